@@ -0,0 +1,198 @@
+# commands_generate.py
+#
+# The code in this file is part of PyXPlot
+# <http://www.pyxplot.org.uk>
+#
+# Copyright (C) 2006-2011 Dominic Ford <coders@pyxplot.org.uk>
+#               2008-2011 Ross Church
+#
+# $Id$
+#
+# PyXPlot is free software; you can redistribute it and/or modify it under the
+# terms of the GNU General Public License as published by the Free Software
+# Foundation; either version 2 of the License, or (at your option) any later
+# version.
+#
+# You should have received a copy of the GNU General Public License along with
+# PyXPlot; if not, write to the Free Software Foundation, Inc., 51 Franklin
+# Street, Fifth Floor, Boston, MA  02110-1301, USA
+
+# ----------------------------------------------------------------------------
+
+# Reads the RE++ definitions of PyXPlot's commands from src/ppl_commands.c, and
+# writes the tree of ParserNodes which ppl_parser.c uses to parse them as
+# static data in src/ppl_parser_tables.h, so that it need not be built each
+# time PyXPlot starts up. The tree is built in exactly the same way as it was
+# by the old ppl_commands_read().
+
+import re
+import sys
+
+PN_TYPE_SEQ  = 21000
+PN_TYPE_OPT  = 21001
+PN_TYPE_REP  = 21002
+PN_TYPE_REP2 = 21003
+PN_TYPE_PER  = 21004
+PN_TYPE_ORA  = 21005
+PN_TYPE_ITEM = 21006
+
+TypeNames = { PN_TYPE_SEQ:"PN_TYPE_SEQ", PN_TYPE_OPT:"PN_TYPE_OPT", PN_TYPE_REP:"PN_TYPE_REP", PN_TYPE_REP2:"PN_TYPE_REP2",
+              PN_TYPE_PER:"PN_TYPE_PER", PN_TYPE_ORA:"PN_TYPE_ORA", PN_TYPE_ITEM:"PN_TYPE_ITEM" }
+
+def fail(message):
+  sys.stderr.write("commands_generate.py: %s\n"%message)
+  sys.exit(1)
+
+# Extract the ppl_commands[] string from ppl_commands.c, undoing C escapes
+
+source = open("src/ppl_commands.c").read()
+match  = re.search(r'char ppl_commands\[\] = "(.*?)(?<!\\)";', source, re.S)
+if match is None: fail("could not find ppl_commands[] in src/ppl_commands.c")
+body   = match.group(1).replace("\\\n", "")
+
+escapes  = { "n":"\n", "t":"\t", "\\":"\\", "\"":"\"", "'":"'" }
+commands = ""
+i        = 0
+while i < len(body):
+  if body[i] == "\\":
+    if body[i+1] not in escapes: fail("unexpected escape sequence \\%s"%body[i+1])
+    commands += escapes[body[i+1]]
+    i += 2
+  else:
+    commands += body[i]
+    i += 1
+
+for c in commands:
+  if ord(c) > 126: fail("non-ASCII character in RE++ definitions")
+
+# Build tree of ParserNodes
+
+class ParserNode:
+  def __init__(self, type):
+    self.type        = type
+    self.MatchString = None
+    self.ACLevel     = -1
+    self.VarName     = None
+    self.VarSetVal   = None
+    self.children    = []
+
+def StartNewStructure(stack, type):
+  node = ParserNode(type)
+  if len(stack) > 0:
+    if (stack[-1].type != PN_TYPE_SEQ) and (type != PN_TYPE_SEQ): StartNewStructure(stack, PN_TYPE_SEQ)
+    stack[-1].children.append(node)
+  stack.append(node)
+
+def RollBack(stack, type, pos):
+  j = pos+1
+  while (len(stack) > 0) and (stack[-1].type == PN_TYPE_SEQ): stack.pop()
+  if len(stack) == 0        : fail("incorrect nesting of types in command specification -- attempt to close an unopened bracket")
+  if stack[-1].type != type : fail("incorrect nesting of types in command specification -- expected %d, but got %d"%(type, stack[-1].type))
+  if commands[j:j+1] == ":": j+=1
+  if (commands[j:j+1] == "@") and (type == PN_TYPE_REP): stack[-1].type = PN_TYPE_REP2; j+=1
+  VarNameBegin = j
+  while (j < len(commands)) and (commands[j] > " "): j+=1
+  if j > VarNameBegin: stack[-1].VarName = commands[VarNameBegin:j]
+  while (j < len(commands)) and (commands[j] != "\n") and (commands[j] < " "): j+=1
+  stack[-1].VarSetVal = ""
+  stack.pop()
+  return j
+
+roots = [] # List of [first letter, top-level node]
+pos   = 0
+N     = len(commands)
+while pos < N:
+  while (pos < N) and (commands[pos] <= " "): pos+=1
+  if pos >= N: break
+  if (commands[pos] >= "a") and (commands[pos] <= "z"): cln = ord(commands[pos])-ord("a")
+  else                                                 : cln = 26
+  stack = []
+  StartNewStructure(stack, PN_TYPE_SEQ)
+  roots.append([cln, stack[0]])
+
+  while True:
+    while (pos < N) and (commands[pos] != "\n") and (commands[pos] <= " "): pos+=1
+    if (pos >= N) or (commands[pos] == "\n"): break
+    c = commands[pos]
+    if   c == "{": StartNewStructure(stack, PN_TYPE_OPT); pos+=1
+    elif c == "[": StartNewStructure(stack, PN_TYPE_REP); pos+=1
+    elif c == "(": StartNewStructure(stack, PN_TYPE_PER); pos+=1
+    elif c == "<": StartNewStructure(stack, PN_TYPE_ORA); pos+=1
+    elif c in "~|":
+      while (len(stack) > 0) and (stack[-1].type == PN_TYPE_SEQ): stack.pop()
+      if (c == "~") and ((len(stack) == 0) or (stack[-1].type != PN_TYPE_PER)): fail("tilda should be used only in permutation structures")
+      if (c == "|") and ((len(stack) == 0) or (stack[-1].type != PN_TYPE_ORA)): fail("pipe alternatives should only be used inside ORA structures")
+      pos+=1
+    elif c == ">": pos = RollBack(stack, PN_TYPE_ORA, pos)
+    elif c == ")": pos = RollBack(stack, PN_TYPE_PER, pos)
+    elif c == "]": pos = RollBack(stack, PN_TYPE_REP, pos)
+    elif c == "}": pos = RollBack(stack, PN_TYPE_OPT, pos)
+    else:
+      if c == "\\": pos+=1
+      if stack[-1].type != PN_TYPE_SEQ: StartNewStructure(stack, PN_TYPE_SEQ)
+      node = ParserNode(PN_TYPE_ITEM)
+      i    = pos
+      while (pos < N) and (commands[pos] > " ") and (commands[pos] != "@") and ((commands[pos] != ":") or (pos == i)): pos+=1
+      if pos == i: fail("found a word of zero length")
+      node.MatchString = commands[i:pos]
+      if commands[pos:pos+1] == "@":
+        pos+=1
+        if commands[pos:pos+1] == "n": node.ACLevel = -2; pos+=1
+        else:
+          level = re.match(r"[0-9]+", commands[pos:])
+          if level is None: fail("expected an autocompletion level after @ in <%s>"%node.MatchString)
+          node.ACLevel = int(level.group(0))
+          pos += len(level.group(0))
+      if commands[pos:pos+1] == ":":
+        pos+=1; i=pos
+        while (pos < N) and (commands[pos] > " ") and (commands[pos] != ":"): pos+=1
+        node.VarName = commands[i:pos]
+      if commands[pos:pos+1] == ":":
+        pos+=1; i=pos
+        while (pos < N) and (commands[pos] > " ") and (commands[pos] != ":"): pos+=1
+        node.VarSetVal = commands[i:pos]
+      stack[-1].children.append(node)
+
+# Number nodes in the order in which they are visited by a depth-first walk
+
+nodes = []
+def number(node):
+  node.index = len(nodes)
+  nodes.append(node)
+  for child in node.children: number(child)
+for root in roots: number(root[1])
+
+def cstring(s):
+  if s is None: return "NULL"
+  return "\"%s\""%s.replace("\\","\\\\").replace("\"","\\\"")
+
+def cnode(node):
+  if node is None: return "NULL"
+  return "PplParserNodes+%d"%node.index
+
+# Write ppl_parser_tables.h
+siblings = {}
+for node in nodes:
+  for j in range(len(node.children)-1): siblings[node.children[j].index] = node.children[j+1]
+
+output = open("src/ppl_parser_tables.h","w")
+output.write("""// This file auto-generated by commands_generate.py from the RE++ definitions in ppl_commands.c
+
+#ifndef _PPL_PARSER_TABLES_H
+#define _PPL_PARSER_TABLES_H 1
+
+#define PPL_PARSER_NNODES %d
+#define PPL_PARSER_NCMDS  %d
+
+static ParserNode PplParserNodes[PPL_PARSER_NNODES] = {
+"""%(len(nodes), len(roots)))
+for node in nodes:
+  FirstChild = None
+  if node.children: FirstChild = node.children[0]
+  output.write(" { %s, %s, %d, %s, %s, %s, %s },\n"%(TypeNames[node.type], cstring(node.MatchString), node.ACLevel, cstring(node.VarName), cstring(node.VarSetVal),
+                                                   cnode(FirstChild), cnode(siblings.get(node.index))))
+output.write("};\n\n")
+output.write("static const int PplParserCmdRoots  [PPL_PARSER_NCMDS] = {%s};\n"%(",".join(["%d"%root[1].index for root in roots])))
+output.write("static const int PplParserCmdLetters[PPL_PARSER_NCMDS] = {%s};\n"%(",".join(["%d"%root[0]       for root in roots])))
+output.write("\n#endif\n")
+output.close()
@@ -0,0 +1,13 @@
+#!/bin/sh
+# Compare the fonts embedded by render number $1 of font_index.ppl with those embedded by
+# the first render, and check that no decoy font file has been embedded.
+grep '^%%BeginFont' tests/out/font_index.eps > tests/out/font_index_$1.fonts
+if ! test -s tests/out/font_index_1.fonts ; then
+  echo "render $1 embeds no fonts"
+elif ! cmp -s tests/out/font_index_1.fonts tests/out/font_index_$1.fonts ; then
+  echo "render $1 embeds different fonts from render 1"
+elif grep -q 'decoy' tests/out/font_index.eps ; then
+  echo "render $1 embeds a decoy font file"
+else
+  echo "render $1 embeds the expected fonts"
+fi
@@ -0,0 +1,18 @@
+#!/bin/sh
+# Rewrite the font index in the user's home directory so that every pfa and pfb file in it
+# appears to be in a decoy directory, and give that directory a modification time which is
+# out of date. PyXPlot must notice that the index is stale and rebuild it, rather than
+# embedding the decoy files. Builds which use libkpathsea keep no index, so there is nothing to do.
+index=$HOME/.pyxplot_fontindex
+decoys=`pwd`/tests/out/font_decoys
+test -f $index || exit 0
+mkdir -p $decoys
+awk -v decoys="$decoys" '
+  $1=="D" { ndirs[$2]++ }
+  $1=="F" && ($2==1 || $2==2) {
+    if (!($2 in decoydir)) { print "D", $2, 1, decoys ; decoydir[$2] = ndirs[$2]++ }
+    f = decoys "/" $4 ; print "% decoy font file" > f ; close(f)
+    print "F", $2, decoydir[$2], $4
+    next
+  }
+  { print }' $index > $index.decoy && mv $index.decoy $index
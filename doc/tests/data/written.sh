@@ -0,0 +1,6 @@
+#!/bin/sh
+# Report whether each of the files named on the command line, which are looked for in the
+# regression tests' output directory, has been written and is not empty.
+for f in "$@" ; do
+  if test -s tests/out/$f ; then echo "$f written" ; else echo "$f missing" ; fi
+done
@@ -0,0 +1,235 @@
+// bmp_jpegwrite.c
+//
+// The code in this file is part of PyXPlot
+// <http://www.pyxplot.org.uk>
+//
+// Copyright (C) 2006-2011 Dominic Ford <coders@pyxplot.org.uk>
+//               2008-2011 Ross Church
+//
+// $Id$
+//
+// PyXPlot is free software; you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation; either version 2 of the License, or (at your option) any later
+// version.
+//
+// You should have received a copy of the GNU General Public License along with
+// PyXPlot; if not, write to the Free Software Foundation, Inc., 51 Franklin
+// Street, Fifth Floor, Boston, MA  02110-1301, USA
+
+// ----------------------------------------------------------------------------
+
+// Write a bitmap, held as rows of RGB bytes, to a baseline JPEG file. Colours
+// are converted to YCbCr without chroma subsampling, and encoded using the
+// example quantisation and Huffman tables of the JPEG standard (Annex K).
+
+#define _PPL_BMP_JPEGWRITE_C 1
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+
+#include "ppl_error.h"
+
+#include "bmp_jpegwrite.h"
+
+static const unsigned char ZigZag[64] = { 0, 1, 8,16, 9, 2, 3,10,17,24,32,25,18,11, 4, 5,12,19,26,33,40,48,41,34,27,20,13, 6, 7,14,21,28,
+                                         35,42,49,56,57,50,43,36,29,22,15,23,30,37,44,51,58,59,52,45,38,31,39,46,53,60,61,54,47,55,62,63 };
+
+static const unsigned char QuantLum[64] = { 16, 11, 10, 16, 24, 40, 51, 61, 12, 12, 14, 19, 26, 58, 60, 55, 14, 13, 16, 24, 40, 57, 69, 56, 14, 17, 22, 29, 51, 87, 80, 62,
+                                            18, 22, 37, 56, 68,109,103, 77, 24, 35, 55, 64, 81,104,113, 92, 49, 64, 78, 87,103,121,120,101, 72, 92, 95, 98,112,100,103, 99 };
+static const unsigned char QuantChr[64] = { 17, 18, 24, 47, 99, 99, 99, 99, 18, 21, 26, 66, 99, 99, 99, 99, 24, 26, 56, 99, 99, 99, 99, 99, 47, 66, 99, 99, 99, 99, 99, 99,
+                                            99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99 };
+
+static const unsigned char DCLumBits[16] = {0,1,5,1,1,1,1,1,1,0,0,0,0,0,0,0};
+static const unsigned char DCChrBits[16] = {0,3,1,1,1,1,1,1,1,1,1,0,0,0,0,0};
+static const unsigned char DCVals   [12] = {0,1,2,3,4,5,6,7,8,9,10,11};
+static const unsigned char ACLumBits[16] = {0,2,1,3,3,2,4,3,5,5,4,4,0,0,1,0x7d};
+static const unsigned char ACChrBits[16] = {0,2,1,2,4,4,3,4,7,5,4,4,0,1,2,0x77};
+static const unsigned char ACLumVals[162] = {
+  0x01,0x02,0x03,0x00,0x04,0x11,0x05,0x12,0x21,0x31,0x41,0x06,0x13,0x51,0x61,0x07,0x22,0x71,0x14,0x32,0x81,0x91,0xa1,0x08,0x23,0x42,0xb1,0xc1,0x15,0x52,0xd1,0xf0,
+  0x24,0x33,0x62,0x72,0x82,0x09,0x0a,0x16,0x17,0x18,0x19,0x1a,0x25,0x26,0x27,0x28,0x29,0x2a,0x34,0x35,0x36,0x37,0x38,0x39,0x3a,0x43,0x44,0x45,0x46,0x47,0x48,0x49,
+  0x4a,0x53,0x54,0x55,0x56,0x57,0x58,0x59,0x5a,0x63,0x64,0x65,0x66,0x67,0x68,0x69,0x6a,0x73,0x74,0x75,0x76,0x77,0x78,0x79,0x7a,0x83,0x84,0x85,0x86,0x87,0x88,0x89,
+  0x8a,0x92,0x93,0x94,0x95,0x96,0x97,0x98,0x99,0x9a,0xa2,0xa3,0xa4,0xa5,0xa6,0xa7,0xa8,0xa9,0xaa,0xb2,0xb3,0xb4,0xb5,0xb6,0xb7,0xb8,0xb9,0xba,0xc2,0xc3,0xc4,0xc5,
+  0xc6,0xc7,0xc8,0xc9,0xca,0xd2,0xd3,0xd4,0xd5,0xd6,0xd7,0xd8,0xd9,0xda,0xe1,0xe2,0xe3,0xe4,0xe5,0xe6,0xe7,0xe8,0xe9,0xea,0xf1,0xf2,0xf3,0xf4,0xf5,0xf6,0xf7,0xf8,
+  0xf9,0xfa };
+static const unsigned char ACChrVals[162] = {
+  0x00,0x01,0x02,0x03,0x11,0x04,0x05,0x21,0x31,0x06,0x12,0x41,0x51,0x07,0x61,0x71,0x13,0x22,0x32,0x81,0x08,0x14,0x42,0x91,0xa1,0xb1,0xc1,0x09,0x23,0x33,0x52,0xf0,
+  0x15,0x62,0x72,0xd1,0x0a,0x16,0x24,0x34,0xe1,0x25,0xf1,0x17,0x18,0x19,0x1a,0x26,0x27,0x28,0x29,0x2a,0x35,0x36,0x37,0x38,0x39,0x3a,0x43,0x44,0x45,0x46,0x47,0x48,
+  0x49,0x4a,0x53,0x54,0x55,0x56,0x57,0x58,0x59,0x5a,0x63,0x64,0x65,0x66,0x67,0x68,0x69,0x6a,0x73,0x74,0x75,0x76,0x77,0x78,0x79,0x7a,0x82,0x83,0x84,0x85,0x86,0x87,
+  0x88,0x89,0x8a,0x92,0x93,0x94,0x95,0x96,0x97,0x98,0x99,0x9a,0xa2,0xa3,0xa4,0xa5,0xa6,0xa7,0xa8,0xa9,0xaa,0xb2,0xb3,0xb4,0xb5,0xb6,0xb7,0xb8,0xb9,0xba,0xc2,0xc3,
+  0xc4,0xc5,0xc6,0xc7,0xc8,0xc9,0xca,0xd2,0xd3,0xd4,0xd5,0xd6,0xd7,0xd8,0xd9,0xda,0xe2,0xe3,0xe4,0xe5,0xe6,0xe7,0xe8,0xe9,0xea,0xf2,0xf3,0xf4,0xf5,0xf6,0xf7,0xf8,
+  0xf9,0xfa };
+
+typedef struct jpeg_huffman
+ {
+  unsigned short code[256];
+  unsigned char  len [256];
+ } jpeg_huffman;
+
+typedef struct jpeg_writer
+ {
+  FILE         *out;
+  unsigned long bits;
+  int           NBits;
+ } jpeg_writer;
+
+// Construct the code for each symbol from the list of how many codes there are of each length
+static void jpeg_HuffmanBuild(jpeg_huffman *h, const unsigned char *bits, const unsigned char *vals)
+ {
+  int i, j, k=0, code=0;
+  for (i=0; i<256; i++) h->len[i] = 0;
+  for (i=0; i<16; i++)
+   {
+    for (j=0; j<bits[i]; j++) { h->code[vals[k]] = code++; h->len[vals[k]] = i+1; k++; }
+    code <<= 1;
+   }
+ }
+
+static void jpeg_PutBits(jpeg_writer *w, unsigned int value, int n)
+ {
+  int c;
+  w->bits   = (w->bits << n) | (value & ((1UL<<n)-1));
+  w->NBits += n;
+  while (w->NBits >= 8)
+   {
+    c = (w->bits >> (w->NBits-8)) & 0xff;
+    putc(c, w->out);
+    if (c==0xff) putc(0, w->out); // Byte stuffing
+    w->NBits -= 8;
+   }
+ }
+
+static void jpeg_PutValue(jpeg_writer *w, jpeg_huffman *h, int symbol, int value, int size)
+ {
+  jpeg_PutBits(w, h->code[symbol], h->len[symbol]);
+  if (size>0) jpeg_PutBits(w, (value<0) ? (value + (1<<size) - 1) : value, size);
+ }
+
+static int jpeg_BitSize(int v)
+ {
+  int n=0;
+  if (v<0) v=-v;
+  while (v) { n++; v>>=1; }
+  return n;
+ }
+
+// Transform, quantise and encode one 8x8 block of samples, which have already been offset by -128
+static void jpeg_block(jpeg_writer *w, double *block, double cosines[8][8], double *quant, int *dc, jpeg_huffman *HuffDC, jpeg_huffman *HuffAC)
+ {
+  double tmp[64], s;
+  int    coef[64], i, u, v, x, size, run=0;
+
+  for (v=0; v<8; v++) for (x=0; x<8; x++) // Rows
+   {
+    for (s=0, i=0; i<8; i++) s += cosines[v][i] * block[i*8+x];
+    tmp[v*8+x] = s;
+   }
+  for (v=0; v<8; v++) for (u=0; u<8; u++) // Columns
+   {
+    for (s=0, i=0; i<8; i++) s += cosines[u][i] * tmp[v*8+i];
+    coef[v*8+u] = (int)floor(s / quant[v*8+u] + 0.5);
+   }
+
+  i = coef[0] - *dc; *dc = coef[0];
+  size = jpeg_BitSize(i);
+  jpeg_PutValue(w, HuffDC, size, i, size);
+  for (i=1; i<64; i++)
+   {
+    v = coef[ZigZag[i]];
+    if (v==0) { run++; continue; }
+    while (run>15) { jpeg_PutValue(w, HuffAC, 0xf0, 0, 0); run-=16; }
+    size = jpeg_BitSize(v);
+    jpeg_PutValue(w, HuffAC, (run<<4)|size, v, size);
+    run = 0;
+   }
+  if (run>0) jpeg_PutValue(w, HuffAC, 0x00, 0, 0); // End of block
+ }
+
+static void jpeg_marker(FILE *out, int marker, int length)
+ {
+  putc(0xff, out); putc(marker, out);
+  if (length>0) { putc((length+2)>>8, out); putc((length+2)&0xff, out); }
+ }
+
+static void jpeg_DHT(FILE *out, int class, const unsigned char *bits, const unsigned char *vals)
+ {
+  int i, n=0;
+  for (i=0; i<16; i++) n+=bits[i];
+  jpeg_marker(out, 0xc4, 17+n);
+  putc(class, out);
+  for (i=0; i<16; i++) putc(bits[i], out);
+  for (i=0; i<n ; i++) putc(vals[i], out);
+ }
+
+// Returns zero on success
+int bmp_jpegwrite(char *filename, unsigned char *data, int width, int height, int quality, double dpi)
+ {
+  jpeg_writer    w;
+  jpeg_huffman   HuffDCLum, HuffDCChr, HuffACLum, HuffACChr;
+  double         cosines[8][8], quant[2][64], block[3][64];
+  unsigned char  QuantTable[2][64];
+  unsigned char *p;
+  int            i, j, k, x, y, c, scale, dc[3]={0,0,0}, d=(int)(dpi+0.5);
+
+  if ((width<1) || (height<1) || (width>65535) || (height>65535)) { ppl_error(ERR_GENERAL, -1, -1, "JPEG images must be between 1 and 65535 pixels in each dimension"); return 1; }
+  if ((w.out = fopen(filename, "wb"))==NULL) { sprintf(temp_err_string, "Could not write to file '%s'", filename); ppl_error(ERR_FILE, -1, -1, temp_err_string); return 1; }
+  w.bits = 0; w.NBits = 0;
+  if (d>65535) d=65535;
+
+  // Scale the quantisation tables in the same way as the Independent JPEG Group's library does
+  if (quality<  1) quality=1;
+  if (quality>100) quality=100;
+  scale = (quality<50) ? (5000/quality) : (200-2*quality);
+  for (i=0; i<64; i++)
+   {
+    k = (QuantLum[i]*scale+50)/100; QuantTable[0][i] = (k<1)?1:((k>255)?255:k);
+    k = (QuantChr[i]*scale+50)/100; QuantTable[1][i] = (k<1)?1:((k>255)?255:k);
+    quant[0][i] = QuantTable[0][i]; quant[1][i] = QuantTable[1][i];
+   }
+  for (i=0; i<8; i++) for (j=0; j<8; j++) cosines[i][j] = ((i==0)?sqrt(0.125):0.5) * cos((2*j+1)*i*M_PI/16);
+  jpeg_HuffmanBuild(&HuffDCLum, DCLumBits, DCVals);
+  jpeg_HuffmanBuild(&HuffDCChr, DCChrBits, DCVals);
+  jpeg_HuffmanBuild(&HuffACLum, ACLumBits, ACLumVals);
+  jpeg_HuffmanBuild(&HuffACChr, ACChrBits, ACChrVals);
+
+  // Headers
+  jpeg_marker(w.out, 0xd8, 0); // SOI
+  jpeg_marker(w.out, 0xe0, 14); // JFIF APP0, with resolution in dots per inch
+  fwrite("JFIF\0\1\1\1", 1, 8, w.out); putc(d>>8, w.out); putc(d&0xff, w.out); putc(d>>8, w.out); putc(d&0xff, w.out); putc(0, w.out); putc(0, w.out);
+  for (k=0; k<2; k++)
+   {
+    jpeg_marker(w.out, 0xdb, 65); // DQT
+    putc(k, w.out);
+    for (i=0; i<64; i++) putc(QuantTable[k][ZigZag[i]], w.out);
+   }
+  jpeg_marker(w.out, 0xc0, 15); // SOF0
+  putc(8, w.out); putc(height>>8, w.out); putc(height&0xff, w.out); putc(width>>8, w.out); putc(width&0xff, w.out); putc(3, w.out);
+  for (k=0; k<3; k++) { putc(k+1, w.out); putc(0x11, w.out); putc(k>0, w.out); }
+  jpeg_DHT(w.out, 0x00, DCLumBits, DCVals);
+  jpeg_DHT(w.out, 0x10, ACLumBits, ACLumVals);
+  jpeg_DHT(w.out, 0x01, DCChrBits, DCVals);
+  jpeg_DHT(w.out, 0x11, ACChrBits, ACChrVals);
+  jpeg_marker(w.out, 0xda, 10); // SOS
+  putc(3, w.out);
+  for (k=0; k<3; k++) { putc(k+1, w.out); putc((k>0)?0x11:0x00, w.out); }
+  putc(0, w.out); putc(63, w.out); putc(0, w.out);
+
+  // Encode 8x8 blocks, repeating the last row and column of pixels to fill the blocks at the edges of the image
+  for (y=0; y<height; y+=8) for (x=0; x<width; x+=8)
+   {
+    for (j=0; j<8; j++) for (i=0; i<8; i++)
+     {
+      p = data + 3*((long)((y+j<height)?(y+j):(height-1))*width + ((x+i<width)?(x+i):(width-1)));
+      block[0][j*8+i] =  0.299   *p[0] + 0.587   *p[1] + 0.114   *p[2] - 128;
+      block[1][j*8+i] = -0.168736*p[0] - 0.331264*p[1] + 0.5     *p[2];
+      block[2][j*8+i] =  0.5     *p[0] - 0.418688*p[1] - 0.081312*p[2];
+     }
+    for (c=0; c<3; c++) jpeg_block(&w, block[c], cosines, quant[c>0], dc+c, (c>0)?&HuffDCChr:&HuffDCLum, (c>0)?&HuffACChr:&HuffACLum);
+   }
+  jpeg_PutBits(&w, 0x7f, 7); // Pad final byte with one bits
+  jpeg_marker(w.out, 0xd9, 0); // EOI
+
+  if (fclose(w.out)!=0) { sprintf(temp_err_string, "Could not write to file '%s'", filename); ppl_error(ERR_FILE, -1, -1, temp_err_string); return 1; }
+  return 0;
+ }
@@ -0,0 +1,62 @@
+// bmp_pngwrite.c
+//
+// The code in this file is part of PyXPlot
+// <http://www.pyxplot.org.uk>
+//
+// Copyright (C) 2006-2011 Dominic Ford <coders@pyxplot.org.uk>
+//               2008-2011 Ross Church
+//
+// $Id$
+//
+// PyXPlot is free software; you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation; either version 2 of the License, or (at your option) any later
+// version.
+//
+// You should have received a copy of the GNU General Public License along with
+// PyXPlot; if not, write to the Free Software Foundation, Inc., 51 Franklin
+// Street, Fifth Floor, Boston, MA  02110-1301, USA
+
+// ----------------------------------------------------------------------------
+
+// Write a bitmap, held as rows of RGB or RGBA bytes, to a PNG file using libpng
+
+#define _PPL_BMP_PNGWRITE_C 1
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <png.h>
+
+#include "ppl_error.h"
+
+#include "bmp_pngwrite.h"
+
+// Returns zero on success
+int bmp_pngwrite(char *filename, unsigned char *data, int width, int height, int alpha, double dpi)
+ {
+  FILE       *out;
+  png_structp png_ptr;
+  png_infop   info_ptr;
+  png_uint_32 ppm = (png_uint_32)(dpi / 0.0254 + 0.5); // Pixels per metre
+  int         i, stride = width * (alpha ? 4 : 3);
+
+  if ((out = fopen(filename, "wb"))==NULL) { sprintf(temp_err_string, "Could not write to file '%s'", filename); ppl_error(ERR_FILE, -1, -1, temp_err_string); return 1; }
+
+  png_ptr = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+  if (png_ptr == NULL) { ppl_error(ERR_MEMORY, -1, -1,"Out of memory"); fclose(out); return 1; }
+
+  info_ptr = png_create_info_struct(png_ptr);
+  if (info_ptr == NULL) { ppl_error(ERR_MEMORY, -1, -1,"Out of memory"); png_destroy_write_struct(&png_ptr, NULL); fclose(out); return 1; }
+
+  if (setjmp(png_jmpbuf(png_ptr))) { ppl_error(ERR_INTERNAL, -1, -1, "Unexpected error in libpng while trying to write PNG image file"); png_destroy_write_struct(&png_ptr, &info_ptr); fclose(out); return 1; }
+
+  png_init_io(png_ptr, out);
+  png_set_IHDR(png_ptr, info_ptr, width, height, 8, alpha ? PNG_COLOR_TYPE_RGB_ALPHA : PNG_COLOR_TYPE_RGB, PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+  png_set_pHYs(png_ptr, info_ptr, ppm, ppm, PNG_RESOLUTION_METER);
+  png_write_info(png_ptr, info_ptr);
+  for (i=0; i<height; i++) png_write_row(png_ptr, data + (long)i*stride);
+  png_write_end(png_ptr, info_ptr);
+  png_destroy_write_struct(&png_ptr, &info_ptr);
+  if (fclose(out)!=0) { sprintf(temp_err_string, "Could not write to file '%s'", filename); ppl_error(ERR_FILE, -1, -1, temp_err_string); return 1; }
+  return 0;
+ }
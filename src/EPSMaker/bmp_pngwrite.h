@@ -0,0 +1,30 @@
+// bmp_pngwrite.h
+//
+// The code in this file is part of PyXPlot
+// <http://www.pyxplot.org.uk>
+//
+// Copyright (C) 2006-2011 Dominic Ford <coders@pyxplot.org.uk>
+//               2008-2011 Ross Church
+//
+// $Id$
+//
+// PyXPlot is free software; you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation; either version 2 of the License, or (at your option) any later
+// version.
+//
+// You should have received a copy of the GNU General Public License along with
+// PyXPlot; if not, write to the Free Software Foundation, Inc., 51 Franklin
+// Street, Fifth Floor, Boston, MA  02110-1301, USA
+
+// ----------------------------------------------------------------------------
+
+// Write a bitmap, held as rows of RGB or RGBA bytes, to a PNG file using libpng
+
+#ifndef _PPL_BMP_PNGWRITE_H
+#define _PPL_BMP_PNGWRITE_H 1
+
+int bmp_pngwrite(char *filename, unsigned char *data, int width, int height, int alpha, double dpi);
+
+#endif
+
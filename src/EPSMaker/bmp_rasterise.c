@@ -0,0 +1,2501 @@
+// bmp_rasterise.c
+//
+// The code in this file is part of PyXPlot
+// <http://www.pyxplot.org.uk>
+//
+// Copyright (C) 2006-2011 Dominic Ford <coders@pyxplot.org.uk>
+//               2008-2011 Ross Church
+//
+// $Id$
+//
+// PyXPlot is free software; you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation; either version 2 of the License, or (at your option) any later
+// version.
+//
+// You should have received a copy of the GNU General Public License along with
+// PyXPlot; if not, write to the Free Software Foundation, Inc., 51 Franklin
+// Street, Fifth Floor, Boston, MA  02110-1301, USA
+
+// ----------------------------------------------------------------------------
+
+// Built-in rasteriser for the bitmap terminals. PyXPlot's EPS output uses only
+// a small part of the PostScript language: paths, strokes, fills, clipping,
+// images, and Type 1 fonts which are embedded in the prolog. This file holds an
+// interpreter for that subset, which paints straight into a bitmap using an
+// anti-aliased scanline filler, so that PNG and JPEG output can be made without
+// running ghostscript. Anything outside the subset -- for example, the
+// PostScript inside an included EPS image -- makes bmp_rasterise() give up, and
+// the caller then falls back upon ghostscript.
+
+#define _PPL_BMP_RASTERISE_C 1
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <limits.h>
+#include <math.h>
+#include <zlib.h>
+
+#include "ListTools/lt_memory.h"
+
+#include "ppl_error.h"
+
+#include "bmp_jpegwrite.h"
+#include "bmp_pngwrite.h"
+#include "bmp_rasterise.h"
+#include "bmp_type1.h"
+
+#define RASTER_STACK      4096     // Depth of the operand stack
+#define RASTER_DICTSTACK    64     // Depth of the dictionary stack
+#define RASTER_GSTACK      128     // Depth to which gsave may be nested
+#define RASTER_EXECDEPTH   256     // Depth to which procedure calls may be nested
+#define RASTER_NAMEHASH   1024     // Number of buckets in the table of interned names
+#define RASTER_TOKLEN      256     // Maximum length of names
+#define RASTER_MAXDASH      32     // Maximum length of dash patterns
+#define RASTER_MAXLOOP 10000000L   // Maximum number of iterations of the loop operator
+#define RASTER_MAXDASHES 1000000L  // Maximum number of dashes into which one stroke may be broken
+#define RASTER_MAXPIXELS (1L<<28)  // Larger bitmaps are left to ghostscript
+#define RASTER_FLATNESS    0.1     // Maximum distance, in pixels, between curves and the straight lines which approximate them
+#define RASTER_MINWIDTH    1.0     // Minimum width, in pixels, of stroked lines
+
+// Types of PostScript object
+#define PS_NULL      0
+#define PS_INT       1
+#define PS_REAL      2
+#define PS_BOOL      3
+#define PS_NAME      4
+#define PS_STRING    5
+#define PS_ARRAY     6
+#define PS_DICT      7
+#define PS_MARK      8
+#define PS_OPERATOR  9
+#define PS_FILE     10
+#define PS_FONT     11
+#define PS_SAVE     12
+
+// Filters which may be applied to currentfile. Image data must be ASCII85 encoded, and may additionally be deflated.
+#define PS_FILTER_A85    1
+#define PS_FILTER_FLATE  2
+
+// Colour spaces
+#define CS_GRAY     1
+#define CS_RGB      3
+#define CS_CMYK     4
+#define CS_INDEXED  5
+
+// Flags attached to points in paths
+#define RP_MOVE     1
+#define RP_CLOSED   2
+
+struct raster_state;
+
+typedef struct ps_name
+ {
+  char           *text;
+  struct ps_name *next;
+ } ps_name;
+
+typedef struct ps_operator
+ {
+  char *name;
+  int (*fn)(struct raster_state *);
+ } ps_operator;
+
+typedef struct ps_object
+ {
+  unsigned char type, exec;
+  int           len;         // Length of strings and arrays
+  union
+   {
+    long                i;
+    double              r;
+    ps_name            *name;
+    unsigned char      *s;
+    struct ps_object   *a;
+    struct ps_dict     *d;
+    const ps_operator  *op;
+    struct raster_font *font;
+   } u;
+ } ps_object;
+
+typedef struct ps_dict
+ {
+  int        size, count;    // size is a power of two
+  ps_name  **keys;
+  ps_object *vals;
+ } ps_dict;
+
+typedef struct raster_font
+ {
+  bmp_type1_font *t1;
+  double          m[6];      // Font matrix, including any scaling, which maps character space onto user space
+ } raster_font;
+
+typedef struct raster_path
+ {
+  double        *x, *y;      // Device coordinates
+  unsigned char *flag;
+  int            n, alloc, SubpathStart;
+  unsigned char  CurrentSet, closed;
+  double         cx, cy;     // Current point
+ } raster_path;
+
+typedef struct raster_clip
+ {
+  unsigned char *mask;       // Coverage of each pixel of the page, 0-255
+  int            refs;
+  int            x0, y0, x1, y1;
+ } raster_clip;
+
+typedef struct raster_gstate
+ {
+  double         ctm[6];
+  double         rgb[3];
+  int            ColourSpace, hival;
+  unsigned char *palette;    // Lookup table of an Indexed colour space, in RGB
+  double         LineWidth, MiterLimit, DashOffset;
+  double         dash[RASTER_MAXDASH];
+  int            LineCap, LineJoin, NDash;
+  raster_font   *font;
+  raster_clip   *clip;       // NULL if there is no clipping path
+  raster_path    path;
+ } raster_gstate;
+
+typedef struct raster_state
+ {
+  unsigned char  *in;        // Text of the EPS file being interpreted
+  long            len, pos;
+  ps_object       stack[RASTER_STACK];
+  int             sp;
+  ps_dict        *dstack[RASTER_DICTSTACK];
+  int             dsp;
+  ps_dict        *systemdict, *userdict;
+  ps_name        *names[RASTER_NAMEHASH];
+  raster_gstate   gs, gstack[RASTER_GSTACK];
+  int             gsp, depth;
+  unsigned char   failed, exiting, done;
+  bmp_type1_font *fonts;
+  int             W, H, antialias;
+  unsigned char  *pixels;    // Premultiplied RGBA
+  float          *acc;       // Accumulation buffer for the scanline filler; all zero between uses
+  long            AccAlloc;
+  double         *ux, *uy;   // Workspace for stroking, in user coordinates
+  int             UAlloc;
+  raster_path     tmp;       // Outlines of strokes and glyphs
+ } raster_state;
+
+static int raster_fail(raster_state *S, char *msg)
+ {
+  if (!S->failed && DEBUG) { sprintf(temp_err_string, "Built-in rasteriser stopped at byte %ld: %s", S->pos, msg); ppl_log(temp_err_string); }
+  S->failed = 1;
+  return 1;
+ }
+
+#define NEED(N) if (S->sp<(N)) return raster_fail(S, "stack underflow")
+
+// ----------------------------------------------------------------------------
+// Matrices, in PostScript's [a b c d tx ty] form
+// ----------------------------------------------------------------------------
+
+static void raster_transform(const double *m, double x, double y, double *ox, double *oy)
+ {
+  *ox = m[0]*x + m[2]*y + m[4];
+  *oy = m[1]*x + m[3]*y + m[5];
+ }
+
+// out = the transformation a followed by the transformation b. out may be the same as a or b.
+static void raster_MatMul(const double *a, const double *b, double *out)
+ {
+  double o[6];
+  o[0] = a[0]*b[0] + a[1]*b[2];
+  o[1] = a[0]*b[1] + a[1]*b[3];
+  o[2] = a[2]*b[0] + a[3]*b[2];
+  o[3] = a[2]*b[1] + a[3]*b[3];
+  o[4] = a[4]*b[0] + a[5]*b[2] + b[4];
+  o[5] = a[4]*b[1] + a[5]*b[3] + b[5];
+  memcpy(out, o, 6*sizeof(double));
+ }
+
+// Returns non-zero if m is singular
+static int raster_MatInvert(const double *m, double *out)
+ {
+  double det = m[0]*m[3] - m[1]*m[2];
+  if ((det==0) || (!isfinite(det))) return 1;
+  out[0] =  m[3]/det;
+  out[1] = -m[1]/det;
+  out[2] = -m[2]/det;
+  out[3] =  m[0]/det;
+  out[4] = -(m[4]*out[0] + m[5]*out[2]);
+  out[5] = -(m[4]*out[1] + m[5]*out[3]);
+  return 0;
+ }
+
+// ----------------------------------------------------------------------------
+// Paths
+// ----------------------------------------------------------------------------
+
+static int raster_PathAdd(raster_state *S, raster_path *p, double x, double y, unsigned char flag)
+ {
+  if (p->n >= p->alloc)
+   {
+    int            alloc = (p->alloc<64) ? 64 : (2*p->alloc);
+    double        *nx = (double *)realloc(p->x, alloc*sizeof(double));
+    double        *ny = (nx==NULL) ? NULL : (double *)realloc(p->y, alloc*sizeof(double));
+    unsigned char *nf = (ny==NULL) ? NULL : (unsigned char *)realloc(p->flag, alloc);
+    if (nx!=NULL) p->x = nx;
+    if (ny!=NULL) p->y = ny;
+    if (nf!=NULL) p->flag = nf;
+    if (nf==NULL) { ppl_error(ERR_MEMORY, -1, -1, "Out of memory"); return raster_fail(S, "out of memory"); }
+    p->alloc = alloc;
+   }
+  p->x[p->n] = x;
+  p->y[p->n] = y;
+  p->flag[p->n++] = flag;
+  return 0;
+ }
+
+static void raster_PathReset(raster_path *p)
+ {
+  p->n = 0;
+  p->CurrentSet = p->closed = 0;
+ }
+
+static void raster_PathFree(raster_path *p)
+ {
+  if (p->x   !=NULL) free(p->x);
+  if (p->y   !=NULL) free(p->y);
+  if (p->flag!=NULL) free(p->flag);
+  p->x = p->y = NULL; p->flag = NULL;
+  p->n = p->alloc = 0;
+  p->CurrentSet = p->closed = 0;
+ }
+
+static int raster_PathCopy(raster_state *S, raster_path *out, const raster_path *in)
+ {
+  *out = *in;
+  out->x = out->y = NULL; out->flag = NULL; out->alloc = 0;
+  if (in->n==0) return 0;
+  out->x    = (double *)malloc(in->n*sizeof(double));
+  out->y    = (double *)malloc(in->n*sizeof(double));
+  out->flag = (unsigned char *)malloc(in->n);
+  if ((out->x==NULL)||(out->y==NULL)||(out->flag==NULL)) { raster_PathFree(out); ppl_error(ERR_MEMORY, -1, -1, "Out of memory"); return raster_fail(S, "out of memory"); }
+  memcpy(out->x, in->x, in->n*sizeof(double));
+  memcpy(out->y, in->y, in->n*sizeof(double));
+  memcpy(out->flag, in->flag, in->n);
+  out->alloc = in->n;
+  return 0;
+ }
+
+static int raster_moveto(raster_state *S, raster_path *p, double x, double y)
+ {
+  if ((p->n>0) && (p->flag[p->n-1]==RP_MOVE) && (!p->closed)) p->n--; // A moveto immediately after another replaces it
+  if (raster_PathAdd(S, p, x, y, RP_MOVE)) return 1;
+  p->SubpathStart = p->n-1;
+  p->cx = x; p->cy = y;
+  p->CurrentSet = 1;
+  p->closed     = 0;
+  return 0;
+ }
+
+static int raster_lineto(raster_state *S, raster_path *p, double x, double y)
+ {
+  if (!p->CurrentSet) return raster_fail(S, "no current point");
+  if (p->closed) { if (raster_moveto(S, p, p->cx, p->cy)) return 1; } // After closepath, a new subpath begins at the same point
+  if (raster_PathAdd(S, p, x, y, 0)) return 1;
+  p->cx = x; p->cy = y;
+  return 0;
+ }
+
+static void raster_closepath(raster_path *p)
+ {
+  if ((!p->CurrentSet) || (p->closed)) return;
+  p->flag[p->SubpathStart] |= RP_CLOSED;
+  p->cx = p->x[p->SubpathStart];
+  p->cy = p->y[p->SubpathStart];
+  p->closed = 1;
+ }
+
+// Append a Bezier curve, in device coordinates, from the current point
+static int raster_curveto(raster_state *S, raster_path *p, double x1, double y1, double x2, double y2, double x3, double y3)
+ {
+  double x0=p->cx, y0=p->cy, dd, t, u;
+  int    i, n;
+  if (!p->CurrentSet) return raster_fail(S, "no current point");
+  dd = hypot(x0-2*x1+x2, y0-2*y1+y2);
+  t  = hypot(x1-2*x2+x3, y1-2*y2+y3);
+  if (t>dd) dd=t;
+  n = (int)ceil(sqrt(0.75*dd/RASTER_FLATNESS));
+  if (n<1) n=1; else if (n>1000) n=1000;
+  for (i=1; i<=n; i++)
+   {
+    t = ((double)i)/n; u = 1-t;
+    if (raster_lineto(S, p, u*u*u*x0 + 3*u*u*t*x1 + 3*u*t*t*x2 + t*t*t*x3, u*u*u*y0 + 3*u*u*t*y1 + 3*u*t*t*y2 + t*t*t*y3)) return 1;
+   }
+  return 0;
+ }
+
+// Append an arc, given in user coordinates, to the current path
+static int raster_arc(raster_state *S, double xc, double yc, double r, double a1, double a2, int dir)
+ {
+  double *m = S->gs.ctm, rdev, step, a, x, y;
+  int     i, n;
+  if (dir>0) { while (a2<a1) a2+=360; }
+  else       { while (a2>a1) a2-=360; }
+  rdev = fabs(r) * sqrt(fabs(m[0]*m[3] - m[1]*m[2]));
+  step = (rdev>RASTER_FLATNESS) ? (2*acos(1-RASTER_FLATNESS/rdev)) : (M_PI/2);
+  n = (int)ceil(fabs(a2-a1)*M_PI/180/step);
+  if (n<1) n=1; else if (n>10000) n=10000;
+  for (i=0; i<=n; i++)
+   {
+    a = (a1 + (a2-a1)*i/n) * M_PI / 180;
+    raster_transform(m, xc + r*cos(a), yc + r*sin(a), &x, &y);
+    if ((i==0) && (!S->gs.path.CurrentSet)) { if (raster_moveto(S, &S->gs.path, x, y)) return 1; }
+    else                                    { if (raster_lineto(S, &S->gs.path, x, y)) return 1; }
+   }
+  return 0;
+ }
+
+// ----------------------------------------------------------------------------
+// Scanline filler. Each edge of a path adds its signed area to an accumulation
+// buffer, whose running sum along each row is then the exact coverage of each
+// pixel by the path. See, for example, the rasteriser of stb_truetype.
+// ----------------------------------------------------------------------------
+
+// Accumulate an edge lying within 0<=x<=w. Rows are (w+2) cells wide.
+static void raster_line(float *acc, int w, int h, double x0, double y0, double x1, double y1)
+ {
+  double dir, dxdy, x, xnext, xa, xb, dy, d, s, x0f, x1f, a0, a1, a2, am, xmf;
+  float *row;
+  int    y, xai, xbi, i;
+
+  if (y0==y1) return;
+  if (y0<y1) dir=1;
+  else { dir=-1; d=x0; x0=x1; x1=d; d=y0; y0=y1; y1=d; }
+  if ((y1<=0) || (y0>=h)) return;
+  dxdy = (x1-x0)/(y1-y0);
+  x = x0;
+  if (y0<0) { x -= y0*dxdy; y0=0; }
+  if (y1>h) y1=h;
+  for (y=(int)y0; (y<h) && (y<y1); y++)
+   {
+    row   = acc + (long)y*(w+2);
+    dy    = ((y+1<y1)?(y+1):y1) - ((y>y0)?y:y0);
+    xnext = x + dxdy*dy;
+    d     = dy*dir;
+    xa    = (x<xnext)?x:xnext; if (xa<0) xa=0; if (xa>w) xa=w;
+    xb    = (x<xnext)?xnext:x; if (xb<0) xb=0; if (xb>w) xb=w;
+    xai   = (int)floor(xa);
+    xbi   = (int)ceil(xb);
+    if (xbi <= xai+1)
+     {
+      xmf = 0.5*(x+xnext) - xai;
+      if (xmf<0) xmf=0;
+      if (xmf>1) xmf=1;
+      row[xai  ] += d - d*xmf;
+      row[xai+1] += d*xmf;
+     }
+    else
+     {
+      s   = 1/(xb-xa);
+      x0f = xa - xai;
+      a0  = 0.5*s*(1-x0f)*(1-x0f);
+      x1f = xb - xbi + 1;
+      am  = 0.5*s*x1f*x1f;
+      row[xai] += d*a0;
+      if (xbi == xai+2)
+       { row[xai+1] += d*(1-a0-am); }
+      else
+       {
+        a1 = s*(1.5-x0f);
+        row[xai+1] += d*(a1-a0);
+        for (i=xai+2; i<xbi-1; i++) row[i] += d*s;
+        a2 = a1 + (xbi-xai-3)*s;
+        row[xbi-1] += d*(1-a2-am);
+       }
+      row[xbi] += d*am;
+     }
+    x = xnext;
+   }
+ }
+
+// Accumulate an edge, splitting it where it crosses the left and right sides of the buffer. Parts which lie to the left
+// of the buffer become vertical edges along its left side, which have the same effect upon the coverage within it.
+static void raster_edge(float *acc, int w, int h, double x0, double y0, double x1, double y1)
+ {
+  double ym;
+  if ((y0==y1) || ((y0<=0)&&(y1<=0)) || ((y0>=h)&&(y1>=h))) return;
+  if (((x0<0)&&(x1>0)) || ((x0>0)&&(x1<0)))
+   {
+    ym = y0 + (0-x0)*(y1-y0)/(x1-x0);
+    raster_edge(acc, w, h, x0, y0, 0, ym);
+    raster_edge(acc, w, h, 0, ym, x1, y1);
+    return;
+   }
+  if (((x0<w)&&(x1>w)) || ((x0>w)&&(x1<w)))
+   {
+    ym = y0 + (w-x0)*(y1-y0)/(x1-x0);
+    raster_edge(acc, w, h, x0, y0, w, ym);
+    raster_edge(acc, w, h, w, ym, x1, y1);
+    return;
+   }
+  if (x0<0) x0=0; else if (x0>w) x0=w;
+  if (x1<0) x1=0; else if (x1>w) x1=w;
+  raster_line(acc, w, h, x0, y0, x1, y1);
+ }
+
+// Fill a path, using the non-zero or even-odd winding rule, with the current colour, subject to the current clipping
+// path. If MaskOut is not NULL, the coverage of each pixel is instead multiplied by that of the current clipping path,
+// and written to MaskOut, which should be zeroed by the caller.
+static int raster_fill(raster_state *S, raster_path *p, int evenodd, unsigned char *MaskOut)
+ {
+  raster_clip *clip = S->gs.clip;
+  double       minx, maxx, miny, maxy, sum, cov, c[4];
+  int          x0, x1, y0, y1, bw, bh, i, j, k, s, e;
+  long         need, idx;
+  float       *row;
+  unsigned char *px;
+
+  if (p->n<2) return 0;
+  minx = maxx = p->x[0]; miny = maxy = p->y[0];
+  for (i=1; i<p->n; i++)
+   {
+    if (p->x[i]<minx) minx=p->x[i]; else if (p->x[i]>maxx) maxx=p->x[i];
+    if (p->y[i]<miny) miny=p->y[i]; else if (p->y[i]>maxy) maxy=p->y[i];
+   }
+  if ((!isfinite(minx)) || (!isfinite(maxx)) || (!isfinite(miny)) || (!isfinite(maxy))) return 0;
+  x0 = (minx< 0   ) ? 0    : (minx>S->W ? S->W : (int)floor(minx));
+  x1 = (maxx>S->W) ? S->W : (maxx<0     ? 0    : (int)ceil (maxx));
+  y0 = (miny< 0   ) ? 0    : (miny>S->H ? S->H : (int)floor(miny));
+  y1 = (maxy>S->H) ? S->H : (maxy<0     ? 0    : (int)ceil (maxy));
+  if (clip!=NULL)
+   {
+    if (x0<clip->x0) x0=clip->x0;
+    if (x1>clip->x1) x1=clip->x1;
+    if (y0<clip->y0) y0=clip->y0;
+    if (y1>clip->y1) y1=clip->y1;
+   }
+  if ((x0>=x1) || (y0>=y1)) return 0;
+  bw = x1-x0; bh = y1-y0;
+
+  need = (long)(bw+2)*bh;
+  if (need > S->AccAlloc)
+   {
+    if (S->acc!=NULL) free(S->acc);
+    S->acc = (float *)calloc(need, sizeof(float));
+    if (S->acc==NULL) { S->AccAlloc=0; ppl_error(ERR_MEMORY, -1, -1, "Out of memory"); return raster_fail(S, "out of memory"); }
+    S->AccAlloc = need;
+   }
+
+  for (s=0; s<p->n; s=e)
+   {
+    for (e=s+1; (e<p->n) && !(p->flag[e]&RP_MOVE); e++);
+    for (i=s; i<e-1; i++) raster_edge(S->acc, bw, bh, p->x[i]-x0, p->y[i]-y0, p->x[i+1]-x0, p->y[i+1]-y0);
+    raster_edge(S->acc, bw, bh, p->x[e-1]-x0, p->y[e-1]-y0, p->x[s]-x0, p->y[s]-y0); // Subpaths are implicitly closed
+   }
+
+  for (k=0; k<3; k++) c[k] = 255 * S->gs.rgb[k];
+  c[3] = 255;
+  for (j=0; j<bh; j++)
+   {
+    row = S->acc + (long)j*(bw+2);
+    sum = 0;
+    for (i=0; i<bw; i++)
+     {
+      sum   += row[i];
+      row[i] = 0;
+      cov    = fabs(sum);
+      if (evenodd) { cov = fmod(cov, 2); if (cov>1) cov=2-cov; }
+      else if (cov>1) cov=1;
+      if (!S->antialias) cov = (cov>=0.5) ? 1 : 0;
+      idx = (long)(y0+j)*S->W + x0+i;
+      if (clip!=NULL) cov *= clip->mask[idx] / 255.0;
+      if (MaskOut!=NULL) { MaskOut[idx] = (unsigned char)(255*cov+0.5); continue; }
+      if (cov < 1.0/512) continue;
+      px = S->pixels + 4*idx;
+      for (k=0; k<4; k++) px[k] = (unsigned char)(px[k] + (c[k]-px[k])*cov + 0.5);
+     }
+    row[bw] = row[bw+1] = 0;
+   }
+  return 0;
+ }
+
+static void raster_ClipRelease(raster_clip *c)
+ {
+  if ((c==NULL) || (--c->refs > 0)) return;
+  free(c->mask);
+  free(c);
+ }
+
+// Intersect the clipping path with the current path
+static int raster_ClipPath(raster_state *S, int evenodd)
+ {
+  raster_clip *c = (raster_clip *)malloc(sizeof(raster_clip));
+  double       minx=S->W, maxx=0, miny=S->H, maxy=0;
+  int          i;
+  if (c==NULL) { ppl_error(ERR_MEMORY, -1, -1, "Out of memory"); return raster_fail(S, "out of memory"); }
+  c->mask = (unsigned char *)calloc((long)S->W*S->H, 1);
+  if (c->mask==NULL) { free(c); ppl_error(ERR_MEMORY, -1, -1, "Out of memory"); return raster_fail(S, "out of memory"); }
+  c->refs = 1;
+  if (raster_fill(S, &S->gs.path, evenodd, c->mask)) { raster_ClipRelease(c); return 1; }
+  for (i=0; i<S->gs.path.n; i++)
+   {
+    if (S->gs.path.x[i]<minx) minx=S->gs.path.x[i];
+    if (S->gs.path.x[i]>maxx) maxx=S->gs.path.x[i];
+    if (S->gs.path.y[i]<miny) miny=S->gs.path.y[i];
+    if (S->gs.path.y[i]>maxy) maxy=S->gs.path.y[i];
+   }
+  c->x0 = (minx<0) ? 0 : (int)floor(minx);
+  c->y0 = (miny<0) ? 0 : (int)floor(miny);
+  c->x1 = (maxx>S->W) ? S->W : (int)ceil(maxx);
+  c->y1 = (maxy>S->H) ? S->H : (int)ceil(maxy);
+  if (S->gs.clip!=NULL)
+   {
+    if (c->x0<S->gs.clip->x0) c->x0=S->gs.clip->x0;
+    if (c->x1>S->gs.clip->x1) c->x1=S->gs.clip->x1;
+    if (c->y0<S->gs.clip->y0) c->y0=S->gs.clip->y0;
+    if (c->y1>S->gs.clip->y1) c->y1=S->gs.clip->y1;
+   }
+  if (c->x1<c->x0) c->x1=c->x0;
+  if (c->y1<c->y0) c->y1=c->y0;
+  raster_ClipRelease(S->gs.clip);
+  S->gs.clip = c;
+  return 0;
+ }
+
+// ----------------------------------------------------------------------------
+// Stroking. Strokes are built, in user coordinates, from a quadrilateral for
+// each line segment, plus polygons for the joins and caps. These all wind the
+// same way, so that filling them with the non-zero rule paints their union.
+// ----------------------------------------------------------------------------
+
+// Add a polygon, given in user coordinates, to the outline S->tmp, winding anticlockwise in device space
+static int raster_polygon(raster_state *S, double *x, double *y, int n)
+ {
+  double dx[64], dy[64], area=0;
+  int    i;
+  if ((n<3) || (n>64)) return 0;
+  for (i=0; i<n; i++) raster_transform(S->gs.ctm, x[i], y[i], dx+i, dy+i);
+  for (i=0; i<n; i++) area += dx[i]*dy[(i+1)%n] - dx[(i+1)%n]*dy[i];
+  if (area==0) return 0;
+  for (i=0; i<n; i++)
+   {
+    int j = (area>0) ? i : (n-1-i);
+    if (raster_PathAdd(S, &S->tmp, dx[j], dy[j], (i==0)?RP_MOVE:0)) return 1;
+   }
+  return 0;
+ }
+
+static int raster_circle(raster_state *S, double xc, double yc, double r)
+ {
+  double *m = S->gs.ctm, x[64], y[64], rdev;
+  int     i, n;
+  rdev = r * sqrt(fabs(m[0]*m[3] - m[1]*m[2]));
+  n = (rdev>RASTER_FLATNESS) ? (int)ceil(2*M_PI / (2*acos(1-RASTER_FLATNESS/rdev))) : 4;
+  if (n<8) n=8; else if (n>64) n=64;
+  for (i=0; i<n; i++) { x[i] = xc + r*cos(2*M_PI*i/n); y[i] = yc + r*sin(2*M_PI*i/n); }
+  return raster_polygon(S, x, y, n);
+ }
+
+// Square cap at (x,y), extending in direction (dx,dy)
+static int raster_SquareCap(raster_state *S, double x, double y, double dx, double dy, double hw)
+ {
+  double px[4], py[4];
+  px[0] = x - dy*hw;         py[0] = y + dx*hw;
+  px[1] = px[0] + dx*hw;     py[1] = py[0] + dy*hw;
+  px[3] = x + dy*hw;         py[3] = y - dx*hw;
+  px[2] = px[3] + dx*hw;     py[2] = py[3] + dy*hw;
+  return raster_polygon(S, px, py, 4);
+ }
+
+// Stroke a polyline of n points in user coordinates. (dx,dy) gives the direction of a polyline of a single point.
+static int raster_StrokePolyline(raster_state *S, double *x, double *y, int n, int closed, double hw, double dx0, double dy0)
+ {
+  double px[4], py[4], dx, dy, l, nx0, ny0, nx1, ny1, cross, mx, my, ml, sgn, ax, ay, bx, by;
+  int    i, j, k, NSeg;
+
+  for (i=j=1; i<n; i++) if ((x[i]!=x[j-1]) || (y[i]!=y[j-1])) { x[j]=x[i]; y[j]=y[i]; j++; } // Remove repeated points
+  n = j;
+  if ((closed) && (n>1) && (x[n-1]==x[0]) && (y[n-1]==y[0])) n--;
+  if (n<1) return 0;
+  if (n==1) // Zero-length subpaths are painted only with round or square caps
+   {
+    if (S->gs.LineCap==1) return raster_circle(S, x[0], y[0], hw);
+    if (S->gs.LineCap==2) { l = hypot(dx0, dy0); if (l==0) { dx0=1; dy0=0; l=1; } return raster_SquareCap(S, x[0], y[0], dx0/l, dy0/l, hw) || raster_SquareCap(S, x[0], y[0], -dx0/l, -dy0/l, hw); }
+    return 0;
+   }
+  if (n==2) closed=0;
+  NSeg = closed ? n : (n-1);
+
+  for (i=0; i<NSeg; i++) // Segments
+   {
+    j = (i+1)%n;
+    dx = x[j]-x[i]; dy = y[j]-y[i]; l = hypot(dx, dy);
+    nx0 = -dy/l*hw; ny0 = dx/l*hw;
+    px[0]=x[i]+nx0; py[0]=y[i]+ny0; px[1]=x[j]+nx0; py[1]=y[j]+ny0;
+    px[2]=x[j]-nx0; py[2]=y[j]-ny0; px[3]=x[i]-nx0; py[3]=y[i]-ny0;
+    if (raster_polygon(S, px, py, 4)) return 1;
+   }
+
+  for (k=(closed?0:1); k<(closed?n:(n-1)); k++) // Joins
+   {
+    i = (k+n-1)%n; j = (k+1)%n;
+    if (S->gs.LineJoin==1) { if (raster_circle(S, x[k], y[k], hw)) return 1; continue; }
+    dx = x[k]-x[i]; dy = y[k]-y[i]; l = hypot(dx, dy); nx0 = -dy/l; ny0 = dx/l;
+    dx = x[j]-x[k]; dy = y[j]-y[k]; l = hypot(dx, dy); nx1 = -dy/l; ny1 = dx/l;
+    cross = ny0*nx1 - nx0*ny1; // z component of the cross product of the two segments' directions
+    if (fabs(cross)<1e-12) continue;
+    sgn = (cross>0) ? -1 : 1; // The join is needed on the outside of the turn
+    ax = x[k]+sgn*nx0*hw; ay = y[k]+sgn*ny0*hw;
+    bx = x[k]+sgn*nx1*hw; by = y[k]+sgn*ny1*hw;
+    mx = nx0+nx1; my = ny0+ny1; ml = hypot(mx, my); // ml/2 is the cosine of half the angle through which the path turns
+    px[0]=x[k]; py[0]=y[k]; px[1]=ax; py[1]=ay;
+    if ((S->gs.LineJoin==0) && (ml>1e-9) && (2/ml <= S->gs.MiterLimit))
+     {
+      px[2]=x[k]+sgn*mx/ml*hw*2/ml; py[2]=y[k]+sgn*my/ml*hw*2/ml;
+      px[3]=bx; py[3]=by;
+      if (raster_polygon(S, px, py, 4)) return 1;
+     }
+    else
+     {
+      px[2]=bx; py[2]=by;
+      if (raster_polygon(S, px, py, 3)) return 1;
+     }
+   }
+
+  if ((!closed) && (S->gs.LineCap!=0)) // Caps
+   {
+    if (S->gs.LineCap==1) return raster_circle(S, x[0], y[0], hw) || raster_circle(S, x[n-1], y[n-1], hw);
+    dx = x[1]-x[0]; dy = y[1]-y[0]; l = hypot(dx, dy);
+    if (raster_SquareCap(S, x[0], y[0], -dx/l, -dy/l, hw)) return 1;
+    dx = x[n-1]-x[n-2]; dy = y[n-1]-y[n-2]; l = hypot(dx, dy);
+    if (raster_SquareCap(S, x[n-1], y[n-1], dx/l, dy/l, hw)) return 1;
+   }
+  return 0;
+ }
+
+// Break a polyline into dashes, and stroke each. Points are appended to the workspace S->ux, S->uy from offset n0.
+static int raster_StrokeDashed(raster_state *S, double *x, double *y, int n, int closed, double hw, int n0)
+ {
+  double *d = S->gs.dash, period=0, offset, rem, t, step, l, dx, dy, ax, ay;
+  int     N = S->gs.NDash, k=0, on=1, i, NSeg, pn=0;
+  long    NDashes=0;
+
+  for (i=0; i<N; i++) period += d[i];
+  if (N%2) period*=2;
+  offset = fmod(S->gs.DashOffset, period);
+  if (offset<0) offset+=period;
+  rem = d[0];
+  while (offset>0)
+   {
+    if (offset<rem) { rem-=offset; break; }
+    offset -= rem;
+    k = (k+1)%N; on = !on; rem = d[k];
+   }
+
+#define DASH_POINT(X,Y) \
+  { \
+   if (n0+pn >= S->UAlloc) return raster_fail(S, "dash pattern too complicated"); \
+   S->ux[n0+pn] = (X); S->uy[n0+pn] = (Y); pn++; \
+  }
+
+  if (on) DASH_POINT(x[0], y[0]);
+  NSeg = closed ? n : (n-1);
+  dx = 1; dy = 0;
+  for (i=0; i<NSeg; i++)
+   {
+    ax = x[i]; ay = y[i];
+    dx = x[(i+1)%n]-ax; dy = y[(i+1)%n]-ay; l = hypot(dx, dy);
+    if (l==0) continue;
+    dx/=l; dy/=l; t=0;
+    while (1)
+     {
+      step = (rem < l-t) ? rem : (l-t);
+      t += step; rem -= step;
+      if (on && (step>0)) DASH_POINT(ax+dx*t, ay+dy*t);
+      if (rem>0) break;
+      if (on) { if (raster_StrokePolyline(S, S->ux+n0, S->uy+n0, pn, 0, hw, dx, dy)) return 1; pn=0; }
+      if (++NDashes > RASTER_MAXDASHES) return raster_fail(S, "dash pattern too fine"); // Also stops tiny dashes which no longer advance t from looping forever
+      k = (k+1)%N; on = !on; rem = d[k];
+      if (on) DASH_POINT(ax+dx*t, ay+dy*t);
+     }
+   }
+  if (on && (pn>0)) return raster_StrokePolyline(S, S->ux+n0, S->uy+n0, pn, 0, hw, dx, dy);
+  return 0;
+ }
+
+static int raster_stroke(raster_state *S)
+ {
+  raster_path *p = &S->gs.path;
+  double       inv[6], hw, scale;
+  int          s, e, i, n, need;
+
+  if (p->n<1) return 0;
+  if (raster_MatInvert(S->gs.ctm, inv)) return 0;
+  scale = sqrt(fabs(S->gs.ctm[0]*S->gs.ctm[3] - S->gs.ctm[1]*S->gs.ctm[2]));
+  hw    = fabs(S->gs.LineWidth)/2;
+  if (hw*scale < RASTER_MINWIDTH/2) hw = RASTER_MINWIDTH/2/scale;
+
+  need = 2*p->n + 2;
+  if (S->gs.NDash>0) need += 2*p->n + 64;
+  if (need > S->UAlloc)
+   {
+    if (S->ux!=NULL) free(S->ux);
+    if (S->uy!=NULL) free(S->uy);
+    S->ux = (double *)malloc(need*sizeof(double));
+    S->uy = (double *)malloc(need*sizeof(double));
+    if ((S->ux==NULL)||(S->uy==NULL)) { S->UAlloc=0; ppl_error(ERR_MEMORY, -1, -1, "Out of memory"); return raster_fail(S, "out of memory"); }
+    S->UAlloc = need;
+   }
+
+  raster_PathReset(&S->tmp);
+  for (s=0; s<p->n; s=e)
+   {
+    for (e=s+1; (e<p->n) && !(p->flag[e]&RP_MOVE); e++);
+    n = e-s;
+    for (i=0; i<n; i++) raster_transform(inv, p->x[s+i], p->y[s+i], S->ux+i, S->uy+i);
+    if (S->gs.NDash>0) { if (raster_StrokeDashed   (S, S->ux, S->uy, n, p->flag[s]&RP_CLOSED, hw, n)) return 1; }
+    else               { if (raster_StrokePolyline(S, S->ux, S->uy, n, p->flag[s]&RP_CLOSED, hw, 1, 0)) return 1; }
+    if (S->tmp.n > 65536) { if (raster_fill(S, &S->tmp, 0, NULL)) return 1; raster_PathReset(&S->tmp); } // Stop outlines of very long paths growing without limit
+   }
+  return raster_fill(S, &S->tmp, 0, NULL);
+ }
+
+// ----------------------------------------------------------------------------
+// Names, dictionaries and the operand stack
+// ----------------------------------------------------------------------------
+
+static ps_name *raster_name(raster_state *S, const char *text, int len)
+ {
+  unsigned int h=5381;
+  ps_name     *n;
+  int          i;
+  for (i=0; i<len; i++) h = h*33 + (unsigned char)text[i];
+  h &= RASTER_NAMEHASH-1;
+  for (n=S->names[h]; n!=NULL; n=n->next) if ((strncmp(n->text, text, len)==0) && (n->text[len]=='\0')) return n;
+  n = (ps_name *)lt_malloc(sizeof(ps_name));
+  if (n==NULL) { ppl_error(ERR_MEMORY, -1, -1, "Out of memory"); raster_fail(S, "out of memory"); return NULL; }
+  n->text = (char *)lt_malloc(len+1);
+  if (n->text==NULL) { ppl_error(ERR_MEMORY, -1, -1, "Out of memory"); raster_fail(S, "out of memory"); return NULL; }
+  memcpy(n->text, text, len);
+  n->text[len] = '\0';
+  n->next = S->names[h];
+  S->names[h] = n;
+  return n;
+ }
+
+static ps_dict *raster_DictNew(raster_state *S, int size)
+ {
+  ps_dict *d = (ps_dict *)lt_malloc(sizeof(ps_dict));
+  int      i;
+  if (d==NULL) { ppl_error(ERR_MEMORY, -1, -1, "Out of memory"); raster_fail(S, "out of memory"); return NULL; }
+  for (d->size=16; d->size<2*size; d->size*=2);
+  d->count = 0;
+  d->keys  = (ps_name  **)lt_malloc(d->size*sizeof(ps_name *));
+  d->vals  = (ps_object *)lt_malloc(d->size*sizeof(ps_object));
+  if ((d->keys==NULL)||(d->vals==NULL)) { ppl_error(ERR_MEMORY, -1, -1, "Out of memory"); raster_fail(S, "out of memory"); return NULL; }
+  for (i=0; i<d->size; i++) d->keys[i]=NULL;
+  return d;
+ }
+
+static int raster_DictSlot(ps_dict *d, ps_name *key)
+ {
+  int i = (int)((((unsigned long)key)>>3) * 2654435761UL) & (d->size-1);
+  while ((d->keys[i]!=NULL) && (d->keys[i]!=key)) i = (i+1) & (d->size-1);
+  return i;
+ }
+
+static ps_object *raster_DictGet(ps_dict *d, ps_name *key)
+ {
+  int i = raster_DictSlot(d, key);
+  return (d->keys[i]==NULL) ? NULL : (d->vals+i);
+ }
+
+static int raster_DictPut(raster_state *S, ps_dict *d, ps_name *key, ps_object *val)
+ {
+  int i = raster_DictSlot(d, key);
+  if (d->keys[i]==NULL)
+   {
+    if (2*(d->count+1) > d->size) // Grow table
+     {
+      ps_dict *n = raster_DictNew(S, d->size);
+      if (n==NULL) return 1;
+      for (i=0; i<d->size; i++) if (d->keys[i]!=NULL) { int j=raster_DictSlot(n, d->keys[i]); n->keys[j]=d->keys[i]; n->vals[j]=d->vals[i]; n->count++; }
+      *d = *n;
+      i = raster_DictSlot(d, key);
+     }
+    d->keys[i] = key;
+    d->count++;
+   }
+  d->vals[i] = *val;
+  return 0;
+ }
+
+static ps_object *raster_lookup(raster_state *S, ps_name *key, ps_dict **where)
+ {
+  ps_object *o;
+  int        i;
+  for (i=S->dsp-1; i>=0; i--) if ((o=raster_DictGet(S->dstack[i], key))!=NULL) { if (where!=NULL) *where=S->dstack[i]; return o; }
+  return NULL;
+ }
+
+static int raster_push(raster_state *S, ps_object *o)
+ {
+  if (S->sp>=RASTER_STACK) return raster_fail(S, "stack overflow");
+  S->stack[S->sp++] = *o;
+  return 0;
+ }
+
+static int raster_PushReal(raster_state *S, double r)
+ {
+  ps_object o;
+  o.type=PS_REAL; o.exec=0; o.len=0; o.u.r=r;
+  return raster_push(S, &o);
+ }
+
+static int raster_PushInt(raster_state *S, long i)
+ {
+  ps_object o;
+  o.type=PS_INT; o.exec=0; o.len=0; o.u.i=i;
+  return raster_push(S, &o);
+ }
+
+static int raster_PushBool(raster_state *S, int b)
+ {
+  ps_object o;
+  o.type=PS_BOOL; o.exec=0; o.len=0; o.u.i=(b!=0);
+  return raster_push(S, &o);
+ }
+
+static int raster_num(ps_object *o, double *out)
+ {
+  if      (o->type==PS_INT ) *out = o->u.i;
+  else if (o->type==PS_REAL) *out = o->u.r;
+  else return 1;
+  return 0;
+ }
+
+static int raster_PopNum(raster_state *S, double *out)
+ {
+  NEED(1);
+  if (raster_num(S->stack+S->sp-1, out)) return raster_fail(S, "number expected");
+  S->sp--;
+  return 0;
+ }
+
+static int raster_PopInt(raster_state *S, long *out)
+ {
+  NEED(1);
+  if      (S->stack[S->sp-1].type==PS_INT ) *out = S->stack[S->sp-1].u.i;
+  else if ((S->stack[S->sp-1].type==PS_REAL) && (S->stack[S->sp-1].u.r==floor(S->stack[S->sp-1].u.r)) && (fabs(S->stack[S->sp-1].u.r)<1e18)) *out = (long)S->stack[S->sp-1].u.r;
+  else return raster_fail(S, "integer expected");
+  S->sp--;
+  return 0;
+ }
+
+static int raster_PopType(raster_state *S, int type, ps_object *out)
+ {
+  NEED(1);
+  if (S->stack[S->sp-1].type!=type) return raster_fail(S, "typecheck");
+  *out = S->stack[--S->sp];
+  return 0;
+ }
+
+// Read a matrix from an array of six numbers
+static int raster_matrix(raster_state *S, ps_object *a, double *m)
+ {
+  int i;
+  if ((a->type!=PS_ARRAY) || (a->len!=6)) return raster_fail(S, "matrix expected");
+  for (i=0; i<6; i++) if (raster_num(a->u.a+i, m+i)) return raster_fail(S, "matrix expected");
+  return 0;
+ }
+
+// ----------------------------------------------------------------------------
+// Scanner
+// ----------------------------------------------------------------------------
+
+static int raster_ExecProc(raster_state *S, ps_object *proc);
+static int raster_exec    (raster_state *S, ps_object *o);
+
+// Decode ASCII85 data from the input, up to and including the ~> which ends it. The result is put in lt_malloced memory.
+static unsigned char *raster_A85(raster_state *S, long *OutLen)
+ {
+  unsigned char *in=S->in, *out;
+  unsigned long  v=0;
+  long           p, end, n=0;
+  int            k=0, i;
+  for (end=S->pos, i=0; (end<S->len) && (in[end]!='~'); end++) if (in[end]=='z') i++;
+  if (end>=S->len) { raster_fail(S, "unterminated ASCII85 data"); return NULL; }
+  out = (unsigned char *)lt_malloc((end-S->pos)/5*4 + 4*(long)i + 8);
+  if (out==NULL) { ppl_error(ERR_MEMORY, -1, -1, "Out of memory"); raster_fail(S, "out of memory"); return NULL; }
+  for (p=S->pos; p<end; p++)
+   {
+    if (isspace(in[p])) continue;
+    if ((in[p]=='z') && (k==0)) { out[n++]=0; out[n++]=0; out[n++]=0; out[n++]=0; continue; }
+    if ((in[p]<'!') || (in[p]>'u')) { raster_fail(S, "bad ASCII85 data"); return NULL; }
+    v = v*85 + (in[p]-'!');
+    if (++k==5) { for (i=3; i>=0; i--) out[n++] = (v>>(8*i)) & 0xff; v=0; k=0; }
+   }
+  if (k==1) { raster_fail(S, "bad ASCII85 data"); return NULL; }
+  if (k>1)
+   {
+    for (i=k; i<5; i++) v = v*85 + 84;
+    for (i=3; i>=5-k; i--) out[n++] = (v>>(8*i)) & 0xff;
+   }
+  S->pos = end+1;
+  if ((S->pos<S->len) && (in[S->pos]=='>')) S->pos++;
+  *OutLen = n;
+  return out;
+ }
+
+// Read the text of an embedded font, between %%BeginFont and %%EndFont
+static int raster_ReadFont(raster_state *S)
+ {
+  bmp_type1_font *f;
+  long            p, start;
+  for (start=S->pos; (start<S->len) && (S->in[start]!='\n') && (S->in[start]!='\r'); start++);
+  for (p=start; p+9<=S->len; p++) if ((S->in[p]=='%') && (strncmp((char *)S->in+p, "%%EndFont", 9)==0)) break;
+  if (p+9>S->len) return raster_fail(S, "unterminated font");
+  if ((f = bmp_type1_read(S->in+start, p-start))==NULL) return raster_fail(S, "could not read embedded font");
+  f->next  = S->fonts;
+  S->fonts = f;
+  S->pos   = p+9;
+  return 0;
+ }
+
+// Read the next token. Returns 0 at the end of the input, 1 if a token was read, 2 if a closing brace was read, or -1 on error
+static int raster_token(raster_state *S, ps_object *out)
+ {
+  unsigned char *in=S->in, *s;
+  long           p, start, n, alloc;
+  int            c, depth, i, status;
+  char          *end, tok[RASTER_TOKLEN];
+  ps_object      item, *items, *NewItems;
+
+  while (1) // Skip whitespace and comments
+   {
+    while ((S->pos<S->len) && (isspace(in[S->pos]) || (in[S->pos]=='\0'))) S->pos++;
+    if (S->pos>=S->len) return 0;
+    if (in[S->pos]!='%') break;
+    if ((S->pos+12<=S->len) && (strncmp((char *)in+S->pos, "%%BeginFont:", 12)==0)) { if (raster_ReadFont(S)) return -1; continue; }
+    while ((S->pos<S->len) && (in[S->pos]!='\n') && (in[S->pos]!='\r')) S->pos++;
+   }
+
+  out->exec = 0;
+  out->len  = 0;
+  c = in[S->pos];
+  if (c=='(') // String
+   {
+    s = (unsigned char *)lt_malloc(S->len - S->pos);
+    if (s==NULL) { ppl_error(ERR_MEMORY, -1, -1, "Out of memory"); raster_fail(S, "out of memory"); return -1; }
+    for (p=S->pos+1, n=0, depth=1; p<S->len; p++)
+     {
+      c = in[p];
+      if      (c=='(') depth++;
+      else if ((c==')') && (--depth==0)) break;
+      else if (c=='\\')
+       {
+        if (++p>=S->len) break;
+        c = in[p];
+        if      (c=='n') c='\n';
+        else if (c=='r') c='\r';
+        else if (c=='t') c='\t';
+        else if (c=='b') c='\b';
+        else if (c=='f') c='\f';
+        else if (c=='\n') continue;
+        else if (c=='\r') { if ((p+1<S->len) && (in[p+1]=='\n')) p++; continue; }
+        else if ((c>='0') && (c<='7'))
+         {
+          c-='0';
+          for (i=0; (i<2) && (p+1<S->len) && (in[p+1]>='0') && (in[p+1]<='7'); i++) c = c*8 + (in[++p]-'0');
+          c &= 0xff;
+         }
+       }
+      s[n++] = c;
+     }
+    if (p>=S->len) { raster_fail(S, "unterminated string"); return -1; }
+    S->pos = p+1;
+    out->type = PS_STRING; out->u.s = s; out->len = n;
+    return 1;
+   }
+  if (c=='<')
+   {
+    if ((S->pos+1<S->len) && (in[S->pos+1]=='<')) { S->pos+=2; out->type=PS_NAME; out->exec=1; out->u.name=raster_name(S, "<<", 2); return (out->u.name==NULL)?-1:1; }
+    if ((S->pos+1<S->len) && (in[S->pos+1]=='~')) // ASCII85 string
+     {
+      S->pos+=2;
+      if ((out->u.s = raster_A85(S, &n))==NULL) return -1;
+      out->type = PS_STRING; out->len = n;
+      return 1;
+     }
+    s = (unsigned char *)lt_malloc((S->len - S->pos)/2 + 1); // Hexadecimal string
+    if (s==NULL) { ppl_error(ERR_MEMORY, -1, -1, "Out of memory"); raster_fail(S, "out of memory"); return -1; }
+    for (p=S->pos+1, n=0, i=0; (p<S->len) && (in[p]!='>'); p++)
+     {
+      if (isspace(in[p])) continue;
+      if (!isxdigit(in[p])) { raster_fail(S, "bad hexadecimal string"); return -1; }
+      c = isdigit(in[p]) ? (in[p]-'0') : (tolower(in[p])-'a'+10);
+      if (i++%2==0) s[n  ]  = c<<4;
+      else          s[n++] |= c;
+     }
+    if (i%2) n++;
+    S->pos = p+1;
+    out->type = PS_STRING; out->u.s = s; out->len = n;
+    return 1;
+   }
+  if (c=='>')
+   {
+    if ((S->pos+1<S->len) && (in[S->pos+1]=='>')) { S->pos+=2; out->type=PS_NAME; out->exec=1; out->u.name=raster_name(S, ">>", 2); return (out->u.name==NULL)?-1:1; }
+    raster_fail(S, "syntax error"); return -1;
+   }
+  if ((c=='[') || (c==']'))
+   {
+    S->pos++; out->type=PS_NAME; out->exec=1; out->u.name=raster_name(S, (char *)in+S->pos-1, 1);
+    return (out->u.name==NULL)?-1:1;
+   }
+  if (c=='}') { S->pos++; return 2; }
+  if (c=='{') // Procedure
+   {
+    S->pos++;
+    items = NULL; n = alloc = 0;
+    while ((status = raster_token(S, &item))==1)
+     {
+      if (n>=alloc)
+       {
+        alloc    = (alloc<16) ? 16 : 2*alloc;
+        NewItems = (ps_object *)realloc(items, alloc*sizeof(ps_object));
+        if (NewItems==NULL) { free(items); ppl_error(ERR_MEMORY, -1, -1, "Out of memory"); raster_fail(S, "out of memory"); return -1; }
+        items = NewItems;
+       }
+      items[n++] = item;
+     }
+    if (status!=2) { if (items!=NULL) free(items); if (status==0) raster_fail(S, "unterminated procedure"); return -1; }
+    out->type = PS_ARRAY; out->exec = 1; out->len = n;
+    out->u.a  = (ps_object *)lt_malloc((n>0?n:1)*sizeof(ps_object));
+    if (out->u.a==NULL) { if (items!=NULL) free(items); ppl_error(ERR_MEMORY, -1, -1, "Out of memory"); raster_fail(S, "out of memory"); return -1; }
+    if (n>0) memcpy(out->u.a, items, n*sizeof(ps_object));
+    if (items!=NULL) free(items);
+    return 1;
+   }
+
+  // Names and numbers
+  start = S->pos;
+  if (c=='/') { S->pos++; if ((S->pos<S->len) && (in[S->pos]=='/')) S->pos++; }
+  for (p=S->pos; (p<S->len) && (!isspace(in[p])) && (in[p]!='\0') && (strchr("()<>[]{}/%", in[p])==NULL); p++);
+  n = p - S->pos;
+  if (n>=RASTER_TOKLEN) { raster_fail(S, "name too long"); return -1; }
+  memcpy(tok, in+S->pos, n); tok[n]='\0';
+  S->pos = p;
+  if (c=='/')
+   {
+    out->type = PS_NAME;
+    if ((out->u.name = raster_name(S, tok, n))==NULL) return -1;
+    if (S->pos-start-n == 2) // Immediately evaluated name
+     {
+      ps_object *v = raster_lookup(S, out->u.name, NULL);
+      if (v==NULL) { raster_fail(S, "undefined name"); return -1; }
+      *out = *v;
+     }
+    return 1;
+   }
+  if (n>0)
+   {
+    long l = strtol(tok, &end, 10);
+    if (*end=='\0') { out->type=PS_INT; out->u.i=l; return 1; }
+    if ((*end=='#') && (l>=2) && (l<=36)) { long r = strtol(end+1, &end, l); if (*end=='\0') { out->type=PS_INT; out->u.i=r; return 1; } }
+    out->u.r = strtod(tok, &end);
+    if ((*end=='\0') && (isdigit(tok[0]) || (tok[0]=='.') || (tok[0]=='-') || (tok[0]=='+'))) { out->type=PS_REAL; return 1; }
+   }
+  out->type = PS_NAME;
+  out->exec = 1;
+  if ((out->u.name = raster_name(S, tok, n))==NULL) return -1;
+  return 1;
+ }
+
+// ----------------------------------------------------------------------------
+// Execution
+// ----------------------------------------------------------------------------
+
+static int raster_ExecProc(raster_state *S, ps_object *proc)
+ {
+  ps_object *o;
+  int        i;
+  if (++S->depth > RASTER_EXECDEPTH) return raster_fail(S, "procedures nested too deeply");
+  for (i=0; (i<proc->len) && (!S->failed) && (!S->exiting); i++)
+   {
+    o = proc->u.a + i;
+    if (o->exec && ((o->type==PS_NAME) || (o->type==PS_OPERATOR))) raster_exec(S, o);
+    else                                                          raster_push(S, o);
+   }
+  S->depth--;
+  return S->failed;
+ }
+
+static int raster_exec(raster_state *S, ps_object *o)
+ {
+  ps_object *v;
+  if (o->type==PS_OPERATOR) return (*o->u.op->fn)(S);
+  if ((o->type==PS_ARRAY) && o->exec) return raster_ExecProc(S, o);
+  if ((o->type!=PS_NAME) || (!o->exec)) return raster_push(S, o);
+  if ((v = raster_lookup(S, o->u.name, NULL))==NULL)
+   {
+    if (DEBUG) { sprintf(temp_err_string, "Built-in rasteriser does not support the PostScript operator '%s'", o->u.name->text); ppl_log(temp_err_string); }
+    return raster_fail(S, "undefined name");
+   }
+  if  (v->type==PS_OPERATOR)            return (*v->u.op->fn)(S);
+  if ((v->type==PS_ARRAY) && v->exec)   return raster_ExecProc(S, v);
+  if ((v->type==PS_NAME ) && v->exec)   { int status; if (++S->depth > RASTER_EXECDEPTH) return raster_fail(S, "names nested too deeply"); status=raster_exec(S, v); S->depth--; return status; }
+  return raster_push(S, v);
+ }
+
+// Pop a procedure from the stack
+static int raster_PopProc(raster_state *S, ps_object *out)
+ {
+  NEED(1);
+  if ((S->stack[S->sp-1].type!=PS_ARRAY) || (!S->stack[S->sp-1].exec)) return raster_fail(S, "procedure expected");
+  *out = S->stack[--S->sp];
+  return 0;
+ }
+
+// ----------------------------------------------------------------------------
+// Operators: stack manipulation and arithmetic
+// ----------------------------------------------------------------------------
+
+static int op_pop  (raster_state *S) { NEED(1); S->sp--; return 0; }
+static int op_exch (raster_state *S) { ps_object t; NEED(2); t=S->stack[S->sp-1]; S->stack[S->sp-1]=S->stack[S->sp-2]; S->stack[S->sp-2]=t; return 0; }
+static int op_dup  (raster_state *S) { NEED(1); return raster_push(S, S->stack+S->sp-1); }
+static int op_clear(raster_state *S) { S->sp=0; return 0; }
+static int op_count(raster_state *S) { return raster_PushInt(S, S->sp); }
+static int op_mark (raster_state *S) { ps_object o; o.type=PS_MARK; o.exec=0; o.len=0; return raster_push(S, &o); }
+
+static int op_copy(raster_state *S)
+ {
+  long n, i;
+  if (raster_PopInt(S, &n)) return 1;
+  if ((n<0) || (n>S->sp)) return raster_fail(S, "rangecheck");
+  if (S->sp+n > RASTER_STACK) return raster_fail(S, "stack overflow");
+  for (i=0; i<n; i++) S->stack[S->sp+i] = S->stack[S->sp-n+i];
+  S->sp += n;
+  return 0;
+ }
+
+static int op_index(raster_state *S)
+ {
+  long n;
+  if (raster_PopInt(S, &n)) return 1;
+  if ((n<0) || (n>=S->sp)) return raster_fail(S, "rangecheck");
+  return raster_push(S, S->stack+S->sp-1-n);
+ }
+
+static int op_roll(raster_state *S)
+ {
+  long n, j, i;
+  ps_object tmp[RASTER_STACK];
+  if (raster_PopInt(S, &j) || raster_PopInt(S, &n)) return 1;
+  if ((n<0) || (n>S->sp)) return raster_fail(S, "rangecheck");
+  if (n==0) return 0;
+  j %= n; if (j<0) j+=n;
+  for (i=0; i<n; i++) tmp[(i+j)%n] = S->stack[S->sp-n+i];
+  memcpy(S->stack+S->sp-n, tmp, n*sizeof(ps_object));
+  return 0;
+ }
+
+static int raster_CountToMark(raster_state *S)
+ {
+  int i;
+  for (i=S->sp-1; i>=0; i--) if (S->stack[i].type==PS_MARK) return S->sp-1-i;
+  raster_fail(S, "unmatched mark");
+  return -1;
+ }
+
+static int op_counttomark(raster_state *S) { int n=raster_CountToMark(S); if (n<0) return 1; return raster_PushInt(S, n); }
+static int op_cleartomark(raster_state *S) { int n=raster_CountToMark(S); if (n<0) return 1; S->sp-=n+1; return 0; }
+
+// Binary arithmetic operators, which return integers when given integers whose result is small enough to be exact.
+// The size of the result is checked in floating point, so that the integer operation itself can never overflow.
+#define ARITH_OP(NAME, EXPR, INTEXPR) \
+static int NAME(raster_state *S) \
+ { \
+  double a, b; \
+  long   ia, ib; \
+  NEED(2); \
+  if ((S->stack[S->sp-1].type==PS_INT) && (S->stack[S->sp-2].type==PS_INT)) \
+   { \
+    ia = S->stack[S->sp-2].u.i; a = (double)ia; \
+    ib = S->stack[S->sp-1].u.i; b = (double)ib; \
+    if (fabs(EXPR)<1e15) { S->sp--; S->stack[S->sp-1].u.i = (INTEXPR); return 0; } \
+   } \
+  if (raster_PopNum(S, &b) || raster_PopNum(S, &a)) return 1; \
+  return raster_PushReal(S, (EXPR)); \
+ }
+
+ARITH_OP(op_add, a+b, ia+ib)
+ARITH_OP(op_sub, a-b, ia-ib)
+ARITH_OP(op_mul, a*b, ia*ib)
+
+static int op_div(raster_state *S)
+ {
+  double a, b;
+  if (raster_PopNum(S, &b) || raster_PopNum(S, &a)) return 1;
+  if (b==0) return raster_fail(S, "undefined result");
+  return raster_PushReal(S, a/b);
+ }
+
+static int op_idiv(raster_state *S)
+ {
+  long a, b;
+  if (raster_PopInt(S, &b) || raster_PopInt(S, &a)) return 1;
+  if (b==0) return raster_fail(S, "undefined result");
+  if ((a==LONG_MIN) && (b==-1)) return raster_fail(S, "integer overflow"); // Quotient does not fit in a long
+  return raster_PushInt(S, a/b);
+ }
+
+static int op_mod(raster_state *S)
+ {
+  long a, b;
+  if (raster_PopInt(S, &b) || raster_PopInt(S, &a)) return 1;
+  if (b==0) return raster_fail(S, "undefined result");
+  if ((a==LONG_MIN) && (b==-1)) return raster_fail(S, "integer overflow"); // Quotient does not fit in a long
+  return raster_PushInt(S, a%b);
+ }
+
+// Unary operators which return integers when given integers. LONG_MIN has no negation in a long, so is promoted to a real.
+#define UNARY_OP(NAME, EXPR, INTEXPR) \
+static int NAME(raster_state *S) \
+ { \
+  double a; \
+  NEED(1); \
+  if ((S->stack[S->sp-1].type==PS_INT) && (S->stack[S->sp-1].u.i!=LONG_MIN)) { long ia=S->stack[S->sp-1].u.i; S->stack[S->sp-1].u.i = (INTEXPR); return 0; } \
+  if (raster_PopNum(S, &a)) return 1; \
+  return raster_PushReal(S, (EXPR)); \
+ }
+
+UNARY_OP(op_neg     , -a      , -ia)
+UNARY_OP(op_abs     , fabs(a) , labs(ia))
+UNARY_OP(op_round   , floor(a+0.5), ia)
+UNARY_OP(op_floor   , floor(a), ia)
+UNARY_OP(op_ceiling , ceil(a) , ia)
+UNARY_OP(op_truncate, (a<0)?ceil(a):floor(a), ia)
+
+// Unary operators which always return reals
+#define REAL_OP(NAME, EXPR, CHECK) \
+static int NAME(raster_state *S) \
+ { \
+  double a; \
+  if (raster_PopNum(S, &a)) return 1; \
+  if (!(CHECK)) return raster_fail(S, "undefined result"); \
+  return raster_PushReal(S, (EXPR)); \
+ }
+
+REAL_OP(op_sqrt, sqrt(a)              , a>=0)
+REAL_OP(op_sin , sin(a*M_PI/180)      , 1)
+REAL_OP(op_cos , cos(a*M_PI/180)      , 1)
+REAL_OP(op_ln  , log(a)               , a>0)
+REAL_OP(op_log , log10(a)             , a>0)
+
+static int op_cvr(raster_state *S)
+ {
+  double a;
+  if (raster_PopNum(S, &a)) return 1;
+  return raster_PushReal(S, a);
+ }
+
+static int op_cvi(raster_state *S)
+ {
+  double a;
+  if (raster_PopNum(S, &a)) return 1;
+  a = (a<0)?ceil(a):floor(a);
+  if (!((a>=(double)LONG_MIN) && (a<(double)LONG_MAX))) return raster_fail(S, "rangecheck"); // Also catches NaN
+  return raster_PushInt(S, (long)a);
+ }
+
+static int op_atan(raster_state *S)
+ {
+  double num, den, a;
+  if (raster_PopNum(S, &den) || raster_PopNum(S, &num)) return 1;
+  if ((num==0) && (den==0)) return raster_fail(S, "undefined result");
+  a = atan2(num, den)*180/M_PI;
+  if (a<0) a+=360;
+  return raster_PushReal(S, a);
+ }
+
+static int op_exp(raster_state *S)
+ {
+  double base, ex;
+  if (raster_PopNum(S, &ex) || raster_PopNum(S, &base)) return 1;
+  return raster_PushReal(S, pow(base, ex));
+ }
+
+// ----------------------------------------------------------------------------
+// Operators: relational, boolean and control
+// ----------------------------------------------------------------------------
+
+static int raster_equal(ps_object *a, ps_object *b)
+ {
+  double x, y;
+  if ((raster_num(a, &x)==0) && (raster_num(b, &y)==0)) return x==y;
+  if ((a->type==PS_STRING) && (b->type==PS_STRING)) return (a->len==b->len) && (memcmp(a->u.s, b->u.s, a->len)==0);
+  if (a->type!=b->type) return 0;
+  switch (a->type)
+   {
+    case PS_NULL: case PS_MARK: return 1;
+    case PS_BOOL: return a->u.i==b->u.i;
+    case PS_NAME: return a->u.name==b->u.name;
+    case PS_ARRAY: return a->u.a==b->u.a;
+    case PS_DICT: return a->u.d==b->u.d;
+    case PS_OPERATOR: return a->u.op==b->u.op;
+    case PS_FONT: return a->u.font==b->u.font;
+    default: return 0;
+   }
+ }
+
+static int op_eq(raster_state *S) { int r; NEED(2); r=raster_equal(S->stack+S->sp-2, S->stack+S->sp-1); S->sp-=2; return raster_PushBool(S,  r); }
+static int op_ne(raster_state *S) { int r; NEED(2); r=raster_equal(S->stack+S->sp-2, S->stack+S->sp-1); S->sp-=2; return raster_PushBool(S, !r); }
+
+#define COMPARE_OP(NAME, OP) \
+static int NAME(raster_state *S) \
+ { \
+  double a, b; \
+  if (raster_PopNum(S, &b) || raster_PopNum(S, &a)) return 1; \
+  return raster_PushBool(S, a OP b); \
+ }
+
+COMPARE_OP(op_gt, > )
+COMPARE_OP(op_ge, >=)
+COMPARE_OP(op_lt, < )
+COMPARE_OP(op_le, <=)
+
+#define LOGIC_OP(NAME, OP) \
+static int NAME(raster_state *S) \
+ { \
+  ps_object *a, *b; \
+  NEED(2); \
+  a=S->stack+S->sp-2; b=S->stack+S->sp-1; \
+  if (((a->type!=PS_BOOL)&&(a->type!=PS_INT)) || (a->type!=b->type)) return raster_fail(S, "typecheck"); \
+  a->u.i = a->u.i OP b->u.i; \
+  S->sp--; \
+  return 0; \
+ }
+
+LOGIC_OP(op_and, &)
+LOGIC_OP(op_or , |)
+LOGIC_OP(op_xor, ^)
+
+static int op_not(raster_state *S)
+ {
+  NEED(1);
+  if      (S->stack[S->sp-1].type==PS_BOOL) S->stack[S->sp-1].u.i = !S->stack[S->sp-1].u.i;
+  else if (S->stack[S->sp-1].type==PS_INT ) S->stack[S->sp-1].u.i = ~S->stack[S->sp-1].u.i;
+  else return raster_fail(S, "typecheck");
+  return 0;
+ }
+
+static int op_if(raster_state *S)
+ {
+  ps_object proc, b;
+  if (raster_PopProc(S, &proc) || raster_PopType(S, PS_BOOL, &b)) return 1;
+  return b.u.i ? raster_ExecProc(S, &proc) : 0;
+ }
+
+static int op_ifelse(raster_state *S)
+ {
+  ps_object p1, p2, b;
+  if (raster_PopProc(S, &p2) || raster_PopProc(S, &p1) || raster_PopType(S, PS_BOOL, &b)) return 1;
+  return raster_ExecProc(S, b.u.i ? &p1 : &p2);
+ }
+
+// Run the body of a loop, returning non-zero if the loop should stop
+static int raster_LoopBody(raster_state *S, ps_object *proc)
+ {
+  raster_ExecProc(S, proc);
+  if (S->exiting) { S->exiting=0; return 1; }
+  return S->failed;
+ }
+
+static int op_repeat(raster_state *S)
+ {
+  ps_object proc;
+  long      n, i;
+  if (raster_PopProc(S, &proc) || raster_PopInt(S, &n)) return 1;
+  for (i=0; i<n; i++) if (raster_LoopBody(S, &proc)) break;
+  return S->failed;
+ }
+
+static int op_loop(raster_state *S)
+ {
+  ps_object proc;
+  long      i;
+  if (raster_PopProc(S, &proc)) return 1;
+  for (i=0; i<RASTER_MAXLOOP; i++) if (raster_LoopBody(S, &proc)) return S->failed;
+  return raster_fail(S, "loop does not terminate");
+ }
+
+static int op_for(raster_state *S)
+ {
+  ps_object proc;
+  double    init, inc, lim, v;
+  long      i, n;
+  int       ints;
+  if (raster_PopProc(S, &proc)) return 1;
+  NEED(3);
+  ints = (S->stack[S->sp-1].type==PS_INT) && (S->stack[S->sp-2].type==PS_INT) && (S->stack[S->sp-3].type==PS_INT);
+  if (raster_PopNum(S, &lim) || raster_PopNum(S, &inc) || raster_PopNum(S, &init)) return 1;
+  if (inc==0) return raster_fail(S, "for loop does not terminate");
+  for (n=0, v=init; (inc>0) ? (v<=lim) : (v>=lim); n++, v=init+n*inc)
+   {
+    if (n>=RASTER_MAXLOOP) return raster_fail(S, "for loop does not terminate");
+    if (ints) { i=(long)v; if (raster_PushInt(S, i)) return 1; }
+    else      { if (raster_PushReal(S, v)) return 1; }
+    if (raster_LoopBody(S, &proc)) break;
+   }
+  return S->failed;
+ }
+
+static int op_exit(raster_state *S) { S->exiting=1; return 0; }
+
+static int op_exec(raster_state *S)
+ {
+  ps_object o;
+  NEED(1);
+  o = S->stack[--S->sp];
+  if (o.exec) return raster_exec(S, &o);
+  return raster_push(S, &o);
+ }
+
+// ----------------------------------------------------------------------------
+// Operators: dictionaries, arrays and strings
+// ----------------------------------------------------------------------------
+
+static int raster_PushDict(raster_state *S, ps_dict *d)
+ {
+  ps_object o;
+  o.type=PS_DICT; o.exec=0; o.len=0; o.u.d=d;
+  return raster_push(S, &o);
+ }
+
+static int op_userdict   (raster_state *S) { return raster_PushDict(S, S->userdict); }
+static int op_systemdict (raster_state *S) { return raster_PushDict(S, S->systemdict); }
+static int op_currentdict(raster_state *S) { return raster_PushDict(S, S->dstack[S->dsp-1]); }
+static int op_countdictstack(raster_state *S) { return raster_PushInt(S, S->dsp); }
+
+static int op_dict(raster_state *S)
+ {
+  long     n;
+  ps_dict *d;
+  if (raster_PopInt(S, &n)) return 1;
+  if ((n<0) || (n>65536)) return raster_fail(S, "rangecheck");
+  if ((d = raster_DictNew(S, (int)n))==NULL) return 1;
+  return raster_PushDict(S, d);
+ }
+
+static int op_begin(raster_state *S)
+ {
+  ps_object d;
+  if (raster_PopType(S, PS_DICT, &d)) return 1;
+  if (S->dsp>=RASTER_DICTSTACK) return raster_fail(S, "dictionary stack overflow");
+  S->dstack[S->dsp++] = d.u.d;
+  return 0;
+ }
+
+static int op_end(raster_state *S)
+ {
+  if (S->dsp<=2) return raster_fail(S, "dictionary stack underflow");
+  S->dsp--;
+  return 0;
+ }
+
+static int op_def(raster_state *S)
+ {
+  NEED(2);
+  if (S->stack[S->sp-2].type!=PS_NAME) return raster_fail(S, "only names may be used as dictionary keys");
+  if (raster_DictPut(S, S->dstack[S->dsp-1], S->stack[S->sp-2].u.name, S->stack+S->sp-1)) return 1;
+  S->sp-=2;
+  return 0;
+ }
+
+static int op_store(raster_state *S)
+ {
+  ps_dict *d = S->dstack[S->dsp-1];
+  NEED(2);
+  if (S->stack[S->sp-2].type!=PS_NAME) return raster_fail(S, "only names may be used as dictionary keys");
+  raster_lookup(S, S->stack[S->sp-2].u.name, &d);
+  if (raster_DictPut(S, d, S->stack[S->sp-2].u.name, S->stack+S->sp-1)) return 1;
+  S->sp-=2;
+  return 0;
+ }
+
+static int op_load(raster_state *S)
+ {
+  ps_object k, *v;
+  if (raster_PopType(S, PS_NAME, &k)) return 1;
+  if ((v = raster_lookup(S, k.u.name, NULL))==NULL) return raster_fail(S, "undefined name");
+  return raster_push(S, v);
+ }
+
+static int op_where(raster_state *S)
+ {
+  ps_object k;
+  ps_dict  *d;
+  if (raster_PopType(S, PS_NAME, &k)) return 1;
+  if (raster_lookup(S, k.u.name, &d)==NULL) return raster_PushBool(S, 0);
+  if (raster_PushDict(S, d)) return 1;
+  return raster_PushBool(S, 1);
+ }
+
+static int op_known(raster_state *S)
+ {
+  ps_object k, d;
+  if (raster_PopType(S, PS_NAME, &k) || raster_PopType(S, PS_DICT, &d)) return 1;
+  return raster_PushBool(S, raster_DictGet(d.u.d, k.u.name)!=NULL);
+ }
+
+static int op_get(raster_state *S)
+ {
+  ps_object *c, *k, *v;
+  long       i;
+  NEED(2);
+  c = S->stack+S->sp-2; k = S->stack+S->sp-1;
+  if (c->type==PS_DICT)
+   {
+    if ((k->type!=PS_NAME) || ((v=raster_DictGet(c->u.d, k->u.name))==NULL)) return raster_fail(S, "undefined key");
+    S->sp-=2;
+    return raster_push(S, v);
+   }
+  if (raster_PopInt(S, &i)) return 1;
+  if ((i<0) || (i>=c->len)) return raster_fail(S, "rangecheck");
+  if (c->type==PS_ARRAY ) { S->sp--; return raster_push(S, c->u.a+i); }
+  if (c->type==PS_STRING) { S->sp--; return raster_PushInt(S, c->u.s[i]); }
+  return raster_fail(S, "typecheck");
+ }
+
+static int op_put(raster_state *S)
+ {
+  ps_object *c, *k, *v;
+  double     x;
+  NEED(3);
+  c = S->stack+S->sp-3; k = S->stack+S->sp-2; v = S->stack+S->sp-1;
+  if (c->type==PS_DICT)
+   {
+    if (k->type!=PS_NAME) return raster_fail(S, "only names may be used as dictionary keys");
+    if (raster_DictPut(S, c->u.d, k->u.name, v)) return 1;
+   }
+  else
+   {
+    if ((k->type!=PS_INT) || (k->u.i<0) || (k->u.i>=c->len)) return raster_fail(S, "rangecheck");
+    if      (c->type==PS_ARRAY ) c->u.a[k->u.i] = *v;
+    else if ((c->type==PS_STRING) && (raster_num(v, &x)==0)) c->u.s[k->u.i] = ((int)x) & 0xff;
+    else return raster_fail(S, "typecheck");
+   }
+  S->sp-=3;
+  return 0;
+ }
+
+static int op_length(raster_state *S)
+ {
+  ps_object o;
+  NEED(1);
+  o = S->stack[--S->sp];
+  if ((o.type==PS_ARRAY) || (o.type==PS_STRING)) return raster_PushInt(S, o.len);
+  if  (o.type==PS_DICT) return raster_PushInt(S, o.u.d->count);
+  if  (o.type==PS_NAME) return raster_PushInt(S, strlen(o.u.name->text));
+  return raster_fail(S, "typecheck");
+ }
+
+static int raster_NewArray(raster_state *S, int n, ps_object *out)
+ {
+  int i;
+  out->type=PS_ARRAY; out->exec=0; out->len=n;
+  out->u.a = (ps_object *)lt_malloc((n>0?n:1)*sizeof(ps_object));
+  if (out->u.a==NULL) { ppl_error(ERR_MEMORY, -1, -1, "Out of memory"); return raster_fail(S, "out of memory"); }
+  for (i=0; i<n; i++) { out->u.a[i].type=PS_NULL; out->u.a[i].exec=0; out->u.a[i].len=0; }
+  return 0;
+ }
+
+static int op_array(raster_state *S)
+ {
+  ps_object a;
+  long      n;
+  if (raster_PopInt(S, &n)) return 1;
+  if ((n<0) || (n>65536)) return raster_fail(S, "rangecheck");
+  if (raster_NewArray(S, n, &a)) return 1;
+  return raster_push(S, &a);
+ }
+
+static int op_ArrayEnd(raster_state *S) // ]
+ {
+  ps_object a;
+  int       n = raster_CountToMark(S);
+  if (n<0) return 1;
+  if (raster_NewArray(S, n, &a)) return 1;
+  if (n>0) memcpy(a.u.a, S->stack+S->sp-n, n*sizeof(ps_object));
+  S->sp -= n+1;
+  return raster_push(S, &a);
+ }
+
+static int op_DictEnd(raster_state *S) // >>
+ {
+  ps_dict *d;
+  int      n = raster_CountToMark(S), i;
+  if (n<0) return 1;
+  if (n%2) return raster_fail(S, "odd number of items in dictionary");
+  if ((d = raster_DictNew(S, n/2))==NULL) return 1;
+  for (i=S->sp-n; i<S->sp; i+=2)
+   {
+    if (S->stack[i].type!=PS_NAME) return raster_fail(S, "only names may be used as dictionary keys");
+    if (raster_DictPut(S, d, S->stack[i].u.name, S->stack+i+1)) return 1;
+   }
+  S->sp -= n+1;
+  return raster_PushDict(S, d);
+ }
+
+static int op_aload(raster_state *S)
+ {
+  ps_object a;
+  int       i;
+  if (raster_PopType(S, PS_ARRAY, &a)) return 1;
+  for (i=0; i<a.len; i++) if (raster_push(S, a.u.a+i)) return 1;
+  return raster_push(S, &a);
+ }
+
+static int op_astore(raster_state *S)
+ {
+  ps_object a;
+  if (raster_PopType(S, PS_ARRAY, &a)) return 1;
+  NEED(a.len);
+  memcpy(a.u.a, S->stack+S->sp-a.len, a.len*sizeof(ps_object));
+  S->sp -= a.len;
+  return raster_push(S, &a);
+ }
+
+static void raster_bind(raster_state *S, ps_object *proc, int depth)
+ {
+  ps_object *v;
+  int        i;
+  if (depth>RASTER_EXECDEPTH) return;
+  for (i=0; i<proc->len; i++)
+   {
+    ps_object *o = proc->u.a+i;
+    if      ((o->type==PS_NAME) && o->exec && ((v=raster_lookup(S, o->u.name, NULL))!=NULL) && (v->type==PS_OPERATOR)) *o = *v;
+    else if ((o->type==PS_ARRAY) && o->exec) raster_bind(S, o, depth+1);
+   }
+ }
+
+static int op_bind(raster_state *S)
+ {
+  NEED(1);
+  if ((S->stack[S->sp-1].type==PS_ARRAY) && S->stack[S->sp-1].exec) raster_bind(S, S->stack+S->sp-1, 0);
+  return 0;
+ }
+
+static int op_noop  (raster_state *S) { return 0; }
+static int op_cvx   (raster_state *S) { NEED(1); S->stack[S->sp-1].exec=1; return 0; }
+static int op_cvlit (raster_state *S) { NEED(1); S->stack[S->sp-1].exec=0; return 0; }
+static int op_xcheck(raster_state *S) { int x; NEED(1); x=S->stack[--S->sp].exec; return raster_PushBool(S, x); }
+static int op_pop1  (raster_state *S) { return op_pop(S); } // Operators whose arguments we ignore, such as setpagedevice
+
+static int op_cvn(raster_state *S)
+ {
+  ps_object s, n;
+  if (raster_PopType(S, PS_STRING, &s)) return 1;
+  if (s.len>=RASTER_TOKLEN) return raster_fail(S, "name too long");
+  n.type=PS_NAME; n.exec=s.exec; n.len=0;
+  if ((n.u.name = raster_name(S, (char *)s.u.s, s.len))==NULL) return 1;
+  return raster_push(S, &n);
+ }
+
+// ----------------------------------------------------------------------------
+// Operators: graphics state
+// ----------------------------------------------------------------------------
+
+static int raster_gsave(raster_state *S)
+ {
+  if (S->gsp>=RASTER_GSTACK) return raster_fail(S, "gsave nested too deeply");
+  S->gstack[S->gsp] = S->gs;
+  if (raster_PathCopy(S, &S->gstack[S->gsp].path, &S->gs.path)) return 1;
+  if (S->gs.clip!=NULL) S->gs.clip->refs++;
+  S->gsp++;
+  return 0;
+ }
+
+static int raster_grestore(raster_state *S)
+ {
+  if (S->gsp<=0) return 0;
+  raster_PathFree(&S->gs.path);
+  raster_ClipRelease(S->gs.clip);
+  S->gs = S->gstack[--S->gsp];
+  return 0;
+ }
+
+static int op_gsave   (raster_state *S) { return raster_gsave(S); }
+static int op_grestore(raster_state *S) { return raster_grestore(S); }
+
+static int op_save(raster_state *S)
+ {
+  ps_object o;
+  o.type=PS_SAVE; o.exec=0; o.len=0; o.u.i=S->gsp;
+  if (raster_gsave(S)) return 1;
+  return raster_push(S, &o);
+ }
+
+static int op_restore(raster_state *S)
+ {
+  ps_object o;
+  if (raster_PopType(S, PS_SAVE, &o)) return 1;
+  while (S->gsp > o.u.i) raster_grestore(S);
+  return 0;
+ }
+
+static int op_setlinewidth (raster_state *S) { return raster_PopNum(S, &S->gs.LineWidth); }
+static int op_setmiterlimit(raster_state *S) { return raster_PopNum(S, &S->gs.MiterLimit); }
+static int op_currentlinewidth(raster_state *S) { return raster_PushReal(S, S->gs.LineWidth); }
+
+static int op_setlinecap(raster_state *S)
+ {
+  long i;
+  if (raster_PopInt(S, &i)) return 1;
+  if ((i<0) || (i>2)) return raster_fail(S, "rangecheck");
+  S->gs.LineCap = (int)i;
+  return 0;
+ }
+
+static int op_setlinejoin(raster_state *S)
+ {
+  long i;
+  if (raster_PopInt(S, &i)) return 1;
+  if ((i<0) || (i>2)) return raster_fail(S, "rangecheck");
+  S->gs.LineJoin = (int)i;
+  return 0;
+ }
+
+static int op_setdash(raster_state *S)
+ {
+  ps_object a;
+  double    offset, total=0;
+  int       i;
+  if (raster_PopNum(S, &offset) || raster_PopType(S, PS_ARRAY, &a)) return 1;
+  if (a.len>RASTER_MAXDASH) return raster_fail(S, "dash pattern too long");
+  for (i=0; i<a.len; i++)
+   {
+    if (raster_num(a.u.a+i, S->gs.dash+i) || (S->gs.dash[i]<0)) return raster_fail(S, "rangecheck");
+    total += S->gs.dash[i];
+   }
+  S->gs.NDash      = (total>0) ? a.len : 0;
+  S->gs.DashOffset = offset;
+  return 0;
+ }
+
+static double raster_clamp(double x) { return (x<0) ? 0 : ((x>1) ? 1 : x); }
+
+static int op_setgray(raster_state *S)
+ {
+  double g;
+  if (raster_PopNum(S, &g)) return 1;
+  S->gs.rgb[0] = S->gs.rgb[1] = S->gs.rgb[2] = raster_clamp(g);
+  return 0;
+ }
+
+static int op_setrgbcolor(raster_state *S)
+ {
+  double r, g, b;
+  if (raster_PopNum(S, &b) || raster_PopNum(S, &g) || raster_PopNum(S, &r)) return 1;
+  S->gs.rgb[0] = raster_clamp(r); S->gs.rgb[1] = raster_clamp(g); S->gs.rgb[2] = raster_clamp(b);
+  return 0;
+ }
+
+static int op_setcmykcolor(raster_state *S)
+ {
+  double c, m, y, k;
+  if (raster_PopNum(S, &k) || raster_PopNum(S, &y) || raster_PopNum(S, &m) || raster_PopNum(S, &c)) return 1;
+  S->gs.rgb[0] = 1 - raster_clamp(c+k);
+  S->gs.rgb[1] = 1 - raster_clamp(m+k);
+  S->gs.rgb[2] = 1 - raster_clamp(y+k);
+  return 0;
+ }
+
+static int op_sethsbcolor(raster_state *S)
+ {
+  double h, s, b, f, p, q, t;
+  int    i;
+  if (raster_PopNum(S, &b) || raster_PopNum(S, &s) || raster_PopNum(S, &h)) return 1;
+  h = raster_clamp(h)*6; s = raster_clamp(s); b = raster_clamp(b);
+  i = (int)floor(h); f = h-i; if (i>=6) i=0;
+  p = b*(1-s); q = b*(1-s*f); t = b*(1-s*(1-f));
+  switch (i)
+   {
+    case 0 : S->gs.rgb[0]=b; S->gs.rgb[1]=t; S->gs.rgb[2]=p; break;
+    case 1 : S->gs.rgb[0]=q; S->gs.rgb[1]=b; S->gs.rgb[2]=p; break;
+    case 2 : S->gs.rgb[0]=p; S->gs.rgb[1]=b; S->gs.rgb[2]=t; break;
+    case 3 : S->gs.rgb[0]=p; S->gs.rgb[1]=q; S->gs.rgb[2]=b; break;
+    case 4 : S->gs.rgb[0]=t; S->gs.rgb[1]=p; S->gs.rgb[2]=b; break;
+    default: S->gs.rgb[0]=b; S->gs.rgb[1]=p; S->gs.rgb[2]=q; break;
+   }
+  return 0;
+ }
+
+static int op_currentrgbcolor(raster_state *S)
+ {
+  return raster_PushReal(S, S->gs.rgb[0]) || raster_PushReal(S, S->gs.rgb[1]) || raster_PushReal(S, S->gs.rgb[2]);
+ }
+
+static int op_currentgray(raster_state *S)
+ {
+  return raster_PushReal(S, 0.3*S->gs.rgb[0] + 0.59*S->gs.rgb[1] + 0.11*S->gs.rgb[2]);
+ }
+
+static int op_setcolorspace(raster_state *S)
+ {
+  ps_object o, *a;
+  long      n;
+  NEED(1);
+  o = S->stack[--S->sp];
+  if ((o.type==PS_ARRAY) && (o.len==1)) o = o.u.a[0];
+  S->gs.rgb[0] = S->gs.rgb[1] = S->gs.rgb[2] = 0;
+  if (o.type==PS_NAME)
+   {
+    if      (strcmp(o.u.name->text, "DeviceGray")==0) S->gs.ColourSpace = CS_GRAY;
+    else if (strcmp(o.u.name->text, "DeviceRGB" )==0) S->gs.ColourSpace = CS_RGB;
+    else if (strcmp(o.u.name->text, "DeviceCMYK")==0) S->gs.ColourSpace = CS_CMYK;
+    else return raster_fail(S, "unsupported colour space");
+    return 0;
+   }
+  if ((o.type!=PS_ARRAY) || (o.len!=4)) return raster_fail(S, "unsupported colour space");
+  a = o.u.a;
+  if ((a[0].type!=PS_NAME) || (strcmp(a[0].u.name->text, "Indexed")!=0)) return raster_fail(S, "unsupported colour space");
+  if ((a[1].type!=PS_NAME) || (strcmp(a[1].u.name->text, "DeviceRGB")!=0)) return raster_fail(S, "unsupported base for indexed colour space");
+  if (a[2].type!=PS_INT) return raster_fail(S, "typecheck");
+  n = a[2].u.i;
+  if ((n<0) || (n>255) || (a[3].type!=PS_STRING) || (a[3].len < 3*(n+1))) return raster_fail(S, "bad indexed colour space");
+  S->gs.ColourSpace = CS_INDEXED;
+  S->gs.hival       = (int)n;
+  S->gs.palette     = a[3].u.s;
+  S->gs.rgb[0] = a[3].u.s[0]/255.0; S->gs.rgb[1] = a[3].u.s[1]/255.0; S->gs.rgb[2] = a[3].u.s[2]/255.0;
+  return 0;
+ }
+
+// ----------------------------------------------------------------------------
+// Operators: coordinate transformations
+// ----------------------------------------------------------------------------
+
+static int raster_concat(raster_state *S, double *m)
+ {
+  raster_MatMul(m, S->gs.ctm, S->gs.ctm);
+  return 0;
+ }
+
+static int op_translate(raster_state *S)
+ {
+  double m[6]={1,0,0,1,0,0};
+  if (raster_PopNum(S, m+5) || raster_PopNum(S, m+4)) return 1;
+  return raster_concat(S, m);
+ }
+
+static int op_scale(raster_state *S)
+ {
+  double m[6]={1,0,0,1,0,0};
+  if (raster_PopNum(S, m+3) || raster_PopNum(S, m+0)) return 1;
+  return raster_concat(S, m);
+ }
+
+static int op_rotate(raster_state *S)
+ {
+  double m[6]={1,0,0,1,0,0}, a;
+  if (raster_PopNum(S, &a)) return 1;
+  a *= M_PI/180;
+  m[0] = cos(a); m[1] = sin(a); m[2] = -sin(a); m[3] = cos(a);
+  return raster_concat(S, m);
+ }
+
+static int op_concat(raster_state *S)
+ {
+  ps_object a;
+  double    m[6];
+  if (raster_PopType(S, PS_ARRAY, &a) || raster_matrix(S, &a, m)) return 1;
+  return raster_concat(S, m);
+ }
+
+static int op_matrix(raster_state *S)
+ {
+  ps_object a;
+  int       i;
+  if (raster_NewArray(S, 6, &a)) return 1;
+  for (i=0; i<6; i++) { a.u.a[i].type=PS_REAL; a.u.a[i].u.r = ((i==0)||(i==3)) ? 1 : 0; }
+  return raster_push(S, &a);
+ }
+
+static int op_currentmatrix(raster_state *S)
+ {
+  ps_object a;
+  int       i;
+  if (raster_PopType(S, PS_ARRAY, &a)) return 1;
+  if (a.len!=6) return raster_fail(S, "rangecheck");
+  for (i=0; i<6; i++) { a.u.a[i].type=PS_REAL; a.u.a[i].exec=0; a.u.a[i].u.r = S->gs.ctm[i]; }
+  return raster_push(S, &a);
+ }
+
+static int op_setmatrix(raster_state *S)
+ {
+  ps_object a;
+  if (raster_PopType(S, PS_ARRAY, &a)) return 1;
+  return raster_matrix(S, &a, S->gs.ctm);
+ }
+
+// ----------------------------------------------------------------------------
+// Operators: paths and painting
+// ----------------------------------------------------------------------------
+
+static int op_newpath(raster_state *S) { raster_PathReset(&S->gs.path); return 0; }
+static int op_closepath(raster_state *S) { raster_closepath(&S->gs.path); return 0; }
+
+static int op_moveto(raster_state *S)
+ {
+  double x, y;
+  if (raster_PopNum(S, &y) || raster_PopNum(S, &x)) return 1;
+  raster_transform(S->gs.ctm, x, y, &x, &y);
+  return raster_moveto(S, &S->gs.path, x, y);
+ }
+
+static int op_lineto(raster_state *S)
+ {
+  double x, y;
+  if (raster_PopNum(S, &y) || raster_PopNum(S, &x)) return 1;
+  raster_transform(S->gs.ctm, x, y, &x, &y);
+  return raster_lineto(S, &S->gs.path, x, y);
+ }
+
+static int op_rmoveto(raster_state *S)
+ {
+  double *m = S->gs.ctm, x, y;
+  if (raster_PopNum(S, &y) || raster_PopNum(S, &x)) return 1;
+  if (!S->gs.path.CurrentSet) return raster_fail(S, "no current point");
+  return raster_moveto(S, &S->gs.path, S->gs.path.cx + m[0]*x + m[2]*y, S->gs.path.cy + m[1]*x + m[3]*y);
+ }
+
+static int op_rlineto(raster_state *S)
+ {
+  double *m = S->gs.ctm, x, y;
+  if (raster_PopNum(S, &y) || raster_PopNum(S, &x)) return 1;
+  if (!S->gs.path.CurrentSet) return raster_fail(S, "no current point");
+  return raster_lineto(S, &S->gs.path, S->gs.path.cx + m[0]*x + m[2]*y, S->gs.path.cy + m[1]*x + m[3]*y);
+ }
+
+static int raster_CurveOp(raster_state *S, int relative)
+ {
+  double *m = S->gs.ctm, p[6], ox=0, oy=0;
+  int     i;
+  for (i=5; i>=0; i--) if (raster_PopNum(S, p+i)) return 1;
+  if (!S->gs.path.CurrentSet) return raster_fail(S, "no current point");
+  if (relative) { m = S->gs.ctm; ox = S->gs.path.cx - m[4]; oy = S->gs.path.cy - m[5]; }
+  for (i=0; i<6; i+=2) { raster_transform(m, p[i], p[i+1], p+i, p+i+1); p[i]+=ox; p[i+1]+=oy; }
+  return raster_curveto(S, &S->gs.path, p[0], p[1], p[2], p[3], p[4], p[5]);
+ }
+
+static int op_curveto (raster_state *S) { return raster_CurveOp(S, 0); }
+static int op_rcurveto(raster_state *S) { return raster_CurveOp(S, 1); }
+
+static int raster_ArcOp(raster_state *S, int dir)
+ {
+  double x, y, r, a1, a2;
+  if (raster_PopNum(S, &a2) || raster_PopNum(S, &a1) || raster_PopNum(S, &r) || raster_PopNum(S, &y) || raster_PopNum(S, &x)) return 1;
+  return raster_arc(S, x, y, r, a1, a2, dir);
+ }
+
+static int op_arc (raster_state *S) { return raster_ArcOp(S,  1); }
+static int op_arcn(raster_state *S) { return raster_ArcOp(S, -1); }
+
+static int op_currentpoint(raster_state *S)
+ {
+  double inv[6], x, y;
+  if (!S->gs.path.CurrentSet) return raster_fail(S, "no current point");
+  if (raster_MatInvert(S->gs.ctm, inv)) return raster_fail(S, "singular matrix");
+  raster_transform(inv, S->gs.path.cx, S->gs.path.cy, &x, &y);
+  return raster_PushReal(S, x) || raster_PushReal(S, y);
+ }
+
+static int op_fill  (raster_state *S) { if (raster_fill(S, &S->gs.path, 0, NULL)) return 1; raster_PathReset(&S->gs.path); return 0; }
+static int op_eofill(raster_state *S) { if (raster_fill(S, &S->gs.path, 1, NULL)) return 1; raster_PathReset(&S->gs.path); return 0; }
+static int op_stroke(raster_state *S) { if (raster_stroke(S)) return 1; raster_PathReset(&S->gs.path); return 0; }
+static int op_clip  (raster_state *S) { return raster_ClipPath(S, 0); }
+static int op_eoclip(raster_state *S) { return raster_ClipPath(S, 1); }
+static int op_initclip(raster_state *S) { raster_ClipRelease(S->gs.clip); S->gs.clip=NULL; return 0; }
+
+static int op_showpage(raster_state *S) { S->done=1; return 0; }
+
+// ----------------------------------------------------------------------------
+// Operators: fonts and text
+// ----------------------------------------------------------------------------
+
+static int raster_PushFont(raster_state *S, bmp_type1_font *t1, double *m)
+ {
+  ps_object o;
+  o.type=PS_FONT; o.exec=0; o.len=0;
+  o.u.font = (raster_font *)lt_malloc(sizeof(raster_font));
+  if (o.u.font==NULL) { ppl_error(ERR_MEMORY, -1, -1, "Out of memory"); return raster_fail(S, "out of memory"); }
+  o.u.font->t1 = t1;
+  memcpy(o.u.font->m, m, 6*sizeof(double));
+  return raster_push(S, &o);
+ }
+
+static bmp_type1_font *raster_FindFont(raster_state *S, ps_object *name)
+ {
+  bmp_type1_font *f;
+  char           *n;
+  if      (name->type==PS_NAME  ) n = name->u.name->text;
+  else if (name->type==PS_STRING) { ps_name *nn = raster_name(S, (char *)name->u.s, name->len); if (nn==NULL) return NULL; n = nn->text; }
+  else { raster_fail(S, "typecheck"); return NULL; }
+  for (f=S->fonts; f!=NULL; f=f->next) if (strcmp(f->FontName, n)==0) return f;
+  if (DEBUG) { sprintf(temp_err_string, "Built-in rasteriser cannot use font '%s', which is not embedded", n); ppl_log(temp_err_string); }
+  raster_fail(S, "font is not embedded");
+  return NULL;
+ }
+
+static int op_findfont(raster_state *S)
+ {
+  bmp_type1_font *f;
+  NEED(1);
+  if ((f = raster_FindFont(S, S->stack+S->sp-1))==NULL) return 1;
+  S->sp--;
+  return raster_PushFont(S, f, f->FontMatrix);
+ }
+
+static int op_scalefont(raster_state *S)
+ {
+  ps_object f;
+  double    s, m[6];
+  int       i;
+  if (raster_PopNum(S, &s) || raster_PopType(S, PS_FONT, &f)) return 1;
+  for (i=0; i<6; i++) m[i] = f.u.font->m[i]*s;
+  return raster_PushFont(S, f.u.font->t1, m);
+ }
+
+static int op_makefont(raster_state *S)
+ {
+  ps_object f, a;
+  double    m[6];
+  if (raster_PopType(S, PS_ARRAY, &a) || raster_matrix(S, &a, m) || raster_PopType(S, PS_FONT, &f)) return 1;
+  raster_MatMul(f.u.font->m, m, m);
+  return raster_PushFont(S, f.u.font->t1, m);
+ }
+
+static int op_setfont(raster_state *S)
+ {
+  ps_object f;
+  if (raster_PopType(S, PS_FONT, &f)) return 1;
+  S->gs.font = f.u.font;
+  return 0;
+ }
+
+static int op_selectfont(raster_state *S)
+ {
+  ps_object       *s;
+  bmp_type1_font  *f;
+  double           m[6], k;
+  int              i;
+  NEED(2);
+  s = S->stack+S->sp-1;
+  if ((f = raster_FindFont(S, S->stack+S->sp-2))==NULL) return 1;
+  if (raster_num(s, &k)==0) { for (i=0; i<6; i++) m[i] = f->FontMatrix[i]*k; }
+  else if (raster_matrix(S, s, m)==0) { raster_MatMul(f->FontMatrix, m, m); }
+  else return 1;
+  S->sp-=2;
+  if (raster_PushFont(S, f, m)) return 1;
+  return op_setfont(S);
+ }
+
+// Glyph outlines are received in character space, and mapped onto device space by the matrix G
+typedef struct raster_GlyphSink
+ {
+  raster_state *S;
+  double        G[6];
+ } raster_GlyphSink;
+
+static void raster_GlyphMoveto(void *arg, double x, double y)
+ {
+  raster_GlyphSink *g = (raster_GlyphSink *)arg;
+  raster_transform(g->G, x, y, &x, &y);
+  raster_moveto(g->S, &g->S->tmp, x, y);
+ }
+
+static void raster_GlyphLineto(void *arg, double x, double y)
+ {
+  raster_GlyphSink *g = (raster_GlyphSink *)arg;
+  raster_transform(g->G, x, y, &x, &y);
+  if (g->S->tmp.CurrentSet) raster_lineto(g->S, &g->S->tmp, x, y);
+ }
+
+static void raster_GlyphCurveto(void *arg, double x1, double y1, double x2, double y2, double x3, double y3)
+ {
+  raster_GlyphSink *g = (raster_GlyphSink *)arg;
+  raster_transform(g->G, x1, y1, &x1, &y1);
+  raster_transform(g->G, x2, y2, &x2, &y2);
+  raster_transform(g->G, x3, y3, &x3, &y3);
+  if (g->S->tmp.CurrentSet) raster_curveto(g->S, &g->S->tmp, x1, y1, x2, y2, x3, y3);
+ }
+
+static int op_show(raster_state *S)
+ {
+  ps_object        str;
+  raster_font     *f = S->gs.font;
+  raster_GlyphSink g;
+  bmp_type1_sink   sink;
+  double           wx, wy, cx, cy;
+  int              i;
+
+  if (raster_PopType(S, PS_STRING, &str)) return 1;
+  if (f==NULL) return raster_fail(S, "no current font");
+  if (!S->gs.path.CurrentSet) return raster_fail(S, "no current point");
+  g.S = S;
+  raster_MatMul(f->m, S->gs.ctm, g.G);
+  sink.arg = &g; sink.moveto = raster_GlyphMoveto; sink.lineto = raster_GlyphLineto; sink.curveto = raster_GlyphCurveto;
+  cx = S->gs.path.cx;
+  cy = S->gs.path.cy;
+  for (i=0; i<str.len; i++)
+   {
+    g.G[4] = cx + f->m[4]*S->gs.ctm[0] + f->m[5]*S->gs.ctm[2]; // Origin of glyph is the current point
+    g.G[5] = cy + f->m[4]*S->gs.ctm[1] + f->m[5]*S->gs.ctm[3];
+    raster_PathReset(&S->tmp);
+    if (bmp_type1_glyph(f->t1, str.u.s[i], &sink, &wx, &wy)) continue;
+    if (S->failed || raster_fill(S, &S->tmp, 0, NULL)) return 1;
+    cx += g.G[0]*wx + g.G[2]*wy;
+    cy += g.G[1]*wx + g.G[3]*wy;
+   }
+  return raster_moveto(S, &S->gs.path, cx, cy);
+ }
+
+static int op_stringwidth(raster_state *S)
+ {
+  ps_object    str;
+  raster_font *f = S->gs.font;
+  double       wx, wy, x=0, y=0;
+  int          i;
+  if (raster_PopType(S, PS_STRING, &str)) return 1;
+  if (f==NULL) return raster_fail(S, "no current font");
+  for (i=0; i<str.len; i++)
+   if (bmp_type1_glyph(f->t1, str.u.s[i], NULL, &wx, &wy)==0)
+    {
+     x += f->m[0]*wx + f->m[2]*wy;
+     y += f->m[1]*wx + f->m[3]*wy;
+    }
+  return raster_PushReal(S, x) || raster_PushReal(S, y);
+ }
+
+// ----------------------------------------------------------------------------
+// Operators: images
+// ----------------------------------------------------------------------------
+
+static int op_currentfile(raster_state *S)
+ {
+  ps_object o;
+  o.type=PS_FILE; o.exec=0; o.len=0; o.u.i=0;
+  return raster_push(S, &o);
+ }
+
+static int op_filter(raster_state *S)
+ {
+  ps_object n, f;
+  if (raster_PopType(S, PS_NAME, &n) || raster_PopType(S, PS_FILE, &f)) return 1;
+  if      ((strcmp(n.u.name->text, "ASCII85Decode")==0) && (f.u.i==0)) f.u.i |= PS_FILTER_A85;
+  else if ((strcmp(n.u.name->text, "FlateDecode"  )==0) && (f.u.i==PS_FILTER_A85)) f.u.i |= PS_FILTER_FLATE;
+  else return raster_fail(S, "unsupported filter");
+  return raster_push(S, &f);
+ }
+
+static ps_object *raster_DictKey(raster_state *S, ps_dict *d, char *key)
+ {
+  ps_name *n = raster_name(S, key, strlen(key));
+  if (n==NULL) return NULL;
+  return raster_DictGet(d, n);
+ }
+
+static int raster_DictInt(raster_state *S, ps_dict *d, char *key, long *out)
+ {
+  ps_object *o = raster_DictKey(S, d, key);
+  if ((o==NULL) || (o->type!=PS_INT)) return raster_fail(S, "bad image dictionary");
+  *out = o->u.i;
+  return 0;
+ }
+
+// Read sample i from a row of packed samples
+static unsigned int raster_sample(const unsigned char *row, long i, int bpc)
+ {
+  long bit;
+  if (bpc==8 ) return row[i];
+  if (bpc==16) return (row[2*i]<<8) | row[2*i+1];
+  bit = i*bpc;
+  return (row[bit>>3] >> (8 - bpc - (bit&7))) & ((1<<bpc)-1);
+ }
+
+static int op_image(raster_state *S)
+ {
+  ps_object      d, *o, *decode, *mask;
+  long           type, w, h, bpc, stride, need, n, i, j, x, y, k, filters, NMask=0;
+  unsigned char *data, *raw, *row, *px;
+  double         IM[6], inv[6], comb[6], dec[8], c[4], u, v, cx[4], cy[4], minx, maxx, miny, maxy, cov, fu, fv, col[4][3];
+  unsigned int   s[4], MaskLo[4], MaskHi[4];
+  int            NComp, interpolate=0, x0, x1, y0, y1, q, masked;
+  z_stream       zs;
+  raster_clip   *clip = S->gs.clip;
+
+  if (raster_PopType(S, PS_DICT, &d)) return raster_fail(S, "only the dictionary form of the image operator is supported");
+  if (raster_DictInt(S, d.u.d, "ImageType", &type) || raster_DictInt(S, d.u.d, "Width", &w) || raster_DictInt(S, d.u.d, "Height", &h) || raster_DictInt(S, d.u.d, "BitsPerComponent", &bpc)) return 1;
+  if (((type!=1)&&(type!=4)) || (w<1) || (h<1) || ((bpc!=1)&&(bpc!=2)&&(bpc!=4)&&(bpc!=8)&&(bpc!=16))) return raster_fail(S, "unsupported image");
+  if (((o = raster_DictKey(S, d.u.d, "ImageMatrix"))==NULL) || raster_matrix(S, o, IM)) return 1;
+  if (((o = raster_DictKey(S, d.u.d, "DataSource"))==NULL) || (o->type!=PS_FILE) || !(o->u.i & PS_FILTER_A85)) return raster_fail(S, "unsupported image data source");
+  filters = o->u.i;
+  if (((o = raster_DictKey(S, d.u.d, "Interpolate"))!=NULL) && (o->type==PS_BOOL)) interpolate = o->u.i;
+  switch (S->gs.ColourSpace)
+   {
+    case CS_GRAY: case CS_INDEXED: NComp=1; break;
+    case CS_RGB : NComp=3; break;
+    default     : NComp=4; break;
+   }
+  decode = raster_DictKey(S, d.u.d, "Decode");
+  for (k=0; k<NComp; k++)
+   {
+    dec[2*k] = 0; dec[2*k+1] = (S->gs.ColourSpace==CS_INDEXED) ? ((1<<bpc)-1) : 1;
+    if ((decode!=NULL) && (decode->type==PS_ARRAY) && (decode->len>=2*NComp)) { raster_num(decode->u.a+2*k, dec+2*k); raster_num(decode->u.a+2*k+1, dec+2*k+1); }
+   }
+  if ((type==4) && ((mask = raster_DictKey(S, d.u.d, "MaskColor"))!=NULL) && (mask->type==PS_ARRAY))
+   {
+    if      (mask->len==  NComp) { for (k=0; k<NComp; k++) { if (raster_num(mask->u.a+k, &u)) return 1; MaskLo[k]=MaskHi[k]=(unsigned int)u; } NMask=1; }
+    else if (mask->len==2*NComp) { for (k=0; k<NComp; k++) { if (raster_num(mask->u.a+2*k, &u) || raster_num(mask->u.a+2*k+1, &v)) return 1; MaskLo[k]=(unsigned int)u; MaskHi[k]=(unsigned int)v; } NMask=1; }
+   }
+
+  // Decode the image data which follows
+  stride = (w*NComp*bpc+7)/8;
+  need   = stride*h;
+  if ((raw = raster_A85(S, &n))==NULL) return 1;
+  if (filters & PS_FILTER_FLATE)
+   {
+    data = (unsigned char *)calloc(need, 1);
+    if (data==NULL) { ppl_error(ERR_MEMORY, -1, -1, "Out of memory"); return raster_fail(S, "out of memory"); }
+    zs.zalloc = Z_NULL; zs.zfree = Z_NULL; zs.opaque = Z_NULL;
+    zs.next_in = raw; zs.avail_in = n; zs.next_out = data; zs.avail_out = need;
+    if (inflateInit(&zs)!=Z_OK) { free(data); return raster_fail(S, "zlib error"); }
+    q = inflate(&zs, Z_FINISH);
+    inflateEnd(&zs);
+    if ((q!=Z_STREAM_END) && (q!=Z_OK) && (q!=Z_BUF_ERROR)) { free(data); return raster_fail(S, "corrupt image data"); }
+   }
+  else
+   {
+    data = (unsigned char *)calloc(need, 1);
+    if (data==NULL) { ppl_error(ERR_MEMORY, -1, -1, "Out of memory"); return raster_fail(S, "out of memory"); }
+    memcpy(data, raw, (n<need)?n:need);
+   }
+
+  // Map device pixels back onto the image
+  if (raster_MatInvert(S->gs.ctm, inv) || raster_MatInvert(IM, comb)) { free(data); return 0; }
+  raster_transform(comb, 0, 0, cx+0, cy+0); raster_transform(comb, w, 0, cx+1, cy+1);
+  raster_transform(comb, 0, h, cx+2, cy+2); raster_transform(comb, w, h, cx+3, cy+3);
+  for (k=0; k<4; k++) raster_transform(S->gs.ctm, cx[k], cy[k], cx+k, cy+k);
+  minx=maxx=cx[0]; miny=maxy=cy[0];
+  for (k=1; k<4; k++) { if (cx[k]<minx) minx=cx[k]; if (cx[k]>maxx) maxx=cx[k]; if (cy[k]<miny) miny=cy[k]; if (cy[k]>maxy) maxy=cy[k]; }
+  x0 = (minx<0) ? 0 : (int)floor(minx); x1 = (maxx>S->W) ? S->W : (int)ceil(maxx);
+  y0 = (miny<0) ? 0 : (int)floor(miny); y1 = (maxy>S->H) ? S->H : (int)ceil(maxy);
+  if (clip!=NULL) { if (x0<clip->x0) x0=clip->x0; if (x1>clip->x1) x1=clip->x1; if (y0<clip->y0) y0=clip->y0; if (y1>clip->y1) y1=clip->y1; }
+  raster_MatMul(inv, IM, comb);
+
+#define IMAGE_COLOUR(IX, IY, OUT) \
+  { \
+   row = data + (IY)*stride; \
+   for (k=0; k<NComp; k++) c[k] = dec[2*k] + raster_sample(row, (IX)*NComp+k, bpc) * (dec[2*k+1]-dec[2*k]) / ((1<<bpc)-1); \
+   switch (S->gs.ColourSpace) \
+    { \
+     case CS_GRAY   : OUT[0]=OUT[1]=OUT[2]=raster_clamp(c[0]); break; \
+     case CS_RGB    : OUT[0]=raster_clamp(c[0]); OUT[1]=raster_clamp(c[1]); OUT[2]=raster_clamp(c[2]); break; \
+     case CS_CMYK   : OUT[0]=1-raster_clamp(c[0]+c[3]); OUT[1]=1-raster_clamp(c[1]+c[3]); OUT[2]=1-raster_clamp(c[2]+c[3]); break; \
+     default        : q=(int)floor(c[0]+0.5); if (q<0) q=0; if (q>S->gs.hival) q=S->gs.hival; \
+                      OUT[0]=S->gs.palette[3*q]/255.0; OUT[1]=S->gs.palette[3*q+1]/255.0; OUT[2]=S->gs.palette[3*q+2]/255.0; break; \
+    } \
+  }
+
+  for (y=y0; y<y1; y++) for (x=x0; x<x1; x++)
+   {
+    raster_transform(comb, x+0.5, y+0.5, &u, &v);
+    if ((u<0) || (v<0) || (u>=w) || (v>=h)) continue;
+    i = (long)u; j = (long)v;
+    if (NMask)
+     {
+      row = data + j*stride;
+      for (masked=1, k=0; k<NComp; k++) { s[k] = raster_sample(row, i*NComp+k, bpc); if ((s[k]<MaskLo[k]) || (s[k]>MaskHi[k])) masked=0; }
+      if (masked) continue;
+     }
+    cov = (clip==NULL) ? 1 : (clip->mask[(long)y*S->W+x]/255.0);
+    if (cov<=0) continue;
+    if (interpolate && (S->gs.ColourSpace!=CS_INDEXED))
+     {
+      long ia, ib, ja, jb;
+      fu = u-0.5; fv = v-0.5;
+      ia = (long)floor(fu); ja = (long)floor(fv); fu -= ia; fv -= ja;
+      ib = (ia+1<w) ? (ia+1) : (w-1); jb = (ja+1<h) ? (ja+1) : (h-1);
+      if (ia<0) ia=0;
+      if (ja<0) ja=0;
+      IMAGE_COLOUR(ia, ja, col[0]); IMAGE_COLOUR(ib, ja, col[1]);
+      IMAGE_COLOUR(ia, jb, col[2]); IMAGE_COLOUR(ib, jb, col[3]);
+      for (k=0; k<3; k++) col[0][k] = (col[0][k]*(1-fu) + col[1][k]*fu)*(1-fv) + (col[2][k]*(1-fu) + col[3][k]*fu)*fv;
+     }
+    else IMAGE_COLOUR(i, j, col[0]);
+    px = S->pixels + 4*((long)y*S->W+x);
+    for (k=0; k<3; k++) px[k] = (unsigned char)(px[k] + (255*col[0][k]-px[k])*cov + 0.5);
+    px[3] = (unsigned char)(px[3] + (255-px[3])*cov + 0.5);
+   }
+  free(data);
+  return 0;
+ }
+
+// ----------------------------------------------------------------------------
+// Table of operators
+// ----------------------------------------------------------------------------
+
+static const ps_operator raster_operators[] = {
+ {"pop",op_pop}, {"exch",op_exch}, {"dup",op_dup}, {"copy",op_copy}, {"index",op_index}, {"roll",op_roll}, {"clear",op_clear},
+ {"count",op_count}, {"mark",op_mark}, {"[",op_mark}, {"<<",op_mark}, {"]",op_ArrayEnd}, {">>",op_DictEnd}, {"cleartomark",op_cleartomark},
+ {"counttomark",op_counttomark},
+ {"add",op_add}, {"sub",op_sub}, {"mul",op_mul}, {"div",op_div}, {"idiv",op_idiv}, {"mod",op_mod}, {"neg",op_neg}, {"abs",op_abs},
+ {"round",op_round}, {"floor",op_floor}, {"ceiling",op_ceiling}, {"truncate",op_truncate}, {"sqrt",op_sqrt}, {"sin",op_sin},
+ {"cos",op_cos}, {"atan",op_atan}, {"exp",op_exp}, {"ln",op_ln}, {"log",op_log}, {"cvi",op_cvi}, {"cvr",op_cvr},
+ {"eq",op_eq}, {"ne",op_ne}, {"gt",op_gt}, {"ge",op_ge}, {"lt",op_lt}, {"le",op_le}, {"and",op_and}, {"or",op_or}, {"xor",op_xor},
+ {"not",op_not},
+ {"if",op_if}, {"ifelse",op_ifelse}, {"repeat",op_repeat}, {"for",op_for}, {"loop",op_loop}, {"exit",op_exit}, {"exec",op_exec},
+ {"dict",op_dict}, {"begin",op_begin}, {"end",op_end}, {"def",op_def}, {"store",op_store}, {"load",op_load}, {"where",op_where},
+ {"known",op_known}, {"get",op_get}, {"put",op_put}, {"length",op_length}, {"array",op_array}, {"aload",op_aload},
+ {"astore",op_astore}, {"userdict",op_userdict}, {"systemdict",op_systemdict}, {"currentdict",op_currentdict},
+ {"countdictstack",op_countdictstack}, {"bind",op_bind}, {"readonly",op_noop}, {"executeonly",op_noop}, {"noaccess",op_noop},
+ {"cvx",op_cvx}, {"cvlit",op_cvlit}, {"xcheck",op_xcheck}, {"cvn",op_cvn},
+ {"save",op_save}, {"restore",op_restore}, {"gsave",op_gsave}, {"grestore",op_grestore}, {"showpage",op_showpage},
+ {"setpagedevice",op_pop1}, {"setstrokeadjust",op_pop1}, {"setoverprint",op_pop1}, {"setflat",op_pop1}, {"setsmoothness",op_pop1},
+ {"setlinewidth",op_setlinewidth}, {"currentlinewidth",op_currentlinewidth}, {"setlinecap",op_setlinecap},
+ {"setlinejoin",op_setlinejoin}, {"setmiterlimit",op_setmiterlimit}, {"setdash",op_setdash},
+ {"setgray",op_setgray}, {"setrgbcolor",op_setrgbcolor}, {"setcmykcolor",op_setcmykcolor}, {"sethsbcolor",op_sethsbcolor},
+ {"currentrgbcolor",op_currentrgbcolor}, {"currentgray",op_currentgray}, {"setcolorspace",op_setcolorspace},
+ {"translate",op_translate}, {"scale",op_scale}, {"rotate",op_rotate}, {"concat",op_concat}, {"matrix",op_matrix},
+ {"currentmatrix",op_currentmatrix}, {"setmatrix",op_setmatrix},
+ {"newpath",op_newpath}, {"moveto",op_moveto}, {"rmoveto",op_rmoveto}, {"lineto",op_lineto}, {"rlineto",op_rlineto},
+ {"curveto",op_curveto}, {"rcurveto",op_rcurveto}, {"arc",op_arc}, {"arcn",op_arcn}, {"closepath",op_closepath},
+ {"currentpoint",op_currentpoint}, {"fill",op_fill}, {"eofill",op_eofill}, {"stroke",op_stroke}, {"clip",op_clip},
+ {"eoclip",op_eoclip}, {"initclip",op_initclip},
+ {"findfont",op_findfont}, {"scalefont",op_scalefont}, {"makefont",op_makefont}, {"setfont",op_setfont},
+ {"selectfont",op_selectfont}, {"show",op_show}, {"stringwidth",op_stringwidth},
+ {"currentfile",op_currentfile}, {"filter",op_filter}, {"image",op_image},
+ {NULL,NULL}
+};
+
+// ----------------------------------------------------------------------------
+// Main entry point
+// ----------------------------------------------------------------------------
+
+static int raster_SetupDicts(raster_state *S)
+ {
+  ps_object o;
+  int       i;
+  if ((S->systemdict = raster_DictNew(S, 256))==NULL) return 1;
+  if ((S->userdict   = raster_DictNew(S, 256))==NULL) return 1;
+  o.exec=1; o.len=0; o.type=PS_OPERATOR;
+  for (i=0; raster_operators[i].name!=NULL; i++)
+   {
+    ps_name *n = raster_name(S, raster_operators[i].name, strlen(raster_operators[i].name));
+    if (n==NULL) return 1;
+    o.u.op = raster_operators + i;
+    if (raster_DictPut(S, S->systemdict, n, &o)) return 1;
+   }
+  o.exec=0;
+  o.type=PS_BOOL; o.u.i=1; if (raster_DictPut(S, S->systemdict, raster_name(S, "true" , 4), &o)) return 1;
+  o.type=PS_BOOL; o.u.i=0; if (raster_DictPut(S, S->systemdict, raster_name(S, "false", 5), &o)) return 1;
+  o.type=PS_NULL;          if (raster_DictPut(S, S->systemdict, raster_name(S, "null" , 4), &o)) return 1;
+  o.type=PS_INT ; o.u.i=2; if (raster_DictPut(S, S->systemdict, raster_name(S, "languagelevel", 13), &o)) return 1;
+  S->dstack[0] = S->systemdict;
+  S->dstack[1] = S->userdict;
+  S->dsp       = 2;
+  return 0;
+ }
+
+static void raster_free(raster_state *S)
+ {
+  while (S->gsp>0) raster_grestore(S);
+  raster_PathFree(&S->gs.path);
+  raster_ClipRelease(S->gs.clip);
+  raster_PathFree(&S->tmp);
+  if (S->acc   !=NULL) free(S->acc);
+  if (S->ux    !=NULL) free(S->ux);
+  if (S->uy    !=NULL) free(S->uy);
+  if (S->pixels!=NULL) free(S->pixels);
+  if (S->in    !=NULL) free(S->in);
+  free(S);
+ }
+
+// Render an EPS file, written by PyXPlot, to a PNG or JPEG file. Returns zero on success, or non-zero if the EPS file
+// contains PostScript which we cannot interpret, in which case no output is written and ghostscript should be used.
+int bmp_rasterise(char *EPSFilename, char *OutFilename, int format, double dpi, int antialias, int transparent, int invert)
+ {
+  raster_state  *S;
+  FILE          *f;
+  ps_object      o;
+  long           i, j, npx;
+  double         llx, lly, urx, ury, scale;
+  int            context, status, k, a;
+  char          *bb;
+  unsigned char *out, *px;
+
+  if ((S = (raster_state *)calloc(1, sizeof(raster_state)))==NULL) { ppl_error(ERR_MEMORY, -1, -1, "Out of memory"); return 1; }
+  if ((f = fopen(EPSFilename, "rb"))==NULL) { free(S); return 1; }
+  fseek(f, 0, SEEK_END);
+  S->len = ftell(f);
+  rewind(f);
+  S->in = (unsigned char *)malloc(S->len+1);
+  if ((S->in==NULL) || (fread(S->in, 1, S->len, f)!=S->len)) { fclose(f); raster_free(S); return 1; }
+  fclose(f);
+  S->in[S->len] = '\0';
+
+  // Page size is taken from the bounding box, as when ghostscript is run with -dEPSCrop
+  if (((bb = strstr((char *)S->in, "%%BoundingBox:"))==NULL) || (sscanf(bb+14, "%lf %lf %lf %lf", &llx, &lly, &urx, &ury)!=4)) { raster_free(S); return 1; }
+  scale = dpi/72;
+  S->W  = (int)floor((urx-llx)*scale + 0.5);
+  S->H  = (int)floor((ury-lly)*scale + 0.5);
+  if ((S->W<1) || (S->H<1) || ((double)S->W*S->H > RASTER_MAXPIXELS)) { raster_free(S); return 1; }
+  S->antialias = antialias;
+  npx = (long)S->W*S->H;
+  if ((S->pixels = (unsigned char *)malloc(4*npx))==NULL) { ppl_error(ERR_MEMORY, -1, -1, "Out of memory"); raster_free(S); return 1; }
+  memset(S->pixels, transparent ? 0 : 255, 4*npx);
+
+  S->gs.ctm[0] = scale; S->gs.ctm[1] = 0; S->gs.ctm[2] = 0; S->gs.ctm[3] = -scale;
+  S->gs.ctm[4] = -llx*scale; S->gs.ctm[5] = ury*scale;
+  S->gs.ColourSpace = CS_GRAY;
+  S->gs.LineWidth   = 1;
+  S->gs.MiterLimit  = 10;
+
+  // Interpret the PostScript
+  context = lt_DescendIntoNewContext();
+  if (raster_SetupDicts(S)==0)
+   while (!S->failed && !S->done)
+    {
+     status = raster_token(S, &o);
+     if      (status==0) break;
+     else if (status==2) raster_fail(S, "unmatched closing brace");
+     else if (status==1) { if (o.exec && (o.type==PS_NAME)) raster_exec(S, &o); else raster_push(S, &o); }
+     if (S->exiting) raster_fail(S, "exit outside of a loop");
+    }
+  lt_AscendOutOfContext(context);
+  if (S->failed) { raster_free(S); return 1; }
+
+  // Convert from premultiplied alpha, and write output
+  a   = transparent && (format==BMP_RASTER_PNG);
+  out = S->pixels; // Converted in place
+  for (i=j=0; i<npx; i++)
+   {
+    px = S->pixels + 4*i;
+    for (k=0; k<3; k++)
+     {
+      int c = px[k];
+      if (px[3]==0) c=0; else if (px[3]<255) { c = (c*255 + px[3]/2)/px[3]; if (c>255) c=255; }
+      if (!a) c = c + (255 - px[3]); // Composite onto white where no alpha channel is available
+      if (c>255) c=255;
+      if (invert) c = 255-c;
+      out[j++] = c;
+     }
+    if (a) out[j++] = px[3];
+   }
+  if (format==BMP_RASTER_PNG) status = bmp_pngwrite (OutFilename, out, S->W, S->H, a, dpi);
+  else                        status = bmp_jpegwrite(OutFilename, out, S->W, S->H, 100, dpi);
+  raster_free(S);
+  return status;
+ }
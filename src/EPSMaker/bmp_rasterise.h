@@ -0,0 +1,34 @@
+// bmp_rasterise.h
+//
+// The code in this file is part of PyXPlot
+// <http://www.pyxplot.org.uk>
+//
+// Copyright (C) 2006-2011 Dominic Ford <coders@pyxplot.org.uk>
+//               2008-2011 Ross Church
+//
+// $Id$
+//
+// PyXPlot is free software; you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation; either version 2 of the License, or (at your option) any later
+// version.
+//
+// You should have received a copy of the GNU General Public License along with
+// PyXPlot; if not, write to the Free Software Foundation, Inc., 51 Franklin
+// Street, Fifth Floor, Boston, MA  02110-1301, USA
+
+// ----------------------------------------------------------------------------
+
+// Built-in rasteriser, which turns PyXPlot's own EPS output into PNG and JPEG
+// images without the help of ghostscript
+
+#ifndef _PPL_BMP_RASTERISE_H
+#define _PPL_BMP_RASTERISE_H 1
+
+#define BMP_RASTER_PNG 1
+#define BMP_RASTER_JPG 2
+
+int bmp_rasterise(char *EPSFilename, char *OutFilename, int format, double dpi, int antialias, int transparent, int invert);
+
+#endif
+
@@ -0,0 +1,497 @@
+// bmp_type1.c
+//
+// The code in this file is part of PyXPlot
+// <http://www.pyxplot.org.uk>
+//
+// Copyright (C) 2006-2011 Dominic Ford <coders@pyxplot.org.uk>
+//               2008-2011 Ross Church
+//
+// $Id$
+//
+// PyXPlot is free software; you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation; either version 2 of the License, or (at your option) any later
+// version.
+//
+// You should have received a copy of the GNU General Public License along with
+// PyXPlot; if not, write to the Free Software Foundation, Inc., 51 Franklin
+// Street, Fifth Floor, Boston, MA  02110-1301, USA
+
+// ----------------------------------------------------------------------------
+
+// Functions for reading Type 1 fonts embedded in PFA format, and for turning
+// their charstrings into glyph outlines for the built-in rasteriser. Rather
+// than executing the PostScript of the font program, the cleartext and eexec
+// sections are scanned for the handful of entries which a rasteriser needs,
+// in the layout which the Type 1 specification prescribes.
+
+#define _PPL_BMP_TYPE1_C 1
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "ListTools/lt_memory.h"
+
+#include "ppl_error.h"
+
+#include "bmp_type1.h"
+
+// Limits upon charstring interpretation, taken from the Type 1 font format specification
+#define T1_STACK      24
+#define T1_PSSTACK    16
+#define T1_SUBR_DEPTH 10
+#define T1_FLEX        7
+#define T1_TOKLEN    256
+
+// The Adobe StandardEncoding, used by fonts which do not define an encoding of their own, and by the seac operator
+static const struct { int code; char *name; } StandardEncoding[] = {
+ { 32,"space"},{ 33,"exclam"},{ 34,"quotedbl"},{ 35,"numbersign"},{ 36,"dollar"},{ 37,"percent"},{ 38,"ampersand"},{ 39,"quoteright"},
+ { 40,"parenleft"},{ 41,"parenright"},{ 42,"asterisk"},{ 43,"plus"},{ 44,"comma"},{ 45,"hyphen"},{ 46,"period"},{ 47,"slash"},
+ { 48,"zero"},{ 49,"one"},{ 50,"two"},{ 51,"three"},{ 52,"four"},{ 53,"five"},{ 54,"six"},{ 55,"seven"},{ 56,"eight"},{ 57,"nine"},
+ { 58,"colon"},{ 59,"semicolon"},{ 60,"less"},{ 61,"equal"},{ 62,"greater"},{ 63,"question"},{ 64,"at"},
+ { 65,"A"},{ 66,"B"},{ 67,"C"},{ 68,"D"},{ 69,"E"},{ 70,"F"},{ 71,"G"},{ 72,"H"},{ 73,"I"},{ 74,"J"},{ 75,"K"},{ 76,"L"},{ 77,"M"},
+ { 78,"N"},{ 79,"O"},{ 80,"P"},{ 81,"Q"},{ 82,"R"},{ 83,"S"},{ 84,"T"},{ 85,"U"},{ 86,"V"},{ 87,"W"},{ 88,"X"},{ 89,"Y"},{ 90,"Z"},
+ { 91,"bracketleft"},{ 92,"backslash"},{ 93,"bracketright"},{ 94,"asciicircum"},{ 95,"underscore"},{ 96,"quoteleft"},
+ { 97,"a"},{ 98,"b"},{ 99,"c"},{100,"d"},{101,"e"},{102,"f"},{103,"g"},{104,"h"},{105,"i"},{106,"j"},{107,"k"},{108,"l"},{109,"m"},
+ {110,"n"},{111,"o"},{112,"p"},{113,"q"},{114,"r"},{115,"s"},{116,"t"},{117,"u"},{118,"v"},{119,"w"},{120,"x"},{121,"y"},{122,"z"},
+ {123,"braceleft"},{124,"bar"},{125,"braceright"},{126,"asciitilde"},
+ {161,"exclamdown"},{162,"cent"},{163,"sterling"},{164,"fraction"},{165,"yen"},{166,"florin"},{167,"section"},{168,"currency"},
+ {169,"quotesingle"},{170,"quotedblleft"},{171,"guillemotleft"},{172,"guilsinglleft"},{173,"guilsinglright"},{174,"fi"},{175,"fl"},
+ {177,"endash"},{178,"dagger"},{179,"daggerdbl"},{180,"periodcentered"},{182,"paragraph"},{183,"bullet"},{184,"quotesinglbase"},
+ {185,"quotedblbase"},{186,"quotedblright"},{187,"guillemotright"},{188,"ellipsis"},{189,"perthousand"},{191,"questiondown"},
+ {193,"grave"},{194,"acute"},{195,"circumflex"},{196,"tilde"},{197,"macron"},{198,"breve"},{199,"dotaccent"},{200,"dieresis"},
+ {202,"ring"},{203,"cedilla"},{205,"hungarumlaut"},{206,"ogonek"},{207,"caron"},{208,"emdash"},{225,"AE"},{227,"ordfeminine"},
+ {232,"Lslash"},{233,"Oslash"},{234,"OE"},{235,"ordmasculine"},{241,"ae"},{245,"dotlessi"},{248,"lslash"},{249,"oslash"},
+ {250,"oe"},{251,"germandbls"},{-1,NULL}
+};
+
+static char *t1_StandardName(int code)
+ {
+  int i;
+  for (i=0; StandardEncoding[i].name!=NULL; i++) if (StandardEncoding[i].code==code) return StandardEncoding[i].name;
+  return NULL;
+ }
+
+// Return the position of the first occurrence of key within in[from...len-1], or -1
+static long t1_find(unsigned char *in, long len, long from, char *key)
+ {
+  long i, l=strlen(key);
+  for (i=from; i+l<=len; i++) if ((in[i]==key[0]) && (memcmp(in+i, key, l)==0)) return i;
+  return -1;
+ }
+
+// Read the next PostScript token from in[*p...], skipping whitespace and comments. Returns zero at the end of the text.
+static int t1_token(unsigned char *in, long len, long *p, char *tok)
+ {
+  int i=0;
+  while (*p<len)
+   {
+    if      (isspace(in[*p])) (*p)++;
+    else if (in[*p]=='%') { while ((*p<len)&&(in[*p]!='\n')&&(in[*p]!='\r')) (*p)++; }
+    else break;
+   }
+  if (*p>=len) return 0;
+  if (strchr("[]{}", in[*p])!=NULL) { tok[i++]=in[(*p)++]; tok[i]='\0'; return 1; }
+  if (in[*p]=='/') tok[i++]=in[(*p)++];
+  while ((*p<len) && (!isspace(in[*p])) && (strchr("()<>[]{}/%", in[*p])==NULL))
+   {
+    if (i<T1_TOKLEN-1) tok[i++]=in[*p];
+    (*p)++;
+   }
+  tok[i]='\0';
+  return 1;
+ }
+
+// Decrypt eexec or charstring encrypted data, discarding the first skip bytes of plaintext
+static unsigned char *t1_decrypt(unsigned char *in, long len, unsigned short r, int skip, long *OutLen)
+ {
+  unsigned char *out;
+  long i;
+  if (skip<0) skip=0;
+  if (len<skip) return NULL;
+  out = (unsigned char *)lt_malloc(len-skip+1);
+  if (out==NULL) { ppl_error(ERR_MEMORY, -1, -1, "Out of memory"); return NULL; }
+  for (i=0; i<len; i++)
+   {
+    if (i>=skip) out[i-skip] = in[i] ^ (r>>8);
+    r = (unsigned short)((in[i] + r) * 52845 + 22719);
+   }
+  *OutLen = len-skip;
+  return out;
+ }
+
+// Read one charstring or subroutine, whose length and RD token are expected at in[*p]
+static int t1_ReadCharString(unsigned char *in, long len, long *p, int lenIV, bmp_type1_charstring *out)
+ {
+  char tok[T1_TOKLEN];
+  long n, l;
+  if (!t1_token(in, len, p, tok)) return 1;
+  n = strtol(tok, NULL, 10);
+  if (!t1_token(in, len, p, tok)) return 1; // RD or -|
+  (*p)++; // A single space separates the RD token from the binary data
+  if ((n<0) || (*p+n>len)) return 1;
+  if (lenIV<0) { out->data = in + *p; out->len = n; }
+  else
+   {
+    out->data = t1_decrypt(in + *p, n, 4330, lenIV, &l);
+    if (out->data==NULL) return 1;
+    out->len = l;
+   }
+  *p += n;
+  return 0;
+ }
+
+static int t1_GlyphCmp(const void *a, const void *b)
+ {
+  return strcmp(((const bmp_type1_charstring *)a)->name, ((const bmp_type1_charstring *)b)->name);
+ }
+
+static int t1_lookup(bmp_type1_font *font, char *name)
+ {
+  bmp_type1_charstring key, *item;
+  if (name==NULL) return -1;
+  key.name = name;
+  item = (bmp_type1_charstring *)bsearch(&key, font->glyphs, font->NGlyphs, sizeof(bmp_type1_charstring), t1_GlyphCmp);
+  if (item==NULL) return -1;
+  return item - font->glyphs;
+ }
+
+// Read a Type 1 font from the text of a PFA file. Returns NULL if the font cannot be understood.
+bmp_type1_font *bmp_type1_read(unsigned char *in, long len)
+ {
+  bmp_type1_font *font;
+  char            tok[T1_TOKLEN], *EncNames[256];
+  unsigned char  *cipher, *priv;
+  long            p, eexec, PrivLen, CipherLen, cs;
+  int             i, j, n, lenIV=4, hex=1;
+
+  font = (bmp_type1_font *)lt_malloc(sizeof(bmp_type1_font));
+  if (font==NULL) { ppl_error(ERR_MEMORY, -1, -1, "Out of memory"); return NULL; }
+  font->FontName = NULL;
+  font->NSubrs = font->NGlyphs = 0;
+  font->subrs  = font->glyphs  = NULL;
+  font->next   = NULL;
+  for (i=0; i<256; i++) { EncNames[i]=NULL; font->encoding[i]=-1; }
+  font->FontMatrix[0]=0.001; font->FontMatrix[1]=0; font->FontMatrix[2]=0; font->FontMatrix[3]=0.001; font->FontMatrix[4]=0; font->FontMatrix[5]=0;
+
+  // Cleartext section: FontName, FontMatrix and Encoding
+  if ((eexec = t1_find(in, len, 0, "eexec"))<0) return NULL;
+  if ((p = t1_find(in, eexec, 0, "/FontName"))<0) return NULL;
+  p+=9;
+  if ((!t1_token(in, eexec, &p, tok)) || (tok[0]!='/')) return NULL;
+  font->FontName = (char *)lt_malloc(strlen(tok));
+  if (font->FontName==NULL) { ppl_error(ERR_MEMORY, -1, -1, "Out of memory"); return NULL; }
+  strcpy(font->FontName, tok+1);
+
+  if ((p = t1_find(in, eexec, 0, "/FontMatrix"))>=0)
+   {
+    p+=11;
+    t1_token(in, eexec, &p, tok);
+    for (i=0; i<6; i++) { if (!t1_token(in, eexec, &p, tok)) return NULL; font->FontMatrix[i] = strtod(tok, NULL); }
+   }
+
+  if ((p = t1_find(in, eexec, 0, "/Encoding"))>=0)
+   {
+    p+=9;
+    if (!t1_token(in, eexec, &p, tok)) return NULL;
+    if (strcmp(tok, "StandardEncoding")==0)
+     { for (i=0; StandardEncoding[i].name!=NULL; i++) EncNames[StandardEncoding[i].code] = StandardEncoding[i].name; }
+    else
+     {
+      while (t1_token(in, eexec, &p, tok) && (strcmp(tok, "def")!=0))
+       if (strcmp(tok, "dup")==0)
+        {
+         if (!t1_token(in, eexec, &p, tok)) break;
+         j = (int)strtol(tok, NULL, 10);
+         if (!t1_token(in, eexec, &p, tok)) break;
+         if ((j<0) || (j>255) || (tok[0]!='/')) continue;
+         EncNames[j] = (char *)lt_malloc(strlen(tok));
+         if (EncNames[j]==NULL) { ppl_error(ERR_MEMORY, -1, -1, "Out of memory"); return NULL; }
+         strcpy(EncNames[j], tok+1);
+        }
+     }
+   }
+
+  // The eexec section may be either hexadecimal or binary
+  p = eexec+5;
+  while ((p<len) && isspace(in[p])) p++;
+  for (i=0; i<4; i++) if ((p+i>=len) || (!isxdigit(in[p+i]))) hex=0;
+  if (hex)
+   {
+    cipher = (unsigned char *)lt_malloc((len-p)/2+1);
+    if (cipher==NULL) { ppl_error(ERR_MEMORY, -1, -1, "Out of memory"); return NULL; }
+    for (CipherLen=0, n=-1; p<len; p++)
+     {
+      if      (isspace(in[p])) continue;
+      else if (!isxdigit(in[p])) break;
+      j = isdigit(in[p]) ? (in[p]-'0') : (tolower(in[p])-'a'+10);
+      if (n<0) n=j;
+      else     { cipher[CipherLen++] = (n<<4) | j; n=-1; }
+     }
+   }
+  else
+   {
+    cipher    = in+p;
+    CipherLen = len-p;
+   }
+  if ((priv = t1_decrypt(cipher, CipherLen, 55665, 4, &PrivLen))==NULL) return NULL;
+
+  // Private dictionary: lenIV, Subrs and CharStrings
+  if ((cs = t1_find(priv, PrivLen, 0, "/CharStrings"))<0) return NULL;
+  if ((p = t1_find(priv, cs, 0, "/lenIV"))>=0) { p+=6; if (t1_token(priv, cs, &p, tok)) lenIV = (int)strtol(tok, NULL, 10); }
+  if ((p = t1_find(priv, cs, 0, "/Subrs"))>=0)
+   {
+    p+=6;
+    if (!t1_token(priv, PrivLen, &p, tok)) return NULL;
+    n = (int)strtol(tok, NULL, 10);
+    if (n>0)
+     {
+      font->subrs = (bmp_type1_charstring *)lt_malloc(n*sizeof(bmp_type1_charstring));
+      if (font->subrs==NULL) { ppl_error(ERR_MEMORY, -1, -1, "Out of memory"); return NULL; }
+      for (i=0; i<n; i++) { font->subrs[i].name=NULL; font->subrs[i].data=NULL; font->subrs[i].len=0; }
+      font->NSubrs = n;
+     }
+    for (i=0; (i<n) && t1_token(priv, PrivLen, &p, tok); )
+     {
+      if (strcmp(tok, "dup")!=0) { if (tok[0]=='/') break; continue; } // Skip array, and the NP, or noaccess put, which follows each subroutine
+      if (!t1_token(priv, PrivLen, &p, tok)) return NULL;
+      j = (int)strtol(tok, NULL, 10);
+      if ((j<0) || (j>=n)) return NULL;
+      if (t1_ReadCharString(priv, PrivLen, &p, lenIV, font->subrs+j)) return NULL;
+      i++;
+     }
+    if ((cs = t1_find(priv, PrivLen, p, "/CharStrings"))<0) return NULL;
+   }
+
+  p = cs+12;
+  if (!t1_token(priv, PrivLen, &p, tok)) return NULL;
+  n = (int)strtol(tok, NULL, 10);
+  if (n<1) n=1;
+  font->glyphs = (bmp_type1_charstring *)lt_malloc(n*sizeof(bmp_type1_charstring));
+  if (font->glyphs==NULL) { ppl_error(ERR_MEMORY, -1, -1, "Out of memory"); return NULL; }
+  while ((font->NGlyphs<n) && t1_token(priv, PrivLen, &p, tok) && (strcmp(tok, "end")!=0))
+   {
+    if (tok[0]!='/') continue; // Skip dict, dup, begin, and the ND, or readonly def, which follows each charstring
+    font->glyphs[font->NGlyphs].name = (char *)lt_malloc(strlen(tok));
+    if (font->glyphs[font->NGlyphs].name==NULL) { ppl_error(ERR_MEMORY, -1, -1, "Out of memory"); return NULL; }
+    strcpy(font->glyphs[font->NGlyphs].name, tok+1);
+    if (t1_ReadCharString(priv, PrivLen, &p, lenIV, font->glyphs+font->NGlyphs)) return NULL;
+    font->NGlyphs++;
+   }
+  if (font->NGlyphs==0) return NULL;
+
+  // Sort glyphs by name, and look up the glyph for each character code
+  qsort(font->glyphs, font->NGlyphs, sizeof(bmp_type1_charstring), t1_GlyphCmp);
+  for (i=0; i<256; i++) font->encoding[i] = t1_lookup(font, EncNames[i]);
+  return font;
+ }
+
+// Charstring interpreter
+
+typedef struct t1_state
+ {
+  bmp_type1_font *font;
+  bmp_type1_sink *sink;
+  double          stack[T1_STACK], ps[T1_PSSTACK];
+  int             sp, psp;
+  double          x, y;         // Current point
+  double          ox, oy;       // Origin of the glyph being drawn; non-zero only for the accents of seac characters
+  double          wx, wy;       // Advance width
+  unsigned char   accent;       // Set while drawing the accent of a seac character, whose width is ignored
+  unsigned char   flex;
+  int             NFlex;
+  double          FlexX[T1_FLEX], FlexY[T1_FLEX];
+ } t1_state;
+
+static void t1_moveto(t1_state *s, double dx, double dy)
+ {
+  s->x += dx; s->y += dy;
+  if ((!s->flex) && (s->sink!=NULL)) (*s->sink->moveto)(s->sink->arg, s->x, s->y);
+ }
+
+static void t1_lineto(t1_state *s, double dx, double dy)
+ {
+  s->x += dx; s->y += dy;
+  if (s->sink!=NULL) (*s->sink->lineto)(s->sink->arg, s->x, s->y);
+ }
+
+static void t1_curveto(t1_state *s, double dx1, double dy1, double dx2, double dy2, double dx3, double dy3)
+ {
+  double x1=s->x+dx1, y1=s->y+dy1, x2=x1+dx2, y2=y1+dy2;
+  s->x = x2+dx3; s->y = y2+dy3;
+  if (s->sink!=NULL) (*s->sink->curveto)(s->sink->arg, x1, y1, x2, y2, s->x, s->y);
+ }
+
+static int t1_glyph(t1_state *s, int GlyphNo);
+
+// Run a charstring. Returns 1 upon endchar, 0 upon return, or -1 if the charstring is malformed.
+static int t1_run(t1_state *s, unsigned char *cs, int len, int depth)
+ {
+  int     i=0, v, n, k, status;
+  double *a;
+  t1_state sub;
+
+  if (depth>T1_SUBR_DEPTH) return -1;
+  while (i<len)
+   {
+    v = cs[i++];
+    if (v>=32) // Number
+     {
+      if (s->sp>=T1_STACK) return -1;
+      if      (v<=246) s->stack[s->sp++] = v-139;
+      else if (v<=250) { if (i>=len) return -1; s->stack[s->sp++] =  (v-247)*256 + cs[i++] + 108; }
+      else if (v<=254) { if (i>=len) return -1; s->stack[s->sp++] = -(v-251)*256 - cs[i++] - 108; }
+      else             { if (i+4>len) return -1; s->stack[s->sp++] = (double)(int)(((unsigned)cs[i]<<24)|((unsigned)cs[i+1]<<16)|((unsigned)cs[i+2]<<8)|(unsigned)cs[i+3]); i+=4; }
+      continue;
+     }
+    a = s->stack + s->sp; // Arguments are addressed relative to the top of the stack
+    switch (v)
+     {
+      case  1: // hstem
+      case  3: // vstem
+        break;
+      case  4: // vmoveto
+        if (s->sp<1) return -1;
+        t1_moveto(s, 0, a[-1]); break;
+      case  5: // rlineto
+        if (s->sp<2) return -1;
+        t1_lineto(s, a[-2], a[-1]); break;
+      case  6: // hlineto
+        if (s->sp<1) return -1;
+        t1_lineto(s, a[-1], 0); break;
+      case  7: // vlineto
+        if (s->sp<1) return -1;
+        t1_lineto(s, 0, a[-1]); break;
+      case  8: // rrcurveto
+        if (s->sp<6) return -1;
+        t1_curveto(s, a[-6], a[-5], a[-4], a[-3], a[-2], a[-1]); break;
+      case  9: // closepath; filling closes subpaths anyway
+        break;
+      case 10: // callsubr
+        if (s->sp<1) return -1;
+        n = (int)a[-1]; s->sp--;
+        if ((n<0) || (n>=s->font->NSubrs) || (s->font->subrs[n].data==NULL)) return -1;
+        status = t1_run(s, s->font->subrs[n].data, s->font->subrs[n].len, depth+1);
+        if (status!=0) return status;
+        continue;
+      case 11: // return
+        return 0;
+      case 13: // hsbw
+        if (s->sp<2) return -1;
+        s->x = s->ox + a[-2]; s->y = s->oy;
+        if (!s->accent) { s->wx = a[-1]; s->wy = 0; }
+        break;
+      case 14: // endchar
+        return 1;
+      case 21: // rmoveto
+        if (s->sp<2) return -1;
+        t1_moveto(s, a[-2], a[-1]); break;
+      case 22: // hmoveto
+        if (s->sp<1) return -1;
+        t1_moveto(s, a[-1], 0); break;
+      case 30: // vhcurveto
+        if (s->sp<4) return -1;
+        t1_curveto(s, 0, a[-4], a[-3], a[-2], a[-1], 0); break;
+      case 31: // hvcurveto
+        if (s->sp<4) return -1;
+        t1_curveto(s, a[-4], 0, a[-3], a[-2], 0, a[-1]); break;
+      case 12: // Two-byte operators
+        if (i>=len) return -1;
+        v = cs[i++];
+        switch (v)
+         {
+          case  6: // seac: build an accented character from a base glyph and an accent glyph of the StandardEncoding
+            if (s->sp<5) return -1;
+            sub = *s;
+            sub.sp = sub.psp = 0; sub.flex = 0;
+            if (t1_glyph(&sub, t1_lookup(s->font, t1_StandardName((int)a[-2])))<0) return -1;
+            s->wx = sub.wx; s->wy = sub.wy;
+            sub.sp = sub.psp = 0; sub.flex = 0;
+            sub.ox = s->ox + a[-4] - a[-5];
+            sub.oy = s->oy + a[-3];
+            sub.accent = 1;
+            if (t1_glyph(&sub, t1_lookup(s->font, t1_StandardName((int)a[-1])))<0) return -1;
+            return 1;
+          case  7: // sbw
+            if (s->sp<4) return -1;
+            s->x = s->ox + a[-4]; s->y = s->oy + a[-3];
+            if (!s->accent) { s->wx = a[-2]; s->wy = a[-1]; }
+            break;
+          case 12: // div
+            if ((s->sp<2) || (a[-1]==0)) return -1;
+            a[-2] /= a[-1]; s->sp--;
+            continue;
+          case 16: // callothersubr
+            if (s->sp<2) return -1;
+            k = (int)a[-1]; n = (int)a[-2];
+            if ((n<0) || (s->sp<n+2)) return -1;
+            s->sp -= n+2;
+            a = s->stack + s->sp; // Arguments are now a[0]...a[n-1]
+            if      (k==1) { s->flex=1; s->NFlex=0; } // Start of flex
+            else if (k==2) { if (s->flex && (s->NFlex<T1_FLEX)) { s->FlexX[s->NFlex]=s->x; s->FlexY[s->NFlex]=s->y; s->NFlex++; } }
+            else if (k==0) // End of flex: draw two curves through the points collected, ignoring the reference point
+             {
+              if ((!s->flex) || (s->NFlex!=T1_FLEX) || (s->psp+2>T1_PSSTACK)) return -1;
+              s->flex = 0;
+              if (s->sink!=NULL)
+               {
+                (*s->sink->curveto)(s->sink->arg, s->FlexX[1], s->FlexY[1], s->FlexX[2], s->FlexY[2], s->FlexX[3], s->FlexY[3]);
+                (*s->sink->curveto)(s->sink->arg, s->FlexX[4], s->FlexY[4], s->FlexX[5], s->FlexY[5], s->FlexX[6], s->FlexY[6]);
+               }
+              s->x = s->FlexX[6]; s->y = s->FlexY[6];
+              s->ps[s->psp++] = s->y; // Leave the end point to be collected by pop pop setcurrentpoint
+              s->ps[s->psp++] = s->x;
+             }
+            else // Hint replacement, and anything else, is done by returning the arguments to be collected by pop
+             {
+              if (s->psp+n>T1_PSSTACK) return -1;
+              for (k=n-1; k>=0; k--) s->ps[s->psp++] = a[k];
+             }
+            continue;
+          case 17: // pop
+            if (s->sp>=T1_STACK) return -1;
+            s->stack[s->sp++] = (s->psp>0) ? s->ps[--s->psp] : 0;
+            continue;
+          case 33: // setcurrentpoint
+            if (s->sp<2) return -1;
+            s->x = a[-2]; s->y = a[-1];
+            break;
+          default: // dotsection, vstem3, hstem3
+            break;
+         }
+        break;
+      default:
+        break;
+     }
+    s->sp = 0;
+   }
+  return 0;
+ }
+
+static int t1_glyph(t1_state *s, int GlyphNo)
+ {
+  if (GlyphNo<0) return -1;
+  s->x = s->ox; s->y = s->oy;
+  return t1_run(s, s->font->glyphs[GlyphNo].data, s->font->glyphs[GlyphNo].len, 0);
+ }
+
+// Send the outline of the glyph with character code code to sink, which may be NULL if only the advance width is wanted.
+// Returns non-zero if the font has no such glyph, or if its charstring is malformed.
+int bmp_type1_glyph(bmp_type1_font *font, int code, bmp_type1_sink *sink, double *wx, double *wy)
+ {
+  t1_state s;
+  *wx = *wy = 0;
+  if ((code<0) || (code>255) || (font->encoding[code]<0)) return 1;
+  s.font   = font;
+  s.sink   = sink;
+  s.sp     = s.psp = 0;
+  s.ox     = s.oy  = 0;
+  s.wx     = s.wy  = 0;
+  s.accent = s.flex = 0;
+  s.NFlex  = 0;
+  if (t1_glyph(&s, font->encoding[code])<0) return 1;
+  *wx = s.wx; *wy = s.wy;
+  return 0;
+ }
@@ -0,0 +1,58 @@
+// bmp_type1.h
+//
+// The code in this file is part of PyXPlot
+// <http://www.pyxplot.org.uk>
+//
+// Copyright (C) 2006-2011 Dominic Ford <coders@pyxplot.org.uk>
+//               2008-2011 Ross Church
+//
+// $Id$
+//
+// PyXPlot is free software; you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation; either version 2 of the License, or (at your option) any later
+// version.
+//
+// You should have received a copy of the GNU General Public License along with
+// PyXPlot; if not, write to the Free Software Foundation, Inc., 51 Franklin
+// Street, Fifth Floor, Boston, MA  02110-1301, USA
+
+// ----------------------------------------------------------------------------
+
+// Functions for reading Type 1 fonts embedded in PFA format, and for turning
+// their charstrings into glyph outlines for the built-in rasteriser
+
+#ifndef _PPL_BMP_TYPE1_H
+#define _PPL_BMP_TYPE1_H 1
+
+typedef struct bmp_type1_charstring
+ {
+  char          *name;
+  unsigned char *data;                 // Decrypted charstring, with its lenIV leading bytes removed
+  int            len;
+ } bmp_type1_charstring;
+
+typedef struct bmp_type1_font
+ {
+  char                 *FontName;
+  double                FontMatrix[6];
+  int                   NSubrs, NGlyphs;
+  bmp_type1_charstring *subrs, *glyphs; // Glyphs are sorted by name, so that they can be looked up with bsearch()
+  int                   encoding[256];  // Index into glyphs[] of each character code, or -1 if it is not defined
+  struct bmp_type1_font *next;
+ } bmp_type1_font;
+
+// Callbacks which receive the outline of a glyph, in character space units
+typedef struct bmp_type1_sink
+ {
+  void  *arg;
+  void (*moveto )(void *arg, double x, double y);
+  void (*lineto )(void *arg, double x, double y);
+  void (*curveto)(void *arg, double x1, double y1, double x2, double y2, double x3, double y3);
+ } bmp_type1_sink;
+
+bmp_type1_font *bmp_type1_read (unsigned char *in, long len);
+int             bmp_type1_glyph(bmp_type1_font *font, int code, bmp_type1_sink *sink, double *wx, double *wy);
+
+#endif
+
@@ -0,0 +1,229 @@
+// dvi_cache.c
+//
+// The code in this file is part of PyXPlot
+// <http://www.pyxplot.org.uk>
+//
+// Copyright (C) 2006-2011 Dominic Ford <coders@pyxplot.org.uk>
+//               2008-2011 Ross Church
+//
+// $Id$
+//
+// PyXPlot is free software; you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation; either version 2 of the License, or (at your option) any later
+// version.
+//
+// You should have received a copy of the GNU General Public License along with
+// PyXPlot; if not, write to the Free Software Foundation, Inc., 51 Franklin
+// Street, Fifth Floor, Boston, MA  02110-1301, USA
+
+// ----------------------------------------------------------------------------
+
+// Cache of text strings which LaTeX has already typeset. Each entry holds the
+// postscript which the dvi interpreter produced from one page of LaTeX output,
+// together with its bounding boxes and the fonts it uses. Entries live in
+// malloced memory, since they must outlive the memory context of any one
+// canvas redraw.
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "ListTools/lt_list.h"
+#include "ListTools/lt_memory.h"
+#include "StringTools/str_constants.h"
+
+#include "ppl_error.h"
+
+#include "dvi_cache.h"
+#include "dvi_font.h"
+#include "dvi_read.h"
+
+#define DVI_CACHE_HASHSIZE 4099
+
+static dviCacheItem    *dviCache[DVI_CACHE_HASHSIZE];
+static int              dviCacheNItems=0;
+
+// Fonts used by cache entries. These are never freed, since there are only ever a handful of them.
+static dviFontDetails **dviCacheFonts=NULL;
+static int              dviCacheNFonts=0, dviCacheFontsAlloc=0;
+
+static unsigned long dviCacheHash(char *preamble, char *text)
+ {
+  unsigned long h=5381;
+  while (*preamble!='\0') h = (h*33) ^ (unsigned char)*(preamble++);
+  h = (h*33) ^ 0xff; // Separator, so that moving text between preamble and string changes the hash
+  while (*text    !='\0') h = (h*33) ^ (unsigned char)*(text++);
+  return h;
+ }
+
+static char *dviCacheStrdup(const char *in)
+ {
+  char *out;
+  if (in==NULL) return NULL;
+  if ((out = (char *)malloc(strlen(in)+1))==NULL) return NULL;
+  strcpy(out, in);
+  return out;
+ }
+
+// Return a persistent copy of the details of a font, which is shared between all of the cache entries which use it
+static dviFontDetails *dviCacheFont(dviFontDetails *in)
+ {
+  int i;
+  dviFontDetails *f, **tmp;
+
+  for (i=0; i<dviCacheNFonts; i++) if (strcmp(dviCacheFonts[i]->psName, in->psName)==0) return dviCacheFonts[i];
+  if (dviCacheNFonts >= dviCacheFontsAlloc)
+   {
+    tmp = (dviFontDetails **)realloc(dviCacheFonts, (dviCacheFontsAlloc+16)*sizeof(dviFontDetails *));
+    if (tmp==NULL) return NULL;
+    dviCacheFonts = tmp;
+    dviCacheFontsAlloc += 16;
+   }
+  if ((f = (dviFontDetails *)malloc(sizeof(dviFontDetails)))==NULL) return NULL;
+  memcpy(f, in, sizeof(dviFontDetails));
+  f->area    = dviCacheStrdup(in->area);
+  f->name    = dviCacheStrdup(in->name);
+  f->psName  = dviCacheStrdup(in->psName);
+  f->pfaPath = dviCacheStrdup(in->pfaPath);
+  f->tfm     = NULL; // Only the font's name and pfa file are needed to write it into an EPS file
+  if ((f->psName==NULL) || ((in->pfaPath!=NULL)&&(f->pfaPath==NULL))) return NULL;
+  dviCacheFonts[dviCacheNFonts++] = f;
+  return f;
+ }
+
+// Look up a text string which may have been typeset before with the same LaTeX preamble
+dviCacheItem *dviCacheFetch(char *preamble, char *text)
+ {
+  unsigned long h = dviCacheHash(preamble, text);
+  dviCacheItem *i;
+
+  for (i=dviCache[h % DVI_CACHE_HASHSIZE]; i!=NULL; i=i->next)
+   if ((i->hash==h) && (strcmp(i->text, text)==0) && (strcmp(i->preamble, preamble)==0))
+    return i;
+  return NULL;
+ }
+
+// Add a page of postscript, as produced by the dvi interpreter, to the cache. fonts is the list of all of the fonts
+// which the dvi interpreter loaded; we keep only those which this page uses.
+dviCacheItem *dviCacheStore(char *preamble, char *text, postscriptPage *page, List *fonts)
+ {
+  dviCacheItem   *item;
+  dviFontDetails *font, **tmp;
+  ListIterator   *ListIter;
+  char            FontRef[SSTR_LENGTH];
+  long            len=0;
+  int             i;
+
+  if ((item = (dviCacheItem *)malloc(sizeof(dviCacheItem)))==NULL) return NULL;
+  item->hash     = dviCacheHash(preamble, text);
+  item->preamble = dviCacheStrdup(preamble);
+  item->text     = dviCacheStrdup(text);
+  item->Nfonts   = 0;
+  item->fonts    = NULL;
+
+  // Concatenate the strings of postscript which make up the page
+  ListIter = ListIterateInit(page->text);
+  while (ListIter != NULL) { len += strlen((char *)ListIter->data); ListIter = ListIterate(ListIter, NULL); }
+  item->ps = (char *)malloc(len+1);
+  if ((item->preamble==NULL) || (item->text==NULL) || (item->ps==NULL)) { free(item->preamble); free(item->text); free(item->ps); free(item); return NULL; }
+  len = 0;
+  ListIter = ListIterateInit(page->text);
+  while (ListIter != NULL) { strcpy(item->ps+len, (char *)ListIter->data); len += strlen(item->ps+len); ListIter = ListIterate(ListIter, NULL); }
+  item->ps[len] = '\0';
+
+  for (i=0; i<4; i++)
+   {
+    item->boundingBox[i] = (page->boundingBox==NULL) ? 0.0 : page->boundingBox[i];
+    item->textSizeBox[i] = (page->textSizeBox==NULL) ? 0.0 : page->textSizeBox[i];
+   }
+
+  // Work out which fonts this page selects
+  ListIter = ListIterateInit(fonts);
+  while (ListIter != NULL)
+   {
+    font = (dviFontDetails *)ListIter->data;
+    ListIter = ListIterate(ListIter, NULL);
+    if (font->psName == NULL) continue;
+    snprintf(FontRef, SSTR_LENGTH, "/%s ", font->psName);
+    if (strstr(item->ps, FontRef) == NULL) continue;
+    tmp = (dviFontDetails **)realloc(item->fonts, (item->Nfonts+1)*sizeof(dviFontDetails *));
+    if (tmp != NULL) item->fonts = tmp;
+    if ((tmp == NULL) || ((item->fonts[item->Nfonts] = dviCacheFont(font))==NULL)) { free(item->preamble); free(item->text); free(item->ps); free(item->fonts); free(item); return NULL; }
+    item->Nfonts++;
+   }
+
+  item->next = dviCache[item->hash % DVI_CACHE_HASHSIZE];
+  dviCache[item->hash % DVI_CACHE_HASHSIZE] = item;
+  dviCacheNItems++;
+  return item;
+ }
+
+// Make a dvi interpreter state, of the kind which ReadDviFile() returns, containing the pages of postscript held in a
+// series of cache entries. Page 1 is left blank, as in the documents which we pass to LaTeX. The interpreter is
+// allocated in the current lt_memory context, but refers to the cache entries, which must not be freed while it is in use.
+dviInterpreterState *dviCacheInterpreter(dviCacheItem **items, int Nitems)
+ {
+  dviInterpreterState *interp;
+  postscriptPage      *page;
+  ListIterator        *ListIter;
+  int                  i, j;
+
+  interp = (dviInterpreterState *)lt_malloc(sizeof(dviInterpreterState));
+  if (interp==NULL) { ppl_error(ERR_MEMORY, -1, -1, "Out of memory"); return NULL; }
+  memset(interp, 0, sizeof(dviInterpreterState));
+  interp->output = (postscriptState *)lt_malloc(sizeof(postscriptState));
+  if (interp->output==NULL) { ppl_error(ERR_MEMORY, -1, -1, "Out of memory"); return NULL; }
+  memset(interp->output, 0, sizeof(postscriptState));
+  interp->output->pages = ListInit();
+  interp->fonts         = ListInit();
+  interp->stack         = ListInit();
+  interp->colStack      = ListInit();
+  if ((page = dviNewPostscriptPage())==NULL) return NULL;
+  ListAppendPtr(interp->output->pages, (void *)page, sizeof(postscriptPage), 0, DATATYPE_VOID);
+
+  for (i=0; i<Nitems; i++)
+   {
+    if ((page = dviNewPostscriptPage())==NULL) return NULL;
+    page->boundingBox = items[i]->boundingBox;
+    page->textSizeBox = items[i]->textSizeBox;
+    ListAppendPtr(page->text, (void *)items[i]->ps, strlen(items[i]->ps)+1, 0, DATATYPE_VOID);
+    ListAppendPtr(interp->output->pages, (void *)page, sizeof(postscriptPage), 0, DATATYPE_VOID);
+
+    for (j=0; j<items[i]->Nfonts; j++)
+     {
+      ListIter = ListIterateInit(interp->fonts);
+      while ((ListIter != NULL) && (ListIter->data != (void *)items[i]->fonts[j])) ListIter = ListIterate(ListIter, NULL);
+      if (ListIter == NULL) ListAppendPtr(interp->fonts, (void *)items[i]->fonts[j], sizeof(dviFontDetails), 0, DATATYPE_VOID);
+     }
+   }
+  interp->output->Npages = Nitems+1;
+  return interp;
+ }
+
+// Empty the cache if it has grown too large. This must not be called while any cache entries are in use.
+void dviCacheTrim()
+ {
+  if (dviCacheNItems >= DVI_CACHE_MAXITEMS) dviCacheClear();
+  return;
+ }
+
+void dviCacheClear()
+ {
+  int i;
+  dviCacheItem *item, *next;
+
+  if (DEBUG) { sprintf(temp_err_string, "Emptying cache of %d typeset text strings.", dviCacheNItems); ppl_log(temp_err_string); }
+  for (i=0; i<DVI_CACHE_HASHSIZE; i++)
+   {
+    for (item=dviCache[i]; item!=NULL; item=next)
+     {
+      next = item->next;
+      free(item->preamble); free(item->text); free(item->ps); free(item->fonts); free(item);
+     }
+    dviCache[i] = NULL;
+   }
+  dviCacheNItems = 0;
+  return;
+ }
+
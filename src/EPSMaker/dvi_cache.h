@@ -0,0 +1,52 @@
+// dvi_cache.h
+//
+// The code in this file is part of PyXPlot
+// <http://www.pyxplot.org.uk>
+//
+// Copyright (C) 2006-2011 Dominic Ford <coders@pyxplot.org.uk>
+//               2008-2011 Ross Church
+//
+// $Id$
+//
+// PyXPlot is free software; you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation; either version 2 of the License, or (at your option) any later
+// version.
+//
+// You should have received a copy of the GNU General Public License along with
+// PyXPlot; if not, write to the Free Software Foundation, Inc., 51 Franklin
+// Street, Fifth Floor, Boston, MA  02110-1301, USA
+
+// ----------------------------------------------------------------------------
+
+// Cache of text strings which LaTeX has already typeset, so that the same
+// strings need not be passed to LaTeX again each time a canvas is redrawn
+
+#ifndef _PPL_DVI_CACHE_H
+#define _PPL_DVI_CACHE_H 1
+
+#include "dvi_read.h"
+#include "dvi_font.h"
+
+// The maximum number of strings kept in the cache before it is emptied
+#define DVI_CACHE_MAXITEMS 16384
+
+typedef struct dviCacheItem
+ {
+  char            *preamble, *text; // The LaTeX preamble in use, and the text string which was typeset
+  unsigned long    hash;
+  char            *ps;              // The postscript which the dvi interpreter made from this string
+  double           boundingBox[4], textSizeBox[4];
+  int              Nfonts;
+  dviFontDetails **fonts;           // The fonts which this page of postscript uses
+  struct dviCacheItem *next;
+ } dviCacheItem;
+
+dviCacheItem        *dviCacheFetch      (char *preamble, char *text);
+dviCacheItem        *dviCacheStore      (char *preamble, char *text, postscriptPage *page, List *fonts);
+dviInterpreterState *dviCacheInterpreter(dviCacheItem **items, int Nitems);
+void                 dviCacheTrim       ();
+void                 dviCacheClear      ();
+
+#endif
+
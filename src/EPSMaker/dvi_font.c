@@ -24,6 +24,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <sys/stat.h>
 
 #include "ListTools/lt_memory.h"
 #include "StringTools/str_constants.h"
@@ -45,6 +46,115 @@ char builtinFontNames[N_BUILTIN_FONTS][L_BUILTIN_FPSNAME] = {"Times-Bold", "Time
 
 int dviGetPfa(dviFontDetails *font, char *filename);
 
+// Cache of fonts which have already been loaded. Neither the metrics in a font's TFM file, nor the name and location of
+// its pfa file, depend upon the size at which it is used, so these are kept, keyed by the font's name, in malloced
+// memory for the lifetime of the process. Only the maximum glyph dimensions, which are scaled by the font's size, are
+// worked out afresh each time that a font is used. There are only ever a handful of fonts, so a list suffices.
+
+typedef struct dviFontCacheItem
+ {
+  char   *name, *psName, *pfaPath;
+  dviTFM *tfm;
+  int     fontType;
+  struct dviFontCacheItem *next;
+ } dviFontCacheItem;
+
+static dviFontCacheItem *dviFontCache = NULL;
+
+// The text of pfa files which have been embedded in EPS files, keyed by their paths
+typedef struct dviPfaCacheItem
+ {
+  char *path, *text;
+  struct dviPfaCacheItem *next;
+ } dviPfaCacheItem;
+
+static dviPfaCacheItem *dviPfaCache = NULL;
+
+static char *dviFontCacheStrdup(const char *in)
+ {
+  char *out;
+  if (in==NULL) return NULL;
+  if ((out = (char *)malloc(strlen(in)+1))==NULL) return NULL;
+  strcpy(out, in);
+  return out;
+ }
+
+// Make a copy of an array in malloced memory. Returns nonzero on failure.
+static int dviFontCacheArray(void **out, void *in, int N, int size)
+ {
+  *out = NULL;
+  if (N<=0) return 0;
+  if ((*out = malloc(N*size))==NULL) return 1;
+  memcpy(*out, in, N*size);
+  return 0;
+ }
+
+// Add a font, which has just been successfully loaded, to the cache, and make it point to the cached copies of its
+// TFM data and pfa path. If we run out of memory, the font simply doesn't get cached.
+static void dviFontCacheStore(dviFontDetails *font)
+ {
+  dviFontCacheItem *item;
+  dviTFM           *tfm;
+  int               fail=0;
+
+  if ((item = (dviFontCacheItem *)malloc(sizeof(dviFontCacheItem)))==NULL) return;
+  if ((tfm  = (dviTFM           *)malloc(sizeof(dviTFM          )))==NULL) { free(item); return; }
+  memcpy(tfm, font->tfm, sizeof(dviTFM));
+  fail |= dviFontCacheArray((void **)&tfm->charInfo        , font->tfm->charInfo        , tfm->ec-tfm->bc+1, sizeof(TFMcharInfo));
+  fail |= dviFontCacheArray((void **)&tfm->width           , font->tfm->width           , tfm->nw          , sizeof(double     ));
+  fail |= dviFontCacheArray((void **)&tfm->height          , font->tfm->height          , tfm->nh          , sizeof(double     ));
+  fail |= dviFontCacheArray((void **)&tfm->depth           , font->tfm->depth           , tfm->nd          , sizeof(double     ));
+  fail |= dviFontCacheArray((void **)&tfm->italic          , font->tfm->italic          , tfm->ni          , sizeof(double     ));
+  fail |= dviFontCacheArray((void **)&tfm->ligKern         , font->tfm->ligKern         , tfm->nl          , sizeof(TFMligKern ));
+  fail |= dviFontCacheArray((void **)&tfm->kern            , font->tfm->kern            , tfm->nk          , sizeof(double     ));
+  fail |= dviFontCacheArray((void **)&tfm->extensibleRecipe, font->tfm->extensibleRecipe, tfm->ne          , sizeof(TFMextRec  ));
+  tfm->param = NULL; // dviReadTFM() does not read the parameter array
+  item->name     = dviFontCacheStrdup(font->name);
+  item->psName   = dviFontCacheStrdup(font->psName);
+  item->pfaPath  = dviFontCacheStrdup(font->pfaPath);
+  item->tfm      = tfm;
+  item->fontType = font->fontType;
+  if (fail || (item->name==NULL) || (item->psName==NULL) || ((font->pfaPath!=NULL)&&(item->pfaPath==NULL)))
+   {
+    free(tfm->charInfo); free(tfm->width); free(tfm->height); free(tfm->depth); free(tfm->italic); free(tfm->ligKern); free(tfm->kern); free(tfm->extensibleRecipe);
+    free(tfm); free(item->name); free(item->psName); free(item->pfaPath); free(item);
+    if (DEBUG) { sprintf(temp_err_string, "Could not add font %s to font cache.", font->name); ppl_log(temp_err_string); }
+    return;
+   }
+  item->next   = dviFontCache;
+  dviFontCache = item;
+
+  // The pfa path may point to a static buffer in kpse_wrap.c, which is overwritten by the next lookup
+  font->pfaPath = item->pfaPath;
+  return;
+ }
+
+// Return the text of the pfa file PFApath, reading it only if it has not been read before. Returns NULL on failure.
+char *dviGetPfaText(char *PFApath)
+ {
+  dviPfaCacheItem *item;
+  FILE            *fp;
+  struct stat      statbuf;
+  char            *text;
+  long             len;
+
+  for (item=dviPfaCache; item!=NULL; item=item->next) if (strcmp(item->path, PFApath)==0) return item->text;
+
+  if ((fp = fopen(PFApath, "r"))==NULL) return NULL;
+  if ((fstat(fileno(fp), &statbuf) < 0) || ((text = (char *)malloc(statbuf.st_size+1))==NULL)) { fclose(fp); return NULL; }
+  len = fread(text, 1, statbuf.st_size, fp);
+  fclose(fp);
+  text[len] = '\0';
+
+  if ((item = (dviPfaCacheItem *)malloc(sizeof(dviPfaCacheItem)))==NULL) { free(text); return NULL; }
+  if ((item->path = dviFontCacheStrdup(PFApath))==NULL) { free(text); free(item); return NULL; }
+  item->text  = text;
+  item->next  = dviPfaCache;
+  dviPfaCache = item;
+  if (DEBUG) { sprintf(temp_err_string, "Read %ld bytes of pfa file %s into font cache.", len, PFApath); ppl_log(temp_err_string); }
+  return text;
+ }
+
 int dviGetTFM(dviFontDetails *font)
  {
   char *TFMpath;
@@ -53,6 +163,19 @@ int dviGetTFM(dviFontDetails *font)
   int err=0;
   int i;
   FILE *TFMfp;
+  dviFontCacheItem *item;
+
+  // See whether we have loaded this font before
+  for (item=dviFontCache; item!=NULL; item=item->next)
+   if (strcmp(item->name, font->name)==0)
+    {
+     if (DEBUG) { sprintf(temp_err_string, "Font file %s: using cached TFM data", font->name); ppl_log(temp_err_string); }
+     font->tfm      = item->tfm;
+     font->psName   = item->psName;
+     font->pfaPath  = item->pfaPath;
+     font->fontType = item->fontType;
+     return dviFindMaxSize(font);
+    }
 
   // Get the TFM file
   s = (char *)lt_malloc((strlen(font->name)+5)*sizeof(char));
@@ -136,6 +259,7 @@ int dviGetTFM(dviFontDetails *font)
     if (font->psName==NULL) return 1;
    }
 
+  dviFontCacheStore(font);
   return 0;
  }
 
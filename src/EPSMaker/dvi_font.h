@@ -110,6 +110,7 @@ dviTFM *dviReadTFM    (FILE *fp, int *err);
 int     dviFindMaxSize(dviFontDetails *font);
 int     pfb2pfa       (FILE *in, FILE *out);
 char   *psNameFromPFA (char *PFApath);
+char   *dviGetPfaText (char *PFApath);
 
 #endif
 
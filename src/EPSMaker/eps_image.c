@@ -32,6 +32,7 @@
 #include "ppl_error.h"
 #include "ppl_glob.h"
 #include "ppl_setting_types.h"
+#include "ppl_threads.h"
 
 #include "bmp_a85.h"
 #include "bmp_bmpread.h"
@@ -45,6 +46,112 @@
 #include "eps_image.h"
 #include "eps_settings.h"
 
+// Image data is deflated in chunks of this many bytes, which are compressed by several threads at once
+#define EPS_IMAGE_DEFLATE_CHUNK 262144
+
+typedef struct DeflateChunks {
+  const unsigned char *in;
+  unsigned long        InLen;
+  int                  NChunks;
+  unsigned char      **out;
+  unsigned long       *OutLen, *adler;
+  unsigned char       *failed;
+ } DeflateChunks;
+
+// Deflate chunks ThreadNo, ThreadNo+NThreads, ... of the input into raw deflate streams. Each chunk is primed with the 32kB of data which
+// precede it, and all but the last are ended with a sync flush rather than a final block, so that they can simply be concatenated.
+static void eps_image_DeflateThread(void *job_void, int ThreadNo, int NThreads)
+ {
+  DeflateChunks *job = (DeflateChunks *)job_void;
+  z_stream       s;
+  unsigned long  start, len, dict, bound;
+  int            k, last, r;
+
+  for (k=ThreadNo; k<job->NChunks; k+=NThreads)
+   {
+    start = (unsigned long)k * EPS_IMAGE_DEFLATE_CHUNK;
+    len   = job->InLen - start;
+    if (len > EPS_IMAGE_DEFLATE_CHUNK) len = EPS_IMAGE_DEFLATE_CHUNK;
+    last  = (k == job->NChunks-1);
+
+    memset(&s, 0, sizeof(z_stream));
+    if (deflateInit2(&s, 9, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK) { job->failed[k]=1; continue; }
+    dict = (start < 32768) ? start : 32768;
+    if ((dict > 0) && (deflateSetDictionary(&s, job->in+start-dict, dict) != Z_OK)) { deflateEnd(&s); job->failed[k]=1; continue; }
+    bound = deflateBound(&s, len) + 16; // Leave room for the empty stored block written by a sync flush
+    job->out[k] = (unsigned char *)malloc(bound); // lt_malloc is not thread safe
+    if (job->out[k] == NULL) { deflateEnd(&s); job->failed[k]=1; continue; }
+    s.next_in   = (Bytef *)(job->in+start);
+    s.avail_in  = len;
+    s.next_out  = job->out[k];
+    s.avail_out = bound;
+    r = deflate(&s, last ? Z_FINISH : Z_SYNC_FLUSH);
+    if ( (last ? (r!=Z_STREAM_END) : (r!=Z_OK)) || (s.avail_in!=0) || (s.avail_out==0) ) job->failed[k]=1;
+    job->OutLen[k] = bound - s.avail_out;
+    job->adler [k] = adler32(adler32(0L, Z_NULL, 0), job->in+start, len);
+    deflateEnd(&s);
+   }
+  return;
+ }
+
+// eps_image_deflate(): Compress image data for use with the FlateDecode filter. This has the same interface as zlib's compress2() at
+// compression level 9. Large images are split into chunks, which are compressed in parallel and then stitched back together into a
+// single zlib stream, so the output differs slightly from that of compress2(), but decompresses to the same data.
+int eps_image_deflate(unsigned char *out, unsigned long *OutLen, const unsigned char *in, unsigned long InLen)
+ {
+  DeflateChunks job;
+  int           NThreads, k, r=Z_OK;
+  unsigned long pos, adler;
+
+  NThreads    = ppl_threads_count();
+  job.NChunks = (InLen + EPS_IMAGE_DEFLATE_CHUNK - 1) / EPS_IMAGE_DEFLATE_CHUNK;
+  if ((NThreads < 2) || (job.NChunks < 2)) return compress2(out, (uLongf *)OutLen, in, InLen, 9);
+  if (NThreads > job.NChunks) NThreads = job.NChunks;
+
+  job.in     = in;
+  job.InLen  = InLen;
+  job.out    = (unsigned char **)calloc(job.NChunks, sizeof(unsigned char *));
+  job.OutLen = (unsigned long  *)calloc(job.NChunks, sizeof(unsigned long));
+  job.adler  = (unsigned long  *)calloc(job.NChunks, sizeof(unsigned long));
+  job.failed = (unsigned char  *)calloc(job.NChunks, sizeof(unsigned char));
+  if ((job.out==NULL)||(job.OutLen==NULL)||(job.adler==NULL)||(job.failed==NULL)) r = Z_MEM_ERROR;
+  else
+   {
+    if (DEBUG) { sprintf(temp_err_string, "Deflating %d chunks of image data using %d threads.", job.NChunks, NThreads); ppl_log(temp_err_string); }
+    ppl_threads_run(&eps_image_DeflateThread, (void *)&job, NThreads);
+
+    // zlib header for a deflate stream with a 32kB window, compressed at maximum compression
+    pos = 2;
+    if (*OutLen < pos) r = Z_BUF_ERROR;
+    else { out[0] = 0x78; out[1] = 0xDA; }
+    adler = adler32(0L, Z_NULL, 0);
+    for (k=0; (k<job.NChunks) && (r==Z_OK); k++)
+     {
+      if (job.failed[k])                       { r = Z_MEM_ERROR; break; }
+      if (pos + job.OutLen[k] + 4 > *OutLen)   { r = Z_BUF_ERROR; break; }
+      memcpy(out+pos, job.out[k], job.OutLen[k]);
+      pos  += job.OutLen[k];
+      adler = adler32_combine(adler, job.adler[k], (k<job.NChunks-1) ? EPS_IMAGE_DEFLATE_CHUNK : (InLen - (unsigned long)k*EPS_IMAGE_DEFLATE_CHUNK));
+     }
+    if (r == Z_OK)
+     {
+      out[pos++] = (adler>>24)&0xFF; // Adler-32 checksum of uncompressed data, most significant byte first
+      out[pos++] = (adler>>16)&0xFF;
+      out[pos++] = (adler>> 8)&0xFF;
+      out[pos++] = (adler    )&0xFF;
+      *OutLen = pos;
+     }
+   }
+
+  if (job.out != NULL) for (k=0; k<job.NChunks; k++) if (job.out[k]!=NULL) free(job.out[k]);
+  if (job.out    != NULL) free(job.out);
+  if (job.OutLen != NULL) free(job.OutLen);
+  if (job.adler  != NULL) free(job.adler);
+  if (job.failed != NULL) free(job.failed);
+  if (r == Z_MEM_ERROR) return compress2(out, (uLongf *)OutLen, in, InLen, 9); // Fall back to doing everything in this thread
+  return r;
+ }
+
 void eps_image_RenderEPS(EPSComm *x)
  {
   bitmap_data   data;
@@ -165,7 +272,7 @@ if (data.TargetCompression==BMP_ENCODING_FLATE) data.TargetCompression=BMP_ENCOD
       imagez = (unsigned char *)lt_malloc(zlen);
       if (imagez == NULL) { ppl_error(ERR_MEMORY, -1, -1,"Out of memory"); return; }
       if (DEBUG) { ppl_log("Calling zlib to compress image data"); }
-      j = compress2(imagez,&zlen,data.data,data.data_len,9); // Call zlib to do deflation
+      j = eps_image_deflate(imagez,&zlen,data.data,data.data_len); // Call zlib to do deflation
 
       if (j!=0)
        {
@@ -25,6 +25,7 @@
 #include "eps_comm.h"
 
 void eps_image_RenderEPS(EPSComm *x);
+int  eps_image_deflate  (unsigned char *out, unsigned long *OutLen, const unsigned char *in, unsigned long InLen);
 
 // Colour channel configurations
 
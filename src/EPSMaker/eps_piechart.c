@@ -95,7 +95,7 @@ void eps_pie_ReadAccessibleData(EPSComm *x)
   if (pd->function == 0) // Read data from file
    {
     if (DEBUG) { sprintf(temp_err_string, "Reading data from file '%s' for piechart item %d", pd->filename, x->current->id); ppl_log(temp_err_string); }
-    if (pd->PersistentDataTable==NULL) DataFile_read(x->current->plotdata, &status, errbuffer, pd->filename, pd->index, pd->UsingRowCols, UsingList, AutoUsingList, EveryList, LabelString, NExpect, pd->SelectCriterion, pd->continuity, NULL, -1, 0, &ErrCount);
+    if (pd->PersistentDataTable==NULL) DataFile_read(x->current->plotdata, &status, errbuffer, pd->filename, pd->BinaryFormat, pd->index, pd->UsingRowCols, UsingList, AutoUsingList, EveryList, LabelString, NExpect, pd->SelectCriterion, pd->continuity, NULL, -1, 0, &ErrCount);
     else                               x->current->plotdata[0] = pd->PersistentDataTable;
    } else {
     if (DEBUG) { sprintf(temp_err_string, "Reading data from functions for piechart item %d", x->current->id); ppl_log(temp_err_string); }
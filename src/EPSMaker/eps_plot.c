@@ -279,6 +279,53 @@ static void TriSwap(double *a, double *b)
   return;
  }
 
+// Make the using and every lists with which the data for a dataset are read, and work out how many columns of data are needed to plot it
+// in the style given in ww. Returns nonzero on error.
+
+static int eps_plot_DatasetLists(EPSComm *x, canvas_plotdesc *pd, with_words *ww, List **UsingList, List **EveryList, unsigned char *AutoUsingList, int *NExpect)
+ {
+  int   j;
+  Dict *tempdict;
+
+  *UsingList = ListInit(); for (j=0; j<pd->NUsing  ; j++) { tempdict = DictInit(HASHSIZE_SMALL); DictAppendPtr(tempdict, "using_item", (void *)pd->UsingList[j], 0, 0, DATATYPE_VOID); ListAppendPtr(*UsingList, (void *)tempdict, 0, 0, DATATYPE_VOID); }
+  *EveryList = ListInit(); for (j=0; j<pd->EverySet; j++) { tempdict = DictInit(HASHSIZE_SMALL); DictAppendPtr(tempdict, "every_item", (void *)(pd->EveryList+j), 0, 0, DATATYPE_VOID); ListAppendPtr(*EveryList, (void *)tempdict, 0, 0, DATATYPE_VOID); }
+  *NExpect   = eps_plot_styles_NDataColumns(ww->linespoints, x->current->ThreeDim);
+
+  if (ww->linespoints==SW_STYLE_COLOURMAP)
+   {
+    int ll = ListLen(*UsingList);
+    if ((ll>=3)&&(ll<=6)) *NExpect=ll; // Colour maps can take 3,4,5 or 6 columns of data
+    else if ((pd->function)&&(pd->NFunctions>=3)&&(pd->NFunctions<=6)) *NExpect=pd->NFunctions;
+   }
+
+  return eps_plot_AddUsingItemsForWithWords(ww, NExpect, AutoUsingList, *UsingList); // Add extra using items for, e.g. "linewidth $3".
+ }
+
+// Ask for the datafiles plotted by a graph to be read by worker threads, ahead of the ReadAccessibleData phase. Graphs whose axes are
+// linked are given the same group number, so that their files are read by the same thread. The requests are made with the same
+// arguments as are later passed to DataFile_read() by eps_plot_ReadAccessibleData().
+
+void eps_plot_ReadAhead(EPSComm *x, int group)
+ {
+  int              NExpect;
+  canvas_plotdesc *pd;
+  List            *UsingList, *EveryList;
+  unsigned char    AutoUsingList=0;
+  with_words       ww_default, ww_final;
+
+  for (pd=x->current->plotitems; pd!=NULL; pd=pd->next)
+   {
+    if ((pd->function != 0) || (pd->PersistentDataTable != NULL)) continue;
+
+    // The default colours and line types of datasets do not affect which columns are read, and so need not be counted here
+    eps_withwords_default(&ww_default, &x->current->settings, 0, 0, 0, 0, settings_term_current.colour==SW_ONOFF_ON);
+    with_words_merge(&ww_final, &pd->ww, &x->current->settings.DataStyle, &ww_default, NULL, NULL, 1);
+    if (eps_plot_DatasetLists(x, pd, &ww_final, &UsingList, &EveryList, &AutoUsingList, &NExpect)) return;
+    DataFile_ReadAheadRequest(pd->filename, pd->BinaryFormat, pd->index, pd->UsingRowCols, UsingList, AutoUsingList, EveryList, pd->label, NExpect, pd->SelectCriterion, pd->continuity, (ww_final.linespoints==SW_STYLE_BOXES)?"@":NULL, DATAFILE_DISCONTINUOUS, group);
+   }
+  return;
+ }
+
 // Loop through all of the datasets plotted in a single plot command.
 // Initialise the datastructures for the plot command which we will fill in the
 // process of deciding how to render the graph. Then read in data from
@@ -294,7 +341,6 @@ void eps_plot_ReadAccessibleData(EPSComm *x)
   settings_axis    *axis, *axissets[3];
   List             *UsingList, *EveryList;
   unsigned char     AutoUsingList=0;
-  Dict             *tempdict;
   char              errbuffer[LSTR_LENGTH];
   with_words        ww_default;
   double           *ordinate_raster, *ordinate2_raster, size[3], ScreenSize[3], ScreenBearing[3];
@@ -469,25 +515,14 @@ void eps_plot_ReadAccessibleData(EPSComm *x)
     // If plotting a datafile, can read in data now, so do so
     if ((pd->function == 0) || (pd->parametric == 1))
      {
-      UsingList = ListInit(); for (j=0; j<pd->NUsing  ; j++) { tempdict = DictInit(HASHSIZE_SMALL); DictAppendPtr(tempdict, "using_item", (void *)pd->UsingList[j], 0, 0, DATATYPE_VOID); ListAppendPtr(UsingList, (void *)tempdict, 0, 0, DATATYPE_VOID); }
-      EveryList = ListInit(); for (j=0; j<pd->EverySet; j++) { tempdict = DictInit(HASHSIZE_SMALL); DictAppendPtr(tempdict, "every_item", (void *)(pd->EveryList+j), 0, 0, DATATYPE_VOID); ListAppendPtr(EveryList, (void *)tempdict, 0, 0, DATATYPE_VOID); }
       status   = 0;
       ErrCount = DATAFILE_NERRS;
-      NExpect  = eps_plot_styles_NDataColumns(pd->ww_final.linespoints, x->current->ThreeDim);
-
-      if (pd->ww_final.linespoints==SW_STYLE_COLOURMAP)
-       {
-        int ll = ListLen(UsingList);
-        if ((ll>=3)&&(ll<=6)) NExpect=ll; // Colour maps can take 3,4,5 or 6 columns of data
-        else if ((pd->function)&&(pd->NFunctions>=3)&&(pd->NFunctions<=6)) NExpect=pd->NFunctions;
-       }
-
-      if (eps_plot_AddUsingItemsForWithWords(&pd->ww_final, &NExpect, &AutoUsingList, UsingList)) { *(x->status) = 1; return; } // Add extra using items for, e.g. "linewidth $3".
+      if (eps_plot_DatasetLists(x, pd, &pd->ww_final, &UsingList, &EveryList, &AutoUsingList, &NExpect)) { *(x->status) = 1; return; }
 
       if (pd->function == 0) // Read data from file
        {
         if (DEBUG) { sprintf(temp_err_string, "Reading data from file '%s' for dataset %d in plot item %d", pd->filename, i+1, x->current->id); ppl_log(temp_err_string); }
-        if (pd->PersistentDataTable==NULL) DataFile_read(x->current->plotdata+i, &status, errbuffer, pd->filename, pd->index, pd->UsingRowCols, UsingList, AutoUsingList, EveryList, pd->label, NExpect, pd->SelectCriterion, pd->continuity, (pd->ww_final.linespoints==SW_STYLE_BOXES)?"@":NULL, DATAFILE_DISCONTINUOUS, 0, &ErrCount);
+        if (pd->PersistentDataTable==NULL) DataFile_read(x->current->plotdata+i, &status, errbuffer, pd->filename, pd->BinaryFormat, pd->index, pd->UsingRowCols, UsingList, AutoUsingList, EveryList, pd->label, NExpect, pd->SelectCriterion, pd->continuity, (pd->ww_final.linespoints==SW_STYLE_BOXES)?"@":NULL, DATAFILE_DISCONTINUOUS, 0, &ErrCount);
         else                               x->current->plotdata[i] = pd->PersistentDataTable;
        } else {
         int     Nsamples      ,  Nsamples2, USE_T_or_uv;
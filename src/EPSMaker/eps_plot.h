@@ -30,6 +30,7 @@
 
 int eps_plot_AddUsingItemsForWithWords(with_words *ww, int *NExpect, unsigned char *AutoUsingList, List *UsingList);
 
+void eps_plot_ReadAhead(EPSComm *x, int group);
 void eps_plot_ReadAccessibleData(EPSComm *x);
 void eps_plot_SampleFunctions(EPSComm *x);
 void eps_plot_DecideAxisRanges(EPSComm *x);
@@ -34,8 +34,10 @@
 #include "ppl_settings.h"
 #include "ppl_setting_types.h"
 #include "ppl_units.h"
+#include "ppl_threads.h"
 #include "ppl_units_fns.h"
 #include "ppl_userspace.h"
+#include "ppl_userspace_compile.h"
 
 #include "bmp_a85.h"
 #include "bmp_optimise.h"
@@ -57,12 +59,265 @@
 #define TRANS_G 2
 #define TRANS_B 20
 
+// Minimum number of pixels in each band of a colourmap which is coloured in by a separate thread
+#define COLMAP_BAND_PIXELS 16384
+
+#define COLMAP_FREE_BANDS(N) \
+  { int t2; for (t2=0; t2<(N); t2++) eps_plot_colourmap_free(bands.fns+t2); }
+
 #define CLIP_COMPS \
   comp[0] = (comp[0] < 0.0) ? 0.0 : ((comp[0]>1.0) ? 1.0 : comp[0] ); \
   comp[1] = (comp[1] < 0.0) ? 0.0 : ((comp[1]>1.0) ? 1.0 : comp[1] ); \
   comp[2] = (comp[2] < 0.0) ? 0.0 : ((comp[2]>1.0) ? 1.0 : comp[2] ); \
   comp[3] = (comp[3] < 0.0) ? 0.0 : ((comp[3]>1.0) ? 1.0 : comp[3] );
 
+// Colour and mask expressions of a colourmap, compiled with the variables c1...c4 bound to arguments, so that they can be evaluated
+// over a whole row of pixels at a time without being parsed afresh for each pixel
+typedef struct ColMapExprs {
+  CompiledAlgebra *expr   [5];  // Colour components 1-4, then the mask expression
+  char            *text   [5];
+  int              trivial[5];  // Result of ppl_CompiledAlgebraTrivial(), or -3 if there is no such expression
+  value            ConstVal[5];
+  int              errpos [5];  // If an expression failed to compile, the error is only reported if it is ever evaluated, as it used to be
+  char            *errtext[5];
+  int              NComps, NArgs;
+  value            args[4];     // Units of c1...c4
+ } ColMapExprs;
+
+// Compile the colour expressions in sg, and the mask expression if there is one. c1...cNArgs are bound to arguments, with the units of CVal[].
+static int eps_plot_colourmap_compile(ColMapExprs *f, settings_graph *sg, int NArgs, value *CVal)
+ {
+  char *ArgNames[4] = {"c1","c2","c3","c4"};
+  int   c;
+
+  f->text[0]  = sg->ColMapExpr1;
+  f->text[1]  = sg->ColMapExpr2;
+  f->text[2]  = sg->ColMapExpr3;
+  f->text[3]  = sg->ColMapExpr4;
+  f->text[4]  = sg->MaskExpr;
+  f->NComps   = 3+(sg->ColMapColSpace==SW_COLSPACE_CMYK);
+  f->NArgs    = NArgs;
+  for (c=0; c<NArgs; c++) f->args[c] = CVal[c];
+  for (c=0; c<5; c++)
+   {
+    f->expr[c]    = NULL;
+    f->trivial[c] = -3;
+    f->errpos[c]  = -1;
+    f->errtext[c] = NULL;
+   }
+  for (c=0; c<5; c++)
+   {
+    if ((c<4) ? (c>=f->NComps) : (sg->MaskExpr[0]=='\0')) continue;
+    f->errtext[c] = (char *)lt_malloc(LSTR_LENGTH);
+    if (f->errtext[c]==NULL) { ppl_error(ERR_MEMORY,-1,-1,"Out of memory."); return 1; }
+    f->expr[c] = ppl_CompileAlgebra(f->text[c], 0, NULL, 0, NArgs, ArgNames, &f->errpos[c], f->errtext[c], 0);
+    if (f->expr[c]==NULL) { f->trivial[c] = -1; continue; }
+    f->trivial[c] = ppl_CompiledAlgebraTrivial(f->expr[c], &f->ConstVal[c]);
+    if ((f->trivial[c]>=0) && !f->args[f->trivial[c]].dimensionless) f->trivial[c] = -1; // Let ppl_EvaluateCompiled() deal with any units
+   }
+  return 0;
+ }
+
+static void eps_plot_colourmap_free(ColMapExprs *f)
+ {
+  int c;
+  for (c=0; c<5; c++) { ppl_CompiledAlgebraFree(f->expr[c]); f->expr[c]=NULL; }
+  return;
+ }
+
+static int eps_plot_colourmap_ThreadSafe(ColMapExprs *f)
+ {
+  int c;
+  for (c=0; c<5; c++) if ((f->expr[c]!=NULL) && (!f->expr[c]->ThreadSafe)) return 0;
+  return 1;
+ }
+
+// Evaluate expression c of f for those of the N pixels in a row which are flagged in live[]; CRow[k][i] is the value of c(k+1) at pixel i.
+// On failure, *ErrPixel is set to the pixel at which the error occurred, or left alone if the error does not depend upon the pixel.
+static int eps_plot_colourmap_EvalRow(ColMapExprs *f, int c, double **CRow, int N, unsigned char *live, value *outval, double *out, int *errpos, int *ErrPixel, char *errtext)
+ {
+  value args[4];
+  int   i, k;
+
+  for (i=0; i<N; i++) if (live[i]) break;
+  if (i==N) return 0;
+
+  if (f->expr[c]==NULL) { *errpos = f->errpos[c]; strcpy(errtext, f->errtext[c]); return 1; }
+  if (f->trivial[c]>=0) // Expression is simply c<n>
+   {
+    double *in = CRow[f->trivial[c]];
+    *outval = f->args[f->trivial[c]];
+    for (i=0; i<N; i++) out[i] = in[i];
+    return 0;
+   }
+  if (f->trivial[c]==-2) // Expression is a constant
+   {
+    *outval = f->ConstVal[c];
+    for (i=0; i<N; i++) out[i] = outval->real;
+    return 0;
+   }
+
+  for (k=0; k<f->NArgs; k++) args[k] = f->args[k];
+  for (i=0; i<N; i++)
+   {
+    if (!live[i]) continue;
+    for (k=0; k<f->NArgs; k++) args[k].real = CRow[k][i];
+    *errpos=-1;
+    ppl_EvaluateCompiled(f->expr[c], args, outval, errpos, errtext, 0);
+    if (*errpos>=0) { *ErrPixel=i; return 1; }
+    if ((c<4) && ((!outval->dimensionless) || (outval->FlagComplex))) { *ErrPixel=i; return 2; } // Caller reports units of outval
+    out[i] = outval->real;
+   }
+  outval->dimensionless = 1; outval->FlagComplex = 0;
+  return 0;
+ }
+
+// Convert colour components in colour space of sg into RGB values in the range 0-1
+static void eps_plot_colourmap_ToRGB(settings_graph *sg, double *comp)
+ {
+  switch (sg->ColMapColSpace)
+   {
+    case SW_COLSPACE_RGB: /* Convert RGB --> RGB */
+     break;
+    case SW_COLSPACE_HSB: /* Convert HSB --> RGB */
+     {
+      double h2, ch, x, m; int h2i;
+      CLIP_COMPS;
+      ch  = comp[1]*comp[2];
+      h2i = (int)(h2 = comp[0] * 6);
+      x   = ch*(1.0-fabs(fmod(h2,2)-1.0));
+      m   = comp[2] - ch;
+      switch (h2i)
+       {
+        case 0 : comp[0]=ch; comp[1]=x ; comp[2]=0 ; break;
+        case 1 : comp[0]=x ; comp[1]=ch; comp[2]=0 ; break;
+        case 2 : comp[0]=0 ; comp[1]=ch; comp[2]=x ; break;
+        case 3 : comp[0]=0 ; comp[1]=x ; comp[2]=ch; break;
+        case 4 : comp[0]=x ; comp[1]=0 ; comp[2]=ch; break;
+        case 5 :
+        case 6 : comp[0]=ch; comp[1]=0 ; comp[2]=x ; break; /* case 6 is for hue=1.0 only */
+        default: comp[0]=0 ; comp[1]=0 ; comp[2]=0 ; break;
+       }
+      comp[0]+=m; comp[1]+=m; comp[2]+=m;
+      break;
+     }
+    case SW_COLSPACE_CMYK: /* Convert CMYK --> RGB */
+     comp[0] = 1.0 - (comp[0]+comp[3]);
+     comp[1] = 1.0 - (comp[1]+comp[3]);
+     comp[2] = 1.0 - (comp[2]+comp[3]);
+     break;
+    default: /* Unknown colour space */
+     comp[0] = comp[1] = comp[2] = 0.0;
+     break;
+   }
+  CLIP_COMPS;
+  return;
+ }
+
+// Fill in the RGB values of a row of N pixels, whose values of c1...c4 are in CRow[0...3][]. The arrays in work[] must each have room for N
+// doubles, and live[] room for N flags. Returns 1 on failure, with an error message in errout. This may be called by several threads at
+// once, provided that each has its own ColMapExprs and workspace.
+// Each expression is evaluated across the row in turn, but errors are reported as if the pixels were coloured in one at a time, each
+// having its mask and then its components evaluated. Once an error is met at some pixel, only the pixels before it are evaluated further,
+// and any error which they give takes its place.
+static int eps_plot_colourmap_row(ColMapExprs *f, settings_graph *sg, double **CRow, int N, unsigned char *rgb, double **work, unsigned char *live, char *errtext, char *errout)
+ {
+  int    i, c, errpos=-1, status, ErrPixel, NEval=N;
+  double comp[4];
+  value  outval;
+
+  for (i=0; i<N; i++) live[i]=1;
+
+  // Check if mask criterion is satisfied
+  if ((f->trivial[4]!=-3) && (N>0))
+   {
+    ErrPixel = 0;
+    if (eps_plot_colourmap_EvalRow(f, 4, CRow, NEval, live, &outval, work[0], &errpos, &ErrPixel, errtext))
+     { sprintf(errout, "Could not evaluate mask expression <%s>. The error, encountered at character position %d, was: '%s'", f->text[4], errpos, errtext); NEval=ErrPixel; }
+    for (i=0; i<NEval; i++) if (work[0][i]==0) live[i]=0;
+   }
+
+  // Compute RGB, HSB or CMYK components
+  for (c=0; c<f->NComps; c++)
+   {
+    for (i=0; i<NEval; i++) if (live[i]) break;
+    if (i==NEval) break; // No pixels left to colour in
+    ErrPixel = i; // Errors which do not depend upon the pixel are met at the first pixel which gets this far
+    status = eps_plot_colourmap_EvalRow(f, c, CRow, NEval, live, &outval, work[c], &errpos, &ErrPixel, errtext);
+    if      (status==1)             sprintf(errout, "Could not evaluate colour expression <%s>. The error, encountered at character position %d, was: '%s'", f->text[c], errpos, errtext);
+    else if (!outval.dimensionless) sprintf(errout, "Expression <%s> for colour component %d returns result with units of <%s>; this should be a dimensionless number in the range 0-1.",f->text[c], c+1, ppl_units_GetUnitStr(&outval, NULL, NULL, 0, 1, 0));
+    else if (outval.FlagComplex)    sprintf(errout, "Expression <%s> for colour component %d returns a complex result.", f->text[c], c+1);
+    else                            ErrPixel = NEval;
+    NEval = ErrPixel;
+    for (i=0; i<NEval; i++) if (live[i] && !gsl_finite(work[c][i])) live[i]=0;
+   }
+  if (NEval<N) return 1;
+
+  // Convert to RGB, and store RGB components
+  for (i=0; i<N; i++)
+   {
+    if (!live[i]) { rgb[3*i] = TRANS_R; rgb[3*i+1] = TRANS_G; rgb[3*i+2] = TRANS_B; continue; }
+    for (c=0; c<3; c++) comp[c] = work[c][i];
+    comp[3] = (f->NComps>3) ? work[3][i] : 0.0;
+    eps_plot_colourmap_ToRGB(sg, comp);
+    rgb[3*i  ] = (unsigned char)floor(comp[0] * 255.99);
+    rgb[3*i+1] = (unsigned char)floor(comp[1] * 255.99);
+    rgb[3*i+2] = (unsigned char)floor(comp[2] * 255.99);
+    if ((rgb[3*i]==TRANS_R)&&(rgb[3*i+1]==TRANS_G)&&(rgb[3*i+2]==TRANS_B)) rgb[3*i+2]++;
+   }
+  return 0;
+ }
+
+// The pixels of a colourmap are coloured in by several threads at once, each working on a band of rows of the image
+typedef struct ColMapBands {
+  settings_graph *sg;
+  DataBlock      *blk;
+  int             Ncol, XSize, YSize, cmax, NThreads;
+  double         *CMin, *CMax;
+  unsigned char  *CLog, *data;
+  ColMapExprs     fns      [MAX_THREADS]; // Each thread has its own copy of the compiled expressions, and its own workspace
+  double         *CRow     [MAX_THREADS][4];
+  double         *work     [MAX_THREADS][4];
+  unsigned char  *live     [MAX_THREADS];
+  char           *errtext  [MAX_THREADS];
+  char           *errout   [MAX_THREADS];
+  int             FailedRow[MAX_THREADS]; // Row of the image at which each thread stopped with an error, or -1
+ } ColMapBands;
+
+// Colour in rows RowStart ... RowEnd-1 of the image, counting from the top, using the expressions and workspace of thread ThreadNo.
+// Returns the row at which an error occurred, or -1 on success.
+static int eps_plot_colourmap_band(ColMapBands *b, int ThreadNo, int RowStart, int RowEnd)
+ {
+  int    r, i, j, c;
+  double val, **CRow = b->CRow[ThreadNo];
+
+  for (r=RowStart; r<RowEnd; r++)
+   {
+    j = b->YSize-1-r; // Postscript images are top-first. Data block is bottom-first.
+
+    // Set values of c1...c4
+    for (c=0; c<=b->cmax; c++)
+     for (i=0; i<b->XSize; i++)
+      {
+       val = b->blk->data_real[c+2 + b->Ncol*(i+b->XSize*j)].d;
+       if      (b->sg->Crenorm[c]==SW_BOOL_FALSE) { CRow[c][i] = val; } // No renormalisation
+       else if (b->CMax[c]==b->CMin[c]) /* Ooops */ { CRow[c][i] = (gsl_finite(val))?0.5:(GSL_NAN); }
+       else if (!b->CLog[c]) /* Linear */         { CRow[c][i] = (val - b->CMin[c]) / (b->CMax[c] - b->CMin[c]); }
+       else                  /* Logarithmic */    { CRow[c][i] = log(val / b->CMin[c]) / log(b->CMax[c] / b->CMin[c]); }
+      }
+
+    if (eps_plot_colourmap_row(b->fns+ThreadNo, b->sg, CRow, b->XSize, b->data+3*(long)b->XSize*r, b->work[ThreadNo], b->live[ThreadNo], b->errtext[ThreadNo], b->errout[ThreadNo])) return r;
+   }
+  return -1;
+ }
+
+static void eps_plot_colourmap_BandThread(void *b_void, int ThreadNo, int NThreads)
+ {
+  ColMapBands *b = (ColMapBands *)b_void;
+  b->FailedRow[ThreadNo] = eps_plot_colourmap_band(b, ThreadNo, (long)b->YSize*ThreadNo/NThreads, (long)b->YSize*(ThreadNo+1)/NThreads);
+  return;
+ }
+
 // Yield up text items which label colour scale of a colourmap
 void eps_plot_colourmap_YieldText(EPSComm *x, DataTable *data, settings_graph *sg, canvas_plotdesc *pd)
  {
@@ -207,15 +462,15 @@ int  eps_plot_colourmap(EPSComm *x, DataTable *data, unsigned char ThreeDim, int
   DataBlock     *blk;
   int            XSize = pd->GridXSize;
   int            YSize = pd->GridYSize;
-  int            i, j, c, cmax, errpos, Ncol, NcolsData;
-  long           p;
-  double         xo, yo, Lx, Ly, ThetaX, ThetaY, comp[4], CMin[4], CMax[4];
-  value         *CVar[4], CDummy[4], outval;
+  int            i, j, c, t, cmax, Ncol, NcolsData;
+  double         xo, yo, Lx, Ly, ThetaX, ThetaY, CMin[4], CMax[4];
+  value          CVal[4];
   uLongf         zlen; // Length of buffer passed to zlib
   unsigned char *imagez, CMinAuto[4], CMinSet[4], CMaxAuto[4], CMaxSet[4], CLog[4];
-  char          *ColExpr[4] = {sg->ColMapExpr1 , sg->ColMapExpr2 , sg->ColMapExpr3 , sg->ColMapExpr4 }, *errtext;
-  unsigned char  component_r, component_g, component_b, transparent[3] = {TRANS_R, TRANS_G, TRANS_B};
+  char          *errtext;
+  unsigned char  transparent[3] = {TRANS_R, TRANS_G, TRANS_B};
   bitmap_data    img;
+  ColMapBands    bands;
 
   if ((data==NULL) || (data->Nrows<1)) return 0; // No data present
   Ncol = data->Ncolumns;
@@ -283,13 +538,11 @@ int  eps_plot_colourmap(EPSComm *x, DataTable *data, unsigned char ThreeDim, int
   img.TargetCompression = BMP_ENCODING_FLATE;
   if (img.data==NULL) { ppl_error(ERR_MEMORY, -1, -1,"Out of memory."); return 1; }
 
-  // Get pointer to variable c in the user's variable space
+  // Work out units of variables c1...c4
   for (i=0; i<4; i++)
    {
-    char v[3]={'c','1'+i,'\0'};
-    ppl_UserSpace_GetVarPointer(v, CVar+i, CDummy+i);
-    if ((i<NcolsData-2)&&(sg->Crenorm[i]==SW_BOOL_FALSE)) { *CVar[i] = data->FirstEntries[i+2]; CVar[i]->FlagComplex=0; CVar[i]->imag=0.0; }
-    else ppl_units_zero(CVar[i]); // c1...c4 are dimensionless numbers in range 0-1, regardless of units of input data
+    if ((i<NcolsData-2)&&(sg->Crenorm[i]==SW_BOOL_FALSE)) { CVal[i] = data->FirstEntries[i+2]; CVal[i].FlagComplex=0; CVal[i].imag=0.0; }
+    else ppl_units_zero(CVal+i); // c1...c4 are dimensionless numbers in range 0-1, regardless of units of input data
    }
 
   // Work out normalisation of variables c1...c4
@@ -334,7 +587,6 @@ int  eps_plot_colourmap(EPSComm *x, DataTable *data, unsigned char ThreeDim, int
     if ((!CMinSet[c])||(!CMaxSet[c]))
      {
       sprintf(temp_err_string, "No data supplied to determine range for variable c%d", c+1);
-      for (i=0; i<4; i++) ppl_UserSpace_RestoreVarPointer(CVar+i, CDummy+i);
       return 0;
      }
 
@@ -350,102 +602,65 @@ int  eps_plot_colourmap(EPSComm *x, DataTable *data, unsigned char ThreeDim, int
 
   // Check that variables c1...c4 has appropriate units
   for (c=0; c<=cmax; c++)
-   if ( ((!CMinAuto[c])||(!CMaxAuto[c])) && (!ppl_units_DimEqual(CVar[c] , (sg->Cminauto[c]==SW_BOOL_TRUE)?(&sg->Cmax[c]):(&sg->Cmin[c]))) )
+   if ( ((!CMinAuto[c])||(!CMaxAuto[c])) && (!ppl_units_DimEqual(CVal+c , (sg->Cminauto[c]==SW_BOOL_TRUE)?(&sg->Cmax[c]):(&sg->Cmin[c]))) )
     {
-     sprintf(temp_err_string, "Column %d of data supplied to the colourmap plot style has conflicting units with those set in the 'set crange' command. The former has units of <%s> whilst the latter has units of <%s>.", c+3, ppl_units_GetUnitStr(CVar[c], NULL, NULL, 0, 1, 0), ppl_units_GetUnitStr((sg->Cminauto[c]==SW_BOOL_TRUE)?(&sg->Cmax[c]):(&sg->Cmin[c]), NULL, NULL, 1, 1, 0));
+     sprintf(temp_err_string, "Column %d of data supplied to the colourmap plot style has conflicting units with those set in the 'set crange' command. The former has units of <%s> whilst the latter has units of <%s>.", c+3, ppl_units_GetUnitStr(CVal+c, NULL, NULL, 0, 1, 0), ppl_units_GetUnitStr((sg->Cminauto[c]==SW_BOOL_TRUE)?(&sg->Cmax[c]):(&sg->Cmin[c]), NULL, NULL, 1, 1, 0));
      ppl_error(ERR_NUMERIC,-1,-1,temp_err_string);
      return 1;
     }
 
-  // Populate bitmap data array
-  for (p=0, j=YSize-1; j>=0; j--) // Postscript images are top-first. Data block is bottom-first.
-   for (i=0; i<XSize; i++)
-    {
-     // Set values of c1...c4
-     for (c=0;c<4; c++)
-      if      (c>cmax)  /* No c<c> */         { *CVar[c]       = CDummy[c]; }
-      else if (sg->Crenorm[c]==SW_BOOL_FALSE) {  CVar[c]->real = blk->data_real[c+2 + Ncol*(i+XSize*j)].d; } // No renormalisation
-      else if (CMax[c]==CMin[c])  /* Ooops */ {  CVar[c]->real = (gsl_finite(blk->data_real[c+2 + Ncol*(i+XSize*j)].d))?0.5:(GSL_NAN); }
-      else if (!CLog[c]) /* Linear */         {  CVar[c]->real = (blk->data_real[c+2 + Ncol*(i+XSize*j)].d - CMin[c]) / (CMax[c] - CMin[c]); }
-      else               /* Logarithmic */    {  CVar[c]->real = log(blk->data_real[c+2 + Ncol*(i+XSize*j)].d / CMin[c]) / log(CMax[c] / CMin[c]); }
-
-#define SET_RGB_COLOUR \
-     /* Check if mask criterion is satisfied */ \
-     if (sg->MaskExpr[0]!='\0') \
-      { \
-       errpos=-1; \
-       ppl_EvaluateAlgebra(sg->MaskExpr, &outval, 0, NULL, 0, &errpos, errtext, 0); \
-       if (errpos>=0) { sprintf(temp_err_string, "Could not evaluate mask expression <%s>. The error, encountered at character position %d, was: '%s'", sg->MaskExpr, errpos, errtext); ppl_error(ERR_NUMERIC,-1,-1,temp_err_string); return 1; } \
-       if (outval.real==0) { component_r = TRANS_R; component_g = TRANS_G; component_b = TRANS_B; goto write_rgb; } \
-      } \
- \
-     /* Compute RGB, HSB or CMYK components */ \
-     comp[3]=0.0; \
-     for (c=0; c<3+(sg->ColMapColSpace==SW_COLSPACE_CMYK); c++) \
-      { \
-       errpos=-1; \
-       ppl_EvaluateAlgebra(ColExpr[c], &outval, 0, NULL, 0, &errpos, errtext, 0); \
-       if (errpos>=0) { sprintf(temp_err_string, "Could not evaluate colour expression <%s>. The error, encountered at character position %d, was: '%s'", ColExpr[c], errpos, errtext); ppl_error(ERR_NUMERIC,-1,-1,temp_err_string); return 1; } \
-       if (!outval.dimensionless) { sprintf(temp_err_string, "Expression <%s> for colour component %d returns result with units of <%s>; this should be a dimensionless number in the range 0-1.",ColExpr[c], c+1, ppl_units_GetUnitStr(&outval, NULL, NULL, 0, 1, 0)); ppl_error(ERR_NUMERIC,-1,-1,temp_err_string); return 1; } \
-       if (outval.FlagComplex) { sprintf(temp_err_string, "Expression <%s> for colour component %d returns a complex result.", ColExpr[c], c+1); ppl_error(ERR_NUMERIC,-1,-1,temp_err_string); return 1; } \
-       if (!gsl_finite(outval.real)) { component_r = TRANS_R; component_g = TRANS_G; component_b = TRANS_B; goto write_rgb; } \
-       comp[c]=outval.real; \
-      } \
- \
-     /* Convert to RGB */ \
-     switch (sg->ColMapColSpace) \
-      { \
-       case SW_COLSPACE_RGB: /* Convert RGB --> RGB */ \
-        break; \
-       case SW_COLSPACE_HSB: /* Convert HSB --> RGB */ \
-        { \
-         double h2, ch, x, m; int h2i; \
-         CLIP_COMPS; \
-         ch  = comp[1]*comp[2]; \
-         h2i = (int)(h2 = comp[0] * 6); \
-         x   = ch*(1.0-fabs(fmod(h2,2)-1.0)); \
-         m   = comp[2] - ch; \
-         switch (h2i) \
-          { \
-           case 0 : comp[0]=ch; comp[1]=x ; comp[2]=0 ; break; \
-           case 1 : comp[0]=x ; comp[1]=ch; comp[2]=0 ; break; \
-           case 2 : comp[0]=0 ; comp[1]=ch; comp[2]=x ; break; \
-           case 3 : comp[0]=0 ; comp[1]=x ; comp[2]=ch; break; \
-           case 4 : comp[0]=x ; comp[1]=0 ; comp[2]=ch; break; \
-           case 5 : \
-           case 6 : comp[0]=ch; comp[1]=0 ; comp[2]=x ; break; /* case 6 is for hue=1.0 only */ \
-           default: comp[0]=0 ; comp[1]=0 ; comp[2]=0 ; break; \
-          } \
-         comp[0]+=m; comp[1]+=m; comp[2]+=m; \
-         break; \
-        } \
-       case SW_COLSPACE_CMYK: /* Convert CMYK --> RGB */ \
-        comp[0] = 1.0 - (comp[0]+comp[3]); \
-        comp[1] = 1.0 - (comp[1]+comp[3]); \
-        comp[2] = 1.0 - (comp[2]+comp[3]); \
-        break; \
-       default: /* Unknown colour space */ \
-        comp[0] = comp[1] = comp[2] = 0.0; \
-        break; \
-      } \
-     CLIP_COMPS; \
- \
-     /* Store RGB components */ \
-     component_r = (unsigned char)floor(comp[0] * 255.99); \
-     component_g = (unsigned char)floor(comp[1] * 255.99); \
-     component_b = (unsigned char)floor(comp[2] * 255.99); \
-     if ((component_r==TRANS_R)&&(component_g==TRANS_G)&&(component_b==TRANS_B)) component_b++; \
- \
-write_rgb: \
-     img.data[p++] = component_r; \
-     img.data[p++] = component_g; \
-     img.data[p++] = component_b; \
-
-     SET_RGB_COLOUR;
-    }
+  // Decide how many threads to split the image between
+  bands.sg       = sg;
+  bands.blk      = blk;
+  bands.Ncol     = Ncol;
+  bands.XSize    = XSize;
+  bands.YSize    = YSize;
+  bands.cmax     = cmax;
+  bands.CMin     = CMin;
+  bands.CMax     = CMax;
+  bands.CLog     = CLog;
+  bands.data     = img.data;
+  bands.NThreads = ppl_threads_count();
+  if (bands.NThreads > (long)XSize*YSize/COLMAP_BAND_PIXELS) bands.NThreads = (long)XSize*YSize/COLMAP_BAND_PIXELS;
+  if (bands.NThreads > YSize) bands.NThreads = YSize;
+  if (bands.NThreads < 1    ) bands.NThreads = 1;
+
+  // Compile colour expressions for each thread, and allocate workspace for evaluating them over one row of pixels at a time.
+  // Expressions which use global state, e.g. which call subroutines, cannot be evaluated in several threads at once.
+  for (t=0; t<bands.NThreads; t++)
+   {
+    for (c=0; c<4; c++)
+     {
+      bands.CRow[t][c] = (double *)lt_malloc(XSize*sizeof(double));
+      bands.work[t][c] = (double *)lt_malloc(XSize*sizeof(double));
+      if ((bands.CRow[t][c]==NULL)||(bands.work[t][c]==NULL)) { ppl_error(ERR_MEMORY, -1, -1,"Out of memory."); COLMAP_FREE_BANDS(t); return 1; }
+     }
+    bands.live   [t] = (unsigned char *)lt_malloc(XSize);
+    bands.errtext[t] = (t==0) ? errtext : (char *)lt_malloc(LSTR_LENGTH);
+    bands.errout [t] = (char *)lt_malloc(LSTR_LENGTH);
+    if ((bands.live[t]==NULL)||(bands.errtext[t]==NULL)||(bands.errout[t]==NULL)) { ppl_error(ERR_MEMORY, -1, -1,"Out of memory."); COLMAP_FREE_BANDS(t); return 1; }
+    if (eps_plot_colourmap_compile(bands.fns+t, sg, cmax+1, CVal)) { COLMAP_FREE_BANDS(t+1); return 1; }
+    if (!eps_plot_colourmap_ThreadSafe(bands.fns)) { bands.NThreads=t+1; break; }
+   }
 
-  // Restore variables c1...c4 in the user's variable space
-  for (i=0; i<4; i++) ppl_UserSpace_RestoreVarPointer(CVar+i, CDummy+i);
+  // Populate bitmap data array
+  if (bands.NThreads > 1)
+   {
+    if (DEBUG) { sprintf(temp_err_string, "Colouring in colourmap using %d threads.", bands.NThreads); ppl_log(temp_err_string); }
+    ppl_threads_run(&eps_plot_colourmap_BandThread, (void *)&bands, bands.NThreads);
+    for (t=0; t<bands.NThreads; t++)
+     if (bands.FailedRow[t]>=0) // Redo the first row which failed in this thread, so that error messages are produced one at a time
+      {
+       bands.FailedRow[0] = eps_plot_colourmap_band(&bands, 0, bands.FailedRow[t], bands.FailedRow[t]+1);
+       break;
+      }
+   }
+  else
+   {
+    bands.FailedRow[0] = eps_plot_colourmap_band(&bands, 0, 0, YSize);
+   }
+  COLMAP_FREE_BANDS(bands.NThreads);
+  if (bands.FailedRow[0]>=0) { ppl_error(ERR_NUMERIC,-1,-1,bands.errout[0]); return 1; }
 
 #define COMPRESS_POSTSCRIPT_IMAGE \
   /* Consider converting RGB data into a paletted image */ \
@@ -461,7 +676,7 @@ write_rgb: \
      imagez = (unsigned char *)lt_malloc(zlen); \
      if (imagez == NULL) { ppl_error(ERR_MEMORY, -1, -1,"Out of memory."); img.TargetCompression = BMP_ENCODING_NULL; break; } \
      if (DEBUG) { ppl_log("Calling zlib to compress image data."); } \
-     j = compress2(imagez,&zlen,img.data,img.data_len,9); /* Call zlib to do deflation */ \
+     j = eps_image_deflate(imagez,&zlen,img.data,img.data_len); /* Call zlib to do deflation */ \
  \
      if (j!=0) \
       { \
@@ -522,8 +737,7 @@ if (img.TargetCompression==BMP_ENCODING_FLATE) img.TargetCompression=BMP_ENCODIN
 
 int  eps_plot_colourmap_DrawScales(EPSComm *x, double origin_x, double origin_y, double width, double height, double zdepth)
  {
-  int              i, j, c, k, errpos;
-  long             p;
+  int              i, j, k;
   double           xmin,xmax,ymin,ymax;
   char            *errtext;
   canvas_plotdesc *pd;
@@ -573,9 +787,9 @@ int  eps_plot_colourmap_DrawScales(EPSComm *x, double origin_x, double origin_y,
     if (pd->CRangeDisplay)
      {
       double              XSize = 1024, YSize = 1; // Dimensions of bitmap image
-      unsigned char       component_r, component_g, component_b, transparent[3] = {TRANS_R, TRANS_G, TRANS_B};
-      char                v[3]="c1";
-      double              x1,y1,x2,y2  ,  x3,y3,x4,y4  ,  theta,dummy  ,  comp[4],CMin,CMax;
+      unsigned char       transparent[3] = {TRANS_R, TRANS_G, TRANS_B}, live[1024];
+      double              x1,y1,x2,y2  ,  x3,y3,x4,y4  ,  theta,dummy  ,  CMin,CMax;
+      double              CRow[1024], WorkSpace[4][1024], *CRowPtr[1] = {CRow}, *work[4] = {WorkSpace[0],WorkSpace[1],WorkSpace[2],WorkSpace[3]};
       double              Lx, Ly, ThetaX, ThetaY;
       unsigned char       CLog;
       const double        MARGIN = EPS_COLOURSCALE_MARGIN * M_TO_PS;
@@ -583,9 +797,9 @@ int  eps_plot_colourmap_DrawScales(EPSComm *x, double origin_x, double origin_y,
       const unsigned char Lr = (sg->ColKeyPos==SW_COLKEYPOS_B)||(sg->ColKeyPos==SW_COLKEYPOS_R);
       uLongf              zlen; // Length of buffer passed to zlib
       unsigned char      *imagez;
-      char               *ColExpr[4] = {sg->ColMapExpr1 , sg->ColMapExpr2 , sg->ColMapExpr3 , sg->ColMapExpr4 };
       bitmap_data         img;
-      value              *CVar=NULL, CDummy, outval;
+      value               CVal;
+      ColMapExprs         fns;
 
       if      (sg->ColKeyPos==SW_COLKEYPOS_T) { x1 = xmin; x2 = xmax; y1 = y2 = x->current->PlotTopMargin   +MARGIN; }
       else if (sg->ColKeyPos==SW_COLKEYPOS_B) { x1 = xmin; x2 = xmax; y1 = y2 = x->current->PlotBottomMargin-MARGIN; }
@@ -624,25 +838,25 @@ int  eps_plot_colourmap_DrawScales(EPSComm *x, double origin_x, double origin_y,
       CMax = pd->CMaxFinal;
       CLog = (sg->Clog[0]==SW_BOOL_TRUE);
 
-      // Get pointer to variable c1 in the user's variable space
-      ppl_UserSpace_GetVarPointer(v, &CVar, &CDummy);
-      if (sg->Crenorm[0]==SW_BOOL_FALSE) { *CVar = data->FirstEntries[2]; CVar->FlagComplex=0; CVar->imag=0.0; }
-      else ppl_units_zero(CVar); // c1...c4 are dimensionless numbers in range 0-1, regardless of units of input data
+      // Work out units of variable c1
+      if (sg->Crenorm[0]==SW_BOOL_FALSE) { CVal = data->FirstEntries[2]; CVal.FlagComplex=0; CVal.imag=0.0; }
+      else ppl_units_zero(&CVal); // c1...c4 are dimensionless numbers in range 0-1, regardless of units of input data
+
+      // Set values of c1 along colour scale
+      for (i=0; i<XSize; i++)
+       {
+        if (sg->Crenorm[0]==SW_BOOL_FALSE)
+         {
+          if (!CLog) CRow[i] = CMin+(CMax-CMin)*((double)i)/(XSize-1);
+          else       CRow[i] = CMin*pow(CMax/CMin,((double)i)/(XSize-1));
+         }
+        else         CRow[i] = ((double)i)/(XSize-1);
+       }
 
       // Populate bitmap data array
-      for (p=0, j=YSize-1; j>=0; j--) // Postscript images are top-first. Data block is bottom-first.
-       for (i=0; i<XSize; i++)
-        {
-         // Set value of c1
-         if (sg->Crenorm[0]==SW_BOOL_FALSE)
-          {
-           if (!CLog) CVar->real = CMin+(CMax-CMin)*((double)i)/(XSize-1);
-           else       CVar->real = CMin*pow(CMax/CMin,((double)i)/(XSize-1));
-          }
-         else         CVar->real = ((double)i)/(XSize-1);
-
-         SET_RGB_COLOUR;
-        }
+      if (eps_plot_colourmap_compile(&fns, sg, 1, &CVal)) { eps_plot_colourmap_free(&fns); return 1; }
+      if (eps_plot_colourmap_row(&fns, sg, CRowPtr, XSize, img.data, work, live, errtext, temp_err_string)) { ppl_error(ERR_NUMERIC,-1,-1,temp_err_string); eps_plot_colourmap_free(&fns); return 1; }
+      eps_plot_colourmap_free(&fns);
 #ifdef FLATE_DISABLE
 if (img.TargetCompression==BMP_ENCODING_FLATE) img.TargetCompression=BMP_ENCODING_NULL;
 #endif
@@ -655,9 +869,6 @@ if (img.TargetCompression==BMP_ENCODING_FLATE) img.TargetCompression=BMP_ENCODIN
        fprintf(x->epsbuffer, "grestore\n");
 
 POST_BITMAP:
-      // Restore variable c1 in the user's variable space
-      if (CVar!=NULL) ppl_UserSpace_RestoreVarPointer(&CVar, &CDummy);
-
       // Paint inner-facing scale
       theta = ((sg->ColKeyPos==SW_COLKEYPOS_T)||(sg->ColKeyPos==SW_COLKEYPOS_B))?M_PI:(M_PI/2);
       if (Lr) theta=theta+M_PI;
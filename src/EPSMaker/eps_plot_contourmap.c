@@ -35,6 +35,7 @@
 #include "ppl_error.h"
 #include "ppl_settings.h"
 #include "ppl_setting_types.h"
+#include "ppl_threads.h"
 #include "ppl_units.h"
 #include "ppl_units_fns.h"
 #include "ppl_userspace.h"
@@ -55,7 +56,8 @@
 #define FACE_B    3
 #define FACE_L    4
 
-#define MAX_CONTOUR_PATHS 1024
+// Minimum number of cells crossed by contours which are traced by each thread
+#define CONTOUR_THREAD_CELLS 4096
 
 typedef struct ContourDesc
  {
@@ -67,6 +69,29 @@ typedef struct ContourDesc
   double         vreal;
  } ContourDesc;
 
+typedef struct ContourLevel
+ {
+  double c;
+  int    k;
+ } ContourLevel;
+
+// The contour levels to be traced, the cells which each one passes through, and the contours traced at each level
+typedef struct ContourLevels
+ {
+  DataTable     *data;
+  int            XSize, YSize, NLevels, NSorted, NThreads;
+  double         Lx, ThetaX, Ly, ThetaY;
+  double         c[MAX_CONTOURS], vreal[MAX_CONTOURS]; // Value of c1 along each level, and value to give variable c1 when drawing it
+  ContourLevel   sorted[MAX_CONTOURS];                 // Finite levels, in ascending order
+  long           CellStart[MAX_CONTOURS+1];            // Cells spanning level k are CellList[CellStart[k]] ... CellList[CellStart[k+1]-1]
+  long           CellFill [MAX_CONTOURS];
+  int           *CellList;
+  ContourDesc   *paths[MAX_CONTOURS];
+  long           Npaths[MAX_CONTOURS], NpathsAlloc[MAX_CONTOURS];
+  unsigned char *split [MAX_THREADS];                  // Usage flags for crossing points, one array for each thread
+  unsigned char  failed[MAX_THREADS];
+ } ContourLevels;
+
 static int ContourCmp(const void *xv, const void *yv)
  {
   const ContourDesc *x = (const ContourDesc *)xv;
@@ -191,7 +216,7 @@ void eps_plot_contourmap_YieldText(EPSComm *x, DataTable *data, settings_graph *
 // Routines for tracking the paths of contours
 
 // -----+-----+-----+-----+
-//      |     |     |     |  blk->split[X] contains flags indicating whether crossing points on lines
+//      |     |     |     |  split[X] contains flags indicating whether crossing points on lines
 //      |     |     |     |  A (in bit 1) and B (in bit 2) have been used.
 //      |     |--A--|     |  on successive passes, bits (3,4), (5,6) are used, etc.
 // -----+-----X-----+-----+
@@ -215,7 +240,7 @@ static int IsBetween(double x, double a, double b, double *f)
  }
 
 // See whether cell X contains any unused starting points for contours
-static int GetStartPoint(double c1, DataTable *data, unsigned char **flags, int XSize, int YSize, int x0, int y0, int EntryFace, int *ExitFace, int *xcell, int *ycell, double *Xout, double *Yout)
+static int GetStartPoint(double c1, DataTable *data, unsigned char *split, unsigned char **flags, int XSize, int YSize, int x0, int y0, int EntryFace, int *ExitFace, int *xcell, int *ycell, double *Xout, double *Yout)
  {
   DataBlock *blk  = data->first;
   int        Ncol = data->Ncolumns;
@@ -226,29 +251,29 @@ static int GetStartPoint(double c1, DataTable *data, unsigned char **flags, int
   *ycell = y0;
 
   if (((EntryFace<0)||(EntryFace==FACE_T)) && (x0<=XSize-2) && (x0>= 0) && (y0>= 0) && (y0<=YSize-1) &&
-       (((blk->split[(x0  )+(y0  )*XSize]>>(0+2*pass))&1)==0) &&
+       (((split[(x0  )+(y0  )*XSize]>>(0+2*pass))&1)==0) &&
        IsBetween(c1, blk->data_real[2+Ncol*((x0  )+(y0  )*XSize)].d, blk->data_real[2+Ncol*((x0+1)+(y0  )*XSize)].d,&f))
-   { *flags = &blk->split[(x0  )+(y0  )*XSize]; *ExitFace=FACE_T; *Xout=x0+f; *Yout=y0; return 1; }
+   { *flags = &split[(x0  )+(y0  )*XSize]; *ExitFace=FACE_T; *Xout=x0+f; *Yout=y0; return 1; }
 
   if (((EntryFace<0)||(EntryFace==FACE_R)) && (x0<=XSize-2) && (x0>=-1) && (y0>= 0) && (y0<=YSize-2) &&
-       (((blk->split[(x0+1)+(y0  )*XSize]>>(1+2*pass))&1)==0) &&
+       (((split[(x0+1)+(y0  )*XSize]>>(1+2*pass))&1)==0) &&
        IsBetween(c1, blk->data_real[2+Ncol*((x0+1)+(y0  )*XSize)].d, blk->data_real[2+Ncol*((x0+1)+(y0+1)*XSize)].d,&f))
-   { *flags = &blk->split[(x0+1)+(y0  )*XSize]; *ExitFace=FACE_R; *Xout=x0+1; *Yout=y0+f; return 1; }
+   { *flags = &split[(x0+1)+(y0  )*XSize]; *ExitFace=FACE_R; *Xout=x0+1; *Yout=y0+f; return 1; }
 
   if (((EntryFace<0)||(EntryFace==FACE_B)) && (x0<=XSize-2) && (x0>= 0) && (y0>=-1) && (y0<=YSize-2) &&
-       (((blk->split[(x0  )+(y0+1)*XSize]>>(0+2*pass))&1)==0) &&
+       (((split[(x0  )+(y0+1)*XSize]>>(0+2*pass))&1)==0) &&
        IsBetween(c1, blk->data_real[2+Ncol*((x0  )+(y0+1)*XSize)].d, blk->data_real[2+Ncol*((x0+1)+(y0+1)*XSize)].d,&f))
-   { *flags = &blk->split[(x0  )+(y0+1)*XSize]; *ExitFace=FACE_B; *Xout=x0+f; *Yout=y0+1; return 1; }
+   { *flags = &split[(x0  )+(y0+1)*XSize]; *ExitFace=FACE_B; *Xout=x0+f; *Yout=y0+1; return 1; }
 
   if (((EntryFace<0)||(EntryFace==FACE_L)) && (x0<=XSize-1) && (x0>= 0) && (y0>= 0) && (y0<=YSize-2) &&
-       (((blk->split[(x0  )+(y0  )*XSize]>>(1+2*pass))&1)==0) &&
+       (((split[(x0  )+(y0  )*XSize]>>(1+2*pass))&1)==0) &&
        IsBetween(c1, blk->data_real[2+Ncol*((x0  )+(y0  )*XSize)].d, blk->data_real[2+Ncol*((x0  )+(y0+1)*XSize)].d,&f))
-   { *flags = &blk->split[(x0  )+(y0  )*XSize]; *ExitFace=FACE_L; *Xout=x0; *Yout=y0+f; return 1; }
+   { *flags = &split[(x0  )+(y0  )*XSize]; *ExitFace=FACE_L; *Xout=x0; *Yout=y0+f; return 1; }
   return 0;
  }
 
 // Given a contour already tracking through cell X from a given face, where to go next?
-static int GetNextPoint(double c1, DataTable *data, int pass, int XSize, int YSize, int x0, int y0, int EntryFace, int *ExitFace, int *xcell, int *ycell, double *Xout, double *Yout)
+static int GetNextPoint(double c1, DataTable *data, unsigned char *split, int pass, int XSize, int YSize, int x0, int y0, int EntryFace, int *ExitFace, int *xcell, int *ycell, double *Xout, double *Yout)
  {
   DataBlock *blk  = data->first;
   int        Ncol = data->Ncolumns;
@@ -258,29 +283,30 @@ static int GetNextPoint(double c1, DataTable *data, int pass, int XSize, int YSi
   for (j=0; j<2; j++)
    {
     if (((j==1       )||(EntryFace==FACE_B)) && (x0<=XSize-2) && (x0>= 0) && (y0>= 0) && (y0<=YSize-1) &&
-         (((blk->split[(x0  )+(y0  )*XSize]>>(0+2*pass))&1)==0) &&
+         (((split[(x0  )+(y0  )*XSize]>>(0+2*pass))&1)==0) &&
          IsBetween(c1, blk->data_real[2+Ncol*((x0  )+(y0  )*XSize)].d, blk->data_real[2+Ncol*((x0+1)+(y0  )*XSize)].d,&f))
-     { blk->split[(x0  )+(y0  )*XSize] |= 1<<(0+2*pass); *ExitFace=FACE_T; *xcell=x0; *ycell=y0-1; *Xout=x0+f; *Yout=y0; return 1; }
+     { split[(x0  )+(y0  )*XSize] |= 1<<(0+2*pass); *ExitFace=FACE_T; *xcell=x0; *ycell=y0-1; *Xout=x0+f; *Yout=y0; return 1; }
 
     if (((j==1       )||(EntryFace==FACE_L)) && (x0<=XSize-2) && (x0>=-1) && (y0>= 0) && (y0<=YSize-2) &&
-         (((blk->split[(x0+1)+(y0  )*XSize]>>(1+2*pass))&1)==0) &&
+         (((split[(x0+1)+(y0  )*XSize]>>(1+2*pass))&1)==0) &&
          IsBetween(c1, blk->data_real[2+Ncol*((x0+1)+(y0  )*XSize)].d, blk->data_real[2+Ncol*((x0+1)+(y0+1)*XSize)].d,&f))
-     { blk->split[(x0+1)+(y0  )*XSize] |= 1<<(1+2*pass); *ExitFace=FACE_R; *xcell=x0+1; *ycell=y0; *Xout=x0+1; *Yout=y0+f; return 1; }
+     { split[(x0+1)+(y0  )*XSize] |= 1<<(1+2*pass); *ExitFace=FACE_R; *xcell=x0+1; *ycell=y0; *Xout=x0+1; *Yout=y0+f; return 1; }
 
     if (((j==1       )||(EntryFace==FACE_T)) && (x0<=XSize-2) && (x0>= 0) && (y0>=-1) && (y0<=YSize-2) &&
-         (((blk->split[(x0  )+(y0+1)*XSize]>>(0+2*pass))&1)==0) &&
+         (((split[(x0  )+(y0+1)*XSize]>>(0+2*pass))&1)==0) &&
          IsBetween(c1, blk->data_real[2+Ncol*((x0  )+(y0+1)*XSize)].d, blk->data_real[2+Ncol*((x0+1)+(y0+1)*XSize)].d,&f))
-     { blk->split[(x0  )+(y0+1)*XSize] |= 1<<(0+2*pass); *ExitFace=FACE_B; *xcell=x0; *ycell=y0+1; *Xout=x0+f; *Yout=y0+1; return 1; }
+     { split[(x0  )+(y0+1)*XSize] |= 1<<(0+2*pass); *ExitFace=FACE_B; *xcell=x0; *ycell=y0+1; *Xout=x0+f; *Yout=y0+1; return 1; }
 
     if (((j==1       )||(EntryFace==FACE_R)) && (x0<=XSize-1) && (x0>= 0) && (y0>= 0) && (y0<=YSize-2) &&
-         (((blk->split[(x0  )+(y0  )*XSize]>>(1+2*pass))&1)==0) &&
+         (((split[(x0  )+(y0  )*XSize]>>(1+2*pass))&1)==0) &&
          IsBetween(c1, blk->data_real[2+Ncol*((x0  )+(y0  )*XSize)].d, blk->data_real[2+Ncol*((x0  )+(y0+1)*XSize)].d,&f))
-     { blk->split[(x0  )+(y0  )*XSize] |= 1<<(1+2*pass); *ExitFace=FACE_L; *xcell=x0-1; *ycell=y0; *Xout=x0; *Yout=y0+f; return 1; }
+     { split[(x0  )+(y0  )*XSize] |= 1<<(1+2*pass); *ExitFace=FACE_L; *xcell=x0-1; *ycell=y0; *Xout=x0; *Yout=y0+f; return 1; }
    }
   return 0;
  }
 
-static void FollowContour(EPSComm *x, DataTable *data, ContourDesc *cd, value *v, unsigned char *flags, int XSize, int YSize, int xcell, int ycell, int face, double xpos, double ypos, double Lx, double ThetaX, double Ly, double ThetaY)
+// Trace one contour from a starting point. The vertex list is malloced, rather than lt_malloced, as contours are traced in several threads at once.
+static void FollowContour(DataTable *data, ContourDesc *cd, double c1, unsigned char *split, unsigned char *flags, int XSize, int YSize, int xcell, int ycell, int face, double xpos, double ypos, double Lx, double ThetaX, double Ly, double ThetaY)
  {
   long   i, j, i_flatest=0;
   int    xcelli=xcell, ycelli=ycell;
@@ -292,7 +318,7 @@ static void FollowContour(EPSComm *x, DataTable *data, ContourDesc *cd, value *v
   *flags |= 1<<(((face==FACE_L)||(face==FACE_R)) + 0);
 
   // Trace path, looking for flattest segment and counting length
-  for (i=1; (GetNextPoint(v->real, data, 0, XSize, YSize, xcell, ycell, face, &face, &xcell, &ycell, &xpos, &ypos)!=0); i++)
+  for (i=1; (GetNextPoint(c1, data, split, 0, XSize, YSize, xcell, ycell, face, &face, &xcell, &ycell, &xpos, &ypos)!=0); i++)
    {
     double grad;
     if (xpos!=xold)
@@ -311,7 +337,7 @@ static void FollowContour(EPSComm *x, DataTable *data, ContourDesc *cd, value *v
   // Fill out information in contour descriptor
   cd->Nvertices_min = cd->Nvertices_max = i;
   cd->segment_flatest = i_flatest;
-  cd->posdata = (double *)lt_malloc((i+8) * 2 * sizeof(double));
+  cd->posdata = (double *)malloc((i+8) * 2 * sizeof(double));
   if (cd->posdata==NULL) return;
 
   // Begin pass one
@@ -323,7 +349,7 @@ static void FollowContour(EPSComm *x, DataTable *data, ContourDesc *cd, value *v
   // Trace path, looking for flattest segment and counting length
   cd->posdata[2*0  ] = xpos;
   cd->posdata[2*0+1] = ypos;
-  for (j=1; (GetNextPoint(v->real, data, 1, XSize, YSize, xcell, ycell, face, &face, &xcell, &ycell, &xpos, &ypos)!=0); j++)
+  for (j=1; (GetNextPoint(c1, data, split, 1, XSize, YSize, xcell, ycell, face, &face, &xcell, &ycell, &xpos, &ypos)!=0); j++)
    {
     cd->posdata[2*j  ] = xpos;
     cd->posdata[2*j+1] = ypos;
@@ -331,32 +357,178 @@ static void FollowContour(EPSComm *x, DataTable *data, ContourDesc *cd, value *v
   return;
  }
 
+// Find the range of entries in the sorted list of contour levels which lie between the extremal values at the corners of cell (x0,y0)
+static int CellLevelRange(ContourLevels *cl, int x0, int y0, int *lo, int *hi)
+ {
+  DataBlock *blk  = cl->data->first;
+  int        Ncol = cl->data->Ncolumns;
+  int        i, a, b, m, set=0;
+  double     min=0, max=0;
+
+  for (i=0; i<4; i++)
+   {
+    double val = blk->data_real[2+Ncol*((x0+(i&1))+(y0+(i>>1))*cl->XSize)].d;
+    if (!gsl_finite(val)) continue;
+    if ((!set)||(val<min)) min=val;
+    if ((!set)||(val>max)) max=val;
+    set=1;
+   }
+  if (!set) return 0;
+
+  for (a=0, b=cl->NSorted; a<b; ) { m=(a+b)/2; if (cl->sorted[m].c <  min) a=m+1; else b=m; }
+  *lo = a;
+  for (      b=cl->NSorted; a<b; ) { m=(a+b)/2; if (cl->sorted[m].c <= max) a=m+1; else b=m; }
+  *hi = a;
+  return (*hi > *lo);
+ }
+
+static int ContourLevelCmp(const void *xv, const void *yv)
+ {
+  const ContourLevel *x = (const ContourLevel *)xv;
+  const ContourLevel *y = (const ContourLevel *)yv;
+
+  if      (x->c < y->c) return -1;
+  else if (x->c > y->c) return  1;
+  else                  return x->k - y->k;
+ }
+
+// Make a list, for each contour level, of the cells whose corners span it. The lists are built by counting sort in two sweeps over the grid,
+// so that the time taken does not scale with the number of levels, and a level's list is in the row-major order in which cells were scanned.
+static int ContourIndexCells(ContourLevels *cl)
+ {
+  int  i, j, k, s, lo, hi;
+  long total;
+
+  for (k=0, cl->NSorted=0; k<cl->NLevels; k++)
+   if (gsl_finite(cl->c[k])) { cl->sorted[cl->NSorted].c = cl->c[k]; cl->sorted[cl->NSorted].k = k; cl->NSorted++; }
+  qsort((void *)cl->sorted, cl->NSorted, sizeof(ContourLevel), ContourLevelCmp);
+
+  for (k=0; k<=cl->NLevels; k++) cl->CellStart[k]=0;
+  for (j=0; j<cl->YSize-1; j++)
+   for (i=0; i<cl->XSize-1; i++)
+    if (CellLevelRange(cl, i, j, &lo, &hi))
+     for (s=lo; s<hi; s++) cl->CellStart[cl->sorted[s].k + 1]++;
+
+  for (k=0; k<cl->NLevels; k++) cl->CellStart[k+1] += cl->CellStart[k];
+  total = cl->CellStart[cl->NLevels];
+  cl->CellList = (int *)malloc((total>0 ? total : 1) * sizeof(int));
+  if (cl->CellList==NULL) return 1;
+
+  for (k=0; k<cl->NLevels; k++) cl->CellFill[k] = cl->CellStart[k];
+  for (j=0; j<cl->YSize-1; j++)
+   for (i=0; i<cl->XSize-1; i++)
+    if (CellLevelRange(cl, i, j, &lo, &hi))
+     for (s=lo; s<hi; s++) cl->CellList[ cl->CellFill[cl->sorted[s].k]++ ] = i + cl->XSize*j;
+  return 0;
+ }
+
+// Add a new entry to the list of contours traced at level k
+static ContourDesc *ContourNewPath(ContourLevels *cl, int k, unsigned char closepath)
+ {
+  ContourDesc *cd;
+
+  if (cl->Npaths[k] >= cl->NpathsAlloc[k])
+   {
+    long         n   = (cl->NpathsAlloc[k] < 16) ? 16 : 2*cl->NpathsAlloc[k];
+    ContourDesc *new = (ContourDesc *)realloc((void *)cl->paths[k], n*sizeof(ContourDesc));
+    if (new==NULL) return NULL;
+    cl->paths[k] = new;
+    cl->NpathsAlloc[k] = n;
+   }
+  cd = &cl->paths[k][ cl->Npaths[k]++ ];
+  cd->i         = k;
+  cd->vreal     = cl->vreal[k];
+  cd->closepath = closepath;
+  cd->posdata   = NULL;
+  return cd;
+ }
+
+#define TRACE_FROM_START_POINT(X0,Y0,FACE,CLOSE) \
+  if (GetStartPoint(c1, cl->data, split, &flags, XSize, YSize, X0, Y0, FACE, &face, &xcell, &ycell, &xpos, &ypos)) \
+   { \
+    if ((cd = ContourNewPath(cl, k, CLOSE))==NULL) { failed=1; break; } \
+    FollowContour(cl->data, cd, c1, split, flags, XSize, YSize, xcell, ycell, face, xpos, ypos, cl->Lx, cl->ThetaX, cl->Ly, cl->ThetaY); \
+   }
+
+// Trace all of the contours at level k, using the array split of usage flags, which must be zero on entry and is cleared again on exit
+static int ContourTraceLevel(ContourLevels *cl, int k, unsigned char *split)
+ {
+  int            XSize = cl->XSize, YSize = cl->YSize;
+  int            i, face, xcell, ycell, failed=0;
+  long           n;
+  double         c1 = cl->c[k], xpos, ypos;
+  unsigned char *flags;
+  ContourDesc   *cd;
+
+  // Scan edges of plot looking for contour start points
+  for (i=0; (i<XSize-1)&&(!failed); i++) { TRACE_FROM_START_POINT(i        , 0        , FACE_T, 0); } // Top face
+  for (i=0; (i<YSize-1)&&(!failed); i++) { TRACE_FROM_START_POINT(XSize-2  , i        , FACE_R, 0); } // Right face
+  for (i=0; (i<XSize-1)&&(!failed); i++) { TRACE_FROM_START_POINT(XSize-2-i, YSize-2  , FACE_B, 0); } // Bottom face
+  for (i=0; (i<YSize-1)&&(!failed); i++) { TRACE_FROM_START_POINT(0        , YSize-2-i, FACE_L, 0); } // Left face
+
+  // Scan body of plot looking for undrawn contours. Only cells whose corners span this level can contain start points.
+  for (n=cl->CellStart[k]; (n<cl->CellStart[k+1])&&(!failed); n++)
+   { TRACE_FROM_START_POINT(cl->CellList[n]%XSize, cl->CellList[n]/XSize, FACE_ALL, 1); }
+
+  // Every crossing point which has been used lies on an edge of one of these cells, and its flags are stored at one of the cell's corners
+  if ((XSize<2)||(YSize<2)) { memset(split, 0, XSize*YSize); return failed; }
+  for (n=cl->CellStart[k]; n<cl->CellStart[k+1]; n++)
+   {
+    int c = cl->CellList[n];
+    split[c] = split[c+1] = split[c+XSize] = split[c+XSize+1] = 0;
+   }
+  return failed;
+ }
+
+static void ContourTraceThread(void *arg, int ThreadNo, int NThreads)
+ {
+  ContourLevels *cl = (ContourLevels *)arg;
+  int            k;
+
+  for (k=ThreadNo; (k<cl->NLevels)&&(!cl->failed[ThreadNo]); k+=NThreads) cl->failed[ThreadNo] = ContourTraceLevel(cl, k, cl->split[ThreadNo]);
+  return;
+ }
+
+static void ContourLevelsFree(ContourLevels *cl)
+ {
+  int  k;
+  long n;
+
+  for (k=0; k<cl->NLevels; k++)
+   {
+    for (n=0; n<cl->Npaths[k]; n++) if (cl->paths[k][n].posdata!=NULL) free(cl->paths[k][n].posdata);
+    if (cl->paths[k]!=NULL) free(cl->paths[k]);
+   }
+  for (k=0; k<MAX_THREADS; k++) if (cl->split[k]!=NULL) free(cl->split[k]);
+  if (cl->CellList!=NULL) free(cl->CellList);
+  return;
+ }
+
 // Render a contourmap to postscript
 int  eps_plot_contourmap(EPSComm *x, DataTable *data, unsigned char ThreeDim, int xn, int yn, int zn, settings_graph *sg, canvas_plotdesc *pd, int pdn, double origin_x, double origin_y, double width, double height, double zdepth)
  {
   double         scale_x, scale_y, scale_z;
-  DataBlock     *blk;
   int            XSize = (x->current->settings.SamplesXAuto==SW_BOOL_TRUE) ? x->current->settings.samples : x->current->settings.SamplesX;
   int            YSize = (x->current->settings.SamplesYAuto==SW_BOOL_TRUE) ? x->current->settings.samples : x->current->settings.SamplesY;
-  int            i, j, k, cn, pass, Ncol, face, xcell, ycell;
+  int            i, k, t, pass, Ncol;
+  long           cn, n, cpos=0;
   double         xo, yo, Lx, Ly, ThetaX, ThetaY, CMin, CMax, xpos, ypos;
   double         col=GSL_NAN,col1=-1,col2=-1,col3=-1,col4=-1,fc=GSL_NAN,fc1=-1,fc2=-1,fc3=-1,fc4=-1;
-  unsigned char  CLog, CMinAuto, CMaxAuto, CRenorm, *flags;
+  unsigned char  CLog, CMinAuto, CMaxAuto, CRenorm;
   char          *errtext, c1name[]="c1";
   value         *CVar=NULL, CDummy;
   ContourDesc   *clist;
-  int            cpos=0;
+  ContourLevels  cl;
 
   if ((data==NULL) || (data->Nrows<1)) return 0; // No data present
   Ncol = data->Ncolumns;
   // if (eps_plot_WithWordsCheckUsingItemsDimLess(&pd->ww_final, data->FirstEntries, Ncol, NULL)) return 1;
   if (!ThreeDim) { scale_x=width; scale_y=height; scale_z=1.0;    }
   else           { scale_x=width; scale_y=height; scale_z=zdepth; }
-  blk = data->first;
 
-  clist   = (ContourDesc *)lt_malloc(MAX_CONTOUR_PATHS * sizeof(ContourDesc));
+  memset((void *)&cl, 0, sizeof(ContourLevels));
   errtext = lt_malloc(LSTR_LENGTH);
-  if ((clist==NULL)||(errtext==NULL)) { ppl_error(ERR_MEMORY,-1,-1,"Out of memory."); return 1; }
+  if (errtext==NULL) { ppl_error(ERR_MEMORY,-1,-1,"Out of memory."); return 1; }
 
   // Work out orientation of contourmap
   if (!ThreeDim)
@@ -425,94 +597,82 @@ int  eps_plot_contourmap(EPSComm *x, DataTable *data, unsigned char ThreeDim, in
     return 1;
    }
 
-  // Get pointer to variable c1 in the user's variable space
-  ppl_UserSpace_GetVarPointer(c1name, &CVar, &CDummy);
-  if (!CRenorm) { *CVar = pd->CRangeUnit; CVar->FlagComplex=0; CVar->imag=0.0; }
-  else ppl_units_zero(CVar); // c1 is a dimensionless number in range 0-1, regardless of units of input data
-
-  // Loop over contours
+  // Work out the value of c1 along each contour, and the value to give variable c1 when drawing it
   for (k=0;
        (k<MAX_CONTOURS) && (  ((sg->ContoursListLen< 0) && (k<sg->ContoursN))  ||
                               ((sg->ContoursListLen>=0) && (k<sg->ContoursListLen))  );
        k++)
    {
-    value v = pd->CRangeUnit;
+    double v, vreal;
 
-    if (sg->ContoursListLen< 0) v.real = CLog?(CMin*pow(CMax/CMin,(k+0.5*CMinAuto)/(sg->ContoursN-0.5*((!CMinAuto)+(!CMaxAuto)))))
-                                             :(CMin+(CMax-CMin)*(k+0.5*CMinAuto)/(sg->ContoursN-0.5*((!CMinAuto)+(!CMaxAuto))));
-    else                        v.real = sg->ContoursList[k];
+    if (sg->ContoursListLen< 0) v = CLog?(CMin*pow(CMax/CMin,(k+0.5*CMinAuto)/(sg->ContoursN-0.5*((!CMinAuto)+(!CMaxAuto)))))
+                                        :(CMin+(CMax-CMin)*(k+0.5*CMinAuto)/(sg->ContoursN-0.5*((!CMinAuto)+(!CMaxAuto))));
+    else                        v = sg->ContoursList[k];
 
     // Write debugging output
     if (DEBUG)
      {
-      sprintf(temp_err_string, "Beginning to trace path of contour at c1=%g.", v.real);
+      sprintf(temp_err_string, "Beginning to trace path of contour at c1=%g.", v);
       ppl_log(temp_err_string);
      }
 
-    // Reset contour map usage flags
-    for (j=0; j<YSize; j++)
-     for (i=0; i<XSize; i++)
-      blk->split[i+XSize*j] = 0;
-
-    // Set value of c1
     if (CRenorm)
      {
-      if (sg->ContoursListLen< 0)  CVar->real = ((double)(k+1)/(sg->ContoursN+1));
-      else                         CVar->real = CLog?(log(v.real/CMin) / log(CMax/CMin))
-                                                    :((v.real-CMin)/(CMax-CMin));
-      if (CVar->real<0.0)          CVar->real=0.0;
-      if (CVar->real>1.0)          CVar->real=1.0;
-      if (!gsl_finite(CVar->real)) CVar->real=0.5;
+      if (sg->ContoursListLen< 0)  vreal = ((double)(k+1)/(sg->ContoursN+1));
+      else                         vreal = CLog?(log(v/CMin) / log(CMax/CMin))
+                                               :((v-CMin)/(CMax-CMin));
+      if (vreal<0.0)          vreal=0.0;
+      if (vreal>1.0)          vreal=1.0;
+      if (!gsl_finite(vreal)) vreal=0.5;
      }
-    else                           CVar->real = v.real;
-
-    // Scan edges of plot looking for contour start points
-    for (i=0; i<XSize-1; i++) // Top face
-     if (GetStartPoint(v.real, data, &flags, XSize, YSize, i        , 0        , FACE_T,&face,&xcell,&ycell,&xpos,&ypos))
-      {
-       clist[cpos].i=k; clist[cpos].vreal=CVar->real;
-       clist[cpos].closepath = 0;
-       FollowContour(x, data, &clist[cpos], &v, flags, XSize, YSize, xcell, ycell, face, xpos, ypos, Lx, ThetaX, Ly, ThetaY);
-       if (++cpos>=MAX_CONTOUR_PATHS) goto GOT_CONTOURS;
-      }
-    for (i=0; i<YSize-1; i++) // Right face
-     if (GetStartPoint(v.real, data, &flags, XSize, YSize, XSize-2  , i        , FACE_R,&face,&xcell,&ycell,&xpos,&ypos))
-      {
-       clist[cpos].i=k; clist[cpos].vreal=CVar->real;
-       clist[cpos].closepath = 0;
-       FollowContour(x, data, &clist[cpos], &v, flags, XSize, YSize, xcell, ycell, face, xpos, ypos, Lx, ThetaX, Ly, ThetaY);
-       if (++cpos>=MAX_CONTOUR_PATHS) goto GOT_CONTOURS;
-      }
-    for (i=0; i<XSize-1; i++) // Bottom face
-     if (GetStartPoint(v.real, data, &flags, XSize, YSize, XSize-2-i, YSize-2  , FACE_B,&face,&xcell,&ycell,&xpos,&ypos))
-      {
-       clist[cpos].i=k; clist[cpos].vreal=CVar->real;
-       clist[cpos].closepath = 0;
-       FollowContour(x, data, &clist[cpos], &v, flags, XSize, YSize, xcell, ycell, face, xpos, ypos, Lx, ThetaX, Ly, ThetaY);
-       if (++cpos>=MAX_CONTOUR_PATHS) goto GOT_CONTOURS;
-      }
-    for (i=0; i<YSize-1; i++) // Left face
-     if (GetStartPoint(v.real, data, &flags, XSize, YSize, 0        , YSize-2-i, FACE_L,&face,&xcell,&ycell,&xpos,&ypos))
-      {
-       clist[cpos].i=k; clist[cpos].vreal=CVar->real;
-       clist[cpos].closepath = 0;
-       FollowContour(x, data, &clist[cpos], &v, flags, XSize, YSize, xcell, ycell, face, xpos, ypos, Lx, ThetaX, Ly, ThetaY);
-       if (++cpos>=MAX_CONTOUR_PATHS) goto GOT_CONTOURS;
-      }
-
-    // Scan body of plot looking for undrawn contours
-    for (j=0; j<YSize-1; j++)
-     for (i=0; i<XSize-1; i++)
-      if (GetStartPoint(v.real, data, &flags, XSize, YSize, i, j, FACE_ALL,&face,&xcell,&ycell,&xpos,&ypos))
-       {
-        clist[cpos].i=k; clist[cpos].vreal=CVar->real;
-        clist[cpos].closepath = 1;
-        FollowContour(x, data, &clist[cpos], &v, flags, XSize, YSize, xcell, ycell, face, xpos, ypos, Lx, ThetaX, Ly, ThetaY);
-        if (++cpos>=MAX_CONTOUR_PATHS) goto GOT_CONTOURS;
-       }
-   } // Finish looping over contours we are to trace
+    else                      vreal = v;
+
+    cl.c    [k] = v;
+    cl.vreal[k] = vreal;
+    cl.NLevels  = k+1;
+   }
 
-GOT_CONTOURS:
+  // Find which cells each contour passes through, in a single sweep over the grid for all levels
+  cl.data   = data;
+  cl.XSize  = XSize;
+  cl.YSize  = YSize;
+  cl.Lx     = Lx;
+  cl.ThetaX = ThetaX;
+  cl.Ly     = Ly;
+  cl.ThetaY = ThetaY;
+  if (ContourIndexCells(&cl)) { ppl_error(ERR_MEMORY,-1,-1,"Out of memory."); ContourLevelsFree(&cl); return 1; }
+
+  // Decide how many threads to split the contour levels between
+  cl.NThreads = ppl_threads_count();
+  if (cl.NThreads > cl.CellStart[cl.NLevels]/CONTOUR_THREAD_CELLS) cl.NThreads = cl.CellStart[cl.NLevels]/CONTOUR_THREAD_CELLS;
+  if (cl.NThreads > cl.NLevels) cl.NThreads = cl.NLevels;
+  if (cl.NThreads < 1         ) cl.NThreads = 1;
+  for (t=0; t<cl.NThreads; t++)
+   if ((cl.split[t] = (unsigned char *)calloc(XSize*YSize, 1))==NULL)
+    {
+     if (t==0) { ppl_error(ERR_MEMORY,-1,-1,"Out of memory."); ContourLevelsFree(&cl); return 1; }
+     cl.NThreads = t;
+    }
+
+  // Trace contours
+  if ((DEBUG) && (cl.NThreads > 1)) { sprintf(temp_err_string, "Tracing contours using %d threads.", cl.NThreads); ppl_log(temp_err_string); }
+  ppl_threads_run(&ContourTraceThread, (void *)&cl, cl.NThreads);
+  for (t=0; t<cl.NThreads; t++)
+   if (cl.failed[t]) { ppl_error(ERR_MEMORY,-1,-1,"Out of memory."); ContourLevelsFree(&cl); return 1; }
+
+  // Gather contours into a single list, in order of level
+  for (k=0, cpos=0; k<cl.NLevels; k++) cpos += cl.Npaths[k];
+  clist = (ContourDesc *)lt_malloc((cpos>0 ? cpos : 1) * sizeof(ContourDesc));
+  if (clist==NULL) { ppl_error(ERR_MEMORY,-1,-1,"Out of memory."); ContourLevelsFree(&cl); return 1; }
+  for (k=0, cn=0; k<cl.NLevels; k++)
+   for (n=0; n<cl.Npaths[k]; n++)
+    clist[cn++] = cl.paths[k][n];
+
+  // Get pointer to variable c1 in the user's variable space. This is done after all of the allocations above, which
+  // return early on failure, so that the variable is always restored.
+  ppl_UserSpace_GetVarPointer(c1name, &CVar, &CDummy);
+  if (!CRenorm) { *CVar = pd->CRangeUnit; CVar->FlagComplex=0; CVar->imag=0.0; }
+  else ppl_units_zero(CVar); // c1 is a dimensionless number in range 0-1, regardless of units of input data
 
 #define XPOS_TO_POSTSCRIPT \
  { \
@@ -824,6 +984,7 @@ GOT_CONTOURS:
   // Reset value of variable c1
   if (CVar!=NULL) ppl_UserSpace_RestoreVarPointer(&CVar, &CDummy);
 
+  ContourLevelsFree(&cl);
   return 0;
  }
 
@@ -26,8 +26,8 @@
 #include <math.h>
 #include <string.h>
 
-#include "ListTools/lt_memory.h"
-#include "ListTools/lt_list.h"
+#include "ppl_error.h"
+#include "ppl_settings.h"
 
 #include "eps_comm.h"
 #include "eps_core.h"
@@ -38,21 +38,53 @@
 unsigned char  ThreeDimBuffer_ACTIVE        = 0;
 static long    ThreeDimBuffer_LineSegmentID = 0;
 static double  ThreeDimBuffer_LineLength    = 0.0;
-static List   *ThreeDimBuffer_buffer        = NULL;
 
 static int     linetype_old  ; static int linetype_old_SET  ;
 static double  linewidth_old ; static int linewidth_old_SET ;
 static double  pointsize_old ; static int pointsize_old_SET ;
 static char   *colstr_old;
 
+// Items held in memory, in chunks
+static ThreeDimBufferChunk **ThreeDimBuffer_chunks   = NULL;
+static long                  ThreeDimBuffer_Nchunks  = 0, ThreeDimBuffer_ChunksAlloc = 0;
+static long                  ThreeDimBuffer_Nitems   = 0;
+
+// Text of PostScript fragments held in memory, each terminated by a null
+static char *ThreeDimBuffer_text      = NULL;
+static long  ThreeDimBuffer_TextLen   = 0, ThreeDimBuffer_TextAlloc = 0;
+
+// Table of colour strings, so that each item need only store an index into it. Strings are looked up in an open-addressed hash table.
+static char **ThreeDimBuffer_colours  = NULL;
+static int    ThreeDimBuffer_Ncolours = 0, ThreeDimBuffer_ColoursAlloc = 0;
+static int   *ThreeDimBuffer_ColHash  = NULL; // Contains colour index plus one, or zero for an empty slot
+static int    ThreeDimBuffer_ColHashSize = 0, ThreeDimBuffer_ColLast = -1;
+
+// Temporary files containing runs of items which have been sorted by depth
+static FILE  *ThreeDimBuffer_runs  [THREEDIMBUFF_MAX_RUNS];
+static long   ThreeDimBuffer_RunLen[THREEDIMBUFF_MAX_RUNS];
+static int    ThreeDimBuffer_Nruns = 0;
+
 void ThreeDimBuffer_Reset()
  {
+  int i;
+
   ThreeDimBuffer_ACTIVE        = 0;
   ThreeDimBuffer_LineSegmentID = 0;
   ThreeDimBuffer_LineLength    = 0.0;
-  ThreeDimBuffer_buffer        = NULL;
   linetype_old_SET = linewidth_old_SET = pointsize_old_SET = 0;
   colstr_old = NULL;
+
+  for (i=0; i<ThreeDimBuffer_Nchunks; i++) free(ThreeDimBuffer_chunks[i]);
+  for (i=0; i<ThreeDimBuffer_Nruns  ; i++) fclose(ThreeDimBuffer_runs[i]);
+  if (ThreeDimBuffer_chunks  != NULL) free(ThreeDimBuffer_chunks );
+  if (ThreeDimBuffer_text    != NULL) free(ThreeDimBuffer_text   );
+  if (ThreeDimBuffer_colours != NULL) free(ThreeDimBuffer_colours);
+  if (ThreeDimBuffer_ColHash != NULL) free(ThreeDimBuffer_ColHash);
+  ThreeDimBuffer_chunks  = NULL; ThreeDimBuffer_Nchunks  = ThreeDimBuffer_ChunksAlloc  = ThreeDimBuffer_Nitems = 0;
+  ThreeDimBuffer_text    = NULL; ThreeDimBuffer_TextLen  = ThreeDimBuffer_TextAlloc    = 0;
+  ThreeDimBuffer_colours = NULL; ThreeDimBuffer_Ncolours = ThreeDimBuffer_ColoursAlloc = 0;
+  ThreeDimBuffer_ColHash = NULL; ThreeDimBuffer_ColHashSize = 0; ThreeDimBuffer_ColLast = -1;
+  ThreeDimBuffer_Nruns   = 0;
   return;
  }
 
@@ -62,65 +94,286 @@ int ThreeDimBuffer_Activate(EPSComm *x)
   ThreeDimBuffer_ACTIVE        = 1;
   ThreeDimBuffer_LineSegmentID = 0;
   ThreeDimBuffer_LineLength    = 0.0;
-  ThreeDimBuffer_buffer        = ListInit();
   linetype_old_SET = linewidth_old_SET = pointsize_old_SET = 0;
   colstr_old = NULL;
-  return (ThreeDimBuffer_buffer != NULL);
+  return 1;
+ }
+
+// Look up a colour string in the table of interned colours, adding it if necessary. Returns -1 if out of memory.
+static int ThreeDimBuffer_InternColour(char *colstr)
+ {
+  unsigned long h=5381;
+  int           i, j;
+  char         *c;
+
+  if ((ThreeDimBuffer_ColLast>=0) && ((ThreeDimBuffer_colours[ThreeDimBuffer_ColLast]==colstr) || (strcmp(ThreeDimBuffer_colours[ThreeDimBuffer_ColLast], colstr)==0))) return ThreeDimBuffer_ColLast;
+
+  // Grow hash table so that it is never more than half full
+  if (2*(ThreeDimBuffer_Ncolours+1) > ThreeDimBuffer_ColHashSize)
+   {
+    int  size = (ThreeDimBuffer_ColHashSize < 64) ? 64 : 2*ThreeDimBuffer_ColHashSize;
+    int *hash = (int *)calloc(size, sizeof(int));
+    if (hash==NULL) return -1;
+    for (i=0; i<ThreeDimBuffer_Ncolours; i++)
+     {
+      unsigned long h2=5381;
+      for (c=ThreeDimBuffer_colours[i]; *c!='\0'; c++) h2 = h2*33 + (unsigned char)*c;
+      for (j=h2&(size-1); hash[j]!=0; j=(j+1)&(size-1));
+      hash[j] = i+1;
+     }
+    if (ThreeDimBuffer_ColHash!=NULL) free(ThreeDimBuffer_ColHash);
+    ThreeDimBuffer_ColHash     = hash;
+    ThreeDimBuffer_ColHashSize = size;
+   }
+
+  for (c=colstr; *c!='\0'; c++) h = h*33 + (unsigned char)*c;
+  for (j=h&(ThreeDimBuffer_ColHashSize-1); ThreeDimBuffer_ColHash[j]!=0; j=(j+1)&(ThreeDimBuffer_ColHashSize-1))
+   if (strcmp(ThreeDimBuffer_colours[ThreeDimBuffer_ColHash[j]-1], colstr)==0) return (ThreeDimBuffer_ColLast = ThreeDimBuffer_ColHash[j]-1);
+
+  // Colour string is new. Callers' colour strings persist until the plot is finished, so we store a pointer to it.
+  if (ThreeDimBuffer_Ncolours >= ThreeDimBuffer_ColoursAlloc)
+   {
+    int    n   = (ThreeDimBuffer_ColoursAlloc < 32) ? 32 : 2*ThreeDimBuffer_ColoursAlloc;
+    char **new = (char **)realloc((void *)ThreeDimBuffer_colours, n*sizeof(char *));
+    if (new==NULL) return -1;
+    ThreeDimBuffer_colours      = new;
+    ThreeDimBuffer_ColoursAlloc = n;
+   }
+  ThreeDimBuffer_colours[ThreeDimBuffer_Ncolours] = colstr;
+  ThreeDimBuffer_ColHash[j] = ++ThreeDimBuffer_Ncolours;
+  return (ThreeDimBuffer_ColLast = ThreeDimBuffer_Ncolours-1);
+ }
+
+// Sort key for depths, such that items in the order of ascending keys run from the back to the front
+static unsigned long long ThreeDimBuffer_DepthKey(double depth)
+ {
+  unsigned long long u;
+  if (depth==0.0) depth=0.0; // Treat -0 and +0 alike
+  memcpy((void *)&u, (void *)&depth, sizeof(u));
+  u = (u>>63) ? ~u : (u | (1ULL<<63));
+  return ~u;
  }
 
-struct DepthArrayEntry { double depth; void *item; };
+// Sort the items held in memory from back to front, with a stable radix sort on depth. Returns a malloced array of item numbers, or NULL.
+static int *ThreeDimBuffer_sort()
+ {
+  long                N = ThreeDimBuffer_Nitems, count[256], i, n;
+  int                 shift, *idx, *idx2, *itmp;
+  unsigned long long *key, *key2, *ktmp;
+
+  key  = (unsigned long long *)malloc((N+1)*sizeof(unsigned long long));
+  key2 = (unsigned long long *)malloc((N+1)*sizeof(unsigned long long));
+  idx  = (int *)malloc((N+1)*sizeof(int));
+  idx2 = (int *)malloc((N+1)*sizeof(int));
+  if ((key==NULL)||(key2==NULL)||(idx==NULL)||(idx2==NULL))
+   {
+    if (key !=NULL) free(key );
+    if (key2!=NULL) free(key2);
+    if (idx !=NULL) free(idx );
+    if (idx2!=NULL) free(idx2);
+    return NULL;
+   }
+
+  for (i=0; i<N; i++) { key[i] = ThreeDimBuffer_DepthKey(ThreeDimBuffer_chunks[i/THREEDIMBUFF_CHUNK]->depth[i%THREEDIMBUFF_CHUNK]); idx[i]=i; }
+
+  for (shift=0; shift<64; shift+=8)
+   {
+    memset((void *)count, 0, sizeof(count));
+    for (i=0; i<N; i++) count[(key[i]>>shift)&255]++;
+    if ((N==0) || (count[(key[0]>>shift)&255]==N)) continue; // All items have the same value of this digit
+    for (i=0, n=0; i<256; i++) { long c=count[i]; count[i]=n; n+=c; }
+    for (i=0; i<N; i++)
+     {
+      long j = count[(key[i]>>shift)&255]++;
+      key2[j] = key[i];
+      idx2[j] = idx[i];
+     }
+    ktmp=key; key=key2; key2=ktmp;
+    itmp=idx; idx=idx2; idx2=itmp;
+   }
+  free(key); free(key2); free(idx2);
+  return idx;
+ }
 
-static int ThreeDimBuffer_qsort_slave(const void *x, const void *y)
+// Fetch item number i from memory
+static void ThreeDimBuffer_GetItem(long i, ThreeDimBufferItem *item, char **psfrag)
  {
-  const struct DepthArrayEntry *x1 = (const struct DepthArrayEntry *)x;
-  const struct DepthArrayEntry *y1 = (const struct DepthArrayEntry *)y;
+  ThreeDimBufferChunk *c = ThreeDimBuffer_chunks[i/THREEDIMBUFF_CHUNK];
+  long                 j = i%THREEDIMBUFF_CHUNK;
 
-  if      (x1->depth > y1->depth) return -1.0;
-  else if (x1->depth < y1->depth) return  1.0;
-  else                            return  0.0;
+  item->FlagLineSegment  = (c->flags[j]&1)!=0;
+  item->FirstLineSegment = (c->flags[j]&2)!=0;
+  item->linetype         = c->linetype[j];
+  item->colour           = c->colour[j];
+  item->linewidth        = c->linewidth[j];
+  item->depth            = c->depth[j];
+  if (item->FlagLineSegment)
+   {
+    item->LineSegmentID = c->aux[j];
+    item->LineLength    = c->LineLength[j];
+    item->x0 = c->x0[j]; item->y0 = c->y0[j];
+    item->x1 = c->x1[j]; item->y1 = c->y1[j];
+    item->x2 = c->x2[j]; item->y2 = c->y2[j];
+    item->TextLen       = 0;
+    *psfrag             = NULL;
+   }
+  else
+   {
+    item->offset        = c->x0[j];
+    item->pointsize     = c->y0[j];
+    *psfrag             = ThreeDimBuffer_text + c->aux[j];
+    item->TextLen       = strlen(*psfrag);
+   }
+  return;
+ }
+
+// Sort the items held in memory by depth, and move them into a temporary file
+static int ThreeDimBuffer_spill()
+ {
+  static long         counter = 0;
+  char                fname[FNAME_LENGTH], *psfrag;
+  int                *order;
+  long                i;
+  FILE               *f;
+  ThreeDimBufferItem  item;
+
+  if (ThreeDimBuffer_Nruns >= THREEDIMBUFF_MAX_RUNS) return 1;
+  i = snprintf(fname, FNAME_LENGTH, "%s%spyxplot_3dbuffer_%ld.tmp", settings_session_default.tempdir, PATHLINK, counter++);
+  if ((i < 0) || (i >= FNAME_LENGTH)) return 1; // Temporary filename too long; keep the items in memory instead
+  if ((f = fopen(fname, "w+"))==NULL) return 1;
+  remove(fname); // File is deleted as soon as it is closed
+  if ((order = ThreeDimBuffer_sort())==NULL) { fclose(f); return 1; }
+  for (i=0; i<ThreeDimBuffer_Nitems; i++)
+   {
+    ThreeDimBuffer_GetItem(order[i], &item, &psfrag);
+    if ( (fwrite((void *)&item, sizeof(ThreeDimBufferItem), 1, f) != 1) ||
+         ((item.TextLen>0) && (fwrite((void *)psfrag, item.TextLen, 1, f) != 1)) )
+     { free(order); fclose(f); return 1; }
+   }
+  free(order);
+  if ((fflush(f)!=0) || (fseek(f, 0, SEEK_SET)!=0)) { fclose(f); return 1; }
+  ThreeDimBuffer_runs  [ThreeDimBuffer_Nruns  ] = f;
+  ThreeDimBuffer_RunLen[ThreeDimBuffer_Nruns++] = ThreeDimBuffer_Nitems;
+  ThreeDimBuffer_Nitems  = 0;
+  ThreeDimBuffer_TextLen = 0;
+  return 0;
+ }
+
+// Allocate storage for a new item, returning its chunk and position within it, or NULL if out of memory
+static ThreeDimBufferChunk *ThreeDimBuffer_NewItem(long *j)
+ {
+  if (ThreeDimBuffer_Nitems >= ThreeDimBuffer_Nchunks*THREEDIMBUFF_CHUNK)
+   {
+    ThreeDimBufferChunk *c = NULL;
+    if ((ThreeDimBuffer_Nchunks*sizeof(ThreeDimBufferChunk) + ThreeDimBuffer_TextAlloc < THREEDIMBUFF_MEMORY_BUDGET) || (ThreeDimBuffer_spill()!=0))
+     {
+      if (ThreeDimBuffer_Nchunks >= ThreeDimBuffer_ChunksAlloc)
+       {
+        long                  n   = (ThreeDimBuffer_ChunksAlloc < 16) ? 16 : 2*ThreeDimBuffer_ChunksAlloc;
+        ThreeDimBufferChunk **new = (ThreeDimBufferChunk **)realloc((void *)ThreeDimBuffer_chunks, n*sizeof(ThreeDimBufferChunk *));
+        if (new==NULL) return NULL;
+        ThreeDimBuffer_chunks      = new;
+        ThreeDimBuffer_ChunksAlloc = n;
+       }
+      if ((c = (ThreeDimBufferChunk *)malloc(sizeof(ThreeDimBufferChunk)))==NULL) return NULL;
+      ThreeDimBuffer_chunks[ThreeDimBuffer_Nchunks++] = c;
+     }
+   }
+  *j = ThreeDimBuffer_Nitems % THREEDIMBUFF_CHUNK;
+  return ThreeDimBuffer_chunks[ThreeDimBuffer_Nitems++ / THREEDIMBUFF_CHUNK];
+ }
+
+// Display a single item which has been taken out of the buffer
+static void ThreeDimBuffer_display(EPSComm *x, ThreeDimBufferItem *item, char *psfrag)
+ {
+  if (item->FlagLineSegment)
+   {
+    ThreeDimBuffer_linesegment(x, item->depth, item->linetype, item->linewidth, ThreeDimBuffer_colours[item->colour], item->x0, item->y0, item->x1, item->y1, item->x2, item->y2, item->FirstLineSegment, (ThreeDimBuffer_LineSegmentID!=(item->LineSegmentID-1)), item->LineLength);
+    ThreeDimBuffer_LineSegmentID = item->LineSegmentID;
+   }
+  else
+   {
+    ThreeDimBuffer_linepenup(x);
+    ThreeDimBuffer_writeps(x, item->depth, item->linetype, item->linewidth, item->offset, item->pointsize, ThreeDimBuffer_colours[item->colour], psfrag);
+   }
+  return;
+ }
+
+// Read the next item from a temporary file, into a text buffer which is grown as required
+static int ThreeDimBuffer_ReadItem(FILE *f, ThreeDimBufferItem *item, char **text, long *TextAlloc)
+ {
+  if (fread((void *)item, sizeof(ThreeDimBufferItem), 1, f) != 1) return 1;
+  if (item->TextLen+1 > *TextAlloc)
+   {
+    char *new = (char *)realloc((void *)*text, item->TextLen+1);
+    if (new==NULL) return 1;
+    *text      = new;
+    *TextAlloc = item->TextLen+1;
+   }
+  if ((item->TextLen>0) && (fread((void *)*text, item->TextLen, 1, f) != 1)) return 1;
+  (*text)[item->TextLen] = '\0';
+  return 0;
  }
 
 int ThreeDimBuffer_Deactivate(EPSComm *x)
  {
-  int   Nitems, i, j;
-  struct DepthArrayEntry *DepthArray;
-  ThreeDimBufferItem *item;
-  ListIterator *ListIter;
+  long                i;
+  int                *order, r, NRuns;
+  ThreeDimBufferItem  item;
+  char               *psfrag;
 
   if (!ThreeDimBuffer_ACTIVE) { ThreeDimBuffer_Reset(); return 0; }
-  Nitems = ListLen(ThreeDimBuffer_buffer);
   ThreeDimBuffer_ACTIVE = 0;
-  if (Nitems > 0)
+  if ((ThreeDimBuffer_Nitems > 0) || (ThreeDimBuffer_Nruns > 0))
    {
     eps_core_WritePSColour(x);
+    ThreeDimBuffer_LineSegmentID = -5;
+    order = ThreeDimBuffer_sort();
+    if (order == NULL) { ppl_error(ERR_MEMORY, -1, -1, "Out of memory whilst sorting 3D plot by depth."); ThreeDimBuffer_Reset(); return 1; }
 
     // Display all items in 3D display buffer, from back to front
-    DepthArray = (struct DepthArrayEntry *)lt_malloc(Nitems * sizeof(struct DepthArrayEntry));
-    i=0;
-    ListIter = ListIterateInit(ThreeDimBuffer_buffer);
-    while (ListIter != NULL)
+    if (ThreeDimBuffer_Nruns == 0)
      {
-      DepthArray[i].item  = ListIter->data;
-      DepthArray[i].depth = ((ThreeDimBufferItem *)(ListIter->data))->depth;
-      i++;
-      ListIter = ListIterate(ListIter, NULL);
+      for (i=0; i<ThreeDimBuffer_Nitems; i++)
+       {
+        ThreeDimBuffer_GetItem(order[i], &item, &psfrag);
+        ThreeDimBuffer_display(x, &item, psfrag);
+       }
      }
-    qsort((void *)DepthArray, i, sizeof(struct DepthArrayEntry), ThreeDimBuffer_qsort_slave);
-    ThreeDimBuffer_LineSegmentID = -5;
-    for (j=0; j<i; j++)
+
+    // Merge runs of items from temporary files with those in memory. Ties go to the earliest run, i.e. to the item buffered first.
+    else
      {
-      item = (ThreeDimBufferItem *)DepthArray[j].item;
-      if (item->FlagLineSegment)
+      ThreeDimBufferItem cur      [THREEDIMBUFF_MAX_RUNS+1];
+      char              *text     [THREEDIMBUFF_MAX_RUNS+1];
+      long               TextAlloc[THREEDIMBUFF_MAX_RUNS+1], pos[THREEDIMBUFF_MAX_RUNS+1];
+      unsigned long long key      [THREEDIMBUFF_MAX_RUNS+1];
+      int                fail=0;
+
+      NRuns = ThreeDimBuffer_Nruns;
+      for (r=0; r<=NRuns; r++)
        {
-        ThreeDimBuffer_linesegment(x, item->depth, item->linetype, item->linewidth, item->colstr, item->x0, item->y0, item->x1, item->y1, item->x2, item->y2, item->FirstLineSegment, (ThreeDimBuffer_LineSegmentID!=(item->LineSegmentID-1)), item->LineLength);
-        ThreeDimBuffer_LineSegmentID = item->LineSegmentID;
+        text[r]=NULL; TextAlloc[r]=0; pos[r]=0;
+        if      (r==NRuns)                 { if (ThreeDimBuffer_Nitems>0) { ThreeDimBuffer_GetItem(order[0], cur+r, text+r); key[r] = ThreeDimBuffer_DepthKey(cur[r].depth); } }
+        else if (ThreeDimBuffer_ReadItem(ThreeDimBuffer_runs[r], cur+r, text+r, TextAlloc+r)) fail=1;
+        else                               { key[r] = ThreeDimBuffer_DepthKey(cur[r].depth); }
        }
-      else
+      while (!fail)
        {
-        ThreeDimBuffer_linepenup(x);
-        ThreeDimBuffer_writeps(x, item->depth, item->linetype, item->linewidth, item->offset, item->pointsize, item->colstr, item->psfrag);
+        int best=-1;
+        for (r=0; r<=NRuns; r++)
+         if ( (pos[r] < ((r==NRuns) ? ThreeDimBuffer_Nitems : ThreeDimBuffer_RunLen[r])) && ((best<0) || (key[r]<key[best])) ) best=r;
+        if (best<0) break;
+        ThreeDimBuffer_display(x, cur+best, text[best]);
+        if (++pos[best] >= ((best==NRuns) ? ThreeDimBuffer_Nitems : ThreeDimBuffer_RunLen[best])) continue;
+        if (best==NRuns) ThreeDimBuffer_GetItem(order[pos[best]], cur+best, text+best);
+        else if (ThreeDimBuffer_ReadItem(ThreeDimBuffer_runs[best], cur+best, text+best, TextAlloc+best)) { fail=1; break; }
+        key[best] = ThreeDimBuffer_DepthKey(cur[best].depth);
        }
+      for (r=0; r<NRuns; r++) if (text[r]!=NULL) free(text[r]);
+      if (fail) { free(order); ppl_error(ERR_FILE, -1, -1, "Could not read back temporary file whilst sorting 3D plot by depth."); ThreeDimBuffer_linepenup(x); ThreeDimBuffer_Reset(); return 1; }
      }
+    free(order);
    }
   ThreeDimBuffer_linepenup(x);
   ThreeDimBuffer_Reset();
@@ -129,8 +382,9 @@ int ThreeDimBuffer_Deactivate(EPSComm *x)
 
 int ThreeDimBuffer_writeps(EPSComm *x, double z, int linetype, double linewidth, double offset, double pointsize, char *colstr, char *psfrag)
  {
-  ThreeDimBufferItem *item;
-  char               *tempstr;
+  ThreeDimBufferChunk *c;
+  long                 j, len;
+  int                  colour;
 
   if (!ThreeDimBuffer_ACTIVE)
    {
@@ -143,26 +397,36 @@ int ThreeDimBuffer_writeps(EPSComm *x, double z, int linetype, double linewidth,
    }
   else
    {
-    item = (ThreeDimBufferItem *)lt_malloc(sizeof(ThreeDimBufferItem));
-    tempstr = (char *)lt_malloc(strlen(psfrag)+1);
-    if ((item == NULL) || (tempstr == NULL)) return 1;
-    strcpy(tempstr, psfrag);
-    item->FlagLineSegment = item->FirstLineSegment = 0;
-    item->linetype        = linetype;
-    item->linewidth       = linewidth;
-    item->offset          = offset;
-    item->pointsize       = pointsize;
-    item->colstr          = colstr;
-    item->psfrag          = tempstr;
-    item->depth           = z;
-    ListAppendPtr(ThreeDimBuffer_buffer, (void *)item, 0, 0, DATATYPE_VOID);
+    len = strlen(psfrag)+1;
+    if ((colour = ThreeDimBuffer_InternColour(colstr)) < 0) return 1;
+    if ((c = ThreeDimBuffer_NewItem(&j)) == NULL) return 1;
+    if (ThreeDimBuffer_TextLen+len > ThreeDimBuffer_TextAlloc)
+     {
+      long  n   = 2*ThreeDimBuffer_TextAlloc + len + 65536;
+      char *new = (char *)realloc((void *)ThreeDimBuffer_text, n);
+      if (new==NULL) { ThreeDimBuffer_Nitems--; return 1; }
+      ThreeDimBuffer_text      = new;
+      ThreeDimBuffer_TextAlloc = n;
+     }
+    strcpy(ThreeDimBuffer_text+ThreeDimBuffer_TextLen, psfrag);
+    c->flags    [j] = 0;
+    c->linetype [j] = linetype;
+    c->linewidth[j] = linewidth;
+    c->x0       [j] = offset;
+    c->y0       [j] = pointsize;
+    c->colour   [j] = colour;
+    c->aux      [j] = ThreeDimBuffer_TextLen;
+    c->depth    [j] = z;
+    ThreeDimBuffer_TextLen += len;
    }
   return 0;
  }
 
 int ThreeDimBuffer_linesegment(EPSComm *x, double z, int linetype, double linewidth, char *colstr, double x0, double y0, double x1, double y1, double x2, double y2, unsigned char FirstSegment, unsigned char broken, double LengthOffset)
  {
-  ThreeDimBufferItem *item;
+  ThreeDimBufferChunk *c;
+  long                 j;
+  int                  colour;
 
   if (!ThreeDimBuffer_ACTIVE)
    {
@@ -211,23 +475,21 @@ int ThreeDimBuffer_linesegment(EPSComm *x, double z, int linetype, double linewi
       linetype_old_SET = 1;
       linetype_old     = linetype;
      }
-    item = (ThreeDimBufferItem *)lt_malloc(sizeof(ThreeDimBufferItem));
-    if (item == NULL) return 1;
-    item->FlagLineSegment  = 1;
-    item->LineSegmentID    = ThreeDimBuffer_LineSegmentID++;
-    item->LineLength       = ThreeDimBuffer_LineLength;
-    item->FirstLineSegment = FirstSegment;
-    item->linetype         = linetype;
-    item->linewidth        = linewidth;
-    item->colstr           = colstr;
-    item->depth            = z;
-    item->x0               = x0;
-    item->y0               = y0;
-    item->x1               = x1;
-    item->y1               = y1;
-    item->x2               = x2;
-    item->y2               = y2;
-    ListAppendPtr(ThreeDimBuffer_buffer, (void *)item, 0, 0, DATATYPE_VOID);
+    if ((colour = ThreeDimBuffer_InternColour(colstr)) < 0) return 1;
+    if ((c = ThreeDimBuffer_NewItem(&j)) == NULL) return 1;
+    c->flags     [j] = 1 | (FirstSegment ? 2 : 0);
+    c->aux       [j] = ThreeDimBuffer_LineSegmentID++;
+    c->LineLength[j] = ThreeDimBuffer_LineLength;
+    c->linetype  [j] = linetype;
+    c->linewidth [j] = linewidth;
+    c->colour    [j] = colour;
+    c->depth     [j] = z;
+    c->x0        [j] = x0;
+    c->y0        [j] = y0;
+    c->x1        [j] = x1;
+    c->y1        [j] = y1;
+    c->x2        [j] = x2;
+    c->y2        [j] = y2;
     ThreeDimBuffer_LineLength += hypot(x2-x1,y2-y1);
    }
   return 0;
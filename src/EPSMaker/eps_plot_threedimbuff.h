@@ -24,13 +24,30 @@
 
 #include "eps_comm.h"
 
+// Items in the 3D buffer are stored in chunks of this many, each chunk holding one array for each property of the items
+#define THREEDIMBUFF_CHUNK 65536
+
+// Once the chunks and text held by the 3D buffer exceed this many bytes, the items buffered so far are sorted by depth and written to a
+// temporary file. When the buffer is displayed, the sorted runs of items are merged together.
+#define THREEDIMBUFF_MEMORY_BUDGET 268435456
+#define THREEDIMBUFF_MAX_RUNS      64
+
+typedef struct ThreeDimBufferChunk {
+ double        depth[THREEDIMBUFF_CHUNK], linewidth[THREEDIMBUFF_CHUNK], LineLength[THREEDIMBUFF_CHUNK];
+ double        x0[THREEDIMBUFF_CHUNK], y0[THREEDIMBUFF_CHUNK], x1[THREEDIMBUFF_CHUNK], y1[THREEDIMBUFF_CHUNK], x2[THREEDIMBUFF_CHUNK], y2[THREEDIMBUFF_CHUNK]; // For PostScript fragments, x0 and y0 hold offset and pointsize
+ long          aux[THREEDIMBUFF_CHUNK];      // LineSegmentID of line segments; position of PostScript fragments in the text arena
+ int           linetype[THREEDIMBUFF_CHUNK];
+ int           colour[THREEDIMBUFF_CHUNK];   // Index in the table of interned colour strings
+ unsigned char flags[THREEDIMBUFF_CHUNK];    // Bit 0 set for line segments; bit 1 set for the first segment of a line
+ } ThreeDimBufferChunk;
+
+// A single item, as passed to the display routines and written to temporary files. PostScript fragments are followed in files by TextLen bytes of text.
 typedef struct ThreeDimBufferItem {
  unsigned char FlagLineSegment, FirstLineSegment;
- int           linetype;
+ int           linetype, colour;
  double        linewidth, offset, pointsize;
- char         *colstr, *psfrag;
  double        depth, LineLength, x0,y0,x1,y1,x2,y2;
- long          LineSegmentID;
+ long          LineSegmentID, TextLen;
  } ThreeDimBufferItem;
 
 #ifndef _PPL_EPS_PLOT_THREEDIMBUFF_C
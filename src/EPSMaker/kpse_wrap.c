@@ -42,14 +42,21 @@
 #include <unistd.h>
 #include <errno.h>
 #include "ppl_children.h"
+#include "ppl_settings.h"
 #define MAX_PATHS 256
 char           ppl_kpse_FilePaths    [3][LSTR_LENGTH];
 char          *ppl_kpse_PathList     [3][MAX_PATHS];
 unsigned char  ppl_kpse_PathRecursive[3][MAX_PATHS];
 #endif
 
+// Called lazily the first time that a font file is looked up, so that sessions which never typeset any text never
+// need to wait for kpsewhich
 void ppl_kpse_wrap_init()
  {
+  static int initialised = 0;
+  if (initialised) return;
+  initialised = 1;
+
   #ifdef HAVE_KPATHSEA
   kpse_set_program_name("dvips", "dvips");
   #else
@@ -185,32 +192,352 @@ char *ppl_kpse_wrap_find_file(char *s, char **paths, unsigned char *RecurseList)
    }
   return NULL;
  }
+
+// ------------------------------------------------------------------------------------------------------------------------------------
+// Index of font files. The first time that a font file is looked up, every directory on the search paths returned by kpsewhich is
+// scanned once, and the name of every file with the extension .tfm, .pfa or .pfb, as appropriate, is stored in a hash table along with
+// the directory it was found in. A file which appears in more than one place is indexed at the first place in which the recursive
+// search above would have found it. The index is saved in the user's home directory, together with the modification time of every
+// directory which was scanned, so that later PyXPlot processes can use it without scanning again, so long as kpsewhich returns the
+// same search paths and none of those directories have been modified since.
+// ------------------------------------------------------------------------------------------------------------------------------------
+
+#define KPSE_INDEX_MAGIC    "PyXPlot font index 1"
+#define KPSE_INDEX_FNAME    ".pyxplot_fontindex"
+#define KPSE_INDEX_HASHSIZE 1024
+
+typedef struct KpseIndexEntry {
+  char                  *name;
+  int                    dir; // Index into DirPath[] of the directory containing this file
+  struct KpseIndexEntry *next;
+ } KpseIndexEntry;
+
+typedef struct KpseIndex {
+  KpseIndexEntry **hash;
+  int              HashSize, Nentries;
+  char           **DirPath;
+  long long       *DirMtime; // -1 if the directory did not exist
+  int              Ndirs, DirSpace;
+ } KpseIndex;
+
+static KpseIndex   ppl_kpse_Index[3];
+static int         ppl_kpse_IndexState = 0; // 0 = not yet built; 1 = ready; -1 = could not be built, so search directories instead
+static const char *ppl_kpse_Extensions[3] = {".tfm",".pfa",".pfb"};
+
+static unsigned long ppl_kpse_index_hash(const char *s)
+ {
+  unsigned long hash = 5381;
+  for ( ; *s!='\0'; s++) hash = hash*33 + (unsigned char)*s;
+  return hash;
+ }
+
+static KpseIndexEntry *ppl_kpse_index_find(KpseIndex *ix, const char *name)
+ {
+  KpseIndexEntry *e;
+  for (e=ix->hash[ppl_kpse_index_hash(name) % ix->HashSize]; e!=NULL; e=e->next) if (strcmp(e->name, name)==0) return e;
+  return NULL;
+ }
+
+static void ppl_kpse_index_clear(KpseIndex *ix)
+ {
+  KpseIndexEntry *e, *next;
+  int             i;
+  if (ix->hash != NULL)
+   for (i=0; i<ix->HashSize; i++)
+    for (e=ix->hash[i]; e!=NULL; e=next) { next=e->next; free(e->name); free(e); }
+  for (i=0; i<ix->Ndirs; i++) free(ix->DirPath[i]);
+  free(ix->hash); free(ix->DirPath); free(ix->DirMtime);
+  memset(ix, 0, sizeof(KpseIndex));
+  return;
+ }
+
+static int ppl_kpse_index_new(KpseIndex *ix)
+ {
+  memset(ix, 0, sizeof(KpseIndex));
+  ix->HashSize = KPSE_INDEX_HASHSIZE;
+  ix->hash     = (KpseIndexEntry **)calloc(ix->HashSize, sizeof(KpseIndexEntry *));
+  return (ix->hash == NULL);
+ }
+
+// Add a directory to the index, returning its number, or -1 on failure
+static int ppl_kpse_index_add_dir(KpseIndex *ix, const char *path, long long mtime)
+ {
+  char      **NewPath;
+  long long  *NewMtime;
+
+  if (ix->Ndirs == ix->DirSpace)
+   {
+    ix->DirSpace = (ix->DirSpace==0) ? 64 : 2*ix->DirSpace;
+    if ((NewPath  = (char    **)realloc(ix->DirPath , ix->DirSpace*sizeof(char *   )))==NULL) return -1;
+    ix->DirPath  = NewPath;
+    if ((NewMtime = (long long *)realloc(ix->DirMtime, ix->DirSpace*sizeof(long long)))==NULL) return -1;
+    ix->DirMtime = NewMtime;
+   }
+  if ((ix->DirPath[ix->Ndirs] = (char *)malloc(strlen(path)+1))==NULL) return -1;
+  strcpy(ix->DirPath[ix->Ndirs], path);
+  ix->DirMtime[ix->Ndirs] = mtime;
+  return ix->Ndirs++;
+ }
+
+// Add a file to the index, unless a file of the same name has already been found elsewhere. Returns nonzero on failure.
+static int ppl_kpse_index_add_file(KpseIndex *ix, const char *name, int dir)
+ {
+  KpseIndexEntry **NewHash, *e, *next;
+  int              i, NewSize;
+  unsigned long    h;
+
+  if (ppl_kpse_index_find(ix, name) != NULL) return 0;
+
+  // Keep the hash table at least half as long as the number of entries in it
+  if (ix->Nentries >= 2*ix->HashSize)
+   {
+    NewSize = 4*ix->HashSize;
+    if ((NewHash = (KpseIndexEntry **)calloc(NewSize, sizeof(KpseIndexEntry *)))==NULL) return 1;
+    for (i=0; i<ix->HashSize; i++)
+     for (e=ix->hash[i]; e!=NULL; e=next)
+      {
+       next = e->next;
+       h    = ppl_kpse_index_hash(e->name) % NewSize;
+       e->next = NewHash[h]; NewHash[h] = e;
+      }
+    free(ix->hash);
+    ix->hash     = NewHash;
+    ix->HashSize = NewSize;
+   }
+
+  if ((e = (KpseIndexEntry *)malloc(sizeof(KpseIndexEntry)))==NULL) return 1;
+  if ((e->name = (char *)malloc(strlen(name)+1))==NULL) { free(e); return 1; }
+  strcpy(e->name, name);
+  e->dir  = dir;
+  h       = ppl_kpse_index_hash(name) % ix->HashSize;
+  e->next = ix->hash[h]; ix->hash[h] = e;
+  ix->Nentries++;
+  return 0;
+ }
+
+// Scan a directory, adding all of the files in it with extension ext, and then scanning its subdirectories if recurse is set. The order
+// in which files are visited is the same as that of ppl_kpse_wrap_test_path(). Returns nonzero on failure.
+static int ppl_kpse_index_scan(KpseIndex *ix, const char *ext, const char *path, unsigned char recurse)
+ {
+  DIR            *dp;
+  struct dirent  *dirp;
+  struct stat     statbuf;
+  char            next[FNAME_LENGTH];
+  char          **subdirs=NULL, **NewSubdirs;
+  int             Nsubdirs=0, SubdirSpace=0, i, dir, len, ExtLen=strlen(ext), fail=0;
+  unsigned char   IsDir;
+
+  if (stat(path, &statbuf) < 0) return (ppl_kpse_index_add_dir(ix, path, -1) < 0); // Remember directories which don't exist, in case they are created later
+  if ((dir = ppl_kpse_index_add_dir(ix, path, (long long)statbuf.st_mtime)) < 0) return 1;
+  snprintf(next, FNAME_LENGTH, "%s%s", path, PATHLINK);
+  next[FNAME_LENGTH-1]='\0';
+  if ((dp = opendir(next))==NULL) return 0;
+  while ((!fail) && ((dirp = readdir(dp))!=NULL))
+   {
+    if ((strcmp(dirp->d_name,".")==0) || (strcmp(dirp->d_name,"..")==0)) continue;
+    len = strlen(dirp->d_name);
+    if ((len > ExtLen) && (strcmp(dirp->d_name+len-ExtLen, ext)==0) && (strchr(dirp->d_name,'\n')==NULL))
+     {
+      fail = ppl_kpse_index_add_file(ix, dirp->d_name, dir);
+      continue;
+     }
+    if (!recurse) continue;
+
+    // Work out whether this is a subdirectory, without following symbolic links
+#ifdef _DIRENT_HAVE_D_TYPE
+    if (dirp->d_type != DT_UNKNOWN) IsDir = (dirp->d_type == DT_DIR);
+    else
+#endif
+     {
+      snprintf(next, FNAME_LENGTH, "%s%s%s", path, PATHLINK, dirp->d_name);
+      next[FNAME_LENGTH-1]='\0';
+      IsDir = ((lstat(next,&statbuf) == 0) && S_ISDIR(statbuf.st_mode));
+     }
+    if (!IsDir) continue;
+    if (Nsubdirs == SubdirSpace)
+     {
+      SubdirSpace = (SubdirSpace==0) ? 16 : 2*SubdirSpace;
+      if ((NewSubdirs = (char **)realloc(subdirs, SubdirSpace*sizeof(char *)))==NULL) { fail=1; break; }
+      subdirs = NewSubdirs;
+     }
+    if ((subdirs[Nsubdirs] = (char *)malloc(strlen(path)+strlen(PATHLINK)+len+1))==NULL) { fail=1; break; }
+    sprintf(subdirs[Nsubdirs++], "%s%s%s", path, PATHLINK, dirp->d_name);
+   }
+  closedir(dp);
+
+  // Subdirectories are scanned only once all of the files in this directory have been indexed
+  for (i=0; i<Nsubdirs; i++)
+   {
+    if (!fail) fail = ppl_kpse_index_scan(ix, ext, subdirs[i], 1);
+    free(subdirs[i]);
+   }
+  free(subdirs);
+  return fail;
+ }
+
+// Try to load the index from the file fname. Returns nonzero if the file does not exist, or if it is out of date.
+static int ppl_kpse_index_load(const char *fname)
+ {
+  FILE         *f;
+  char          line[FNAME_LENGTH+64], *p;
+  int           j, type, Npaths[3]={0,0,0}, fail=0, len;
+  long long     n;
+  struct stat   statbuf;
+  KpseIndex    *ix;
+
+  if ((f=fopen(fname, "r"))==NULL) return 1;
+  for (j=0; j<3; j++) if (ppl_kpse_index_new(&ppl_kpse_Index[j])) fail=1;
+  if ((fgets(line, FNAME_LENGTH+64, f)==NULL) || (strncmp(line, KPSE_INDEX_MAGIC "\n", strlen(KPSE_INDEX_MAGIC)+1)!=0)) fail=1;
+  while ((!fail) && (fgets(line, FNAME_LENGTH+64, f)!=NULL))
+   {
+    len = strlen(line);
+    if ((len<1) || (line[len-1]!='\n')) { fail=1; break; } // Truncated line
+    line[len-1] = '\0';
+    if ((sscanf(line+1, " %d %lld %n", &type, &n, &len) < 2) || (type<0) || (type>2)) { fail=1; break; }
+    ix = &ppl_kpse_Index[type];
+    p  = line+1+len;
+
+    // P lines list the search paths which kpsewhich returned; these must not have changed
+    if      (line[0]=='P')
+     {
+      if ((Npaths[type] >= MAX_PATHS-1) || (ppl_kpse_PathList[type][Npaths[type]]==NULL) ||
+          (strcmp(ppl_kpse_PathList[type][Npaths[type]], p)!=0) || (ppl_kpse_PathRecursive[type][Npaths[type]]!=n)) { fail=1; break; }
+      Npaths[type]++;
+     }
+
+    // D lines list the directories which were scanned; these must not have been modified
+    else if (line[0]=='D')
+     {
+      if (stat(p, &statbuf) < 0) { if (n != -1) fail=1; }
+      else if ((n != (long long)statbuf.st_mtime) || (!S_ISDIR(statbuf.st_mode))) fail=1;
+      if ((!fail) && (ppl_kpse_index_add_dir(ix, p, n) < 0)) fail=1;
+     }
+
+    // F lines list the files which were found in each directory
+    else if (line[0]=='F')
+     {
+      if ((n<0) || (n>=ix->Ndirs) || (ppl_kpse_index_add_file(ix, p, (int)n))) fail=1;
+     }
+    else fail=1;
+   }
+  fclose(f);
+  for (j=0; j<3; j++) if (ppl_kpse_PathList[j][Npaths[j]]!=NULL) fail=1; // A path has been added
+  if (fail) for (j=0; j<3; j++) ppl_kpse_index_clear(&ppl_kpse_Index[j]);
+  return fail;
+ }
+
+// Save the index to the file fname. It is written under a temporary name and then renamed, so that other processes never see half of it.
+static void ppl_kpse_index_save(const char *fname)
+ {
+  FILE           *f;
+  KpseIndexEntry *e;
+  char            tmpname[FNAME_LENGTH+32];
+  int             i, j, fail=0;
+
+  sprintf(tmpname, "%s.%d", fname, getpid());
+  if ((f=fopen(tmpname, "w"))==NULL) { if (DEBUG) { sprintf(temp_err_string, "Could not write font index '%s'.", tmpname); ppl_log(temp_err_string); } return; }
+  fail |= (fprintf(f, "%s\n", KPSE_INDEX_MAGIC) < 0);
+  for (j=0; j<3; j++)
+   {
+    for (i=0; ppl_kpse_PathList[j][i]!=NULL; i++) fail |= (fprintf(f, "P %d %d %s\n", j, (int)ppl_kpse_PathRecursive[j][i], ppl_kpse_PathList[j][i]) < 0);
+    for (i=0; i<ppl_kpse_Index[j].Ndirs; i++) fail |= (fprintf(f, "D %d %lld %s\n", j, ppl_kpse_Index[j].DirMtime[i], ppl_kpse_Index[j].DirPath[i]) < 0);
+    for (i=0; i<ppl_kpse_Index[j].HashSize; i++)
+     for (e=ppl_kpse_Index[j].hash[i]; e!=NULL; e=e->next)
+      fail |= (fprintf(f, "F %d %d %s\n", j, e->dir, e->name) < 0);
+   }
+  fail |= (fclose(f) != 0);
+  if (fail || (rename(tmpname, fname)!=0)) { remove(tmpname); if (DEBUG) { sprintf(temp_err_string, "Could not write font index '%s'.", fname); ppl_log(temp_err_string); } }
+  return;
+ }
+
+// Load the index of font files, or build it if there is no up-to-date copy on disk
+static void ppl_kpse_index_init()
+ {
+  char fname[FNAME_LENGTH];
+  int  i, j, len, OnDisk, fail=0;
+
+  if (ppl_kpse_IndexState != 0) return;
+  len    = snprintf(fname, FNAME_LENGTH, "%s%s%s", settings_session_default.homedir, PATHLINK, KPSE_INDEX_FNAME);
+  OnDisk = (len >= 0) && (len < FNAME_LENGTH); // If the filename does not fit, the index is built afresh and not saved
+
+  if (OnDisk && (ppl_kpse_index_load(fname) == 0))
+   {
+    if (DEBUG) { sprintf(temp_err_string, "Loaded font index from '%s'.", fname); ppl_log(temp_err_string); }
+   }
+  else
+   {
+    if (DEBUG) ppl_log("Building font index.");
+    for (j=0; (j<3)&&(!fail); j++)
+     {
+      fail = ppl_kpse_index_new(&ppl_kpse_Index[j]);
+      for (i=0; (ppl_kpse_PathList[j][i]!=NULL)&&(!fail); i++)
+       {
+        if (ppl_kpse_PathList[j][i][0]=='.') continue; // Do not look for files in cwd
+        fail = ppl_kpse_index_scan(&ppl_kpse_Index[j], ppl_kpse_Extensions[j], ppl_kpse_PathList[j][i], ppl_kpse_PathRecursive[j][i]);
+       }
+     }
+    if (fail)
+     {
+      ppl_error(ERR_MEMORY, -1, -1, "Out of memory whilst building index of font files.");
+      for (j=0; j<3; j++) ppl_kpse_index_clear(&ppl_kpse_Index[j]);
+      ppl_kpse_IndexState = -1;
+      return;
+     }
+    if (OnDisk) ppl_kpse_index_save(fname);
+   }
+  if (DEBUG)
+   {
+    sprintf(temp_err_string, "Font index contains %d tfm, %d pfa and %d pfb files.", ppl_kpse_Index[0].Nentries, ppl_kpse_Index[1].Nentries, ppl_kpse_Index[2].Nentries);
+    ppl_log(temp_err_string);
+   }
+  ppl_kpse_IndexState = 1;
+  return;
+ }
+
+// Look up a file of type j (0 = tfm; 1 = pfa; 2 = pfb) in the index
+static char *ppl_kpse_wrap_find_indexed(char *s, int j)
+ {
+  static char     buffer[FNAME_LENGTH];
+  KpseIndexEntry *e;
+
+  ppl_kpse_index_init();
+  if (ppl_kpse_IndexState != 1) return ppl_kpse_wrap_find_file(s, ppl_kpse_PathList[j], ppl_kpse_PathRecursive[j]);
+  if ((e = ppl_kpse_index_find(&ppl_kpse_Index[j], s)) == NULL) return NULL;
+  snprintf(buffer, FNAME_LENGTH, "%s%s%s", ppl_kpse_Index[j].DirPath[e->dir], PATHLINK, e->name);
+  buffer[FNAME_LENGTH-1]='\0';
+  if (access(buffer, R_OK) != 0) return ppl_kpse_wrap_find_file(s, ppl_kpse_PathList[j], ppl_kpse_PathRecursive[j]); // File has gone away since the index was made
+  if (DEBUG) { sprintf(temp_err_string, "KPSE found file <%s> in font index", buffer); ppl_log(temp_err_string); }
+  return buffer;
+ }
 #endif
 
 char *ppl_kpse_wrap_find_pfa(char *s)
  {
+  ppl_kpse_wrap_init();
   #ifdef HAVE_KPATHSEA
   return (char *)kpse_find_file(s, kpse_type1_format, true);
   #else
-  return ppl_kpse_wrap_find_file(s, ppl_kpse_PathList[1], ppl_kpse_PathRecursive[1]);
+  return ppl_kpse_wrap_find_indexed(s, 1);
   #endif
  }
 
 char *ppl_kpse_wrap_find_pfb(char *s)
  {
+  ppl_kpse_wrap_init();
   #ifdef HAVE_KPATHSEA
   return (char *)kpse_find_file(s, kpse_type1_format, true);
   #else
-  return ppl_kpse_wrap_find_file(s, ppl_kpse_PathList[2], ppl_kpse_PathRecursive[2]);
+  return ppl_kpse_wrap_find_indexed(s, 2);
   #endif
  }
 
 char *ppl_kpse_wrap_find_tfm(char *s)
  {
+  ppl_kpse_wrap_init();
   #ifdef HAVE_KPATHSEA
   return (char *)kpse_find_tfm(s);
   #else
-  return ppl_kpse_wrap_find_file(s, ppl_kpse_PathList[0], ppl_kpse_PathRecursive[0]);
+  return ppl_kpse_wrap_find_indexed(s, 0);
   #endif
  }
 
@@ -30,10 +30,20 @@
 
 /* GetFloat(): This gets a float from a string */
 
+/* Up to this many significant figures are accumulated exactly, as an integer, before being scaled by a power of ten */
+#define GETFLOAT_MAX_DIGITS 19
+
+static const double GetFloat_PowersOfTen[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                                               1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 }; /* All exactly representable as doubles */
+
 double GetFloat(const char *str, int *Nchars)
  {
   double accumulator = 0;
+  double exponent;
+  unsigned long long mantissa = 0;
   int decimals = 0;
+  int digits = 0;
+  int power;
   unsigned char past_decimal_point = 0;
   unsigned char negative = 0;
   int pos = 0;
@@ -50,23 +60,36 @@ double GetFloat(const char *str, int *Nchars)
     if (str[pos] == '.')
      {
       past_decimal_point = 1;
-     } else {
-      accumulator = ((10 * accumulator) + (((int)str[pos])-48));
+     } else if (digits < GETFLOAT_MAX_DIGITS) {
+      mantissa = 10 * mantissa + (str[pos]-'0');      /* Integer arithmetic is exact, and cheaper than repeated floating-point operations */
+      if (mantissa != 0) digits++;                     /* Leading zeros are not significant figures */
       if (past_decimal_point == 1) decimals++;
+     } else {
+      if (past_decimal_point == 0) decimals--;         /* Further significant figures are beyond double precision; only count them */
      }
     pos++;
    }
 
-  while (decimals != 0)                                         /* Deals with decimals */
+  if ((str[pos] == 'e') || (str[pos] == 'E')) exponent = GetFloat(str+pos+1 , &pos2); /* Deals with exponents */
+  else                                        exponent = 0.0;
+
+  power = (fabs(exponent) < 1000) ? ((int)exponent - decimals) : 1000;
+  if ((power >= -22) && (power <= 22) && (exponent == (int)exponent) && (mantissa < (1ULL<<53)))
    {
-    decimals--;
-    accumulator /= 10;
+    /* Mantissa and power of ten are both exact, so one multiplication or division gives a correctly-rounded result */
+    if (power >= 0) accumulator = ((double)mantissa) * GetFloat_PowersOfTen[ power];
+    else            accumulator = ((double)mantissa) / GetFloat_PowersOfTen[-power];
+   }
+  else
+   {
+    accumulator = (double)mantissa;
+    if (decimals > 0) accumulator /= (decimals<=22) ? GetFloat_PowersOfTen[decimals] : pow(10.0,  decimals);
+    if (decimals < 0) accumulator *= pow(10.0, -decimals);
+    if (exponent != 0.0) accumulator *= pow(10.0, exponent);
    }
 
   if (negative == 1) accumulator *= -1;                         /* Deals with negatives */
 
-  if ((str[pos] == 'e') || (str[pos] == 'E')) accumulator *= pow(10.0,GetFloat(str+pos+1 , &pos2)); /* Deals with exponents */
-
   if (pos2   >     0) pos += (1+pos2); // Add on characters taken up by exponent, including one for the 'e' character.
   if (pos    ==    0) pos = -1; // Alert the user that this was a blank string!
   if (Nchars != NULL) *Nchars = pos;
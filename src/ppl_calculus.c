@@ -35,9 +35,10 @@
 #include "ppl_units.h"
 #include "ppl_units_fns.h"
 #include "ppl_userspace.h"
+#include "ppl_userspace_compile.h"
 
 typedef struct IntComm {
- char         *expr;
+ CompiledAlgebra *expr;
  value        *dummy;
  value         first;
  double        DummyReal, DummyImag;
@@ -58,7 +59,7 @@ double CalculusSlave(double x, void *params)
   if (data->VaryingReal) { data->dummy->real = x; data->dummy->imag = data->DummyImag; data->dummy->FlagComplex = !ppl_units_DblEqual(data->dummy->imag,0); }
   else                   { data->dummy->imag = x; data->dummy->real = data->DummyReal; data->dummy->FlagComplex = !ppl_units_DblEqual(data->dummy->imag,0); }
 
-  ppl_EvaluateAlgebra(data->expr, &output, 0, NULL, 0, data->errpos, data->errtext, data->RecursionDepth+1);
+  ppl_EvaluateCompiled(data->expr, NULL, &output, data->errpos, data->errtext, data->RecursionDepth+1);
   if (*(data->errpos)>=0) return GSL_NAN;
 
   if (data->IsFirst)
@@ -104,7 +105,6 @@ void Integrate(char *expr, char *dummy, value *min, value *max, value *out, int
     return;
    }
 
-  commlink.expr    = expr;
   commlink.IsFirst = 1;
   commlink.TestingReal = 1;
   commlink.VaryingReal = 1;
@@ -119,6 +119,10 @@ void Integrate(char *expr, char *dummy, value *min, value *max, value *out, int
   commlink.DummyReal = DummyVar->real;
   commlink.DummyImag = DummyVar->imag;
 
+  // Compile the integrand once, rather than parsing it afresh at every sample point
+  commlink.expr = ppl_CompileAlgebra(expr, 0, NULL, 0, 0, NULL, errpos, errtext, RecursionDepth+1);
+  if (commlink.expr == NULL) { ppl_UserSpace_RestoreVarPointer(&DummyVar, &DummyTemp); return; }
+
   ws          = gsl_integration_workspace_alloc(1000);
   fn.function = &CalculusSlave;
   fn.params   = &commlink;
@@ -132,6 +136,7 @@ void Integrate(char *expr, char *dummy, value *min, value *max, value *out, int
    }
 
   gsl_integration_workspace_free(ws);
+  ppl_CompiledAlgebraFree(commlink.expr);
 
   ppl_UserSpace_RestoreVarPointer(&DummyVar, &DummyTemp); // Restore old value of the dummy variable we've been using
 
@@ -175,7 +180,6 @@ void Differentiate(char *expr, char *dummy, value *point, value *step, value *ou
     return;
    }
 
-  commlink.expr    = expr;
   commlink.IsFirst = 1;
   commlink.TestingReal = 1;
   commlink.VaryingReal = 1;
@@ -190,6 +194,9 @@ void Differentiate(char *expr, char *dummy, value *point, value *step, value *ou
   commlink.DummyReal = DummyVar->real;
   commlink.DummyImag = DummyVar->imag;
 
+  commlink.expr = ppl_CompileAlgebra(expr, 0, NULL, 0, 0, NULL, errpos, errtext, RecursionDepth+1);
+  if (commlink.expr == NULL) { ppl_UserSpace_RestoreVarPointer(&DummyVar, &DummyTemp); return; }
+
   fn.function = &CalculusSlave;
   fn.params   = &commlink;
 
@@ -203,7 +210,12 @@ void Differentiate(char *expr, char *dummy, value *point, value *step, value *ou
     gsl_deriv_central(&fn, point->imag, step->real, &dIdI      , &dIdI_error);
     commlink.TestingReal = 1;
     gsl_deriv_central(&fn, point->imag, step->real, &dRdI      , &dRdI_error);
+   }
 
+  ppl_CompiledAlgebraFree(commlink.expr);
+
+  if ((*errpos < 0) && (settings_term_current.ComplexNumbers == SW_ONOFF_ON))
+   {
     if ((!ppl_units_DblApprox(ResultReal, dIdI, 2*(ResultReal_error+dIdI_error))) || (!ppl_units_DblApprox(ResultImag, -dRdI, 2*(ResultImag_error+dRdI_error))))
      { *errpos = 0; sprintf(errtext, "The Cauchy-Riemann equations are not satisfied at this point in the complex plane. It does not therefore appear possible to perform complex differentiation. In the notation f(x+iy)=u+iv, the offending derivatives were: du/dx=%e, dv/dy=%e, du/dy=%e and dv/dx=%e.", ResultReal, dIdI, dRdI, ResultImag); return; }
    }
@@ -27,6 +27,7 @@
 #include <string.h>
 #include <unistd.h>
 #include <errno.h>
+#include <limits.h>
 #include <signal.h>
 #include <time.h>
 #include <wordexp.h>
@@ -35,6 +36,8 @@
 
 #include <gsl/gsl_math.h>
 
+#include "EPSMaker/bmp_rasterise.h"
+#include "EPSMaker/dvi_cache.h"
 #include "EPSMaker/dvi_read.h"
 #include "EPSMaker/eps_comm.h"
 #include "EPSMaker/eps_core.h"
@@ -84,10 +87,7 @@ static int filecopy(const char *in, const char *out)
  }
 
 // Run ghostscript to convert postscript output into bitmap graphics
-#define BITMAP_TERMINAL_CLEANUP(X, Y, CanInvert) \
-    if (system(temp_err_string) != 0) /* Run ghostscript */ \
-     { ppl_error(ERR_GENERAL, -1, -1, "Error encountered whilst using " X " to generate " Y " output"); } \
-    else \
+#define BITMAP_TERMINAL_COPY(Y, CanInvert) \
      { \
       char *src = GSOutputTemp; \
       if ((CanInvert) && (settings_term_current.TermInvert==SW_ONOFF_ON)) \
@@ -101,9 +101,23 @@ static int filecopy(const char *in, const char *out)
       if (filecopy(src, comm.FinalFilename) != 0) /* Move ghostscript output to desire target file */ \
        { sprintf(temp_err_string, "Could not write output to file '%s'", comm.FinalFilename); ppl_error(ERR_FILE, -1, -1, temp_err_string); } \
       remove(src);  /* Delete temporary files */ \
-     } \
+     }
+
+#define BITMAP_TERMINAL_CLEANUP(X, Y, CanInvert) \
+    if (system(temp_err_string) != 0) /* Run ghostscript */ \
+     { ppl_error(ERR_GENERAL, -1, -1, "Error encountered whilst using " X " to generate " Y " output"); } \
+    else \
+     BITMAP_TERMINAL_COPY(Y, CanInvert) \
     remove(comm.EPSFilename);
 
+// Try the built-in rasteriser, if it is enabled. It inverts colours itself, if required.
+#define BITMAP_TERMINAL_RASTERISE(FORMAT) \
+    ((settings_term_current.TermRaster==SW_ONOFF_ON) && \
+     (bmp_rasterise(comm.EPSFilename, GSOutputTemp, FORMAT, floor(settings_term_current.dpi), \
+                    settings_term_current.TermAntiAlias==SW_ONOFF_ON, \
+                    (FORMAT==BMP_RASTER_PNG) && (settings_term_current.TermTransparent==SW_ONOFF_ON), \
+                    settings_term_current.TermInvert==SW_ONOFF_ON)==0))
+
 // Standard postscript prolog text for EPS and PS files
 static char *EPS_PROLOG_TEXT = "\
 /BeginEPSF { %def                                     % Prepare for EPS file\n\
@@ -134,6 +148,272 @@ static char *PS_PROLOG_TEXT = "\
 // Standard commandline flags to pass to ghostscript
 static char *GHOSTSCRIPT_STANDARD_FLAGS = "-dQUIET -dSAFER -P- -dBATCH -dNOPAUSE -dEPSCrop";
 
+// In frames mode, successive bitmap plots are rendered by a single long-lived ghostscript process, which reads a
+// stream of pages from a pipe, rather than by starting a new ghostscript process for every plot
+static int    GSFrames_pid=0, GSFrames_in=-1, GSFrames_out=-1, GSFrames_termtype=-1, GSFrames_antialias=-1, GSFrames_transparent=-1;
+static double GSFrames_dpi=-1;
+static long   GSFrames_page=0;
+static char   GSFrames_stem[FNAME_LENGTH];
+
+// Counter used to number the output files produced in frames mode
+static int    Frames_active=0;
+static long   Frames_count=0;
+static char   Frames_output[FNAME_LENGTH];
+
+// Number of seconds for which we wait to hear from the frames-mode ghostscript process before giving up on it
+#define GSFRAMES_TIMEOUT 60
+
+// Close the pipes to the frames-mode ghostscript process, which will then exit of its own accord. If it has stopped
+// responding, it is killed instead.
+static void canvas_GSFramesClose(int kill_it)
+ {
+  if (GSFrames_pid == 0) return;
+  if (DEBUG) { sprintf(temp_err_string, "%s frames-mode ghostscript process %d after %ld frames.", kill_it ? "Killing" : "Closing", GSFrames_pid, GSFrames_page); ppl_log(temp_err_string); }
+  if (kill_it) kill(GSFrames_pid, SIGTERM);
+  close(GSFrames_in);
+  close(GSFrames_out);
+  GSFrames_pid = 0;
+  GSFrames_in = GSFrames_out = -1;
+  return;
+ }
+
+// Make sure that a frames-mode ghostscript process is running, with settings which match the current terminal.
+// Returns nonzero if the process could not be started.
+static int canvas_GSFramesOpen(int termtype)
+ {
+  char  DeviceFlag[64], ResFlag[64], OutFlag[FNAME_LENGTH+32], *argv[16];
+  int   i=0, antialias, transparent, len;
+  double dpi;
+
+  antialias   = (settings_term_current.TermAntiAlias  ==SW_ONOFF_ON);
+  transparent = (settings_term_current.TermTransparent==SW_ONOFF_ON) && (termtype==SW_TERMTYPE_PNG);
+  dpi         = floor(settings_term_current.dpi);
+  if ((GSFrames_pid!=0) && (GSFrames_termtype==termtype) && (GSFrames_antialias==antialias) && (GSFrames_transparent==transparent) && (GSFrames_dpi==dpi)) return 0;
+  canvas_GSFramesClose(0);
+
+  if      (termtype==SW_TERMTYPE_PNG) sprintf(DeviceFlag, "-sDEVICE=%s", transparent ? "pngalpha" : "png16m");
+  else if (termtype==SW_TERMTYPE_JPG) sprintf(DeviceFlag, "-sDEVICE=jpeg");
+  else if (termtype==SW_TERMTYPE_BMP) sprintf(DeviceFlag, "-sDEVICE=bmp16m");
+  else                                sprintf(DeviceFlag, "-sDEVICE=tiff24nc");
+  sprintf(ResFlag, "-r%d", (int)dpi);
+  // Leave room in GSFrames_stem for the page number and .tmp suffix which are appended to it
+  len = snprintf(GSFrames_stem, FNAME_LENGTH-24, "%s%spyxplot_%d_frame", settings_session_default.tempdir, PATHLINK, getpid());
+  if ((len < 0) || (len >= FNAME_LENGTH-24)) { ppl_error(ERR_GENERAL, -1, -1, "Name of temporary directory is too long for frames-mode output."); return 1; }
+  snprintf(OutFlag, FNAME_LENGTH+32, "-sOutputFile=%s%%d.tmp", GSFrames_stem);
+
+  argv[i++] = GHOSTSCRIPT_COMMAND;
+  argv[i++] = "-dQUIET";
+  argv[i++] = "-dSAFER";
+  argv[i++] = "-P-";
+  argv[i++] = "-dNOPAUSE";
+  argv[i++] = DeviceFlag;
+  if (termtype==SW_TERMTYPE_JPG) argv[i++] = "-dJPEGQ=100";
+  argv[i++] = ResFlag;
+  argv[i++] = antialias ? "-dGraphicsAlphaBits=4" : "-dGraphicsAlphaBits=0";
+  argv[i++] = antialias ? "-dTextAlphaBits=4"     : "-dTextAlphaBits=0";
+  argv[i++] = OutFlag;
+  argv[i++] = "-";
+  argv[i++] = NULL;
+
+  ForkGhostscript(argv, &GSFrames_pid, &GSFrames_in, &GSFrames_out);
+  GSFrames_termtype    = termtype;
+  GSFrames_antialias   = antialias;
+  GSFrames_transparent = transparent;
+  GSFrames_dpi         = dpi;
+  GSFrames_page        = 0;
+  return 0;
+ }
+
+// Write to the frames-mode ghostscript process, a pipe-full at a time, so that we can give up if ghostscript stops
+// reading. Returns nonzero on failure, setting *TimedOut if ghostscript did not read within the time limit.
+static int canvas_GSFramesWrite(char *buf, long len, int *TimedOut)
+ {
+  fd_set writable;
+  struct timespec waitperiod;
+  long   k;
+
+  while (len > 0)
+   {
+    waitperiod.tv_sec  = GSFRAMES_TIMEOUT;
+    waitperiod.tv_nsec = 0;
+    FD_ZERO(&writable); FD_SET(GSFrames_in, &writable);
+    k = pselect(GSFrames_in+1, NULL, &writable, NULL, &waitperiod, NULL);
+    if ((k<0) && (errno==EINTR)) continue;
+    if (k<=0) { *TimedOut=(k==0); return 1; }
+    k = write(GSFrames_in, buf, (len>PIPE_BUF) ? PIPE_BUF : len); // A pipe which selects as writable has room for PIPE_BUF bytes
+    if ((k<0) && (errno==EINTR)) continue;
+    if (k<0) return 1;
+    buf += k; len -= k;
+   }
+  return 0;
+ }
+
+// Send one EPS file down the pipe to the frames-mode ghostscript process, as a page of its own, and wait until it
+// has been rendered. Returns zero on success, and the filename of the bitmap which ghostscript produced in OutFile.
+static int canvas_GSFramesRender(int termtype, char *EPSFilename, char *OutFile)
+ {
+  FILE  *in;
+  char   marker[64], reply[LSTR_LENGTH], *bb;
+  int    llx=0, lly=0, urx=0, ury=0, GotBB=0, n, ReplyLen=0, TimedOut=0;
+  long   k;
+  fd_set readable;
+  struct timespec waitperiod;
+
+  if ((in = fopen(EPSFilename, "r")) == NULL) { sprintf(temp_err_string, "Could not open temporary file '%s'.", EPSFilename); ppl_error(ERR_FILE, -1, -1, temp_err_string); return 1; }
+  while ((!GotBB) && (fgets(temp_err_string, FNAME_LENGTH, in) != NULL))
+   if ((bb = strstr(temp_err_string, "%%BoundingBox:")) != NULL)
+    GotBB = (sscanf(bb+14, "%d %d %d %d", &llx, &lly, &urx, &ury) == 4);
+  if (!GotBB) { fclose(in); ppl_error(ERR_INTERNAL, -1, -1, "Could not find bounding box of postscript output."); return 1; }
+  rewind(in);
+
+  if (canvas_GSFramesOpen(termtype)) { fclose(in); return 1; }
+  GSFrames_page++;
+  sprintf(marker, "PyXPlot frame %ld done", GSFrames_page);
+
+  // Each page is sized to fit the bounding box of the EPS file, just as the -dEPSCrop option would do. The EPS file
+  // is wrapped in save/restore, and its showpage is suppressed, so that pages cannot interfere with one another.
+  sprintf(temp_err_string, "\n<< /PageSize [%d %d] >> setpagedevice\n/PyXPlot_frame save def /showpage { } def %d %d translate\n", urx-llx, ury-lly, -llx, -lly);
+  n = canvas_GSFramesWrite(temp_err_string, strlen(temp_err_string), &TimedOut);
+  while ((!n) && ((k = fread(reply, 1, LSTR_LENGTH, in)) > 0)) n = canvas_GSFramesWrite(reply, k, &TimedOut);
+  fclose(in);
+  reply[0] = '\0';
+  sprintf(temp_err_string, "\nPyXPlot_frame restore showpage\n(\\n%s\\n) print flush\n", marker);
+  if (!n) n = canvas_GSFramesWrite(temp_err_string, strlen(temp_err_string), &TimedOut);
+
+  // Wait for ghostscript to confirm that the page has been rendered. Anything else it says is an error message.
+  // If writing to the pipe failed, ghostscript has exited, and we read whatever it said before it did so.
+  // Get bored if ghostscript says nothing for too long.
+  while (!TimedOut)
+   {
+    reply[ReplyLen] = '\0';
+    if ((!n) && ((bb = strstr(reply, marker)) != NULL)) { *bb = '\0'; break; }
+    if (ReplyLen > LSTR_LENGTH/2) { memmove(reply, reply+LSTR_LENGTH/4, ReplyLen-LSTR_LENGTH/4); ReplyLen -= LSTR_LENGTH/4; }
+    waitperiod.tv_sec  = GSFRAMES_TIMEOUT;
+    waitperiod.tv_nsec = 0;
+    FD_ZERO(&readable); FD_SET(GSFrames_out, &readable);
+    k = pselect(GSFrames_out+1, &readable, NULL, NULL, &waitperiod, NULL);
+    if      ((k<0) && (errno==EINTR)) continue;
+    else if (k<=0) { n=1; TimedOut=(k==0); break; }
+    k = read(GSFrames_out, reply+ReplyLen, LSTR_LENGTH-1-ReplyLen);
+    if      ((k<0) && (errno==EINTR)) continue;
+    else if (k<=0) { n=1; break; }
+    else ReplyLen += k;
+   }
+
+  // Pass on any messages which ghostscript produced, stripped of surrounding whitespace
+  for (bb=reply; (*bb!='\0') && (*bb<=' '); bb++);
+  for (k=strlen(bb); (k>0) && (bb[k-1]<=' '); k--);
+  bb[k]='\0';
+  if (*bb != '\0') { if (n) ppl_error(ERR_GENERAL, -1, -1, bb); else ppl_warning(ERR_GENERAL, bb); }
+
+  if (n)
+   {
+    if (TimedOut) ppl_error(ERR_GENERAL, -1, -1, "Ghostscript did not finish rendering a frame within the time limit");
+    ppl_error(ERR_GENERAL, -1, -1, "Error encountered whilst using ghostscript to generate frame output");
+    canvas_GSFramesClose(TimedOut);
+    return 1;
+   }
+  k = snprintf(OutFile, FNAME_LENGTH, "%s%ld.tmp", GSFrames_stem, GSFrames_page);
+  return ((k < 0) || (k >= FNAME_LENGTH));
+ }
+
+// Insert a frame number into a filename, before its extension, so that anim.png becomes anim_0001.png.
+// fname is a buffer of length FNAME_LENGTH. Returns nonzero if the numbered filename does not fit into it.
+static int canvas_FrameFilename(char *fname, long FrameNumber)
+ {
+  char ext[FNAME_LENGTH];
+  int  i, j=-1, len;
+  for (i=0; fname[i]!='\0'; i++)
+   if      (fname[i]=='.'        ) j=i;
+   else if (fname[i]==PATHLINK[0]) j=-1;
+  if (j<0) j=i;
+  strcpy(ext, fname+j);
+  len = snprintf(fname+j, FNAME_LENGTH-j, "_%04ld%s", FrameNumber, ext);
+  return ((len < 0) || (len >= FNAME_LENGTH-j));
+ }
+
+// The LaTeX preamble is dumped into a format file the first time that it is used, so that it need not be re-read
+// for every canvas. Thereafter, a latex process with this format loaded is started in advance of each canvas being
+// drawn, so that it is ready and waiting to be told the name of the next document which it is to typeset.
+static int    LaTeXFmt_status=0; // 0 = no format built; 1 = format built; -1 = format could not be built from this preamble
+static long   LaTeXFmt_count=0, LaTeXWorker_count=0;
+// Format and job names are relative to the temporary directory, of the form pyxplot_<pid>_fmt<n>, so are short.
+#define LATEX_JOBNAME_LENGTH 64
+static char   LaTeXFmt_preamble[FNAME_LENGTH], LaTeXFmt_name[LATEX_JOBNAME_LENGTH], LaTeXWorker_job[LATEX_JOBNAME_LENGTH];
+static int    LaTeXWorker_pid=0, LaTeXWorker_in=-1, LaTeXWorker_out=-1;
+
+// Close the pipes to a latex process which is waiting for a document, which will cause it to exit
+static void canvas_LaTeXWorkerClose()
+ {
+  if (LaTeXWorker_pid == 0) return;
+  close(LaTeXWorker_in);
+  close(LaTeXWorker_out);
+  LaTeXWorker_pid = 0;
+  LaTeXWorker_in = LaTeXWorker_out = -1;
+  return;
+ }
+
+// Start a new latex process with our format file loaded. Must be called from within the temporary directory.
+static void canvas_LaTeXWorkerStart()
+ {
+  canvas_LaTeXWorkerClose();
+  sprintf(LaTeXWorker_job, "pyxplot_%d_latex%ld", getpid(), (++LaTeXWorker_count)%2); // Alternate between two job names, so that old output files are overwritten
+  ForkLaTeXWorker(LaTeXFmt_name, LaTeXWorker_job, &LaTeXWorker_pid, &LaTeXWorker_in, &LaTeXWorker_out);
+  if (DEBUG) { sprintf(temp_err_string, "Started latex process %d with format <%s>, waiting to typeset job <%s>.", LaTeXWorker_pid, LaTeXFmt_name, LaTeXWorker_job); ppl_log(temp_err_string); }
+  return;
+ }
+
+// Make sure that a format file has been built from the current LaTeX preamble. Must be called from within the
+// temporary directory. Returns one on success, or zero if the format could not be built, in which case the preamble
+// must be included in each document.
+static int canvas_LaTeXFormat(const char *TextHeader1)
+ {
+  char     filename[FNAME_LENGTH], *str_buffer;
+  int      pid, fstdin, fstdout, k;
+  FILE    *output;
+  fd_set   readable;
+  struct timespec waitperiod;
+
+  if ((LaTeXFmt_status!=0) && (strcmp(LaTeXFmt_preamble, settings_term_current.LatexPreamble)==0)) return (LaTeXFmt_status>0);
+
+  // The preamble has changed, so the old format file, and the latex process which has loaded it, are no use
+  canvas_LaTeXWorkerClose();
+  if (LaTeXFmt_status>0) { sprintf(filename, "%s.fmt", LaTeXFmt_name); remove(filename); }
+  strcpy(LaTeXFmt_preamble, settings_term_current.LatexPreamble);
+  LaTeXFmt_status = -1;
+  sprintf(LaTeXFmt_name, "pyxplot_%d_fmt%ld", getpid(), ++LaTeXFmt_count);
+
+  str_buffer = (char *)lt_malloc(LSTR_LENGTH);
+  if (str_buffer==NULL) return 0;
+  sprintf(filename, "%s.ini", LaTeXFmt_name);
+  output = fopen(filename, "w");
+  if (output == NULL) return 0;
+  fprintf(output, "%s%s\n\\dump\n", TextHeader1, LaTeXFmt_preamble);
+  fclose(output);
+
+  // Run latex in ini mode, with its stdin closed so that it will give up rather than wait if the preamble contains an error
+  ForkLaTeXIni(LaTeXFmt_name, filename, &pid, &fstdin, &fstdout);
+  close(fstdin);
+  while (1)
+   {
+    waitperiod.tv_sec  = 30;
+    waitperiod.tv_nsec = 0;
+    FD_ZERO(&readable); FD_SET(fstdout, &readable);
+    k = pselect(fstdout+1, &readable, NULL, NULL, &waitperiod, NULL);
+    if ((k<0) && (errno==EINTR)) continue;
+    if (k<=0) break; // Error, or latex has taken too long
+    k = read(fstdout, str_buffer, LSTR_LENGTH);
+    if ((k<0) && (errno==EINTR)) continue;
+    if (k<=0) break; // EOF; latex has finished
+   }
+  close(fstdout);
+
+  sprintf(filename, "%s.fmt", LaTeXFmt_name);
+  if (access(filename, R_OK) == 0) LaTeXFmt_status = 1;
+  if (DEBUG) { sprintf(temp_err_string, "%s LaTeX format file <%s>.", (LaTeXFmt_status>0) ? "Built" : "Failed to build", filename); ppl_log(temp_err_string); }
+  return (LaTeXFmt_status>0);
+ }
+
 // Table of the functions we call for each phase of the canvas drawing process for different object types
 static void(*ArrowHandlers[])(EPSComm *) = {NULL                       , NULL                    , NULL                     , NULL                , NULL                , eps_arrow_RenderEPS, NULL};
 static void(*BoxHandlers[]  )(EPSComm *) = {NULL                       , NULL                    , NULL                     , NULL                , NULL                , eps_box_RenderEPS  , NULL};
@@ -147,6 +427,55 @@ static void(*PointHandlers[])(EPSComm *) = {NULL                       , NULL
 static void(*TextHandlers[] )(EPSComm *) = {NULL                       , NULL                    , NULL                     , eps_text_YieldUpText, NULL                , eps_text_RenderEPS , NULL};
 static void(*AfterHandlers[])(EPSComm *) = {NULL                       , NULL                    , NULL                     , canvas_CallLaTeX    , canvas_MakeEPSBuffer, canvas_EPSWrite    , NULL};
 
+// Find the panel at the root of a tree of panels whose axes are linked, by following the array of parents LinkParent
+static int canvas_LinkRoot(int *LinkParent, int id)
+ {
+  while (LinkParent[id] != id) id = LinkParent[id] = LinkParent[LinkParent[id]];
+  return id;
+ }
+
+// Ask for the datafiles plotted on the canvas to be read ahead by worker threads. Plots whose axes are linked, directly or through other
+// plots, are put into one group, which is read by a single thread in the order in which the plots appear on the canvas.
+static void canvas_ReadAhead(EPSComm *x, unsigned char *unsuccessful_ops)
+ {
+  static int     LinkParent[MULTIPLOT_MAXINDEX];
+  canvas_item   *item;
+  settings_axis *axes;
+  int            i, j, a, b;
+
+  if (x->itemlist == NULL) return;
+  for (i=0; i<MULTIPLOT_MAXINDEX; i++) LinkParent[i] = -1;
+  for (item=x->itemlist->first; item!=NULL; item=item->next)
+   if ((!item->deleted) && (!unsuccessful_ops[item->id]) && (item->type == CANVAS_PLOT) && (item->id>=0) && (item->id<MULTIPLOT_MAXINDEX)) LinkParent[item->id] = item->id;
+
+  // Join together the groups of plots whose axes are linked
+  for (item=x->itemlist->first; item!=NULL; item=item->next)
+   {
+    if ((item->id<0) || (item->id>=MULTIPLOT_MAXINDEX) || (LinkParent[item->id]<0)) continue;
+    for (j=0; j<3; j++)
+     {
+      axes = (j==0) ? item->XAxes : ((j==1) ? item->YAxes : item->ZAxes);
+      if (axes == NULL) continue;
+      for (i=0; i<MAX_AXES; i++)
+       {
+        if ((!axes[i].linked) || (axes[i].LinkedAxisCanvasID<=0) || (axes[i].LinkedAxisCanvasID>=MULTIPLOT_MAXINDEX) || (LinkParent[axes[i].LinkedAxisCanvasID]<0)) continue;
+        a = canvas_LinkRoot(LinkParent, item->id);
+        b = canvas_LinkRoot(LinkParent, axes[i].LinkedAxisCanvasID);
+        if (a<b) LinkParent[b] = a; else LinkParent[a] = b;
+       }
+     }
+   }
+
+  for (item=x->itemlist->first; item!=NULL; item=item->next)
+   {
+    if ((item->id<0) || (item->id>=MULTIPLOT_MAXINDEX) || (LinkParent[item->id]<0)) continue;
+    x->current = item;
+    eps_plot_ReadAhead(x, canvas_LinkRoot(LinkParent, item->id));
+   }
+  DataFile_ReadAheadRun();
+  return;
+ }
+
 // Main entry point for rendering a canvas to graphical output
 void canvas_draw(unsigned char *unsuccessful_ops)
  {
@@ -170,6 +499,9 @@ void canvas_draw(unsigned char *unsuccessful_ops)
   void(*TextHandler )(EPSComm *);
   void(*AfterHandler)(EPSComm *);
 
+  // All of our temporary files live in the temporary directory created by the CSP
+  RequireCSP();
+
   // Reset 3D rendering buffer
   ThreeDimBuffer_Reset();
 
@@ -188,10 +520,24 @@ void canvas_draw(unsigned char *unsuccessful_ops)
   // Perform expansion of shell filename shortcuts such as ~
   if ((wordexp(comm.FinalFilename, &WordExp, 0) != 0) || (WordExp.we_wordc <= 0)) { sprintf(temp_err_string, "Could not find directory containing filename '%s'.", comm.FinalFilename); ppl_error(ERR_FILE, -1, -1, temp_err_string); return; }
   if  (WordExp.we_wordc > 1) { sprintf(temp_err_string, "Filename '%s' is ambiguous.", comm.FinalFilename); ppl_error(ERR_FILE, -1, -1, temp_err_string); return; }
+  if (strlen(WordExp.we_wordv[0]) >= FNAME_LENGTH) { wordfree(&WordExp); ppl_error(ERR_FILE, -1, -1, "Output filename is too long."); return; }
   strcpy(FinalFilenameTemp, WordExp.we_wordv[0]);
   wordfree(&WordExp);
   comm.FinalFilename = FinalFilenameTemp;
 
+  // In frames mode, bitmap terminals write each successive plot to a new numbered file
+  if ((settings_term_current.TermFrames==SW_ONOFF_ON) && ((termtype==SW_TERMTYPE_PNG) || (termtype==SW_TERMTYPE_JPG) || (termtype==SW_TERMTYPE_GIF) || (termtype==SW_TERMTYPE_BMP) || (termtype==SW_TERMTYPE_TIF)))
+   {
+    if ((!Frames_active) || (strcmp(Frames_output, FinalFilenameTemp)!=0)) { strcpy(Frames_output, FinalFilenameTemp); Frames_count=0; }
+    Frames_active = 1;
+    if (canvas_FrameFilename(FinalFilenameTemp, ++Frames_count)) { ppl_error(ERR_FILE, -1, -1, "Output filename is too long to have a frame number inserted into it."); return; }
+   }
+  else
+   {
+    Frames_active = 0;
+    canvas_GSFramesClose(0);
+   }
+
   // Create filename for temporary LaTeX document
   comm.TeXFilename = TeXFilenameTemp;
   TeXFile_counter++;
@@ -252,6 +598,9 @@ void canvas_draw(unsigned char *unsuccessful_ops)
     item->PlotBottomMargin = 0.0;
    }
 
+  // Read the datafiles plotted by the panels of a multiplot in worker threads, before the panels come to read their data one at a time
+  canvas_ReadAhead(&comm, unsuccessful_ops);
+
   // Rendering of EPS occurs in a series of phases which we now loop over
   for (j=0 ; ; j++)
    {
@@ -293,6 +642,7 @@ void canvas_draw(unsigned char *unsuccessful_ops)
       if (status) { unsuccessful_ops[item->id] = 1; } // If something went wrong... flag it up and give up on this object
       status = 0;
      }
+    if (j==0) DataFile_ReadAheadClear(); // All data has now been read
     if (AfterHandler != NULL) (*AfterHandler)(&comm); // At the end of each phase, a canvas-wide handler may be called
     if (status) { if (comm.epsbuffer!=NULL) fclose(comm.epsbuffer); return; } // The failure of a canvas-wide handler is fatal
    }
@@ -344,6 +694,21 @@ void canvas_draw(unsigned char *unsuccessful_ops)
         GHOSTSCRIPT_COMMAND, GHOSTSCRIPT_STANDARD_FLAGS, GSOutputTemp, comm.EPSFilename);
     BITMAP_TERMINAL_CLEANUP("ghostscript", "pdf", 0);
    }
+  else if ((termtype==SW_TERMTYPE_PNG) && BITMAP_TERMINAL_RASTERISE(BMP_RASTER_PNG)) // PNG terminal, using built-in rasteriser
+   {
+    BITMAP_TERMINAL_COPY("png", 0)
+    remove(comm.EPSFilename);
+   }
+  else if ((termtype==SW_TERMTYPE_JPG) && BITMAP_TERMINAL_RASTERISE(BMP_RASTER_JPG)) // JPEG terminal, using built-in rasteriser
+   {
+    BITMAP_TERMINAL_COPY("jpeg", 0)
+    remove(comm.EPSFilename);
+   }
+  else if (Frames_active && (termtype!=SW_TERMTYPE_GIF)) // PNG, JPEG, BMP and TIF terminals, in frames mode
+   {
+    if (canvas_GSFramesRender(termtype, comm.EPSFilename, GSOutputTemp) == 0) BITMAP_TERMINAL_COPY("frame", 1)
+    remove(comm.EPSFilename);
+   }
   else if (termtype==SW_TERMTYPE_PNG) // PNG terminal
    {
     sprintf(temp_err_string, "%s %s -sDEVICE=%s -r%d %s -sOutputFile=%s %s",
@@ -411,15 +776,18 @@ void canvas_draw(unsigned char *unsuccessful_ops)
 
 void canvas_CallLaTeX(EPSComm *x)
  {
-  int   linecount=1, i, j, pid, LatexStatus, LatexStdIn, LatexOut;
-  char  filename[FNAME_LENGTH], *str_buffer;
+  int   linecount=1, i, j, k, pid, LatexStatus, LatexStdIn, LatexOut, NItems, NMissing, NPages, *ItemPages, *ItemSource, UseFormat;
+  char  filename[FNAME_LENGTH], DviFilename[FNAME_LENGTH], *str_buffer, **ItemTexts;
+  dviCacheItem **CacheItems;
+  dviInterpreterState *dvi;
+  postscriptPage *page;
   FILE *output;
   ListIterator *ListIter;
   CanvasTextItem *TempTextItem, *SuspectTextItem=NULL;
   struct timespec waitperiod; // A time.h timespec specifier for a wait of zero seconds
   unsigned char   FirstIter;
   fd_set          readable;
-  sigset_t        sigs;
+  sigset_t        sigs, WaitMask;
 
   int  ErrLineNo=0, ErrReadState=0, ErrReadPos=0, NCharsRead=0, ReadErrorState=0, TrialNumber;
   char ErrFilename[FNAME_LENGTH]="", ErrMsg[FNAME_LENGTH]="";
@@ -427,6 +795,31 @@ void canvas_CallLaTeX(EPSComm *x)
 
   if (ListLen(x->TextItems) < 1) return; // We have no text to give to latex, and so don't need to fork
 
+  // Look up each text item in the cache of strings which LaTeX has typeset before, with the same preamble
+  dviCacheTrim();
+  NItems     = ListLen(x->TextItems);
+  CacheItems = (dviCacheItem **)lt_malloc(NItems * sizeof(dviCacheItem *));
+  ItemTexts  = (char         **)lt_malloc(NItems * sizeof(char *));
+  ItemPages  = (int           *)lt_malloc(NItems * sizeof(int));
+  ItemSource = (int           *)lt_malloc(NItems * sizeof(int));
+  if ((CacheItems==NULL)||(ItemTexts==NULL)||(ItemPages==NULL)||(ItemSource==NULL)) { ppl_error(ERR_MEMORY,-1,-1,"Out of memory."); *(x->status)=1; return; }
+  ListIter = ListIterateInit(x->TextItems);
+  for (i=NMissing=0; ListIter != NULL; i++)
+   {
+    TempTextItem  = (CanvasTextItem *)ListIter->data;
+    ItemTexts [i] = TempTextItem->text;
+    CacheItems[i] = dviCacheFetch(settings_term_current.LatexPreamble, TempTextItem->text);
+    if (CacheItems[i]==NULL) NMissing++;
+    ListIter = ListIterate(ListIter, NULL);
+   }
+  if (DEBUG) { sprintf(temp_err_string, "%d of %d text items found in cache of typeset text.", NItems-NMissing, NItems); ppl_log(temp_err_string); }
+  if (NMissing==0) // Every string has been typeset before, and so we don't need to fork latex
+   {
+    x->dvi = dviCacheInterpreter(CacheItems, NItems);
+    if (x->dvi == NULL) *(x->status)=1;
+    return;
+   }
+
   sigemptyset(&sigs);
   sigaddset(&sigs,SIGCHLD);
 
@@ -441,26 +834,43 @@ void canvas_CallLaTeX(EPSComm *x)
 
   // Make string buffer
   str_buffer = (char *)lt_malloc(LSTR_LENGTH);
-  if (str_buffer==NULL) { ppl_error(ERR_MEMORY,-1,-1,"Out of memory."); return; }
+  if (str_buffer==NULL) { ppl_error(ERR_MEMORY,-1,-1,"Out of memory."); if (chdir(settings_session_default.cwd) < 0) { ppl_fatal(__FILE__,__LINE__,"chdir into cwd failed."); } return; }
+
+  // Make sure that the preamble has been dumped into a format file
+  UseFormat = canvas_LaTeXFormat(TextHeader1);
 
   // Start writing LaTeX document
   sprintf(filename, "%s.tex", x->TeXFilename);
   output = fopen(filename, "w");
-  if (output == NULL) { ppl_error(ERR_INTERNAL, -1, -1, "Could not create temporary LaTeX document"); *(x->status)=1; return; }
-  FPRINTF_LINECOUNT(TextHeader1);
-  FPRINTF_LINECOUNT(settings_term_current.LatexPreamble);
+  if (output == NULL) { ppl_error(ERR_INTERNAL, -1, -1, "Could not create temporary LaTeX document"); *(x->status)=1; if (chdir(settings_session_default.cwd) < 0) { ppl_fatal(__FILE__,__LINE__,"chdir into cwd failed."); } return; }
+  if (!UseFormat) // If the preamble has been loaded from a format file, it is not included in the document
+   {
+    FPRINTF_LINECOUNT(TextHeader1);
+    FPRINTF_LINECOUNT(settings_term_current.LatexPreamble);
+   }
   FPRINTF_LINECOUNT(TextHeader2);
 
-  // Sequentially print out text strings
+  // Sequentially print out text strings which are not in the cache, each only once
   ListIter = ListIterateInit(x->TextItems);
-  while (ListIter != NULL)
+  for (k=NPages=0; ListIter != NULL; k++)
    {
     TempTextItem = (CanvasTextItem *)ListIter->data;
-    TempTextItem->LaTeXstartline = linecount;
-    FPRINTF_LINECOUNT(ItemHeader);
-    FPRINTF_LINECOUNT(TempTextItem->text);
-    FPRINTF_LINECOUNT(ItemFooter);
-    TempTextItem->LaTeXendline   = linecount;
+    TempTextItem->LaTeXstartline = TempTextItem->LaTeXendline = -1;
+    ItemPages[k] = ItemSource[k] = -1;
+    if (CacheItems[k] == NULL)
+     {
+      for (j=0; j<k; j++) if ((ItemSource[j]==j) && (strcmp(ItemTexts[j], ItemTexts[k])==0)) break;
+      ItemSource[k] = j;
+      if (j==k)
+       {
+        ItemPages[k] = ++NPages;
+        TempTextItem->LaTeXstartline = linecount;
+        FPRINTF_LINECOUNT(ItemHeader);
+        FPRINTF_LINECOUNT(TempTextItem->text);
+        FPRINTF_LINECOUNT(ItemFooter);
+        TempTextItem->LaTeXendline   = linecount;
+       }
+     }
     ListIter = ListIterate(ListIter, NULL);
    }
 
@@ -468,10 +878,27 @@ void canvas_CallLaTeX(EPSComm *x)
   FPRINTF_LINECOUNT(TextFooter);
   fclose(output);
 
-  // Fork LaTeX process
-  ForkLaTeX(filename, &pid, &LatexStdIn, &LatexOut);
+  // Fork LaTeX process, or else tell the latex process which is waiting with our format file loaded to typeset our document
+  if (UseFormat)
+   {
+    if ((LaTeXWorker_pid==0) || (kill(LaTeXWorker_pid, 0)!=0)) canvas_LaTeXWorkerStart();
+    pid = LaTeXWorker_pid; LatexStdIn = LaTeXWorker_in; LatexOut = LaTeXWorker_out;
+    LaTeXWorker_pid = 0; // This process is now ours; another will be started once it has finished
+    sprintf(DviFilename, "%s.dvi", LaTeXWorker_job);
+    sprintf(temp_err_string, "%s\n", filename);
+    if (write(LatexStdIn, temp_err_string, strlen(temp_err_string)) < 0) { if (DEBUG) ppl_log("Could not send filename to latex process."); }
+   }
+  else
+   {
+    ForkLaTeX(filename, &pid, &LatexStdIn, &LatexOut);
+    sprintf(DviFilename, "%s.dvi", x->TeXFilename);
+   }
 
   // Wait for latex process's stdout to become readable. Get bored if this takes too long.
+  // SIGCHLD is held off whilst waiting, since latex processes from previous canvases may exit at any moment, and each
+  // would otherwise interrupt the wait.
+  sigprocmask(SIG_BLOCK, NULL, &WaitMask);
+  sigaddset(&WaitMask, SIGCHLD);
   FirstIter = 1;
   LatexStatus = 0;
   while (1)
@@ -483,7 +910,7 @@ void canvas_CallLaTeX(EPSComm *x)
       if (ReadErrorState) { waitperiod.tv_nsec = 500000000; waitperiod.tv_sec = 0; } // If we've had an error message, only wait 0.5 sec
       if (DEBUG) { sprintf(temp_err_string,"pselect waiting for %ld seconds and %ld nanoseconds",waitperiod.tv_sec,waitperiod.tv_nsec); ppl_log(temp_err_string); }
       FD_ZERO(&readable); FD_SET(LatexOut, &readable);
-      if (pselect(LatexOut+1, &readable, NULL, NULL, &waitperiod, NULL) == -1)
+      if (pselect(LatexOut+1, &readable, NULL, NULL, &waitperiod, &WaitMask) == -1)
        {
         if (DEBUG) { sprintf(temp_err_string,"pselect returned -1. errno=%d",errno); ppl_log(temp_err_string); }
         if ((errno==EINTR) && (TrialNumber<3)) { TrialNumber++; continue; }
@@ -536,6 +963,7 @@ void canvas_CallLaTeX(EPSComm *x)
           if (ErrReadPos > FNAME_LENGTH-1) ErrReadPos=FNAME_LENGTH-1;
          }
        }
+      else if ((NCharsRead<0) && (errno==EINTR)) { continue; } // read was interrupted by a signal, perhaps from another helper process exiting
       else { break; } // read function returned zero; indicates EOF
      }
    }
@@ -544,6 +972,7 @@ void canvas_CallLaTeX(EPSComm *x)
   close(LatexStdIn); // This has the effect of killing latex
   close(LatexOut);
   sigprocmask(SIG_UNBLOCK, &sigs, NULL);
+  if (UseFormat) canvas_LaTeXWorkerStart(); // Have a latex process ready and waiting for the next canvas
 
   // Return error message if latex has failed
   if (LatexStatus)
@@ -556,6 +985,7 @@ void canvas_CallLaTeX(EPSComm *x)
       while (ListIter != NULL)
        {
         TempTextItem = (CanvasTextItem *)ListIter->data;
+        if (TempTextItem->LaTeXstartline < 0) { ListIter = ListIterate(ListIter, NULL); continue; } // This item was taken from the cache
         if (TempTextItem->LaTeXstartline > ErrLineNo) break; // We have gone past the line number where the error happened
         SuspectTextItem = TempTextItem;
         ExactHit        = (TempTextItem->LaTeXendline >= ErrLineNo); // If this is zero, then error was after the end of the item we just looked at
@@ -601,9 +1031,21 @@ void canvas_CallLaTeX(EPSComm *x)
    }
 
   // Convert dvi into postscript fragments
-  sprintf(filename, "%s.dvi", x->TeXFilename);
-  x->dvi = ReadDviFile(filename, x->status);
-  if (*(x->status)) return; // DVI interpreter failed
+  dvi = ReadDviFile(DviFilename, x->status);
+  if (*(x->status)) { if (chdir(settings_session_default.cwd) < 0) { ppl_fatal(__FILE__,__LINE__,"chdir into cwd failed."); } return; } // DVI interpreter failed
+
+  // Add newly typeset strings to the cache, and then assemble all of the postscript fragments we need from it
+  for (i=0; i<NItems; i++)
+   {
+    if      (ItemSource[i] <  0) continue;
+    else if (ItemSource[i] != i) { CacheItems[i] = CacheItems[ItemSource[i]]; continue; }
+    page = (postscriptPage *)ListGetItem(dvi->output->pages, ItemPages[i]);
+    if (page==NULL) { ppl_error(ERR_INTERNAL, -1, -1, "Not all text items were rendered by LaTeX"); *(x->status)=1; if (chdir(settings_session_default.cwd) < 0) { ppl_fatal(__FILE__,__LINE__,"chdir into cwd failed."); } return; }
+    CacheItems[i] = dviCacheStore(settings_term_current.LatexPreamble, ItemTexts[i], page, dvi->fonts);
+    if (CacheItems[i]==NULL) { ppl_error(ERR_MEMORY,-1,-1,"Out of memory."); *(x->status)=1; if (chdir(settings_session_default.cwd) < 0) { ppl_fatal(__FILE__,__LINE__,"chdir into cwd failed."); } return; }
+   }
+  x->dvi = dviCacheInterpreter(CacheItems, NItems);
+  if (x->dvi == NULL) { *(x->status)=1; if (chdir(settings_session_default.cwd) < 0) { ppl_fatal(__FILE__,__LINE__,"chdir into cwd failed."); } return; }
 
   // Return to user's current working directory after LaTeX has finished making a mess
   if (chdir(settings_session_default.cwd) < 0) { ppl_fatal(__FILE__,__LINE__,"chdir into cwd failed."); }
@@ -623,8 +1065,8 @@ void canvas_EPSWrite(EPSComm *x)
  {
   int i;
   double PAGEwidth, PAGEheight, margin_left, margin_top, margin_right, margin_bottom;
-  FILE *epsout, *PFAfile;
-  char LandscapifyText[FNAME_LENGTH], EnlargementText[FNAME_LENGTH], *PaperName, *PFAfilename;
+  FILE *epsout;
+  char LandscapifyText[FNAME_LENGTH], EnlargementText[FNAME_LENGTH], *PaperName, *PFAfilename, *PFAtext;
   ListIterator *ListIter;
 
   // Check that we have a bounding box
@@ -714,17 +1156,16 @@ void canvas_EPSWrite(EPSComm *x)
     if (PFAfilename != NULL)  // PFAfilename==NULL indicates that this is a built-in font that doesn't require a fontdef
      {
       fprintf(epsout, "%%%%BeginFont: %s\n", ((dviFontDetails *)ListIter->data)->psName);
-      PFAfile = fopen(PFAfilename,"r");
-      if (PFAfile==NULL) { sprintf(temp_err_string, "Could not open pfa file '%s'", PFAfilename); ppl_error(ERR_FILE, -1, -1, temp_err_string); *(x->status)=1; fclose(epsout); return; }
-      while (fgets(temp_err_string, FNAME_LENGTH, PFAfile) != NULL)
-       if (fputs(temp_err_string, epsout) == EOF)
-        {
-         sprintf(temp_err_string, "Error while writing to file '%s'.", x->EPSFilename); ppl_error(ERR_FILE, -1, -1, temp_err_string);
-         *(x->status)=1;
-         fclose(PFAfile); fclose(epsout);
-         return;
-        }
-      fclose(PFAfile);
+      PFAtext = dviGetPfaText(PFAfilename); // Kept in memory once read, so that it need not be read again for the next EPS file
+      if (PFAtext==NULL) { sprintf(temp_err_string, "Could not open pfa file '%s'", PFAfilename); ppl_error(ERR_FILE, -1, -1, temp_err_string); *(x->status)=1; fclose(epsout); if (chdir(settings_session_default.cwd) < 0) { ppl_fatal(__FILE__,__LINE__,"chdir into cwd failed."); } return; }
+      if (fputs(PFAtext, epsout) == EOF)
+       {
+        sprintf(temp_err_string, "Error while writing to file '%s'.", x->EPSFilename); ppl_error(ERR_FILE, -1, -1, temp_err_string);
+        *(x->status)=1;
+        fclose(epsout);
+        if (chdir(settings_session_default.cwd) < 0) { ppl_fatal(__FILE__,__LINE__,"chdir into cwd failed."); }
+        return;
+       }
       fprintf(epsout, "\n%%%%EndFont\n");
      }
     ListIter = ListIterate(ListIter, NULL);
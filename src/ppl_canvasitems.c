@@ -81,6 +81,7 @@ static void canvas_item_delete(canvas_item *ptr)
     if (pd->functions       != NULL) free(pd->functions);
     if (pd->label           != NULL) free(pd->label);
     if (pd->SelectCriterion != NULL) free(pd->SelectCriterion);
+    if (pd->BinaryFormat    != NULL) free(pd->BinaryFormat);
     if (pd->title           != NULL) free(pd->title);
     if (pd->UsingList       != NULL) free(pd->UsingList);
     free(pd);
@@ -459,6 +460,7 @@ char *canvas_item_textify(canvas_item *ptr, char *output)
       if (pd->IndexSet) { sprintf(output+i, " index %d", pd->index); i+=strlen(output+i); } // Print index to use
       if (pd->label!=NULL) { sprintf(output+i, " label %s", pd->label); i+=strlen(output+i); } // Print label string
       if (pd->SelectCriterion!=NULL) { sprintf(output+i, " select %s", pd->SelectCriterion); i+=strlen(output+i); } // Print select criterion
+      if (pd->BinaryFormat!=NULL) { sprintf(output+i, " binary "); i+=strlen(output+i); StrEscapify(pd->BinaryFormat, output+i); i+=strlen(output+i); } // Print binary record format
       if (pd->ContinuitySet) // Print continuous / discontinuous flag
        {
         if (pd->continuity == DATAFILE_DISCONTINUOUS) { sprintf(output+i, " discontinuous"); i+=strlen(output+i); }
@@ -1302,7 +1304,7 @@ FinishedUsing:
     if (errbuff==NULL) { canvas_delete(id); ppl_error(ERR_GENERAL, -1, -1, "Piechart has been removed from multiplot, because it generated an error."); return 1; }
 
     if (eps_plot_AddUsingItemsForWithWords(&pd->ww_final, &NExpect, &AutoUsingList, UsingList)) { canvas_delete(id); ppl_error(ERR_GENERAL, -1, -1, "Piechart has been removed from multiplot, because it generated an error."); return 1; } // Add extra using items for, e.g. "linewidth $3".
-    DataFile_read(&pd->PersistentDataTable, &status, errbuff, pd->filename, pd->index, pd->UsingRowCols, UsingList, AutoUsingList, EveryList, pd->label, NExpect, pd->SelectCriterion, pd->continuity, NULL, -1, 1, &ErrCount);
+    DataFile_read(&pd->PersistentDataTable, &status, errbuff, pd->filename, pd->BinaryFormat, pd->index, pd->UsingRowCols, UsingList, AutoUsingList, EveryList, pd->label, NExpect, pd->SelectCriterion, pd->continuity, NULL, -1, 1, &ErrCount);
    }
 
   // Redisplay the canvas as required
@@ -1772,6 +1774,16 @@ int directive_plot(Dict *command, int interactive, int replot)
         strcpy((*PlotItemPtr)->SelectCriterion, SelectCrit);
        }
 
+      // Look up binary modifier
+      DictLookup(TempDict, "binary_format", NULL, (void *)&tempstr);
+      if (tempstr==NULL) { (*PlotItemPtr)->BinaryFormat = NULL; }
+      else
+       {
+        (*PlotItemPtr)->BinaryFormat = (char *)malloc(strlen(tempstr)+1);
+        if ((*PlotItemPtr)->BinaryFormat == NULL)  { ppl_error(ERR_MEMORY, -1, -1,"Out of memory."); free(*PlotItemPtr); *PlotItemPtr = NULL; return 1; }
+        strcpy((*PlotItemPtr)->BinaryFormat, tempstr);
+       }
+
       // Look up using modifiers
       DictLookup(TempDict, "using_list:", NULL, (void *)&UsingList);
       if (UsingList==NULL) { (*PlotItemPtr)->NUsing = 0; (*PlotItemPtr)->UsingList = NULL; }
@@ -1834,7 +1846,7 @@ FinishedUsing:
         if (errbuff==NULL) { ppl_error(ERR_MEMORY, -1, -1,"Out of memory."); free(*PlotItemPtr); *PlotItemPtr = NULL; return 1; }
 
         if (eps_plot_AddUsingItemsForWithWords(&pd->ww, &NExpect, &AutoUsingList, UsingList)) { free(*PlotItemPtr); *PlotItemPtr = NULL; return 1; } // Add extra using items for, e.g. "linewidth $3".
-        DataFile_read(&pd->PersistentDataTable, &status, errbuff, pd->filename, pd->index, pd->UsingRowCols, UsingList, AutoUsingList, EveryList, pd->label, NExpect, pd->SelectCriterion, pd->continuity, (linespoints==SW_STYLE_BOXES)?"@":NULL, DATAFILE_DISCONTINUOUS, 1, &ErrCount);
+        DataFile_read(&pd->PersistentDataTable, &status, errbuff, pd->filename, pd->BinaryFormat, pd->index, pd->UsingRowCols, UsingList, AutoUsingList, EveryList, pd->label, NExpect, pd->SelectCriterion, pd->continuity, (linespoints==SW_STYLE_BOXES)?"@":NULL, DATAFILE_DISCONTINUOUS, 1, &ErrCount);
        }
 
       PlotItemPtr=&(*PlotItemPtr)->next; // Next plot item...
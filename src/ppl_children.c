@@ -26,7 +26,9 @@
 #include <errno.h>
 #include <signal.h>
 #include <time.h>
+#include <fcntl.h>
 #include <sys/stat.h>
+#include <sys/time.h>
 #include <sys/wait.h>
 #include <sys/select.h>
 
@@ -56,6 +58,7 @@ static char SIGTERM_NAME[16]; // The name of SIGTERM, which we filter out from G
 static List *GhostViews;                    // A list of X11_multiwindow and X11_singlewindow sessions which we kill on PyXPlot exit
 static List *GhostView_Persists;            // A list of X11_persist sessions for which we leave our temporary directory until they quit
 static List *HelperPIDs;                    // A list of helper processes forked by the main PyXPlot process
+static List *PersistentPIDs;                // Long-lived helper processes, which are not killed at the end of each command
 static int   GhostView_pid = 0;             // pid of any running gv process launched under X11_singlewindow
 char         GhostView_Fname[FNAME_LENGTH]; // Filename of the eps file currently being viewed in X11_singlewindow
 static int   PyXPlotRunning = 1;            // Flag which we drop in the CSP when the main process stops running
@@ -64,27 +67,63 @@ static int   PyXPlotRunning = 1;            // Flag which we drop in the CSP whe
 
 void  InitialiseCSP()
  {
-  int pid, fail;
-  struct stat statinfo;
-
   // Create empty lists for storing lists of GhostView processes
   GhostViews         = ListInit();
   GhostView_Persists = ListInit();
   HelperPIDs         = ListInit();
+  PersistentPIDs     = ListInit();
 
   // The string "signal 15" we filter out of GhostView's output
   sprintf(SIGTERM_NAME, "signal %d", SIGTERM);
 
+  // The CSP itself is not launched until something needs it; see RequireCSP()
+  if (signal(SIGCHLD, PPLCheckForChildExits) == SIG_ERR) ppl_fatal(__FILE__,__LINE__,"Main process could not set up a signal handler for SIGCHLD.");
+  return;
+ }
+
+// Create our temporary directory and launch the CSP, if this has not already been done. This must be called before any
+// helper process is forked, or the temporary directory is used. Sessions which never produce any graphical output
+// never need to pay the cost of forking the CSP.
+void  RequireCSP()
+ {
+  static int CSPRunning = 0;
+  int pid, fail;
+  struct stat    statinfo;
+  struct timeval StartTime, EndTime;
+
+  if (CSPRunning) return;
+  CSPRunning = 1;
+  if (DEBUG) { ppl_log("Launching the Child Support Process."); gettimeofday(&StartTime, NULL); }
+
+  // Make temporary working directory. We do this before forking the CSP, rather than waiting for the CSP to do it.
+  fail=0;
+  if ((mkdir(settings_session_default.tempdir , 0700) != 0) ||             // Create temporary working directory
+      (access(settings_session_default.tempdir, F_OK) != 0) )  { fail=1; } // If temporary directory does not exist, fail.
+  else
+   {
+    if (stat(settings_session_default.tempdir, &statinfo) <0) fail=1; // Otherwise stat it and make sure it's a directory we own
+    if (!S_ISDIR(statinfo.st_mode)) fail=1;
+    if (statinfo.st_uid != getuid()) fail=1;
+   }
+  if (fail==1) { ppl_fatal(__FILE__,__LINE__,"Failed to create temporary directory." ); }
+
   // Create pipes for communication between main process and the CSP
   if (pipe(PipeCSP2MAIN) < 0) ppl_fatal(__FILE__,__LINE__,"Could not create a pipe.");
   if (pipe(PipeMAIN2CSP) < 0) ppl_fatal(__FILE__,__LINE__,"Could not create a pipe.");
 
+  fflush(NULL); // Make sure that the CSP does not inherit any buffered output, which it would write a second time when it exits
+
   if      ((pid=fork()) < 0) ppl_fatal(__FILE__,__LINE__,"Could not fork a child process for the CSP.");
   else if ( pid        != 0)
    {
     close(PipeMAIN2CSP[0]); // Parent process; close CSP's ends of pipes
     //close(PipeCSP2MAIN[1]); // Leave this pipe open so that sed can return error messages down it
-    if (signal(SIGCHLD, PPLCheckForChildExits) == SIG_ERR) ppl_fatal(__FILE__,__LINE__,"Main process could not set up a signal handler for SIGCHLD.");
+    if (DEBUG)
+     {
+      gettimeofday(&EndTime, NULL);
+      sprintf(temp_err_string, "Child Support Process launched in %.3f ms.", (EndTime.tv_sec-StartTime.tv_sec)*1e3 + (EndTime.tv_usec-StartTime.tv_usec)*1e-3);
+      ppl_log(temp_err_string);
+     }
     return; // Parent process returns
    }
 
@@ -94,20 +133,9 @@ void  InitialiseCSP()
 
   // Make all log messages appear to come from the CSP
   sprintf(ppl_error_source, "CSP%6d", getpid());
-  signal(SIGINT, SIG_IGN); // Ignore SIGINT
+  signal(SIGINT , SIG_IGN); // Ignore SIGINT
+  signal(SIGPIPE, SIG_DFL); // The main process ignores SIGPIPE, but the viewers we launch should not inherit this
   if (setpgid( getpid() , getpid() ) < 0) if (DEBUG) ppl_log("Failed to set process group ID."); // Make into a process group leader so that we won't catch SIGINT
-
-  // Make temporary working directory
-  fail=0;
-  if ((mkdir(settings_session_default.tempdir , 0700) != 0) ||             // Create temporary working directory
-      (access(settings_session_default.tempdir, F_OK) != 0) )  { fail=1; } // If temporary directory does not exist, fail.
-  else
-   {
-    if (stat(settings_session_default.tempdir, &statinfo) <0) fail=1; // Otherwise stat it and make sure it's a directory we own
-    if (!S_ISDIR(statinfo.st_mode)) fail=1;
-    if (statinfo.st_uid != getuid()) fail=1;
-   }
-  if (fail==1)                                     { ppl_fatal(__FILE__,__LINE__,"Failed to create temporary directory." ); }
   if (chdir(settings_session_default.tempdir) < 0) { ppl_fatal(__FILE__,__LINE__,"chdir into temporary directory failed."); } // chdir into temporary directory
 
   // Enter CSP execution loop
@@ -130,6 +158,8 @@ void CheckForGvOutput()
   int             pos, TrialNumber;
   char            linebuffer[SSTR_LENGTH];
 
+  if (PipeCSP2MAIN[0]==0) return; // CSP has not yet been launched, so nothing can have written to it
+
   TrialNumber=1;
   while (1)
    {
@@ -416,17 +446,22 @@ void CSPKillLatestSinglewindow()
 void PPLCheckForChildExits(int signo)
  {
   ListIterator *iter;
-  int          *pid;
+  List         *list;
+  int          *pid, i;
   char          text[256];
 
-  iter = ListIterateInit(HelperPIDs);
-  while (iter != NULL)
+  for (i=0; i<2; i++)
    {
-    iter = ListIterate(iter, (void *)&pid);
-    if (waitpid(*pid,NULL,WNOHANG) != 0)
+    list = (i==0) ? HelperPIDs : PersistentPIDs;
+    iter = ListIterateInit(list);
+    while (iter != NULL)
      {
-      if (DEBUG) { sprintf(text, "A helper process with pid %d has terminated.", *pid); ppl_log(text); }
-      ListRemovePtr(HelperPIDs, (void *)pid); // Stabat mater dolorosa
+      iter = ListIterate(iter, (void *)&pid);
+      if (waitpid(*pid,NULL,WNOHANG) != 0)
+       {
+        if (DEBUG) { sprintf(text, "A helper process with pid %d has terminated.", *pid); ppl_log(text); }
+        ListRemovePtr(list, (void *)pid); // Stabat mater dolorosa
+       }
      }
    }
   return;
@@ -458,6 +493,8 @@ void ForkSed(char *cmd, int *fstdin, int *fstdout)
   int pid;
   sigset_t sigs;
 
+  RequireCSP(); // Launch the CSP before forking any helper, so that it does not inherit the helper's pipes
+
   sigemptyset(&sigs);
   sigaddset(&sigs,SIGCHLD);
 
@@ -507,13 +544,15 @@ void ForkSed(char *cmd, int *fstdin, int *fstdout)
   return;
  }
 
-// NB: Leaves SIGCHLD blocked
-void ForkLaTeX(char *filename, int *PidOut, int *fstdin, int *fstdout)
+// Fork a latex process with the commandline arguments argv. Persistent processes are not killed at the end of each command.
+static void ForkLaTeXArgv(char **argv, int persistent, int *PidOut, int *fstdin, int *fstdout)
  {
   int fd0[2], fd1[2];
   int pid;
   sigset_t sigs;
 
+  RequireCSP(); // Launch the CSP before forking any helper, so that it does not inherit the helper's pipes
+
   sigemptyset(&sigs);
   sigaddset(&sigs,SIGCHLD);
 
@@ -527,8 +566,10 @@ void ForkLaTeX(char *filename, int *PidOut, int *fstdin, int *fstdout)
     // Parent process
     close(fd0[0]); *fstdin  = fd0[1];
     close(fd1[1]); *fstdout = fd1[0];
+    fcntl(fd0[1], F_SETFD, FD_CLOEXEC); // Other helpers must not hold latex's pipes open after we close them
+    fcntl(fd1[0], F_SETFD, FD_CLOEXEC);
     *PidOut = pid;
-    ListAppendInt(HelperPIDs, pid);
+    ListAppendInt(persistent ? PersistentPIDs : HelperPIDs, pid);
     sigprocmask(SIG_UNBLOCK, &sigs, NULL);
     return;
    }
@@ -541,7 +582,7 @@ void ForkLaTeX(char *filename, int *PidOut, int *fstdin, int *fstdout)
     sigprocmask(SIG_UNBLOCK, &sigs, NULL);
     sprintf(ppl_error_source, "TEX%6d", getpid());
     settings_session_default.colour = SW_ONOFF_OFF;
-    if (DEBUG) { sprintf(temp_err_string, "New latex process alive; going to latex file \"%s\".", filename); ppl_log(temp_err_string); }
+    if (DEBUG) { sprintf(temp_err_string, "New latex process alive; going to run latex with arguments starting \"%s\".", argv[1]); ppl_log(temp_err_string); }
     if (fd0[0] != STDIN_FILENO) // Redirect stdin to pipe
      {
       if (dup2(fd0[0], STDIN_FILENO) != STDIN_FILENO) ppl_fatal(__FILE__,__LINE__,"Could not redirect stdin to pipe.");
@@ -556,8 +597,102 @@ void ForkLaTeX(char *filename, int *PidOut, int *fstdin, int *fstdout)
       if (dup2(fd1[1], STDERR_FILENO) != STDERR_FILENO) ppl_fatal(__FILE__,__LINE__,"Could not redirect stderr to pipe.");
       close(fd1[1]);
      }
-    if (execl(LATEX_COMMAND, LATEX_COMMAND, "-file-line-error", filename, NULL)!=0) if (DEBUG) ppl_log("Attempt to execute latex returned error code."); // Execute latex
-    ppl_error(ERR_GENERAL, -1, -1, "Execution of helper process 'latex' failed."); // execlp call should not return
+    if (execv(LATEX_COMMAND, argv)!=0) if (DEBUG) ppl_log("Attempt to execute latex returned error code."); // Execute latex
+    ppl_error(ERR_GENERAL, -1, -1, "Execution of helper process 'latex' failed."); // execv call should not return
+    exit(1);
+   }
+  return;
+ }
+
+// Fork a latex process to typeset the file filename
+void ForkLaTeX(char *filename, int *PidOut, int *fstdin, int *fstdout)
+ {
+  char *argv[] = { LATEX_COMMAND, "-file-line-error", filename, NULL };
+  ForkLaTeXArgv(argv, 0, PidOut, fstdin, fstdout);
+  return;
+ }
+
+// Fork a latex process in ini mode, which loads the standard LaTeX format, reads the file filename, and dumps a new
+// format file called JobName.fmt into the current working directory
+void ForkLaTeXIni(char *JobName, char *filename, int *PidOut, int *fstdin, int *fstdout)
+ {
+  char  JobOpt[FNAME_LENGTH];
+  char *argv[] = { LATEX_COMMAND, "-ini", JobOpt, "&latex", filename, NULL };
+  snprintf(JobOpt, FNAME_LENGTH, "-jobname=%s", JobName);
+  JobOpt[FNAME_LENGTH-1]='\0';
+  ForkLaTeXArgv(argv, 0, PidOut, fstdin, fstdout);
+  return;
+ }
+
+// Fork a latex process which loads the format file FormatName.fmt, and then waits for the name of a file to typeset to
+// be sent to its stdin. Its output goes to JobName.dvi. It is not killed at the end of each command, so that it can be
+// started in advance of being needed.
+void ForkLaTeXWorker(char *FormatName, char *JobName, int *PidOut, int *fstdin, int *fstdout)
+ {
+  char  FmtOpt[FNAME_LENGTH], JobOpt[FNAME_LENGTH];
+  char *argv[] = { LATEX_COMMAND, "-file-line-error", FmtOpt, JobOpt, NULL };
+  snprintf(FmtOpt, FNAME_LENGTH, "-fmt=%s", FormatName);
+  snprintf(JobOpt, FNAME_LENGTH, "-jobname=%s", JobName);
+  FmtOpt[FNAME_LENGTH-1] = JobOpt[FNAME_LENGTH-1] = '\0';
+  ForkLaTeXArgv(argv, 1, PidOut, fstdin, fstdout);
+  return;
+ }
+
+// Fork a ghostscript process which reads PostScript from a pipe. Its stdout and stderr are both returned through fstdout.
+void ForkGhostscript(char **argv, int *PidOut, int *fstdin, int *fstdout)
+ {
+  int fd0[2], fd1[2];
+  int pid;
+  sigset_t sigs;
+
+  RequireCSP(); // Launch the CSP before forking any helper, so that it does not inherit the helper's pipes
+
+  sigemptyset(&sigs);
+  sigaddset(&sigs,SIGCHLD);
+
+  if ((pipe(fd0)<0) || (pipe(fd1)<0)) ppl_fatal(__FILE__,__LINE__,"Could not open required pipes.");
+
+  sigprocmask(SIG_BLOCK, &sigs, NULL);
+
+  if      ((pid=fork()) < 0) ppl_fatal(__FILE__,__LINE__,"Could not fork a child process for ghostscript process.");
+  else if ( pid        != 0)
+   {
+    // Parent process
+    close(fd0[0]); *fstdin  = fd0[1];
+    close(fd1[1]); *fstdout = fd1[0];
+    fcntl(fd0[1], F_SETFD, FD_CLOEXEC); // Other helpers must not hold ghostscript's pipes open after we close them
+    fcntl(fd1[0], F_SETFD, FD_CLOEXEC);
+    *PidOut = pid;
+    ListAppendInt(PersistentPIDs, pid); // Ghostscript lives on from one command to the next; it exits when we close its stdin
+    sigprocmask(SIG_UNBLOCK, &sigs, NULL);
+    return;
+   }
+  else
+   {
+    // Child process
+    close(fd0[1]); close(fd1[0]);
+    close(PipeCSP2MAIN[0]);
+    close(PipeMAIN2CSP[1]);
+    sigprocmask(SIG_UNBLOCK, &sigs, NULL);
+    sprintf(ppl_error_source, "GS %6d", getpid());
+    settings_session_default.colour = SW_ONOFF_OFF;
+    if (DEBUG) ppl_log("New ghostscript process alive; going to read PostScript from pipe.");
+    if (fd0[0] != STDIN_FILENO) // Redirect stdin to pipe
+     {
+      if (dup2(fd0[0], STDIN_FILENO) != STDIN_FILENO) ppl_fatal(__FILE__,__LINE__,"Could not redirect stdin to pipe.");
+      close(fd0[0]);
+     }
+    if (fd1[1] != STDOUT_FILENO) // Redirect stdout to pipe
+     {
+      if (dup2(fd1[1], STDOUT_FILENO) != STDOUT_FILENO) ppl_fatal(__FILE__,__LINE__,"Could not redirect stdout to pipe.");
+     }
+    if (fd1[1] != STDERR_FILENO) // Redirect stderr to pipe
+     {
+      if (dup2(fd1[1], STDERR_FILENO) != STDERR_FILENO) ppl_fatal(__FILE__,__LINE__,"Could not redirect stderr to pipe.");
+      close(fd1[1]);
+     }
+    if (execv(GHOSTSCRIPT_COMMAND, argv)!=0) if (DEBUG) ppl_log("Attempt to execute ghostscript returned error code."); // Execute ghostscript
+    ppl_error(ERR_GENERAL, -1, -1, "Execution of helper process 'ghostscript' failed."); // execv call should not return
     exit(1);
    }
   return;
@@ -570,6 +705,8 @@ void ForkInputFilter(char **cmd, int *fstdout)
   int pid;
   sigset_t sigs;
 
+  RequireCSP(); // Launch the CSP before forking any helper, so that it does not inherit the helper's pipes
+
   sigemptyset(&sigs);
   sigaddset(&sigs,SIGCHLD);
 
@@ -622,6 +759,8 @@ void ForkKpseWhich(const char *ftype, int *fstdout)
   int pid;
   sigset_t sigs;
 
+  RequireCSP(); // Launch the CSP before forking any helper, so that it does not inherit the helper's pipes
+
   sigemptyset(&sigs);
   sigaddset(&sigs,SIGCHLD);
 
@@ -29,6 +29,7 @@ extern char GhostView_Fname[];
 // Functions to be called from main PyXPlot process
 
 void  InitialiseCSP            ();
+void  RequireCSP               ();
 void  CheckForGvOutput         ();
 void  SendCommandToCSP         (char *cmd);
 
@@ -48,6 +49,9 @@ void  PPLCheckForChildExits    (int signo);
 void  PPLKillAllHelpers        ();
 void  ForkSed                  (char *cmd, int *fstdin, int *fstdout);
 void  ForkLaTeX                (char *filename, int *PidOut, int *fstdin, int *fstdout);
+void  ForkLaTeXIni             (char *JobName, char *filename, int *PidOut, int *fstdin, int *fstdout);
+void  ForkLaTeXWorker          (char *FormatName, char *JobName, int *PidOut, int *fstdin, int *fstdout);
+void  ForkGhostscript          (char **argv, int *PidOut, int *fstdin, int *fstdout);
 void  ForkInputFilter          (char **cmd, int *fstdout);
 void  ForkKpseWhich            (const char *ftype, int *fstdout);
 
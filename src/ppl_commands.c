@@ -19,6 +19,9 @@
 
 // ----------------------------------------------------------------------------
 
+// This file is not compiled; commands_generate.py reads the definitions below at build time and writes them as a tree of
+// ParserNodes into ppl_parser_tables.h.
+
 // The language used in this file is generally refered to as RE++.  The atoms of the syntax are summarised below.
 //
 // =                      If a match fails after this point generate an error rather than continuing
@@ -58,7 +61,7 @@ ellipse@2:directive = { item@1 %d:editno } < from@1 %fu:x1 ,@n %fu:y1 { to@1 } %
 eps@2:directive = { item@1 %d:editno } < %q:filename | %S:filename > ( at@2 %fu:x ,@n %fu:y ~ rotate@1 %fu:rotation ~ width@1 %fu:width ~ height@1 %fu:height ~ clip@2:clip ~ calcbbox@2:calcbbox )\n\
 exec@3:directive: = %q:command\n\
 exit@2:directive:quit =\n\
-fit@3:directive = [ \\[@n { { < %fu:min | \\*@n:minauto > } < :@n | to@n > { < %fu:max | \\*@n:maxauto > } } \\]@n ]:@range_list %v:fit_function \\(@n [ %v:inputvar ]:@operands, \\)@n { withouterrors@1:withouterrors } < %q:filename | %S:filename > ( every@1 [ { %d:every_item } ]:every_list: ~ index@1 %d:index ~ select@1 %E:select_criterion ~ using@1 { < rows@1:use_rows | columns@1:use_columns > } [ { %E:using_item } ]:using_list: ) via@1 [ %v:fit_variable ]:fit_variables,\n\
+fit@3:directive = [ \\[@n { { < %fu:min | \\*@n:minauto > } < :@n | to@n > { < %fu:max | \\*@n:maxauto > } } \\]@n ]:@range_list %v:fit_function \\(@n [ %v:inputvar ]:@operands, \\)@n { withouterrors@1:withouterrors } < %q:filename | %S:filename > ( binary@3 %q:binary_format ~ every@1 [ { %d:every_item } ]:every_list: ~ index@1 %d:index ~ select@1 %E:select_criterion ~ using@1 { < rows@1:use_rows | columns@1:use_columns > } [ { %E:using_item } ]:using_list: ) via@1 [ %v:fit_variable ]:fit_variables,\n\
 < fft@2:directive | ifft@3:directive > = [ \\[@n %fu:min < :@n | to@n > %fu:max < :@n | step@n > %fu:step \\]@n ]:range_list %v:fft_function \\(@n [ %v:inputvar ]:@in_operands, \\)@n { of@1 } < %q:filename ( every@1 [ { %d:every_item } ]:every_list: ~ index@1 %d:index ~ select@1 %E:select_criterion ~ using@1 { < rows@1:use_rows | columns@1:use_columns > } [ { %E:using_item } ]:using_list: ) | %v:input_function \\(@n [ %v:inputvar ]:@out_operands, \\)@n { window@1 < rectangular@1:window | hamming@3:window | hann@3:window | cosine@1:window | lanczos@1:window | bartlett@2:window | triangular@1:window | gauss@1:window | bartletthann@9:window | blackman@2:window > } >\n\
 for@2:directive = %v:var_name \\=@n %fu:start_value to@n %fu:final_value ( step@2:step %fu:step_size ) { loopname@1 %s:loopname } { \\{@n:brace { %r:command } }\n\
 foreach@4:directive datum@5:df = [ %v:variable ]:variables, in@n:in [ \\[@n { { < %fu:min | \\*@n:minauto > } < :@n | to@n > { < %fu:max | \\*@n:maxauto > } } \\]@n ]:@range_list [ %q:filename ]:filename_list ( every@1 [ { %d:every_item } ]:every_list: ~ index@1 %d:index ~ select@1 %E:select_criterion  ~ using@1 { < rows@1:use_rows | columns@1:use_columns > } [ { < %E:using_item | %Q:using_item > } ]:using_list: ) { loopname@1 %s:loopname } { \\{@n:brace { %r:command } }\n\
@@ -76,7 +79,7 @@ move@2:directive = { item@1 } %d:moveno to@1 %fu:x ,@n %fu:y { rotate@1 %fu:rota
 ?@n:directive:help = %r:topic\n\
 !@n:directive:pling = %r:cmd\n\
 piechart@2:directive = { item@1 %d:editno } < %q:filename | [ %e:expression ]:expression_list: > ( every@1 [ { %d:every_item } ]:every_list: ~ index@1 %d:index ~ label@1 { < auto@1:piekeypos | inside@1:piekeypos | key@1:piekeypos | outside@1:piekeypos > } { %Q:label } ~ select@1 %E:select_criterion  ~ using@1 { < rows@1:use_rows | columns@1:use_columns > } [ { %E:using_item } ]:using_list: ~ with@1 ( < linetype@5 | lt@2 > < %d:linetype | %E:linetype_string > ~ < linewidth@5 | lw@2 > < %f:linewidth | %E:linewidth_string > ~ style@2 %d:style_number ~ < colour@1 | color@1 > < rgb@n %fi:colourR \\:@n %fi:colourG \\:@n %fi:colourB | hsb@n %fi:colourH \\:@n %fi:colourS \\:@n %fi:colourB | cmyk@n %fi:colourC \\:@n %fi:colourM \\:@n %fi:colourY \\:@n %fi:colourK | rgb@n %E:colourRexpr \\:@n %E:colourGexpr \\:@n %E:colourBexpr | hsb@n %E:colourHexpr \\:@n %E:colourSexpr \\:@n %E:colourBexpr | cmyk@n %E:colourCexpr \\:@n %E:colourMexpr \\:@n %E:colourYexpr \\:@n %E:colourKexpr | %E:colour > ) ~ format@1 < auto@1:auto_format | %Q:format_string > )\n\
-< plot@1:directive = { item@1 %d:editno } { \\3d@2:threedim } | replot@3:directive = { item@1 %d:editno } > [ \\[@n { { < %fu:min | \\*@n:minauto > } < :@n | to@n > { < %fu:max | \\*@n:maxauto > } } \\]@n ]:@range_list [ < %q:filename | { parametric@1:parametric { \\[@n %fu:tmin < :@n | to@n > %fu:tmax \\]@n { \\[@n %fu:vmin < :@n | to@n > %fu:vmax \\]@n } } } [ %e:expression ]:expression_list: > ( axes@1 %a:axis_1 %a:axis_2 { %a:axis_3 } ~ every@1 [ { %d:every_item } ]:every_list: ~ index@1 %d:index ~ label@1 %Q:label ~ select@1 %E:select_criterion { < continuous@1:continuous | discontinuous@1:discontinuous > } ~ < title@1 %q:title | notitle@3:notitle > ~ using@1 { < rows@1:use_rows | columns@1:use_columns > } [ { %E:using_item } ]:using_list: ~ with@1 ( < linetype@5 | lt@2 > < %d:linetype | %E:linetype_string > ~ < linewidth@5 | lw@2 > < %f:linewidth | %E:linewidth_string > ~ < pointsize@7 | ps@2 > < %f:pointsize | %E:pointsize_string > ~ < pointtype@6 | pt@2 > < %d:pointtype | %E:pointtype_string > ~ style@2 %d:style_number ~ < pointlinewidth@6 | plw@3 > < %f:pointlinewidth | %E:pointlinewidth_string > ~ < colour@1 | color@1 > < rgb@n %fi:colourR \\:@n %fi:colourG \\:@n %fi:colourB | hsb@n %fi:colourH \\:@n %fi:colourS \\:@n %fi:colourB | cmyk@n %fi:colourC \\:@n %fi:colourM \\:@n %fi:colourY \\:@n %fi:colourK | rgb@n %E:colourRexpr \\:@n %E:colourGexpr \\:@n %E:colourBexpr | hsb@n %E:colourHexpr \\:@n %E:colourSexpr \\:@n %E:colourBexpr | cmyk@n %E:colourCexpr \\:@n %E:colourMexpr \\:@n %E:colourYexpr \\:@n %E:colourKexpr | %E:colour > ~ < fillcolour@2 | fillcolor@2 | fc@2 > < rgb@n %fi:fillcolourR \\:@n %fi:fillcolourG \\:@n %fi:fillcolourB | hsb@n %fi:fillcolourH \\:@n %fi:fillcolourS \\:@n %fi:fillcolourB | cmyk@n %fi:fillcolourC \\:@n %fi:fillcolourM \\:@n %fi:fillcolourY \\:@n %fi:fillcolourK | rgb@n %E:fillcolourRexpr \\:@n %E:fillcolourGexpr \\:@n %E:fillcolourBexpr | hsb@n %E:fillcolourHexpr \\:@n %E:fillcolourSexpr \\:@n %E:fillcolourBexpr | cmyk@n %E:fillcolourCexpr \\:@n %E:fillcolourMexpr \\:@n %E:fillcolourYexpr \\:@n %E:fillcolourKexpr | %E:fillcolour > ~ < lines@1:style | points@1:style | lp@2:style:linespoints | linespoints@5:style | pl@2:style:linespoints | pointslines@5:style:linespoints | errorbars@6:style:yerrorbars | xerrorbars@1:style | yerrorbars@1:style | zerrorbars@1:style | xyerrorbars@3:style | xzerrorbars@3:style | yzerrorbars@3:style | xyzerrorbars@3:style | errorrange@6:style:yerrorrange | xerrorrange@1:style | yerrorrange@1:style | zerrorrange@1:style | xyerrorrange@3:style | xzerrorrange@3:style | yzerrorrange@3:style | xyzerrorrange@3:style | filledregion@3:style | yerrorshaded@8:style | upperlimits@1:style | lowerlimits@2:style | dots@1:style | impulses@1:style | boxes@1:style | wboxes@1:style | steps@1:style | fsteps@1:style | histeps@1:style | stars@3:style | arrows@3:style:arrows_head | arrows_head@3:style | arrows_nohead@3:style | arrows_twoway@3:style:arrows_twohead | arrows_twohead@3:style | surface@2:style | colourmap@3:style | colmap@4:style:colourmap | contourmap@3:style | contours@3:style:contourmap > ) ) ]:@plot_list,\n\
+< plot@1:directive = { item@1 %d:editno } { \\3d@2:threedim } | replot@3:directive = { item@1 %d:editno } > [ \\[@n { { < %fu:min | \\*@n:minauto > } < :@n | to@n > { < %fu:max | \\*@n:maxauto > } } \\]@n ]:@range_list [ < %q:filename | { parametric@1:parametric { \\[@n %fu:tmin < :@n | to@n > %fu:tmax \\]@n { \\[@n %fu:vmin < :@n | to@n > %fu:vmax \\]@n } } } [ %e:expression ]:expression_list: > ( axes@1 %a:axis_1 %a:axis_2 { %a:axis_3 } ~ binary@3 %q:binary_format ~ every@1 [ { %d:every_item } ]:every_list: ~ index@1 %d:index ~ label@1 %Q:label ~ select@1 %E:select_criterion { < continuous@1:continuous | discontinuous@1:discontinuous > } ~ < title@1 %q:title | notitle@3:notitle > ~ using@1 { < rows@1:use_rows | columns@1:use_columns > } [ { %E:using_item } ]:using_list: ~ with@1 ( < linetype@5 | lt@2 > < %d:linetype | %E:linetype_string > ~ < linewidth@5 | lw@2 > < %f:linewidth | %E:linewidth_string > ~ < pointsize@7 | ps@2 > < %f:pointsize | %E:pointsize_string > ~ < pointtype@6 | pt@2 > < %d:pointtype | %E:pointtype_string > ~ style@2 %d:style_number ~ < pointlinewidth@6 | plw@3 > < %f:pointlinewidth | %E:pointlinewidth_string > ~ < colour@1 | color@1 > < rgb@n %fi:colourR \\:@n %fi:colourG \\:@n %fi:colourB | hsb@n %fi:colourH \\:@n %fi:colourS \\:@n %fi:colourB | cmyk@n %fi:colourC \\:@n %fi:colourM \\:@n %fi:colourY \\:@n %fi:colourK | rgb@n %E:colourRexpr \\:@n %E:colourGexpr \\:@n %E:colourBexpr | hsb@n %E:colourHexpr \\:@n %E:colourSexpr \\:@n %E:colourBexpr | cmyk@n %E:colourCexpr \\:@n %E:colourMexpr \\:@n %E:colourYexpr \\:@n %E:colourKexpr | %E:colour > ~ < fillcolour@2 | fillcolor@2 | fc@2 > < rgb@n %fi:fillcolourR \\:@n %fi:fillcolourG \\:@n %fi:fillcolourB | hsb@n %fi:fillcolourH \\:@n %fi:fillcolourS \\:@n %fi:fillcolourB | cmyk@n %fi:fillcolourC \\:@n %fi:fillcolourM \\:@n %fi:fillcolourY \\:@n %fi:fillcolourK | rgb@n %E:fillcolourRexpr \\:@n %E:fillcolourGexpr \\:@n %E:fillcolourBexpr | hsb@n %E:fillcolourHexpr \\:@n %E:fillcolourSexpr \\:@n %E:fillcolourBexpr | cmyk@n %E:fillcolourCexpr \\:@n %E:fillcolourMexpr \\:@n %E:fillcolourYexpr \\:@n %E:fillcolourKexpr | %E:fillcolour > ~ < lines@1:style | points@1:style | lp@2:style:linespoints | linespoints@5:style | pl@2:style:linespoints | pointslines@5:style:linespoints | errorbars@6:style:yerrorbars | xerrorbars@1:style | yerrorbars@1:style | zerrorbars@1:style | xyerrorbars@3:style | xzerrorbars@3:style | yzerrorbars@3:style | xyzerrorbars@3:style | errorrange@6:style:yerrorrange | xerrorrange@1:style | yerrorrange@1:style | zerrorrange@1:style | xyerrorrange@3:style | xzerrorrange@3:style | yzerrorrange@3:style | xyzerrorrange@3:style | filledregion@3:style | yerrorshaded@8:style | upperlimits@1:style | lowerlimits@2:style | dots@1:style | impulses@1:style | boxes@1:style | wboxes@1:style | steps@1:style | fsteps@1:style | histeps@1:style | stars@3:style | arrows@3:style:arrows_head | arrows_head@3:style | arrows_nohead@3:style | arrows_twoway@3:style:arrows_twohead | arrows_twohead@3:style | surface@2:style | colourmap@3:style | colmap@4:style:colourmap | contourmap@3:style | contours@3:style:contourmap > ) ) ]:@plot_list,\n\
 point@2:directive = { item@1 %d:editno } { at@2 } %fu:x ,@n %fu:y { label@1 < %q:label | %s:label > } { with@1 ( < pointsize@7 | ps@2 > < %f:pointsize | %E:pointsize_string > ~ < pointtype@6 | pt@2 > < %d:pointtype | %E:pointtype_string > ~ style@2 %d:style_number ~ < pointlinewidth@6 | plw@3 > < %f:pointlinewidth | %E:pointlinewidth_string > ~ < colour@1 | color@1 > < rgb@n %fi:colourR \\:@n %fi:colourG \\:@n %fi:colourB | hsb@n %fi:colourH \\:@n %fi:colourS \\:@n %fi:colourB | cmyk@n %fi:colourC \\:@n %fi:colourM \\:@n %fi:colourY \\:@n %fi:colourK | rgb@n %E:colourRexpr \\:@n %E:colourGexpr \\:@n %E:colourBexpr | hsb@n %E:colourHexpr \\:@n %E:colourSexpr \\:@n %E:colourBexpr | cmyk@n %E:colourCexpr \\:@n %E:colourMexpr \\:@n %E:colourYexpr \\:@n %E:colourKexpr | %E:colour > ) }\n\
 print@2:directive = [ < %fi:expression | %q:string > ]:@print_list,\n\
 pwd@2:directive =\n\
@@ -108,6 +111,7 @@ set@2:directive { item@1 %d:editno } < colkey@4:set_option | colourkey@7:set_opt
 set@2:directive { item@1 %d:editno } < colmap@4:set_option | colourmap@7:set_option:colmap | colormap@6:set_option:colmap > = < rgb@n %E:colourR \\:@n %E:colourG \\:@n %E:colourB | hsb@n %E:colourH \\:@n %E:colourS \\:@n %E:colourB | cmyk@n %E:colourC \\:@n %E:colourM \\:@n %E:colourY \\:@n %E:colourK > { < mask@1 %E:mask | nomask@1:nomask > }\n\
 set@2:directive { item@1 %d:editno } contours@3:set_option = ( < \\(@n [ %fu:contour ]:contour_list, \\)@n | %d:contours > ~ < label@1:label | nolabel@1:nolabel > )\n\
 set@2:directive { item@1 %d:editno } c@n < \\1@n:c_number | \\2@n:c_number | \\3@n:c_number | \\4@n:c_number > range@2:set_option:crange = ( < reversed@1:reverse | noreversed@3:noreverse > ~ \\[@n { < %fu:min | \\*@n:minauto > } < :@n | to@n > { < %fu:max | \\*@n:maxauto > } \\]@n ~ < renormalise@3:renormalise | renormalize@3:renormalise | norenormalise@3:norenormalise | norenormalize@3:norenormalise > )\n\
+set@2:directive                      datacache@5:set_option = < flush@1:flush | directory@1 < %q:directory | %S:directory > | nodirectory@3:nodirectory | %f:datacache_size >\n\
 set@2:directive < { item@1 %d:editno } < data@1:dataset_type style@1:set_option | style@2:set_option data@1:dataset_type | function@1:dataset_type style@1:set_option | style@2:set_option function@1:dataset_type > | style@2:set_option:style_numbered %d:style_set_number > = ( < linetype@5 | lt@2 > %d:linetype ~ < linewidth@5 | lw@2 > %f:linewidth ~ < pointsize@7 | ps@2 > %f:pointsize ~ < pointtype@6 | pt@2 > %d:pointtype ~ style@2 %d:style_number ~ < pointlinewidth@6 | plw@3 > %f:pointlinewidth ~ < colour@1 | color@1 > < rgb@n %fi:colourR \\:@n %fi:colourG \\:@n %fi:colourB | hsb@n %fi:colourH \\:@n %fi:colourS \\:@n %fi:colourB | cmyk@n %fi:colourC \\:@n %fi:colourM \\:@n %fi:colourY \\:@n %fi:colourK | %e:colour > ~ < fillcolour@2 | fillcolor@2 | fc@2 > < rgb@n %fi:fillcolourR \\:@n %fi:fillcolourG \\:@n %fi:fillcolourB | hsb@n %fi:fillcolourH \\:@n %fi:fillcolourS \\:@n %fi:fillcolourB | cmyk@n %fi:fillcolourC \\:@n %fi:fillcolourM \\:@n %fi:fillcolourY \\:@n %fi:fillcolourK | %e:fillcolour > ~ < lines@1:style | points@1:style | lp@2:style:linespoints | linespoints@5:style | pl@2:style:linespoints | pointslines@5:style:linespoints | errorbars@6:style:yerrorbars | xerrorbars@1:style | yerrorbars@1:style | zerrorbars@1:style | xyerrorbars@3:style | xzerrorbars@3:style | yzerrorbars@3:style | xyzerrorbars@3:style | errorrange@6:style:yerrorrange | xerrorrange@1:style | yerrorrange@1:style | zerrorrange@1:style | xyerrorrange@3:style | xzerrorrange@3:style | yzerrorrange@3:style | xyzerrorrange@3:style | filledregion@3:style | yerrorshaded@8:style | upperlimits@1:style | lowerlimits@2:style | dots@1:style | impulses@1:style | boxes@1:style | wboxes@1:style | steps@1:style | fsteps@1:style | histeps@1:style | arrows@3:style:arrows_head | arrows_head@3:style | arrows_nohead@3:style | arrows_twoway@3:style:arrows_twohead | arrows_twohead@3:style | surface@2:style | colourmap@3:style | colmap@4:style:colourmap | contourmap@3:style > )\n\
 set@2:directive                      display@1:set_option =\n\
 set@3:directive                      filter@2:set_option = < %q:filename | %S:filename > < %q:filter | %S:filter >\n\
@@ -149,7 +153,7 @@ set@2:directive { item@1 %d:editno } preamble@2:set_option = < %q:preamble | %r:
 set@2:directive { item@1 %d:editno } samples@2:set_option = ( %d:samples ~ grid@2 < %d:samplesX | \\*@n:samplesXauto > { x@n } < %d:samplesY | \\*@n:samplesYauto > ~ interpolate@3 < inversesquare@1:method | monaghanlattanzio@1:method | nearestneighbour@1:method | nearestneighbor@1:method:nearestneighbour > )\n\
 set@2:directive                      seed@2:set_option = %f:seed\n\
 set@2:directive { item@1 %d:editno } size@1:set_option = < %fu:width ,@n %fu:height { ,@n %fu:zsize } | ( %fu:width ~ < ratio@1 < %f:ratio | auto@3:noratio > | noratio@1:noratio | square@1:square > ~ < zratio@1 < %f:zratio | auto@3:nozratio > | nozratio@1:nozratio > ) >\n\
-set@2:directive                      terminal@1:set_option = ( < x11_singlewindow@1:term:X11_SingleWindow | x11_multiwindow@5:term:X11_MultiWindow | x11_persist@5:term:X11_Persist | postscript@1:term:ps | ps@2:term:ps | eps@1:term:eps | pdf@2:term:pdf | png@2:term:png | gif@1:term:gif | jpg@1:term:jpg | jpeg@1:term:jpg | bmp@1:term:bmp | tiff@1:term:tif | svg@1:term:svg > ~ < colour@1:col:On | color@1:col:On | monochrome@1:col:Off | nocolour@1:col:Off | nocolor@1:col:Off > ~ < enlarge@1:enlarge:On | noenlarge@3:enlarge:Off > ~ < landscape@1:land:On | portrait@2:land:Off > ~ < notransparent@1:trans:Off | nosolid@1:trans:On | transparent@1:trans:On | solid@1:trans:Off > ~ < invert@1:invert:On | noinvert@1:invert:Off > ~ < antialias@1:antiali:On | noantialias@3:antiali:Off > ~ < dpi@3 | resolution@3 > %f:dpi )\n\
+set@2:directive                      terminal@1:set_option = ( < x11_singlewindow@1:term:X11_SingleWindow | x11_multiwindow@5:term:X11_MultiWindow | x11_persist@5:term:X11_Persist | postscript@1:term:ps | ps@2:term:ps | eps@1:term:eps | pdf@2:term:pdf | png@2:term:png | gif@1:term:gif | jpg@1:term:jpg | jpeg@1:term:jpg | bmp@1:term:bmp | tiff@1:term:tif | svg@1:term:svg > ~ < colour@1:col:On | color@1:col:On | monochrome@1:col:Off | nocolour@1:col:Off | nocolor@1:col:Off > ~ < enlarge@1:enlarge:On | noenlarge@3:enlarge:Off > ~ < landscape@1:land:On | portrait@2:land:Off > ~ < notransparent@1:trans:Off | nosolid@1:trans:On | transparent@1:trans:On | solid@1:trans:Off > ~ < invert@1:invert:On | noinvert@1:invert:Off > ~ < antialias@1:antiali:On | noantialias@3:antiali:Off > ~ < rasterise@4:raster:On | rasterize@4:raster:On | norasterise@6:raster:Off | norasterize@6:raster:Off > ~ < frames@5:frames:On | noframes@7:frames:Off > ~ < dpi@3 | resolution@3 > %f:dpi )\n\
 set@2:directive { item@1 %d:editno } < textcolour@5:set_option | textcolor@5:set_option:textcolour > = < rgb@n %fi:colourR \\:@n %fi:colourG \\:@n %fi:colourB | hsb@n %fi:colourH \\:@n %fi:colourS \\:@n %fi:colourB | cmyk@n %fi:colourC \\:@n %fi:colourM \\:@n %fi:colourY \\:@n %fi:colourK | %e:colour >\n\
 set@2:directive { item@1 %d:editno } texthalign@5:set_option = < left@1:left | centre@1:centre | center@1:centre | right@1:right >\n\
 set@2:directive { item@1 %d:editno } textvalign@5:set_option = < top@1:top | centre@1:centre | center@1:centre | bottom@1:bottom >\n\
@@ -167,7 +171,7 @@ solve@2:directive = [ %e:left_expression \\=@n %e:right_expression ]:expressions
 < spline@3:directive = | interpolate@4 = < akima@1:directive | linear@2:directive | loglinear@2:directive | polynomial@1:directive | spline@2:directive | stepwise@2:directive | 2d@2:directive:interpolate2d { < bmp_r:bmp | bmp_g:bmp | bmp_b:bmp > } > > [ \\[@n { { < %fu:min | \\*@n:minauto > } < :@n | to@n > { < %fu:max | \\*@n:maxauto > } } \\]@n ]:@range_list %v:fit_function \\()@2 < %q:filename | %S:filename > ( every@1 [ { %d:every_item } ]:every_list: ~ index@1 %d:index ~ select@1 %E:select_criterion ~ using@1 { < rows@1:use_rows | columns@1:use_columns > } [ { %E:using_item } ]:using_list: )\n\
 subroutine@2:directive = %v:subroutine_name \\(@n [ %v:argument_name ]:@argument_list, \\)@n { \\{@n:brace { %r:command } }\n\
 swap@2:directive = %d:item1 %d:item2 \n\
-tabulate@2:directive = [ \\[@n { { < %fu:min | \\*@n:minauto > } < :@n | to@n > { < %fu:max | \\*@n:maxauto > } } \\]@n ]:@range_list [ < %q:filename | { parametric@1:parametric { \\[@n %fu:tmin < :@n | to@n > %fu:tmax \\]@n { \\[@n %fu:vmin < :@n | to@n > %fu:vmax \\]@n } } } [ %e:expression ]:expression_list: > ( every@1 [ { %d:every_item } ]:every_list: ~ index@1 %d:index ~ select@1 %E:select_criterion ~ sortby %E:sort_expression ~ using@1 { < rows@1:use_rows | columns@1:use_columns > } [ { %E:using_item } ]:using_list: ) { with@1 ( format@1 %q:format ~ spacing@1 %fu:spacing ) } ]:@tabulate_list,\n\
+tabulate@2:directive = [ \\[@n { { < %fu:min | \\*@n:minauto > } < :@n | to@n > { < %fu:max | \\*@n:maxauto > } } \\]@n ]:@range_list [ < %q:filename | { parametric@1:parametric { \\[@n %fu:tmin < :@n | to@n > %fu:tmax \\]@n { \\[@n %fu:vmin < :@n | to@n > %fu:vmax \\]@n } } } [ %e:expression ]:expression_list: > ( binary@3 %q:binary_format ~ every@1 [ { %d:every_item } ]:every_list: ~ index@1 %d:index ~ select@1 %E:select_criterion ~ sortby %E:sort_expression ~ using@1 { < rows@1:use_rows | columns@1:use_columns > } [ { %E:using_item } ]:using_list: ) { with@1 ( format@1 %q:format ~ spacing@1 %fu:spacing ) } ]:@tabulate_list,\n\
 text@3:directive = { item@1 %d:editno } < %q:string | %s:string > ( at@1 %fu:x ,@n %fu:y ~ rotate@1 %fu:rotation ~ gap@1 %fu:gap ~ halign@2 < left@1:halign | centre@1:halign | center@1:halign:centre | right@1:halign > ~ valign@2 < top@1:valign | centre@1:valign | center@1:valign:centre | bottom@1:valign > ~ with@1 < colour@1 | color@1 > < rgb@n %fi:colourR \\:@n %fi:colourG \\:@n %fi:colourB | hsb@n %fi:colourH \\:@n %fi:colourS \\:@n %fi:colourB | cmyk@n %fi:colourC \\:@n %fi:colourM \\:@n %fi:colourY \\:@n %fi:colourK | %e:colour > )\n\
 undelete@3:directive = { item@1 } [ %d:number ]:undeleteno,\n\
 unset@3:directive { item@1 %d:editno } { no@n } %a:axis format@1:set_option:xformat =\n\
@@ -193,6 +197,7 @@ unset@3:directive { item@1 %d:editno } < colkey@4:set_option | colourkey@7:set_o
 unset@3:directive { item@1 %d:editno } < colmap@4:set_option | colourmap@7:set_option:colmap | colormap@6:set_option:colmap > =\n\
 unset@3:directive { item@1 %d:editno } contours@3:set_option =\n\
 unset@3:directive { item@1 %d:editno } c@n < \\1@n:c_number | \\2@n:c_number | \\3@n:c_number | \\4@n:c_number > range@2:set_option:crange =\n\
+unset@3:directive                      datacache@5:set_option =\n\
 unset@3:directive                      display@1:set_option =\n\
 unset@3:directive                      filter@2:set_option = < %q:filename | %S:filename >\n\
 unset@3:directive { item@1 %d:editno } < fountsize@2:set_option:fontsize | fontsize@2:set_option > =\n\
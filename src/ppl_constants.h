@@ -42,5 +42,7 @@
 
 #define OPLIST_LEN 15
 
+#define MAX_THREADS 64 // The maximum number of worker threads which calculations are split between
+
 #endif
 
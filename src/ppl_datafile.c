@@ -24,9 +24,18 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <stdint.h>
 #include <math.h>
 #include <signal.h>
+#include <time.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#ifdef HAVE_FITSIO
+#include <fitsio.h>
+#endif
 
 #include "StringTools/asciidouble.h"
 #include "StringTools/str_constants.h"
@@ -40,9 +49,11 @@
 #include "ppl_error.h"
 #include "ppl_input.h"
 #include "ppl_settings.h"
+#include "ppl_threads.h"
 #include "ppl_units.h"
 #include "ppl_units_fns.h"
 #include "ppl_userspace.h"
+#include "ppl_userspace_compile.h"
 
 // -------------------------------------------------------------------------
 // Routine which creates a backup of a datafile if 'set backup' is turned on
@@ -119,6 +130,114 @@ FILE *DataFile_LaunchCoProcess(char *filename, int *status, char *errout)
   return infile;
  }
 
+// ------------------------------------------------------------------------------------------------------
+// Buffered line reader, which reads datafiles in large chunks and returns lines in place within the buffer.
+// Regular files are memory-mapped instead, and each line is copied out of the map as it is returned. Since
+// truncating a mapped file kills the process with SIGBUS, files modified within the last DATAFILE_MAP_SETTLE
+// seconds, which may still be being written, are not mapped. A file truncated whilst it is being read is
+// still fatal, where stdio would have seen the end of the file early.
+// ------------------------------------------------------------------------------------------------------
+
+typedef struct DataFileReader {
+  FILE         *file;
+  char         *buffer;
+  long int      start, end; // The unread data in the buffer (or map) runs from start to end-1
+  const char   *map; // Contents of the file, if it has been memory-mapped
+  long int      LineStart; // Offset within the map of the line most recently returned
+  unsigned char eof, done, skipping;
+ } DataFileReader;
+
+// Memory-map the file being read, if it is a regular file. Touches no global state, and so may be called from worker threads.
+static void DataFile_ReaderMap(DataFileReader *r, FILE *file)
+ {
+  struct stat st;
+  void       *map;
+
+  r->file     = file;
+  r->map      = NULL;
+  r->start    = r->end = r->LineStart = 0;
+  r->eof      = r->done = r->skipping = 0;
+
+  if ((file!=stdin) && (fstat(fileno(file), &st)==0) && S_ISREG(st.st_mode) && (st.st_size>0) && (time(NULL) - st.st_mtime >= DATAFILE_MAP_SETTLE))
+   {
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fileno(file), 0);
+    if (map != MAP_FAILED)
+     {
+      madvise(map, st.st_size, MADV_SEQUENTIAL);
+      r->map = (const char *)map;
+      r->end = st.st_size;
+     }
+   }
+  return;
+ }
+
+static int DataFile_ReaderInit(DataFileReader *r, FILE *file, int context)
+ {
+  DataFile_ReaderMap(r, file);
+  r->buffer = (char *)lt_malloc_incontext((r->map!=NULL) ? LSTR_LENGTH : (DATAFILE_READ_BYTES+1), context);
+  return (r->buffer==NULL);
+ }
+
+static void DataFile_ReaderClose(DataFileReader *r)
+ {
+  if (r->map != NULL) munmap((void *)r->map, r->end);
+  r->map = NULL;
+  return;
+ }
+
+// Returns the next line of the file, stripped of control characters and of whitespace at either end, or NULL at the end of the file.
+// As with file_readline(), lines are truncated at LSTR_LENGTH-2 characters, and a final newline is followed by an empty line.
+static char *DataFile_ReadLine(DataFileReader *r)
+ {
+  char *line, *newline, *in, *out, *limit;
+  size_t n;
+
+  if (r->map != NULL)
+   {
+    if (r->done) return NULL;
+    in       = (char *)r->map + r->start;
+    newline  = (char *)memchr(in, '\n', r->end-r->start);
+    limit    = (newline!=NULL) ? newline : ((char *)r->map + r->end);
+    r->LineStart = r->start;
+    if (newline != NULL)  r->start = newline + 1 - r->map;
+    else                { r->start = r->end; r->done=1; }
+    line = r->buffer;
+    for (out=line; (in<limit) && (out-line<LSTR_LENGTH-2); in++) if ((*in>31)||(*in==9)) *(out++)=*in; // ASCII 9 is a tab
+    goto STRIP;
+   }
+
+  while (1)
+   {
+    if (r->done) return NULL;
+    while (1)
+     {
+      newline = (char *)memchr(r->buffer+r->start, '\n', r->end-r->start);
+      if ((newline!=NULL) || r->eof) break;
+      if (r->start>0) { memmove(r->buffer, r->buffer+r->start, r->end-r->start); r->end-=r->start; r->start=0; }
+      if (r->end == DATAFILE_READ_BYTES) break; // Buffer is full; return what we have as an overlong line
+      n = fread(r->buffer+r->end, 1, DATAFILE_READ_BYTES-r->end, r->file);
+      r->end += n;
+      if ((n==0) && (feof(r->file) || ferror(r->file))) r->eof=1;
+     }
+
+    line  = r->buffer + r->start;
+    limit = (newline!=NULL) ? newline : (r->buffer + r->end);
+    if (newline != NULL)  r->start = newline + 1 - r->buffer;
+    else                { r->start = r->end; if (r->eof) r->done=1; }
+
+    if (!r->skipping) break;
+    r->skipping = (newline==NULL); // Discard the remainder of an overlong line
+   }
+  if ((newline==NULL) && !r->done) r->skipping=1;
+
+  for (in=out=line; (in<limit) && (out-line<LSTR_LENGTH-2); in++) if ((*in>31)||(*in==9)) *(out++)=*in; // ASCII 9 is a tab
+STRIP:
+  while ((out>line) && (out[-1]>='\0') && (out[-1]<=' ')) out--; // Strip whitespace from end
+  *out = '\0';
+  while ((*line<=' ') && (*line>'\0')) line++; // ... and from start
+  return line;
+ }
+
 // -------------------------------------------------------------------------------------------------
 // The following routines are a part of the BODMAS machine, and evaluate "$3" in the current context
 // -------------------------------------------------------------------------------------------------
@@ -223,7 +342,7 @@ void __inline__ DataFile_UsingConvert_FetchColumnByNumber(double ColumnNo, value
     ColumnNo = GetFloat(UCFC_columns_str[i-1],&j);
     if (UCFC_file_linenumbers == NULL) k = UCFC_file_linenumber;
     else                               k = UCFC_file_linenumbers[i-1];
-    if (((UCFC_columns_str[i-1][j]>' ')&&(UCFC_columns_str[i-1][j]!=','))||(j<=0)) { sprintf(errtext, "%s:%ld: In the expression <%s>, the requested %s number %d does not contain numeric data.", UCFC_filename, k, UCFC_UsingExpression, UCFC_RowColWord, i); *status=1; return; } // j==0 for blank columns in CSV, and data off the end of rows
+    if ((j<=0)||((UCFC_columns_str[i-1][j]>' ')&&(UCFC_columns_str[i-1][j]!=','))) { sprintf(errtext, "%s:%ld: In the expression <%s>, the requested %s number %d does not contain numeric data.", UCFC_filename, k, UCFC_UsingExpression, UCFC_RowColWord, i); *status=1; return; } // j==0 for blank columns in CSV, and data off the end of rows
    }
   output->real = ColumnNo;
   if ((i>0)&&(i<UCFC_NColumnUnits)) ppl_units_mult(output,UCFC_ColumnUnits+i-1,output,status,errtext);
@@ -559,6 +678,212 @@ void DataFile_ApplyUsingList(DataTable *out, int ContextOutput, char **ColumnDat
   return;
  }
 
+// ----------------------------------------------------------------------------------------------------------------------------------------
+// DataFile_ApplyColumnList(): Fast alternative to DataFile_ApplyUsingList() for using lists which simply list column numbers, e.g. using 1:2
+// Returns 0 if the line was dealt with, or 1 if it needs to be passed to DataFile_ApplyUsingList(), for example to produce an error message
+// ----------------------------------------------------------------------------------------------------------------------------------------
+
+// Convert the columns listed in UsingColumns into doubles. Touches no global state, and so may be called from worker threads.
+static int DataFile_ParseColumnList(char **ColumnData_str, int ItemsOnLine, int *UsingColumns, int Ncolumns, double *data)
+ {
+  int i, j, c;
+
+  for (i=0; i<Ncolumns; i++)
+   {
+    c = UsingColumns[i];
+    if (c > ItemsOnLine) return 1; // Requested column does not exist on this line
+    data[i] = GetFloat(ColumnData_str[c-1], &j);
+    if ((j<=0)||((ColumnData_str[c-1][j]>' ')&&(ColumnData_str[c-1][j]!=','))) return 1; // Column does not contain numeric data
+    if (!gsl_finite(data[i])) return 1;
+   }
+  return 0;
+ }
+
+// Add a row of dimensionless data to a DataTable
+static int DataFile_AddColumnRow(DataTable *out, double *data, int Ncolumns, long int file_linenumber, unsigned char *discontinuity, int *status, char *errout)
+ {
+  int i;
+
+  if (out->Nrows>0) for (i=0; i<Ncolumns; i++) if (!out->FirstEntries[i].dimensionless) return 1; // Previous data had units
+
+  out->current->text[out->current->BlockPosition] = NULL;
+  for (i=0; i<Ncolumns; i++)
+   {
+    out->current->FileLine [i + out->current->BlockPosition * Ncolumns] = file_linenumber;
+    out->current->data_real[i + out->current->BlockPosition * Ncolumns].d = data[i];
+    if (out->Nrows==0) { ppl_units_zero(out->FirstEntries+i); out->FirstEntries[i].real = data[i]; }
+   }
+  out->current->split[out->current->BlockPosition] = *discontinuity;
+  if (DataFile_DataTable_AddRow(out)) { strcpy(errout, "Out of memory whilst reading data file."); *status=1; if (DEBUG) ppl_log(errout); return 0; }
+  *discontinuity=0;
+  return 0;
+ }
+
+static int DataFile_ApplyColumnList(DataTable *out, char **ColumnData_str, int ItemsOnLine, int *UsingColumns, int Ncolumns, long int file_linenumber, unsigned char *discontinuity, int *status, char *errout)
+ {
+  double data[USING_ITEMS_MAX];
+  if (DataFile_ParseColumnList(ColumnData_str, ItemsOnLine, UsingColumns, Ncolumns, data)) return 1;
+  return DataFile_AddColumnRow(out, data, Ncolumns, file_linenumber, discontinuity, status, errout);
+ }
+
+// As above, but taking the columns from values which have already been evaluated, for example by DataFile_FromFunctions()
+static int DataFile_ApplyValueList(DataTable *out, value *ColumnData_val, int ItemsOnLine, int *UsingColumns, int Ncolumns, long int file_linenumber, unsigned char *discontinuity, int *status, char *errout)
+ {
+  double data[USING_ITEMS_MAX];
+  value *v;
+  int    i;
+
+  for (i=0; i<Ncolumns; i++)
+   {
+    if (UsingColumns[i] > ItemsOnLine) return 1;
+    v = ColumnData_val + UsingColumns[i];
+    if ((!v->dimensionless) || (v->FlagComplex) || (v->string!=NULL) || (!gsl_finite(v->real))) return 1;
+    data[i] = v->real;
+   }
+  return DataFile_AddColumnRow(out, data, Ncolumns, file_linenumber, discontinuity, status, errout);
+ }
+
+// ------------------------------------------------------------------------------------------------------------------------------------------
+// Parallel pre-parsing of memory-mapped datafiles. The main loop in DataFile_read() still walks through the file one line at a time, keeping
+// track of blocks, indices, every modifiers and so forth, but the numerical conversion of data lines is done ahead of it, by worker threads,
+// in windows of the file. Each thread parses a run of whole lines into its own arrays, which the main loop then reads through in order.
+// ------------------------------------------------------------------------------------------------------------------------------------------
+
+typedef struct DataFileParsedRows {
+  long int       start, end; // The range of bytes in the map which this thread parses
+  long int       N, Nalloc;
+  long int      *offset; // For each row, the offset of the start of its line within the map
+  int           *items; // The number of items on each line
+  double        *data; // Ncolumns values for each row
+ } DataFileParsedRows;
+
+typedef struct DataFileParallel {
+  const char        *map;
+  long int           MapLength;
+  long int           WindowEnd; // The end of the portion of the file which has been parsed so far
+  int                NThreads, Ncolumns, *UsingColumns;
+  int                CurrentThread; // Position of the next row to be read by DataFile_ParallelRow()
+  long int           CurrentRow;
+  DataFileParsedRows rows[MAX_THREADS];
+ } DataFileParallel;
+
+// Worker run by each thread. Lines which contain characters that file_readline() would strip out, or which are overlong, are skipped, and
+// are later converted in the usual way by the main loop, along with any lines which do not contain the requested columns.
+static void DataFile_ParseWorker(void *p_void, int ThreadNo, int NThreads)
+ {
+  DataFileParallel   *p = (DataFileParallel *)p_void;
+  DataFileParsedRows *r = p->rows + ThreadNo;
+  const char         *map = p->map;
+  char               *ColumnData[MAX_DATACOLS], *line, *limit, *scan, *newline;
+  unsigned char       hadwhitespace, hadcomma, clean;
+  int                 ItemsOnLine;
+  long int            pos, NewAlloc;
+  void               *tmp;
+
+  r->N = 0;
+  for (pos=r->start; pos<r->end; pos=newline+1-map)
+   {
+    line    = (char *)map + pos;
+    newline = (char *)memchr(line, '\n', r->end-pos);
+    if (newline==NULL) break; // Final line of file is not terminated; leave it to the main loop
+    limit   = newline;
+    if ((limit>line) && (limit[-1]=='\r')) limit--; // DOS line endings
+
+    // Skip blank lines and comment lines
+    for (scan=line; (scan<limit) && (*scan<=' '); scan++);
+    if ((scan==limit) || (*scan=='#')) continue;
+    if (limit-line > LSTR_LENGTH-2) continue;
+
+    // Tokenise line in the same way as DataFile_read()
+    ItemsOnLine = 0; hadwhitespace = 1; hadcomma = 0; clean = 1;
+    for (scan=line; scan<limit; scan++)
+     {
+      if      ((*scan<' ')&&(*scan!='\t')) { clean=0; break; }
+      else if (*scan<=' ') { hadwhitespace = 1; }
+      else if (*scan==',') { char *j; for (j=scan+1;((j<limit)&&(*j<=' '));j++); ColumnData[ItemsOnLine++]=j; hadwhitespace = hadcomma = 1; }
+      else                 { if (hadwhitespace && !hadcomma) { ColumnData[ItemsOnLine++]=scan; } hadwhitespace = hadcomma = 0; }
+      if (ItemsOnLine==MAX_DATACOLS) break;
+     }
+    if (!clean) continue;
+
+    if (r->N >= r->Nalloc)
+     {
+      NewAlloc = (r->Nalloc>0) ? (2*r->Nalloc) : 1024;
+      if ((tmp = realloc(r->offset, NewAlloc*sizeof(long int)               ))==NULL) break;
+      r->offset = (long int *)tmp;
+      if ((tmp = realloc(r->items , NewAlloc*sizeof(int)                    ))==NULL) break;
+      r->items  = (int      *)tmp;
+      if ((tmp = realloc(r->data  , NewAlloc*p->Ncolumns*sizeof(double)     ))==NULL) break;
+      r->data   = (double   *)tmp;
+      r->Nalloc = NewAlloc;
+     }
+    if (DataFile_ParseColumnList(ColumnData, ItemsOnLine, p->UsingColumns, p->Ncolumns, r->data + r->N*p->Ncolumns)) continue;
+    r->offset[r->N] = pos;
+    r->items [r->N] = ItemsOnLine;
+    r->N++;
+   }
+  return;
+ }
+
+// Returns the offset of the start of the line following the one containing position pos
+static long int DataFile_NextLineStart(const char *map, long int MapLength, long int pos)
+ {
+  const char *newline;
+  if (pos >= MapLength) return MapLength;
+  newline = (const char *)memchr(map+pos, '\n', MapLength-pos);
+  return (newline==NULL) ? MapLength : (newline+1-map);
+ }
+
+// Parse the window of the file which starts at position start
+static void DataFile_ParseWindow(DataFileParallel *p, long int start)
+ {
+  int      i;
+  long int end = start + p->NThreads * (long int)DATAFILE_PARSE_BYTES;
+
+  p->WindowEnd = (end>=p->MapLength) ? p->MapLength : DataFile_NextLineStart(p->map, p->MapLength, end);
+  for (i=0; i<p->NThreads; i++)
+   {
+    p->rows[i].start = (i==0) ? start : p->rows[i-1].end;
+    p->rows[i].end   = (i==p->NThreads-1) ? p->WindowEnd : DataFile_NextLineStart(p->map, p->WindowEnd, start + (p->WindowEnd-start)*(i+1)/p->NThreads);
+    if (p->rows[i].end < p->rows[i].start) p->rows[i].end = p->rows[i].start;
+   }
+  ppl_threads_run(&DataFile_ParseWorker, (void *)p, p->NThreads);
+  p->CurrentThread = 0;
+  p->CurrentRow    = 0;
+  return;
+ }
+
+// Returns the values parsed from the line starting at position LineStart, or NULL if this line is to be parsed by the main loop.
+// Successive calls must be made with increasing values of LineStart.
+static double *DataFile_ParallelRow(DataFileParallel *p, long int LineStart, int *ItemsOnLine)
+ {
+  DataFileParsedRows *r;
+
+  if (LineStart >= p->WindowEnd)
+   {
+    if (p->WindowEnd >= p->MapLength) return NULL;
+    DataFile_ParseWindow(p, LineStart); // Lines which were skipped over by the main loop do not need to be parsed
+   }
+  while (p->CurrentThread < p->NThreads)
+   {
+    r = p->rows + p->CurrentThread;
+    if (p->CurrentRow >= r->N) { p->CurrentThread++; p->CurrentRow=0; continue; }
+    if (r->offset[p->CurrentRow] <  LineStart) { p->CurrentRow++; continue; }
+    if (r->offset[p->CurrentRow] >  LineStart) return NULL;
+    *ItemsOnLine = r->items[p->CurrentRow];
+    return r->data + (p->CurrentRow++)*p->Ncolumns;
+   }
+  return NULL;
+ }
+
+static void DataFile_ParallelFree(DataFileParallel *p)
+ {
+  int i;
+  for (i=0; i<p->NThreads; i++) { free(p->rows[i].offset); free(p->rows[i].items); free(p->rows[i].data); }
+  p->NThreads = 0;
+  return;
+ }
+
 // -----------------------------------------------------------------------------------------------
 // DataFile_RotateRawData(): Routine used to rotate raw data by 90 degrees when plotting with rows
 // -----------------------------------------------------------------------------------------------
@@ -634,196 +959,719 @@ void DataFile_RotateRawData(RawDataTable **in, DataTable *out, char **UsingItems
   return;
  }
 
-// ----------------------------------------------------------------------------------
-// DataFile_read is the main entry point for reading a table of data from a data file
-// ----------------------------------------------------------------------------------
-
-void DataFile_read(DataTable **output, int *status, char *errout, char *filename, int index, int UsingRowCol, List *UsingList, unsigned char AutoUsingList, List *EveryList, char *LabelStr, int Ncolumns, char *SelectCriterion, int continuity, char *SortBy, int SortByContinuity, unsigned char persistent, int *ErrCounter)
- {
-  unsigned char HadNonNullUsingItem=0, ReadFromCommandLine=0, discontinuity=0, hadwhitespace, hadcomma, OneColumnInput=1;
-  int           UsingLen, logi, logj, ContextOutput, ContextRough, ContextRaw;
-  char         *UsingItems[USING_ITEMS_MAX], LineNumberStr[32];
-  ListIterator *listiter;
-  Dict         *tempdict;
-  int           linestep=1, blockstep=1, linefirst=-1, blockfirst=-1, linelast=-1, blocklast=-1;
-  long int      index_number, linenumber_count, linenumber_stepcnt, block_count, block_stepcnt, prev_blanklines, file_linenumber, ItemsOnLine;
-  FILE         *filtered_input=NULL;
-  char          linebuffer[LSTR_LENGTH], *lineptr, *cptr;
-
-  int i, j, k, l, m, *intptr;
-
-  char        **ColumnHeadings  = NULL;
-  int           NColumnHeadings = 0;
-  char        **RowHeadings     = NULL;
-  int           NRowHeadings    = 0;
-  value        *ColumnUnits     = NULL;
-  int           NColumnUnits    = 0;
-  value        *RowUnits        = NULL;
-  int           NRowUnits       = 0;
+// ------------------------------------------------------------------------------------------------------------------------------------------
+// Binary datafiles, read with the "binary" modifier. The file is a sequence of fixed-length records, whose layout is described by a format
+// string in the style of Python's struct module, e.g. '<2dI'. Each record is treated as one line of data, and each numeric field in it as
+// one column. Padding bytes, marked x, do not produce columns. Binary files have no blocks, indices, headings or units.
+// ------------------------------------------------------------------------------------------------------------------------------------------
 
-  char         *ColumnData[MAX_DATACOLS];
-  RawDataTable *RawDataTab = NULL;
+typedef struct DataFileBinaryField {
+  char type;   // Struct-module type code
+  int  size;   // Size in bytes
+  int  offset; // Offset from the start of the record
+ } DataFileBinaryField;
 
-  // Init
-  if (DEBUG) { sprintf(temp_err_string, "Opening datafile '%s'.", filename); ppl_log(temp_err_string); }
-  lineptr = linebuffer;
-  if (Ncolumns != 2) OneColumnInput=0; // Only have special handling for one-column datafiles when looking for two columns
+// Parse a binary format string. Returns zero on success, or one, with an error message in errout.
+static int DataFile_BinaryFormat(char *format, DataFileBinaryField *fields, int *Nfields, int *RecordLength, unsigned char *swap, char *errout)
+ {
+  union { int i; unsigned char c[sizeof(int)]; } endian;
+  unsigned char LittleEndian, WantLittle;
+  char *cptr = format;
+  long int count;
+  int size;
+
+  endian.i = 1;
+  LittleEndian = WantLittle = (endian.c[0]==1);
+  *Nfields = *RecordLength = 0;
+
+  while ((*cptr!='\0')&&(*cptr<=' ')) cptr++;
+  if      (*cptr=='<')                    { WantLittle=1; cptr++; }
+  else if ((*cptr=='>')||(*cptr=='!'))    { WantLittle=0; cptr++; }
+  else if ((*cptr=='=')||(*cptr=='@'))    {               cptr++; }
+  *swap = (WantLittle != LittleEndian);
 
-  // Read items out of Using List into an array of strings
-  UsingLen=0; listiter = ListIterateInit(UsingList);
-  while (listiter != NULL)
+  while (1)
    {
-    if (UsingLen>=USING_ITEMS_MAX) { strcpy(errout,"Too many items in using list."); *status=1; if (DEBUG) ppl_log(errout); return; }
-    tempdict = (Dict *)listiter->data;
-    DictLookup(tempdict,"using_item",NULL,(void *)&(UsingItems[UsingLen]));
-    if ((UsingItems[UsingLen]==NULL)||(strlen(StrStrip(UsingItems[UsingLen], UsingItems[UsingLen]))==0)) // Using item is blank; replace with item number
+    while ((*cptr!='\0')&&(*cptr<=' ')) cptr++;
+    if (*cptr=='\0') break;
+    if ((*cptr>='0')&&(*cptr<='9')) { for (count=0; (*cptr>='0')&&(*cptr<='9')&&(count<=MAX_DATACOLS); cptr++) count = 10*count + (*cptr-'0'); }
+    else                            { count = 1; }
+    switch (*cptr)
      {
-      if ((UsingItems[UsingLen] = (char *)lt_malloc(10))==NULL) { sprintf(errout,"Out of memory."); *status=1; if (DEBUG) ppl_log(errout); return; };
-      sprintf(UsingItems[UsingLen], "%d", UsingLen+1);
-     } else {
-      HadNonNullUsingItem=1;
+      case 'x': case 'b': case 'B':                     size=1; break;
+      case 'h': case 'H':                               size=2; break;
+      case 'i': case 'I': case 'l': case 'L': case 'f': size=4; break;
+      case 'q': case 'Q': case 'd':                     size=8; break;
+      case '\0': sprintf(errout, "Binary format string '%s' ends with a repeat count, but no type code.", format); return 1;
+      default  : sprintf(errout, "Unrecognised type code '%c' in binary format string '%s'. Recognised codes are x, b, B, h, H, i, I, l, L, q, Q, f and d.", *cptr, format); return 1;
      }
-    UsingLen++;
-    listiter = ListIterate(listiter, NULL);
-   }
-
-  // If have only one using item, and it is NULL, pretend we have an empty list
-  if ((UsingLen==1) && (!HadNonNullUsingItem)) UsingLen=0;
-
-  // If using list was empty, generate an automatic list
-  if (UsingLen==0)
-   {
-    for (i=0; i<Ncolumns; i++)
+    if ((*cptr!='x') && (*Nfields+count > MAX_DATACOLS)) { sprintf(errout, "Binary format string '%s' describes more than the maximum of %d columns.", format, MAX_DATACOLS); return 1; }
+    if (*RecordLength + count*size > DATAFILE_READ_BYTES) { sprintf(errout, "Binary format string '%s' describes records longer than the maximum of %d bytes.", format, DATAFILE_READ_BYTES); return 1; }
+    for ( ; count>0; count--)
      {
-      if ((UsingItems[i] = (char *)lt_malloc(10))==NULL) { sprintf(errout,"Out of memory."); *status=1; if (DEBUG) ppl_log(errout); return; };
-      sprintf(UsingItems[i], "%d", i+1);
+      if (*cptr!='x')
+       {
+        fields[*Nfields].type   = *cptr;
+        fields[*Nfields].size   = size;
+        fields[*Nfields].offset = *RecordLength;
+        (*Nfields)++;
+       }
+      *RecordLength += size;
      }
-    UsingLen = Ncolumns;
-    AutoUsingList = 1; // We have automatically generated this using list
+    cptr++;
    }
-  else if ((UsingLen==1) && (Ncolumns==2)) // Prepend data point number if only one number specified in using statement
+  if (*Nfields==0) { sprintf(errout, "Binary format string '%s' does not describe any columns of data.", format); return 1; }
+  return 0;
+ }
+
+// Fetch the value of one field of a binary record
+static double DataFile_BinaryValue(const unsigned char *record, const DataFileBinaryField *f, const unsigned char swap)
+ {
+  unsigned char b[8];
+  int i;
+
+  if (swap) for (i=0; i<f->size; i++) b[i] = record[f->offset + f->size-1-i];
+  else      memcpy(b, record + f->offset, f->size);
+
+  switch (f->type)
    {
-    UsingItems[1] = UsingItems[0];
-    UsingItems[0] = "0";
-    UsingLen++;
+    case 'b':           { int8_t   v; memcpy(&v, b, 1); return v; }
+    case 'B':           { uint8_t  v; memcpy(&v, b, 1); return v; }
+    case 'h':           { int16_t  v; memcpy(&v, b, 2); return v; }
+    case 'H':           { uint16_t v; memcpy(&v, b, 2); return v; }
+    case 'i': case 'l': { int32_t  v; memcpy(&v, b, 4); return v; }
+    case 'I': case 'L': { uint32_t v; memcpy(&v, b, 4); return v; }
+    case 'q':           { int64_t  v; memcpy(&v, b, 8); return (double)v; }
+    case 'Q':           { uint64_t v; memcpy(&v, b, 8); return (double)v; }
+    case 'f':           { float    v; memcpy(&v, b, 4); return v; }
+    default :           { double   v; memcpy(&v, b, 8); return v; }
    }
+ }
 
-  // Output using list to log file if required
-  if (DEBUG)
+// Read the records of a binary datafile into a DataTable. Plain lists of column numbers are copied straight into the table; other using
+// lists, and select criteria, are evaluated by DataFile_ApplyUsingList(), with column zero holding the record number.
+static void DataFile_ReadBinary(DataTable *out, int ContextOutput, int ContextRough, FILE *in, char *format, char *filename, int index, char **UsingItems, int UsingLen, int *UsingColumns, unsigned char ColumnListOnly, char *LabelStr, char *SelectCriterion, int continuity, int linestep, int linefirst, int linelast, int *ErrCounter, int *status, char *errout)
+ {
+  DataFileBinaryField *fields;
+  int                  Nfields, RecordLength, i;
+  unsigned char        swap, discontinuity=0;
+  unsigned char       *buffer, *record;
+  long int             BufferBytes, have, got, Nrecords, r, record_count=0, stepcnt=0;
+  value               *ColumnData_val;
+  double               data[USING_ITEMS_MAX];
+
+  fields = (DataFileBinaryField *)lt_malloc_incontext(MAX_DATACOLS*sizeof(DataFileBinaryField), ContextRough);
+  if (fields == NULL) { strcpy(errout, "Out of memory."); *status=1; if (DEBUG) ppl_log(errout); return; }
+  if (DataFile_BinaryFormat(format, fields, &Nfields, &RecordLength, &swap, errout)) { *status=1; if (DEBUG) ppl_log(errout); return; }
+  if (DEBUG) { sprintf(temp_err_string, "Reading binary records of %d bytes, containing %d columns.", RecordLength, Nfields); ppl_log(temp_err_string); }
+  if (index > 0) return; // Binary datafiles contain only a single index
+
+  for (i=0; (i<UsingLen) && ColumnListOnly; i++) if (UsingColumns[i] > Nfields) ColumnListOnly=0;
+
+  BufferBytes    = (DATAFILE_READ_BYTES / RecordLength) * RecordLength;
+  buffer         = (unsigned char *)lt_malloc_incontext(BufferBytes, ContextRough);
+  ColumnData_val = (value *)lt_malloc_incontext((Nfields+1)*sizeof(value), ContextRough);
+  if ((buffer==NULL)||(ColumnData_val==NULL)) { strcpy(errout, "Out of memory whilst trying to allocate buffer to read data from file."); *status=1; if (DEBUG) ppl_log(errout); return; }
+  for (i=0; i<=Nfields; i++) ppl_units_zero(ColumnData_val+i);
+
+  have = 0;
+  while ((got = fread(buffer+have, 1, BufferBytes-have, in)) > 0)
    {
-    logi=0; sprintf(temp_err_string+logi, "Using "); logi+=strlen(temp_err_string+logi);
-    for (logj=0; logj<UsingLen; logj++)
+    have    += got;
+    Nrecords = have / RecordLength;
+    for (r=0; r<Nrecords; r++, record_count++)
      {
-      if (logj!=0) temp_err_string[logi++]=':';
-      strcpy(temp_err_string+logi, UsingItems[logj]);
-      logi+=strlen(temp_err_string+logi);
+      if ((stepcnt==0) && ((linefirst<0)||(record_count>=linefirst)) && ((linelast<0)||(record_count<=linelast)))
+       {
+        record = buffer + r*RecordLength;
+        if (ColumnListOnly)
+         {
+          for (i=0; i<UsingLen; i++) { data[i] = DataFile_BinaryValue(record, fields+UsingColumns[i]-1, swap); if (!gsl_finite(data[i])) break; }
+          if ((i==UsingLen) && !DataFile_AddColumnRow(out, data, UsingLen, record_count+1, &discontinuity, status, errout)) goto RECORD_DONE;
+         }
+        ColumnData_val[0].real = record_count;
+        for (i=0; i<Nfields; i++) ColumnData_val[i+1].real = DataFile_BinaryValue(record, fields+i, swap);
+        DataFile_ApplyUsingList(out, ContextOutput, NULL, ColumnData_val, Nfields, UsingItems, UsingLen, filename, record_count+1, NULL, record_count, 0, 0, DATAFILE_COL, "column", NULL, 0, NULL, 0, LabelStr, SelectCriterion, continuity, &discontinuity, ErrCounter, status, errout);
+RECORD_DONE:
+        if (*status) return;
+       }
+      stepcnt = ((stepcnt-1) % linestep);
      }
-    ppl_log(temp_err_string);
+    have -= Nrecords*RecordLength;
+    if (have > 0) memmove(buffer, buffer+Nrecords*RecordLength, have);
    }
 
-  // If our using list has the wrong number of elements for the plot style we're aiming to use, then reject it
-  if (UsingLen != Ncolumns) { sprintf(errout,"The supplied using ... clause contains the wrong number of items. We need %d columns of data, but %d have been supplied.", Ncolumns, UsingLen); *status=1; if (DEBUG) ppl_log(errout); return; }
-
-  // Read items out of Every List
-  listiter = ListIterateInit(EveryList);
-  if   (listiter == NULL) { linestep   =  1; } // READ linestep
-  else                    { tempdict = (Dict *)listiter->data; listiter = ListIterate(listiter, NULL); DictLookup(tempdict,"every_item",NULL,(void *)&intptr);
-                            if ((intptr==NULL) || (*intptr<1)) { linestep  =  1; } else { linestep   = *intptr; } }
-  if   (listiter == NULL) { blockstep  =  1; } // READ blockstep
-  else                    { tempdict = (Dict *)listiter->data; listiter = ListIterate(listiter, NULL); DictLookup(tempdict,"every_item",NULL,(void *)&intptr);
-                            if ((intptr==NULL) || (*intptr<1)) { blockstep =  1; } else { blockstep  = *intptr; } }
-  if   (listiter == NULL) { linefirst  = -1; } // READ linefirst
-  else                    { tempdict = (Dict *)listiter->data; listiter = ListIterate(listiter, NULL); DictLookup(tempdict,"every_item",NULL,(void *)&intptr);
-                            if ((intptr==NULL) || (*intptr<0)) { linefirst = -1; } else { linefirst  = *intptr; } }
-  if   (listiter == NULL) { blockfirst = -1; } // READ blockfirst
-  else                    { tempdict = (Dict *)listiter->data; listiter = ListIterate(listiter, NULL); DictLookup(tempdict,"every_item",NULL,(void *)&intptr);
-                            if ((intptr==NULL) || (*intptr<0)) { blockfirst= -1; } else { blockfirst = *intptr; } }
-  if   (listiter == NULL) { linelast   = -1; } // READ linelast
-  else                    { tempdict = (Dict *)listiter->data; listiter = ListIterate(listiter, NULL); DictLookup(tempdict,"every_item",NULL,(void *)&intptr);
-                            if ((intptr==NULL) || (*intptr<0)) { linelast  = -1; } else { linelast   = *intptr; } }
-  if   (listiter == NULL) { blocklast  = -1; } // READ blocklast
-  else                    { tempdict = (Dict *)listiter->data; listiter = ListIterate(listiter, NULL); DictLookup(tempdict,"every_item",NULL,(void *)&intptr);
-                            if ((intptr==NULL) || (*intptr<0)) { blocklast = -1; } else { blocklast  = *intptr; } }
-  if   (listiter != NULL) { strcpy(errout, "More than six items specified in every modifier -- final items are not valid syntax."); *status=1; if (DEBUG) ppl_log(errout); return; }
+  if (ferror(in)) { sprintf(errout, "Error whilst reading binary datafile '%s'.", filename); *status=1; if (DEBUG) ppl_log(errout); return; }
+  if (have > 0) { sprintf(temp_err_string, "%s: File ends with an incomplete record of %ld bytes, which has been ignored. Records described by the binary format '%s' are %d bytes long.", filename, have, format, RecordLength); ppl_warning(ERR_GENERAL, temp_err_string); }
+  return;
+ }
 
-  // Output every list to log file if required
-  if (DEBUG) { sprintf(temp_err_string, "Every %d:%d:%d:%d:%d:%d", linestep, blockstep, linefirst, blockfirst, linelast, blocklast); ppl_log(temp_err_string); }
+// ------------------------------------------------------------------------------------------------------------------------------------------
+// FITS files. When PyXPlot is linked against cfitsio, files which would otherwise be passed through the pyxplot_fitshelper input filter are
+// read in-process instead, and their contents passed straight into a DataTable. As with the filter, each HDU of the file forms one index.
+// Each row of a table is one line of data, and the column names given by TTYPE keywords may be used in using expressions. Images are read as
+// lists of pixels, each with its coordinates along each axis, counted from one, followed by its value. Each row of an image forms one block.
+// ------------------------------------------------------------------------------------------------------------------------------------------
 
-  // Reset the counters which we use to monitor our position in the file
-  index_number       = 0;
-  linenumber_count   = 0;
-  linenumber_stepcnt = 0;
-  block_count        = 0;
-  block_stepcnt      = 0;
-  prev_blanklines    = 10; // The number of blank lines we've hit since the last datapoint
-  file_linenumber    = 0;
+#ifdef HAVE_FITSIO
 
-  // If SortBy is not NULL, add it to using list
-  if (SortBy!=NULL)
-   {
-    if (strcmp(SortBy, "@")==0) UsingItems[UsingLen++] = UsingItems[0];
-    else                        UsingItems[UsingLen++] = SortBy;
-   }
+// Returns 1 if filename would be passed through the built-in FITS input filter
+static int DataFile_FitsFilter(char *filename)
+ {
+  DictIterator *DictIter;
 
-  // Open the requested datafile
-  if      (strcmp(filename,"-" )==0) { filtered_input = stdin;  if (DEBUG) ppl_log("Reading from stdin.");       } // Special filename '-'  means we read from stdin
-  else if (strcmp(filename,"--")==0) { ReadFromCommandLine = 1; if (DEBUG) ppl_log("Reading from commandline."); } // Special filename '--' means we read from the commandline
-  else
+  if (filename[0]=='\0') return 0; // Last-used filename is resolved by DataFile_LaunchCoProcess()
+  DictIter = DictIterateInit(settings_filters);
+  while (DictIter != NULL)
    {
-    filtered_input = DataFile_LaunchCoProcess(filename, status, errout);
-    if (*status>0) return; // There was a problem launching coprocess or opening file
+    if (StrWildcardTest(filename, DictIter->key)) return (strcmp(((value *)DictIter->data)->string, FITSHELPER)==0);
+    DictIter = DictIterate(DictIter, NULL, NULL);
    }
-
-#define FCLOSE_FI \
- { \
-  if ((!ReadFromCommandLine) && (filtered_input != stdin)) fclose(filtered_input); \
+  return 0;
  }
 
-  // Keep a record of the memory context we're going to output into, and then make a scratchpad context
-  ContextOutput = persistent ? 0 : lt_GetMemContext();
-  ContextRough  = lt_DescendIntoNewContext(); // Rough mallocs inside this subroutine happen in this context
-  ContextRaw    = lt_DescendIntoNewContext(); // Raw data goes into here when plotting with rows
+// Add one row of a FITS file to a DataTable. Numeric items are passed in RowVal; non-numeric items are passed as text in RowStr, which
+// is NULL for numeric items. Rows which cannot be dealt with by DataFile_AddColumnRow() are printed as text for DataFile_ApplyUsingList().
+static void DataFile_FitsAddRow(DataTable *out, int ContextOutput, double *RowVal, char **RowStr, int Nitems, char *RowText, char **ColumnData, char **UsingItems, int UsingLen, int *UsingColumns, unsigned char ColumnListOnly, char *filename, long int file_linenumber, long int linenumber_count, long int block_count, long int index_number, char **ColumnHeadings, int NColumnHeadings, char *LabelStr, char *SelectCriterion, int continuity, unsigned char *discontinuity, int *ErrCounter, int *status, char *errout)
+ {
+  double data[USING_ITEMS_MAX];
+  char  *cptr;
+  int    i, c;
 
-  *output = DataFile_NewDataTable(UsingLen, ContextOutput, -1);
-  if (*output == NULL) { strcpy(errout, "Out of memory whilst trying to allocate data table to read data from file."); *status=1; if (DEBUG) ppl_log(errout); FCLOSE_FI; return; }
-  if (UsingRowCol == DATAFILE_ROW)
+  if (ColumnListOnly)
    {
-    RawDataTab = DataFile_NewRawDataTable(ContextRaw);
-    if (RawDataTab == NULL) { strcpy(errout, "Out of memory whilst trying to allocate data table to read data from file."); *status=1; if (DEBUG) ppl_log(errout); FCLOSE_FI; return; }
+    for (i=0; i<UsingLen; i++)
+     {
+      c = UsingColumns[i];
+      if ((c>Nitems) || (RowStr[c-1]!=NULL) || (!gsl_finite(RowVal[c-1]))) break;
+      data[i] = RowVal[c-1];
+     }
+    if ((i==UsingLen) && !DataFile_AddColumnRow(out, data, UsingLen, file_linenumber, discontinuity, status, errout)) return;
    }
 
-  // Read input file, line by line
-  while (ReadFromCommandLine || ( (!ferror(filtered_input)) && (!feof(filtered_input)) ))
+  for (i=0, cptr=RowText; i<Nitems; i++)
    {
-    if (!ReadFromCommandLine) file_readline(filtered_input, linebuffer, LSTR_LENGTH);
-    else                      lineptr = FetchInputStatement("data ..> ",".......> ",0);
-
-    if (ReadFromCommandLine && (lineptr==NULL                                 )) break; // End of file reached
-    if (ReadFromCommandLine && (strcmp(StrStrip(lineptr, linebuffer),"END")==0)) break;
-
-    file_linenumber++;
-    StrStrip(lineptr, linebuffer);
+    if (RowStr[i]!=NULL) { ColumnData[i] = RowStr[i]; continue; }
+    ColumnData[i] = cptr;
+    sprintf(cptr, "%.17g", RowVal[i]);
+    cptr += strlen(cptr)+1;
+   }
+  DataFile_ApplyUsingList(out, ContextOutput, ColumnData, NULL, Nitems, UsingItems, UsingLen, filename, file_linenumber, NULL, linenumber_count, block_count, index_number, DATAFILE_COL, "column", ColumnHeadings, NColumnHeadings, NULL, 0, LabelStr, SelectCriterion, continuity, discontinuity, ErrCounter, status, errout);
+  return;
+ }
 
-    for (j=0; ((linebuffer[j]!='\0')&&(linebuffer[j]<=' ')); j++);
-    if (linebuffer[j]=='\0') // We have a blank line
+static void DataFile_ReadFits(DataTable *out, int ContextOutput, int ContextRough, char *filename, int index, char **UsingItems, int UsingLen, int *UsingColumns, unsigned char ColumnListOnly, unsigned char OneColumnInput, char *LabelStr, char *SelectCriterion, int continuity, int linestep, int blockstep, int linefirst, int blockfirst, int linelast, int blocklast, int *ErrCounter, int *status, char *errout)
+ {
+  fitsfile      *fptr=NULL;
+  int            FitsStatus=0, Nhdus, hdunum, hdutype, Ncols, naxis, anynul, Nitems, i, c, *typecode, *width, *BulkRead;
+  unsigned char  discontinuity, *ReadCol;
+  long int      *repeat, *naxes, *coord, nrows, row, ChunkRows, RowBytes, n, r, Npixels, pixel;
+  long int       index_number, linenumber_count, linenumber_stepcnt, block_count, block_stepcnt;
+  double         nulval, **ColNum, *RowVal;
+  char        ***ColStr, **RowStr, **ColumnData, *RowText, **ColumnHeadings, keyword[FLEN_KEYWORD], colname[FLEN_VALUE], nullstr[]="nan";
+
+  nulval = GSL_NAN;
+  if (fits_open_file(&fptr, filename, READONLY, &FitsStatus)) goto FITS_ERROR;
+  if (fits_get_num_hdus(fptr, &Nhdus, &FitsStatus)) goto FITS_ERROR;
+
+  for (hdunum=1; hdunum<=Nhdus; hdunum++)
+   {
+    index_number = hdunum-1; // The primary HDU is index 0
+    if ((index>=0) && (index_number!=index)) continue;
+    if (fits_movabs_hdu(fptr, hdunum, &hdutype, &FitsStatus)) goto FITS_ERROR;
+    discontinuity      = 1;
+    linenumber_count   = 0;
+    linenumber_stepcnt = 0;
+    block_count        = 0;
+    block_stepcnt      = 0;
+
+    if (hdutype == IMAGE_HDU)
      {
-      if (prev_blanklines>1) continue; // A very long gap in the datafile
-      prev_blanklines++;
-      if (prev_blanklines==1)
+      if (fits_get_img_dim(fptr, &naxis, &FitsStatus)) goto FITS_ERROR;
+      if (naxis<1) continue;
+      if (naxis>=MAX_DATACOLS) { sprintf(errout, "%s: HDU %d is an image with too many axes (%d).", filename, hdunum, naxis); *status=1; goto CLOSE; }
+      Nitems     = naxis+1;
+      naxes      = (long int *)lt_malloc_incontext(naxis*sizeof(long int), ContextRough);
+      coord      = (long int *)lt_malloc_incontext(naxis*sizeof(long int), ContextRough);
+      ChunkRows  = DATAFILE_READ_BYTES / sizeof(double);
+      ColNum     = (double  **)lt_malloc_incontext(sizeof(double *), ContextRough);
+      RowVal     = (double   *)lt_malloc_incontext(Nitems*sizeof(double), ContextRough);
+      RowStr     = (char    **)lt_malloc_incontext(Nitems*sizeof(char *), ContextRough);
+      ColumnData = (char    **)lt_malloc_incontext(Nitems*sizeof(char *), ContextRough);
+      RowText    = (char     *)lt_malloc_incontext(Nitems*32, ContextRough);
+      if ((naxes==NULL)||(coord==NULL)||(ColNum==NULL)||(RowVal==NULL)||(RowStr==NULL)||(ColumnData==NULL)||(RowText==NULL)) { strcpy(errout, "Out of memory."); *status=1; goto CLOSE; }
+      if (fits_get_img_size(fptr, naxis, naxes, &FitsStatus)) goto FITS_ERROR;
+      for (Npixels=1, i=0; i<naxis; i++) { Npixels *= naxes[i]; coord[i]=0; RowStr[i]=NULL; }
+      RowStr[naxis] = NULL;
+      if (Npixels<1) continue;
+      if (ChunkRows > Npixels) ChunkRows = Npixels;
+      if ((ColNum[0] = (double *)lt_malloc_incontext(ChunkRows*sizeof(double), ContextRough))==NULL) { strcpy(errout, "Out of memory."); *status=1; goto CLOSE; }
+
+      for (pixel=0; pixel<Npixels; pixel+=n)
        {
-        block_count++; // First newline gives us a new block
-        block_stepcnt = ((block_stepcnt-1) % blockstep);
-        discontinuity=1; // We want to break the line here
-        linenumber_count=0; // Zero linecounter within block
-        linenumber_stepcnt=0;
-       } else {
-        index_number++; // Second newline gives us a new index
-        block_count=0; // Zero block counter
-        block_stepcnt=0;
-        if (DEBUG) { sprintf(temp_err_string, "Index %ld begins on line %ld of datafile.", index_number, file_linenumber); ppl_log(temp_err_string); }
-        if ((index>=0) && (index_number>index)) break; // We'll never find any more data once we've gone past the specified index
-       }
-      continue;
+        n = Npixels-pixel; if (n>ChunkRows) n=ChunkRows;
+        if (fits_read_img(fptr, TDOUBLE, pixel+1, n, &nulval, ColNum[0], &anynul, &FitsStatus)) goto FITS_ERROR;
+        for (r=0; r<n; r++)
+         {
+          if ((coord[0]==0) && (pixel+r>0)) // Each row of the image is a new block
+           {
+            block_count++;
+            block_stepcnt      = ((block_stepcnt-1) % blockstep);
+            discontinuity      = 1;
+            linenumber_count   = 0;
+            linenumber_stepcnt = 0;
+           }
+          if ((block_stepcnt==0) && ((blockfirst<0)||(block_count>=blockfirst)) && ((blocklast<0)||(block_count<=blocklast)) &&
+              (linenumber_stepcnt==0) && ((linefirst<0)||(linenumber_count>=linefirst)) && ((linelast<0)||(linenumber_count<=linelast)))
+           {
+            for (i=0; i<naxis; i++) RowVal[i] = coord[i]+1;
+            RowVal[naxis] = ColNum[0][r];
+            DataFile_FitsAddRow(out, ContextOutput, RowVal, RowStr, Nitems, RowText, ColumnData, UsingItems, UsingLen, UsingColumns, ColumnListOnly, filename, pixel+r+1, linenumber_count, block_count, index_number, NULL, 0, LabelStr, SelectCriterion, continuity, &discontinuity, ErrCounter, status, errout);
+            if (*status) goto CLOSE;
+           }
+          linenumber_count++;
+          linenumber_stepcnt = ((linenumber_stepcnt-1) % linestep);
+          for (i=0; i<naxis; i++) { if (++coord[i] < naxes[i]) break; coord[i]=0; }
+         }
+       }
+     }
+    else // ASCII or binary table
+     {
+      if (blockfirst>0) continue; // Tables contain only block 0
+      if (fits_get_num_rows(fptr, &nrows, &FitsStatus)) goto FITS_ERROR;
+      if (fits_get_num_cols(fptr, &Ncols, &FitsStatus)) goto FITS_ERROR;
+      if (Ncols>MAX_DATACOLS) Ncols=MAX_DATACOLS;
+      if ((Ncols<1) || (nrows<1)) continue;
+      Nitems         = Ncols + ((Ncols==1) && OneColumnInput); // Add row numbers as first column to one-column tables
+      typecode       = (int       *)lt_malloc_incontext(Ncols*sizeof(int)       , ContextRough);
+      width          = (int       *)lt_malloc_incontext(Ncols*sizeof(int)       , ContextRough);
+      BulkRead       = (int       *)lt_malloc_incontext(Ncols*sizeof(int)       , ContextRough);
+      repeat         = (long int  *)lt_malloc_incontext(Ncols*sizeof(long int)  , ContextRough);
+      ReadCol        = (unsigned char *)lt_malloc_incontext(Ncols               , ContextRough);
+      ColNum         = (double   **)lt_malloc_incontext(Ncols*sizeof(double *)  , ContextRough);
+      ColStr         = (char    ***)lt_malloc_incontext(Ncols*sizeof(char **)   , ContextRough);
+      ColumnHeadings = (char     **)lt_malloc_incontext(Ncols*sizeof(char *)    , ContextRough);
+      RowVal         = (double    *)lt_malloc_incontext(Nitems*sizeof(double)   , ContextRough);
+      RowStr         = (char     **)lt_malloc_incontext(Nitems*sizeof(char *)   , ContextRough);
+      ColumnData     = (char     **)lt_malloc_incontext(Nitems*sizeof(char *)   , ContextRough);
+      RowText        = (char      *)lt_malloc_incontext(Nitems*32               , ContextRough);
+      if ((typecode==NULL)||(width==NULL)||(BulkRead==NULL)||(repeat==NULL)||(ReadCol==NULL)||(ColNum==NULL)||(ColStr==NULL)||(ColumnHeadings==NULL)||(RowVal==NULL)||(RowStr==NULL)||(ColumnData==NULL)||(RowText==NULL)) { strcpy(errout, "Out of memory."); *status=1; goto CLOSE; }
+
+      // Plain lists of column numbers only need those columns to be read
+      for (c=0; c<Ncols; c++) ReadCol[c] = !ColumnListOnly;
+      if (ColumnListOnly) for (i=0; i<UsingLen; i++) { c = UsingColumns[i]-1-(Nitems>Ncols); if ((c>=0) && (c<Ncols)) ReadCol[c] = 1; }
+
+      // Read column types and names. Numeric columns are read as doubles, and everything else as text.
+      RowBytes = 0;
+      for (c=0; c<Ncols; c++)
+       {
+        long int ElementWidth;
+        if (fits_get_coltype(fptr, c+1, typecode+c, repeat+c, &ElementWidth, &FitsStatus)) goto FITS_ERROR;
+        fits_make_keyn("TTYPE", c+1, keyword, &FitsStatus);
+        if (fits_read_key(fptr, TSTRING, keyword, colname, NULL, &FitsStatus) == KEY_NO_EXIST) { FitsStatus=0; colname[0]='\0'; }
+        if (FitsStatus) goto FITS_ERROR;
+        ColumnHeadings[c] = (char *)lt_malloc_incontext(strlen(colname)+1, ContextRough);
+        if (ColumnHeadings[c]==NULL) { strcpy(errout, "Out of memory."); *status=1; goto CLOSE; }
+        strcpy(ColumnHeadings[c], colname);
+        switch (typecode[c])
+         {
+          case TBYTE: case TSBYTE: case TSHORT: case TUSHORT: case TINT: case TUINT: case TLONG: case TULONG: case TLONGLONG: case TFLOAT: case TDOUBLE:
+            width[c]    = 0;
+            BulkRead[c] = (repeat[c]==1);
+            if (ReadCol[c]) RowBytes += sizeof(double);
+            break;
+          default:
+            if (fits_get_col_display_width(fptr, c+1, width+c, &FitsStatus)) goto FITS_ERROR;
+            BulkRead[c] = (typecode[c]==TSTRING) ? (repeat[c]<=ElementWidth) : (repeat[c]==1);
+            if (ReadCol[c]) RowBytes += width[c]+1+sizeof(char *);
+         }
+       }
+
+      ChunkRows = DATAFILE_READ_BYTES / (RowBytes+1);
+      if (ChunkRows<1    ) ChunkRows=1;
+      if (ChunkRows>nrows) ChunkRows=nrows;
+      for (c=0; c<Ncols; c++)
+       {
+        ColNum[c] = NULL; ColStr[c] = NULL;
+        if (!ReadCol[c]) continue;
+        if (width[c]==0)
+         {
+          if ((ColNum[c] = (double *)lt_malloc_incontext(ChunkRows*sizeof(double), ContextRough))==NULL) { strcpy(errout, "Out of memory."); *status=1; goto CLOSE; }
+         }
+        else
+         {
+          char *buffer = (char *)lt_malloc_incontext(ChunkRows*(width[c]+1), ContextRough);
+          if ((buffer==NULL) || ((ColStr[c] = (char **)lt_malloc_incontext(ChunkRows*sizeof(char *), ContextRough))==NULL)) { strcpy(errout, "Out of memory."); *status=1; goto CLOSE; }
+          for (r=0; r<ChunkRows; r++) ColStr[c][r] = buffer + r*(width[c]+1);
+         }
+       }
+      if (Nitems>Ncols) RowStr[0] = NULL;
+
+      for (row=0; row<nrows; row+=n)
+       {
+        if ((linelast>=0) && (row>linelast)) break; // No more rows are wanted
+        n = nrows-row; if (n>ChunkRows) n=ChunkRows;
+
+        // Read a chunk of rows from each column. Only the first element of vector columns is read.
+        for (c=0; c<Ncols; c++)
+         {
+          if (!ReadCol[c]) continue;
+          if (BulkRead[c])
+           {
+            if (width[c]==0) fits_read_col    (fptr, TDOUBLE, c+1, row+1, 1, n, &nulval, ColNum[c], &anynul, &FitsStatus);
+            else             fits_read_col_str(fptr,          c+1, row+1, 1, n,  nullstr, ColStr[c], &anynul, &FitsStatus);
+           }
+          else for (r=0; (r<n) && (!FitsStatus); r++)
+           {
+            if (width[c]==0) fits_read_col    (fptr, TDOUBLE, c+1, row+r+1, 1, 1, &nulval, ColNum[c]+r, &anynul, &FitsStatus);
+            else             fits_read_col_str(fptr,          c+1, row+r+1, 1, 1,  nullstr, ColStr[c]+r, &anynul, &FitsStatus);
+           }
+          if (FitsStatus) goto FITS_ERROR;
+         }
+
+        for (r=0; r<n; r++)
+         {
+          if ((linenumber_stepcnt==0) && ((linefirst<0)||(linenumber_count>=linefirst)) && ((linelast<0)||(linenumber_count<=linelast)))
+           {
+            if (Nitems>Ncols) RowVal[0] = row+r+1;
+            for (c=0; c<Ncols; c++)
+             {
+              i = c + (Nitems>Ncols);
+              if      (!ReadCol[c]  ) { RowVal[i] = GSL_NAN; RowStr[i] = nullstr; }
+              else if (width[c]==0  ) { RowVal[i] = ColNum[c][r]; RowStr[i] = NULL; }
+              else                    { RowVal[i] = GSL_NAN; RowStr[i] = ColStr[c][r]; }
+             }
+            DataFile_FitsAddRow(out, ContextOutput, RowVal, RowStr, Nitems, RowText, ColumnData, UsingItems, UsingLen, UsingColumns, ColumnListOnly, filename, row+r+1, linenumber_count, block_count, index_number, ColumnHeadings, Ncols, LabelStr, SelectCriterion, continuity, &discontinuity, ErrCounter, status, errout);
+            if (*status) goto CLOSE;
+           }
+          linenumber_count++;
+          linenumber_stepcnt = ((linenumber_stepcnt-1) % linestep);
+         }
+       }
+     }
+   }
+
+CLOSE:
+  FitsStatus=0;
+  if (fptr!=NULL) fits_close_file(fptr, &FitsStatus);
+  if (DEBUG && *status) ppl_log(errout);
+  return;
+
+FITS_ERROR:
+  fits_get_errstatus(FitsStatus, colname);
+  sprintf(errout, "Error whilst reading FITS file '%s': %s.", filename, colname);
+  *status=1;
+  goto CLOSE;
+ }
+
+#endif
+
+// ------------------------------------------------------------------------------------------------------------------
+// DataFile_ReadFile() reads a table of data from a data file. It is called by DataFile_read(), which caches its output
+// ------------------------------------------------------------------------------------------------------------------
+
+// Read the items of a using list into the array UsingItems. Blank items are replaced with their column numbers, and an automatic list is
+// generated if the supplied list is empty. Returns nonzero on error.
+static int DataFile_UsingItems(List *UsingList, char **UsingItems, int *UsingLen, unsigned char *AutoUsingList, int Ncolumns, char *errout)
+ {
+  unsigned char HadNonNullUsingItem=0;
+  ListIterator *listiter;
+  Dict         *tempdict;
+  int           i;
+
+  *UsingLen=0; listiter = ListIterateInit(UsingList);
+  while (listiter != NULL)
+   {
+    if (*UsingLen>=USING_ITEMS_MAX) { strcpy(errout,"Too many items in using list."); return 1; }
+    tempdict = (Dict *)listiter->data;
+    DictLookup(tempdict,"using_item",NULL,(void *)&(UsingItems[*UsingLen]));
+    if ((UsingItems[*UsingLen]==NULL)||(strlen(StrStrip(UsingItems[*UsingLen], UsingItems[*UsingLen]))==0)) // Using item is blank; replace with item number
+     {
+      if ((UsingItems[*UsingLen] = (char *)lt_malloc(10))==NULL) { sprintf(errout,"Out of memory."); return 1; };
+      sprintf(UsingItems[*UsingLen], "%d", *UsingLen+1);
+     } else {
+      HadNonNullUsingItem=1;
+     }
+    (*UsingLen)++;
+    listiter = ListIterate(listiter, NULL);
+   }
+
+  // If have only one using item, and it is NULL, pretend we have an empty list
+  if ((*UsingLen==1) && (!HadNonNullUsingItem)) *UsingLen=0;
+
+  // If using list was empty, generate an automatic list
+  if (*UsingLen==0)
+   {
+    for (i=0; i<Ncolumns; i++)
+     {
+      if ((UsingItems[i] = (char *)lt_malloc(10))==NULL) { sprintf(errout,"Out of memory."); return 1; };
+      sprintf(UsingItems[i], "%d", i+1);
+     }
+    *UsingLen = Ncolumns;
+    *AutoUsingList = 1; // We have automatically generated this using list
+   }
+  else if ((*UsingLen==1) && (Ncolumns==2)) // Prepend data point number if only one number specified in using statement
+   {
+    UsingItems[1] = UsingItems[0];
+    UsingItems[0] = "0";
+    (*UsingLen)++;
+   }
+  return 0;
+ }
+
+// Read the six items of an every modifier. Items which are not specified are set to their default values. Returns nonzero on error.
+static int DataFile_EveryItems(List *EveryList, int *linestep, int *blockstep, int *linefirst, int *blockfirst, int *linelast, int *blocklast, char *errout)
+ {
+  ListIterator *listiter;
+  Dict         *tempdict;
+  int          *intptr;
+
+  listiter = ListIterateInit(EveryList);
+  if   (listiter == NULL) { *linestep   =  1; } // READ linestep
+  else                    { tempdict = (Dict *)listiter->data; listiter = ListIterate(listiter, NULL); DictLookup(tempdict,"every_item",NULL,(void *)&intptr);
+                            if ((intptr==NULL) || (*intptr<1)) { *linestep  =  1; } else { *linestep   = *intptr; } }
+  if   (listiter == NULL) { *blockstep  =  1; } // READ blockstep
+  else                    { tempdict = (Dict *)listiter->data; listiter = ListIterate(listiter, NULL); DictLookup(tempdict,"every_item",NULL,(void *)&intptr);
+                            if ((intptr==NULL) || (*intptr<1)) { *blockstep =  1; } else { *blockstep  = *intptr; } }
+  if   (listiter == NULL) { *linefirst  = -1; } // READ linefirst
+  else                    { tempdict = (Dict *)listiter->data; listiter = ListIterate(listiter, NULL); DictLookup(tempdict,"every_item",NULL,(void *)&intptr);
+                            if ((intptr==NULL) || (*intptr<0)) { *linefirst = -1; } else { *linefirst  = *intptr; } }
+  if   (listiter == NULL) { *blockfirst = -1; } // READ blockfirst
+  else                    { tempdict = (Dict *)listiter->data; listiter = ListIterate(listiter, NULL); DictLookup(tempdict,"every_item",NULL,(void *)&intptr);
+                            if ((intptr==NULL) || (*intptr<0)) { *blockfirst= -1; } else { *blockfirst = *intptr; } }
+  if   (listiter == NULL) { *linelast   = -1; } // READ linelast
+  else                    { tempdict = (Dict *)listiter->data; listiter = ListIterate(listiter, NULL); DictLookup(tempdict,"every_item",NULL,(void *)&intptr);
+                            if ((intptr==NULL) || (*intptr<0)) { *linelast  = -1; } else { *linelast   = *intptr; } }
+  if   (listiter == NULL) { *blocklast  = -1; } // READ blocklast
+  else                    { tempdict = (Dict *)listiter->data; listiter = ListIterate(listiter, NULL); DictLookup(tempdict,"every_item",NULL,(void *)&intptr);
+                            if ((intptr==NULL) || (*intptr<0)) { *blocklast = -1; } else { *blocklast  = *intptr; } }
+  if   (listiter != NULL) { strcpy(errout, "More than six items specified in every modifier -- final items are not valid syntax."); return 1; }
+
+  return 0;
+ }
+
+// Returns 1 if every using item is simply a column number, e.g. using 1:2 or using $1:$2, in which case the column numbers are put into
+// UsingColumns, and DataFile_ApplyColumnList() can be used in place of DataFile_ApplyUsingList()
+static int DataFile_UsingColumnList(char **UsingItems, int UsingLen, int *UsingColumns)
+ {
+  char *cptr;
+  int   i;
+
+  for (i=0; i<UsingLen; i++)
+   {
+    cptr = UsingItems[i];
+    while ((*cptr!='\0')&&(*cptr<=' ')) cptr++;
+    if (*cptr=='$') cptr++;
+    for (UsingColumns[i]=0; (*cptr>='0')&&(*cptr<='9')&&(UsingColumns[i]<=MAX_DATACOLS); cptr++) UsingColumns[i] = 10*UsingColumns[i] + (*cptr-'0');
+    while ((*cptr!='\0')&&(*cptr<=' ')) cptr++;
+    if ((*cptr!='\0') || (UsingColumns[i]<1) || (UsingColumns[i]>MAX_DATACOLS)) return 0;
+   }
+  return 1;
+ }
+
+// Find the data items on a line of a datafile, putting pointers to the start of each into ColumnData, and return how many there are
+static int DataFile_SplitLine(char *line, char **ColumnData)
+ {
+  unsigned char hadwhitespace=1, hadcomma=0;
+  int           i, j, ItemsOnLine=0;
+
+  for (i=0; line[i]!='\0'; i++)
+   {
+    if      (line[i]<=' ') { hadwhitespace = 1; }
+    else if (line[i]==',') { for (j=i+1;((line[j]<=' ')&&(line[j]!='\0'));j++); ColumnData[ItemsOnLine++]=line+j; hadwhitespace = hadcomma = 1; }
+    else                   { if (hadwhitespace && !hadcomma) { ColumnData[ItemsOnLine++]=line+i; } hadwhitespace = hadcomma = 0; }
+    if (ItemsOnLine==MAX_DATACOLS) break; // Don't allow ColumnData array to overflow
+   }
+  return ItemsOnLine;
+ }
+
+static void DataFile_ReadFile(DataTable **output, int *status, char *errout, char *filename, char *BinaryFormat, int index, int UsingRowCol, List *UsingList, unsigned char AutoUsingList, List *EveryList, char *LabelStr, int Ncolumns, char *SelectCriterion, int continuity, char *SortBy, int SortByContinuity, unsigned char persistent, int *ErrCounter)
+ {
+  unsigned char ReadFromCommandLine=0, discontinuity=0, hadwhitespace, OneColumnInput=1, ColumnListOnly;
+  int           UsingLen, logi, logj, ContextOutput, ContextRough, ContextRaw;
+  char         *UsingItems[USING_ITEMS_MAX], LineNumberStr[32];
+  int           UsingColumns[USING_ITEMS_MAX];
+  DataFileReader reader;
+  DataFileParallel parallel;
+  double       *ParsedRow;
+  int           ParsedItems;
+  int           linestep=1, blockstep=1, linefirst=-1, blockfirst=-1, linelast=-1, blocklast=-1;
+  long int      index_number, linenumber_count, linenumber_stepcnt, block_count, block_stepcnt, prev_blanklines, file_linenumber, ItemsOnLine;
+  FILE         *filtered_input=NULL;
+  char          linespace[LSTR_LENGTH], *linebuffer=linespace, *lineptr, *cptr;
+
+  int i, j, k, l, m;
+
+  char        **ColumnHeadings  = NULL;
+  int           NColumnHeadings = 0;
+  char        **RowHeadings     = NULL;
+  int           NRowHeadings    = 0;
+  value        *ColumnUnits     = NULL;
+  int           NColumnUnits    = 0;
+  value        *RowUnits        = NULL;
+  int           NRowUnits       = 0;
+
+  char         *ColumnData[MAX_DATACOLS];
+  RawDataTable *RawDataTab = NULL;
+#ifdef HAVE_FITSIO
+  unsigned char ReadFits = 0;
+#endif
+
+  // Init
+  if (DEBUG) { sprintf(temp_err_string, "Opening datafile '%s'.", filename); ppl_log(temp_err_string); }
+  reader.map        = NULL;
+  parallel.NThreads = 0;
+  if (Ncolumns != 2) OneColumnInput=0; // Only have special handling for one-column datafiles when looking for two columns
+
+  // Read items out of Using List into an array of strings
+  if (DataFile_UsingItems(UsingList, UsingItems, &UsingLen, &AutoUsingList, Ncolumns, errout)) { *status=1; if (DEBUG) ppl_log(errout); return; }
+
+  // Output using list to log file if required
+  if (DEBUG)
+   {
+    logi=0; sprintf(temp_err_string+logi, "Using "); logi+=strlen(temp_err_string+logi);
+    for (logj=0; logj<UsingLen; logj++)
+     {
+      if (logj!=0) temp_err_string[logi++]=':';
+      strcpy(temp_err_string+logi, UsingItems[logj]);
+      logi+=strlen(temp_err_string+logi);
+     }
+    ppl_log(temp_err_string);
+   }
+
+  // If our using list has the wrong number of elements for the plot style we're aiming to use, then reject it
+  if (UsingLen != Ncolumns) { sprintf(errout,"The supplied using ... clause contains the wrong number of items. We need %d columns of data, but %d have been supplied.", Ncolumns, UsingLen); *status=1; if (DEBUG) ppl_log(errout); return; }
+
+  // Read items out of Every List
+  if (DataFile_EveryItems(EveryList, &linestep, &blockstep, &linefirst, &blockfirst, &linelast, &blocklast, errout)) { *status=1; if (DEBUG) ppl_log(errout); return; }
+
+  // Output every list to log file if required
+  if (DEBUG) { sprintf(temp_err_string, "Every %d:%d:%d:%d:%d:%d", linestep, blockstep, linefirst, blockfirst, linelast, blocklast); ppl_log(temp_err_string); }
+
+  // Reset the counters which we use to monitor our position in the file
+  index_number       = 0;
+  linenumber_count   = 0;
+  linenumber_stepcnt = 0;
+  block_count        = 0;
+  block_stepcnt      = 0;
+  prev_blanklines    = 10; // The number of blank lines we've hit since the last datapoint
+  file_linenumber    = 0;
+
+  // If SortBy is not NULL, add it to using list
+  if (SortBy!=NULL)
+   {
+    if (strcmp(SortBy, "@")==0) UsingItems[UsingLen++] = UsingItems[0];
+    else                        UsingItems[UsingLen++] = SortBy;
+   }
+
+  // See whether every using item is simply a column number, e.g. using 1:2 or using $1:$2, in which case DataFile_ApplyColumnList() can be used
+  ColumnListOnly = (UsingRowCol == DATAFILE_COL) && (LabelStr == NULL) && (SelectCriterion == NULL) && DataFile_UsingColumnList(UsingItems, UsingLen, UsingColumns);
+
+  // Binary datafiles have no text to read rows from
+  if ((BinaryFormat != NULL) && (UsingRowCol == DATAFILE_ROW)) { strcpy(errout, "The binary modifier cannot be used to read data with rows."); *status=1; if (DEBUG) ppl_log(errout); return; }
+  if ((BinaryFormat != NULL) && (strcmp(filename,"--")==0))    { strcpy(errout, "The binary modifier cannot be used to read data from the commandline."); *status=1; if (DEBUG) ppl_log(errout); return; }
+
+  // Open the requested datafile
+  if      (strcmp(filename,"-" )==0) { filtered_input = stdin;  if (DEBUG) ppl_log("Reading from stdin.");       } // Special filename '-'  means we read from stdin
+  else if (strcmp(filename,"--")==0) { ReadFromCommandLine = 1; if (DEBUG) ppl_log("Reading from commandline."); } // Special filename '--' means we read from the commandline
+#ifdef HAVE_FITSIO
+  else if ((BinaryFormat == NULL) && (UsingRowCol == DATAFILE_COL) && DataFile_FitsFilter(filename)) { ReadFits = 1; if (DEBUG) ppl_log("Reading FITS file."); }
+#endif
+  else
+   {
+    filtered_input = DataFile_LaunchCoProcess(filename, status, errout);
+    if (*status>0) return; // There was a problem launching coprocess or opening file
+   }
+
+#define FCLOSE_FI \
+ { \
+  DataFile_ParallelFree(&parallel); \
+  DataFile_ReaderClose(&reader); \
+  if ((filtered_input != NULL) && (filtered_input != stdin)) fclose(filtered_input); \
+ }
+
+  // Keep a record of the memory context we're going to output into, and then make a scratchpad context
+  ContextOutput = persistent ? 0 : lt_GetMemContext();
+  ContextRough  = lt_DescendIntoNewContext(); // Rough mallocs inside this subroutine happen in this context
+  ContextRaw    = lt_DescendIntoNewContext(); // Raw data goes into here when plotting with rows
+
+  *output = DataFile_NewDataTable(UsingLen, ContextOutput, -1);
+  if (*output == NULL) { strcpy(errout, "Out of memory whilst trying to allocate data table to read data from file."); *status=1; if (DEBUG) ppl_log(errout); FCLOSE_FI; return; }
+  if ((filtered_input != NULL) && (BinaryFormat == NULL) && DataFile_ReaderInit(&reader, filtered_input, ContextRough)) { strcpy(errout, "Out of memory whilst trying to allocate buffer to read data from file."); *status=1; if (DEBUG) ppl_log(errout); FCLOSE_FI; return; }
+
+  // If the file has been memory-mapped, and contains plain columns of numbers, these can be converted by several threads at once
+  if ((reader.map != NULL) && ColumnListOnly)
+   {
+    i = ppl_threads_count();
+    if (i > reader.end / DATAFILE_PARSE_BYTES + 1) i = reader.end / DATAFILE_PARSE_BYTES + 1;
+    if (i > 1)
+     {
+      memset(&parallel, 0, sizeof(DataFileParallel));
+      parallel.map          = reader.map;
+      parallel.MapLength    = reader.end;
+      parallel.NThreads     = i;
+      parallel.Ncolumns     = UsingLen;
+      parallel.UsingColumns = UsingColumns;
+      if (DEBUG) { sprintf(temp_err_string, "Parsing datafile using %d threads.", i); ppl_log(temp_err_string); }
+     }
+   }
+  if (BinaryFormat != NULL)
+   {
+    DataFile_ReadBinary(*output, ContextOutput, ContextRough, filtered_input, BinaryFormat, filename, index, UsingItems, UsingLen, UsingColumns, ColumnListOnly, LabelStr, SelectCriterion, continuity, linestep, linefirst, linelast, ErrCounter, status, errout);
+    if (*status) { FCLOSE_FI; return; }
+    goto FINISHED_READING;
+   }
+#ifdef HAVE_FITSIO
+  if (ReadFits)
+   {
+    DataFile_ReadFits(*output, ContextOutput, ContextRough, filename, index, UsingItems, UsingLen, UsingColumns, ColumnListOnly, OneColumnInput && AutoUsingList, LabelStr, SelectCriterion, continuity, linestep, blockstep, linefirst, blockfirst, linelast, blocklast, ErrCounter, status, errout);
+    if (*status) { FCLOSE_FI; return; }
+    goto FINISHED_READING;
+   }
+#endif
+  if (UsingRowCol == DATAFILE_ROW)
+   {
+    RawDataTab = DataFile_NewRawDataTable(ContextRaw);
+    if (RawDataTab == NULL) { strcpy(errout, "Out of memory whilst trying to allocate data table to read data from file."); *status=1; if (DEBUG) ppl_log(errout); FCLOSE_FI; return; }
+   }
+
+  // Read input file, line by line
+  while (1)
+   {
+    if (!ReadFromCommandLine)
+     {
+      linebuffer = DataFile_ReadLine(&reader); // Line is returned already stripped
+      if (linebuffer==NULL) break; // End of file reached
+     }
+    else
+     {
+      lineptr = FetchInputStatement("data ..> ",".......> ",0);
+      if (lineptr==NULL) break; // End of file reached
+      if (strcmp(StrStrip(lineptr, linebuffer),"END")==0) break;
+     }
+
+    file_linenumber++;
+
+    for (j=0; ((linebuffer[j]!='\0')&&(linebuffer[j]<=' ')); j++);
+    if (linebuffer[j]=='\0') // We have a blank line
+     {
+      if (prev_blanklines>1) continue; // A very long gap in the datafile
+      prev_blanklines++;
+      if (prev_blanklines==1)
+       {
+        block_count++; // First newline gives us a new block
+        block_stepcnt = ((block_stepcnt-1) % blockstep);
+        discontinuity=1; // We want to break the line here
+        linenumber_count=0; // Zero linecounter within block
+        linenumber_stepcnt=0;
+       } else {
+        index_number++; // Second newline gives us a new index
+        block_count=0; // Zero block counter
+        block_stepcnt=0;
+        if (DEBUG) { sprintf(temp_err_string, "Index %ld begins on line %ld of datafile.", index_number, file_linenumber); ppl_log(temp_err_string); }
+        if ((index>=0) && (index_number>index)) break; // We'll never find any more data once we've gone past the specified index
+       }
+      continue;
      }
 
     // Ignore comment lines
@@ -986,32 +1834,40 @@ void DataFile_read(DataTable **output, int *status, char *errout, char *filename
      }
     else if ((linenumber_stepcnt==0) && ((linefirst<0)||(linenumber_count>=linefirst)) && ((linelast<0)||(linenumber_count<=linelast)))
      {
-      // Count the number of data items on this line
-      ItemsOnLine = 0; hadwhitespace = 1; hadcomma = 0;
-      for (i=0; linebuffer[i]!='\0'; i++)
+      // See whether this line has already been converted by a worker thread
+      ParsedRow = NULL;
+      if (parallel.NThreads > 0) ParsedRow = DataFile_ParallelRow(&parallel, reader.LineStart, &ParsedItems);
+      if ((ParsedRow != NULL) && (NColumnUnits==0) && !((ParsedItems == 1) && AutoUsingList && OneColumnInput))
        {
-        if      (linebuffer[i]<=' ') { hadwhitespace = 1; }
-        else if (linebuffer[i]==',') { int j; for (j=i+1;((linebuffer[j]<=' ')&&(linebuffer[j]!='\0'));j++); ColumnData[ItemsOnLine++]=linebuffer+j; hadwhitespace = hadcomma = 1; }
-        else                         { if (hadwhitespace && !hadcomma) { ColumnData[ItemsOnLine++]=linebuffer+i; } hadwhitespace = hadcomma = 0; }
-        if (ItemsOnLine==MAX_DATACOLS) break; // Don't allow ColumnData array to overflow
+        if (ParsedItems > 1) OneColumnInput=0;
+        if (DataFile_AddColumnRow(*output, ParsedRow, UsingLen, file_linenumber, &discontinuity, status, errout)) ParsedRow = NULL;
        }
+      else ParsedRow = NULL;
 
-      // Add line numbers as first column to one-column datafiles
-      if  (ItemsOnLine >  1) OneColumnInput=0;
-      if ((ItemsOnLine == 1) && AutoUsingList && OneColumnInput)
+      if (ParsedRow == NULL)
        {
-        ColumnData[ItemsOnLine++]=ColumnData[0];
-        ColumnData[0]=LineNumberStr;
-        sprintf(LineNumberStr,"%ld",file_linenumber);
-       }
+        // Count the number of data items on this line
+        ItemsOnLine = DataFile_SplitLine(linebuffer, ColumnData);
+
+        // Add line numbers as first column to one-column datafiles
+        if  (ItemsOnLine >  1) OneColumnInput=0;
+        if ((ItemsOnLine == 1) && AutoUsingList && OneColumnInput)
+         {
+          ColumnData[ItemsOnLine++]=ColumnData[0];
+          ColumnData[0]=LineNumberStr;
+          sprintf(LineNumberStr,"%ld",file_linenumber);
+         }
 
-      DataFile_ApplyUsingList(*output, ContextOutput, ColumnData, NULL, ItemsOnLine, UsingItems, UsingLen, filename, file_linenumber, NULL, linenumber_count, block_count, index_number, DATAFILE_COL, "column", ColumnHeadings, NColumnHeadings, ColumnUnits, NColumnUnits, LabelStr, SelectCriterion, continuity, &discontinuity, ErrCounter, status, errout);
+        if ((!ColumnListOnly) || (NColumnUnits>0) || (ColumnData[0]==LineNumberStr) || DataFile_ApplyColumnList(*output, ColumnData, ItemsOnLine, UsingColumns, UsingLen, file_linenumber, &discontinuity, status, errout))
+         DataFile_ApplyUsingList(*output, ContextOutput, ColumnData, NULL, ItemsOnLine, UsingItems, UsingLen, filename, file_linenumber, NULL, linenumber_count, block_count, index_number, DATAFILE_COL, "column", ColumnHeadings, NColumnHeadings, ColumnUnits, NColumnUnits, LabelStr, SelectCriterion, continuity, &discontinuity, ErrCounter, status, errout);
+       }
       if (*status) { FCLOSE_FI; return; }
      }
     linenumber_count++;
     linenumber_stepcnt = ((linenumber_stepcnt-1) % linestep);
    }
 
+FINISHED_READING:
   // Close input file
   FCLOSE_FI;
 
@@ -1032,23 +1888,888 @@ void DataFile_read(DataTable **output, int *status, char *errout, char *filename
   return;
  }
 
+// ------------------------------------------------------------------------------------------------------------------------------------
+// Cache of recently-read datafiles. Tables are kept in malloced memory, outside of lt_memory's stack of contexts, and are indexed by the
+// identity of the file (device, inode, size and modification time) together with a key describing the clauses used to read it. Only
+// tables whose contents depend on nothing but the file itself are cached. Least recently used tables are discarded first when the
+// total size of the cache exceeds the limit set by "set datacache".
+// ------------------------------------------------------------------------------------------------------------------------------------
+
+typedef struct DataCacheEntry {
+  char          *key;
+  dev_t          dev;
+  ino_t          ino;
+  off_t          size;
+  time_t         mtime, ctime;
+  int            Ncolumns;
+  long int       Nrows, bytes;
+  value         *FirstEntries;
+  UnionDblStr   *data;
+  long int      *FileLine;
+  unsigned char *split;
+  struct DataCacheEntry *next; // Entries are kept in order of use, most recent first
+  struct DataCacheEntry *prev;
+ } DataCacheEntry;
+
+static DataCacheEntry *DataCache_first = NULL;
+static DataCacheEntry *DataCache_last  = NULL;
+static long int        DataCache_N=0, DataCache_bytes=0, DataCache_hits=0, DataCache_misses=0;
+
+static void DataFile_CacheRemove(DataCacheEntry *c)
+ {
+  if (c->prev != NULL) c->prev->next = c->next; else DataCache_first = c->next;
+  if (c->next != NULL) c->next->prev = c->prev; else DataCache_last  = c->prev;
+  DataCache_N--;
+  DataCache_bytes -= c->bytes;
+  free(c->key); free(c->FirstEntries); free(c->data); free(c->FileLine); free(c->split); free(c);
+  return;
+ }
+
+// Discard tables until the cache fits within its memory limit
+void DataFile_CacheTrim()
+ {
+  long int limit = (long int)(settings_term_current.DataCache * 1048576);
+  while ((DataCache_last != NULL) && (DataCache_bytes > limit)) DataFile_CacheRemove(DataCache_last);
+  return;
+ }
+
+void DataFile_CacheFlush()
+ {
+  while (DataCache_first != NULL) DataFile_CacheRemove(DataCache_first);
+  return;
+ }
+
+void DataFile_CacheStatus(long int *Nentries, long int *bytes, long int *hits, long int *misses)
+ {
+  *Nentries = DataCache_N;
+  *bytes    = DataCache_bytes;
+  *hits     = DataCache_hits;
+  *misses   = DataCache_misses;
+  return;
+ }
+
+// Returns 1 if the expression str, taken from a using, select or sort by clause, depends upon nothing but the contents of the datafile
+static int DataFile_CacheableExpression(char *str)
+ {
+  CompiledAlgebra *e;
+  int              errpos=-1, DataOnly;
+  char             errtext[LSTR_LENGTH];
+
+  while ((*str!='\0')&&(*str<=' ')) str++;
+  if (*str=='\0') return 1;
+  if ((*str=='\'')||(*str=='\"')) return 0; // Using items which produce strings are not cached
+  e = ppl_CompileAlgebraCached(str, 0, NULL, 1, &errpos, errtext, 0);
+  if (e==NULL) return 0;
+  DataOnly = ppl_CompiledAlgebraDataOnly(e);
+  ppl_CompiledAlgebraRelease(e);
+  return DataOnly;
+ }
+
+// Make a malloced string describing the clauses with which a datafile is to be read, or return NULL if the result should not be cached.
+// The same key is used to identify tables which have been read ahead by worker threads.
+static char *DataFile_CacheKey(char *filename, char *BinaryFormat, struct stat *st, int index, int UsingRowCol, List *UsingList, unsigned char AutoUsingList, List *EveryList, char *LabelStr, int Ncolumns, char *SelectCriterion, int continuity, char *SortBy, int SortByContinuity)
+ {
+  ListIterator *listiter;
+  DictIterator *DictIter;
+  Dict         *tempdict;
+  char         *item, *key;
+  int          *intptr, len, i;
+
+  if (LabelStr != NULL) return NULL;
+  if ((filename[0]=='\0') || (strcmp(filename,"-")==0) || (strcmp(filename,"--")==0)) return NULL; // Last-used filename, stdin and commandline
+  if ((stat(filename, st)!=0) || (!S_ISREG(st->st_mode))) return NULL;
+
+  // The output of input filters is not cached, but FITS files which are read in-process are
+  DictIter = DictIterateInit(settings_filters);
+#ifdef HAVE_FITSIO
+  if ((BinaryFormat == NULL) && (UsingRowCol == DATAFILE_COL) && DataFile_FitsFilter(filename)) DictIter = NULL;
+#endif
+  while (DictIter != NULL)
+   {
+    if (StrWildcardTest(filename, DictIter->key)) return NULL;
+    DictIter = DictIterate(DictIter, NULL, NULL);
+   }
+
+  // Check that expressions are cacheable, and work out how long the key needs to be
+  len = 256 + ((SelectCriterion!=NULL) ? strlen(SelectCriterion) : 0) + ((SortBy!=NULL) ? strlen(SortBy) : 0) + ((BinaryFormat!=NULL) ? strlen(BinaryFormat) : 0);
+  if ((SelectCriterion!=NULL) && (!DataFile_CacheableExpression(SelectCriterion))) return NULL;
+  if ((SortBy!=NULL) && (strcmp(SortBy,"@")!=0) && (!DataFile_CacheableExpression(SortBy))) return NULL;
+  listiter = ListIterateInit(UsingList);
+  while (listiter != NULL)
+   {
+    tempdict = (Dict *)listiter->data;
+    DictLookup(tempdict,"using_item",NULL,(void *)&item);
+    if (item != NULL)
+     {
+      if (!DataFile_CacheableExpression(item)) return NULL;
+      len += strlen(item);
+     }
+    len += 2;
+    listiter = ListIterate(listiter, NULL);
+   }
+  listiter = ListIterateInit(EveryList);
+  while (listiter != NULL) { len += 16; listiter = ListIterate(listiter, NULL); }
+
+  // Compose key. Settings which change how using expressions are evaluated are included.
+  if ((key = (char *)malloc(len))==NULL) return NULL;
+  sprintf(key, "%d:%d:%d:%d:%d:%d:%d:%d:%d:%d:%d:%d", index, UsingRowCol, (int)AutoUsingList, Ncolumns, continuity, SortByContinuity,
+          settings_term_current.ComplexNumbers, settings_term_current.ExplicitErrors, settings_term_current.UnitAngleDimless,
+          settings_term_current.CalendarIn, settings_term_current.CalendarOut, (int)(SelectCriterion!=NULL));
+  i = strlen(key);
+  listiter = ListIterateInit(EveryList);
+  while (listiter != NULL)
+   {
+    tempdict = (Dict *)listiter->data;
+    DictLookup(tempdict,"every_item",NULL,(void *)&intptr);
+    sprintf(key+i, "\x01%d", (intptr==NULL) ? -1 : *intptr); i += strlen(key+i);
+    listiter = ListIterate(listiter, NULL);
+   }
+  listiter = ListIterateInit(UsingList);
+  while (listiter != NULL)
+   {
+    tempdict = (Dict *)listiter->data;
+    DictLookup(tempdict,"using_item",NULL,(void *)&item);
+    sprintf(key+i, "\x02%s", (item==NULL) ? "" : item); i += strlen(key+i);
+    listiter = ListIterate(listiter, NULL);
+   }
+  sprintf(key+i, "\x03%s\x03%s", (SelectCriterion==NULL) ? "" : SelectCriterion, (SortBy==NULL) ? "" : SortBy); i += strlen(key+i);
+  if (BinaryFormat != NULL) sprintf(key+i, "\x04%s", BinaryFormat);
+  return key;
+ }
+
+static DataCacheEntry *DataFile_CacheFetch(char *key, struct stat *st)
+ {
+  DataCacheEntry *c, *next;
+
+  for (c=DataCache_first; c!=NULL; c=next)
+   {
+    next = c->next;
+    if ((c->dev != st->st_dev) || (c->ino != st->st_ino)) continue;
+    if ((c->size != st->st_size) || (c->mtime != st->st_mtime) || (c->ctime != st->st_ctime)) { DataFile_CacheRemove(c); continue; } // File has changed
+    if (strcmp(c->key, key)!=0) continue;
+
+    // Move entry to the front of the list
+    if (c->prev != NULL)
+     {
+      c->prev->next = c->next;
+      if (c->next != NULL) c->next->prev = c->prev; else DataCache_last = c->prev;
+      c->prev = NULL;
+      c->next = DataCache_first;
+      DataCache_first->prev = c;
+      DataCache_first = c;
+     }
+    return c;
+   }
+  return NULL;
+ }
+
+// Returns 1 if a table contains only numeric data, without text labels or string-valued columns, and so can be cached
+static int DataFile_CacheableTable(DataTable *in)
+ {
+  DataBlock *blk;
+  long int   j;
+  int        i;
+
+  for (i=0; i<in->Ncolumns; i++) if (in->FirstEntries[i].string != NULL) return 0;
+  for (blk=in->first; blk!=NULL; blk=blk->next)
+   for (j=0; j<blk->BlockPosition; j++)
+    if (blk->text[j] != NULL) return 0;
+  return 1;
+ }
+
+// Make a copy of a cached table in the memory context MemoryContext, with all of its rows in a single block
+static DataTable *DataFile_CacheCopy(DataCacheEntry *c, int MemoryContext)
+ {
+  DataTable *output;
+  long int   j;
+
+  output = DataFile_NewDataTable(c->Ncolumns, MemoryContext, c->Nrows+1);
+  if (output==NULL) return NULL;
+  memcpy(output->FirstEntries   , c->FirstEntries, c->Ncolumns            * sizeof(value      ));
+  memcpy(output->first->data_real, c->data       , c->Ncolumns * c->Nrows * sizeof(UnionDblStr));
+  memcpy(output->first->FileLine , c->FileLine   , c->Ncolumns * c->Nrows * sizeof(long int   ));
+  memcpy(output->first->split    , c->split      ,               c->Nrows * sizeof(unsigned char));
+  for (j=0; j<=c->Nrows; j++) output->first->text[j] = NULL;
+  output->Nrows                = c->Nrows;
+  output->first->BlockPosition = c->Nrows;
+  return output;
+ }
+
+// Store a copy of a table which has just been read from a datafile. key is freed, or is kept by the cache.
+static void DataFile_CacheStore(char *key, struct stat *st, DataTable *in)
+ {
+  DataCacheEntry *c;
+  DataBlock      *blk;
+  long int        j, k, bytes;
+  int             Nc = in->Ncolumns;
+
+  bytes = sizeof(DataCacheEntry) + strlen(key) + 1 + Nc*sizeof(value) + in->Nrows * (Nc*(sizeof(UnionDblStr)+sizeof(long int)) + 1);
+  if (bytes > (long int)(settings_term_current.DataCache * 1048576)) { free(key); return; }
+
+  if ((c = (DataCacheEntry *)malloc(sizeof(DataCacheEntry)))==NULL) { free(key); return; }
+  c->key          = key;
+  c->dev          = st->st_dev;
+  c->ino          = st->st_ino;
+  c->size         = st->st_size;
+  c->mtime        = st->st_mtime;
+  c->ctime        = st->st_ctime;
+  c->Ncolumns     = Nc;
+  c->Nrows        = in->Nrows;
+  c->bytes        = bytes;
+  c->FirstEntries = (value         *)malloc(Nc * sizeof(value));
+  c->data         = (UnionDblStr   *)malloc(Nc * in->Nrows * sizeof(UnionDblStr) + 1);
+  c->FileLine     = (long int      *)malloc(Nc * in->Nrows * sizeof(long int) + 1);
+  c->split        = (unsigned char *)malloc(     in->Nrows + 1);
+  if ((c->FirstEntries==NULL)||(c->data==NULL)||(c->FileLine==NULL)||(c->split==NULL))
+   { free(c->FirstEntries); free(c->data); free(c->FileLine); free(c->split); free(c); free(key); return; }
+
+  memcpy(c->FirstEntries, in->FirstEntries, Nc * sizeof(value));
+  for (k=0, blk=in->first; blk!=NULL; blk=blk->next)
+   for (j=0; (j<blk->BlockPosition) && (k<in->Nrows); j++, k++)
+    {
+     memcpy(c->data     + k*Nc, blk->data_real + j*Nc, Nc * sizeof(UnionDblStr));
+     memcpy(c->FileLine + k*Nc, blk->FileLine  + j*Nc, Nc * sizeof(long int   ));
+     c->split[k] = blk->split[j];
+    }
+  c->Nrows = k;
+
+  c->prev = NULL;
+  c->next = DataCache_first;
+  if (DataCache_first != NULL) DataCache_first->prev = c; else DataCache_last = c;
+  DataCache_first = c;
+  DataCache_N++;
+  DataCache_bytes += bytes;
+  DataFile_CacheTrim();
+  return;
+ }
+
+// ------------------------------------------------------------------------------------------------------------------------------------
+// Sidecar files. If "set datacache directory" has been used, tables are also written to binary files in that directory, so that other
+// PyXPlot processes can read them back without parsing the original datafile. The arrays are stored in the same order as within a
+// DataBlock, so that each can be copied straight out of the memory-mapped file. Sidecars are only valid on the machine which wrote them.
+// ------------------------------------------------------------------------------------------------------------------------------------
+
+#define DATAFILE_SIDECAR_MAGIC "PyXPlotDataCache"
+
+typedef struct DataSidecarHeader {
+  char      magic[16];
+  int       SizeOfValue, SizeOfLong, KeyLength, Ncolumns;
+  long long dev, ino, size, mtime, ctime, Nrows;
+ } DataSidecarHeader;
+
+// Work out the filename of the sidecar for a particular file and key. Returns nonzero if the name does not fit in FNAME_LENGTH.
+static int DataFile_SidecarName(char *out, char *key, struct stat *st)
+ {
+  unsigned long long hash = 5381;
+  char *p;
+  int   len;
+
+  for (p=key; *p!='\0'; p++) hash = hash*33 + (unsigned char)*p;
+  len = snprintf(out, FNAME_LENGTH, "%s%s%016llx%016llx.ppldc", settings_term_current.DataCacheDir, PATHLINK, (unsigned long long)st->st_ino ^ ((unsigned long long)st->st_dev << 40), hash);
+  if ((len < 0) || (len >= FNAME_LENGTH)) { if (DEBUG) ppl_log("Datafile sidecar name is too long; not using a sidecar."); return 1; }
+  return 0;
+ }
+
+static void DataFile_SidecarHeader(DataSidecarHeader *h, char *key, struct stat *st, int Ncolumns, long int Nrows)
+ {
+  memset(h, 0, sizeof(DataSidecarHeader));
+  memcpy(h->magic, DATAFILE_SIDECAR_MAGIC, 16);
+  h->SizeOfValue = sizeof(value);
+  h->SizeOfLong  = sizeof(long int);
+  h->KeyLength   = strlen(key);
+  h->Ncolumns    = Ncolumns;
+  h->dev         = st->st_dev;
+  h->ino         = st->st_ino;
+  h->size        = st->st_size;
+  h->mtime       = st->st_mtime;
+  h->ctime       = st->st_ctime;
+  h->Nrows       = Nrows;
+  return;
+ }
+
+// Read a table from a sidecar file into the memory context MemoryContext, if a valid sidecar exists. The sidecar is read
+// through stdio, rather than being mapped, so that one truncated by another process whilst we read it cannot raise SIGBUS.
+static DataTable *DataFile_SidecarLoad(char *key, struct stat *st, int MemoryContext)
+ {
+  DataSidecarHeader h, hf;
+  DataTable        *output = NULL;
+  FILE             *f;
+  struct stat       sst;
+  char              fname[FNAME_LENGTH], *KeyCopy;
+  long int          j, Nrows;
+  int               Nc, fail;
+
+  if (settings_term_current.DataCacheDir[0]=='\0') return NULL;
+  if (DataFile_SidecarName(fname, key, st)) return NULL;
+  if ((f=fopen(fname, "r"))==NULL) return NULL;
+  if ((fstat(fileno(f), &sst)!=0) || (fread(&hf, sizeof(DataSidecarHeader), 1, f)!=1)) { fclose(f); return NULL; }
+
+  // Check that the sidecar describes this version of the file, read with the same clauses
+  Nrows = hf.Nrows;
+  Nc    = hf.Ncolumns;
+  DataFile_SidecarHeader(&h, key, st, Nc, Nrows);
+  if ((memcmp(&h, &hf, sizeof(DataSidecarHeader))!=0) || (Nc<1) || (Nc>MAX_DATACOLS) || (Nrows<0) ||
+      (sst.st_size != (off_t)(sizeof(DataSidecarHeader) + h.KeyLength + Nc*sizeof(value) + Nrows*(Nc*(sizeof(UnionDblStr)+sizeof(long int))+1))))
+   { fclose(f); return NULL; }
+  if ((KeyCopy = (char *)malloc(h.KeyLength+1))==NULL) { fclose(f); return NULL; }
+  fail = (fread(KeyCopy, 1, h.KeyLength, f)!=(size_t)h.KeyLength) || (memcmp(KeyCopy, key, h.KeyLength)!=0);
+  free(KeyCopy);
+  if (fail) { fclose(f); return NULL; }
+
+  output = DataFile_NewDataTable(Nc, MemoryContext, Nrows+1);
+  if (output != NULL)
+   {
+    fail = (fread(output->FirstEntries    , sizeof(value        ), Nc        , f) != (size_t)Nc        ) ||
+           (fread(output->first->data_real, sizeof(UnionDblStr  ), Nc * Nrows, f) != (size_t)(Nc*Nrows)) ||
+           (fread(output->first->FileLine , sizeof(long int     ), Nc * Nrows, f) != (size_t)(Nc*Nrows)) ||
+           (fread(output->first->split    , sizeof(unsigned char),      Nrows, f) != (size_t)Nrows     );
+    if (fail) { fclose(f); return NULL; } // File has been truncated since we checked its size. The table is freed with its memory context.
+    for (j=0; j<Nc; j++) output->FirstEntries[j].string = NULL;
+    for (j=0; j<=Nrows; j++) output->first->text[j] = NULL;
+    output->Nrows                = Nrows;
+    output->first->BlockPosition = Nrows;
+   }
+  fclose(f);
+  return output;
+ }
+
+// Write a table to a sidecar file. It is written under a temporary name and then renamed, so that other processes never see half of it.
+static void DataFile_SidecarWrite(char *key, struct stat *st, DataTable *in)
+ {
+  DataSidecarHeader h;
+  DataBlock        *blk;
+  FILE             *f;
+  char              fname[FNAME_LENGTH], tmpname[FNAME_LENGTH+32];
+  value             v;
+  long int          Nrows=0;
+  int               i, fail=0;
+
+  if (settings_term_current.DataCacheDir[0]=='\0') return;
+  for (blk=in->first; blk!=NULL; blk=blk->next) Nrows += blk->BlockPosition;
+  if (DataFile_SidecarName(fname, key, st)) return;
+  sprintf(tmpname, "%s.%d", fname, getpid());
+  if ((f=fopen(tmpname, "w"))==NULL) { if (DEBUG) { sprintf(temp_err_string, "Could not write datafile sidecar '%s'.", tmpname); ppl_log(temp_err_string); } return; }
+
+  DataFile_SidecarHeader(&h, key, st, in->Ncolumns, Nrows);
+  fail |= (fwrite(&h , sizeof(DataSidecarHeader), 1, f) != 1);
+  fail |= (fwrite(key, 1, h.KeyLength, f) != h.KeyLength);
+  for (i=0; i<in->Ncolumns; i++) { v = in->FirstEntries[i]; v.string = NULL; fail |= (fwrite(&v, sizeof(value), 1, f) != 1); }
+  for (blk=in->first; blk!=NULL; blk=blk->next) fail |= (fwrite(blk->data_real, sizeof(UnionDblStr), in->Ncolumns*blk->BlockPosition, f) != in->Ncolumns*blk->BlockPosition);
+  for (blk=in->first; blk!=NULL; blk=blk->next) fail |= (fwrite(blk->FileLine , sizeof(long int   ), in->Ncolumns*blk->BlockPosition, f) != in->Ncolumns*blk->BlockPosition);
+  for (blk=in->first; blk!=NULL; blk=blk->next) fail |= (fwrite(blk->split    , 1                  ,              blk->BlockPosition, f) !=              blk->BlockPosition);
+  fail |= (fclose(f) != 0);
+
+  if (fail || (rename(tmpname, fname)!=0)) { remove(tmpname); if (DEBUG) { sprintf(temp_err_string, "Could not write datafile sidecar '%s'.", fname); ppl_log(temp_err_string); } }
+  return;
+ }
+
+// ------------------------------------------------------------------------------------------------------------------------------------
+// Reading ahead. Before the panels of a multiplot read their data, DataFile_ReadAheadRequest() is called for each datafile which they
+// are going to read, and DataFile_ReadAheadRun() then reads these files into tables in worker threads. Each thread reads all of the
+// files requested by one group of panels, in the order in which they were requested. When DataFile_read() later comes to each file, it
+// copies the table which was read ahead. Only plain columns of numbers are read ahead, since these can be read without evaluating any
+// expressions or reporting any errors. If a worker thread finds anything else in a file, for example a ColumnUnits comment or a line
+// which does not contain the requested columns, it gives up on that file, which is then read by DataFile_read() in the usual way.
+// ------------------------------------------------------------------------------------------------------------------------------------
+
+typedef struct DataReadAhead {
+  DataCacheEntry table; // The table read by the worker thread, which is stored in the same way as in the cache of datafiles
+  unsigned char  ok; // Set by the worker thread if it read the whole file
+  char          *filename;
+  int            group, index, Ncolumns, UsingLen, UsingColumns[USING_ITEMS_MAX];
+  int            linestep, blockstep, linefirst, blockfirst, linelast, blocklast;
+  unsigned char  AutoUsingList;
+  struct DataReadAhead *next;
+ } DataReadAhead;
+
+typedef struct DataReadAheadGroup {
+  int      group;
+  long int bytes;
+ } DataReadAheadGroup;
+
+typedef struct DataReadAheadJob {
+  int                 Ngroups;
+  DataReadAheadGroup *groups; // Largest first
+ } DataReadAheadJob;
+
+static DataReadAhead *DataReadAhead_first = NULL;
+static DataReadAhead *DataReadAhead_last  = NULL;
+
+// Request that a datafile be read ahead by a worker thread. The arguments are those which will later be passed to DataFile_read().
+// Files which cannot be read ahead are instead prefetched into the kernel's page cache.
+void DataFile_ReadAheadRequest(char *filename, char *BinaryFormat, int index, int UsingRowCol, List *UsingList, unsigned char AutoUsingList, List *EveryList, char *LabelStr, int Ncolumns, char *SelectCriterion, int continuity, char *SortBy, int SortByContinuity, int group)
+ {
+  DataReadAhead *r;
+  struct stat    st;
+  char          *key, *UsingItems[USING_ITEMS_MAX], fname[FNAME_LENGTH], errtext[LSTR_LENGTH];
+  int            UsingColumns[USING_ITEMS_MAX], UsingLen, every[6], i;
+  unsigned char  AutoUsing = AutoUsingList;
+
+  if ((BinaryFormat != NULL) || (UsingRowCol != DATAFILE_COL) || (LabelStr != NULL) || (SelectCriterion != NULL) || ((SortBy != NULL) && (strcmp(SortBy,"@")!=0))) { DataFile_Prefetch(filename); return; }
+#ifdef HAVE_FITSIO
+  if (DataFile_FitsFilter(filename)) return;
+#endif
+
+  // Work out the using and every lists in the same way as DataFile_ReadFile(). This is done before the key is made, since the using
+  // items are stripped of whitespace in the process.
+  if (DataFile_UsingItems(UsingList, UsingItems, &UsingLen, &AutoUsing, Ncolumns, errtext) || (UsingLen != Ncolumns) || (UsingLen >= USING_ITEMS_MAX)) return;
+  if (DataFile_EveryItems(EveryList, every, every+1, every+2, every+3, every+4, every+5, errtext)) return;
+  if (SortBy != NULL) UsingItems[UsingLen++] = UsingItems[0];
+  if (!DataFile_UsingColumnList(UsingItems, UsingLen, UsingColumns)) { DataFile_Prefetch(filename); return; }
+
+  // Files which are read through input filters have no key
+  key = DataFile_CacheKey(filename, BinaryFormat, &st, index, UsingRowCol, UsingList, AutoUsingList, EveryList, LabelStr, Ncolumns, SelectCriterion, continuity, SortBy, SortByContinuity);
+  if (key == NULL) { DataFile_Prefetch(filename); return; }
+
+  // Files which are already in the cache, or in a sidecar file, or which have already been requested, need not be read ahead
+  if ((settings_term_current.DataCache > 0) && (DataFile_CacheFetch(key, &st) != NULL)) { free(key); return; }
+  if ((settings_term_current.DataCacheDir[0]!='\0') && (!DataFile_SidecarName(fname, key, &st)) && (access(fname, R_OK)==0)) { free(key); return; }
+  for (r=DataReadAhead_first; r!=NULL; r=r->next)
+   if ((r->table.dev == st.st_dev) && (r->table.ino == st.st_ino) && (strcmp(r->table.key, key)==0)) { free(key); return; }
+
+  if ((r = (DataReadAhead *)malloc(sizeof(DataReadAhead)))==NULL) { free(key); return; }
+  memset(r, 0, sizeof(DataReadAhead));
+  r->table.key          = key;
+  r->table.dev          = st.st_dev;
+  r->table.ino          = st.st_ino;
+  r->table.size         = st.st_size;
+  r->table.mtime        = st.st_mtime;
+  r->table.ctime        = st.st_ctime;
+  r->table.Ncolumns     = UsingLen;
+  r->table.FirstEntries = (value *)malloc(UsingLen * sizeof(value));
+  r->filename           = (char  *)malloc(strlen(filename)+1);
+  if ((r->table.FirstEntries==NULL) || (r->filename==NULL)) { free(r->table.FirstEntries); free(r->filename); free(r); free(key); return; }
+  for (i=0; i<UsingLen; i++) ppl_units_zero(r->table.FirstEntries+i);
+  strcpy(r->filename, filename);
+  r->group         = group;
+  r->index         = index;
+  r->Ncolumns      = Ncolumns;
+  r->UsingLen      = UsingLen;
+  r->AutoUsingList = AutoUsing;
+  memcpy(r->UsingColumns, UsingColumns, UsingLen*sizeof(int));
+  r->linestep      = every[0];
+  r->blockstep     = every[1];
+  r->linefirst     = every[2];
+  r->blockfirst    = every[3];
+  r->linelast      = every[4];
+  r->blocklast     = every[5];
+
+  if (DataReadAhead_last != NULL) DataReadAhead_last->next = r; else DataReadAhead_first = r;
+  DataReadAhead_last = r;
+  if (DEBUG) { sprintf(temp_err_string, "Datafile '%s' will be read ahead in group %d.", filename, group); ppl_log(temp_err_string); }
+  return;
+ }
+
+// Read a datafile into r->table. This is run in a worker thread, and so touches no global state. The lines of the file are stepped
+// through in the same way as in DataFile_ReadFile(), so that the table is identical to the one which that would have produced.
+static void DataFile_ReadAheadFile(DataReadAhead *r)
+ {
+  DataCacheEntry *t = &r->table;
+  DataFileReader  reader;
+  FILE           *f;
+  struct stat     st;
+  char           *linebuffer, *ColumnData[MAX_DATACOLS];
+  double          data[USING_ITEMS_MAX];
+  unsigned char   discontinuity=0, OneColumnInput=(r->Ncolumns==2), fail=0;
+  long int        index_number=0, linenumber_count=0, linenumber_stepcnt=0, block_count=0, block_stepcnt=0, prev_blanklines=10, file_linenumber=0, Nalloc=1024;
+  int             i, j, ItemsOnLine, Nc=r->UsingLen;
+  void           *tmp;
+
+  if ((f = fopen(r->filename, "r"))==NULL) return;
+  if ((fstat(fileno(f), &st)!=0) || (st.st_dev != t->dev) || (st.st_ino != t->ino) || (st.st_size != t->size) || (st.st_mtime != t->mtime) || (st.st_ctime != t->ctime)) { fclose(f); return; } // File has changed since it was requested
+  DataFile_ReaderMap(&reader, f);
+  reader.buffer = (char *)malloc(LSTR_LENGTH);
+  t->data       = (UnionDblStr   *)malloc(Nalloc * Nc * sizeof(UnionDblStr));
+  t->FileLine   = (long int      *)malloc(Nalloc * Nc * sizeof(long int));
+  t->split      = (unsigned char *)malloc(Nalloc);
+  fail = (reader.map==NULL) || (reader.buffer==NULL) || (t->data==NULL) || (t->FileLine==NULL) || (t->split==NULL);
+
+  while (!fail)
+   {
+    linebuffer = DataFile_ReadLine(&reader);
+    if (linebuffer==NULL) break; // End of file reached
+    file_linenumber++;
+
+    for (j=0; ((linebuffer[j]!='\0')&&(linebuffer[j]<=' ')); j++);
+    if (linebuffer[j]=='\0') // We have a blank line
+     {
+      if (prev_blanklines>1) continue;
+      prev_blanklines++;
+      if (prev_blanklines==1)
+       {
+        block_count++;
+        block_stepcnt = ((block_stepcnt-1) % r->blockstep);
+        discontinuity=1;
+        linenumber_count=0;
+        linenumber_stepcnt=0;
+       } else {
+        index_number++;
+        block_count=0;
+        block_stepcnt=0;
+        if ((r->index>=0) && (index_number>r->index)) break;
+       }
+      continue;
+     }
+
+    // Units are evaluated by the main thread
+    if (linebuffer[j]=='#')
+     {
+      for (i=j+1; ((linebuffer[i]!='\0')&&(linebuffer[i]<=' ')); i++);
+      if ((strncmp(linebuffer+i, "ColumnUnits:", 12)==0) || (strncmp(linebuffer+i, "RowUnits:", 9)==0)) fail=1;
+      continue;
+     }
+    prev_blanklines=0;
+
+    if ((r->index>=0) && (index_number != r->index)) continue;
+    if ((block_stepcnt!=0) || ((r->blockfirst>=0)&&(block_count<r->blockfirst)) || ((r->blocklast>=0)&&(block_count>r->blocklast))) continue;
+
+    if ((linenumber_stepcnt==0) && ((r->linefirst<0)||(linenumber_count>=r->linefirst)) && ((r->linelast<0)||(linenumber_count<=r->linelast)))
+     {
+      ItemsOnLine = DataFile_SplitLine(linebuffer, ColumnData);
+      if  (ItemsOnLine >  1) OneColumnInput=0;
+      if ((ItemsOnLine == 1) && r->AutoUsingList && OneColumnInput) { fail=1; break; } // Line numbers are added to one-column files by the main thread
+      if (DataFile_ParseColumnList(ColumnData, ItemsOnLine, r->UsingColumns, Nc, data)) { fail=1; break; } // Errors are reported by the main thread
+
+      if (t->Nrows >= Nalloc)
+       {
+        Nalloc *= 2;
+        if ((tmp = realloc(t->data    , Nalloc * Nc * sizeof(UnionDblStr)))==NULL) { fail=1; break; }
+        t->data     = (UnionDblStr   *)tmp;
+        if ((tmp = realloc(t->FileLine, Nalloc * Nc * sizeof(long int   )))==NULL) { fail=1; break; }
+        t->FileLine = (long int      *)tmp;
+        if ((tmp = realloc(t->split   , Nalloc                          ))==NULL) { fail=1; break; }
+        t->split    = (unsigned char *)tmp;
+       }
+      for (i=0; i<Nc; i++)
+       {
+        t->data    [i + t->Nrows*Nc].d = data[i];
+        t->FileLine[i + t->Nrows*Nc]   = file_linenumber;
+        if (t->Nrows==0) t->FirstEntries[i].real = data[i];
+       }
+      t->split[t->Nrows++] = discontinuity;
+      discontinuity=0;
+     }
+    linenumber_count++;
+    linenumber_stepcnt = ((linenumber_stepcnt-1) % r->linestep);
+   }
+
+  DataFile_ReaderClose(&reader);
+  fclose(f);
+  free(reader.buffer);
+  if (fail) { free(t->data); free(t->FileLine); free(t->split); t->data=NULL; t->FileLine=NULL; t->split=NULL; t->Nrows=0; return; }
+  r->ok = 1;
+  return;
+ }
+
+static void DataFile_ReadAheadWorker(void *job_void, int ThreadNo, int NThreads)
+ {
+  DataReadAheadJob *job = (DataReadAheadJob *)job_void;
+  DataReadAhead    *r;
+  int               g;
+
+  for (g=ThreadNo; g<job->Ngroups; g+=NThreads)
+   for (r=DataReadAhead_first; r!=NULL; r=r->next)
+    if (r->group == job->groups[g].group) DataFile_ReadAheadFile(r);
+  return;
+ }
+
+static int DataFile_ReadAheadGroupCompare(const void *xv, const void *yv)
+ {
+  const DataReadAheadGroup *x = (const DataReadAheadGroup *)xv;
+  const DataReadAheadGroup *y = (const DataReadAheadGroup *)yv;
+
+  if      (x->bytes > y->bytes) return -1;
+  else if (x->bytes < y->bytes) return  1;
+  else                          return x->group - y->group;
+ }
+
+// Read all of the files which have been requested, with the groups which have the most data to read given out first
+void DataFile_ReadAheadRun()
+ {
+  DataReadAheadJob job;
+  DataReadAhead   *r;
+  int              i, N=0, NThreads;
+
+  for (r=DataReadAhead_first; r!=NULL; r=r->next) N++;
+  if (N < 2) { DataFile_ReadAheadClear(); return; }
+  if ((job.groups = (DataReadAheadGroup *)malloc(N * sizeof(DataReadAheadGroup)))==NULL) { DataFile_ReadAheadClear(); return; }
+  job.Ngroups = 0;
+  for (r=DataReadAhead_first; r!=NULL; r=r->next)
+   {
+    for (i=0; (i<job.Ngroups) && (job.groups[i].group != r->group); i++);
+    if (i==job.Ngroups) { job.groups[i].group = r->group; job.groups[i].bytes = 0; job.Ngroups++; }
+    job.groups[i].bytes += r->table.size;
+   }
+
+  // If there is only one group of panels, or only one thread, nothing would be gained by reading ahead
+  NThreads = ppl_threads_count();
+  if (NThreads > job.Ngroups) NThreads = job.Ngroups;
+  if (NThreads < 2)
+   {
+    for (r=DataReadAhead_first; r!=NULL; r=r->next) DataFile_Prefetch(r->filename);
+    free(job.groups);
+    DataFile_ReadAheadClear();
+    return;
+   }
+
+  qsort((void *)job.groups, job.Ngroups, sizeof(DataReadAheadGroup), DataFile_ReadAheadGroupCompare);
+  if (DEBUG) { sprintf(temp_err_string, "Reading ahead %d datafiles in %d groups using %d threads.", N, job.Ngroups, NThreads); ppl_log(temp_err_string); }
+  ppl_threads_run(&DataFile_ReadAheadWorker, (void *)&job, NThreads);
+  free(job.groups);
+
+  if (DEBUG)
+   for (r=DataReadAhead_first; r!=NULL; r=r->next)
+    {
+     if (r->ok) sprintf(temp_err_string, "Read ahead %ld rows of datafile '%s'.", r->table.Nrows, r->filename);
+     else       sprintf(temp_err_string, "Could not read ahead datafile '%s'; it will be read in the usual way.", r->filename);
+     ppl_log(temp_err_string);
+    }
+  return;
+ }
+
+// Returns the table which was read ahead for a datafile, if there is one
+static DataReadAhead *DataFile_ReadAheadFetch(char *key, struct stat *st)
+ {
+  DataReadAhead *r;
+
+  for (r=DataReadAhead_first; r!=NULL; r=r->next)
+   {
+    if ((!r->ok) || (r->table.dev != st->st_dev) || (r->table.ino != st->st_ino)) continue;
+    if ((r->table.size != st->st_size) || (r->table.mtime != st->st_mtime) || (r->table.ctime != st->st_ctime)) continue; // File has changed
+    if (strcmp(r->table.key, key)==0) return r;
+   }
+  return NULL;
+ }
+
+// Make a copy of a table which was read ahead in the memory context MemoryContext. If a sort column was read, the table is then sorted.
+static DataTable *DataFile_ReadAheadCopy(DataReadAhead *r, int MemoryContext, char *SortBy, int SortByContinuity)
+ {
+  DataTable *output;
+  int        ContextRough;
+
+  output = DataFile_CacheCopy(&r->table, MemoryContext);
+  if ((output == NULL) || (SortBy == NULL)) return output;
+  ContextRough = lt_DescendIntoNewContext();
+  output = DataTable_sort(output, r->table.Ncolumns-1, SortByContinuity==DATAFILE_CONTINUOUS);
+  lt_AscendOutOfContext(ContextRough);
+  return output;
+ }
+
+void DataFile_ReadAheadClear()
+ {
+  DataReadAhead *r, *next;
+
+  for (r=DataReadAhead_first; r!=NULL; r=next)
+   {
+    next = r->next;
+    free(r->table.key); free(r->table.FirstEntries); free(r->table.data); free(r->table.FileLine); free(r->table.split); free(r->filename); free(r);
+   }
+  DataReadAhead_first = DataReadAhead_last = NULL;
+  return;
+ }
+
+// ----------------------------------------------------------------------------------
+// DataFile_read is the main entry point for reading a table of data from a data file
+// ----------------------------------------------------------------------------------
+
+void DataFile_read(DataTable **output, int *status, char *errout, char *filename, char *BinaryFormat, int index, int UsingRowCol, List *UsingList, unsigned char AutoUsingList, List *EveryList, char *LabelStr, int Ncolumns, char *SelectCriterion, int continuity, char *SortBy, int SortByContinuity, unsigned char persistent, int *ErrCounter)
+ {
+  DataCacheEntry *c;
+  DataReadAhead  *r = NULL;
+  struct stat     st;
+  char           *key = NULL;
+  int             ErrCount = *ErrCounter;
+  unsigned char   caching = (settings_term_current.DataCache > 0) || (settings_term_current.DataCacheDir[0]!='\0');
+
+  if (caching || (DataReadAhead_first != NULL)) key = DataFile_CacheKey(filename, BinaryFormat, &st, index, UsingRowCol, UsingList, AutoUsingList, EveryList, LabelStr, Ncolumns, SelectCriterion, continuity, SortBy, SortByContinuity);
+  if (key != NULL) r = DataFile_ReadAheadFetch(key, &st);
+
+  if (r != NULL) // The file has been read ahead by a worker thread
+   {
+    *output = DataFile_ReadAheadCopy(r, persistent ? 0 : lt_GetMemContext(), SortBy, SortByContinuity);
+    if (*output == NULL) { strcpy(errout, "Out of memory whilst trying to allocate data table to read data from file."); *status=1; if (DEBUG) ppl_log(errout); free(key); return; }
+    if (DEBUG) { sprintf(temp_err_string, "Using copy of datafile '%s' which was read ahead.", filename); ppl_log(temp_err_string); }
+   }
+  else
+   {
+    if ((key != NULL) && caching)
+     {
+      if ((c = DataFile_CacheFetch(key, &st)) != NULL) *output = DataFile_CacheCopy(c, persistent ? 0 : lt_GetMemContext());
+      else                                              *output = DataFile_SidecarLoad(key, &st, persistent ? 0 : lt_GetMemContext());
+      if (*output != NULL)
+       {
+        if (DEBUG) { sprintf(temp_err_string, "Using cached copy of datafile '%s'.", filename); ppl_log(temp_err_string); }
+        DataCache_hits++;
+        if (c == NULL) DataFile_CacheStore(key, &st, *output); // Table came from a sidecar file; keep it in memory too
+        else           free(key);
+        return;
+       }
+      DataCache_misses++;
+     }
+
+    DataFile_ReadFile(output, status, errout, filename, BinaryFormat, index, UsingRowCol, UsingList, AutoUsingList, EveryList, LabelStr, Ncolumns, SelectCriterion, continuity, SortBy, SortByContinuity, persistent, ErrCounter);
+   }
+
+  // Tables which produced warnings are not cached, since the warnings would not be repeated when the cached copy was used.
+  // Nor are files which were modified too recently for a later change to be sure to alter their modification times.
+  if (key == NULL) return;
+  if (caching && (*status == 0) && (*output != NULL) && (ErrCount > 0) && (*ErrCounter == ErrCount) && (st.st_mtime < time(NULL)-1) && DataFile_CacheableTable(*output))
+   {
+    DataFile_SidecarWrite(key, &st, *output);
+    DataFile_CacheStore(key, &st, *output);
+   }
+  else free(key);
+  return;
+ }
+
+// ------------------------------------------------------------------------------------------------
+// DataFile_Prefetch() asks the kernel to start reading a datafile into memory, in the background
+// ------------------------------------------------------------------------------------------------
+
+void DataFile_Prefetch(char *filename)
+ {
+#ifdef POSIX_FADV_WILLNEED
+  struct stat st;
+  int         fd;
+
+  if ((filename==NULL) || (filename[0]=='\0') || (strcmp(filename,"-")==0) || (strcmp(filename,"--")==0)) return;
+  if ((fd = open(filename, O_RDONLY)) < 0) return; // Any error will be reported when the file is read in earnest
+  if ((fstat(fd, &st)==0) && S_ISREG(st.st_mode)) posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+  close(fd);
+#endif
+  return;
+ }
+
 // -------------------------------------------------------------------------------------
 // DataFile_FromFunctions() tabulates data evaluated from a set of algebraic expressions
 // -------------------------------------------------------------------------------------
 
+// Each function is compiled once, with its dummy variables bound as arguments. When many samples are to be taken, and the compiled
+// functions are thread safe, worker threads evaluate them ahead of the main loop, each using its own compiled copies. The main loop then
+// picks up every result which was a real number with the same units as the first result found by the same thread. Any other samples are
+// evaluated again by the main loop, so that errors, complex numbers and changes of units are reported exactly as they would otherwise be.
+
+typedef struct DataFileSampler {
+  CompiledAlgebra **expr; // NThreads x Nfns compiled copies of the functions
+  int               NThreads, Nfns, NArgs, RasterLen;
+  long int          Npoints;
+  double           *OrdinateRaster, *OrdinateYRaster;
+  value             args[2]; // Values of the dummy variables, carrying their units
+  value            *Tmpl; // NThreads x Nfns: the first result of each function in each thread, whose units the others must match
+  unsigned char    *TmplSet; // NThreads x Nfns
+  double           *result; // Npoints x Nfns
+  unsigned char    *ok; // Npoints x Nfns: set if the main loop may use result
+ } DataFileSampler;
+
+static void DataFile_SampleWorker(void *s_void, int ThreadNo, int NThreads)
+ {
+  DataFileSampler *s = (DataFileSampler *)s_void;
+  value            args[2], out, *tmpl;
+  char             errtext[LSTR_LENGTH];
+  int              j, n, errpos;
+  long int         p, end = s->Npoints*(ThreadNo+1)/NThreads;
+
+  args[0] = s->args[0];
+  args[1] = s->args[1];
+  for (p=s->Npoints*ThreadNo/NThreads; p<end; p++)
+   {
+    args[0].real = s->OrdinateRaster [p % s->RasterLen];
+    if (s->NArgs>1) args[1].real = s->OrdinateYRaster[p / s->RasterLen];
+    for (j=0; j<s->Nfns; j++)
+     {
+      n = ThreadNo*s->Nfns + j;
+      s->ok[p*s->Nfns+j] = 0;
+      ppl_EvaluateCompiled(s->expr[n], args, &out, &errpos, errtext, 0);
+      if ((errpos>=0) || (out.FlagComplex) || (out.string!=NULL)) continue;
+      tmpl = s->Tmpl + n;
+      if (!s->TmplSet[n]) { *tmpl = out; s->TmplSet[n] = 1; }
+      else if ((out.dimensionless!=tmpl->dimensionless) || (out.TempType!=tmpl->TempType) || (memcmp(out.exponent, tmpl->exponent, sizeof(out.exponent))!=0)) continue;
+      s->result[p*s->Nfns+j] = out.real;
+      s->ok    [p*s->Nfns+j] = 1;
+     }
+   }
+  return;
+ }
+
+static void DataFile_SamplerFree(DataFileSampler *s)
+ {
+  int i;
+  for (i=s->Nfns; i<s->NThreads*s->Nfns; i++) ppl_CompiledAlgebraFree(s->expr[i]); // The first thread's copies belong to the caller
+  if (s->expr    != NULL) free(s->expr);
+  if (s->Tmpl    != NULL) free(s->Tmpl);
+  if (s->TmplSet != NULL) free(s->TmplSet);
+  if (s->result  != NULL) free(s->result);
+  if (s->ok      != NULL) free(s->ok);
+  s->ok = NULL;
+  return;
+ }
+
+// Evaluate the compiled functions expr[] at every sample point, using several threads. Returns with s->ok==NULL if this was not possible.
+static void DataFile_SamplerRun(DataFileSampler *s, CompiledAlgebra **expr, char **fnlist, int Nfns, int NArgs, char **ArgNames, double *OrdinateRaster, int RasterLen, double *OrdinateYRaster, int RasterYLen, value *OrdinateVar, value *OrdinateVar2)
+ {
+  char errtext[LSTR_LENGTH];
+  int  i, j, errpos;
+
+  memset(s, 0, sizeof(DataFileSampler));
+  s->Nfns            = Nfns;
+  s->NArgs           = NArgs;
+  s->RasterLen       = RasterLen;
+  s->Npoints         = (long)RasterLen * ((OrdinateYRaster!=NULL) ? RasterYLen : 1);
+  s->OrdinateRaster  = OrdinateRaster;
+  s->OrdinateYRaster = OrdinateYRaster;
+  s->args[0]         = *OrdinateVar;
+  s->args[1]         = (OrdinateVar2!=NULL) ? *OrdinateVar2 : *OrdinateVar;
+
+  s->NThreads = ppl_threads_count();
+  if (s->NThreads > s->Npoints / DATAFILE_SAMPLE_POINTS) s->NThreads = s->Npoints / DATAFILE_SAMPLE_POINTS;
+  if (s->NThreads < 2) return;
+  for (j=0; j<Nfns; j++) if ((expr[j]==NULL) || (!expr[j]->ThreadSafe)) return;
+
+  if ((s->expr = (CompiledAlgebra **)malloc(s->NThreads * Nfns * sizeof(CompiledAlgebra *)))==NULL) return;
+  for (j=0; j<Nfns; j++) s->expr[j] = expr[j];
+  for (i=1; i<s->NThreads; i++) for (j=0; j<Nfns; j++)
+   if ((s->expr[i*Nfns+j] = ppl_CompileAlgebra(fnlist[j], 0, NULL, 0, NArgs, ArgNames, &errpos, errtext, 0))==NULL)
+    {
+     while (j>0) ppl_CompiledAlgebraFree(s->expr[i*Nfns+(--j)]);
+     s->NThreads = i;
+     break;
+    }
+  if (s->NThreads < 2) { DataFile_SamplerFree(s); return; }
+
+  s->Tmpl    = (value *)malloc(s->NThreads * Nfns * sizeof(value));
+  s->TmplSet = (unsigned char *)calloc(s->NThreads * Nfns, 1);
+  s->result  = (double *)malloc(s->Npoints * Nfns * sizeof(double));
+  s->ok      = (unsigned char *)malloc(s->Npoints * Nfns);
+  if ((s->Tmpl==NULL) || (s->TmplSet==NULL) || (s->result==NULL) || (s->ok==NULL)) { DataFile_SamplerFree(s); return; }
+
+  if (DEBUG) { sprintf(temp_err_string, "Evaluating %ld samples of %d functions in %d threads.", s->Npoints, Nfns, s->NThreads); ppl_log(temp_err_string); }
+  ppl_threads_run(&DataFile_SampleWorker, (void *)s, s->NThreads);
+  return;
+ }
+
+// Describe the sample point which an error message refers to
+static void DataFile_SampleName(char *buffer, unsigned char FlagParametric, value *OrdinateVar, value *OrdinateVar2)
+ {
+  if (OrdinateVar2!=NULL) sprintf(buffer, "%c=%s; %c=%s", (FlagParametric?'u':'x'), NumericDisplay(OrdinateVar->real, 0, settings_term_current.SignificantFigures, 0), (FlagParametric?'v':'y'), NumericDisplay(OrdinateVar2->real, 1, settings_term_current.SignificantFigures, 0));
+  else                    sprintf(buffer, "%c=%s", (FlagParametric?'t':'x'), NumericDisplay(OrdinateVar->real, 0, settings_term_current.SignificantFigures, 0));
+  return;
+ }
+
 #define COUNTEDERR2F if (*ErrCounter==0) { sprintf(temp_err_string, "%s: Too many errors: no more errors will be shown.",buffer); ppl_warning(ERR_STACKED, temp_err_string); } }
 
 void DataFile_FromFunctions(double *OrdinateRaster, unsigned char FlagParametric, int RasterLen, value *RasterUnits, double *OrdinateYRaster, int RasterYLen, value *RasterYUnits, DataTable **output, int *status, char *errout, char **fnlist, int fnlist_len, List *UsingList, unsigned char AutoUsingList, char *LabelStr, int Ncolumns, char *SelectCriterion, int continuity, char *SortBy, int SortByContinuity, int *ErrCounter)
  {
-  unsigned char HadNonNullUsingItem=0, discontinuity=0, SampleGrid;
-  int           UsingLen, logi, logj, a, i, j, k, ContextOutput;
-  long          ExpectedNrows;
-  char         *UsingItems[USING_ITEMS_MAX], buffer[FNAME_LENGTH];
-  value         ColumnData_val[USING_ITEMS_MAX+2];
-  ListIterator *listiter;
-  Dict         *tempdict;
-  value        *OrdinateVar , DummyTemp ;
-  value        *OrdinateVar2, DummyTemp2;
+  unsigned char    HadNonNullUsingItem=0, discontinuity=0, SampleGrid, ColumnListOnly;
+  int              UsingLen, UsingColumns[USING_ITEMS_MAX], logi, logj, a, i, j, k, ContextOutput, NArgs, errpos;
+  long             ExpectedNrows;
+  char            *UsingItems[USING_ITEMS_MAX], buffer[FNAME_LENGTH], *ArgNames[2], *cptr;
+  value            ColumnData_val[USING_ITEMS_MAX+2], args[2];
+  CompiledAlgebra *expr[USING_ITEMS_MAX];
+  DataFileSampler  sampler;
+  ListIterator    *listiter;
+  Dict            *tempdict;
+  value           *OrdinateVar , DummyTemp ;
+  value           *OrdinateVar2, DummyTemp2;
 
   // Init
   if (DEBUG) { sprintf(temp_err_string, "Evaluated supplied set of functions."); ppl_log(temp_err_string); }
@@ -1136,31 +2857,83 @@ void DataFile_FromFunctions(double *OrdinateRaster, unsigned char FlagParametric
     (*_OrdinateVar)->FlagComplex = 0;
    }
 
+  // Compile the functions, binding the dummy variables as arguments. Any function which cannot be compiled is left to ppl_EvaluateAlgebra().
+  NArgs = 1 + SampleGrid;
+  if (!SampleGrid) { ArgNames[0] = FlagParametric ? "t" : "x"; }
+  else             { ArgNames[0] = FlagParametric ? "u" : "x"; ArgNames[1] = FlagParametric ? "v" : "y"; }
+  for (j=0; j<fnlist_len; j++)
+   {
+    k=-1;
+    expr[j] = ppl_CompileAlgebra(fnlist[j], 0, &k, 0, NArgs, ArgNames, &errpos, errout, 0);
+    if ((expr[j]!=NULL) && (k<strlen(fnlist[j])))
+     {
+      sprintf(errout, "Expression '%s' is not syntactically valid %d %ld", fnlist[j],k,(long)strlen(fnlist[j])); *status=1; if (DEBUG) ppl_log(errout);
+      for ( ; j>=0; j--) if (expr[j]!=NULL) ppl_CompiledAlgebraFree(expr[j]);
+      ppl_UserSpace_RestoreVarPointer(&OrdinateVar, &DummyTemp);
+      if (OrdinateVar2!=NULL) ppl_UserSpace_RestoreVarPointer(&OrdinateVar2, &DummyTemp2);
+      return;
+     }
+   }
+
+  // See whether every using item is simply a column number, in which case rows can be added with DataFile_ApplyValueList()
+  ColumnListOnly = (LabelStr == NULL) && (SelectCriterion == NULL);
+  for (i=0; (i<UsingLen) && ColumnListOnly; i++)
+   {
+    cptr = UsingItems[i];
+    while ((*cptr!='\0')&&(*cptr<=' ')) cptr++;
+    if (*cptr=='$') cptr++;
+    for (k=0, UsingColumns[i]=0; (*cptr>='0')&&(*cptr<='9')&&(UsingColumns[i]<=MAX_DATACOLS); cptr++, k++) UsingColumns[i] = 10*UsingColumns[i] + (*cptr-'0');
+    while ((*cptr!='\0')&&(*cptr<=' ')) cptr++;
+    if ((*cptr!='\0') || (k==0) || (UsingColumns[i]>MAX_DATACOLS)) ColumnListOnly=0;
+   }
+
+  // If there are many samples to take, evaluate the functions in several threads before entering the main loop
+  DataFile_SamplerRun(&sampler, expr, fnlist, fnlist_len, NArgs, ArgNames, OrdinateRaster, RasterLen, OrdinateYRaster, RasterYLen, OrdinateVar, OrdinateVar2);
+
   // Loop over ordinate values
   {
-   int i, ilen = RasterLen, i2, i2len = SampleGrid ? RasterYLen : 1; long p=0;
+   int i, ilen = RasterLen, i2, i2len = SampleGrid ? RasterYLen : 1, t=0; long p=0;
+   value *out;
    for (i2=0; i2<i2len; i2++,discontinuity=1) for (i=0; i<ilen; i++, p++)
    {
     OrdinateVar->real = OrdinateRaster[i];
     if (SampleGrid) OrdinateVar2->real = OrdinateYRaster[i2];
-    if (SampleGrid) sprintf(buffer, "%c=%s; %c=%s", (FlagParametric?'u':'x'), NumericDisplay(OrdinateVar->real, 0, settings_term_current.SignificantFigures, 0), (FlagParametric?'v':'y'), NumericDisplay(OrdinateVar2->real, 1, settings_term_current.SignificantFigures, 0));
-    else            sprintf(buffer, "%c=%s", (FlagParametric?'t':'x'), NumericDisplay(OrdinateVar->real, 0, settings_term_current.SignificantFigures, 0));
+    args[0] = *OrdinateVar;
+    if (SampleGrid) args[1] = *OrdinateVar2;
+    if (sampler.ok != NULL) while (p >= sampler.Npoints*(t+1)/sampler.NThreads) t++; // Which thread evaluated this sample
     ppl_units_zero(ColumnData_val+0);
     ColumnData_val[0].real = p;
     if  (!FlagParametric)              ColumnData_val[1] = *OrdinateVar;
     if ((!FlagParametric)&&SampleGrid) ColumnData_val[2] = *OrdinateVar2;
     for (j=0; j<fnlist_len; j++)
      {
+      out = ColumnData_val+j+1+(!FlagParametric)+((!FlagParametric)&&SampleGrid);
+      if ((sampler.ok != NULL) && sampler.ok[p*fnlist_len+j])
+       {
+        *out      = sampler.Tmpl[t*fnlist_len+j];
+        out->real = sampler.result[p*fnlist_len+j];
+        *status   = 0;
+        continue;
+       }
       *status=-1; k=-1;
-      ppl_EvaluateAlgebra(fnlist[j], ColumnData_val+j+1+(!FlagParametric)+((!FlagParametric)&&SampleGrid), 0, &k, 0, status, errout, 0);
-      if (k<strlen(fnlist[j])) { sprintf(errout, "Expression '%s' is not syntactically valid %d %ld", fnlist[j],k,(long)strlen(fnlist[j])); *status=1; if (DEBUG) ppl_log(errout); return; }
-      if (*status>=0) { COUNTEDERR1; sprintf(temp_err_string, "%s: Could not evaluate expression <%s>. The error, encountered at character position %d, was: '%s'", buffer, fnlist[j], *status, errout); ppl_error(ERR_NUMERIC, -1, -1, temp_err_string); COUNTEDERR2F; *status=1; break; }
+      if (expr[j]!=NULL)
+       {
+        ppl_EvaluateCompiled(expr[j], args, out, status, errout, 0);
+       } else {
+        ppl_EvaluateAlgebra(fnlist[j], out, 0, &k, 0, status, errout, 0);
+        if (k<strlen(fnlist[j])) { sprintf(errout, "Expression '%s' is not syntactically valid %d %ld", fnlist[j],k,(long)strlen(fnlist[j])); *status=1; if (DEBUG) ppl_log(errout); goto SAMPLING_DONE; }
+       }
+      if (*status>=0) { DataFile_SampleName(buffer, FlagParametric, OrdinateVar, OrdinateVar2); COUNTEDERR1; sprintf(temp_err_string, "%s: Could not evaluate expression <%s>. The error, encountered at character position %d, was: '%s'", buffer, fnlist[j], *status, errout); ppl_error(ERR_NUMERIC, -1, -1, temp_err_string); COUNTEDERR2F; *status=1; break; }
       else            { *status=0; }
      }
     ExpectedNrows = (*output)->Nrows+1;
     if (!(*status))
      {
-      DataFile_ApplyUsingList(*output, ContextOutput, NULL, ColumnData_val, fnlist_len+(!FlagParametric)+((!FlagParametric)&&SampleGrid), UsingItems, UsingLen, buffer, 0, NULL, i, 0, 0, DATAFILE_COL, "column", NULL, 0, NULL, 0, LabelStr, SelectCriterion, continuity, &discontinuity, ErrCounter, status, errout);
+      if ((!ColumnListOnly) || DataFile_ApplyValueList(*output, ColumnData_val, fnlist_len+(!FlagParametric)+((!FlagParametric)&&SampleGrid), UsingColumns, UsingLen, i, &discontinuity, status, errout))
+       {
+        DataFile_SampleName(buffer, FlagParametric, OrdinateVar, OrdinateVar2);
+        DataFile_ApplyUsingList(*output, ContextOutput, NULL, ColumnData_val, fnlist_len+(!FlagParametric)+((!FlagParametric)&&SampleGrid), UsingItems, UsingLen, buffer, 0, NULL, i, 0, 0, DATAFILE_COL, "column", NULL, 0, NULL, 0, LabelStr, SelectCriterion, continuity, &discontinuity, ErrCounter, status, errout);
+       }
      } else {
       if (!SampleGrid) discontinuity = 1;
      }
@@ -1176,9 +2949,15 @@ void DataFile_FromFunctions(double *OrdinateRaster, unsigned char FlagParametric
    }
   }
 
+SAMPLING_DONE:
+  // Free the compiled functions
+  if (sampler.ok != NULL) DataFile_SamplerFree(&sampler);
+  for (j=0; j<fnlist_len; j++) if (expr[j]!=NULL) ppl_CompiledAlgebraFree(expr[j]);
+
   // Reset the variable x (and maybe y or t) to its old value
   ppl_UserSpace_RestoreVarPointer(&OrdinateVar, &DummyTemp);
   if (OrdinateVar2!=NULL) ppl_UserSpace_RestoreVarPointer(&OrdinateVar2, &DummyTemp2);
+  if (*status) return; // An expression was not syntactically valid
 
   // If data is to be sorted, sort it now
   if ((!SampleGrid) && (SortBy != NULL))
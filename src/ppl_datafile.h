@@ -38,6 +38,28 @@
 
 #define DATAFILE_DATABLOCK_BYTES 524288
 
+// The number of bytes which are read from a datafile at a time
+
+#define DATAFILE_READ_BYTES 1048576
+
+// The number of seconds for which a datafile must have gone unmodified before it is memory-mapped. A file which is
+// truncated whilst it is mapped raises SIGBUS, rather than simply ending, so files which may still be being written
+// are read through stdio instead
+
+#define DATAFILE_MAP_SETTLE 10
+
+// The number of bytes of a memory-mapped datafile which are given to each thread to parse at a time
+
+#define DATAFILE_PARSE_BYTES 4194304
+
+// The minimum number of samples of a function which are worth giving to each thread to evaluate
+
+#define DATAFILE_SAMPLE_POINTS 4096
+
+// The default amount of memory, in megabytes, used to keep copies of recently-read datafiles
+
+#define DATAFILE_CACHE_DEFAULT_MB 256
+
 #include "ppl_units.h"
 
 // RawDataTabls structure, used for storing raw text from datafiles prior to rotation when "with rows" is used
@@ -95,7 +117,17 @@ void DataFile_CreateBackupIfRequired(const char *filename);
 void __inline__ DataFile_UsingConvert_FetchColumnByNumber(double ColumnNo, value *output, const int NumericOut, const unsigned char MallocOut, int *status, char *errtext);
 void __inline__ DataFile_UsingConvert_FetchColumnByName(char *ColumnName, value *output, const int NumericOut, const unsigned char MallocOut, int *status, char *errtext);
 
-void DataFile_read(DataTable **output, int *status, char *errout, char *filename, int index, int UsingRowCol, List *UsingList, unsigned char AutoUsingList, List *EveryList, char *LabelStr, int Ncolumns, char *SelectCriterion, int continuity, char *SortBy, int SortByContinuity, unsigned char persistent, int *ErrCounter);
+void DataFile_CacheTrim();
+void DataFile_CacheFlush();
+void DataFile_CacheStatus(long int *Nentries, long int *bytes, long int *hits, long int *misses);
+
+void DataFile_read(DataTable **output, int *status, char *errout, char *filename, char *BinaryFormat, int index, int UsingRowCol, List *UsingList, unsigned char AutoUsingList, List *EveryList, char *LabelStr, int Ncolumns, char *SelectCriterion, int continuity, char *SortBy, int SortByContinuity, unsigned char persistent, int *ErrCounter);
+
+void DataFile_Prefetch(char *filename);
+
+void DataFile_ReadAheadRequest(char *filename, char *BinaryFormat, int index, int UsingRowCol, List *UsingList, unsigned char AutoUsingList, List *EveryList, char *LabelStr, int Ncolumns, char *SelectCriterion, int continuity, char *SortBy, int SortByContinuity, int group);
+void DataFile_ReadAheadRun();
+void DataFile_ReadAheadClear();
 
 void DataFile_FromFunctions(double *OrdinateRaster, unsigned char FlagParametric, int RasterLen, value *RasterUnits, double *OrdinateYRaster, int RasterYLen, value *RasterYUnits, DataTable **output, int *status, char *errout, char **fnlist, int fnlist_len, List *UsingList, unsigned char AutoUsingList, char *LabelStr, int Ncolumns, char *SelectCriterion, int continuity, char *SortBy, int SortByContinuity, int *ErrCounter);
 
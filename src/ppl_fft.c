@@ -171,7 +171,7 @@ int directive_fft(Dict *command)
     // Read data from file
     status=0;
     errtext = (char *)lt_malloc(LSTR_LENGTH);
-    DataFile_read(&data, &status, errtext, filename, *indexptr, rowcol, UsingList, 0, EveryList, NULL, Ndims+2, SelectCrit, DATAFILE_CONTINUOUS, NULL, -1, 0, &ErrCount);
+    DataFile_read(&data, &status, errtext, filename, NULL, *indexptr, rowcol, UsingList, 0, EveryList, NULL, Ndims+2, SelectCrit, DATAFILE_CONTINUOUS, NULL, -1, 0, &ErrCount);
     if (status) { ppl_error(ERR_GENERAL, -1, -1, errtext); return 1; }
     if (data->Nrows==0) { ppl_error(ERR_FILE, -1, -1, "No data was read from file"); return 1; }
 
@@ -349,6 +349,7 @@ int directive_fft(Dict *command)
    }
 
   // Add entry to function dictionary
+  _ppl_UserSpace_Generation++;
   DictAppendPtr(_ppl_UserSpace_Funcs, outfunc, (void *)FuncPtr2, sizeof(FunctionDescriptor), 0, DATATYPE_VOID);
 
   // Free copies of data vectors defined within our local context
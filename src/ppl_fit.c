@@ -44,9 +44,15 @@
 #include "ppl_fit.h"
 #include "ppl_glob.h"
 #include "ppl_settings.h"
+#include "ppl_threads.h"
 #include "ppl_units.h"
 #include "ppl_units_fns.h"
 #include "ppl_userspace.h"
+#include "ppl_userspace_compile.h"
+
+// Residuals are summed over blocks of this many data points, which are shared out between threads. The block sums are then added up in order,
+// so that the result does not depend upon how many threads were used.
+#define FIT_BLOCK_LENGTH 1000
 
 // Structure used for passing data around
 typedef struct FitComm {
@@ -63,6 +69,13 @@ typedef struct FitComm {
  double             *DataTable; // Two-dimensional table of the data read from the datafile.
  unsigned char       FlagYErrorBars; // If true, the user has specified errorbars for each target value. If false, we have no idea of uncertainty.
  FunctionDescriptor *funcdef; // Function descriptor for the function f() which we're trying to get to fit the data
+ int                 NThreads; // The number of threads between which the data points are split when FitResidual() sums residuals
+ CompiledAlgebra    *expr[MAX_THREADS]; // Compiled calls to f(), one per thread, with arguments bound to slots which are filled from DataTable
+ value              *ArgVals; // Values passed to the arguments of f() for each data point; NArgs values for each thread
+ char               *ThreadErrtext; // Error messages from threads other than the first
+ long int            NBlocks; // The number of blocks of FIT_BLOCK_LENGTH data points
+ double             *BlockSum; // Sum of residuals over each block of data points
+ unsigned char       ThreadFailed[MAX_THREADS]; // Set if evaluation of f() failed in a thread
  char               *ScratchPad, *errtext, *FunctionName; // String workspaces
  unsigned char       GoneNaN; // Used by the minimiser to keep track of when the function being minimised has returned NAN.
  double              SigmaData; // The assumed errorbar (uniform for all datapoints) on the supplied target values if errorbars are not supplied. We fit this.
@@ -87,13 +100,51 @@ static char *MatrixPrint(const gsl_matrix *m, const size_t size, char *out)
   return out;
  }
 
+// Sum the residuals between function and data over each block of data points from FirstBlock to LastBlock-1, using the copy of f() belonging to thread ThreadNo
+static int FitResidualSum(FitComm *p, int ThreadNo, long int FirstBlock, long int LastBlock)
+ {
+  int      k, errpos=-1;
+  long int i, j, end;
+  double   accumulator, residual;
+  value    x, *ArgVals = p->ArgVals + ThreadNo*p->NArgs;
+  char    *errtext = (ThreadNo==0) ? p->errtext : (p->ThreadErrtext + (ThreadNo-1)*LSTR_LENGTH);
+
+  for (i=FirstBlock; i<LastBlock; i++)
+   {
+    accumulator = 0.0; // Add up sum of square residuals
+
+    end = (i+1)*FIT_BLOCK_LENGTH;
+    if (end > p->NDataPoints) end = p->NDataPoints;
+    for (j=i*FIT_BLOCK_LENGTH; j<end; j++) // Loop over all of the data points in this block
+     {
+      for (k=0; k<p->NArgs; k++) ArgVals[k].real = p->DataTable[j*p->NExpect+k]; // Units of arguments were set up in directive_fit()
+      ppl_EvaluateCompiled(p->expr[ThreadNo], ArgVals, &x, &errpos, errtext, 0);
+      if (errpos>=0) return 1; // Evaluation of algebra failed
+      if (!ppl_units_DimEqual(&x, p->FirstVals+p->NArgs)) { sprintf(errtext, "The supplied function to fit produces a value which is dimensionally incompatible with its target value. The function produces a result with dimensions of <%s>, while its target value has dimensions of <%s>.", ppl_units_GetUnitStr(&x,NULL,NULL,0,1,0), ppl_units_GetUnitStr(p->FirstVals+p->NArgs,NULL,NULL,1,1,0)); return 1; }
+      residual = pow(x.real - p->DataTable[j*p->NExpect+k] , 2) + pow(x.imag , 2); // Calculate squared deviation of function result from desired result
+      if (p->FlagYErrorBars) residual /= 2 * pow(p->DataTable[j*p->NExpect+k+1] , 2); // Divide square residual by 2 sigma squared.
+      else                   residual /= 2 * pow(p->SigmaData                   , 2);
+      accumulator += residual; // ... and sum
+     }
+    p->BlockSum[i] = accumulator;
+   }
+  return 0;
+ }
+
+// Worker run by each thread, which sums the residuals over its share of the blocks of data points
+static void FitResidualThread(void *p_void, int ThreadNo, int NThreads)
+ {
+  FitComm *p = (FitComm *)p_void;
+  p->ThreadFailed[ThreadNo] = FitResidualSum(p, ThreadNo, p->NBlocks*ThreadNo/NThreads, p->NBlocks*(ThreadNo+1)/NThreads);
+  return;
+ }
+
 // Low-level routine for working out the mismatch between function and data for a given set of free parameter values
 static double FitResidual(FitComm *p)
  {
-  int      i, k, errpos=-1;
+  int      i;
   long int j;
-  double   accumulator, residual;
-  value    x;
+  double   accumulator;
 
   // Set free parameter values
   for (i=0; i<p->NFitVars; i++)
@@ -102,35 +153,31 @@ static double FitResidual(FitComm *p)
                                                                p->outval[i]->imag = gsl_vector_get(p->ParamVals, 2*i+1);
                                                              }
 
-  accumulator = 0.0; // Add up sum of square residuals
-
-  for (j=0; j<p->NDataPoints; j++) // Loop over all of the data points in the file that we're fitting
+  if (p->NThreads > 1)
    {
-    i=0;
-    sprintf(p->ScratchPad+i, "%s(", p->FunctionName); i+=strlen(p->ScratchPad+i);
-    for (k=0; k<p->NArgs; k++)
-     {
-      x = p->FirstVals[k];
-      x.real = p->DataTable[j*p->NExpect+k];
-      x.imag = 0.0;
-      x.FlagComplex = 0;
-      sprintf(p->ScratchPad+i, "%s,", ppl_units_NumericDisplay(&x, 0, 1, 20));
-      i+=strlen(p->ScratchPad+i);
-     }
-    if (p->NArgs>0) i--; // Remove final comma from list of arguments
-    sprintf(p->ScratchPad+i, ")");
-    ppl_EvaluateAlgebra(p->ScratchPad, &x, 0, NULL, 0, &errpos, p->errtext, 0);
-    if (errpos>=0) return GSL_NAN; // Evaluation of algebra failed
-    if (!ppl_units_DimEqual(&x, p->FirstVals+p->NArgs)) { sprintf(p->errtext, "The supplied function to fit produces a value which is dimensionally incompatible with its target value. The function produces a result with dimensions of <%s>, while its target value has dimensions of <%s>.", ppl_units_GetUnitStr(&x,NULL,NULL,0,1,0), ppl_units_GetUnitStr(p->FirstVals+p->NArgs,NULL,NULL,1,1,0)); return GSL_NAN; }
-    residual = pow(x.real - p->DataTable[j*p->NExpect+k] , 2) + pow(x.imag , 2); // Calculate squared deviation of function result from desired result
-    if (p->FlagYErrorBars) residual /= 2 * pow(p->DataTable[j*p->NExpect+k+1] , 2); // Divide square residual by 2 sigma squared.
-    else                   residual /= 2 * pow(p->SigmaData                   , 2);
-    accumulator += residual; // ... and sum
+    ppl_threads_run(&FitResidualThread, (void *)p, p->NThreads);
+    for (i=0; i<p->NThreads; i++) if (p->ThreadFailed[i]) break;
+    // If any thread failed, go over the data again in one thread, to get the same error message as we would have done otherwise
+    if ((i<p->NThreads) && FitResidualSum(p, 0, 0, p->NBlocks)) return GSL_NAN;
+   }
+  else
+   {
+    if (FitResidualSum(p, 0, 0, p->NBlocks)) return GSL_NAN;
    }
 
+  for (j=0, accumulator=0.0; j<p->NBlocks; j++) accumulator += p->BlockSum[j];
   return accumulator;
  }
 
+// Free the compiled copies of f() used by FitResidual()
+static void FitFreeExpressions(FitComm *p)
+ {
+  int i;
+  for (i=0; i<p->NThreads; i++) ppl_CompiledAlgebraFree(p->expr[i]);
+  p->NThreads = 0;
+  return;
+ }
+
 // Slave routines called by the differentiation operation when working out the Hessian matrix
 
 static double GetHessian_diff2(double x, void *p_void)
@@ -309,13 +356,14 @@ static int FitMinimiseIterate(FitComm *commlink, double(*slave)(const gsl_vector
 // Main entry point for the implementation of the fit command
 int directive_fit(Dict *command)
  {
-  int        status=0, NArgs, NExpect;
+  int        status=0, NArgs, NExpect, errpos;
   char      *cptr, *filename;
   long int   i, j, k, NDataPoints;
   int        ContextOutput, ContextLocalVec, ContextDataTab, index=-1, *indexptr, rowcol=DATAFILE_COL, ErrCount=DATAFILE_NERRS;
-  char       errtext[LSTR_LENGTH], *FitVars[USING_ITEMS_MAX], *tempstr=NULL, *SelectCrit=NULL;
+  char       errtext[LSTR_LENGTH], *FitVars[USING_ITEMS_MAX], *tempstr=NULL, *SelectCrit=NULL, *BinaryFormat=NULL;
   List      *UsingList=NULL, *EveryList=NULL;
   value     *min[USING_ITEMS_MAX], *max[USING_ITEMS_MAX], *outval[USING_ITEMS_MAX], FirstVals[USING_ITEMS_MAX];
+  char      *ArgNames[USING_ITEMS_MAX];
   value     *DummyVar, DummyTemp;
   DataTable *data;
   DataBlock *blk;
@@ -372,6 +420,7 @@ int directive_fit(Dict *command)
   DictLookup(command, "using_list:", NULL, (void *)&UsingList);
   DictLookup(command, "every_list:", NULL, (void *)&EveryList);
   DictLookup(command, "select_criterion", NULL, (void *)&SelectCrit);
+  DictLookup(command, "binary_format"   , NULL, (void *)&BinaryFormat);
 
   // Work out how many columns of data we're going to read
   if ((UsingList==NULL) || (ListLen(UsingList) != NArgs+2)) NExpect = NArgs+1;
@@ -397,7 +446,7 @@ int directive_fit(Dict *command)
   ContextDataTab = lt_DescendIntoNewContext();
 
   // Read data from file
-  DataFile_read(&data, &status, errtext, filename, *indexptr, rowcol, UsingList, 0, EveryList, NULL, NExpect, SelectCrit, DATAFILE_CONTINUOUS, NULL, -1, 0, &ErrCount);
+  DataFile_read(&data, &status, errtext, filename, BinaryFormat, *indexptr, rowcol, UsingList, 0, EveryList, NULL, NExpect, SelectCrit, DATAFILE_CONTINUOUS, NULL, -1, 0, &ErrCount);
   if (status) { ppl_error(ERR_GENERAL, -1, -1, errtext); return 1; }
 
   // Check that the FirstEntries above have the same units as any supplied ranges
@@ -472,10 +521,53 @@ int directive_fit(Dict *command)
   DataComm.funcdef     = funcdef;
   DataComm.ScratchPad  = (char *)lt_malloc_incontext(LSTR_LENGTH, ContextLocalVec);
   DataComm.errtext     = (char *)lt_malloc_incontext(LSTR_LENGTH, ContextLocalVec); // FunctionName was already set above
+  DataComm.NThreads    = 0;
+
+  // Decide how many threads to split the data points between
+  DataComm.NBlocks  = (NDataPoints + FIT_BLOCK_LENGTH - 1) / FIT_BLOCK_LENGTH;
+  DataComm.NThreads = ppl_threads_count();
+  if (DataComm.NThreads > DataComm.NBlocks) DataComm.NThreads = DataComm.NBlocks;
+  if (DataComm.NThreads < 1) DataComm.NThreads = 1;
+  DataComm.BlockSum      = (double *)lt_malloc_incontext((DataComm.NBlocks+1) * sizeof(double), ContextLocalVec);
+  DataComm.ArgVals       = (value *)lt_malloc_incontext(DataComm.NThreads * (NArgs+1) * sizeof(value), ContextLocalVec);
+  DataComm.ThreadErrtext = (char  *)lt_malloc_incontext(DataComm.NThreads * LSTR_LENGTH, ContextLocalVec);
+  if ((DataComm.ArgVals==NULL) || (DataComm.ThreadErrtext==NULL) || (DataComm.BlockSum==NULL)) { ppl_error(ERR_MEMORY, -1, -1, "Out of memory."); return 1; }
+
+  // Compile a call to f(), whose arguments are bound to the values in ArgVals rather than being printed into a string and parsed for each data point
+  // The arguments are given the same names as in the definition of f(), which is what they would be called within the body of f() anyway
+  cptr = DataComm.ScratchPad;
+  sprintf(cptr, "%s(", DataComm.FunctionName); k=strlen(cptr);
+  for (j=0, tempstr=funcdef->ArgList; j<NArgs; j++)
+   {
+    if (tempstr != NULL) { ArgNames[j] = tempstr; tempstr += strlen(tempstr)+1; }
+    else
+     {
+      ArgNames[j] = (char *)lt_malloc_incontext(16, ContextLocalVec);
+      if (ArgNames[j]==NULL) { ppl_error(ERR_MEMORY, -1, -1, "Out of memory."); return 1; }
+      sprintf(ArgNames[j], "x%ld", j+1);
+     }
+    sprintf(cptr+k, "%s%s", (j>0)?",":"", ArgNames[j]); k+=strlen(cptr+k);
+    for (i=0; i<DataComm.NThreads; i++)
+     {
+      DataComm.ArgVals[i*NArgs+j] = FirstVals[j]; // Copy units of each column of data
+      DataComm.ArgVals[i*NArgs+j].imag = 0.0;
+      DataComm.ArgVals[i*NArgs+j].FlagComplex = 0;
+     }
+   }
+  strcpy(cptr+k, ")");
+
+  // Each thread needs its own copy of the compiled expression, since each copy has its own workspace. Functions which use global state
+  // (e.g. which call subroutines, or which are integrated) cannot be evaluated in several threads at once.
+  for (i=0; i<DataComm.NThreads; i++)
+   {
+    DataComm.expr[i] = ppl_CompileAlgebra(cptr, 0, NULL, 0, NArgs, ArgNames, &errpos, DataComm.errtext, 0);
+    if (DataComm.expr[i] == NULL) { ppl_error(ERR_GENERAL, -1, -1, DataComm.errtext); DataComm.NThreads=i; FitFreeExpressions(&DataComm); return 1; }
+    if (!DataComm.expr[0]->ThreadSafe) { DataComm.NThreads=1; break; }
+   }
 
   // Set up a minimiser
   status = FitMinimiseIterate(&DataComm, &ResidualMinimiserSlave, 0);
-  if (status) { ppl_error(ERR_GENERAL, -1, -1, DataComm.errtext); return 1; }
+  if (status) { ppl_error(ERR_GENERAL, -1, -1, DataComm.errtext); FitFreeExpressions(&DataComm); return 1; }
 
   // Display the results of the minimiser
   ppl_report("\n# Best fit parameters were:\n# -------------------------\n");
@@ -490,6 +582,7 @@ int directive_fit(Dict *command)
   DictLookup(command,"withouterrors", NULL, (void *)&cptr);
   if (cptr != NULL)
    {
+    FitFreeExpressions(&DataComm);
     lt_AscendOutOfContext(ContextLocalVec);
     return 0;
    }
@@ -509,7 +602,7 @@ int directive_fit(Dict *command)
     sprintf(temp_err_string, "\n# Estimating the size of the error bars on supplied data.\n# This may take a while.\n# The fit command can be made to run very substantially faster if the 'withouterrors' option is set.");
     ppl_report(temp_err_string);
     status = FitMinimiseIterate(&DataComm, &FitSigmaData, 1);
-    if (status) { ppl_error(ERR_GENERAL, -1, -1, DataComm.errtext); gsl_vector_free(BestFitParamVals); return 1; }
+    if (status) { ppl_error(ERR_GENERAL, -1, -1, DataComm.errtext); gsl_vector_free(BestFitParamVals); FitFreeExpressions(&DataComm); return 1; }
     FirstVals[NArgs].real = DataComm.SigmaData;
     FirstVals[NArgs].imag = 0.0;
     FirstVals[NArgs].FlagComplex = 0;
@@ -666,6 +759,7 @@ int directive_fit(Dict *command)
   gsl_matrix_free(hessian_lu);
   gsl_matrix_free(hessian);
   gsl_permutation_free(perm);
+  FitFreeExpressions(&DataComm);
   lt_AscendOutOfContext(ContextLocalVec);
   return 0;
  }
@@ -55,6 +55,7 @@ int   PPL_FLOWCTRL_CONTINUED  = 0;
 int   PPL_FLOWCTRL_RETURNED   = 0;
 int   PPL_FLOWCTRL_RETURNCONTEXT = 0;
 value PPL_FLOWCTRL_RETURNVAL, PPL_FLOWCTRL_RETURNTOALGEBRA;
+long int PPL_FLOWCTRL_SUBROUTINECALLS = 0; // The number of subroutines which have been called from algebraic expressions
 
 void loopaddline(cmd_chain **cmd_put, char *line, int *bracegot, int *bracelevel, int *status)
  {
@@ -105,6 +106,8 @@ void loopaddline(cmd_chain **cmd_put, char *line, int *bracegot, int *bracelevel
   if (k==NULL) (**cmd_put)->linenumber  = -1; // Write source line number
   else         (**cmd_put)->linenumber  = *k;
   (**cmd_put)->next        = NULL; // Put null next tag in linked list
+  (**cmd_put)->parsed      = NULL;
+  (**cmd_put)->context     = lt_GetMemContext();
   if (desc == NULL)
    { (**cmd_put)->description = NULL; } // Write source filename description
   else
@@ -137,7 +140,7 @@ int loop_execute(cmd_chain *chain, int breakable, int returnable, int IterLevel)
     SetInputSourceLoop(chain);
     line_ptr = FetchInputStatement("","",0);
     if (line_ptr == NULL) break;
-    if (StrStrip(line_ptr,line_ptr)[0] != '\0') status = ProcessDirective(line_ptr, 0, IterLevel);
+    if (StrStrip(line_ptr,line_ptr)[0] != '\0') status = ProcessDirectiveCached(line_ptr, 0, IterLevel, GetInputSourceLoopItem());
    }
   PPL_FLOWCTRL_BREAKABLE  = OldBreakable;
   PPL_FLOWCTRL_RETURNABLE = OldReturnable;
@@ -519,7 +522,7 @@ void directive_foreach_LoopOverData(Dict *command, char *filename, cmd_chain *ch
    if (ListIter != NULL) { sprintf(temp_err_string, "Too many ranges supplied to the 'foreach ... in datafile' construct. %d ranges were supplied, even though only %ld variables are being read.", ListLen(RangeList), i); ppl_error(ERR_SYNTAX, -1, -1, temp_err_string); *status=1; return; }
 
   ContextDataTab = lt_DescendIntoNewContext();
-  DataFile_read(&data, status, errtext, filename, *indexptr, rowcol, UsingList, 0, EveryList, NULL, i, SelectCrit, DATAFILE_CONTINUOUS, NULL, -1, 0, &ErrCount);
+  DataFile_read(&data, status, errtext, filename, NULL, *indexptr, rowcol, UsingList, 0, EveryList, NULL, i, SelectCrit, DATAFILE_CONTINUOUS, NULL, -1, 0, &ErrCount);
   if (*status) { ppl_error(ERR_GENERAL, -1, -1, errtext); *status=1; return; }
 
   // Check that the FirstEntries above have the same units as any supplied ranges
@@ -728,6 +731,7 @@ int directive_subroutine(Dict *command, int IterLevel)
 
   // Add subroutine to subroutine dictionary
   NewSub->commands = chain;
+  _ppl_UserSpace_Generation++;
   DictAppendPtr(_ppl_UserSpace_Funcs, name, (void *)NewFD, sizeof(FunctionDescriptor), 0, DATATYPE_VOID);
   _lt_SetMemContext(MemContext);
   return 0;
@@ -832,6 +836,7 @@ int CallSubroutineFromAlgebra(char *FunctionName, char *ArgStart, int *endpos, i
   DictLookup(_ppl_UserSpace_Funcs,FunctionName,NULL,(void *)&fd);
   if (fd==NULL) { sprintf(errtext,"No subroutine defined with name '%s'.",FunctionName); *errpos=-1; return 1; }
   NArgs = fd->NumberArguments;
+  PPL_FLOWCTRL_SUBROUTINECALLS++;
 
   for (i=k=0; k<NArgs; k++) // Now collect together numeric arguments
    {
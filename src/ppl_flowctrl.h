@@ -34,6 +34,8 @@ typedef struct cmd_chain_item {
  struct cmd_chain_item *next;
  int linenumber;
  char *description;
+ struct ParsedCommand *parsed; // Traces of how the statements on this line were last parsed; see parse_cached()
+ int context; // The memory context in which this chain item was allocated
 } cmd_chain_item;
 
 typedef struct cmd_chain_item *cmd_chain;
@@ -54,6 +56,7 @@ extern int   PPL_FLOWCTRL_CONTINUED;
 extern int   PPL_FLOWCTRL_RETURNED;
 extern int   PPL_FLOWCTRL_RETURNCONTEXT;
 extern value PPL_FLOWCTRL_RETURNVAL, PPL_FLOWCTRL_RETURNTOALGEBRA;
+extern long int PPL_FLOWCTRL_SUBROUTINECALLS;
 extern Dict *PPL_SUBROUTINES;
 #endif
 
@@ -46,6 +46,7 @@
 
 static FILE      *infile = NULL;
 static cmd_chain *inchain = NULL;
+static cmd_chain_item *inchain_item = NULL; // The loop chain item from which a line was last read
 static int        mode = -1;
 static int       *linenumber = NULL;
 static char      *instr = NULL;
@@ -56,6 +57,7 @@ void SetInputSourcePipe(int *linenumber_, char *filename_description_)
  {
   infile               = stdin;
   inchain              = NULL;
+  inchain_item         = NULL;
   mode                 = INPUT_PIPE;
   linenumber           = linenumber_;
   instr                = NULL;
@@ -68,6 +70,7 @@ void SetInputSourceReadline(int *linenumber_)
  {
   infile               = NULL;
   inchain              = NULL;
+  inchain_item         = NULL;
   mode                 = INPUT_READLINE;
   linenumber           = linenumber_;
   instr                = NULL;
@@ -80,6 +83,7 @@ void SetInputSourceFile(FILE *infile_, int *linenumber_, char *filename_descript
  {
   infile               = infile_;
   inchain              = NULL;
+  inchain_item         = NULL;
   mode                 = INPUT_FILE;
   linenumber           = linenumber_;
   instr                = NULL;
@@ -92,6 +96,7 @@ void SetInputSourceLoop(cmd_chain *inchain_)
  {
   infile               = NULL;
   inchain              = inchain_;
+  inchain_item         = NULL;
   mode                 = INPUT_LOOPCHAIN;
   linenumber           = NULL;
   instr                = NULL;
@@ -104,6 +109,7 @@ void SetInputSourceString(char *instr_, int *inpos_)
  {
   infile               = NULL;
   inchain              = NULL;
+  inchain_item         = NULL;
   mode                 = INPUT_STRING;
   instr                = instr_;
   inpos                = inpos_;
@@ -118,6 +124,12 @@ void GetInputSource(int **lineno, char **descr)
   return;
  }
 
+cmd_chain_item *GetInputSourceLoopItem()
+ {
+  if (mode != INPUT_LOOPCHAIN) return NULL;
+  return inchain_item;
+ }
+
 char *FetchInputLine(char *output, char *prompt)
  {
   int i;
@@ -155,6 +167,7 @@ char *FetchInputLine(char *output, char *prompt)
     if ((*inchain)->description != NULL) ppl_error_setstreaminfo((*inchain)->linenumber , (*inchain)->description);
     else                                 ppl_error_setstreaminfo(-1                     , ""                     );
     strcpy(output, (*inchain)->line);
+    inchain_item = *inchain;
     *inchain = (*inchain)->next;
     return output;
    }
@@ -32,6 +32,7 @@ void SetInputSourceFile(FILE *infile_, int *linenumber_, char *filename_descript
 void SetInputSourceLoop(cmd_chain *inchain_);
 void SetInputSourceString(char *instr_, int *inpos_);
 void GetInputSource(int **lineno, char **descr);
+cmd_chain_item *GetInputSourceLoopItem();
 char *FetchInputLine(char *output, char *prompt);
 
 #ifndef _PPL_INPUT_C
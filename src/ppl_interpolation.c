@@ -161,7 +161,7 @@ RANGES_DONE:
   // Read input data
   if (bmp<0)
    {
-    DataFile_read(&data, &status, errtext, filename, *indexptr, rowcol, UsingList, 0, EveryList, NULL, NcolRequired, SelectCrit, continuity, NULL, -1, 0, &ErrCount);
+    DataFile_read(&data, &status, errtext, filename, NULL, *indexptr, rowcol, UsingList, 0, EveryList, NULL, NcolRequired, SelectCrit, continuity, NULL, -1, 0, &ErrCount);
 
     // Transfer data from multiple data tables into single vectors
     if ((NcolRequired<3)&&(mode!=INTERP_STEPWISE)) xdata = (double *)lt_malloc_incontext(NcolRequired * (data->Nrows+2) * sizeof(double), ContextLocalVec);
@@ -395,6 +395,7 @@ RANGES_DONE:
    }
 
   // Add entry to function dictionary
+  _ppl_UserSpace_Generation++;
   DictAppendPtr(_ppl_UserSpace_Funcs, fitfunc, (void *)FuncPtr2, sizeof(FunctionDescriptor), 0, DATATYPE_VOID);
 
   // Free copies of data vectors defined within our local context
@@ -503,7 +504,7 @@ void ppl_interp2d_evaluate(const char *FuncName, SplineDescriptor *desc, const v
 
   if (!bmp)
    {
-    ppl_interp2d_eval(&dblout, &settings_graph_current, (double *)desc->SplineObj, desc->SizeX, 2, 3, dblin1, dblin2);
+    ppl_interp2d_eval(&dblout, &settings_graph_current, (double *)desc->SplineObj, desc->SizeX, 2, 3, NULL, dblin1, dblin2);
    } else {
     int x = floor(dblin1);
     int y = floor(dblin2);
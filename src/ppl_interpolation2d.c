@@ -39,7 +39,235 @@
 #include "ppl_settings.h"
 #include "ppl_setting_types.h"
 
-void ppl_interp2d_eval(double *output, const settings_graph *sg, const double *in, const long InSize, const int ColNum, const int NCols, const double x, const double y)
+// Offset of the first cell of level l of the pyramid, which has 2^l x 2^l cells
+#define LEVEL_OFFSET(l) ((((long)1<<(2*(l)))-1)/3)
+
+// Finest-level cell containing normalised position (u,v), clamped to the grid
+static void ppl_interp2d_cell(const ppl_interp2d_index *index, double u, double v, int *ix, int *iy)
+ {
+  u *= index->N; v *= index->N;
+  *ix = (!(u>0)) ? 0 : ((u>=index->N) ? index->N-1 : (int)u); // Written so that NaNs land in cell 0
+  *iy = (!(v>0)) ? 0 : ((v>=index->N) ? index->N-1 : (int)v);
+  return;
+ }
+
+ppl_interp2d_index *ppl_interp2d_IndexBuild(const settings_graph *sg, const double *in, const long InSize, const int NCols)
+ {
+  ppl_interp2d_index *index;
+  long   i, c, NCells;
+  int    ix, iy, l, j, m, M, Nz=NCols-2;
+  double u, v, *mom;
+
+  if ((InSize<1) || (NCols<3)) return NULL;
+  index = (ppl_interp2d_index *)lt_malloc(sizeof(ppl_interp2d_index));
+  if (index==NULL) return NULL;
+
+  index->Xmin = in[NCols*InSize    ];
+  index->Ymin = in[NCols*InSize + 1];
+  index->Xscl = in[NCols*(InSize+1)    ] - index->Xmin;
+  index->Yscl = in[NCols*(InSize+1) + 1] - index->Ymin;
+
+  // Choose a grid with around two points per cell
+  for (index->depth=0; (index->depth<10) && ((4L<<(2*index->depth)) <= InSize); index->depth++);
+  index->N = 1<<index->depth;
+  NCells   = (long)index->N * index->N;
+
+  // Counting sort of points into cells; points within each cell stay in order
+  index->start = (long *)lt_malloc((NCells+1)*sizeof(long));
+  index->order = (long *)lt_malloc(InSize*sizeof(long));
+  if ((index->start==NULL)||(index->order==NULL)) return NULL;
+  for (c=0; c<=NCells; c++) index->start[c]=0;
+  for (i=0; i<InSize; i++)
+   {
+    ppl_interp2d_cell(index, (in[i]-index->Xmin)/index->Xscl, (in[InSize+i]-index->Ymin)/index->Yscl, &ix, &iy);
+    index->start[(long)iy*index->N+ix+1]++;
+   }
+  for (c=0; c<NCells; c++) index->start[c+1] += index->start[c];
+  for (i=0; i<InSize; i++)
+   {
+    ppl_interp2d_cell(index, (in[i]-index->Xmin)/index->Xscl, (in[InSize+i]-index->Ymin)/index->Yscl, &ix, &iy);
+    index->order[index->start[(long)iy*index->N+ix]++] = i;
+   }
+  for (c=NCells; c>0; c--) index->start[c] = index->start[c-1];
+  index->start[0] = 0;
+
+  // Build pyramid of moments, which is only needed for approximate inverse-square interpolation
+  index->NMoments = 0;
+  index->moments  = NULL;
+  if ((sg->Sample2DMethod != SW_SAMPLEMETHOD_INVSQ) || (InSize <= INTERP2D_INVSQ_EXACT_MAX)) return index;
+  M = 3 + 3*Nz;
+  index->moments = (double *)lt_malloc(LEVEL_OFFSET(index->depth+1)*M*sizeof(double));
+  if (index->moments==NULL) return index;
+  for (c=0; c<LEVEL_OFFSET(index->depth+1)*M; c++) index->moments[c]=0.0;
+
+  mom = index->moments + LEVEL_OFFSET(index->depth)*M;
+  for (iy=0; iy<index->N; iy++) for (ix=0; ix<index->N; ix++)
+   {
+    c = (long)iy*index->N+ix;
+    for (i=index->start[c]; i<index->start[c+1]; i++)
+     {
+      long p = index->order[i];
+      u = (in[p]-index->Xmin)/index->Xscl;
+      v = (in[InSize+p]-index->Ymin)/index->Yscl;
+      mom[c*M  ] += 1.0;
+      mom[c*M+1] += u;
+      mom[c*M+2] += v;
+      for (j=0; j<Nz; j++)
+       {
+        double z = in[(j+2)*InSize+p];
+        mom[c*M+3+3*j  ] += z;
+        mom[c*M+3+3*j+1] += z*u;
+        mom[c*M+3+3*j+2] += z*v;
+       }
+     }
+   }
+  for (l=index->depth-1; l>=0; l--)
+   {
+    double *parent = index->moments + LEVEL_OFFSET(l  )*M;
+    double *child  = index->moments + LEVEL_OFFSET(l+1)*M;
+    int     n      = 1<<l;
+    for (iy=0; iy<2*n; iy++) for (ix=0; ix<2*n; ix++)
+     {
+      c = (long)(iy/2)*n + ix/2;
+      for (m=0; m<M; m++) parent[c*M+m] += child[((long)iy*2*n+ix)*M+m];
+     }
+   }
+  index->NMoments = M;
+  return index;
+ }
+
+// Nearest-neighbour search, looking through rings of cells around the one containing (x,y) until no closer point can remain
+static double ppl_interp2d_nearest(const ppl_interp2d_index *index, const double *inX, const double *inY, const double *inZ, const double x, const double y)
+ {
+  const double u = (x-index->Xmin)/index->Xscl;
+  const double v = (y-index->Ymin)/index->Yscl;
+  const double u_out = (u<0) ? -u : ((u>1) ? u-1 : 0); // Distance of (x,y) outside the range of the data
+  const double v_out = (v<0) ? -v : ((v>1) ? v-1 : 0);
+  const int    N = index->N;
+  int    bx, by, r, ix, iy, step;
+  long   i, best=-1;
+  double DistBest=0, margin;
+
+  ppl_interp2d_cell(index, u, v, &bx, &by);
+  for (r=0; ; r++)
+   {
+    for (iy=((by-r<0)?0:by-r); iy<=((by+r>=N)?N-1:by+r); iy++)
+     {
+      step = ((iy==by-r)||(iy==by+r)) ? 1 : 2*r;
+      for (ix=bx-r; ix<=bx+r; ix+=step)
+       {
+        if ((ix<0)||(ix>=N)) continue;
+        for (i=index->start[(long)iy*N+ix]; i<index->start[(long)iy*N+ix+1]; i++)
+         {
+          long   p    = index->order[i];
+          double dist = hypot( (inX[p] - x)/index->Xscl , (inY[p] - y)/index->Yscl );
+          if ((best<0) || (dist<DistBest) || ((dist==DistBest) && (p<best))) { DistBest=dist; best=p; }
+         }
+       }
+     }
+
+    // Distance from (x,y) to the nearest cell not yet searched
+    margin = GSL_POSINF;
+    if (bx-r>0  ) { double t=hypot(v_out, u - (double)(bx-r  )/N); if (t<margin) margin=t; }
+    if (bx+r<N-1) { double t=hypot(v_out, (double)(bx+r+1)/N - u); if (t<margin) margin=t; }
+    if (by-r>0  ) { double t=hypot(u_out, v - (double)(by-r  )/N); if (t<margin) margin=t; }
+    if (by+r<N-1) { double t=hypot(u_out, (double)(by+r+1)/N - v); if (t<margin) margin=t; }
+    if (!gsl_finite(margin)) break; // Whole grid has been searched
+    if ((best>=0) && (DistBest < margin*(1-1e-9))) break;
+   }
+  return (best>=0) ? inZ[best] : 0.0;
+ }
+
+// Monaghan Lattanzio kernel has compact support, so only cells within 2h of (x,y) need to be searched
+static double ppl_interp2d_ML(const ppl_interp2d_index *index, const double *inX, const double *inY, const double *inZ, const long InSize, const double x, const double y)
+ {
+  const double u = (x-index->Xmin)/index->Xscl;
+  const double v = (y-index->Ymin)/index->Yscl;
+  const double h = sqrt( 1.0/InSize );
+  const int    N = index->N;
+  int    ix, iy, ix0, ix1, iy0, iy1;
+  long   i;
+  double output=0.0, WeightSum=0.0;
+
+  if ((u+2*h<0) || (u-2*h>1) || (v+2*h<0) || (v-2*h>1)) return GSL_NAN;
+  ppl_interp2d_cell(index, u-2*h*(1+1e-9), v-2*h*(1+1e-9), &ix0, &iy0);
+  ppl_interp2d_cell(index, u+2*h*(1+1e-9), v+2*h*(1+1e-9), &ix1, &iy1);
+  for (iy=iy0; iy<=iy1; iy++) for (ix=ix0; ix<=ix1; ix++)
+   for (i=index->start[(long)iy*N+ix]; i<index->start[(long)iy*N+ix+1]; i++)
+    {
+     long   p = index->order[i];
+     double r = hypot( (inX[p] - x)/index->Xscl , (inY[p] - y)/index->Yscl ) / h;
+     double w = (r>=2)?0.0:((r>=1)?(0.25*gsl_pow_3(2.0-r)):(1.0-1.5*gsl_pow_2(r)+0.75*gsl_pow_3(r)));
+     if (!gsl_finite(w)) continue;
+     output    += w * inZ[p];
+     WeightSum += w;
+    }
+  if (WeightSum>0.0) return output / WeightSum;
+  return GSL_NAN;
+ }
+
+// Inverse-square weighting, walking down the pyramid. Cells which are far away compared with their size are replaced by their centroid, with a
+// first-order correction for the variation of weight across the cell in the sum of weighted values. Nearby cells are opened, and points in the
+// cells of the finest level are summed exactly.
+static double ppl_interp2d_invsq(const ppl_interp2d_index *index, const double *inX, const double *inY, const double *inZ, const int zcol, const double x, const double y)
+ {
+  const double u = (x-index->Xmin)/index->Xscl;
+  const double v = (y-index->Ymin)/index->Yscl;
+  const int    M = index->NMoments;
+  int    stack_l[64], stack_x[64], stack_y[64], Nstack=0, l, cx, cy, k;
+  long   i, hit=-1;
+  double output=0.0, WeightSum=0.0;
+
+  stack_l[0]=stack_x[0]=stack_y[0]=0; Nstack=1;
+  while (Nstack>0)
+   {
+    const double *mom;
+    double n, du, dv, d2, size;
+    Nstack--;
+    l  = stack_l[Nstack];
+    cx = stack_x[Nstack];
+    cy = stack_y[Nstack];
+    mom = index->moments + (LEVEL_OFFSET(l) + ((long)cy<<l) + cx)*M;
+    n   = mom[0];
+    if (n<=0) continue;
+    du   = mom[1]/n - u;
+    dv   = mom[2]/n - v;
+    d2   = du*du + dv*dv;
+    size = M_SQRT2 / (1<<l); // Largest possible distance of a point in this cell from its centroid
+    if (size*size < gsl_pow_2(INTERP2D_INVSQ_THETA) * d2)
+     {
+      const double Sz = mom[3+3*zcol], Szu = mom[4+3*zcol], Szv = mom[5+3*zcol];
+      output    += Sz/d2 - 2*(du*(Szu - Sz*mom[1]/n) + dv*(Szv - Sz*mom[2]/n))/(d2*d2);
+      WeightSum += n/d2;
+     }
+    else if (l < index->depth)
+     {
+      for (k=0; k<4; k++)
+       {
+        stack_l[Nstack] = l+1;
+        stack_x[Nstack] = 2*cx + (k&1);
+        stack_y[Nstack] = 2*cy + (k>>1);
+        Nstack++;
+       }
+     }
+    else
+     {
+      for (i=index->start[((long)cy<<l)+cx]; i<index->start[((long)cy<<l)+cx+1]; i++)
+       {
+        long   p    = index->order[i];
+        double dist = gsl_pow_2((inX[p] - x)/index->Xscl) + gsl_pow_2((inY[p] - y)/index->Yscl);
+        if (dist<1e-200) { if ((hit<0)||(p<hit)) hit=p; continue; }
+        output    += inZ[p] / dist;
+        WeightSum += 1.0 / dist;
+       }
+     }
+   }
+  if (hit>=0) return inZ[hit];
+  if (WeightSum>0.0) return output / WeightSum;
+  return 0.0;
+ }
+
+void ppl_interp2d_eval(double *output, const settings_graph *sg, const double *in, const long InSize, const int ColNum, const int NCols, const ppl_interp2d_index *index, const double x, const double y)
  {
   long          i;
   const double *inX = in;
@@ -55,6 +283,7 @@ void ppl_interp2d_eval(double *output, const settings_graph *sg, const double *i
      {
       double DistBest=0;
       unsigned char first=1;
+      if (index!=NULL) { *output = ppl_interp2d_nearest(index, inX, inY, inZ, x, y); break; }
       *output = 0.0;
       for (i=0; i<InSize; i++)
        {
@@ -66,6 +295,7 @@ void ppl_interp2d_eval(double *output, const settings_graph *sg, const double *i
     case SW_SAMPLEMETHOD_INVSQ:
      {
       double WeightSum = 0.0;
+      if ((index!=NULL) && (index->NMoments>0)) { *output = ppl_interp2d_invsq(index, inX, inY, inZ, ColNum-2, x, y); break; }
       *output = 0.0;
       for (i=0; i<InSize; i++)
        {
@@ -83,6 +313,7 @@ void ppl_interp2d_eval(double *output, const settings_graph *sg, const double *i
      {
       double WeightSum = 0.0;
       double h = sqrt( 1.0/InSize );
+      if (index!=NULL) { *output = ppl_interp2d_ML(index, inX, inY, inZ, InSize, x, y); break; }
       *output = 0.0;
       for (i=0; i<InSize; i++)
        {
@@ -111,6 +342,7 @@ void ppl_interp2d_grid(DataTable **output, const settings_graph *sg, DataTable *
   double    *indata, *MinList, *MaxList, *d[USING_ITEMS_MAX+4];
   long       p, p2, pc, InSize;
   DataBlock *blk;
+  ppl_interp2d_index *index;
   imax = (sg->SamplesXAuto == SW_BOOL_TRUE) ? sg->samples : sg->SamplesX;
   jmax = (sg->SamplesYAuto == SW_BOOL_TRUE) ? sg->samples : sg->SamplesY;
   *XSizeOut = imax;
@@ -159,6 +391,9 @@ void ppl_interp2d_grid(DataTable **output, const settings_graph *sg, DataTable *
     if (MaxList[jms]<=MinList[jms]) { double t=MinList[jms]; MinList[jms]=t*0.999;  MaxList[jms]=t*1.001; }
    }
 
+  // Sort data into a spatial index, so that each output point need only look at nearby input points
+  index = ppl_interp2d_IndexBuild(sg, indata, InSize, k);
+
   // Resample data into new DataTable
   for (j=0, p=0; j<jmax; j++)
    {
@@ -172,7 +407,7 @@ void ppl_interp2d_grid(DataTable **output, const settings_graph *sg, DataTable *
       (*output)->current->data_real[p++].d = y;
 
       for (c=2; c<k; c++)
-        ppl_interp2d_eval(&(*output)->current->data_real[p++].d, sg, indata, InSize, c, k, x, y);
+        ppl_interp2d_eval(&(*output)->current->data_real[p++].d, sg, indata, InSize, c, k, index, x, y);
      }
    }
 
@@ -25,7 +25,29 @@
 #include "ppl_datafile.h"
 #include "ppl_settings.h"
 
-void ppl_interp2d_eval(double *output, const settings_graph *sg, const double *in, const long InSize, const int ColNum, const int NCols, const double x, const double y);
+// Inverse-square interpolation of more than this many points uses the approximate tree walk in ppl_interp2d_eval()
+#define INTERP2D_INVSQ_EXACT_MAX 4096
+
+// Groups of points whose extent, seen from the point being interpolated, is less than THETA times their distance are replaced by a single point at
+// their centroid, with a first-order correction for the variation of weight across the group. The weight given to any one point is then wrong by
+// at most (3*THETA^2-2*THETA^3)/(1-THETA)^2 of itself; since these errors largely cancel, the interpolated values of smooth data are typically
+// accurate to better than 0.1% of the range of the data.
+#define INTERP2D_INVSQ_THETA 0.3
+
+// Spatial index of the scattered points being resampled. Points are sorted into a square grid of N x N cells spanning the range of the data.
+// For inverse-square interpolation, a pyramid of coarser grids, each with half the resolution of the one below, holds the moments of the points
+// in each cell. All positions are normalised so that the data span the unit square.
+typedef struct ppl_interp2d_index {
+  int     depth, N;          // N = 2^depth
+  int     NMoments;          // Number of doubles stored for each cell of the pyramid; zero if it has not been built
+  double  Xmin, Ymin, Xscl, Yscl;
+  long   *start;             // Points in finest-level cell c are order[start[c]] ... order[start[c+1]-1]
+  long   *order;
+  double *moments;           // For each cell of each level, coarsest first: count, sum u, sum v, then sum z, sum zu, sum zv for each z column
+ } ppl_interp2d_index;
+
+ppl_interp2d_index *ppl_interp2d_IndexBuild(const settings_graph *sg, const double *in, const long InSize, const int NCols);
+void ppl_interp2d_eval(double *output, const settings_graph *sg, const double *in, const long InSize, const int ColNum, const int NCols, const ppl_interp2d_index *index, const double x, const double y);
 void ppl_interp2d_grid(DataTable **output, const settings_graph *sg, DataTable *in, settings_axis *axis_x, settings_axis *axis_y, unsigned char SampleToEdge, int *XSizeOut, int *YSizeOut);
 
 #endif
@@ -41,6 +41,7 @@
 
 #include "ppl_constants.h"
 #include "ppl_error.h"
+#include "ppl_flowctrl.h"
 #include "ppl_input.h"
 #include "ppl_parser.h"
 #include "ppl_units.h"
@@ -68,10 +69,61 @@ typedef struct ParserNode {
 
 void parse_descend(ParserNode *node, char *line, int IterLevel, int *linepos, int *start, int *number, char *expecting, int *ExpectingPos, int *ExpectingLinePos, char *AlgebraError, int *AlgebraLinepos, char *AlgebraNewError, int *AlgebraNewLinepos, Dict *output, int *match, int *success);
 
+// Whilst parse_cached() is parsing a line, parse_descend() keeps a trace of the items which matched it, and of the repeated structures
+// which they formed, from which the same output dictionary can later be rebuilt. Steps recorded inside structures which fail to match
+// are removed again, in exactly the cases where parse_descend() rolls back its output dictionary.
+
+#define PARSE_STEP_ITEM       21100
+#define PARSE_STEP_LISTBEGIN  21101
+#define PARSE_STEP_BABYBEGIN  21102
+#define PARSE_STEP_BABYEND    21103
+#define PARSE_STEP_LISTEND    21104
+
+typedef struct ParseStep {
+  int         type;
+  ParserNode *node;
+  int         start, end; // Position of an ITEM on the line
+ } ParseStep;
+
+typedef struct ParseTrace {
+  ParseStep *steps;
+  int        N, Nalloc;
+  int        NEvaluations; // The number of algebraic expressions evaluated whilst parsing, including those in structures which failed to match
+  int        failed;
+ } ParseTrace;
+
+static ParseTrace *CurrentTrace = NULL;
+
+static void ParseTracePush(int type, ParserNode *node, int start, int end)
+ {
+  ParseStep *tmp;
+  if (CurrentTrace->N >= CurrentTrace->Nalloc)
+   {
+    tmp = (ParseStep *)realloc(CurrentTrace->steps, (CurrentTrace->Nalloc+32)*sizeof(ParseStep));
+    if (tmp==NULL) { CurrentTrace->failed=1; return; }
+    CurrentTrace->steps   = tmp;
+    CurrentTrace->Nalloc += 32;
+   }
+  CurrentTrace->steps[CurrentTrace->N].type  = type;
+  CurrentTrace->steps[CurrentTrace->N].node  = node;
+  CurrentTrace->steps[CurrentTrace->N].start = start;
+  CurrentTrace->steps[CurrentTrace->N].end   = end;
+  CurrentTrace->N++;
+  return;
+ }
+
+// Items whose values come from evaluating algebra, rather than from the text of the line alone
+static int ParseItemEvaluated(ParserNode *node)
+ {
+  char *m = node->MatchString;
+  if (node->ACLevel == -2) return 0;
+  return (strcmp(m,"%a")==0) || (strcmp(m,"%q")==0) || (strcmp(m,"%f")==0) || (strcmp(m,"%fi")==0) || (strcmp(m,"%fu")==0) || (strcmp(m,"%d")==0);
+ }
+
 // --------------------------------------------------------------------------
 // PART I: READ SYNTAX SPECIFICATION
 //
-// The syntaxes of PyXPlot commands are specified in gp_commands.
+// The syntaxes of PyXPlot commands are specified in ppl_commands.c.
 //
 // We make a tree structure -- a hierarchy of ParserNodes
 //
@@ -86,190 +138,22 @@ void parse_descend(ParserNode *node, char *line, int IterLevel, int *linepos, in
 // Only "item" and "rep" structures are allowed to return output variables "varname".
 // Upon parsing a line of user input, a dictionary is returned, containing the values of all these variables.
 
-// StartNewStructure(): This creates a child ParserNode within the present ParserNode.
+// The tree is built from the RE++ definitions in ppl_commands.c at compile time, by commands_generate.py, which writes it as static data into
+// ppl_parser_tables.h.
 
-// DefnStack is an array: item 0 is the top-level of the tree; item N is the current Nth leaf node that we are populating.
-
-void StartNewStructure(ParserNode **DefnStack, int *i, int type)
- {
-  ParserNode **target = NULL;
-  ParserNode  *NewNode = (ParserNode *)lt_malloc(sizeof(ParserNode));
+#include "ppl_parser_tables.h"
 
-  if (NewNode == NULL) { ppl_fatal(__FILE__,__LINE__,"Out of memory whilst setting up PyXPlot's command line parser."); exit(1); }
-
-  NewNode->type = type;
-  NewNode->MatchString = NULL;
-  NewNode->VarName     = NewNode->VarSetVal   = NULL;
-  NewNode->FirstChild  = NewNode->NextSibling = NULL;
-  NewNode->ACLevel = -1;
-
-  if ((*i)>0)
-   {
-    if ((DefnStack[(*i)-1]->type != PN_TYPE_SEQ) && (type != PN_TYPE_SEQ)) StartNewStructure(DefnStack, i, PN_TYPE_SEQ); // This new structure is actually the first in a possible sequence
-    target = &(DefnStack[(*i)-1]->FirstChild);
-    while (*target != NULL) target = &((*target)->NextSibling);
-    *target = NewNode; // Add new node into hierarchy
-   }
-  DefnStack[(*i)++] = NewNode; // ... and onto the stack describing our current position
- }
-
-// RollBack(): The opposite of the above... implements the closing bracket.
-// Finishes the present structure, which should be of type "type". Throws an error if it is not.
-// Note that "seq" structures are automatically closed without need for closing grammar.
-
-void RollBack(ParserNode **DefnStack, int *i, int type, char *PplCommandsText, int *NcharsTaken)
- {
-  int j=1; // First character of PplCommandsText is a closing bracket
-  int VarNameBegin=-1, VarNameEnd=-1;
-
-  while (((*i)>0) && (DefnStack[(*i)-1]->type == PN_TYPE_SEQ)) (*i)--; // Automatically close SEQs; they don't have closing grammar
-
-  if ((*i)<=0)
-   { sprintf(temp_err_string, "Incorrect nesting of types in command specification -- attempt to close an unopened bracket."); ppl_fatal(__FILE__,__LINE__, temp_err_string); }
-  else if (DefnStack[(*i)-1]->type != type)
-   { sprintf(temp_err_string, "Incorrect nesting of types in command specification -- expected %d, but got %d.", type, DefnStack[(*i)-1]->type); ppl_fatal(__FILE__,__LINE__, temp_err_string); }
-
-  if (PplCommandsText[j]==':') j++;
-  if ((PplCommandsText[j]=='@') && (type==PN_TYPE_REP)) { type=PN_TYPE_REP2; DefnStack[(*i)-1]->type=type; j++; } // A REP2 item
-  if (PplCommandsText[j]> ' ')
-   {
-    VarNameBegin = j;
-    while (PplCommandsText[j]> ' ') j++; // FFW over variable name
-    VarNameEnd   = j;
-   }
-  while ((PplCommandsText[j]!='\0') && (PplCommandsText[j]!='\n') && (PplCommandsText[j]<' ')) j++; // FFW over trailing whitespace
-
-  if (VarNameBegin > -1)
-   {
-    if ((DefnStack[(*i)-1]->VarName = (char *)lt_malloc((VarNameEnd-VarNameBegin+1)*sizeof(char)))==NULL) { ppl_fatal(__FILE__,__LINE__,"Out of memory whilst setting up PyXPlot's command line parser."); exit(1); }
-    strncpy( DefnStack[(*i)-1]->VarName , PplCommandsText+VarNameBegin , VarNameEnd-VarNameBegin );
-    DefnStack[(*i)-1]->VarName[VarNameEnd - VarNameBegin] = '\0';
-   }
-  DefnStack[(*i)-1]->VarSetVal = "\0"; // ITEM structures can do "exit:directive:quit" to store "quit" into variable "directive", but []s never do that.
-
-  (*i)--; // Close structure of type "type" and roll back stack.
-  *NcharsTaken = j;
-  return;
- }
-
-// ppl_commands_read(): This runs on startup to populate a list,
-// PplParserCmdList, with list-based definitions of PyXPlot's commands, parsed
-// using the functions above from plp_commands
+// ppl_commands_read(): This runs on startup to populate a list, PplParserCmdList, with the definitions of PyXPlot's commands, indexed by the
+// first letter of each command.
 
 static List *PplParserCmdList[27];
 
 void ppl_commands_read()
  {
-  int         InputPos = 0;
-  ParserNode *DefnStack[25];
-  int         StackPos;
-  int         i,j,k,l,m,n,N,cln;
-  ParserNode *NewNode;
-  ParserNode **target = NULL;
+  int i;
 
   for (i=0;i<27;i++) PplParserCmdList[i] = ListInit();
-  while (ppl_commands[InputPos] != '\0')
-   {
-    while ((ppl_commands[InputPos] != '\0') && (ppl_commands[InputPos] <= ' ')) InputPos++; // Ignore whitespace
-    if (ppl_commands[InputPos] == '\0') continue;
-    StackPos = 0;
-    if ((ppl_commands[InputPos]>='a')&&(ppl_commands[InputPos]<='z')) cln = (int)(ppl_commands[InputPos]-'a');
-    else                                                              cln = 26; // Begins with punctuation
-    StartNewStructure(DefnStack, &StackPos, PN_TYPE_SEQ);
-
-    while (1)
-     {
-      while ((ppl_commands[InputPos] != '\0') && (ppl_commands[InputPos] != '\n') && (ppl_commands[InputPos] <= ' ')) InputPos++; // Ignore whitespace
-      if ((ppl_commands[InputPos] == '\0') || (ppl_commands[InputPos] == '\n')) break; // Newline
-      if      (ppl_commands[InputPos] == '{') // {} grammar indicates an optional series of items, which go into a new structure.
-       { StartNewStructure(DefnStack, &StackPos, PN_TYPE_OPT); InputPos++; }
-      else if (ppl_commands[InputPos] == '[') // [] grammar indicates a series of items which repeat 0 or more times. These go into a new structure.
-       { StartNewStructure(DefnStack, &StackPos, PN_TYPE_REP); InputPos++; }
-      else if (ppl_commands[InputPos] == '(') // () grammar indicates items which can appear in any order, but each one not more than once. New structure.
-       { StartNewStructure(DefnStack, &StackPos, PN_TYPE_PER); InputPos++; }
-      else if (ppl_commands[InputPos] == '<') // <> grammar indicates a list of items of which only one should be matched. New structure.
-       { StartNewStructure(DefnStack, &StackPos, PN_TYPE_ORA); InputPos++; }
-      else if (ppl_commands[InputPos] == '~') // ~ is used inside () to separate items
-       {
-        while ((StackPos>=0) && (DefnStack[StackPos-1]->type == PN_TYPE_SEQ)) StackPos--; // Automatically close SEQs; they don't have closing grammar
-        if ((StackPos<0) || (DefnStack[StackPos-1]->type != PN_TYPE_PER)) ppl_fatal(__FILE__,__LINE__, "Tilda should be used only in permutation structures.");
-        InputPos++;
-       }
-      else if (ppl_commands[InputPos] == '|') // | is used inside <> for either/or items
-       {
-        while ((StackPos>=0) && (DefnStack[StackPos-1]->type == PN_TYPE_SEQ)) StackPos--; // Automatically close SEQs; they don't have closing grammar
-        if ((StackPos<0) || (DefnStack[StackPos-1]->type != PN_TYPE_ORA)) ppl_fatal(__FILE__,__LINE__, "Pipe alternatives should only be used inside ORA structures.");
-        InputPos++;
-       }
-      else if (ppl_commands[InputPos] == '>') // Match closing brackets for the above types
-       { RollBack(DefnStack, &StackPos, PN_TYPE_ORA, ppl_commands+InputPos, &j) ; InputPos+=j; }
-      else if (ppl_commands[InputPos] == ')')
-       { RollBack(DefnStack, &StackPos, PN_TYPE_PER, ppl_commands+InputPos, &j) ; InputPos+=j; }
-      else if (ppl_commands[InputPos] == ']')
-       { RollBack(DefnStack, &StackPos, PN_TYPE_REP, ppl_commands+InputPos, &j) ; InputPos+=j; }
-      else if (ppl_commands[InputPos] == '}')
-       { RollBack(DefnStack, &StackPos, PN_TYPE_OPT, ppl_commands+InputPos, &j) ; InputPos+=j; }
-      else
-       { // This word is a rare instance of a piece of RE++ syntax which is not grammar
-        if (ppl_commands[InputPos] == '\\') InputPos++; // Escape character put at the beginnings of words are ignored; they allow them to begin with punctuation e.g. "["
-        if (DefnStack[StackPos-1]->type != PN_TYPE_SEQ) StartNewStructure(DefnStack, &StackPos, PN_TYPE_SEQ); // Match words have to go in sequences, not, e.g. "ora" structures
-        // i     j N  k   l  m   n
-        // foobar @3: plob : bolp
-        k=l=m=n=N=-1; // ACL of -1 means no ACL specified
-        i=InputPos;
-        while ((ppl_commands[InputPos] > ' ') && (ppl_commands[InputPos] !='@') && ((ppl_commands[InputPos] !=':')||(i==InputPos))) InputPos++;
-        j=InputPos;
-        if (j==i) ppl_fatal(__FILE__,__LINE__,"ppl_parser found a word of zero length. This should never happen.");
-        if (ppl_commands[InputPos] == '@')
-         {
-          InputPos++;
-          if (ppl_commands[InputPos] == 'n') { N=-2 ; k=1; } // ACL of -2 means @n mode
-          else N = (int)GetFloat(ppl_commands+InputPos , &k);
-          InputPos+=k; k=-1;
-         }
-        if (ppl_commands[InputPos] == ':')
-         {
-          k = ++InputPos;
-          while ((ppl_commands[InputPos] > ' ') && (ppl_commands[InputPos] != ':')) InputPos++;
-          l = InputPos;
-         }
-        if (ppl_commands[InputPos] == ':')
-         {
-          m = ++InputPos;
-          while ((ppl_commands[InputPos] > ' ') && (ppl_commands[InputPos] != ':')) InputPos++;
-          n = InputPos;
-         }
-        if ((NewNode = (ParserNode *)lt_malloc(sizeof(ParserNode)))==NULL) { ppl_fatal(__FILE__,__LINE__,"Out of memory whilst setting up PyXPlot's command line parser."); exit(1); }
-        NewNode->type    = PN_TYPE_ITEM;
-        NewNode->ACLevel = N;
-
-        if ((NewNode->MatchString = (char *)lt_malloc((j-i+1)*sizeof(char)))==NULL) { ppl_fatal(__FILE__,__LINE__,"Out of memory whilst setting up PyXPlot's command line parser."); exit(1); }
-        strncpy(NewNode->MatchString, ppl_commands + i, j-i);
-        NewNode->MatchString[j-i]='\0';
-        if (k>0)
-         {
-           if ((NewNode->VarName = (char *)lt_malloc((l-k+1)*sizeof(char)))==NULL) { ppl_fatal(__FILE__,__LINE__,"Out of memory whilst setting up PyXPlot's command line parser."); exit(1); }
-           strncpy(NewNode->VarName, ppl_commands + k, l-k);
-           NewNode->VarName[l-k]='\0';
-          }
-        else
-         { NewNode->VarName = NULL; }
-        if (m>0)
-         {
-          if ((NewNode->VarSetVal = (char *)lt_malloc((n-m+1)*sizeof(char)))==NULL) { ppl_fatal(__FILE__,__LINE__,"Out of memory whilst setting up PyXPlot's command line parser."); exit(1); }
-          strncpy(NewNode->VarSetVal, ppl_commands + m, n-m);
-          NewNode->VarSetVal[n-m]='\0';
-         }
-        else
-         { NewNode->VarSetVal = NULL; }
-        NewNode->FirstChild = NewNode->NextSibling = NULL;
-        target = &(DefnStack[StackPos-1]->FirstChild);
-        while (*target != NULL) target = &((*target)->NextSibling);
-        *target = NewNode; // Add new node into hierarchy
-       }
-     }
-    ListAppendPtr(PplParserCmdList[cln], DefnStack[0], sizeof(ParserNode), 0, DATATYPE_VOID);
-   }
+  for (i=0;i<PPL_PARSER_NCMDS;i++) ListAppendPtr(PplParserCmdList[PplParserCmdLetters[i]], PplParserNodes+PplParserCmdRoots[i], sizeof(ParserNode), 0, DATATYPE_VOID);
   return;
  }
 
@@ -288,7 +172,7 @@ void ppl_parser_bnreset()
   return;
  }
 
-Dict *parse(char *line, int IterLevel)
+static Dict *parse_main(char *line, int IterLevel)
  {
   ListIterator *CmdIterator;
   ParserNode   *CmdDescriptor;
@@ -366,6 +250,7 @@ Dict *parse(char *line, int IterLevel)
     AlgebraError[0] = '\0';
     AlgebraNewError[0] = '\0';
     output          = DictInit(HASHSIZE_SMALL);
+    if (CurrentTrace != NULL) CurrentTrace->N = 0;
 
     parse_descend(CmdDescriptor, line, IterLevel, &linepos, NULL, NULL, expecting, &ExpectingPos, &ExpectingLinePos,
                   AlgebraError, &AlgebraLinepos, AlgebraNewError, &AlgebraNewLinepos, output, &match, &success);
@@ -420,6 +305,182 @@ Dict *parse(char *line, int IterLevel)
   return output;
  }
 
+// Parse a line, keeping a trace of how it matched in trace, if not NULL. Any lines parsed recursively whilst evaluating algebra are not traced.
+static Dict *parse_traced(char *line, int IterLevel, ParseTrace *trace)
+ {
+  ParseTrace *OldTrace = CurrentTrace;
+  Dict       *output;
+
+  CurrentTrace = trace;
+  output = parse_main(line, IterLevel);
+  CurrentTrace = OldTrace;
+  return output;
+ }
+
+Dict *parse(char *line, int IterLevel)
+ {
+  return parse_traced(line, IterLevel, NULL);
+ }
+
+// PARSE_REPLAY(): Rebuild the output dictionary for a line from a trace recorded when it was last parsed. Algebraic items are re-evaluated,
+// since the values of variables may have changed, and NULL is returned if any of them no longer evaluates to something of the same length
+// which passes the checks made by parse_descend(). No error messages are produced; the caller falls back upon a full parse in this case.
+
+#define PARSE_REPLAY_DEPTH 64
+
+static Dict *parse_replay(char *line, int IterLevel, ParsedCommand *cmd)
+ {
+  Dict      *DictStack[PARSE_REPLAY_DEPTH];
+  List      *ListStack[PARSE_REPLAY_DEPTH];
+  int        ND=0, NL=0, k, i, errpos, MatchType;
+  char      *errtext=NULL, *buffer=NULL, *m, *VarName;
+  ParseStep *step;
+  struct {int _int; char *_str; value _val; } MatchVal;
+
+  DictStack[ND++] = DictInit(HASHSIZE_SMALL);
+  for (k=0; k<cmd->NSteps; k++)
+   {
+    step = cmd->steps + k;
+    if      (step->type == PARSE_STEP_LISTBEGIN) { if (NL>=PARSE_REPLAY_DEPTH) return NULL; ListStack[NL++] = ListInit(); continue; }
+    else if (step->type == PARSE_STEP_BABYBEGIN) { if (ND>=PARSE_REPLAY_DEPTH) return NULL; DictStack[ND++] = DictInit(HASHSIZE_SMALL); continue; }
+    else if (step->type == PARSE_STEP_BABYEND  ) { if ((ND<2)||(NL<1)) return NULL; ND--; ListAppendDict(ListStack[NL-1], DictStack[ND]); continue; }
+    else if (step->type == PARSE_STEP_LISTEND  ) { if ((ND<1)||(NL<1)) return NULL; NL--; DictAppendList(DictStack[ND-1], step->node->VarName, ListStack[NL]); continue; }
+
+    m         = step->node->MatchString;
+    VarName   = step->node->VarName;
+    MatchType = 0;
+
+    if (ParseItemEvaluated(step->node))
+     {
+      if ((errtext==NULL) && ((errtext=(char *)lt_malloc(LSTR_LENGTH))==NULL)) return NULL;
+      if ((buffer ==NULL) && ((buffer =(char *)lt_malloc(LSTR_LENGTH))==NULL)) return NULL;
+      i=-1; errpos=-1;
+      if (strcmp(m,"%q")==0)
+       {
+        ppl_GetQuotedString(line, buffer, step->start, &i, 0, &errpos, errtext, IterLevel);
+        if ((errpos>=0) || (i!=step->end)) return NULL;
+        MatchType = DATATYPE_STRING; MatchVal._str = buffer;
+       }
+      else if (strcmp(m,"%a")==0)
+       {
+        buffer[0] = tolower(line[step->start]);
+        ppl_EvaluateAlgebra(line, &MatchVal._val, step->start+1, &i, 0, &errpos, errtext, IterLevel);
+        if (errpos>=0) { strcpy(buffer+1, "1"); i=step->start+1; }
+        else
+         {
+          if ((MatchVal._val.dimensionless==0) || (MatchVal._val.FlagComplex==1) || (!gsl_finite(MatchVal._val.real)) ||
+              (MatchVal._val.real>=INT_MAX) || (MatchVal._val.real>=MAX_AXES) || (MatchVal._val.real<1)) return NULL;
+          sprintf(buffer+1, "%d", (int)floor(MatchVal._val.real));
+         }
+        if (i!=step->end) return NULL;
+        MatchType = DATATYPE_STRING; MatchVal._str = buffer;
+       }
+      else
+       {
+        ppl_EvaluateAlgebra(line, &MatchVal._val, step->start, &i, 0, &errpos, errtext, IterLevel);
+        if ((errpos>=0) || (i!=step->end)) return NULL;
+        if ((strcmp(m,"%fi")!=0) && (strcmp(m,"%fu")!=0) && (MatchVal._val.dimensionless == 0)) return NULL;
+        if ((strcmp(m,"%fi")!=0) && (MatchVal._val.FlagComplex == 1)) return NULL;
+        if (strcmp(m,"%d")==0)
+         {
+          if ((!gsl_finite(MatchVal._val.real)) || (MatchVal._val.real<=INT_MIN) || (MatchVal._val.real>=INT_MAX)) return NULL;
+          MatchVal._int = (int)floor(MatchVal._val.real);
+          MatchType     = DATATYPE_INT;
+         }
+        else if (strcmp(m,"%f")==0) MatchType = DATATYPE_FLOAT;
+        else                        MatchType = DATATYPE_VALUE;
+       }
+     }
+    else if ((step->node->ACLevel != -2) && ((strcmp(m,"%r")==0) || (strcmp(m,"%s")==0) || (strcmp(m,"%S")==0) || (strcmp(m,"%Q")==0) ||
+                                             (strcmp(m,"%v")==0) || (strcmp(m,"%e")==0) || (strcmp(m,"%E")==0)))
+     {
+      if ((buffer==NULL) && ((buffer=(char *)lt_malloc(LSTR_LENGTH))==NULL)) return NULL;
+      strncpy(buffer, line+step->start, step->end-step->start);
+      buffer[step->end-step->start] = '\0';
+      MatchType = DATATYPE_STRING; MatchVal._str = buffer;
+     }
+    else if ((step->node->ACLevel == -2) || (strcmp(m,"=")!=0))
+     {
+      MatchType = DATATYPE_STRING; MatchVal._str = m;
+     }
+
+    if ((VarName == NULL) || (VarName[0] == '\0')) continue;
+    if ((step->node->VarSetVal != NULL) && (step->node->VarSetVal[0] != '\0'))  DictAppendString(DictStack[ND-1], VarName, step->node->VarSetVal);
+    else if (MatchType == DATATYPE_INT)    DictAppendInt   (DictStack[ND-1], VarName, MatchVal._int     );
+    else if (MatchType == DATATYPE_FLOAT)  DictAppendFloat (DictStack[ND-1], VarName, MatchVal._val.real);
+    else if (MatchType == DATATYPE_VALUE)  DictAppendValue (DictStack[ND-1], VarName, MatchVal._val     );
+    else if (MatchType == DATATYPE_STRING) DictAppendString(DictStack[ND-1], VarName, MatchVal._str     );
+   }
+  if ((ND!=1) || (NL!=0)) return NULL;
+  return DictStack[0];
+ }
+
+// PARSE_CACHED(): Parse a line which is likely to be executed many times, for example within a loop, using and maintaining a list of traces of
+// how lines have previously been parsed in *cache. New entries in the list are allocated in memory context context, which should last as long
+// as the line itself. Lines whose parsing involves evaluating algebra in structures which are then rolled back, or calling subroutines, whose
+// side effects should not be repeated if a replay fails part way through, or which fail to replay too often, are always parsed in full.
+
+#define PARSE_CACHE_MAXLINES    8
+#define PARSE_CACHE_MAXFAILURES 4
+
+Dict *parse_cached(char *line, int IterLevel, ParsedCommand **cache, int context)
+ {
+  ParsedCommand *item;
+  ParseTrace     trace;
+  Dict          *output;
+  char          *directive;
+  int            i, NEvaluated, Nitems=0;
+  long int       NSubroutineCalls;
+
+  for (item=*cache; item!=NULL; item=item->next, Nitems++) if (strcmp(item->line, line)==0) break;
+
+  if ((item!=NULL) && (item->NSteps>=0))
+   {
+    output = parse_replay(line, IterLevel, item);
+    if (output != NULL) return output;
+    if (DEBUG) { sprintf(temp_err_string, "Cached parse of line <%s> could not be replayed; parsing it in full.", line); ppl_log(temp_err_string); }
+    if (++item->failures >= PARSE_CACHE_MAXFAILURES) item->NSteps = -1;
+   }
+  if (((item!=NULL) && (item->NSteps<0)) || ((item==NULL) && (Nitems>=PARSE_CACHE_MAXLINES))) return parse(line, IterLevel);
+
+  trace.steps = NULL; trace.N = trace.Nalloc = trace.NEvaluations = trace.failed = 0;
+  NSubroutineCalls = PPL_FLOWCTRL_SUBROUTINECALLS;
+  output = parse_traced(line, IterLevel, &trace);
+  if (PPL_FLOWCTRL_SUBROUTINECALLS != NSubroutineCalls) trace.failed = 1;
+
+  if (output != NULL)
+   {
+    if (item == NULL)
+     {
+      item = (ParsedCommand *)lt_malloc_incontext(sizeof(ParsedCommand), context);
+      if (item != NULL)
+       {
+        item->line = (char *)lt_malloc_incontext(strlen(line)+1, context);
+        if (item->line == NULL) item = NULL;
+       }
+      if (item != NULL)
+       {
+        strcpy(item->line, line);
+        item->NSteps   = -1;
+        item->failures = 0;
+        item->steps    = NULL;
+        item->next     = *cache;
+        *cache         = item;
+       }
+     }
+    for (i=0, NEvaluated=0; i<trace.N; i++) if ((trace.steps[i].type==PARSE_STEP_ITEM) && ParseItemEvaluated(trace.steps[i].node)) NEvaluated++;
+    DictLookup(output, "directive", NULL, (void *)&directive);
+    if ((item != NULL) && (!trace.failed) && (NEvaluated == trace.NEvaluations) && ((directive == NULL) || (strcmp(directive, "unrecognised")!=0)))
+     {
+      item->steps = (ParseStep *)lt_malloc_incontext((trace.N>0?trace.N:1)*sizeof(ParseStep), context);
+      if (item->steps != NULL) { memcpy(item->steps, trace.steps, trace.N*sizeof(ParseStep)); item->NSteps = trace.N; }
+     }
+    else if (item != NULL) item->NSteps = -1;
+   }
+  if (trace.steps != NULL) free(trace.steps);
+  return output;
+ }
+
 // PARSE_AUTOCOMPLETE(): Make suggestion for words which could come next. number gives the nth possible word.
 
 #ifdef HAVE_READLINE
@@ -555,7 +616,8 @@ void parse_descend(ParserNode *node, char *line, int IterLevel, int *linepos, in
                    Dict *output, int *match, int *success)
  {
   unsigned char repeating=0, first=0;
-  int MatchType=0, LinePosOld=-1, excluded[PER_MAXSIZE], i, j, ACLevel, OutContext, TempContext=0, OwnContext=0, bnd_old;
+  int MatchType=0, LinePosOld=-1, excluded[PER_MAXSIZE], i, j, ACLevel, OutContext, TempContext=0, OwnContext=0, bnd_old, ItemStart, TraceMark=0;
+  ParseTrace *trace = (start==NULL) ? CurrentTrace : NULL;
   struct {int _int; char *_str; value _val; } MatchVal;
   char *varname, *TempMatchStr, SeparatorString[4], QuoteType;
   unsigned char DummyStatus[ALGEBRA_MAXLENGTH];
@@ -571,6 +633,7 @@ void parse_descend(ParserNode *node, char *line, int IterLevel, int *linepos, in
 
   while ((line[*linepos]!='\0') && (line[*linepos]<=' ')) (*linepos)++; // FFW over spaces
   *success = 1; // We are successful until proven otherwise
+  ItemStart = *linepos;
 
 #define BND_QUIT if (OwnContext) { _lt_SetMemContext(TempContext); lt_AscendOutOfContext(TempContext); } bnd=bnd_old;
 
@@ -694,6 +757,7 @@ NO_TAB_COMPLETION:
        {
         i=-1;
         *AlgebraNewLinepos=-1;
+        if (trace != NULL) trace->NEvaluations++;
         ppl_GetQuotedString(line, TempMatchStr, *linepos, &i, 0, AlgebraNewLinepos, AlgebraNewError, IterLevel);
         if (*AlgebraNewLinepos >= 0)
          {
@@ -783,6 +847,7 @@ NO_TAB_COMPLETION:
           (*linepos)++;
           i = -1;
           *AlgebraNewLinepos = -1;
+          if (trace != NULL) trace->NEvaluations++;
           ppl_EvaluateAlgebra(line, &MatchVal._val, *linepos, &i, 0, AlgebraNewLinepos, AlgebraNewError, IterLevel);
           if (*AlgebraNewLinepos >= 0)
            {
@@ -875,6 +940,7 @@ NO_TAB_COMPLETION:
        {
         i = -1;
         *AlgebraNewLinepos=-1;
+        if (trace != NULL) trace->NEvaluations++;
         ppl_EvaluateAlgebra(line, &MatchVal._val, *linepos, &i, 0, AlgebraNewLinepos, AlgebraNewError, IterLevel);
         if (*AlgebraNewLinepos >= 0)
          {
@@ -948,6 +1014,7 @@ NO_TAB_COMPLETION:
        {
         expecting[0]   = '\0'; *ExpectingPos  =0;
         AlgebraError[0]= '\0'; *AlgebraLinepos=-1;
+        if ((trace != NULL) && (((node->VarName != NULL) && (node->VarName[0] != '\0')) || ParseItemEvaluated(node))) ParseTracePush(PARSE_STEP_ITEM, node, ItemStart, *linepos);
         if ((node->VarName     != NULL) && (node->VarName[0]    != '\0'))
          {
           if ((node->VarSetVal != NULL) && (node->VarSetVal[0]  != '\0'))  DictAppendString(output , node->VarName , node->VarSetVal);
@@ -1002,6 +1069,7 @@ NO_TAB_COMPLETION:
    {
     repeating = 1; first = 1;
     if (output != NULL) DictBabyList = ListInit();
+    if (trace != NULL) { TraceMark = trace->N; ParseTracePush(PARSE_STEP_LISTBEGIN, node, 0, 0); }
     SeparatorString[0] = node->VarName[strlen(node->VarName)-1];
     if ((SeparatorString[0]!=',')&&(SeparatorString[0]!=':')) SeparatorString[0]='\0';
     SeparatorString[1] = '\0';
@@ -1009,7 +1077,9 @@ NO_TAB_COMPLETION:
     while (repeating != 0)
      {
       ParserNode SeparatorNode;
+      int        BabyMark = (trace != NULL) ? trace->N : 0;
       if (output != NULL) DictBaby = DictInit(HASHSIZE_SMALL);
+      if (trace  != NULL) ParseTracePush(PARSE_STEP_BABYBEGIN, node, 0, 0);
       LinePosOld = *linepos;
       SeparatorNode.type        = PN_TYPE_ITEM;
       SeparatorNode.ACLevel     = -2;
@@ -1046,14 +1116,17 @@ NO_TAB_COMPLETION:
        }
       if  (repeating!=0)                      { first = 0; }
       if ((repeating!=0) && (output != NULL)) { ListAppendDict(DictBabyList, DictBaby); }
+      if  (trace != NULL) { if (repeating!=0) ParseTracePush(PARSE_STEP_BABYEND, node, 0, 0); else trace->N = BabyMark; }
      }
     if (first==0) { if (output != NULL) DictAppendList(output , node->VarName , DictBabyList); } // Only append list if we matched at least once
     else if (node->type == PN_TYPE_REP) *success=0; // We needed at least one item, but got none
+    if (trace != NULL) { if (first==0) ParseTracePush(PARSE_STEP_LISTEND, node, 0, 0); else trace->N = TraceMark; }
    }
   else if (node->type == PN_TYPE_OPT)
    {
     LinePosOld = *linepos;
     if (output != NULL) OutputOld = DictCopy(output,1);
+    if (trace  != NULL) TraceMark = trace->N;
     NodeIter = node->FirstChild;
     while (NodeIter != NULL)
      {
@@ -1063,6 +1136,7 @@ NO_TAB_COMPLETION:
       if (*success==0)
        {
         if ((output != NULL)&&(*linepos!=LinePosOld)) *output = *OutputOld; // Don't need to do another deepcopy; just overwrite top Dict struct
+        if ((trace  != NULL)&&(*linepos!=LinePosOld)) trace->N = TraceMark;
         *linepos = LinePosOld;
         *success = 1; // Optional items are allowed to fail
         break;
@@ -1079,6 +1153,7 @@ NO_TAB_COMPLETION:
       repeating  = 0; // Unless we find an item on the list which succeeds, we don't want to loop again
       LinePosOld = *linepos;
       if (output != NULL) OutputOld = DictCopy(output,1);
+      if (trace  != NULL) TraceMark = trace->N;
       NodeIter = node->FirstChild; i=0;
       while (NodeIter != NULL)
        {
@@ -1096,6 +1171,7 @@ NO_TAB_COMPLETION:
               *output   = *OutputOld; // Don't need to do another deepcopy; just overwrite top Dict struct
               OutputOld = DictCopy(output,1);
              }
+            if ((trace  != NULL)&&(*linepos!=LinePosOld)) trace->N = TraceMark;
             *linepos = LinePosOld;
             *success = 1; // The failure of one item doesn't matter... all PER items are optional.
            }
@@ -1108,6 +1184,7 @@ NO_TAB_COMPLETION:
    {
     LinePosOld = *linepos;
     if (output != NULL) OutputOld = DictCopy(output,1);
+    if (trace  != NULL) TraceMark = trace->N;
     NodeIter = node->FirstChild;
     while (NodeIter != NULL)
      {
@@ -1122,6 +1199,7 @@ NO_TAB_COMPLETION:
           *output   = *OutputOld; // Don't need to do another deepcopy; just overwrite top Dict struct
           OutputOld = DictCopy(output,1);
          }
+        if ((trace  != NULL)&&(*linepos!=LinePosOld)) trace->N = TraceMark;
         *linepos = LinePosOld;
        }
       else break; // We've found an ORA item which worked
@@ -25,9 +25,20 @@
 #include "ListTools/lt_list.h"
 #include "ListTools/lt_dict.h"
 
+// A list of traces of how the lines executed by a loop or subroutine were parsed, which parse_cached() uses to avoid parsing them afresh
+
+typedef struct ParsedCommand {
+  char                 *line;
+  int                   NSteps;   // -1 if this line must always be parsed in full
+  int                   failures; // The number of times the trace has failed to replay
+  struct ParseStep     *steps;
+  struct ParsedCommand *next;
+ } ParsedCommand;
+
 void   ppl_commands_read();
 void   ppl_parser_bnreset();
 Dict  *parse             (char *line, int IterLevel);
+Dict  *parse_cached      (char *line, int IterLevel, ParsedCommand **cache, int context);
 char **ppl_rl_completion (const char *text, int start, int end);
 
 #endif
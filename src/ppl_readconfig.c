@@ -207,6 +207,11 @@ void ReadConfigFile(char *ConfigFname)
 
       DO_CRANGE(0,"1")  DO_CRANGE(1,"2")  DO_CRANGE(2,"3")  DO_CRANGE(3,"4")
 
+      else if (strcmp(setkey, "DATACACHE"    )==0)
+        if  (fl=GetFloat(setvalue, &i), ((gsl_finite(fl))&&(i==strlen(setvalue))&&(fl>=0.0)))   settings_term_default .DataCache     = fl;
+        else {sprintf(temp_err_string, "Error in line %d of configuration file %s: Illegal value for setting DataCache."    , linecounter, ConfigFname); ppl_warning(ERR_PREFORMED, temp_err_string); continue; }
+      else if (strcmp(setkey, "DATACACHEDIR" )==0)
+        { strncpy(settings_term_default.DataCacheDir , setvalue, FNAME_LENGTH-4); settings_term_default.DataCacheDir[FNAME_LENGTH-4]='\0'; }
       else if (strcmp(setkey, "DATASTYLE"    )==0)
         if ((i=FetchSettingByName(setvalue,SW_STYLE_INT, SW_STYLE_STR ))>0)                      settings_graph_default.DataStyle.style = i;
         else {sprintf(temp_err_string, "Error in line %d of configuration file %s: Illegal value for setting DataStyle."    , linecounter, ConfigFname); ppl_warning(ERR_PREFORMED, temp_err_string); continue; }
@@ -354,9 +359,15 @@ void ReadConfigFile(char *ConfigFname)
       else if (strcmp(setkey, "ENLARGE"      )==0) // ENLARGE, as opposed to TERMENLARGE is supported for back-compatibility with PyXPlot 0.7
         if ((i=FetchSettingByName(setvalue,SW_ONOFF_INT, SW_ONOFF_STR ))>0)                      settings_term_default .TermEnlarge   = i;
         else {sprintf(temp_err_string, "Error in line %d of configuration file %s: Illegal value for setting Enlarge."      , linecounter, ConfigFname); ppl_warning(ERR_PREFORMED, temp_err_string); continue; }
+      else if (strcmp(setkey, "TERMFRAMES"   )==0)
+        if ((i=FetchSettingByName(setvalue,SW_ONOFF_INT, SW_ONOFF_STR ))>0)                      settings_term_default .TermFrames = i;
+        else {sprintf(temp_err_string, "Error in line %d of configuration file %s: Illegal value for setting TermFrames."   , linecounter, ConfigFname); ppl_warning(ERR_PREFORMED, temp_err_string); continue; }
       else if (strcmp(setkey, "TERMINVERT"   )==0)
         if ((i=FetchSettingByName(setvalue,SW_ONOFF_INT, SW_ONOFF_STR ))>0)                      settings_term_default .TermInvert = i;
         else {sprintf(temp_err_string, "Error in line %d of configuration file %s: Illegal value for setting TermInvert."   , linecounter, ConfigFname); ppl_warning(ERR_PREFORMED, temp_err_string); continue; }
+      else if (strcmp(setkey, "TERMRASTERISE")==0)
+        if ((i=FetchSettingByName(setvalue,SW_ONOFF_INT, SW_ONOFF_STR ))>0)                      settings_term_default .TermRaster = i;
+        else {sprintf(temp_err_string, "Error in line %d of configuration file %s: Illegal value for setting TermRasterise.", linecounter, ConfigFname); ppl_warning(ERR_PREFORMED, temp_err_string); continue; }
       else if (strcmp(setkey, "TERMTRANSPARENT")==0)
         if ((i=FetchSettingByName(setvalue,SW_ONOFF_INT, SW_ONOFF_STR ))>0)                      settings_term_default .TermTransparent= i;
         else {sprintf(temp_err_string, "Error in line %d of configuration file %s: Illegal value for setting TermTransparent.",linecounter,ConfigFname); ppl_warning(ERR_PREFORMED, temp_err_string); continue; }
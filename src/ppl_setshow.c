@@ -39,6 +39,7 @@
 #include "ppl_canvasitems.h"
 #include "ppl_children.h"
 #include "ppl_constants.h"
+#include "ppl_datafile.h"
 #include "ppl_error.h"
 #include "ppl_flowctrl.h"
 #include "ppl_papersize.h"
@@ -640,6 +641,25 @@ void directive_set(Dict *command)
     sg->Crenorm[c]  = settings_graph_default.Crenorm[c];
     sg->Creverse[c] = settings_graph_default.Creverse[c];
    }
+  else if (strcmp_set && (strcmp(setoption,"datacache")==0)) /* set datacache */
+   {
+    DictLookup(command,"flush",NULL,(void *)&tempstr);
+    if (tempstr != NULL) { DataFile_CacheFlush(); return; }
+    DictLookup(command,"directory",NULL,(void *)&tempstr);
+    if (tempstr != NULL) { strncpy(settings_term_current.DataCacheDir, tempstr, FNAME_LENGTH-4); settings_term_current.DataCacheDir[FNAME_LENGTH-4]='\0'; return; }
+    DictLookup(command,"nodirectory",NULL,(void *)&tempstr);
+    if (tempstr != NULL) { settings_term_current.DataCacheDir[0]='\0'; return; }
+    DictLookup(command,"datacache_size",NULL,(void *)&tempdbl);
+    if ((!gsl_finite(*tempdbl)) || (*tempdbl < 0)) { ppl_error(ERR_GENERAL, -1, -1, "The amount of memory given to the 'set datacache' command must be a finite number of megabytes, or zero to disable the cache."); return; }
+    settings_term_current.DataCache = *tempdbl;
+    DataFile_CacheTrim();
+   }
+  else if (strcmp_unset && (strcmp(setoption,"datacache")==0)) /* unset datacache */
+   {
+    settings_term_current.DataCache = settings_term_default.DataCache;
+    strcpy(settings_term_current.DataCacheDir, settings_term_default.DataCacheDir);
+    DataFile_CacheTrim();
+   }
   else if (strcmp_set && (strcmp(setoption,"display")==0)) /* set display */
    {
     settings_term_current.display = SW_ONOFF_ON;
@@ -1660,6 +1680,10 @@ void directive_set(Dict *command)
     if (tempstr != NULL) settings_term_current.TermTransparent = FetchSettingByName(tempstr, SW_ONOFF_INT, SW_ONOFF_STR);
     DictLookup(command,"invert" ,NULL,(void *)&tempstr);
     if (tempstr != NULL) settings_term_current.TermInvert      = FetchSettingByName(tempstr, SW_ONOFF_INT, SW_ONOFF_STR);
+    DictLookup(command,"raster" ,NULL,(void *)&tempstr);
+    if (tempstr != NULL) settings_term_current.TermRaster      = FetchSettingByName(tempstr, SW_ONOFF_INT, SW_ONOFF_STR);
+    DictLookup(command,"frames" ,NULL,(void *)&tempstr);
+    if (tempstr != NULL) settings_term_current.TermFrames      = FetchSettingByName(tempstr, SW_ONOFF_INT, SW_ONOFF_STR);
    }
   else if (strcmp_unset && (strcmp(setoption,"terminal")==0)) /* unset terminal */
    {
@@ -1669,7 +1693,9 @@ void directive_set(Dict *command)
     settings_term_current.TermAntiAlias  = settings_term_default.TermAntiAlias;
     settings_term_current.TermType       = settings_term_default.TermType;
     settings_term_current.TermEnlarge    = settings_term_default.TermEnlarge;
+    settings_term_current.TermFrames     = settings_term_default.TermFrames;
     settings_term_current.TermInvert     = settings_term_default.TermInvert;
+    settings_term_current.TermRaster     = settings_term_default.TermRaster;
     settings_term_current.TermTransparent= settings_term_default.TermTransparent;
    }
   else if (strcmp_set && (strcmp(setoption,"texthalign")==0)) /* set texthalign */
@@ -2771,6 +2797,19 @@ int directive_show2(char *word, char *ItemSet, int interactive, settings_graph *
       i += strlen(out+i) ; p=1;
      }
    }
+  if ((StrAutocomplete(word, "settings", 1)>=0) || (StrAutocomplete(word, "datacache", 1)>=0))
+   {
+    long int Nentries, bytes, hits, misses;
+    DataFile_CacheStatus(&Nentries, &bytes, &hits, &misses);
+    sprintf(buf, "%s", (char *)NumericDisplay(settings_term_current.DataCache,0,settings_term_current.SignificantFigures,(settings_term_current.NumDisplay==SW_DISPLAY_L)));
+    sprintf(buf2, "The number of megabytes of memory used to keep copies of recently-read datafiles; %ld files (%.1f MB) are presently held, and %ld of %ld reads have used them", Nentries, bytes/1048576.0, hits, hits+misses);
+    directive_show3(out+i, ItemSet, 0, interactive, "datacache", buf, (settings_term_default.DataCache == settings_term_current.DataCache), buf2);
+    i += strlen(out+i) ; p=1;
+    if (settings_term_current.DataCacheDir[0]=='\0') { sprintf(buf, "nodirectory"); bufp = "datacache"; }
+    else                                              { StrEscapify(settings_term_current.DataCacheDir, buf); bufp = "datacache directory"; }
+    directive_show3(out+i, ItemSet, 0, interactive, bufp, buf, (strcmp(settings_term_default.DataCacheDir,settings_term_current.DataCacheDir)==0), "Directory in which binary copies of datafiles are kept, so that other PyXPlot processes need not parse them again");
+    i += strlen(out+i) ; p=1;
+   }
   if ((StrAutocomplete(word, "settings", 1)>=0) || (StrAutocomplete(word, "display", 1)>=0))
    {
     sprintf(buf, "%s", *(char **)FetchSettingName(settings_term_current.display, SW_ONOFF_INT, (void *)SW_ONOFF_STR, sizeof(char *)));
@@ -3052,6 +3091,18 @@ int directive_show2(char *word, char *ItemSet, int interactive, settings_graph *
     directive_show3(out+i, ItemSet, 0, interactive, "terminal", buf, (settings_term_default.landscape==settings_term_current.landscape), "Selects the orientation of output");
     i += strlen(out+i) ; p=1;
    }
+  if ((StrAutocomplete(word, "settings", 1)>=0) || (StrAutocomplete(word, "terminal", 1)>=0) || (StrAutocomplete(word, "frames", 1)>=0))
+   {
+    sprintf(buf, "%s", *(char **)FetchSettingName(settings_term_current.TermFrames, SW_ONOFF_INT, (void *)SW_ONOFF_STR, sizeof(char *)));
+    directive_show3(out+i, ItemSet, 0, interactive, "terminal frames", buf, (settings_term_default.TermFrames==settings_term_current.TermFrames), "Selects whether successive bitmap plots are written to numbered frame files, through a single ghostscript process");
+    i += strlen(out+i) ; p=1;
+   }
+  if ((StrAutocomplete(word, "settings", 1)>=0) || (StrAutocomplete(word, "terminal", 1)>=0) || (StrAutocomplete(word, "rasterise", 1)>=0) || (StrAutocomplete(word, "rasterize", 1)>=0))
+   {
+    sprintf(buf, "%s", *(char **)FetchSettingName(settings_term_current.TermRaster, SW_ONOFF_INT, (void *)SW_ONOFF_STR, sizeof(char *)));
+    directive_show3(out+i, ItemSet, 0, interactive, "terminal rasterise", buf, (settings_term_default.TermRaster==settings_term_current.TermRaster), "Selects whether png and jpeg output is rasterised by PyXPlot itself, rather than by ghostscript");
+    i += strlen(out+i) ; p=1;
+   }
   if ((StrAutocomplete(word, "settings", 1)>=0) || (StrAutocomplete(word, "terminal", 1)>=0) || (StrAutocomplete(word, "transparent", 1)>=0) || (StrAutocomplete(word, "solid", 1)>=0))
    {
     sprintf(buf, "%s", *(char **)FetchSettingName(settings_term_current.TermTransparent, SW_ONOFF_INT, (void *)SW_ONOFF_STR, sizeof(char *)));
@@ -37,6 +37,7 @@
 #include "EPSMaker/eps_colours.h"
 
 #include "ppl_constants.h"
+#include "ppl_datafile.h"
 #include "ppl_error.h"
 #include "ppl_papersize.h"
 #include "ppl_passwd.h"
@@ -101,6 +102,8 @@ void ppl_settings_makedefault()
   settings_term_default.CalendarOut         = SW_CALENDAR_BRITISH;
   settings_term_default.colour              = SW_ONOFF_ON;
   settings_term_default.ComplexNumbers      = SW_ONOFF_OFF;
+  settings_term_default.DataCache           = DATAFILE_CACHE_DEFAULT_MB;
+  strcpy(settings_term_default.DataCacheDir, "");
   settings_term_default.display             = SW_ONOFF_ON;
   settings_term_default.dpi                 = 300.0;
   settings_term_default.ExplicitErrors      = SW_ONOFF_ON;
@@ -122,6 +125,8 @@ void ppl_settings_makedefault()
   settings_term_default.TermType            = SW_TERMTYPE_X11S;
   settings_term_default.TermEnlarge         = SW_ONOFF_OFF;
   settings_term_default.TermInvert          = SW_ONOFF_OFF;
+  settings_term_default.TermFrames          = SW_ONOFF_OFF;
+  settings_term_default.TermRaster          = SW_ONOFF_OFF;
   settings_term_default.TermTransparent     = SW_ONOFF_OFF;
   settings_term_default.UnitScheme          = SW_UNITSCH_SI;
   settings_term_default.UnitDisplayPrefix   = SW_ONOFF_ON;
@@ -41,11 +41,12 @@ typedef struct with_words {
  } with_words;
 
 typedef struct settings_terminal {
- int    backup, CalendarIn, CalendarOut, colour, ComplexNumbers, display, ExplicitErrors, landscape, multiplot, NumDisplay, SignificantFigures, TermAntiAlias, TermType, TermEnlarge, TermInvert, TermTransparent, UnitScheme, UnitDisplayPrefix, UnitDisplayAbbrev, UnitAngleDimless, viewer;
+ int    backup, CalendarIn, CalendarOut, colour, ComplexNumbers, display, ExplicitErrors, landscape, multiplot, NumDisplay, SignificantFigures, TermAntiAlias, TermType, TermEnlarge, TermFrames, TermInvert, TermRaster, TermTransparent, UnitScheme, UnitDisplayPrefix, UnitDisplayAbbrev, UnitAngleDimless, viewer;
  long int RandomSeed;
- double dpi;
+ double DataCache, dpi;
  unsigned char BinOriginAuto, BinWidthAuto;
  value  BinOrigin, BinWidth, PaperHeight, PaperWidth;
+ char   DataCacheDir[FNAME_LENGTH];
  char   output[FNAME_LENGTH];
  char   PaperName[FNAME_LENGTH];
  char   LatexPreamble[FNAME_LENGTH];
@@ -174,6 +174,12 @@ void ProcessPyXPlotScript(char *input, int IterLevel)
  }
 
 int ProcessDirective(char *in, int interactive, int IterLevel)
+ {
+  return ProcessDirectiveCached(in, interactive, IterLevel, NULL);
+ }
+
+// Lines which are read from a loop chain are passed with source pointing to their chain item, so that they needn't be parsed afresh each time
+int ProcessDirectiveCached(char *in, int interactive, int IterLevel, cmd_chain_item *source)
  {
   int   memcontext, i, breakable;
   int   status=0;
@@ -197,7 +203,8 @@ int ProcessDirective(char *in, int interactive, int IterLevel)
     // Parse and execute command
     if (status==0)
      {
-      command = parse(in, IterLevel);
+      if (source == NULL) command = parse(in, IterLevel);
+      else                command = parse_cached(in, IterLevel, &source->parsed, source->context);
       if (command != NULL) status = ProcessDirective2(in, command, interactive, memcontext, IterLevel);
       else                 status = 1;
       // If command is NULL, we had a syntax error
@@ -57,6 +57,7 @@ Usage: pyxplot <options> <filelist>\n\
   -V, --verbose:    Turn on initial welcome message.\n\
   -c, --colour:     Use coloured highlighting of output.\n\
   -m, --monochrome: Turn off coloured highlighting.\n\
+  -t, --timing:     Report how long each stage of startup takes.\n\
 \n\
 A brief introduction to PyXPlot can be obtained by typing 'man pyxplot'; the\n\
 full Users' Guide can be found in the file:\n\
@@ -91,15 +92,15 @@ sprintf(txt_valid_set_options, "\n\
 'arrow', 'autoscale', 'axescolour', 'axis', 'axisunitstyle', 'backup', 'bar',\n\
 'binorigin', 'binwidth', 'boxfrom', 'boxwidth', 'c1format', 'c1label',\n\
 'calendar', 'clip', 'colmap', 'colkey', 'contours', 'c<n>range', 'data style',\n\
-'display', 'filter', 'fontsize', 'function style', 'grid', 'gridmajcolour',\n\
-'gridmincolour', 'key', 'keycolumns', 'label', 'linearscale', 'linewidth',\n\
-'logscale', 'multiplot', 'noarrow', 'noaxis', 'nobackup', 'nodisplay',\n\
-'nogrid', 'nokey', 'nolabel', 'nologscale', 'nomultiplot', 'nostyle',\n\
-'notitle', 'no<m>[xyz]<n>format', 'no<m>[xyz]<n>tics', 'numerics', 'origin',\n\
-'output', 'palette', 'papersize', 'pointlinewidth', 'pointsize', 'preamble',\n\
-'samples', 'seed', 'size', 'size noratio', 'size ratio', 'size square',\n\
-'style', 'terminal', 'textcolour', 'texthalign', 'textvalign', 'title',\n\
-'trange', 'unit', 'urange', 'view', 'viewer', 'vrange', 'width',\n\
+'datacache', 'display', 'filter', 'fontsize', 'function style', 'grid',\n\
+'gridmajcolour', 'gridmincolour', 'key', 'keycolumns', 'label', 'linearscale',\n\
+'linewidth', 'logscale', 'multiplot', 'noarrow', 'noaxis', 'nobackup',\n\
+'nodisplay', 'nogrid', 'nokey', 'nolabel', 'nologscale', 'nomultiplot',\n\
+'nostyle', 'notitle', 'no<m>[xyz]<n>format', 'no<m>[xyz]<n>tics', 'numerics',\n\
+'origin', 'output', 'palette', 'papersize', 'pointlinewidth', 'pointsize',\n\
+'preamble', 'samples', 'seed', 'size', 'size noratio', 'size ratio',\n\
+'size square', 'style', 'terminal', 'textcolour', 'texthalign', 'textvalign',\n\
+'title', 'trange', 'unit', 'urange', 'view', 'viewer', 'vrange', 'width',\n\
 '[xyz]<n>format', '[xyz]<n>label', '[xyz]<n>range', '<m>[xyz]<n>tics'\n\
 ");
 
@@ -114,15 +115,15 @@ Unset options which PyXPlot recognises are: [] = choose one, <> = optional\n\
 'arrow', 'autoscale', 'axescolour', 'axis', 'axisunitstyle', 'backup', 'bar',\n\
 'binorigin', 'binwidth', 'boxfrom', 'boxwidth', 'c1format', 'c1label',\n\
 'calendar', 'clip', 'colmap', 'colkey', 'contours', 'c<n>range', 'data style',\n\
-'display', 'filter', 'fontsize', 'function style', 'grid', 'gridmajcolour',\n\
-'gridmincolour', 'key', 'keycolumns', 'label', 'linewidth', 'logscale',\n\
-'multiplot', 'noarrow', 'noaxis', 'nobackup', 'nodisplay', 'nogrid', 'nokey',\n\
-'nolabel', 'nologscale', 'nomultiplot', 'notitle', 'no<m>[xyz]<n>tics',\n\
-'numerics', 'origin', 'output', 'palette', 'papersize', 'pointlinewidth',\n\
-'pointsize', 'preamble', 'samples', 'size', 'style', 'terminal', 'textcolour',\n\
-'texthalign', 'textvalign', 'title', 'trange', 'unit', 'urange', 'view',\n\
-'viewer', 'vrange', 'width', '[xyz]<n>format', '[xyz]<n>label',\n\
-'[xyz]<n>range', '<m>[xyz]<n>tics'\n\
+'datacache', 'display', 'filter', 'fontsize', 'function style', 'grid',\n\
+'gridmajcolour', 'gridmincolour', 'key', 'keycolumns', 'label', 'linewidth',\n\
+'logscale', 'multiplot', 'noarrow', 'noaxis', 'nobackup', 'nodisplay',\n\
+'nogrid', 'nokey', 'nolabel', 'nologscale', 'nomultiplot', 'notitle',\n\
+'no<m>[xyz]<n>tics', 'numerics', 'origin', 'output', 'palette', 'papersize',\n\
+'pointlinewidth', 'pointsize', 'preamble', 'samples', 'size', 'style',\n\
+'terminal', 'textcolour', 'texthalign', 'textvalign', 'title', 'trange',\n\
+'unit', 'urange', 'view', 'viewer', 'vrange', 'width', '[xyz]<n>format',\n\
+'[xyz]<n>label', '[xyz]<n>range', '<m>[xyz]<n>tics'\n\
 ");
 
 sprintf(txt_set, "\n\
@@ -145,13 +146,13 @@ or any of the following set options:\n\
 'arrow', 'autoscale', 'axescolour', 'axis', 'axisunitstyle', 'backup', 'bar',\n\
 'binorigin', 'binwidth', 'boxfrom', 'boxwidth', 'c1format', 'c1label',\n\
 'calendar', 'clip', 'colmap', 'colkey', 'contours', 'c<n>range', 'data style',\n\
-'display', 'filter', 'fontsize', 'function style', 'grid', 'gridmajcolour',\n\
-'gridmincolour', 'key', 'keycolumns', 'label', 'linearscale', 'linewidth',\n\
-'logscale', 'multiplot', 'numerics', 'origin', 'output', 'palette',\n\
-'papersize', 'pointlinewidth', 'pointsize', 'preamble', 'samples', 'seed',\n\
-'size', 'size noratio', 'size ratio', 'size square', 'style', 'terminal',\n\
-'textcolour', 'texthalign', 'textvalign', 'title', 'trange', 'unit', 'urange',\n\
-'view', 'viewer', 'vrange', 'width', '[xyz]<n>format', '[xyz]<n>label',\n\
-'[xyz]<n>range', '<m>[xyz]<n>tics'\n\
+'datacache', 'display', 'filter', 'fontsize', 'function style', 'grid',\n\
+'gridmajcolour', 'gridmincolour', 'key', 'keycolumns', 'label', 'linearscale',\n\
+'linewidth', 'logscale', 'multiplot', 'numerics', 'origin', 'output',\n\
+'palette', 'papersize', 'pointlinewidth', 'pointsize', 'preamble', 'samples',\n\
+'seed', 'size', 'size noratio', 'size ratio', 'size square', 'style',\n\
+'terminal', 'textcolour', 'texthalign', 'textvalign', 'title', 'trange',\n\
+'unit', 'urange', 'view', 'viewer', 'vrange', 'width', '[xyz]<n>format',\n\
+'[xyz]<n>label', '[xyz]<n>range', '<m>[xyz]<n>tics'\n\
 "); }
 
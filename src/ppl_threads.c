@@ -0,0 +1,87 @@
+// ppl_threads.c
+//
+// The code in this file is part of PyXPlot
+// <http://www.pyxplot.org.uk>
+//
+// Copyright (C) 2006-2011 Dominic Ford <coders@pyxplot.org.uk>
+//               2008-2011 Ross Church
+//
+// $Id$
+//
+// PyXPlot is free software; you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation; either version 2 of the License, or (at your option) any later
+// version.
+//
+// You should have received a copy of the GNU General Public License along with
+// PyXPlot; if not, write to the Free Software Foundation, Inc., 51 Franklin
+// Street, Fifth Floor, Boston, MA  02110-1301, USA
+
+// ----------------------------------------------------------------------------
+
+#define _PPL_THREADS_C 1
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "ppl_constants.h"
+#include "ppl_threads.h"
+
+typedef struct ThreadJob {
+ ppl_ThreadWorker worker;
+ void            *arg;
+ int              ThreadNo, NThreads;
+ } ThreadJob;
+
+// ppl_threads_count(): The number of worker threads which calculations should be split between; one per processor core
+int ppl_threads_count()
+ {
+  static int count = 0;
+  long int   n;
+
+  if (count > 0) return count;
+  n = sysconf(_SC_NPROCESSORS_ONLN);
+  if      (n < 1          ) count = 1;
+  else if (n > MAX_THREADS) count = MAX_THREADS;
+  else                      count = (int)n;
+  return count;
+ }
+
+static void *ppl_threads_slave(void *job_void)
+ {
+  ThreadJob *job = (ThreadJob *)job_void;
+  (*job->worker)(job->arg, job->ThreadNo, job->NThreads);
+  return NULL;
+ }
+
+// ppl_threads_run(): Call worker(arg, i, NThreads) for i = 0 ... NThreads-1 simultaneously, and return once all calls have finished.
+// Call 0 is made from the calling thread. If a thread cannot be started, its share of the work is done by the calling thread instead.
+void ppl_threads_run(ppl_ThreadWorker worker, void *arg, int NThreads)
+ {
+  pthread_t     thread [MAX_THREADS];
+  ThreadJob     job    [MAX_THREADS];
+  unsigned char started[MAX_THREADS];
+  int           i;
+
+  if (NThreads > MAX_THREADS) NThreads = MAX_THREADS;
+  if (NThreads < 2) { (*worker)(arg, 0, 1); return; }
+
+  for (i=1; i<NThreads; i++)
+   {
+    job[i].worker   = worker;
+    job[i].arg      = arg;
+    job[i].ThreadNo = i;
+    job[i].NThreads = NThreads;
+    started[i] = (pthread_create(&thread[i], NULL, &ppl_threads_slave, (void *)&job[i]) == 0);
+   }
+  (*worker)(arg, 0, NThreads);
+  for (i=1; i<NThreads; i++)
+   {
+    if (started[i]) pthread_join(thread[i], NULL);
+    else            (*worker)(arg, i, NThreads);
+   }
+  return;
+ }
+
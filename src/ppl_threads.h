@@ -0,0 +1,33 @@
+// ppl_threads.h
+//
+// The code in this file is part of PyXPlot
+// <http://www.pyxplot.org.uk>
+//
+// Copyright (C) 2006-2011 Dominic Ford <coders@pyxplot.org.uk>
+//               2008-2011 Ross Church
+//
+// $Id$
+//
+// PyXPlot is free software; you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation; either version 2 of the License, or (at your option) any later
+// version.
+//
+// You should have received a copy of the GNU General Public License along with
+// PyXPlot; if not, write to the Free Software Foundation, Inc., 51 Franklin
+// Street, Fifth Floor, Boston, MA  02110-1301, USA
+
+// ----------------------------------------------------------------------------
+
+// Helpers for splitting calculations between a number of worker threads
+
+#ifndef _PPL_THREADS_H
+#define _PPL_THREADS_H 1
+
+typedef void (*ppl_ThreadWorker)(void *arg, int ThreadNo, int NThreads);
+
+int  ppl_threads_count();
+void ppl_threads_run  (ppl_ThreadWorker worker, void *arg, int NThreads);
+
+#endif
+
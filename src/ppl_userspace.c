@@ -53,6 +53,7 @@
 #include "ppl_units.h"
 #include "ppl_units_fns.h"
 #include "ppl_userspace.h"
+#include "ppl_userspace_compile.h"
 
 // -------------------------------------------------------------------
 // Data structures used for storing the user's variables and functions
@@ -62,6 +63,9 @@ Dict *_ppl_UserSpace_Vars;
 Dict *_ppl_UserSpace_Funcs;
 Dict *_ppl_UserSpace_Funcs2;
 
+// Incremented whenever a variable is deleted or a function is redefined, so that compiled expressions know to look things up again
+int   _ppl_UserSpace_Generation = 0;
+
 // ppl_UserSpace_SetVarStr(): Called to define a new string variable within the user's variable space
 void ppl_UserSpace_SetVarStr(char *name, char *inval, int modified)
  {
@@ -85,6 +89,7 @@ void ppl_UserSpace_SetVarNumeric(char *name, value *inval, int modified)
 void ppl_UserSpace_UnsetVar(char *name)
  {
   DictRemoveKey(_ppl_UserSpace_Vars , name);
+  _ppl_UserSpace_Generation++;
   return;
  }
 
@@ -131,6 +136,7 @@ void ppl_UserSpace_SetFunc(char *definition, int modified, int *status, char *er
   unsigned char MinActive[ALGEBRA_MAXITEMS], MaxActive[ALGEBRA_MAXITEMS];
   FunctionDescriptor *OldFuncPtr, *OldFuncIter, **OldFuncPrev, *NewFuncPtr, *temp;
 
+  _ppl_UserSpace_Generation++;
   for (j=0; j<ALGEBRA_MAXITEMS; j++) MinActive[j]=0; // By default, function definition has no limits to the range over which it is applicable
   for (j=0; j<ALGEBRA_MAXITEMS; j++) MaxActive[j]=0;
 
@@ -789,6 +795,8 @@ void ppl_GetQuotedString(char *in, char *out, int start, int *end, unsigned char
 // ---------------------------------------------
 
 // ppl_EvaluateAlgebra(): Evaluates an algebraic expression to return a double. All fields as above.
+// The expression is compiled into a tree, which is cached so that repeated calls on the same string do not need to
+// parse it again; see ppl_userspace_compile.c.
 
 // Order of precedence:
 //  1 f(x)
@@ -796,683 +804,30 @@ void ppl_GetQuotedString(char *in, char *out, int start, int *end, unsigned char
 //    [evaluate numerics]
 //    [evaluate $s]
 //    [evaluate variables]
-//  3 **
-//  4 minus signs
+//  3 **                   (right to left)
+//  4 minus signs, not
 //  5 *  /  %
 //  6 +  -
 //  7 <<  >>
-//  8 <  <=  >=  >
-//  9 ==  !=  <>
+//  8 <  <=  >=  >         (right to left)
+//  9 ==  !=  <>           (right to left)
 // 10 &
 // 11 ^
 // 12 |
 // 13 and
 // 14 or
 
-// StatusRow values 20-255 correspond to ResultBuffer values 0-235
-#define BUFFER_OFFSET 20
-
-#define MATCH_ONE(A)       (in[i]==A)
-#define MATCH_TWO(A,B)    ((in[i]==A)&&(in[i+1]==B))
-#define MATCH_THR(A,B,C)  ((in[i]==A)&&(in[i+1]==B)&&(in[i+2]==C))
-
-#define FETCHPREV(VARA,VARB,VARC)  { for (j=p-1,cj=StatusRow[p-1]; ((StatusRow[j]==cj)&&(j>0)); j--); if (cj<BUFFER_OFFSET) {*errpos=i; strcpy(errtext, "Internal Error: Trying to do arithmetic before numeric conversion"); return;}; VARA=j; VARB=(int)(cj-BUFFER_OFFSET); VARC=p-1; }
-#define FETCHNEXT(VARA,VARB,VARC)  { for (j=p,ci=StatusRow[p]; StatusRow[j]==ci; j++); if ((cj=StatusRow[j])<BUFFER_OFFSET) {*errpos=i; strcpy(errtext, "Internal Error: Trying to do arithmetic before numeric conversion"); return;}; for (k=j; StatusRow[k]==cj; k++); VARA=j; VARB=(int)(cj-BUFFER_OFFSET); VARC=k; }
-#define FETCHNEXTI(VARA,VARB,VARC) { for (j=p,ci=StatusRow[p]; StatusRow[j]==ci; j++); for (k=j, cj=StatusRow[j]; StatusRow[k]==cj; k++); VARA=j; VARB=(int)cj; VARC=k; }
-#define SETSTATUS(BEG,END,VAL)     { ci = (unsigned char)(VAL+BUFFER_OFFSET); for (j=BEG;j<END;j++) StatusRow[j]=ci; }
-
-#define ENFORCEANGLEDIMLESS(POS) \
- if ((settings_term_current.UnitAngleDimless == SW_ONOFF_ON) && (ResultBuffer[POS].exponent[UNIT_ANGLE]!=0)) \
-  { \
-   int i; \
-   ResultBuffer[POS].exponent[UNIT_ANGLE] = 0; \
-   ResultBuffer[POS].dimensionless = 1; \
-   for (i=0; i<UNITS_MAX_BASEUNITS; i++) if (ResultBuffer[POS].exponent[i]!=0.0) { ResultBuffer[POS].dimensionless=0; break; } \
-  }
-
 void ppl_EvaluateAlgebra(char *in, value *out, int start, int *end, unsigned char DollarAllowed, int *errpos, char *errtext, int RecursionDepth)
  {
-  unsigned char OpList[OPLIST_LEN];           // A list of what operations this expression contains
-  unsigned char StatusRow[ALGEBRA_MAXLENGTH]; // Describes the atoms at each position in the expression
-  value ResultBuffer[ALGEBRA_MAXITEMS];       // A buffer of temporary numerical results
-  int len, CalculatedEnd;
-  int i,p,j,k,l,FunctionType, NArgs;
-  int prev_start, prev_end, next_start, next_end, prev_bufno, next_bufno;
-  unsigned char ci,cj;
-  char dummy[DUMMYVAR_MAXLEN];
-  char ck, *integrand=NULL;
-  int bufpos = 0;
-  value  *VarData  = NULL;
-  FunctionDescriptor *FuncDef = NULL;
-  double  TempDbl, TempDbl2;
-  DictItem *DictItem;
+  CompiledAlgebra *e;
 
   if (RecursionDepth > MAX_RECURSION_DEPTH) { *errpos=start; strcpy(errtext,"Overflow Error: Maximum recursion depth exceeded"); return; }
 
   *errpos = -1;
-  ppl_GetExpression(in+start, &len, DollarAllowed, StatusRow, OpList, errpos, errtext);
-  if (*errpos >= 0) { (*errpos) += start; return; }
-  CalculatedEnd = start + len;
-  if ((end != NULL) && (*end >  0) && (CalculatedEnd < *end)) { *errpos=CalculatedEnd; strcpy(errtext,"Syntax Error: Unexpected trailing matter after algebraic expression"); return; }
-  if ((end != NULL) && (*end <= 0)) *end = CalculatedEnd;
-
-  // PHASE  1: EVALUATION OF FUNCTIONS
-  if (OpList[1]!=0) for (i=0;i<len-1;i++) if ((StatusRow[i]==8)&&(StatusRow[i+1]==3))
-   {
-    for (j=i;((j>0)&&(StatusRow[j-1]==8));j--); // Rewind to beginning of function name
-    DictLookupWithWildcard(_ppl_UserSpace_Funcs, _ppl_UserSpace_Funcs2, in+start+j, dummy, DUMMYVAR_MAXLEN, &DictItem);
-    if (DictItem != NULL)
-     {
-      i+=2;
-      FunctionType = ((FunctionDescriptor *)DictItem->data)->FunctionType;
-      NArgs = (FunctionType == PPL_USERSPACE_SUBROUTINE) ? -1 : (((FunctionDescriptor *)DictItem->data)->NumberArguments);
-      for (k=0; k<NArgs; k++) // Now collect together numeric arguments
-       {
-        if (bufpos+k+2 >= ALGEBRA_MAXITEMS) { *errpos = start+i; strcpy(errtext,"Internal Error: Temporary results buffer overflow."); return; }
-        while ((in[start+i]>'\0')&&(in[start+i]<=' ')) i++;
-        if (in[start+i]==')') { *errpos = start+i; strcpy(errtext,"Syntax Error: Too few arguments supplied to function."); return; }
-        j=-1;
-        if ((k==0)&&(FunctionType == PPL_USERSPACE_INT)) // First argument is an integrand, which we should not evaluate
-         {
-          if ((in[start+i]=='\'') || (in[start+i]=='\"')) { ck=in[start+i]; i++; } else { ck='\0'; }
-          while ((in[start+i]>'\0')&&(in[start+i]<=' ')) i++;
-          integrand = in+start+i; // Integrand starts here
-          ppl_GetExpression(in+start+i, &j, DollarAllowed, NULL, NULL, errpos, errtext);
-          if (*errpos >= 0) { (*errpos) += start+i; return; }
-          i+=j;
-          while ((in[start+i]>'\0')&&(in[start+i]<=' ')) i++;
-          if (ck>'\0')
-           {
-            if (in[start+i]!=ck) { *errpos = start+i; strcpy(errtext,"Syntax Error: Was expecting a closing quote."); return; }
-            else                    i++;
-           }
-         } else { // otherwise, we evaluate the argument straight away
-          ppl_EvaluateAlgebra(in+start+i, ResultBuffer+bufpos+k+2, 0, &j, DollarAllowed, errpos, errtext, RecursionDepth+1);
-          if (*errpos >= 0) { (*errpos) += start+i; return; }
-          i+=j;
-         }
-        while ((in[start+i]>'\0')&&(in[start+i]<=' ')) i++;
-        if (k < NArgs-1)
-         {
-          if (in[start+i] != ',')
-           {
-            *errpos = start+i;
-            if (in[start+i] ==')')
-             {
-              if ((FunctionType == PPL_USERSPACE_INT) && (DictItem->key[0]!='i') && (k==NArgs-2)) // Last argument to diff_dx is optional
-               {
-                ResultBuffer[bufpos+k+3] = ResultBuffer[bufpos+k+2];
-                ResultBuffer[bufpos+k+3].real = hypot(ResultBuffer[bufpos+k+3].real , ResultBuffer[bufpos+k+3].imag) * 1e-6;
-                ResultBuffer[bufpos+k+3].imag = 0.0;
-                ResultBuffer[bufpos+k+3].FlagComplex = 0;
-                if (ResultBuffer[bufpos+k+3].real < DBL_MIN*1e5) ResultBuffer[bufpos+k+3].real = 1e-6;
-                k++; *errpos=-1; continue;
-               }
-              strcpy(errtext,"Syntax Error: Too few arguments supplied to function.");
-             }
-            else                   strcpy(errtext,"Syntax Error: Unexpected trailing matter after argument to function.");
-            return;
-           } else { i++; }
-         }
-       }
-      if (FunctionType == PPL_USERSPACE_SUBROUTINE)
-       {
-        int ep=-1, endpos, stat, j;
-        j=i;
-        while (StatusRow[i]==3) i--; while ((i>0)&&(StatusRow[i]==8)) i--; if (StatusRow[i]!=8) i++; // Rewind back to beginning of f(x) text
-        stat = CallSubroutineFromAlgebra(DictItem->key, in+start+j, &endpos, &ep, errtext, RecursionDepth+1);
-        if (stat) { *errpos = (ep>=0) ? (start+j+ep) : (start+i); return; }
-        if (PPL_FLOWCTRL_RETURNTOALGEBRA.string != NULL) { *errpos = start+i; sprintf(errtext, "This subroutine returns a string result; a numeric result was expected."); return; }
-        ResultBuffer[bufpos] = PPL_FLOWCTRL_RETURNTOALGEBRA;
-       }
-      else if (FunctionType == PPL_USERSPACE_STRFUNC)
-       {
-        while (StatusRow[i]==3) i--; while ((i>0)&&(StatusRow[i]==8)) i--; if (StatusRow[i]!=8) i++; // Rewind back to beginning of f(x) text
-        (*errpos) = start+i;
-        strcpy(errtext,"Type Error: This function returns a string where a numeric result was expected.");
-        return;
-       }
-      else if ((FunctionType == PPL_USERSPACE_SYSTEM) && (NArgs==-1))
-       {
-        int k;
-        i--; // Should point at opening bracket
-        StrBracketMatch(in+i,NULL,NULL,&k,0);
-        if (k<=0) { *errpos=start+i; strcpy(errtext,"Syntax Error: Mismatched bracket."); return; }
-        j=-1;
-        ((void(*)(char*,int,value*,unsigned char,int,int*,char*))((FunctionDescriptor*)DictItem->data)->FunctionPtr)(in+start+i+1,k-1,ResultBuffer+bufpos,DollarAllowed,RecursionDepth,&j,errtext);
-        if (j>=0) { *errpos = start+i+1+j; return; }
-        while (StatusRow[i]==3) i--; while ((i>0)&&(StatusRow[i]==8)) i--; if (StatusRow[i]!=8) i++; // Rewind back to beginning of f(x) text
-       }
-      else if ((FunctionType != PPL_USERSPACE_UNIT) && (in[start+i] != ')')) // Unit function deals with arguments itself
-       {
-        (*errpos) = start+i;
-        if (in[start+i] ==',') strcpy(errtext,"Syntax Error: Too many arguments supplied to function.");
-        else                   strcpy(errtext,"Syntax Error: Unexpected trailing matter after final argument to function.");
-        return;
-       }
-      else if (FunctionType == PPL_USERSPACE_SYSTEM)
-       {
-        while (StatusRow[i]==3) i--; while ((i>0)&&(StatusRow[i]==8)) i--; if (StatusRow[i]!=8) i++; // Rewind back to beginning of f(x) text
-        j=0;
-        if      (NArgs==0) ((void(*)(value*,                                          int*,char*))((FunctionDescriptor*)DictItem->data)->FunctionPtr)(                                                                                                                                    ResultBuffer+bufpos,&j,errtext);
-        else if (NArgs==1) ((void(*)(value*,value*,                                   int*,char*))((FunctionDescriptor*)DictItem->data)->FunctionPtr)(                                                                                                              ResultBuffer+bufpos+2,ResultBuffer+bufpos,&j,errtext);
-        else if (NArgs==2) ((void(*)(value*,value*,value*,                            int*,char*))((FunctionDescriptor*)DictItem->data)->FunctionPtr)(                                                                                        ResultBuffer+bufpos+2,ResultBuffer+bufpos+3,ResultBuffer+bufpos,&j,errtext);
-        else if (NArgs==3) ((void(*)(value*,value*,value*,value*,                     int*,char*))((FunctionDescriptor*)DictItem->data)->FunctionPtr)(                                                                  ResultBuffer+bufpos+2,ResultBuffer+bufpos+3,ResultBuffer+bufpos+4,ResultBuffer+bufpos,&j,errtext);
-        else if (NArgs==4) ((void(*)(value*,value*,value*,value*,value*,              int*,char*))((FunctionDescriptor*)DictItem->data)->FunctionPtr)(                                            ResultBuffer+bufpos+2,ResultBuffer+bufpos+3,ResultBuffer+bufpos+4,ResultBuffer+bufpos+5,ResultBuffer+bufpos,&j,errtext);
-        else if (NArgs==5) ((void(*)(value*,value*,value*,value*,value*,value*,       int*,char*))((FunctionDescriptor*)DictItem->data)->FunctionPtr)(                      ResultBuffer+bufpos+2,ResultBuffer+bufpos+3,ResultBuffer+bufpos+4,ResultBuffer+bufpos+5,ResultBuffer+bufpos+6,ResultBuffer+bufpos,&j,errtext);
-        else if (NArgs==6) ((void(*)(value*,value*,value*,value*,value*,value*,value*,int*,char*))((FunctionDescriptor*)DictItem->data)->FunctionPtr)(ResultBuffer+bufpos+2,ResultBuffer+bufpos+3,ResultBuffer+bufpos+4,ResultBuffer+bufpos+5,ResultBuffer+bufpos+6,ResultBuffer+bufpos+7,ResultBuffer+bufpos,&j,errtext);
-        if (j>0) { *errpos = start+i; return; }
-       }
-      else if (FunctionType == PPL_USERSPACE_UNIT)
-       {
-        j=-1;
-        ppl_units_StringEvaluate(in+start+i, ResultBuffer+bufpos, &k, &j, errtext);
-        if (j>=0) { *errpos = start+i+j; return; }
-        i+=k; while ((in[start+i]>'\0')&&(in[start+i]<=' ')) i++;
-        if (in[start+i] != ')') { (*errpos) = start+i; strcpy(errtext,"Syntax Error: Unexpected trailing matter after unit expression."); return; }
-        while (StatusRow[i]==3) i--; while ((i>0)&&(StatusRow[i]==8)) i--; if (StatusRow[i]!=8) i++;
-       }
-      else if (FunctionType == PPL_USERSPACE_SPLINE)
-       {
-        while (StatusRow[i]==3) i--; while ((i>0)&&(StatusRow[i]==8)) i--; if (StatusRow[i]!=8) i++; // Rewind back to beginning of f(x) text
-        j=0;
-        ppl_spline_evaluate(DictItem->key, (SplineDescriptor *)(((FunctionDescriptor *)DictItem->data)->FunctionPtr) , ResultBuffer+bufpos+2 , ResultBuffer+bufpos, &j, errtext);
-        if (j>0) { *errpos = start+i; return; }
-       }
-      else if ((FunctionType == PPL_USERSPACE_INTERP2D) || (FunctionType == PPL_USERSPACE_BMPDATA))
-       {
-        while (StatusRow[i]==3) i--; while ((i>0)&&(StatusRow[i]==8)) i--; if (StatusRow[i]!=8) i++; // Rewind back to beginning of f(x) text
-        j=0;
-        ppl_interp2d_evaluate(DictItem->key, (SplineDescriptor *)(((FunctionDescriptor *)DictItem->data)->FunctionPtr) , ResultBuffer+bufpos+2 , ResultBuffer+bufpos+3, (FunctionType == PPL_USERSPACE_BMPDATA), ResultBuffer+bufpos, &j, errtext);
-        if (j>0) { *errpos = start+i; return; }
-       }
-      else if (FunctionType == PPL_USERSPACE_HISTOGRAM)
-       {
-        while (StatusRow[i]==3) i--; while ((i>0)&&(StatusRow[i]==8)) i--; if (StatusRow[i]!=8) i++; // Rewind back to beginning of f(x) text
-        j=0;
-        ppl_histogram_evaluate(DictItem->key, (HistogramDescriptor *)(((FunctionDescriptor *)DictItem->data)->FunctionPtr) , ResultBuffer+bufpos+2 , ResultBuffer+bufpos, &j, errtext);
-        if (j>0) { *errpos = start+i; return; }
-       }
-      else if (FunctionType == PPL_USERSPACE_FFT)
-       {
-        while (StatusRow[i]==3) i--; while ((i>0)&&(StatusRow[i]==8)) i--; if (StatusRow[i]!=8) i++; // Rewind back to beginning of f(x) text
-        j=0;
-        ppl_fft_evaluate(DictItem->key, (FFTDescriptor *)(((FunctionDescriptor *)DictItem->data)->FunctionPtr) , ResultBuffer+bufpos+2 , ResultBuffer+bufpos, &j, errtext);
-        if (j>0) { *errpos = start+i; return; }
-       }
-      else if (FunctionType == PPL_USERSPACE_USERDEF)
-       {
-        while (StatusRow[i]==3) i--; while ((i>0)&&(StatusRow[i]==8)) i--; if (StatusRow[i]!=8) i++;
-        FuncDef = (FunctionDescriptor *)DictItem->data;
-        j=0;
-        while (FuncDef != NULL) // Check whether supplied arguments are within the range of this definition
-         {
-          l=1;
-          for (k=0; ((k<NArgs)&&(l==1)); k++)
-           {
-            if (FuncDef->MinActive[k]!=0)
-             {
-              if (j==0)
-               {
-                if (!ppl_units_DimEqual(FuncDef->min+k , ResultBuffer+bufpos+k+2))
-                 {
-                  *errpos = start+i;
-                  sprintf(errtext,"Argument %d supplied to this function is dimensionally incompatible with the argument's specified min/max range: argument has dimensions of <%s>, meanwhile range has dimensions of <%s>.",k+1,ppl_units_GetUnitStr(ResultBuffer+bufpos+k+2,NULL,NULL,0,1,0),ppl_units_GetUnitStr(FuncDef->min+k,NULL,NULL,1,1,0));
-                  return;
-                 }
-                else if (ResultBuffer[bufpos+k+2].FlagComplex)
-                 {
-                  *errpos = start+i;
-                  sprintf(errtext,"Argument %d supplied to this function must be a real number: any arguments which have min/max ranges specified must be real.",k+1);
-                  return;
-                 } else { j=1; }
-               }
-              if (ResultBuffer[bufpos+k+2].real < FuncDef->min[k].real) { FuncDef=FuncDef->next; l=0; continue; }
-             }
-            if (FuncDef->MaxActive[k]!=0)
-             {
-              if (j==0)
-               {
-                if (!ppl_units_DimEqual(FuncDef->max+k , ResultBuffer+bufpos+k+2))
-                 {
-                  *errpos = start+i;
-                  sprintf(errtext,"Argument %d supplied to this function is dimensionally incompatible with the argument's specified min/max range: argument has dimensions of <%s>, meanwhile range has dimensions of <%s>.",k+1,ppl_units_GetUnitStr(ResultBuffer+bufpos+k+2,NULL,NULL,0,1,0),ppl_units_GetUnitStr(FuncDef->max+k,NULL,NULL,1,1,0));
-                  return;
-                 }
-                else if (ResultBuffer[bufpos+k+2].FlagComplex)
-                 {
-                  *errpos = start+i;
-                  sprintf(errtext,"Argument %d supplied to this function must be a real number: any arguments which have min/max ranges specified must be real.",k+1);
-                  return;
-                 } else { j=1; }
-               }
-              if (ResultBuffer[bufpos+k+2].real > FuncDef->max[k].real) { FuncDef=FuncDef->next; l=0; continue; }
-             }
-           }
-          if (l==1) break;
-         }
-        if (FuncDef==NULL)
-         {
-          if (settings_term_current.ExplicitErrors == SW_ONOFF_OFF) { ppl_units_zero(ResultBuffer+bufpos); ResultBuffer[bufpos].real = GSL_NAN; ResultBuffer[bufpos].imag = 0; }
-          else { *errpos = start; sprintf(errtext,"This function is not defined in the requested region of parameter space."); return; }
-         } else {
-          j=0;
-          for (k=0; k<NArgs; k++) // Swap new arguments for old in global dictionary
-           {
-            DictLookup(_ppl_UserSpace_Vars, ((FunctionDescriptor *)DictItem->data)->ArgList+j, NULL, (void *)&VarData);
-            if (VarData!=NULL)
-             {
-              memcpy(ResultBuffer+bufpos+k+1, VarData, sizeof(value));
-              memcpy(VarData, ResultBuffer+bufpos+k+2, sizeof(value));
-             }
-            else
-             {
-              ppl_units_zero(ResultBuffer+bufpos+k+1);
-              ResultBuffer[bufpos+k+1].modified=2;
-              DictAppendValue(_ppl_UserSpace_Vars, ((FunctionDescriptor *)DictItem->data)->ArgList+j, ResultBuffer[bufpos+k+2]);
-             }
-            j += strlen(((FunctionDescriptor *)DictItem->data)->ArgList+j)+1;
-           }
-          j=-1;
-          ppl_EvaluateAlgebra((char *)FuncDef->FunctionPtr, ResultBuffer+bufpos, 0, &j, DollarAllowed, errpos, errtext, RecursionDepth+1);
-          if (((char *)FuncDef->FunctionPtr)[j]!='\0') { *errpos=1; strcpy(errtext,"Unexpected trailing matter in function definition."); }
-          j=0;
-          for (k=0; k<NArgs; k++) // Swap old arguments for new in global dictionary
-           {
-            DictLookup(_ppl_UserSpace_Vars, ((FunctionDescriptor *)DictItem->data)->ArgList+j, NULL, (void *)&VarData);
-            memcpy(VarData, ResultBuffer+bufpos+k+1, sizeof(value));
-            j += strlen(((FunctionDescriptor *)DictItem->data)->ArgList+j)+1;
-           }
-          if (*errpos >= 0) { (*errpos) = start+i; return; }
-         }
-       }
-      else if (FunctionType == PPL_USERSPACE_INT)
-       {
-        while (StatusRow[i]==3) i--; while ((i>0)&&(StatusRow[i]==8)) i--; if (StatusRow[i]!=8) i++;
-        if (DictItem->key[0]=='i') Integrate    ( integrand , dummy , ResultBuffer+bufpos+3 , ResultBuffer+bufpos+4 , ResultBuffer+bufpos , errpos , errtext , RecursionDepth );
-        else                       Differentiate( integrand , dummy , ResultBuffer+bufpos+3 , ResultBuffer+bufpos+4 , ResultBuffer+bufpos , errpos , errtext , RecursionDepth );
-        if (*errpos >= 0) { (*errpos) = start+i; return; }
-       }
-      for ( ; StatusRow[i]==8; i++) StatusRow[i] = (unsigned char)(bufpos + BUFFER_OFFSET);
-      for ( ; StatusRow[i]==3; i++) StatusRow[i] = (unsigned char)(bufpos + BUFFER_OFFSET);
-      ENFORCEANGLEDIMLESS(bufpos);
-      bufpos++; if (bufpos >= ALGEBRA_MAXITEMS) { *errpos = start+i; strcpy(errtext,"Internal Error: Temporary results buffer overflow."); return; }
-     }
-    else { *errpos=start+j; strcpy(errtext,"No such function"); return; }
-   }
-  // PHASE  2: EVALUATION OF BRACKETED EXPRESSIONS
-  if (OpList[2]!=0) for (i=0;i<len;i++) if (StatusRow[i]==3)
-   {
-    j=-1;
-    ppl_EvaluateAlgebra(in+start+i, ResultBuffer+bufpos, 1, &j, DollarAllowed, errpos, errtext, RecursionDepth+1);
-    if (*errpos >= 0) { (*errpos) += start+i; return; }
-    j+=i; while ((in[start+j]>'\0')&&(in[start+j]<=' ')) j++;
-    if (in[start+j]!=')') { *errpos=start+j; strcpy(errtext,"Syntax Error: Unexpected trailing matter within brackets."); return; }
-    for (k=i; StatusRow[k]==3; k++) StatusRow[k] = (unsigned char)(bufpos + BUFFER_OFFSET);
-    bufpos++; if (bufpos >= ALGEBRA_MAXITEMS) { *errpos = start+i; strcpy(errtext,"Internal Error: Temporary results buffer overflow."); return; }
-   }
-  // PHASE 2b: EVALUATION OF EXPLICIT NUMERICAL QUANTITIES
-  for (i=0;i<len;i++) if (StatusRow[i]==6)
-   {
-    ppl_units_zero(ResultBuffer+bufpos);
-    ResultBuffer[bufpos].real = GetFloat(in+start+i, &j);
-    for (k=i; StatusRow[k]==6; k++) StatusRow[k] = (unsigned char)(bufpos + BUFFER_OFFSET);
-    j+=i; while ((in[start+j]>'\0')&&(in[start+j]<=' ')) j++;
-    if (j!=k) { *errpos=start+i; strcpy(errtext,"Syntax Error: Unexpected trailing matter after numeric constant."); return; }
-    bufpos++; if (bufpos >= ALGEBRA_MAXITEMS) { *errpos = start+i; strcpy(errtext,"Internal Error: Temporary results buffer overflow."); return; }
-   }
-  // PHASE 2c: EVALUATION OF $45-TYPE VARIABLES
-  if (DollarAllowed) for (i=start,p=0;i<CalculatedEnd;i++,p++) if (StatusRow[p]==4)
-   {
-    FETCHNEXTI(next_start, next_bufno, next_end);
-    if (next_bufno>=BUFFER_OFFSET) // $45 or $(45)
-     {
-      next_bufno-=BUFFER_OFFSET;
-      if (ResultBuffer[next_bufno].FlagComplex  !=0) { *errpos=0; strcpy(errtext, "Number of requested column in datafile should be a real integer; supplied number has an imaginary component."); return; }
-      if (ResultBuffer[next_bufno].dimensionless==0) { *errpos=0; sprintf(errtext, "Number of requested column in datafile should be a dimensionless number; supplied number has units of <%s>.",ppl_units_GetUnitStr(ResultBuffer+next_bufno,NULL,NULL,0,1,0)); return; }
-      *errpos=0;
-      DataFile_UsingConvert_FetchColumnByNumber(ResultBuffer[next_bufno].real, ResultBuffer+next_bufno, 1, 0, errpos, errtext);
-      if (*errpos==0) { *errpos=-1; } else { *errpos=20000; return; }
-      SETSTATUS(p, next_start, next_bufno);
-      i = start + next_end;
-      i--; p=i-start;
-      ENFORCEANGLEDIMLESS(next_bufno);
-     }
-    else // $ColumnName
-     {
-      ppl_units_zero(ResultBuffer+bufpos);
-      while (StatusRow[p]==4) p++;
-      for (j=p;(StatusRow[j]==8);j++);
-      while ((j>p) && (in[start+j-1]<=' ')) j--;
-      ck = in[start+j] ; in[start+j]='\0'; // This will not work if string constant is passed to us!!
-      *errpos=0;
-      DataFile_UsingConvert_FetchColumnByName(in+start+p, ResultBuffer+bufpos, 1, 0, errpos, errtext);
-      in[start+j] = ck;
-      if (*errpos==0) { *errpos=-1; } else { *errpos=20000; return; }
-      SETSTATUS(p, next_end, bufpos);
-      i = start + next_end;
-      i--; p=i-start;
-      ENFORCEANGLEDIMLESS(bufpos);
-      bufpos++; if (bufpos >= ALGEBRA_MAXITEMS) { *errpos = start+i; strcpy(errtext,"Internal Error: Temporary results buffer overflow."); return; }
-     }
-   }
-  // PHASE 2d: EVALUATION OF VARIABLES
-  for (i=0;i<len;i++) if (StatusRow[i]==8)
-   {
-    for (j=i;(StatusRow[j]==8);j++);
-    while ((j>i) && (in[start+j-1]<=' ')) j--;
-    ck = in[start+j] ; in[start+j]='\0'; // This will not work if string constant is passed to us!!
-    DictLookup(_ppl_UserSpace_Vars, in+start+i, NULL, (void *)&VarData);
-    if ((VarData == NULL) || (VarData->modified==2)) { *errpos = start+i; sprintf(errtext, "No such variable, '%s'.", in+start+i); in[start+j] = ck; return; }
-    in[start+j] = ck;
-    if (VarData->string != NULL) { *errpos = start+i; strcpy(errtext, "Type Error: This is a string variable where numeric value is expected."); return; }
-    ResultBuffer[bufpos] = *VarData;
-    ENFORCEANGLEDIMLESS(bufpos);
-    for (k=i; (StatusRow[k]==8); k++) StatusRow[k] = (unsigned char)(bufpos + BUFFER_OFFSET);
-    bufpos++; if (bufpos >= ALGEBRA_MAXITEMS) { *errpos = start+i; strcpy(errtext,"Internal Error: Temporary results buffer overflow."); return; }
-   }
-  // PHASE  3: EVALUATION OF **
-  if (OpList[4]!=0) for (i=CalculatedEnd-1,p=len-1;p>0;i--,p--) if ((StatusRow[p]==7)&&(StatusRow[p-1]!=7))
-   {
-    for (j=p,ci=StatusRow[p]; StatusRow[j]==ci; j++);
-    if ((StatusRow[j]>=BUFFER_OFFSET) && (MATCH_TWO('*','*')))
-     {
-      FETCHPREV(prev_start, prev_bufno, prev_end);
-      FETCHNEXT(next_start, next_bufno, next_end);
-      ppl_units_pow(ResultBuffer+prev_bufno , ResultBuffer+next_bufno , ResultBuffer+prev_bufno , errpos , errtext);
-      if (*errpos >= 0) { *errpos=i; return; }
-      SETSTATUS(prev_end, next_end, prev_bufno);
-     }
-   }
-  // PHASE  4: EVALUATION OF MINUS SIGNS
-  if (OpList[3]!=0) for (i=start,p=0;i<CalculatedEnd;i++,p++) if (StatusRow[p]==5)
-   {
-    FETCHNEXT(next_start, next_bufno, next_end);
-    if (MATCH_ONE('-'))
-     {
-      ResultBuffer[next_bufno].real *= -1;
-      if (ResultBuffer[next_bufno].FlagComplex) ResultBuffer[next_bufno].imag *= -1;
-     } else {
-      ResultBuffer[next_bufno].real        = !((ResultBuffer[next_bufno].real==0)&&(ResultBuffer[next_bufno].imag==0));
-      ResultBuffer[next_bufno].imag        = 0;
-      ResultBuffer[next_bufno].FlagComplex = 0;
-     }
-    SETSTATUS(p, next_start, next_bufno);
-    i = start + next_start;
-    i--; p=i-start;
-   }
-  // PHASE 4b: EVALUATION OF ** IN CASE OF **-...
-  if (OpList[4]!=0) for (i=CalculatedEnd-1,p=len-1;p>0;i--,p--) if ((StatusRow[p]==7)&&(StatusRow[p-1]!=7))
-   {
-    if (MATCH_TWO('*','*'))
-     {
-      FETCHPREV(prev_start, prev_bufno, prev_end);
-      FETCHNEXT(next_start, next_bufno, next_end);
-      ppl_units_pow(ResultBuffer+prev_bufno , ResultBuffer+next_bufno , ResultBuffer+prev_bufno , errpos , errtext);
-      if (*errpos >= 0) { *errpos=i; return; }
-      SETSTATUS(prev_end, next_end, prev_bufno);
-     }
-   }
-  // PHASE  5: EVALUATION OF *  /  %
-  if (OpList[5]!=0) for (i=start,p=0;i<CalculatedEnd;i++,p++) if (StatusRow[p]==7)
-   {
-    if ((MATCH_ONE('*'))||(MATCH_ONE('/'))||(MATCH_ONE('%')))
-     {
-      FETCHPREV(prev_start, prev_bufno, prev_end);
-      FETCHNEXT(next_start, next_bufno, next_end);
-      if      (MATCH_ONE('*')) ppl_units_mult(ResultBuffer+prev_bufno , ResultBuffer+next_bufno , ResultBuffer+prev_bufno , errpos , errtext);
-      else if (MATCH_ONE('/')) ppl_units_div (ResultBuffer+prev_bufno , ResultBuffer+next_bufno , ResultBuffer+prev_bufno , errpos , errtext);
-      else if (MATCH_ONE('%')) ppl_units_mod (ResultBuffer+prev_bufno , ResultBuffer+next_bufno , ResultBuffer+prev_bufno , errpos , errtext);
-      if (*errpos >= 0) { *errpos=i; return; }
-      SETSTATUS(prev_end, next_end, prev_bufno);
-      i = start + next_start - 1; p=i-start;
-     } else {
-      while (StatusRow[p]==7) { i++; p++; }
-     }
-   }
-  // PHASE  6: EVALUATION OF +  -
-  if (OpList[6]!=0) for (i=start,p=0;i<CalculatedEnd;i++,p++) if (StatusRow[p]==7)
-   {
-    if ((MATCH_ONE('+'))||(MATCH_ONE('-')))
-     {
-      FETCHPREV(prev_start, prev_bufno, prev_end);
-      FETCHNEXT(next_start, next_bufno, next_end);
-      if      (MATCH_ONE('+')) ppl_units_add(ResultBuffer+prev_bufno , ResultBuffer+next_bufno , ResultBuffer+prev_bufno , errpos , errtext);
-      else if (MATCH_ONE('-')) ppl_units_sub(ResultBuffer+prev_bufno , ResultBuffer+next_bufno , ResultBuffer+prev_bufno , errpos , errtext);
-      if (*errpos >= 0) { *errpos=i; return; }
-      SETSTATUS(prev_end, next_end, prev_bufno);
-      i = start + next_start - 1; p=i-start;
-     } else {
-      while (StatusRow[p]==7) { i++; p++; }
-     }
-   }
-  // PHASE  7: EVALUATION OF << >>
-  if (OpList[7]!=0) for (i=start,p=0;i<CalculatedEnd;i++,p++) if (StatusRow[p]==7)
-   {
-    if ((MATCH_TWO('<','<'))||(MATCH_TWO('>','>')))
-     {
-      FETCHPREV(prev_start, prev_bufno, prev_end);
-      FETCHNEXT(next_start, next_bufno, next_end);
-      if ( (ResultBuffer[prev_bufno].dimensionless == 0) || (ResultBuffer[next_bufno].dimensionless == 0) )
-       {
-        if ( (ResultBuffer[prev_bufno].dimensionless == 0) && (ResultBuffer[next_bufno].dimensionless == 0) )
-         { *errpos=i; sprintf(errtext, "Binary operators can only be applied to dimensionless operands; here, the left operand has units of <%s> and the right operand has units of <%s>.", ppl_units_GetUnitStr(ResultBuffer+prev_bufno, NULL, NULL, 0, 1, 0), ppl_units_GetUnitStr(ResultBuffer+next_bufno, NULL, NULL, 1, 1, 0)); return; }
-        else if (ResultBuffer[prev_bufno].dimensionless == 0)
-         { *errpos=i; sprintf(errtext, "Binary operators can only be applied to dimensionless operands; here, the left operand has units of <%s>.", ppl_units_GetUnitStr(ResultBuffer+prev_bufno, NULL, NULL, 0, 1, 0) ); return; }
-        else
-         { *errpos=i; sprintf(errtext, "Binary operators can only be applied to dimensionless operands; here, the right operand has units of <%s>.", ppl_units_GetUnitStr(ResultBuffer+next_bufno, NULL, NULL, 0, 1, 0) ); return; }
-       }
-      if (ResultBuffer[prev_bufno].FlagComplex || ResultBuffer[next_bufno].FlagComplex)
-       { *errpos=i; sprintf(errtext, "Binary operators can only be applied to real operands; supplied operands have imaginary components."); return; }
-      if ((ResultBuffer[prev_bufno].real<=INT_MIN)||(ResultBuffer[prev_bufno].real>=INT_MAX)||(!gsl_finite(ResultBuffer[prev_bufno].real))||(ResultBuffer[next_bufno].real<=INT_MIN)||(ResultBuffer[next_bufno].real>=INT_MAX)||(!gsl_finite(ResultBuffer[next_bufno].real)))
-       { *errpos=i; sprintf(errtext, "Binary operators can only be applied to operands in the range %d<x<%d.",INT_MIN,INT_MAX); return; }
-      if      (MATCH_ONE('<')) ResultBuffer[prev_bufno].real = (double)((int)ResultBuffer[prev_bufno].real << (int)ResultBuffer[next_bufno].real);
-      else if (MATCH_ONE('>')) ResultBuffer[prev_bufno].real = (double)((int)ResultBuffer[prev_bufno].real >> (int)ResultBuffer[next_bufno].real);
-      if ((ResultBuffer[prev_bufno].real<=INT_MIN)||(ResultBuffer[prev_bufno].real>=INT_MAX)||(!gsl_finite(ResultBuffer[prev_bufno].real)))
-       { *errpos=i; sprintf(errtext, "Overflow error; the result of a binary operation must be in the range %d<x<%d.",INT_MIN,INT_MAX); return; }
-      SETSTATUS(prev_end, next_end, prev_bufno);
-      i = start + next_start - 1; p=i-start;
-     } else {
-      while (StatusRow[p]==7) { i++; p++; }
-     }
-   }
-  // PHASE  8: EVALUATION OF < <= >= >
-  if (OpList[8]!=0) for (i=CalculatedEnd-1,p=len-1;p>0;i--,p--) if ((StatusRow[p]==7)&&(StatusRow[p-1]!=7))
-   {
-    if ((MATCH_ONE('<'))||(MATCH_ONE('>')))
-     {
-      FETCHPREV(prev_start, prev_bufno, prev_end);
-      FETCHNEXT(next_start, next_bufno, next_end);
-      if (ppl_units_DimEqual(ResultBuffer+prev_bufno , ResultBuffer+next_bufno) == 0)
-       {
-        *errpos=i;
-        if      (ResultBuffer[prev_bufno].dimensionless)
-         { sprintf(errtext, "Attempt to compare a quantity which is dimensionless with one with dimensions of <%s>.", ppl_units_GetUnitStr(ResultBuffer+next_bufno,NULL,NULL,1,1,0)); }
-        else if (ResultBuffer[next_bufno].dimensionless)
-         { sprintf(errtext, "Attempt to compare a quantity with dimensions of <%s> with one which is dimensionless.", ppl_units_GetUnitStr(ResultBuffer+prev_bufno,NULL,NULL,0,1,0)); }
-        else
-         { sprintf(errtext, "Attempt to compare a quantity with dimensions of <%s> with one with dimensions of <%s>.", ppl_units_GetUnitStr(ResultBuffer+prev_bufno,NULL,NULL,0,1,0), ppl_units_GetUnitStr(ResultBuffer+next_bufno,NULL,NULL,1,1,0)); }
-        return;
-       }
-      if (ResultBuffer[prev_bufno].FlagComplex || ResultBuffer[next_bufno].FlagComplex)
-       { *errpos=i; sprintf(errtext, "Magnitude comparisons can only be applied to real operands; supplied operands have imaginary components."); return; }
-      TempDbl = ResultBuffer[prev_bufno].real;
-      ppl_units_zero(ResultBuffer+prev_bufno);
-      if      (MATCH_TWO('<','=')) ResultBuffer[prev_bufno].real = (double)(TempDbl <= ResultBuffer[next_bufno].real);
-      else if (MATCH_TWO('>','=')) ResultBuffer[prev_bufno].real = (double)(TempDbl >= ResultBuffer[next_bufno].real);
-      else if (MATCH_ONE('<')    ) ResultBuffer[prev_bufno].real = (double)(TempDbl <  ResultBuffer[next_bufno].real);
-      else if (MATCH_ONE('>')    ) ResultBuffer[prev_bufno].real = (double)(TempDbl >  ResultBuffer[next_bufno].real);
-      SETSTATUS(prev_end, next_end, prev_bufno);
-     }
-   }
-  // PHASE  9: EVALUATION OF == !=  <>
-  if (OpList[9]!=0) for (i=CalculatedEnd-1,p=len-1;p>0;i--,p--) if ((StatusRow[p]==7)&&(StatusRow[p-1]!=7))
-   {
-    if ((MATCH_TWO('=','='))||(MATCH_TWO('!','='))||(MATCH_TWO('<','>')))
-     {
-      FETCHPREV(prev_start, prev_bufno, prev_end);
-      FETCHNEXT(next_start, next_bufno, next_end);
-      if (ppl_units_DimEqual(ResultBuffer+prev_bufno , ResultBuffer+next_bufno) == 0)
-      if (ppl_units_DimEqual(ResultBuffer+prev_bufno , ResultBuffer+next_bufno) == 0)
-       {
-        *errpos=i;
-        if      (ResultBuffer[prev_bufno].dimensionless)
-         { sprintf(errtext, "Attempt to compare a quantity which is dimensionless with one with dimensions of <%s>.", ppl_units_GetUnitStr(ResultBuffer+next_bufno,NULL,NULL,1,1,0)); }
-        else if (ResultBuffer[next_bufno].dimensionless)
-         { sprintf(errtext, "Attempt to compare a quantity with dimensions of <%s> with one which is dimensionless.", ppl_units_GetUnitStr(ResultBuffer+prev_bufno,NULL,NULL,0,1,0)); }
-        else
-         { sprintf(errtext, "Attempt to compare a quantity with dimensions of <%s> with one with dimensions of <%s>.", ppl_units_GetUnitStr(ResultBuffer+prev_bufno,NULL,NULL,0,1,0), ppl_units_GetUnitStr(ResultBuffer+next_bufno,NULL,NULL,1,1,0)); }
-        return;
-       }
-      TempDbl = ResultBuffer[prev_bufno].real;
-      TempDbl2= ResultBuffer[prev_bufno].imag;
-      ppl_units_zero(ResultBuffer+prev_bufno);
-      if      (MATCH_TWO('=','=')) ResultBuffer[prev_bufno].real = (double) (ppl_units_DblEqual(TempDbl, ResultBuffer[next_bufno].real) && ppl_units_DblEqual(TempDbl2, ResultBuffer[next_bufno].imag));
-      else if (MATCH_TWO('!','=')) ResultBuffer[prev_bufno].real = (double)!(ppl_units_DblEqual(TempDbl, ResultBuffer[next_bufno].real) && ppl_units_DblEqual(TempDbl2, ResultBuffer[next_bufno].imag));
-      else if (MATCH_TWO('<','>')) ResultBuffer[prev_bufno].real = (double)!(ppl_units_DblEqual(TempDbl, ResultBuffer[next_bufno].real) && ppl_units_DblEqual(TempDbl2, ResultBuffer[next_bufno].imag));
-      SETSTATUS(prev_end, next_end, prev_bufno);
-     }
-   }
-  // PHASE 10: EVALUATION OF &
-  if (OpList[10]!=0) for (i=start,p=0;i<CalculatedEnd;i++,p++) if (StatusRow[p]==7)
-   {
-    if (MATCH_ONE('&'))
-     {
-      FETCHPREV(prev_start, prev_bufno, prev_end);
-      FETCHNEXT(next_start, next_bufno, next_end);
-      if ( (ResultBuffer[prev_bufno].dimensionless == 0) || (ResultBuffer[next_bufno].dimensionless == 0) )
-       {
-        if ( (ResultBuffer[prev_bufno].dimensionless == 0) && (ResultBuffer[next_bufno].dimensionless == 0) )
-         { *errpos=i; sprintf(errtext, "Binary operators can only be applied to dimensionless operands; here, the left operand has units of <%s> and the right operand has units of <%s>.", ppl_units_GetUnitStr(ResultBuffer+prev_bufno, NULL, NULL, 0, 1, 0), ppl_units_GetUnitStr(ResultBuffer+next_bufno, NULL, NULL, 1, 1, 0)); return; }
-        else if (ResultBuffer[prev_bufno].dimensionless == 0)
-         { *errpos=i; sprintf(errtext, "Binary operators can only be applied to dimensionless operands; here, the left operand has units of <%s>.", ppl_units_GetUnitStr(ResultBuffer+prev_bufno, NULL, NULL, 0, 1, 0) ); return; }
-        else
-         { *errpos=i; sprintf(errtext, "Binary operators can only be applied to dimensionless operands; here, the right operand has units of <%s>.", ppl_units_GetUnitStr(ResultBuffer+next_bufno, NULL, NULL, 0, 1, 0) ); return; }
-       }
-      if (ResultBuffer[prev_bufno].FlagComplex || ResultBuffer[next_bufno].FlagComplex)
-       { *errpos=i; sprintf(errtext, "Binary operators can only be applied to real operands; supplied operands have imaginary components."); return; }
-      if ((ResultBuffer[prev_bufno].real<=INT_MIN)||(ResultBuffer[prev_bufno].real>=INT_MAX)||(!gsl_finite(ResultBuffer[prev_bufno].real))||(ResultBuffer[next_bufno].real<=INT_MIN)||(ResultBuffer[next_bufno].real>=INT_MAX)||(!gsl_finite(ResultBuffer[next_bufno].real)))
-       { *errpos=i; sprintf(errtext, "Binary operators can only be applied to operands in the range %d<x<%d.",INT_MIN,INT_MAX); return; }
-      ResultBuffer[prev_bufno].real = (double)((int)ResultBuffer[prev_bufno].real & (int)ResultBuffer[next_bufno].real);
-      SETSTATUS(prev_end, next_end, prev_bufno);
-      i = start + next_start - 1; p=i-start;
-     } else {
-      while (StatusRow[p]==7) { i++; p++; }
-     }
-   }
-  // PHASE 11: EVALUATION OF ^
-  if (OpList[11]!=0) for (i=start,p=0;i<CalculatedEnd;i++,p++) if (StatusRow[p]==7)
-   {
-    if (MATCH_ONE('^'))
-     {
-      FETCHPREV(prev_start, prev_bufno, prev_end);
-      FETCHNEXT(next_start, next_bufno, next_end);
-      if ( (ResultBuffer[prev_bufno].dimensionless == 0) || (ResultBuffer[next_bufno].dimensionless == 0) )
-       {
-        if ( (ResultBuffer[prev_bufno].dimensionless == 0) && (ResultBuffer[next_bufno].dimensionless == 0) )
-         { *errpos=i; sprintf(errtext, "Binary operators can only be applied to dimensionless operands; here, the left operand has units of <%s> and the right operand has units of <%s>.", ppl_units_GetUnitStr(ResultBuffer+prev_bufno, NULL, NULL, 0, 1, 0), ppl_units_GetUnitStr(ResultBuffer+next_bufno, NULL, NULL, 1, 1, 0)); return; }
-        else if (ResultBuffer[prev_bufno].dimensionless == 0)
-         { *errpos=i; sprintf(errtext, "Binary operators can only be applied to dimensionless operands; here, the left operand has units of <%s>.", ppl_units_GetUnitStr(ResultBuffer+prev_bufno, NULL, NULL, 0, 1, 0) ); return; }
-        else
-         { *errpos=i; sprintf(errtext, "Binary operators can only be applied to dimensionless operands; here, the right operand has units of <%s>.", ppl_units_GetUnitStr(ResultBuffer+next_bufno, NULL, NULL, 0, 1, 0) ); return; }
-       }
-      if (ResultBuffer[prev_bufno].FlagComplex || ResultBuffer[next_bufno].FlagComplex)
-       { *errpos=i; sprintf(errtext, "Binary operators can only be applied to real operands; supplied operands have imaginary components."); return; }
-      if ((ResultBuffer[prev_bufno].real<=INT_MIN)||(ResultBuffer[prev_bufno].real>=INT_MAX)||(!gsl_finite(ResultBuffer[prev_bufno].real))||(ResultBuffer[next_bufno].real<=INT_MIN)||(ResultBuffer[next_bufno].real>=INT_MAX)||(!gsl_finite(ResultBuffer[next_bufno].real)))
-       { *errpos=i; sprintf(errtext, "Binary operators can only be applied to operands in the range %d<x<%d.",INT_MIN,INT_MAX); return; }
-      ResultBuffer[prev_bufno].real = (double)((int)ResultBuffer[prev_bufno].real ^ (int)ResultBuffer[next_bufno].real);
-      SETSTATUS(prev_end, next_end, prev_bufno);
-      i = start + next_start - 1; p=i-start;
-     } else {
-      while (StatusRow[p]==7) { i++; p++; }
-     }
-   }
-  // PHASE 12: EVALUATION OF |
-  if (OpList[12]!=0) for (i=start,p=0;i<CalculatedEnd;i++,p++) if (StatusRow[p]==7)
-   {
-    if (MATCH_ONE('|'))
-     {
-      FETCHPREV(prev_start, prev_bufno, prev_end);
-      FETCHNEXT(next_start, next_bufno, next_end);
-      if ( (ResultBuffer[prev_bufno].dimensionless == 0) || (ResultBuffer[next_bufno].dimensionless == 0) )
-       {
-        if ( (ResultBuffer[prev_bufno].dimensionless == 0) && (ResultBuffer[next_bufno].dimensionless == 0) )
-         { *errpos=i; sprintf(errtext, "Binary operators can only be applied to dimensionless operands; here, the left operand has units of <%s> and the right operand has units of <%s>.", ppl_units_GetUnitStr(ResultBuffer+prev_bufno, NULL, NULL, 0, 1, 0), ppl_units_GetUnitStr(ResultBuffer+next_bufno, NULL, NULL, 1, 1, 0)); return; }
-        else if (ResultBuffer[prev_bufno].dimensionless == 0)
-         { *errpos=i; sprintf(errtext, "Binary operators can only be applied to dimensionless operands; here, the left operand has units of <%s>.", ppl_units_GetUnitStr(ResultBuffer+prev_bufno, NULL, NULL, 0, 1, 0) ); return; }
-        else
-         { *errpos=i; sprintf(errtext, "Binary operators can only be applied to dimensionless operands; here, the right operand has units of <%s>.", ppl_units_GetUnitStr(ResultBuffer+next_bufno, NULL, NULL, 0, 1, 0) ); return; }
-       }
-      if (ResultBuffer[prev_bufno].FlagComplex || ResultBuffer[next_bufno].FlagComplex)
-       { *errpos=i; sprintf(errtext, "Binary operators can only be applied to real operands; supplied operands have imaginary components."); return; }
-      if ((ResultBuffer[prev_bufno].real<=INT_MIN)||(ResultBuffer[prev_bufno].real>=INT_MAX)||(!gsl_finite(ResultBuffer[prev_bufno].real))||(ResultBuffer[next_bufno].real<=INT_MIN)||(ResultBuffer[next_bufno].real>=INT_MAX)||(!gsl_finite(ResultBuffer[next_bufno].real)))
-       { *errpos=i; sprintf(errtext, "Binary operators can only be applied to operands in the range %d<x<%d.",INT_MIN,INT_MAX); return; }
-      ResultBuffer[prev_bufno].real = (double)((int)ResultBuffer[prev_bufno].real | (int)ResultBuffer[next_bufno].real);
-      SETSTATUS(prev_end, next_end, prev_bufno);
-      i = start + next_start - 1; p=i-start;
-     } else {
-      while (StatusRow[p]==7) { i++; p++; }
-     }
-   }
-  // PHASE 13: EVALUATION OF and
-  if (OpList[13]!=0) for (i=start,p=0;i<CalculatedEnd;i++,p++) if (StatusRow[p]==7)
-   {
-    if (MATCH_THR('a','n','d'))
-     {
-      FETCHPREV(prev_start, prev_bufno, prev_end);
-      FETCHNEXT(next_start, next_bufno, next_end);
-      if ( (ResultBuffer[prev_bufno].dimensionless == 0) || (ResultBuffer[next_bufno].dimensionless == 0) )
-       {
-        if ( (ResultBuffer[prev_bufno].dimensionless == 0) && (ResultBuffer[next_bufno].dimensionless == 0) )
-         { *errpos=i; sprintf(errtext, "Logical operators can only be applied to dimensionless operands; here, the left operand has units of <%s> and the right operand has units of <%s>.", ppl_units_GetUnitStr(ResultBuffer+prev_bufno, NULL, NULL, 0, 1, 0), ppl_units_GetUnitStr(ResultBuffer+next_bufno, NULL, NULL, 1, 1, 0)); return; }
-        else if (ResultBuffer[prev_bufno].dimensionless == 0)
-         { *errpos=i; sprintf(errtext, "Logical operators can only be applied to dimensionless operands; here, the left operand has units of <%s>.", ppl_units_GetUnitStr(ResultBuffer+prev_bufno, NULL, NULL, 0, 1, 0) ); return; }
-        else
-         { *errpos=i; sprintf(errtext, "Logical operators can only be applied to dimensionless operands; here, the right operand has units of <%s>.", ppl_units_GetUnitStr(ResultBuffer+next_bufno, NULL, NULL, 0, 1, 0) ); return; }
-       }
-      if (ResultBuffer[prev_bufno].FlagComplex || ResultBuffer[next_bufno].FlagComplex)
-       { *errpos=i; sprintf(errtext, "Logical operators can only be applied to real operands; supplied operands have imaginary components."); return; }
-      if ((ResultBuffer[prev_bufno].real<=INT_MIN)||(ResultBuffer[prev_bufno].real>=INT_MAX)||(!gsl_finite(ResultBuffer[prev_bufno].real))||(ResultBuffer[next_bufno].real<=INT_MIN)||(ResultBuffer[next_bufno].real>=INT_MAX)||(!gsl_finite(ResultBuffer[next_bufno].real)))
-       { *errpos=i; sprintf(errtext, "Logical operators can only be applied to operands in the range %d<x<%d.",INT_MIN,INT_MAX); return; }
-      ResultBuffer[prev_bufno].real = (double)((int)ResultBuffer[prev_bufno].real && (int)ResultBuffer[next_bufno].real);
-      SETSTATUS(prev_end, next_end, prev_bufno);
-      i = start + next_start - 1; p=i-start;
-     } else {
-      while (StatusRow[p]==7) { i++; p++; }
-     }
-   }
-  // PHASE 14: EVALUATION OF or
-  if (OpList[14]!=0) for (i=start,p=0;i<CalculatedEnd;i++,p++) if (StatusRow[p]==7)
-   {
-    if (MATCH_TWO('o','r'))
-     {
-      FETCHPREV(prev_start, prev_bufno, prev_end);
-      FETCHNEXT(next_start, next_bufno, next_end);
-      if ( (ResultBuffer[prev_bufno].dimensionless == 0) || (ResultBuffer[next_bufno].dimensionless == 0) )
-       {
-        if ( (ResultBuffer[prev_bufno].dimensionless == 0) && (ResultBuffer[next_bufno].dimensionless == 0) )
-         { *errpos=i; sprintf(errtext, "Logical operators can only be applied to dimensionless operands; here, the left operand has units of <%s> and the right operand has units of <%s>.", ppl_units_GetUnitStr(ResultBuffer+prev_bufno, NULL, NULL, 0, 1, 0), ppl_units_GetUnitStr(ResultBuffer+next_bufno, NULL, NULL, 1, 1, 0)); return; }
-        else if (ResultBuffer[prev_bufno].dimensionless == 0)
-         { *errpos=i; sprintf(errtext, "Logical operators can only be applied to dimensionless operands; here, the left operand has units of <%s>.", ppl_units_GetUnitStr(ResultBuffer+prev_bufno, NULL, NULL, 0, 1, 0) ); return; }
-        else
-         { *errpos=i; sprintf(errtext, "Logical operators can only be applied to dimensionless operands; here, the right operand has units of <%s>.", ppl_units_GetUnitStr(ResultBuffer+next_bufno, NULL, NULL, 0, 1, 0) ); return; }
-       }
-      if (ResultBuffer[prev_bufno].FlagComplex || ResultBuffer[next_bufno].FlagComplex)
-       { *errpos=i; sprintf(errtext, "Logical operators can only be applied to real operands; supplied operands have imaginary components."); return; }
-      if ((ResultBuffer[prev_bufno].real<=INT_MIN)||(ResultBuffer[prev_bufno].real>=INT_MAX)||(!gsl_finite(ResultBuffer[prev_bufno].real))||(ResultBuffer[next_bufno].real<=INT_MIN)||(ResultBuffer[next_bufno].real>=INT_MAX)||(!gsl_finite(ResultBuffer[next_bufno].real)))
-       { *errpos=i; sprintf(errtext, "Logical operators can only be applied to operands in the range %d<x<%d.",INT_MIN,INT_MAX); return; }
-      ResultBuffer[prev_bufno].real = (double)((int)ResultBuffer[prev_bufno].real || (int)ResultBuffer[next_bufno].real);
-      SETSTATUS(prev_end, next_end, prev_bufno);
-      i = start + next_start - 1; p=i-start;
-     } else {
-      while (StatusRow[p]==7) { i++; p++; }
-     }
-   }
-  // PHASE 15: RETURN RESULT TO USER
-  for (i=0;i<len;i++) if (StatusRow[i] >= BUFFER_OFFSET) { *out = ResultBuffer[ StatusRow[i] - BUFFER_OFFSET ]; out->modified=0; out->string=NULL; return; }
-  // for (i=0;i<len;i++) printf("%c",(StatusRow[i]+'A')); printf("\n"); // DEBUG LINE
-  *errpos = start;
-  strcpy(errtext,"Internal Error: ppl_EvaluateAlgebra failed to evaluate this expression"); // Oops
+  e = ppl_CompileAlgebraCached(in, start, end, DollarAllowed, errpos, errtext, RecursionDepth);
+  if (e == NULL) return;
+  ppl_EvaluateCompiled(e, NULL, out, errpos, errtext, RecursionDepth);
+  ppl_CompiledAlgebraRelease(e);
   return;
  }
 
@@ -92,6 +92,7 @@ typedef struct FunctionDescriptor {
 extern Dict *_ppl_UserSpace_Vars;
 extern Dict *_ppl_UserSpace_Funcs;
 extern Dict *_ppl_UserSpace_Funcs2;
+extern int   _ppl_UserSpace_Generation;
 #endif
 
 void ppl_UserSpaceInit              ();
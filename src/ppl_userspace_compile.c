@@ -0,0 +1,1329 @@
+// ppl_userspace_compile.c
+//
+// The code in this file is part of PyXPlot
+// <http://www.pyxplot.org.uk>
+//
+// Copyright (C) 2006-2011 Dominic Ford <coders@pyxplot.org.uk>
+//               2008-2011 Ross Church
+//
+// $Id$
+//
+// PyXPlot is free software; you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation; either version 2 of the License, or (at your option) any later
+// version.
+//
+// You should have received a copy of the GNU General Public License along with
+// PyXPlot; if not, write to the Free Software Foundation, Inc., 51 Franklin
+// Street, Fifth Floor, Boston, MA  02110-1301, USA
+
+// ----------------------------------------------------------------------------
+
+#define _PPL_USERSPACE_COMPILE_C 1
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <limits.h>
+#include <float.h>
+#include <math.h>
+
+#include <gsl/gsl_math.h>
+
+#include "StringTools/asciidouble.h"
+#include "StringTools/str_constants.h"
+
+#include "ListTools/lt_dict.h"
+
+#include "MathsTools/dcfmath.h"
+#include "MathsTools/dcfstr.h"
+#include "MathsTools/dcftime.h"
+
+#include "ppl_calculus.h"
+#include "ppl_constants.h"
+#include "ppl_datafile.h"
+#include "ppl_fft.h"
+#include "ppl_flowctrl.h"
+#include "ppl_histogram.h"
+#include "ppl_interpolation.h"
+#include "ppl_settings.h"
+#include "ppl_setting_types.h"
+#include "ppl_units.h"
+#include "ppl_units_fns.h"
+#include "ppl_userspace.h"
+#include "ppl_userspace_compile.h"
+
+// Types of node which can appear in a compiled expression
+#define ALGNODE_CONST       1
+#define ALGNODE_VAR         2
+#define ALGNODE_SLOT        3
+#define ALGNODE_UNARY       4
+#define ALGNODE_BINARY      5
+#define ALGNODE_CALL        6  // System function taking a fixed number of numeric arguments
+#define ALGNODE_CALLTEXT    7  // System function which parses the text of its own arguments
+#define ALGNODE_COND        8  // conditionalN()
+#define ALGNODE_SPLINE      9
+#define ALGNODE_INTERP2D   10
+#define ALGNODE_BMPDATA    11
+#define ALGNODE_HISTOGRAM  12
+#define ALGNODE_FFT        13
+#define ALGNODE_SUBROUTINE 14
+#define ALGNODE_INT        15
+#define ALGNODE_DIFF       16
+#define ALGNODE_COLUMN     17  // $2 or $(expr)
+#define ALGNODE_COLNAME    18  // $name
+#define ALGNODE_USERFN     19
+#define ALGNODE_TEXT       20  // Call which could not be inlined, e.g. a recursive function; evaluated from text
+#define ALGNODE_ERROR      21  // Error which is only reported if this node is evaluated
+
+// Operators
+#define ALGOP_NEG   1
+#define ALGOP_NOT   2
+#define ALGOP_POW   3
+#define ALGOP_MUL   4
+#define ALGOP_DIV   5
+#define ALGOP_MOD   6
+#define ALGOP_ADD   7
+#define ALGOP_SUB   8
+#define ALGOP_SHL   9
+#define ALGOP_SHR  10
+#define ALGOP_LT   11
+#define ALGOP_LE   12
+#define ALGOP_GE   13
+#define ALGOP_GT   14
+#define ALGOP_EQ   15
+#define ALGOP_NE   16
+#define ALGOP_BAND 17
+#define ALGOP_BXOR 18
+#define ALGOP_BOR  19
+#define ALGOP_AND  20
+#define ALGOP_OR   21
+
+// Calls to user-defined functions stop being inlined beyond this number of nodes; they are evaluated from text instead
+#define COMPILE_MAX_NODES 16384
+
+// Status codes returned by ppl_GetExpression()
+#define ATOM_B 3
+#define ATOM_D 4
+#define ATOM_M 5
+#define ATOM_N 6
+#define ATOM_O 7
+#define ATOM_V 8
+
+typedef struct AlgebraToken {
+ unsigned char type;
+ int start, end, TextEnd; // TextEnd excludes trailing whitespace
+ } AlgebraToken;
+
+// The names of arguments which are bound to workspace slots within the body of a function being inlined
+typedef struct CompileScope {
+ int    NArgs;
+ char  *ArgList;
+ int    SlotBase;
+ FunctionDescriptor  *def;
+ struct CompileScope *parent;
+ } CompileScope;
+
+typedef struct CompileState {
+ CompiledAlgebra *e;
+ char            *in;
+ AlgebraToken    *tok;
+ int              Ntok, i;
+ int              start, depth;
+ CompileScope    *scope;
+ int             *errpos;
+ char            *errtext;
+ } CompileState;
+
+#define ENFORCEANGLEDIMLESS(X) \
+ if ((settings_term_current.UnitAngleDimless == SW_ONOFF_ON) && ((X)->exponent[UNIT_ANGLE]!=0)) \
+  { \
+   int i_; \
+   (X)->exponent[UNIT_ANGLE] = 0; \
+   (X)->dimensionless = 1; \
+   for (i_=0; i_<UNITS_MAX_BASEUNITS; i_++) if ((X)->exponent[i_]!=0.0) { (X)->dimensionless=0; break; } \
+  }
+
+#define MEMORY_ERROR(POS) { *errpos=(POS); strcpy(errtext, "Memory Error: Out of Memory."); }
+
+static AlgebraNode *CompileSub(CompiledAlgebra *e, char *in, int start, int *end, int depth, CompileScope *scope, unsigned char *StatusIn, int *errpos, char *errtext);
+static AlgebraNode *ParseOr   (CompileState *s);
+static AlgebraNode *ParseUnary(CompileState *s);
+static void         EvalNode  (CompiledAlgebra *e, AlgebraNode *n, value *ws, value *out, int *errpos, char *errtext, int RecursionDepth);
+
+// ------------------------------------
+// Allocation of nodes within the tree
+// ------------------------------------
+
+static AlgebraNode *NewNode(CompiledAlgebra *e, int type, int pos, int pos2, int NChild)
+ {
+  AlgebraNode *n = (AlgebraNode *)malloc(sizeof(AlgebraNode));
+  if (n==NULL) return NULL;
+  memset(n, 0, sizeof(AlgebraNode));
+  n->type = type;
+  n->pos  = pos;
+  n->pos2 = pos2;
+  n->NChild = NChild;
+  if (NChild>0)
+   {
+    n->child = (AlgebraNode **)malloc(NChild * sizeof(AlgebraNode *));
+    if (n->child==NULL) { free(n); return NULL; }
+    memset(n->child, 0, NChild * sizeof(AlgebraNode *));
+   }
+  n->next  = e->nodes;
+  e->nodes = n;
+  e->NNodes++;
+  return n;
+ }
+
+static char *StrDupLen(const char *in, int len)
+ {
+  char *out = (char *)malloc(len+1);
+  if (out==NULL) return NULL;
+  memcpy(out, in, len);
+  out[len]='\0';
+  return out;
+ }
+
+static AlgebraNode *ErrorNode(CompiledAlgebra *e, int pos, char *errtext)
+ {
+  AlgebraNode *n = NewNode(e, ALGNODE_ERROR, pos, pos, 0);
+  if (n==NULL) return NULL;
+  if ((n->text = StrDupLen(errtext, strlen(errtext)))==NULL) return NULL;
+  return n;
+ }
+
+static void FreeNodes(CompiledAlgebra *e)
+ {
+  AlgebraNode *n, *next;
+  for (n=e->nodes; n!=NULL; n=next)
+   {
+    next = n->next;
+    if (n->child  !=NULL) free(n->child);
+    if (n->name   !=NULL) free(n->name);
+    if (n->text   !=NULL) free(n->text);
+    if (n->AltDef !=NULL) free(n->AltDef);
+    if (n->AltBody!=NULL) free(n->AltBody);
+    free(n);
+   }
+  e->nodes  = NULL;
+  e->root   = NULL;
+  e->NNodes = 0;
+ }
+
+// --------------------------------------------------------------
+// Parsing: operators in order of increasing precedence. Numbers,
+// variables, function calls and bracketed expressions are atoms.
+// --------------------------------------------------------------
+
+#define TOK(J)     (s->tok[s->i+(J)])
+#define HAVETOK(J) (s->i+(J) < s->Ntok)
+#define C0(T)      (s->in[(T).start])
+#define C1(T)      (s->in[(T).start+1])
+
+static int MatchOperator(CompileState *s, int level)
+ {
+  AlgebraToken t;
+  char a, b;
+  if ((!HAVETOK(0)) || (TOK(0).type!=ATOM_O)) return 0;
+  t = TOK(0); a = C0(t); b = C1(t);
+  switch (level)
+   {
+    case 0: if ((a=='o')&&(b=='r')) return ALGOP_OR; break;
+    case 1: if ((a=='a')&&(b=='n')) return ALGOP_AND; break;
+    case 2: if (a=='|') return ALGOP_BOR; break;
+    case 3: if (a=='^') return ALGOP_BXOR; break;
+    case 4: if (a=='&') return ALGOP_BAND; break;
+    case 5: if ((a=='=')&&(b=='=')) return ALGOP_EQ;
+            if ((a=='!')&&(b=='=')) return ALGOP_NE;
+            if ((a=='<')&&(b=='>')) return ALGOP_NE;
+            break;
+    case 6: if ((a=='<')&&(b=='=')) return ALGOP_LE;
+            if ((a=='>')&&(b=='=')) return ALGOP_GE;
+            if ((a=='<')&&(b!='<')&&(b!='>')) return ALGOP_LT;
+            if ((a=='>')&&(b!='>')) return ALGOP_GT;
+            break;
+    case 7: if ((a=='<')&&(b=='<')) return ALGOP_SHL;
+            if ((a=='>')&&(b=='>')) return ALGOP_SHR;
+            break;
+    case 8: if (a=='+') return ALGOP_ADD;
+            if (a=='-') return ALGOP_SUB;
+            break;
+    case 9: if ((a=='*')&&(b!='*')) return ALGOP_MUL;
+            if (a=='/') return ALGOP_DIV;
+            if (a=='%') return ALGOP_MOD;
+            break;
+   }
+  return 0;
+ }
+
+static AlgebraNode *BinaryNode(CompileState *s, int op, int pos, AlgebraNode *a, AlgebraNode *b)
+ {
+  AlgebraNode *n;
+  if ((a==NULL)||(b==NULL)) return NULL;
+  n = NewNode(s->e, ALGNODE_BINARY, pos, s->start, 2);
+  if (n==NULL) { *s->errpos=pos; strcpy(s->errtext, "Memory Error: Out of Memory."); return NULL; }
+  n->op = op;
+  n->child[0] = a;
+  n->child[1] = b;
+  return n;
+ }
+
+// Left-associative binary operators
+static AlgebraNode *ParseLevel(CompileState *s, int level)
+ {
+  AlgebraNode *a;
+  int op, pos;
+  if (level==5) // == != <> associate right-to-left, as do < <= >= >
+   {
+    a = ParseLevel(s, 6);
+    if ((a==NULL) || ((op=MatchOperator(s,5))==0)) return a;
+    pos = TOK(0).start; s->i++;
+    return BinaryNode(s, op, pos, a, ParseLevel(s, 5));
+   }
+  if (level==6)
+   {
+    a = ParseLevel(s, 7);
+    if ((a==NULL) || ((op=MatchOperator(s,6))==0)) return a;
+    pos = TOK(0).start; s->i++;
+    return BinaryNode(s, op, pos, a, ParseLevel(s, 6));
+   }
+  if (level==10) return ParseUnary(s);
+  a = ParseLevel(s, level+1);
+  while ((a!=NULL) && ((op=MatchOperator(s,level))!=0))
+   {
+    pos = TOK(0).start; s->i++;
+    a = BinaryNode(s, op, pos, a, ParseLevel(s, level+1));
+   }
+  return a;
+ }
+
+static AlgebraNode *ParseOr(CompileState *s) { return ParseLevel(s, 0); }
+
+static AlgebraNode *ParseCall  (CompileState *s);
+static AlgebraNode *ParsePower (CompileState *s);
+
+static AlgebraNode *ParseAtom(CompileState *s)
+ {
+  AlgebraNode  *n, *c;
+  AlgebraToken  t;
+  char         *in = s->in;
+  int           j, k, pos;
+  value        *VarData;
+  int          *errpos = s->errpos;
+  char         *errtext = s->errtext;
+  CompileScope *scope;
+
+  if (!HAVETOK(0)) { *s->errpos=s->start; strcpy(s->errtext, "Internal Error: ppl_EvaluateAlgebra failed to evaluate this expression"); return NULL; }
+  t = TOK(0);
+
+  if (t.type==ATOM_N) // Numeric constant
+   {
+    s->i++;
+    if ((n = NewNode(s->e, ALGNODE_CONST, t.start, s->start, 0))==NULL) { MEMORY_ERROR(t.start) ; return NULL; }
+    ppl_units_zero(&n->v);
+    n->v.real = GetFloat(in+t.start, &j);
+    j+=t.start; while ((in[j]>'\0')&&(in[j]<=' ')) j++;
+    if (j!=t.end) { *s->errpos=t.start; strcpy(s->errtext,"Syntax Error: Unexpected trailing matter after numeric constant."); return NULL; }
+    return n;
+   }
+  else if (t.type==ATOM_B) // Bracketed expression
+   {
+    s->i++;
+    j=-1;
+    n = CompileSub(s->e, in, t.start+1, &j, s->depth+1, s->scope, NULL, s->errpos, s->errtext);
+    if (n==NULL) return NULL;
+    while ((in[j]>'\0')&&(in[j]<=' ')) j++;
+    if (in[j]!=')') { *s->errpos=j; strcpy(s->errtext,"Syntax Error: Unexpected trailing matter within brackets."); return NULL; }
+    return n;
+   }
+  else if (t.type==ATOM_D) // $ column reference
+   {
+    s->i++;
+    if (!HAVETOK(0)) { *s->errpos=t.start; strcpy(s->errtext, "Internal Error: ppl_EvaluateAlgebra failed to evaluate this expression"); return NULL; }
+    if ((TOK(0).type==ATOM_V) && !(HAVETOK(1) && (TOK(1).type==ATOM_B))) // $ColumnName
+     {
+      if ((n = NewNode(s->e, ALGNODE_COLNAME, TOK(0).start, s->start, 0))==NULL) { MEMORY_ERROR(t.start) ; return NULL; }
+      if ((n->name = StrDupLen(in+TOK(0).start, TOK(0).TextEnd-TOK(0).start))==NULL) { MEMORY_ERROR(t.start) ; return NULL; }
+      n->AngleFix = 1;
+      s->i++;
+      return n;
+     }
+    c = ParseAtom(s); // $45, $(45) or $f(x)
+    if (c==NULL) return NULL;
+    if ((n = NewNode(s->e, ALGNODE_COLUMN, t.start, s->start, 1))==NULL) { MEMORY_ERROR(t.start) ; return NULL; }
+    n->child[0] = c;
+    n->AngleFix = 1;
+    return n;
+   }
+  else if (t.type==ATOM_V)
+   {
+    if (HAVETOK(1) && (TOK(1).type==ATOM_B)) return ParseCall(s);
+    s->i++;
+    pos = t.start;
+    for (scope=s->scope; scope!=NULL; scope=scope->parent) // Variables which are arguments of functions being inlined are bound to workspace slots
+     {
+      for (j=0,k=0; k<scope->NArgs; k++)
+       {
+        if ((strncmp(scope->ArgList+j, in+t.start, t.TextEnd-t.start)==0) && (scope->ArgList[j+t.TextEnd-t.start]=='\0'))
+         {
+          if ((n = NewNode(s->e, ALGNODE_SLOT, pos, s->start, 0))==NULL) { MEMORY_ERROR(pos) ; return NULL; }
+          n->slot = scope->SlotBase + k;
+          n->AngleFix = 1;
+          return n;
+         }
+        j += strlen(scope->ArgList+j)+1;
+       }
+     }
+    if ((n = NewNode(s->e, ALGNODE_VAR, pos, s->start, 0))==NULL) { MEMORY_ERROR(pos) ; return NULL; }
+    if ((n->name = StrDupLen(in+t.start, t.TextEnd-t.start))==NULL) { MEMORY_ERROR(pos) ; return NULL; }
+    DictLookup(_ppl_UserSpace_Vars, n->name, NULL, (void *)&VarData);
+    n->var = VarData;
+    n->AngleFix = 1;
+    return n;
+   }
+  *s->errpos=t.start; strcpy(s->errtext, "Internal Error: ppl_EvaluateAlgebra failed to evaluate this expression");
+  return NULL;
+ }
+
+// The string evaluator applies ** in two passes: first every ** whose right operand is not signed, right-to-left;
+// then minus signs; then the remaining ** right-to-left. Hence 2**3**-1 is (2**3)**-1 and -2**-2 is (-2)**-2.
+// ParsePower groups the unsigned powers; ParseUnary applies signs to such a group and chains the signed powers.
+#define POWER_TOKEN(J) (HAVETOK(J) && (TOK(J).type==ATOM_O) && (C0(TOK(J))=='*') && (C1(TOK(J))=='*'))
+
+static AlgebraNode *ParsePower(CompileState *s)
+ {
+  AlgebraNode *a;
+  int pos;
+  a = ParseAtom(s);
+  if (a==NULL) return NULL;
+  if (POWER_TOKEN(0) && HAVETOK(1) && (TOK(1).type!=ATOM_M))
+   {
+    pos = TOK(0).start; s->i++;
+    return BinaryNode(s, ALGOP_POW, pos, a, ParsePower(s));
+   }
+  return a;
+ }
+
+static AlgebraNode *ParseSigned(CompileState *s)
+ {
+  AlgebraNode *n, *a;
+  int pos, op;
+  int *errpos = s->errpos;
+  char *errtext = s->errtext;
+  if (HAVETOK(0) && (TOK(0).type==ATOM_M))
+   {
+    pos = TOK(0).start;
+    op  = (C0(TOK(0))=='-') ? ALGOP_NEG : ALGOP_NOT;
+    s->i++;
+    a = ParseSigned(s);
+    if (a==NULL) return NULL;
+    if ((n = NewNode(s->e, ALGNODE_UNARY, pos, s->start, 1))==NULL) { MEMORY_ERROR(pos) ; return NULL; }
+    n->op = op;
+    n->child[0] = a;
+    return n;
+   }
+  return ParsePower(s);
+ }
+
+static AlgebraNode *ParseUnary(CompileState *s)
+ {
+  AlgebraNode *a;
+  int pos;
+  a = ParseSigned(s);
+  if (a==NULL) return NULL;
+  if (POWER_TOKEN(0))
+   {
+    pos = TOK(0).start; s->i++;
+    return BinaryNode(s, ALGOP_POW, pos, a, ParseUnary(s));
+   }
+  return a;
+ }
+
+// Compile the text of a call to a function which cannot be inlined, to be evaluated by ppl_EvaluateAlgebra()
+static AlgebraNode *TextNode(CompileState *s, AlgebraToken *name, AlgebraToken *bracket)
+ {
+  AlgebraNode *n;
+  int len;
+  int *errpos = s->errpos;
+  char *errtext = s->errtext;
+  for (len=bracket->end; (len>bracket->start) && (s->in[len-1]<=' '); len--);
+  if ((n = NewNode(s->e, ALGNODE_TEXT, name->start, s->start, 0))==NULL) { MEMORY_ERROR(name->start) ; return NULL; }
+  if ((n->text = StrDupLen(s->in+name->start, len-name->start))==NULL) { MEMORY_ERROR(name->start) ; return NULL; }
+  n->AngleFix = 1;
+  s->e->NeedsGlobals = 1;
+  return n;
+ }
+
+// f(x)
+static AlgebraNode *ParseCall(CompileState *s)
+ {
+  AlgebraToken  name = TOK(0), bracket = TOK(1);
+  char         *in = s->in, *integrand=NULL, ck;
+  char          FuncName[LSTR_LENGTH], dummy[DUMMYVAR_MAXLEN];
+  DictItem     *DictItem;
+  FunctionDescriptor *fd, *FuncDef;
+  AlgebraNode  *n, *args[ALGEBRA_MAXITEMS];
+  CompileScope *scope, NewScope;
+  int           i, j, k, NArgs, FunctionType, IntegrandLen=0, OptionalStep=0;
+  int          *errpos = s->errpos;
+  char         *errtext = s->errtext;
+
+  s->i += 2;
+  for (j=0; ((j<LSTR_LENGTH-1) && (isalnum(in[name.start+j]) || (in[name.start+j]=='_'))); j++) FuncName[j]=in[name.start+j];
+  FuncName[j]='\0';
+  DictLookupWithWildcard(_ppl_UserSpace_Funcs, _ppl_UserSpace_Funcs2, FuncName, dummy, DUMMYVAR_MAXLEN, &DictItem);
+  if (DictItem == NULL) { *errpos=name.start; strcpy(errtext,"No such function"); return NULL; }
+  fd           = (FunctionDescriptor *)DictItem->data;
+  FunctionType = fd->FunctionType;
+  NArgs        = (FunctionType == PPL_USERSPACE_SUBROUTINE) ? -1 : fd->NumberArguments;
+  i            = bracket.start+1;
+
+  if (FunctionType == PPL_USERSPACE_USERDEF) // Recursive functions, and very large expressions, are not inlined
+   {
+    for (scope=s->scope; scope!=NULL; scope=scope->parent) if (scope->def==fd) return TextNode(s, &name, &bracket);
+    if ((s->depth >= MAX_RECURSION_DEPTH) || (s->e->NNodes > COMPILE_MAX_NODES)) return TextNode(s, &name, &bracket);
+   }
+
+  for (k=0; k<NArgs; k++) // Now collect together numeric arguments
+   {
+    if (k >= ALGEBRA_MAXITEMS-2) { *errpos = i; strcpy(errtext,"Internal Error: Temporary results buffer overflow."); return NULL; }
+    args[k]=NULL;
+    while ((in[i]>'\0')&&(in[i]<=' ')) i++;
+    if (in[i]==')') { *errpos = i; strcpy(errtext,"Syntax Error: Too few arguments supplied to function."); return NULL; }
+    j=-1;
+    if ((k==0)&&(FunctionType == PPL_USERSPACE_INT)) // First argument is an integrand, which we should not evaluate
+     {
+      unsigned char StatusRow[ALGEBRA_MAXLENGTH];
+      unsigned char OpList[OPLIST_LEN];
+      if ((in[i]=='\'') || (in[i]=='\"')) { ck=in[i]; i++; } else { ck='\0'; }
+      while ((in[i]>'\0')&&(in[i]<=' ')) i++;
+      integrand = in+i; // Integrand starts here
+      ppl_GetExpression(in+i, &j, s->e->DollarAllowed, StatusRow, OpList, errpos, errtext);
+      if (*errpos >= 0) { (*errpos) += i; return NULL; }
+      IntegrandLen = j;
+      i+=j;
+      while ((in[i]>'\0')&&(in[i]<=' ')) i++;
+      if (ck>'\0')
+       {
+        if (in[i]!=ck) { *errpos = i; strcpy(errtext,"Syntax Error: Was expecting a closing quote."); return NULL; }
+        else           i++;
+       }
+     } else { // otherwise, we compile the argument
+      args[k] = CompileSub(s->e, in, i, &j, s->depth+1, s->scope, NULL, errpos, errtext);
+      if (args[k]==NULL) return NULL;
+      i=j;
+     }
+    while ((in[i]>'\0')&&(in[i]<=' ')) i++;
+    if (k < NArgs-1)
+     {
+      if (in[i] != ',')
+       {
+        *errpos = i;
+        if (in[i] ==')')
+         {
+          if ((FunctionType == PPL_USERSPACE_INT) && (DictItem->key[0]!='i') && (k==NArgs-2)) // Last argument to diff_dx is optional
+           {
+            OptionalStep=1;
+            args[k+1]=NULL;
+            *errpos=-1;
+            break;
+           }
+          strcpy(errtext,"Syntax Error: Too few arguments supplied to function.");
+         }
+        else                   strcpy(errtext,"Syntax Error: Unexpected trailing matter after argument to function.");
+        return NULL;
+       } else { i++; }
+     }
+   }
+
+  if (FunctionType == PPL_USERSPACE_SUBROUTINE)
+   {
+    if ((n = NewNode(s->e, ALGNODE_SUBROUTINE, name.start, s->start, 0))==NULL) { MEMORY_ERROR(name.start) ; return NULL; }
+    if ((n->name = StrDupLen(DictItem->key, strlen(DictItem->key)))==NULL) { MEMORY_ERROR(name.start) ; return NULL; }
+    if ((n->text = StrDupLen(in+i, bracket.end-i))==NULL) { MEMORY_ERROR(name.start) ; return NULL; }
+    n->slot     = i; // Position of the start of the argument list
+    n->AngleFix = 1;
+    s->e->NeedsGlobals = 1;
+    return n;
+   }
+  else if (FunctionType == PPL_USERSPACE_STRFUNC)
+   {
+    *errpos = name.start;
+    strcpy(errtext,"Type Error: This function returns a string where a numeric result was expected.");
+    return NULL;
+   }
+  else if ((FunctionType == PPL_USERSPACE_SYSTEM) && (NArgs==-1) && (fd->FunctionPtr == (void *)&dcfstr_conditionalN))
+   {
+    // conditionalN(a,b,c) is compiled natively, so that its arguments do not need to be parsed each time it is evaluated
+    if ((n = NewNode(s->e, ALGNODE_COND, name.start, s->start, 3))==NULL) { MEMORY_ERROR(name.start) ; return NULL; }
+    n->AngleFix = 1;
+    for (k=0; k<3; k++)
+     {
+      if (k>0)
+       {
+        if (in[i] != ',')
+         {
+          *errpos = i;
+          if (in[i] ==')') strcpy(errtext,"Syntax Error: Too few arguments supplied to function.");
+          else             strcpy(errtext,"Syntax Error: Unexpected trailing matter after argument to function.");
+          return NULL;
+         }
+        i++;
+       }
+      j=-1;
+      n->child[k] = CompileSub(s->e, in, i, &j, s->depth+1, s->scope, NULL, errpos, errtext);
+      if (n->child[k]==NULL) return NULL;
+      i=j;
+      while ((in[i]>'\0')&&(in[i]<=' ')) i++;
+     }
+    if (in[i] != ')')
+     {
+      *errpos = i;
+      if (in[i] == ',') strcpy(errtext,"Syntax Error: Too many arguments supplied to function.");
+      else              strcpy(errtext,"Syntax Error: Unexpected trailing matter after argument to function.");
+      return NULL;
+     }
+    return n;
+   }
+  else if ((FunctionType == PPL_USERSPACE_SYSTEM) && (NArgs==-1))
+   {
+    StrBracketMatch(in+bracket.start,NULL,NULL,&k,0);
+    if (k<=0) { *errpos=bracket.start; strcpy(errtext,"Syntax Error: Mismatched bracket."); return NULL; }
+    if ((n = NewNode(s->e, ALGNODE_CALLTEXT, bracket.start+1, s->start, 0))==NULL) { MEMORY_ERROR(name.start) ; return NULL; }
+    if ((n->text = StrDupLen(in+bracket.start+1, bracket.end-bracket.start-1))==NULL) { MEMORY_ERROR(name.start) ; return NULL; }
+    n->TextLen  = k-1;
+    n->fn       = fd->FunctionPtr;
+    n->AngleFix = 1;
+    s->e->NeedsGlobals = 1;
+    return n;
+   }
+  else if ((FunctionType != PPL_USERSPACE_UNIT) && (in[i] != ')')) // Unit function deals with arguments itself
+   {
+    *errpos = i;
+    if (in[i] ==',') strcpy(errtext,"Syntax Error: Too many arguments supplied to function.");
+    else             strcpy(errtext,"Syntax Error: Unexpected trailing matter after final argument to function.");
+    return NULL;
+   }
+  else if (FunctionType == PPL_USERSPACE_UNIT) // Units are constants, and are evaluated now
+   {
+    if ((n = NewNode(s->e, ALGNODE_CONST, name.start, s->start, 0))==NULL) { MEMORY_ERROR(name.start) ; return NULL; }
+    j=-1;
+    ppl_units_StringEvaluate(in+i, &n->v, &k, &j, errtext);
+    if (j>=0) { *errpos = i+j; return NULL; }
+    i+=k; while ((in[i]>'\0')&&(in[i]<=' ')) i++;
+    if (in[i] != ')') { *errpos = i; strcpy(errtext,"Syntax Error: Unexpected trailing matter after unit expression."); return NULL; }
+    n->AngleFix = 1;
+    return n;
+   }
+
+  // All remaining function types take a fixed list of numeric arguments
+  switch (FunctionType)
+   {
+    case PPL_USERSPACE_SYSTEM   : k = ALGNODE_CALL;      break;
+    case PPL_USERSPACE_SPLINE   : k = ALGNODE_SPLINE;    break;
+    case PPL_USERSPACE_INTERP2D : k = ALGNODE_INTERP2D;  break;
+    case PPL_USERSPACE_BMPDATA  : k = ALGNODE_BMPDATA;   break;
+    case PPL_USERSPACE_HISTOGRAM: k = ALGNODE_HISTOGRAM; break;
+    case PPL_USERSPACE_FFT      : k = ALGNODE_FFT;       break;
+    case PPL_USERSPACE_USERDEF  : k = ALGNODE_USERFN;    break;
+    case PPL_USERSPACE_INT      : k = (DictItem->key[0]=='i') ? ALGNODE_INT : ALGNODE_DIFF; break;
+    default                     : *errpos=name.start; strcpy(errtext,"No such function"); return NULL;
+   }
+  if ((n = NewNode(s->e, k, name.start, s->start, (NArgs>0)?NArgs:0))==NULL) { MEMORY_ERROR(name.start) ; return NULL; }
+  for (j=0; j<NArgs; j++) n->child[j] = args[j];
+  n->fn       = (void *)fd;
+  n->AngleFix = 1;
+  if ((n->name = StrDupLen(DictItem->key, strlen(DictItem->key)))==NULL) { MEMORY_ERROR(name.start) ; return NULL; }
+
+  if (FunctionType == PPL_USERSPACE_SYSTEM)
+   {
+    n->fn = fd->FunctionPtr;
+   }
+  else if (FunctionType == PPL_USERSPACE_INT)
+   {
+    free(n->name);
+    if ((n->name = StrDupLen(dummy, strlen(dummy)))==NULL) { MEMORY_ERROR(name.start) ; return NULL; }
+    if ((n->text = StrDupLen(integrand, IntegrandLen))==NULL) { MEMORY_ERROR(name.start) ; return NULL; }
+    n->slot = OptionalStep;
+    s->e->NeedsGlobals = 1;
+   }
+  else if (FunctionType == PPL_USERSPACE_USERDEF)
+   {
+    // Inline the body of each spliced definition of this function, with the function's arguments bound to workspace slots
+    for (n->NAlt=0, FuncDef=fd; FuncDef!=NULL; FuncDef=FuncDef->next) n->NAlt++;
+    n->AltDef  = (FunctionDescriptor **)malloc(n->NAlt * sizeof(FunctionDescriptor *));
+    n->AltBody = (AlgebraNode        **)malloc(n->NAlt * sizeof(AlgebraNode        *));
+    if ((n->AltDef==NULL)||(n->AltBody==NULL)) { MEMORY_ERROR(name.start) ; return NULL; }
+    n->slot             = s->e->NSlots;
+    s->e->NSlots       += 2*NArgs; // Slots for argument values, followed by slots where global variables are stashed
+    NewScope.NArgs      = NArgs;
+    NewScope.ArgList    = fd->ArgList;
+    NewScope.SlotBase   = n->slot;
+    NewScope.def        = fd;
+    NewScope.parent     = s->scope;
+    for (k=0, FuncDef=fd; FuncDef!=NULL; k++, FuncDef=FuncDef->next)
+     {
+      char *body = (char *)FuncDef->FunctionPtr;
+      n->AltDef[k] = FuncDef;
+      j=-1;
+      n->AltBody[k] = CompileSub(s->e, body, 0, &j, s->depth+1, &NewScope, NULL, errpos, errtext);
+      if ((n->AltBody[k]!=NULL) && (body[j]!='\0')) { n->AltBody[k]=NULL; *errpos=1; strcpy(errtext,"Unexpected trailing matter in function definition."); }
+      if (n->AltBody[k]==NULL) // Errors within function definitions are only reported if that definition is used
+       {
+        *errpos = -1;
+        if ((n->AltBody[k] = ErrorNode(s->e, name.start, errtext))==NULL) { MEMORY_ERROR(name.start) ; return NULL; }
+       }
+     }
+   }
+  return n;
+ }
+
+// CompileSub(): Compile the algebraic expression which starts at in+start. Positions are all relative to in.
+static AlgebraNode *CompileSub(CompiledAlgebra *e, char *in, int start, int *end, int depth, CompileScope *scope, unsigned char *StatusIn, int *errpos, char *errtext)
+ {
+  unsigned char StatusBuf[ALGEBRA_MAXLENGTH], *StatusRow = StatusIn;
+  unsigned char OpList[OPLIST_LEN];
+  CompileState  s;
+  AlgebraNode  *n;
+  int           len, p, p0, q, Ntok;
+
+  if (depth > MAX_RECURSION_DEPTH) { *errpos=start; strcpy(errtext,"Overflow Error: Maximum recursion depth exceeded"); return NULL; }
+
+  *errpos = -1;
+  if (StatusRow == NULL)
+   {
+    StatusRow = StatusBuf;
+    ppl_GetExpression(in+start, &len, e->DollarAllowed, StatusRow, OpList, errpos, errtext);
+    if (*errpos >= 0) { (*errpos) += start; return NULL; }
+   }
+  else
+   {
+    len = *end - start;
+   }
+  if (end != NULL) *end = start + len;
+
+  // Break status row up into a list of atoms, skipping any leading whitespace
+  for (p0=0; (p0<len) && (in[start+p0]>'\0') && (in[start+p0]<=' '); p0++);
+  for (p=p0, Ntok=0; p<len; Ntok++) { for (q=p; (q<len) && (StatusRow[q]==StatusRow[p]); q++); p=q; }
+  s.tok = (AlgebraToken *)malloc((Ntok+1) * sizeof(AlgebraToken));
+  if (s.tok == NULL) { MEMORY_ERROR(start); return NULL; }
+  for (p=p0, Ntok=0; p<len; Ntok++)
+   {
+    for (q=p; (q<len) && (StatusRow[q]==StatusRow[p]); q++);
+    s.tok[Ntok].type    = StatusRow[p];
+    s.tok[Ntok].start   = start+p;
+    s.tok[Ntok].end     = start+q;
+    while ((q>p) && (in[start+q-1]<=' ')) q--;
+    s.tok[Ntok].TextEnd = start+q;
+    p = s.tok[Ntok].end - start;
+   }
+
+  s.e       = e;
+  s.in      = in;
+  s.Ntok    = Ntok;
+  s.i       = 0;
+  s.start   = start;
+  s.depth   = depth;
+  s.scope   = scope;
+  s.errpos  = errpos;
+  s.errtext = errtext;
+  n = ParseOr(&s);
+  if ((n!=NULL) && (s.i < s.Ntok)) { n=NULL; *errpos=s.tok[s.i].start; strcpy(errtext, "Internal Error: ppl_EvaluateAlgebra failed to evaluate this expression"); }
+  free(s.tok);
+  return n;
+ }
+
+// ---------------------------------
+// Public interface to the compiler
+// ---------------------------------
+
+// Work out whether a node may be evaluated simultaneously in several threads, each with its own copy of the compiled expression.
+// Nodes which write to global variables, parse text, read datafile columns, or use shared state such as the random number generator may not.
+static unsigned char NodeThreadSafe(AlgebraNode *n)
+ {
+  switch (n->type)
+   {
+    case ALGNODE_CALLTEXT: case ALGNODE_SPLINE: case ALGNODE_FFT: case ALGNODE_SUBROUTINE: case ALGNODE_INT: case ALGNODE_DIFF:
+    case ALGNODE_COLUMN: case ALGNODE_COLNAME: case ALGNODE_TEXT:
+      return 0;
+    case ALGNODE_CALL:
+      if ((n->fn == (void *)&dcfmath_frandom  ) || (n->fn == (void *)&dcfmath_frandombin) || (n->fn == (void *)&dcfmath_frandomcs) ||
+          (n->fn == (void *)&dcfmath_frandomg ) || (n->fn == (void *)&dcfmath_frandomln ) || (n->fn == (void *)&dcfmath_frandomp ) ||
+          (n->fn == (void *)&dcfmath_frandomt )) return 0;
+      return 1;
+    default:
+      return 1;
+   }
+ }
+
+// Compile (or recompile) e->text into a tree. StatusRow may be supplied if ppl_GetExpression() has already been run on the text.
+static int CompileTree(CompiledAlgebra *e, unsigned char *StatusRow, int *errpos, char *errtext, int RecursionDepth)
+ {
+  CompileScope scope;
+  AlgebraNode *n;
+  int end = strlen(e->text);
+  FreeNodes(e);
+  e->generation     = _ppl_UserSpace_Generation;
+  e->NeedsGlobals   = 0;
+  e->NSlots         = 2*e->NArgs;
+  scope.NArgs       = e->NArgs;
+  scope.ArgList     = e->ArgNames;
+  scope.SlotBase    = 0;
+  scope.def         = NULL;
+  scope.parent      = NULL;
+  e->root = CompileSub(e, e->text, 0, &end, RecursionDepth, (e->NArgs>0)?&scope:NULL, StatusRow, errpos, errtext);
+  if (e->root == NULL) return 1;
+  e->ThreadSafe = !e->NeedsGlobals;
+  for (n=e->nodes; (n!=NULL) && e->ThreadSafe; n=n->next) e->ThreadSafe = NodeThreadSafe(n);
+  if (e->workspace != NULL) free(e->workspace);
+  e->workspace = (value *)malloc((e->NSlots+1) * sizeof(value));
+  if (e->workspace == NULL) { MEMORY_ERROR(0); return 1; }
+  return 0;
+ }
+
+// ppl_CompileAlgebra(): Compile the algebraic expression at in+start. The arguments start, end, DollarAllowed, errpos, errtext and
+// RecursionDepth have the same meanings as in ppl_EvaluateAlgebra(). ArgNames is a list of NArgs variable names which will be bound
+// to the values passed in args[] when the expression is evaluated, rather than being looked up in the user's variable space.
+
+CompiledAlgebra *ppl_CompileAlgebra(char *in, int start, int *end, unsigned char DollarAllowed, int NArgs, char **ArgNames, int *errpos, char *errtext, int RecursionDepth)
+ {
+  unsigned char    StatusRow[ALGEBRA_MAXLENGTH];
+  unsigned char    OpList[OPLIST_LEN];
+  CompiledAlgebra *e;
+  int              len, CalculatedEnd, i, j;
+
+  if (RecursionDepth > MAX_RECURSION_DEPTH) { *errpos=start; strcpy(errtext,"Overflow Error: Maximum recursion depth exceeded"); return NULL; }
+
+  *errpos = -1;
+  ppl_GetExpression(in+start, &len, DollarAllowed, StatusRow, OpList, errpos, errtext);
+  if (*errpos >= 0) { (*errpos) += start; return NULL; }
+  CalculatedEnd = start + len;
+  if ((end != NULL) && (*end >  0) && (CalculatedEnd < *end)) { *errpos=CalculatedEnd; strcpy(errtext,"Syntax Error: Unexpected trailing matter after algebraic expression"); return NULL; }
+  if ((end != NULL) && (*end <= 0)) *end = CalculatedEnd;
+
+  if ((e = (CompiledAlgebra *)malloc(sizeof(CompiledAlgebra)))==NULL) { MEMORY_ERROR(start); return NULL; }
+  memset(e, 0, sizeof(CompiledAlgebra));
+  e->offset        = start;
+  e->NArgs         = NArgs;
+  e->DollarAllowed = DollarAllowed;
+  if ((e->text = StrDupLen(in+start, len))==NULL) { free(e); MEMORY_ERROR(start); return NULL; }
+  for (i=j=0; i<NArgs; i++) j+=strlen(ArgNames[i])+1;
+  if ((e->ArgNames = (char *)malloc(j+1))==NULL) { ppl_CompiledAlgebraFree(e); MEMORY_ERROR(start); return NULL; }
+  for (i=j=0; i<NArgs; i++) { strcpy(e->ArgNames+j, ArgNames[i]); j+=strlen(ArgNames[i])+1; }
+
+  if (CompileTree(e, StatusRow, errpos, errtext, RecursionDepth)) { (*errpos) += start; ppl_CompiledAlgebraFree(e); return NULL; }
+  return e;
+ }
+
+void ppl_CompiledAlgebraFree(CompiledAlgebra *e)
+ {
+  if (e==NULL) return;
+  FreeNodes(e);
+  if (e->text     !=NULL) free(e->text);
+  if (e->ArgNames !=NULL) free(e->ArgNames);
+  if (e->workspace!=NULL) free(e->workspace);
+  free(e);
+  return;
+ }
+
+// ppl_CompileAlgebraCached(): As ppl_CompileAlgebra(), but with no bound arguments. ppl_EvaluateAlgebra() tends to be called over
+// and over on the same strings -- for example, on every line of a datafile -- and so the expressions it compiles are kept in a small
+// hash table, indexed by their text. Expressions returned by this function should be passed to ppl_CompiledAlgebraRelease() when done.
+
+#define COMPILE_CACHE_SIZE 64
+
+typedef struct CompileCacheItem {
+ char            *key;
+ unsigned long    hash;
+ int              len, RecursionDepth;
+ unsigned char    DollarAllowed;
+ CompiledAlgebra *e;
+ } CompileCacheItem;
+
+static CompileCacheItem CompileCache[COMPILE_CACHE_SIZE];
+
+CompiledAlgebra *ppl_CompileAlgebraCached(char *in, int start, int *end, unsigned char DollarAllowed, int *errpos, char *errtext, int RecursionDepth)
+ {
+  CompileCacheItem *c;
+  CompiledAlgebra  *e;
+  unsigned long     hash = 5381;
+  char             *key, *p;
+  int               CalculatedEnd, len;
+
+  if (RecursionDepth > MAX_RECURSION_DEPTH) { *errpos=start; strcpy(errtext,"Overflow Error: Maximum recursion depth exceeded"); return NULL; }
+
+  for (p=in+start; *p!='\0'; p++) hash = hash*33 + (unsigned char)*p;
+  c = CompileCache + (hash % COMPILE_CACHE_SIZE);
+
+  if ((c->e!=NULL) && (!c->e->InUse) && (c->hash==hash) && (c->DollarAllowed==DollarAllowed) && (c->RecursionDepth==RecursionDepth) && (strcmp(c->key, in+start)==0))
+   {
+    *errpos = -1;
+    CalculatedEnd = start + c->len;
+    if ((end != NULL) && (*end >  0) && (CalculatedEnd < *end)) { *errpos=CalculatedEnd; strcpy(errtext,"Syntax Error: Unexpected trailing matter after algebraic expression"); return NULL; }
+    if ((end != NULL) && (*end <= 0)) *end = CalculatedEnd;
+    c->e->offset = start;
+    c->e->InUse  = 1;
+    return c->e;
+   }
+
+  CalculatedEnd = -1;
+  e = ppl_CompileAlgebra(in, start, &CalculatedEnd, DollarAllowed, 0, NULL, errpos, errtext, RecursionDepth);
+  if (e==NULL) return NULL;
+  if ((end != NULL) && (*end >  0) && (CalculatedEnd < *end)) { *errpos=CalculatedEnd; strcpy(errtext,"Syntax Error: Unexpected trailing matter after algebraic expression"); ppl_CompiledAlgebraFree(e); return NULL; }
+  if ((end != NULL) && (*end <= 0)) *end = CalculatedEnd;
+  len = CalculatedEnd - start;
+
+  if ((c->e!=NULL) && (c->e->InUse)) return e; // Cache entry is busy; return an uncached copy which will be freed after use
+  if ((key = StrDupLen(in+start, strlen(in+start)))==NULL) return e;
+  if (c->e!=NULL) { ppl_CompiledAlgebraFree(c->e); free(c->key); }
+  c->key            = key;
+  c->hash           = hash;
+  c->len            = len;
+  c->RecursionDepth = RecursionDepth;
+  c->DollarAllowed  = DollarAllowed;
+  c->e              = e;
+  e->cached         = 1;
+  e->InUse          = 1;
+  return e;
+ }
+
+void ppl_CompiledAlgebraRelease(CompiledAlgebra *e)
+ {
+  if (e==NULL) return;
+  if (e->cached) e->InUse = 0;
+  else           ppl_CompiledAlgebraFree(e);
+  return;
+ }
+
+// ppl_CompiledAlgebraDataOnly(): Returns 1 if the value of an expression depends only upon constants and datafile columns, and so will
+// always evaluate to the same result on the same line of the same datafile. Expressions which refer to variables or user-defined
+// functions, which may be redefined at any time, or which call random number generators or the clock, do not.
+
+int ppl_CompiledAlgebraDataOnly(CompiledAlgebra *e)
+ {
+  AlgebraNode *n;
+  if ((e==NULL) || e->NeedsGlobals) return 0;
+  for (n=e->nodes; n!=NULL; n=n->next)
+   switch (n->type)
+    {
+     case ALGNODE_CONST: case ALGNODE_UNARY: case ALGNODE_BINARY: case ALGNODE_COND: case ALGNODE_COLUMN: case ALGNODE_COLNAME:
+       break;
+     case ALGNODE_CALL:
+       if ((n->fn == (void *)&dcftime_now) || !NodeThreadSafe(n)) return 0;
+       break;
+     default:
+       return 0;
+    }
+  return 1;
+ }
+
+// ppl_CompiledAlgebraTrivial(): Callers which evaluate an expression very many times over can use this to skip evaluation altogether in
+// common cases. If the expression is simply one of its bound arguments, such as "(c1)", the number of that argument is returned. If it is
+// a constant, such as "1", -2 is returned and its value is put in *out. Otherwise -1 is returned.
+
+int ppl_CompiledAlgebraTrivial(CompiledAlgebra *e, value *out)
+ {
+  if ((e==NULL) || (e->root==NULL) || e->NeedsGlobals) return -1;
+  if ((e->root->type==ALGNODE_SLOT) && (e->root->slot < e->NArgs)) return e->root->slot;
+  if (e->root->type==ALGNODE_CONST)
+   {
+    *out = e->root->v;
+    if (e->root->AngleFix) { ENFORCEANGLEDIMLESS(out); }
+    out->modified = 0;
+    out->string   = NULL;
+    return -2;
+   }
+  return -1;
+ }
+
+// ---------------------------------
+// Evaluation of compiled expressions
+// ---------------------------------
+
+// Swap the values of the arguments to a function into the global variable dictionary, so that they are visible to
+// functions which parse their arguments from text. Exactly as was done when all expressions were evaluated from text.
+static void SwapArgsIn(char *ArgList, int NArgs, value *vals, value *stash)
+ {
+  int j, k;
+  value *VarData;
+  for (j=0,k=0; k<NArgs; k++)
+   {
+    DictLookup(_ppl_UserSpace_Vars, ArgList+j, NULL, (void *)&VarData);
+    if (VarData!=NULL)
+     {
+      memcpy(stash+k, VarData, sizeof(value));
+      memcpy(VarData, vals+k, sizeof(value));
+     }
+    else
+     {
+      ppl_units_zero(stash+k);
+      stash[k].modified=2;
+      DictAppendValue(_ppl_UserSpace_Vars, ArgList+j, vals[k]);
+     }
+    j += strlen(ArgList+j)+1;
+   }
+ }
+
+static void SwapArgsOut(char *ArgList, int NArgs, value *stash)
+ {
+  int j, k;
+  value *VarData;
+  for (j=0,k=0; k<NArgs; k++)
+   {
+    DictLookup(_ppl_UserSpace_Vars, ArgList+j, NULL, (void *)&VarData);
+    if (VarData!=NULL) memcpy(VarData, stash+k, sizeof(value));
+    j += strlen(ArgList+j)+1;
+   }
+ }
+
+// If a subroutine has redefined things while we were being evaluated, function descriptors must be looked up again by name
+static FunctionDescriptor *FetchDescriptor(CompiledAlgebra *e, AlgebraNode *n, int type, int *errpos, char *errtext)
+ {
+  FunctionDescriptor *fd = (FunctionDescriptor *)n->fn;
+  if (e->generation != _ppl_UserSpace_Generation)
+   {
+    DictLookup(_ppl_UserSpace_Funcs, n->name, NULL, (void *)&fd);
+    if ((fd==NULL) || (fd->FunctionType!=type)) { *errpos=n->pos; strcpy(errtext,"No such function"); return NULL; }
+   }
+  return fd;
+ }
+
+static int IntegerOperands(const value *a, const value *b, const char *kind, int pos, int *errpos, char *errtext)
+ {
+  if ( (a->dimensionless == 0) || (b->dimensionless == 0) )
+   {
+    if ( (a->dimensionless == 0) && (b->dimensionless == 0) )
+     { *errpos=pos; sprintf(errtext, "%s operators can only be applied to dimensionless operands; here, the left operand has units of <%s> and the right operand has units of <%s>.", kind, ppl_units_GetUnitStr(a, NULL, NULL, 0, 1, 0), ppl_units_GetUnitStr(b, NULL, NULL, 1, 1, 0)); return 1; }
+    else if (a->dimensionless == 0)
+     { *errpos=pos; sprintf(errtext, "%s operators can only be applied to dimensionless operands; here, the left operand has units of <%s>.", kind, ppl_units_GetUnitStr(a, NULL, NULL, 0, 1, 0) ); return 1; }
+    else
+     { *errpos=pos; sprintf(errtext, "%s operators can only be applied to dimensionless operands; here, the right operand has units of <%s>.", kind, ppl_units_GetUnitStr(b, NULL, NULL, 0, 1, 0) ); return 1; }
+   }
+  if (a->FlagComplex || b->FlagComplex)
+   { *errpos=pos; sprintf(errtext, "%s operators can only be applied to real operands; supplied operands have imaginary components.", kind); return 1; }
+  if ((a->real<=INT_MIN)||(a->real>=INT_MAX)||(!gsl_finite(a->real))||(b->real<=INT_MIN)||(b->real>=INT_MAX)||(!gsl_finite(b->real)))
+   { *errpos=pos; sprintf(errtext, "%s operators can only be applied to operands in the range %d<x<%d.", kind, INT_MIN, INT_MAX); return 1; }
+  return 0;
+ }
+
+static int ComparableOperands(const value *a, const value *b, int pos, int *errpos, char *errtext)
+ {
+  if (ppl_units_DimEqual(a, b) == 0)
+   {
+    *errpos=pos;
+    if      (a->dimensionless)
+     { sprintf(errtext, "Attempt to compare a quantity which is dimensionless with one with dimensions of <%s>.", ppl_units_GetUnitStr(b,NULL,NULL,1,1,0)); }
+    else if (b->dimensionless)
+     { sprintf(errtext, "Attempt to compare a quantity with dimensions of <%s> with one which is dimensionless.", ppl_units_GetUnitStr(a,NULL,NULL,0,1,0)); }
+    else
+     { sprintf(errtext, "Attempt to compare a quantity with dimensions of <%s> with one with dimensions of <%s>.", ppl_units_GetUnitStr(a,NULL,NULL,0,1,0), ppl_units_GetUnitStr(b,NULL,NULL,1,1,0)); }
+    return 1;
+   }
+  return 0;
+ }
+
+static void EvalBinary(CompiledAlgebra *e, AlgebraNode *n, value *ws, value *out, int *errpos, char *errtext, int RecursionDepth)
+ {
+  value  a, b;
+  int    st=-1;
+  double TempDbl, TempDbl2;
+
+  EvalNode(e, n->child[0], ws, &a, errpos, errtext, RecursionDepth); if (*errpos>=0) return;
+  EvalNode(e, n->child[1], ws, &b, errpos, errtext, RecursionDepth); if (*errpos>=0) return;
+
+  switch (n->op)
+   {
+    case ALGOP_POW: ppl_units_pow (&a, &b, out, &st, errtext); break;
+    case ALGOP_MUL: ppl_units_mult(&a, &b, out, &st, errtext); break;
+    case ALGOP_DIV: ppl_units_div (&a, &b, out, &st, errtext); break;
+    case ALGOP_MOD: ppl_units_mod (&a, &b, out, &st, errtext); break;
+    case ALGOP_ADD: ppl_units_add (&a, &b, out, &st, errtext); break;
+    case ALGOP_SUB: ppl_units_sub (&a, &b, out, &st, errtext); break;
+    case ALGOP_SHL: case ALGOP_SHR: case ALGOP_BAND: case ALGOP_BXOR: case ALGOP_BOR:
+      if (IntegerOperands(&a, &b, "Binary", n->pos, errpos, errtext)) return;
+      *out = a;
+      if      (n->op==ALGOP_SHL ) out->real = (double)((int)a.real << (int)b.real);
+      else if (n->op==ALGOP_SHR ) out->real = (double)((int)a.real >> (int)b.real);
+      else if (n->op==ALGOP_BAND) out->real = (double)((int)a.real &  (int)b.real);
+      else if (n->op==ALGOP_BXOR) out->real = (double)((int)a.real ^  (int)b.real);
+      else                        out->real = (double)((int)a.real |  (int)b.real);
+      if (((n->op==ALGOP_SHL)||(n->op==ALGOP_SHR)) && ((out->real<=INT_MIN)||(out->real>=INT_MAX)||(!gsl_finite(out->real))))
+       { *errpos=n->pos; sprintf(errtext, "Overflow error; the result of a binary operation must be in the range %d<x<%d.",INT_MIN,INT_MAX); return; }
+      break;
+    case ALGOP_AND: case ALGOP_OR:
+      if (IntegerOperands(&a, &b, "Logical", n->pos, errpos, errtext)) return;
+      *out = a;
+      if (n->op==ALGOP_AND) out->real = (double)((int)a.real && (int)b.real);
+      else                  out->real = (double)((int)a.real || (int)b.real);
+      break;
+    case ALGOP_LT: case ALGOP_LE: case ALGOP_GE: case ALGOP_GT:
+      if (ComparableOperands(&a, &b, n->pos, errpos, errtext)) return;
+      if (a.FlagComplex || b.FlagComplex)
+       { *errpos=n->pos; sprintf(errtext, "Magnitude comparisons can only be applied to real operands; supplied operands have imaginary components."); return; }
+      TempDbl = a.real;
+      ppl_units_zero(out);
+      if      (n->op==ALGOP_LE) out->real = (double)(TempDbl <= b.real);
+      else if (n->op==ALGOP_GE) out->real = (double)(TempDbl >= b.real);
+      else if (n->op==ALGOP_LT) out->real = (double)(TempDbl <  b.real);
+      else                      out->real = (double)(TempDbl >  b.real);
+      break;
+    case ALGOP_EQ: case ALGOP_NE:
+      if (ComparableOperands(&a, &b, n->pos, errpos, errtext)) return;
+      TempDbl  = a.real;
+      TempDbl2 = a.imag;
+      ppl_units_zero(out);
+      out->real = (double)(ppl_units_DblEqual(TempDbl, b.real) && ppl_units_DblEqual(TempDbl2, b.imag));
+      if (n->op==ALGOP_NE) out->real = !out->real;
+      break;
+   }
+  if (st >= 0) *errpos=n->pos;
+  return;
+ }
+
+static void EvalUserFn(CompiledAlgebra *e, AlgebraNode *n, value *ws, value *out, int *errpos, char *errtext, int RecursionDepth)
+ {
+  FunctionDescriptor *FuncDef, *fd = (FunctionDescriptor *)n->fn;
+  value *args = ws + n->slot;
+  int    NArgs = n->NChild;
+  int    alt, j, k, l;
+
+  for (k=0; k<NArgs; k++)
+   {
+    EvalNode(e, n->child[k], ws, args+k, errpos, errtext, RecursionDepth);
+    if (*errpos>=0) return;
+    args[k].modified = 0; // Arguments may be written into global variables by SwapArgsIn()
+    args[k].string   = NULL;
+   }
+
+  j=0;
+  for (alt=0; alt<n->NAlt; alt++) // Check whether supplied arguments are within the range of this definition
+   {
+    FuncDef = n->AltDef[alt];
+    l=1;
+    for (k=0; ((k<NArgs)&&(l==1)); k++)
+     {
+      if (FuncDef->MinActive[k]!=0)
+       {
+        if (j==0)
+         {
+          if (!ppl_units_DimEqual(FuncDef->min+k , args+k))
+           {
+            *errpos = n->pos;
+            sprintf(errtext,"Argument %d supplied to this function is dimensionally incompatible with the argument's specified min/max range: argument has dimensions of <%s>, meanwhile range has dimensions of <%s>.",k+1,ppl_units_GetUnitStr(args+k,NULL,NULL,0,1,0),ppl_units_GetUnitStr(FuncDef->min+k,NULL,NULL,1,1,0));
+            return;
+           }
+          else if (args[k].FlagComplex)
+           {
+            *errpos = n->pos;
+            sprintf(errtext,"Argument %d supplied to this function must be a real number: any arguments which have min/max ranges specified must be real.",k+1);
+            return;
+           } else { j=1; }
+         }
+        if (args[k].real < FuncDef->min[k].real) { l=0; continue; }
+       }
+      if (FuncDef->MaxActive[k]!=0)
+       {
+        if (j==0)
+         {
+          if (!ppl_units_DimEqual(FuncDef->max+k , args+k))
+           {
+            *errpos = n->pos;
+            sprintf(errtext,"Argument %d supplied to this function is dimensionally incompatible with the argument's specified min/max range: argument has dimensions of <%s>, meanwhile range has dimensions of <%s>.",k+1,ppl_units_GetUnitStr(args+k,NULL,NULL,0,1,0),ppl_units_GetUnitStr(FuncDef->max+k,NULL,NULL,1,1,0));
+            return;
+           }
+          else if (args[k].FlagComplex)
+           {
+            *errpos = n->pos;
+            sprintf(errtext,"Argument %d supplied to this function must be a real number: any arguments which have min/max ranges specified must be real.",k+1);
+            return;
+           } else { j=1; }
+         }
+        if (args[k].real > FuncDef->max[k].real) { l=0; continue; }
+       }
+     }
+    if (l==1) break;
+   }
+
+  if (alt>=n->NAlt)
+   {
+    if (settings_term_current.ExplicitErrors == SW_ONOFF_OFF) { ppl_units_zero(out); out->real = GSL_NAN; out->imag = 0; return; }
+    else { *errpos = n->pos2; sprintf(errtext,"This function is not defined in the requested region of parameter space."); return; }
+   }
+
+  if (e->NeedsGlobals) SwapArgsIn(fd->ArgList, NArgs, args, args+NArgs);
+  EvalNode(e, n->AltBody[alt], ws, out, errpos, errtext, RecursionDepth+1);
+  if (e->NeedsGlobals) SwapArgsOut(fd->ArgList, NArgs, args+NArgs);
+  if (*errpos >= 0) *errpos = n->pos;
+  return;
+ }
+
+static void EvalNode(CompiledAlgebra *e, AlgebraNode *n, value *ws, value *out, int *errpos, char *errtext, int RecursionDepth)
+ {
+  value  argv[6], *VarData;
+  int    j, k;
+  void  *desc;
+
+  switch (n->type)
+   {
+    case ALGNODE_CONST:
+      *out = n->v;
+      break;
+    case ALGNODE_VAR:
+      VarData = n->var;
+      if ((VarData==NULL) || (e->generation != _ppl_UserSpace_Generation)) DictLookup(_ppl_UserSpace_Vars, n->name, NULL, (void *)&VarData);
+      if ((VarData == NULL) || (VarData->modified==2)) { *errpos = n->pos; sprintf(errtext, "No such variable, '%s'.", n->name); return; }
+      if (VarData->string != NULL) { *errpos = n->pos; strcpy(errtext, "Type Error: This is a string variable where numeric value is expected."); return; }
+      *out = *VarData;
+      break;
+    case ALGNODE_SLOT:
+      *out = ws[n->slot];
+      break;
+    case ALGNODE_UNARY:
+      EvalNode(e, n->child[0], ws, out, errpos, errtext, RecursionDepth);
+      if (*errpos>=0) return;
+      if (n->op==ALGOP_NEG)
+       {
+        out->real *= -1;
+        if (out->FlagComplex) out->imag *= -1;
+       } else {
+        out->real        = !((out->real==0)&&(out->imag==0));
+        out->imag        = 0;
+        out->FlagComplex = 0;
+       }
+      break;
+    case ALGNODE_BINARY:
+      EvalBinary(e, n, ws, out, errpos, errtext, RecursionDepth);
+      break;
+    case ALGNODE_CALL:
+      for (k=0; k<n->NChild; k++) { EvalNode(e, n->child[k], ws, argv+k, errpos, errtext, RecursionDepth+1); if (*errpos>=0) return; }
+      j=0;
+      if      (n->NChild==0) ((void(*)(value*,                                          int*,char*))n->fn)(                                          out,&j,errtext);
+      else if (n->NChild==1) ((void(*)(value*,value*,                                   int*,char*))n->fn)(argv                                     ,out,&j,errtext);
+      else if (n->NChild==2) ((void(*)(value*,value*,value*,                            int*,char*))n->fn)(argv,argv+1                              ,out,&j,errtext);
+      else if (n->NChild==3) ((void(*)(value*,value*,value*,value*,                     int*,char*))n->fn)(argv,argv+1,argv+2                       ,out,&j,errtext);
+      else if (n->NChild==4) ((void(*)(value*,value*,value*,value*,value*,              int*,char*))n->fn)(argv,argv+1,argv+2,argv+3                ,out,&j,errtext);
+      else if (n->NChild==5) ((void(*)(value*,value*,value*,value*,value*,value*,       int*,char*))n->fn)(argv,argv+1,argv+2,argv+3,argv+4         ,out,&j,errtext);
+      else if (n->NChild==6) ((void(*)(value*,value*,value*,value*,value*,value*,value*,int*,char*))n->fn)(argv,argv+1,argv+2,argv+3,argv+4,argv+5  ,out,&j,errtext);
+      if (j>0) { *errpos = n->pos; return; }
+      break;
+    case ALGNODE_COND:
+      for (k=0; k<3; k++) { EvalNode(e, n->child[k], ws, argv+k, errpos, errtext, RecursionDepth+1); if (*errpos>=0) return; }
+      if (hypot(argv[0].real,argv[0].imag)>1e-250) *out=argv[1];
+      else                                         *out=argv[2];
+      break;
+    case ALGNODE_CALLTEXT:
+      j=-1;
+      ((void(*)(char*,int,value*,unsigned char,int,int*,char*))n->fn)(n->text,n->TextLen,out,e->DollarAllowed,RecursionDepth,&j,errtext);
+      if (j>=0) { *errpos = n->pos+j; return; }
+      break;
+    case ALGNODE_SPLINE: case ALGNODE_HISTOGRAM: case ALGNODE_FFT:
+      if ((desc = FetchDescriptor(e, n, (n->type==ALGNODE_SPLINE)?PPL_USERSPACE_SPLINE:((n->type==ALGNODE_FFT)?PPL_USERSPACE_FFT:PPL_USERSPACE_HISTOGRAM), errpos, errtext))==NULL) return;
+      desc = ((FunctionDescriptor *)desc)->FunctionPtr;
+      if (n->type==ALGNODE_FFT) // FFT functions take an array of arguments
+       {
+        value *fftargs = (value *)malloc((n->NChild+1)*sizeof(value));
+        if (fftargs==NULL) { MEMORY_ERROR(n->pos); return; }
+        for (k=0; k<n->NChild; k++) { EvalNode(e, n->child[k], ws, fftargs+k, errpos, errtext, RecursionDepth+1); if (*errpos>=0) { free(fftargs); return; } }
+        j=0;
+        ppl_fft_evaluate(n->name, (FFTDescriptor *)desc, fftargs, out, &j, errtext);
+        free(fftargs);
+       }
+      else
+       {
+        EvalNode(e, n->child[0], ws, argv, errpos, errtext, RecursionDepth+1); if (*errpos>=0) return;
+        j=0;
+        if (n->type==ALGNODE_SPLINE) ppl_spline_evaluate   (n->name, (SplineDescriptor    *)desc, argv, out, &j, errtext);
+        else                         ppl_histogram_evaluate(n->name, (HistogramDescriptor *)desc, argv, out, &j, errtext);
+       }
+      if (j>0) { *errpos = n->pos; return; }
+      break;
+    case ALGNODE_INTERP2D: case ALGNODE_BMPDATA:
+      if ((desc = FetchDescriptor(e, n, (n->type==ALGNODE_BMPDATA)?PPL_USERSPACE_BMPDATA:PPL_USERSPACE_INTERP2D, errpos, errtext))==NULL) return;
+      desc = ((FunctionDescriptor *)desc)->FunctionPtr;
+      for (k=0; k<2; k++) { EvalNode(e, n->child[k], ws, argv+k, errpos, errtext, RecursionDepth+1); if (*errpos>=0) return; }
+      j=0;
+      ppl_interp2d_evaluate(n->name, (SplineDescriptor *)desc, argv, argv+1, (n->type==ALGNODE_BMPDATA), out, &j, errtext);
+      if (j>0) { *errpos = n->pos; return; }
+      break;
+    case ALGNODE_SUBROUTINE:
+     {
+      int ep=-1, endpos, stat;
+      stat = CallSubroutineFromAlgebra(n->name, n->text, &endpos, &ep, errtext, RecursionDepth+1);
+      if (stat) { *errpos = (ep>=0) ? (n->slot+ep) : n->pos; return; }
+      if (PPL_FLOWCTRL_RETURNTOALGEBRA.string != NULL) { *errpos = n->pos; sprintf(errtext, "This subroutine returns a string result; a numeric result was expected."); return; }
+      *out = PPL_FLOWCTRL_RETURNTOALGEBRA;
+      break;
+     }
+    case ALGNODE_INT: case ALGNODE_DIFF:
+      for (k=1; k<n->NChild; k++) if (n->child[k]!=NULL) { EvalNode(e, n->child[k], ws, argv+k, errpos, errtext, RecursionDepth+1); if (*errpos>=0) return; }
+      if ((n->type==ALGNODE_DIFF) && (n->slot)) // Step size for differentiation was not specified
+       {
+        argv[2] = argv[1];
+        argv[2].real = hypot(argv[2].real , argv[2].imag) * 1e-6;
+        argv[2].imag = 0.0;
+        argv[2].FlagComplex = 0;
+        if (argv[2].real < DBL_MIN*1e5) argv[2].real = 1e-6;
+       }
+      if (n->type==ALGNODE_INT) Integrate    (n->text, n->name, argv+1, argv+2, out, errpos, errtext, RecursionDepth);
+      else                      Differentiate(n->text, n->name, argv+1, argv+2, out, errpos, errtext, RecursionDepth);
+      if (*errpos >= 0) { *errpos = n->pos; return; }
+      break;
+    case ALGNODE_COLUMN:
+      EvalNode(e, n->child[0], ws, out, errpos, errtext, RecursionDepth);
+      if (*errpos>=0) return;
+      if (out->FlagComplex  !=0) { *errpos=n->pos2; strcpy(errtext, "Number of requested column in datafile should be a real integer; supplied number has an imaginary component."); return; }
+      if (out->dimensionless==0) { *errpos=n->pos2; sprintf(errtext, "Number of requested column in datafile should be a dimensionless number; supplied number has units of <%s>.",ppl_units_GetUnitStr(out,NULL,NULL,0,1,0)); return; }
+      j=0;
+      DataFile_UsingConvert_FetchColumnByNumber(out->real, out, 1, 0, &j, errtext);
+      if (j!=0) { *errpos=20000; return; }
+      break;
+    case ALGNODE_COLNAME:
+      j=0;
+      DataFile_UsingConvert_FetchColumnByName(n->name, out, 1, 0, &j, errtext);
+      if (j!=0) { *errpos=20000; return; }
+      break;
+    case ALGNODE_USERFN:
+      EvalUserFn(e, n, ws, out, errpos, errtext, RecursionDepth);
+      if (*errpos>=0) return;
+      break;
+    case ALGNODE_TEXT:
+      j=-1;
+      ppl_EvaluateAlgebra(n->text, out, 0, &j, e->DollarAllowed, errpos, errtext, RecursionDepth+1);
+      if (*errpos>=0) { if (*errpos<20000) *errpos += n->pos; return; }
+      break;
+    case ALGNODE_ERROR:
+      *errpos = n->pos;
+      strcpy(errtext, n->text);
+      return;
+    default:
+      *errpos = n->pos;
+      strcpy(errtext,"Internal Error: ppl_EvaluateAlgebra failed to evaluate this expression");
+      return;
+   }
+  if (n->AngleFix) { ENFORCEANGLEDIMLESS(out); }
+  return;
+ }
+
+// ppl_EvaluateCompiled(): Evaluate a compiled expression. args[] contains values for the NArgs variables named when it was compiled.
+// Error positions are reported relative to the string which was originally passed to ppl_CompileAlgebra().
+
+void ppl_EvaluateCompiled(CompiledAlgebra *e, value *args, value *out, int *errpos, char *errtext, int RecursionDepth)
+ {
+  int k;
+  *errpos = -1;
+  if (e->generation != _ppl_UserSpace_Generation) // Functions or variables have been redefined since we were compiled
+   {
+    if (CompileTree(e, NULL, errpos, errtext, RecursionDepth)) { (*errpos) += e->offset; return; }
+   }
+  for (k=0; k<e->NArgs; k++) { e->workspace[k] = args[k]; e->workspace[k].modified = 0; e->workspace[k].string = NULL; }
+  if (e->NeedsGlobals && (e->NArgs>0)) SwapArgsIn(e->ArgNames, e->NArgs, e->workspace, e->workspace+e->NArgs);
+  EvalNode(e, e->root, e->workspace, out, errpos, errtext, RecursionDepth);
+  if (e->NeedsGlobals && (e->NArgs>0)) SwapArgsOut(e->ArgNames, e->NArgs, e->workspace+e->NArgs);
+  if (*errpos>=0) { (*errpos) += e->offset; return; }
+  out->modified = 0;
+  out->string   = NULL;
+  return;
+ }
+
@@ -0,0 +1,80 @@
+// ppl_userspace_compile.h
+//
+// The code in this file is part of PyXPlot
+// <http://www.pyxplot.org.uk>
+//
+// Copyright (C) 2006-2011 Dominic Ford <coders@pyxplot.org.uk>
+//               2008-2011 Ross Church
+//
+// $Id$
+//
+// PyXPlot is free software; you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation; either version 2 of the License, or (at your option) any later
+// version.
+//
+// You should have received a copy of the GNU General Public License along with
+// PyXPlot; if not, write to the Free Software Foundation, Inc., 51 Franklin
+// Street, Fifth Floor, Boston, MA  02110-1301, USA
+
+// ----------------------------------------------------------------------------
+
+// Algebraic expressions are compiled into a tree of AlgebraNodes, which can
+// then be evaluated many times over without re-parsing the expression text.
+// Calls to user-defined functions are inlined into the tree, with their
+// arguments bound to numbered slots in a workspace.
+
+#ifndef _PPL_USERSPACE_COMPILE_H
+#define _PPL_USERSPACE_COMPILE_H 1
+
+#include "ppl_units.h"
+#include "ppl_userspace.h"
+
+typedef struct AlgebraNode {
+ int    type;                 // One of the ALGNODE_* codes in ppl_userspace_compile.c
+ int    op;                   // Operator code for unary and binary operator nodes
+ int    pos, pos2;            // Positions in the source text where errors should be reported
+ unsigned char AngleFix;      // Apply "set unit angle nodimensionless" to the result of this node
+ value  v;                    // Constant value
+ value *var;                  // Pointer to global variable, if resolved when compiled
+ char  *name;                 // Variable, function or datafile column name
+ char  *text;                 // Source text passed to functions which parse their own arguments
+ int    TextLen;
+ int    slot;                 // Workspace slot of a bound argument, or first slot used by a function call
+ int    NChild;
+ struct AlgebraNode **child;
+ void  *fn;                   // Function pointer or descriptor
+ int    NAlt;                 // Number of spliced definitions of a user-defined function
+ FunctionDescriptor **AltDef;
+ struct AlgebraNode **AltBody;
+ struct AlgebraNode  *next;   // List of all nodes belonging to one compiled expression, for freeing
+ } AlgebraNode;
+
+typedef struct CompiledAlgebra {
+ char          *text;         // Private copy of the expression text
+ int            offset;       // Position of text within the string originally passed to us
+ int            NArgs;
+ char          *ArgNames;     // \0-separated list of the names bound to args[] in ppl_EvaluateCompiled
+ unsigned char  DollarAllowed;
+ unsigned char  NeedsGlobals; // Set if expression contains calls which re-parse text, and hence need to see bound arguments as global variables
+ unsigned char  ThreadSafe;   // Set if separately compiled copies of this expression may be evaluated in several threads at once
+ int            generation;   // Value of _ppl_UserSpace_Generation when compiled
+ int            NSlots;
+ value         *workspace;
+ AlgebraNode   *root;
+ AlgebraNode   *nodes;
+ int            NNodes;
+ unsigned char  cached;       // Set if this expression belongs to the cache used by ppl_EvaluateAlgebra()
+ unsigned char  InUse;        // Set while a cached expression is being evaluated, so that recursive calls do not share its workspace
+ } CompiledAlgebra;
+
+CompiledAlgebra *ppl_CompileAlgebra  (char *in, int start, int *end, unsigned char DollarAllowed, int NArgs, char **ArgNames, int *errpos, char *errtext, int RecursionDepth);
+void             ppl_EvaluateCompiled(CompiledAlgebra *e, value *args, value *out, int *errpos, char *errtext, int RecursionDepth);
+void             ppl_CompiledAlgebraFree(CompiledAlgebra *e);
+CompiledAlgebra *ppl_CompileAlgebraCached(char *in, int start, int *end, unsigned char DollarAllowed, int *errpos, char *errtext, int RecursionDepth);
+void             ppl_CompiledAlgebraRelease(CompiledAlgebra *e);
+int              ppl_CompiledAlgebraDataOnly(CompiledAlgebra *e);
+int              ppl_CompiledAlgebraTrivial (CompiledAlgebra *e, value *out);
+
+#endif
+
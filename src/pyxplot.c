@@ -29,6 +29,7 @@
 #include <setjmp.h>
 #include <time.h>
 #include <sys/stat.h>
+#include <sys/time.h>
 
 #ifdef HAVE_READLINE
 #include <readline/readline.h>
@@ -37,8 +38,6 @@
 
 #include <gsl/gsl_errno.h>
 
-#include "EPSMaker/kpse_wrap.h"
-
 #include "StringTools/asciidouble.h"
 #include "StringTools/str_constants.h"
 
@@ -68,29 +67,55 @@ sigjmp_buf sigjmp_ToInteractive;
 sigjmp_buf sigjmp_ToDirective;
 sigjmp_buf *sigjmp_FromSigInt = NULL;
 
+// Report how long each stage of startup takes, and the total time elapsed since startup began.
+// The report goes to stderr when the -t / --timing switch is given, and to the log when debugging.
+
+static int StartupTiming = 0;
+static struct timeval StartupBegin, StartupLast;
+
+static void StartupTimer(char *stage)
+ {
+  struct timeval now;
+  if ((!DEBUG) && (!StartupTiming)) return;
+  gettimeofday(&now, NULL);
+  if (stage == NULL) { StartupBegin = StartupLast = now; return; }
+  sprintf(temp_err_string, "Startup timing: %-32s took %8.3f ms; %8.3f ms since launch.", stage,
+          (now.tv_sec-StartupLast .tv_sec)*1e3 + (now.tv_usec-StartupLast .tv_usec)*1e-3,
+          (now.tv_sec-StartupBegin.tv_sec)*1e3 + (now.tv_usec-StartupBegin.tv_usec)*1e-3);
+  if (DEBUG) ppl_log(temp_err_string);
+  if (StartupTiming) fprintf(stderr, "%s\n", temp_err_string);
+  StartupLast = now;
+ }
+
 int main(int argc, char **argv)
  {
-  int i,fail=0;
+  int i;
   int tempdirnumber = 1;
   char tempdirpath[FNAME_LENGTH];
   char *EnvDisplay;
-  struct stat statinfo;
 
   sigset_t sigs;
 
-  struct timespec waitperiod, waitedperiod; // A time.h timespec specifier for a 50ms nanosleep wait
-  waitperiod.tv_sec  = 0;
-  waitperiod.tv_nsec = 50000000;
   WillBeInteractive  = 1;
 
+  // Look for the timing switch before anything else, so that the whole of startup can be timed
+  for (i=1; i<argc; i++)
+    if ((strcmp(argv[i], "-t")==0) || (strcmp(argv[i], "-timing")==0) || (strcmp(argv[i], "--timing")==0)) StartupTiming = 1;
+
   // Initialise sub-modules
+  StartupTimer(NULL);
   if (DEBUG) ppl_log("Initialising PyXPlot.");
   lt_MemoryInit(&ppl_error, &ppl_log);
   ClearInputSource(NULL,NULL,NULL,NULL,NULL,NULL);
+  StartupTimer("memory manager");
   ppl_units_init();
+  StartupTimer("units");
   ppl_PaperSizeInit();
+  StartupTimer("paper sizes");
   ppl_settings_makedefault();
+  StartupTimer("default settings");
   ppl_text_init();
+  StartupTimer("text");
 
   // Make all loop names NULL
   for (i=0; i<MAX_ITERLEVEL_DEPTH+1; i++) PPL_FLOWCTRL_LOOPNAME[i]=NULL;
@@ -106,10 +131,12 @@ int main(int argc, char **argv)
 
   // Initialise user variables and functions
   ppl_UserSpaceInit();
+  StartupTimer("user variables and functions");
 
   // Set up commandline parser; do this BEFORE reading config files, which may contain a [script] section which needs parsing
   if (DEBUG) ppl_log("Setting up commandline parser from RE++ definitions.");
   ppl_commands_read();
+  StartupTimer("commandline parser");
 
   // Set default terminal
   EnvDisplay = getenv("DISPLAY"); // Check whether the environment variable DISPLAY is set
@@ -129,6 +156,7 @@ int main(int argc, char **argv)
   // Initialise settings and read configuration file; do this BEFORE processing command line arguments which take precedence
   if (DEBUG) ppl_log("Reading configuration file.");
   ppl_settings_readconfig();
+  StartupTimer("configuration files");
 
   // Scan commandline options for any switches
   for (i=1; i<argc; i++)
@@ -155,6 +183,9 @@ int main(int argc, char **argv)
     else if (strcmp(argv[i], "--mono"      )==0) settings_session_default.colour = SW_ONOFF_OFF;
     else if (strcmp(argv[i], "-monochrome" )==0) settings_session_default.colour = SW_ONOFF_OFF;
     else if (strcmp(argv[i], "--monochrome")==0) settings_session_default.colour = SW_ONOFF_OFF;
+    else if (strcmp(argv[i], "-t"          )==0) continue; // Timing switch; already acted upon above
+    else if (strcmp(argv[i], "-timing"     )==0) continue;
+    else if (strcmp(argv[i], "--timing"    )==0) continue;
     else if (strcmp(argv[i], "-"           )==0) WillBeInteractive=2;
     else if ((strcmp(argv[i], "-v")==0) || (strcmp(argv[i], "-version")==0) || (strcmp(argv[i], "--version")==0))
      {
@@ -186,12 +217,9 @@ int main(int argc, char **argv)
   while (1) { sprintf(tempdirpath, "/tmp/pyxplot_%d_%d", getpid(), tempdirnumber); if (access(tempdirpath, F_OK) != 0) break; tempdirnumber++; } // Find an unused dir path
   strcpy(settings_session_default.tempdir, tempdirpath); // Store our chosen temporary directory path
 
-  // Launch child process
-  if (DEBUG) ppl_log("Launching the Child Support Process.");
+  // Prepare to launch child process. It is not forked, and does not create our temporary directory, until it is first needed.
   InitialiseCSP();
-
-  // Set program name within kpathsea
-  ppl_kpse_wrap_init();
+  StartupTimer("child process handling");
 
   // Set up SIGINT handler
   if (sigsetjmp(sigjmp_ToMain, 1) == 0)
@@ -200,25 +228,13 @@ int main(int argc, char **argv)
     if (signal(SIGINT, SIG_IGN)!=SIG_IGN) signal(SIGINT, SigIntHandler);
     signal(SIGPIPE, SIG_IGN);
 
-    // Wait for temporary directory to appear, and change directory into it
-    if (DEBUG) ppl_log("Waiting for temporary directory to appear.");
-    strcpy(tempdirpath, settings_session_default.tempdir);
-    for (i=0; i<100; i++) { if (access(tempdirpath, F_OK) == 0) break; nanosleep(&waitperiod,&waitedperiod); } // Wait for temp dir to be created by child process
-    if (access(tempdirpath, F_OK) != 0) { fail=1; } // If it never turns up, fail.
-    else
-     {
-      stat(tempdirpath, &statinfo); // Otherwise stat it and make sure it's a directory we own
-      if (!S_ISDIR(statinfo.st_mode)) fail=1;
-      if (statinfo.st_uid != getuid()) fail=1;
-     }
-    if (fail==1)                { ppl_fatal(__FILE__,__LINE__,"Failed to create temporary directory." ); }
-
     // Read GNU Readline history
 #ifdef HAVE_READLINE
     if (DEBUG) ppl_log("Reading GNU Readline history.");
     sprintf(tempdirpath, "%s%s%s", settings_session_default.homedir, PATHLINK, ".pyxplot_history");
     read_history(tempdirpath);
     stifle_history(1000);
+    StartupTimer("readline history");
 #endif
 
     // Scan commandline and process all script files we have been given
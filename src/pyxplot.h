@@ -27,9 +27,6 @@
 
 #include "ListTools/lt_dict.h"
 
-/* Strings defined in ppl_commands.c */
-extern char ppl_commands[];
-
 /* Defined in dcfstr.h */
 extern int NestedConditionalDepth;
 
@@ -40,7 +37,9 @@ extern long int  history_NLinesWritten; // The number of lines written to the GN
 #endif
 void        InteractiveSession  ();
 void        ProcessPyXPlotScript(char *input, int IterLevel);
+struct cmd_chain_item;
 int         ProcessDirective    (char *in, int interactive, int IterLevel);
+int         ProcessDirectiveCached(char *in, int interactive, int IterLevel, struct cmd_chain_item *source);
 int         ProcessDirective2   (char *in, Dict *command, int interactive, int memcontext, int IterLevel);
 int         directive_assert    (Dict *command);
 int         directive_break     (Dict *command, int IterLevel);